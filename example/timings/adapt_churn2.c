@@ -0,0 +1,245 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Usage: p4est_adapt_churn [-l minlevel] [-L maxlevel]
+ *                          [-v velocity] [-w width] [-n cycles]
+ *
+ * Benchmark the full adaptation pipeline under a moving refinement
+ * front.  A band of width 2 * w around a front plane sweeping the unit
+ * domain at the given velocity per cycle is refined to maxlevel; the
+ * rest of the mesh coarsens back to minlevel.  Every cycle runs
+ * refine, coarsen, balance, partition and a fresh ghost layer, so the
+ * reported per-phase times exercise the same churn as a moving-front
+ * simulation.  The criterion is purely geometric, hence deterministic
+ * on every rank count.  The statistics output is compatible with
+ * timana.awk.
+ */
+
+#ifndef P4_TO_P8
+#include <p4est_extended.h>
+#include <p4est_ghost.h>
+#else
+#include <p8est_extended.h>
+#include <p8est_ghost.h>
+#endif
+#include <sc_flops.h>
+#include <sc_statistics.h>
+#include <sc_options.h>
+
+typedef enum churn_stats
+{
+  CHURN_REFINE,
+  CHURN_COARSEN,
+  CHURN_BALANCE,
+  CHURN_PARTITION,
+  CHURN_GHOST,
+  CHURN_CYCLE,
+  CHURN_NUM_STATS
+}
+churn_stats_t;
+
+static const char  *churn_stats_names[CHURN_NUM_STATS] = {
+  "Refine",
+  "Coarsen",
+  "Balance",
+  "Partition",
+  "Ghost",
+  "Cycle"
+};
+
+/** The state of the moving refinement front. */
+typedef struct churn_front
+{
+  int                 minlevel; /**< level outside the band */
+  int                 maxlevel; /**< level inside the band */
+  double              position; /**< front plane position in [0, 1) */
+  double              width;    /**< half width of the refined band */
+}
+churn_front_t;
+
+/** Distance of a quadrant midpoint to the front, wrapped periodically. */
+static double
+churn_front_distance (const churn_front_t * front,
+                      const p4est_quadrant_t * q)
+{
+  const double        half = .5 * (double) P4EST_QUADRANT_LEN (q->level);
+  double              dist;
+
+  dist = fabs (((double) q->x + half) / (double) P4EST_ROOT_LEN -
+               front->position);
+  return SC_MIN (dist, 1. - dist);
+}
+
+static int
+churn_refine_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                 p4est_quadrant_t * quadrant)
+{
+  const churn_front_t *front = (const churn_front_t *) p4est->user_pointer;
+
+  return quadrant->level < front->maxlevel &&
+    churn_front_distance (front, quadrant) < front->width;
+}
+
+static int
+churn_coarsen_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                  p4est_quadrant_t * quadrants[])
+{
+  const churn_front_t *front = (const churn_front_t *) p4est->user_pointer;
+  int                 k;
+
+  if (quadrants[0]->level <= front->minlevel) {
+    return 0;
+  }
+  for (k = 0; k < P4EST_CHILDREN; ++k) {
+    if (churn_front_distance (front, quadrants[k]) < front->width) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  sc_MPI_Comm         mpicomm;
+  int                 mpiret, retval;
+  int                 minlevel, maxlevel, cycles;
+  int                 c, k;
+  double              velocity, width;
+  double              times[CHURN_NUM_STATS];
+  churn_front_t       front;
+  p4est_connectivity_t *conn;
+  p4est_t            *p4est;
+  p4est_ghost_t      *ghost;
+  sc_options_t       *opt;
+  sc_flopinfo_t       fi, snapshot;
+  sc_statinfo_t       stats[CHURN_NUM_STATS];
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  opt = sc_options_new (argv[0]);
+  sc_options_add_int (opt, 'l', "minlevel", &minlevel, 3,
+                      "Refinement level away from the front");
+  sc_options_add_int (opt, 'L', "maxlevel", &maxlevel, 7,
+                      "Refinement level at the front");
+  sc_options_add_double (opt, 'v', "velocity", &velocity, .05,
+                         "Front movement per cycle in domain fractions");
+  sc_options_add_double (opt, 'w', "width", &width, .03,
+                         "Half width of the refined band");
+  sc_options_add_int (opt, 'n', "cycles", &cycles, 20,
+                      "Number of adaptation cycles");
+  retval = sc_options_parse (p4est_package_id, SC_LP_ERROR, opt, argc, argv);
+  if (retval == -1 || retval < argc ||
+      minlevel < 0 || maxlevel < minlevel || maxlevel > P4EST_QMAXLEVEL ||
+      width <= 0. || cycles <= 0) {
+    sc_options_print_usage (p4est_package_id, SC_LP_PRODUCTION, opt, NULL);
+    sc_abort_collective ("Usage error");
+  }
+
+  front.minlevel = minlevel;
+  front.maxlevel = maxlevel;
+  front.position = 0.;
+  front.width = width;
+
+#ifndef P4_TO_P8
+  conn = p4est_connectivity_new_unitsquare ();
+#else
+  conn = p8est_connectivity_new_unitcube ();
+#endif
+  p4est = p4est_new_ext (mpicomm, conn, 0, minlevel, 1, 0, NULL, &front);
+
+  P4EST_GLOBAL_PRODUCTIONF
+    ("Churning levels %d to %d, velocity %g, width %g, %d cycles\n",
+     minlevel, maxlevel, velocity, width, cycles);
+
+  for (k = 0; k < CHURN_NUM_STATS; ++k) {
+    times[k] = 0.;
+  }
+  for (c = 0; c < cycles; ++c) {
+    front.position = fmod (c * velocity, 1.);
+
+    sc_flops_snap (&fi, &snapshot);
+    p4est_refine (p4est, 1, churn_refine_fn, NULL);
+    sc_flops_shot (&fi, &snapshot);
+    times[CHURN_REFINE] += snapshot.iwtime;
+    times[CHURN_CYCLE] += snapshot.iwtime;
+
+    sc_flops_snap (&fi, &snapshot);
+    p4est_coarsen (p4est, 1, churn_coarsen_fn, NULL);
+    sc_flops_shot (&fi, &snapshot);
+    times[CHURN_COARSEN] += snapshot.iwtime;
+    times[CHURN_CYCLE] += snapshot.iwtime;
+
+    sc_flops_snap (&fi, &snapshot);
+    p4est_balance (p4est, P4EST_CONNECT_FULL, NULL);
+    sc_flops_shot (&fi, &snapshot);
+    times[CHURN_BALANCE] += snapshot.iwtime;
+    times[CHURN_CYCLE] += snapshot.iwtime;
+
+    sc_flops_snap (&fi, &snapshot);
+    p4est_partition (p4est, 0, NULL);
+    sc_flops_shot (&fi, &snapshot);
+    times[CHURN_PARTITION] += snapshot.iwtime;
+    times[CHURN_CYCLE] += snapshot.iwtime;
+
+    sc_flops_snap (&fi, &snapshot);
+    ghost = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+    sc_flops_shot (&fi, &snapshot);
+    times[CHURN_GHOST] += snapshot.iwtime;
+    times[CHURN_CYCLE] += snapshot.iwtime;
+    p4est_ghost_destroy (ghost);
+
+    P4EST_GLOBAL_VERBOSEF ("Cycle %d front %g with %lld quadrants\n",
+                           c, front.position,
+                           (long long) p4est->global_num_quadrants);
+  }
+
+  for (k = 0; k < CHURN_NUM_STATS; ++k) {
+    sc_stats_set1 (&stats[k], times[k] / (double) cycles,
+                   churn_stats_names[k]);
+  }
+
+  /* calculate and print timings */
+  sc_stats_compute (mpicomm, CHURN_NUM_STATS, stats);
+  sc_stats_print (p4est_package_id, SC_LP_STATISTICS,
+                  CHURN_NUM_STATS, stats, 1, 1);
+
+  p4est_destroy (p4est);
+  p4est_connectivity_destroy (conn);
+  sc_options_destroy (opt);
+
+  /* clean up and exit */
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
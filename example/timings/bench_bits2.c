@@ -0,0 +1,263 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Usage: p4est_bench_bits [-l level] [-r repetitions]
+ *
+ * Microbenchmarks for the leaf primitives in p4est_bits over a
+ * Morton-sorted quadrant array taken from a fractally refined forest.
+ * Reports cycles per call where a cycle counter is available and
+ * wall-clock nanoseconds per call everywhere.
+ */
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#include <p4est_extended.h>
+#else
+#include <p8est_bits.h>
+#include <p8est_extended.h>
+#endif
+#include <sc_options.h>
+
+/* cycle counter; falls back to zero where no counter is accessible */
+#if defined (__x86_64__) || defined (__i386__)
+#define BENCH_BITS_HAVE_CYCLES 1
+static inline uint64_t
+bench_bits_cycles (void)
+{
+  uint32_t            lo, hi;
+
+  __asm__ __volatile__ ("rdtsc":"=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | (uint64_t) lo;
+}
+#elif defined (__aarch64__)
+#define BENCH_BITS_HAVE_CYCLES 1
+static inline uint64_t
+bench_bits_cycles (void)
+{
+  uint64_t            c;
+
+  __asm__ __volatile__ ("mrs %0, cntvct_el0":"=r" (c));
+  return c;
+}
+#else
+#define BENCH_BITS_HAVE_CYCLES 0
+static inline uint64_t
+bench_bits_cycles (void)
+{
+  return 0;
+}
+#endif
+
+/* prevent the compiler from discarding the benchmark loops */
+static volatile int64_t bench_bits_sink;
+
+static int          refine_level = 6;
+
+static int
+refine_fractal (p4est_t * p4est, p4est_topidx_t which_tree,
+                p4est_quadrant_t * q)
+{
+  int                 qid;
+
+  if ((int) q->level >= refine_level) {
+    return 0;
+  }
+  qid = p4est_quadrant_child_id (q);
+  return (qid == 0 || qid == 3
+#ifdef P4_TO_P8
+          || qid == 5 || qid == 6
+#endif
+    );
+}
+
+static void
+bench_bits_report (const char *name, size_t ncalls,
+                   uint64_t cycles, double seconds)
+{
+#if BENCH_BITS_HAVE_CYCLES
+  P4EST_GLOBAL_PRODUCTIONF ("%-28s %10.2f cycles %10.2f ns per call\n",
+                            name, (double) cycles / (double) ncalls,
+                            1.e9 * seconds / (double) ncalls);
+#else
+  P4EST_GLOBAL_PRODUCTIONF ("%-28s %10.2f ns per call\n",
+                            name, 1.e9 * seconds / (double) ncalls);
+#endif
+}
+
+static void
+bench_bits_run (sc_array_t * quads, int reps)
+{
+  const size_t        n = quads->elem_count;
+  int                 r;
+  size_t              zz;
+  int64_t             sum;
+  uint64_t            c0;
+  double              t0;
+  p4est_quadrant_t   *q1, *q2, neigh;
+
+  P4EST_ASSERT (n >= 2);
+
+  /* pairwise comparison of Morton neighbors */
+  sum = 0;
+  t0 = -sc_MPI_Wtime ();
+  c0 = bench_bits_cycles ();
+  for (r = 0; r < reps; ++r) {
+    for (zz = 0; zz + 1 < n; ++zz) {
+      q1 = p4est_quadrant_array_index (quads, zz);
+      q2 = p4est_quadrant_array_index (quads, zz + 1);
+      sum += p4est_quadrant_compare (q1, q2);
+    }
+  }
+  c0 = bench_bits_cycles () - c0;
+  t0 += sc_MPI_Wtime ();
+  bench_bits_sink += sum;
+  bench_bits_report (P4EST_STRING "_quadrant_compare",
+                     (size_t) reps * (n - 1), c0, t0);
+
+  /* ancestor test between Morton neighbors */
+  sum = 0;
+  t0 = -sc_MPI_Wtime ();
+  c0 = bench_bits_cycles ();
+  for (r = 0; r < reps; ++r) {
+    for (zz = 0; zz + 1 < n; ++zz) {
+      q1 = p4est_quadrant_array_index (quads, zz);
+      q2 = p4est_quadrant_array_index (quads, zz + 1);
+      sum += p4est_quadrant_is_ancestor (q1, q2);
+    }
+  }
+  c0 = bench_bits_cycles () - c0;
+  t0 += sc_MPI_Wtime ();
+  bench_bits_sink += sum;
+  bench_bits_report (P4EST_STRING "_quadrant_is_ancestor",
+                     (size_t) reps * (n - 1), c0, t0);
+
+  /* face neighbor construction, cycling through all faces */
+  sum = 0;
+  t0 = -sc_MPI_Wtime ();
+  c0 = bench_bits_cycles ();
+  for (r = 0; r < reps; ++r) {
+    for (zz = 0; zz < n; ++zz) {
+      q1 = p4est_quadrant_array_index (quads, zz);
+      p4est_quadrant_face_neighbor (q1, (int) (zz % P4EST_FACES), &neigh);
+      sum += neigh.x;
+    }
+  }
+  c0 = bench_bits_cycles () - c0;
+  t0 += sc_MPI_Wtime ();
+  bench_bits_sink += sum;
+  bench_bits_report (P4EST_STRING "_quadrant_face_neighbor",
+                     (size_t) reps * n, c0, t0);
+
+  /* nearest common ancestor of Morton neighbors */
+  sum = 0;
+  t0 = -sc_MPI_Wtime ();
+  c0 = bench_bits_cycles ();
+  for (r = 0; r < reps; ++r) {
+    for (zz = 0; zz + 1 < n; ++zz) {
+      q1 = p4est_quadrant_array_index (quads, zz);
+      q2 = p4est_quadrant_array_index (quads, zz + 1);
+      p4est_nearest_common_ancestor (q1, q2, &neigh);
+      sum += neigh.level;
+    }
+  }
+  c0 = bench_bits_cycles () - c0;
+  t0 += sc_MPI_Wtime ();
+  bench_bits_sink += sum;
+  bench_bits_report (P4EST_STRING "_nearest_common_ancestor",
+                     (size_t) reps * (n - 1), c0, t0);
+}
+
+int
+main (int argc, char **argv)
+{
+  sc_MPI_Comm         mpicomm;
+  int                 mpiret, retval;
+  int                 level, reps;
+  size_t              zz;
+  p4est_topidx_t      jt;
+  p4est_connectivity_t *conn;
+  p4est_t            *p4est;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+  sc_array_t         *quads;
+  sc_options_t       *opt;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  opt = sc_options_new (argv[0]);
+  sc_options_add_int (opt, 'l', "level", &level, 6,
+                      "Fractal refinement level of the input forest");
+  sc_options_add_int (opt, 'r', "reps", &reps, 16,
+                      "Repetitions over the quadrant array");
+  retval = sc_options_parse (p4est_package_id, SC_LP_ERROR, opt, argc, argv);
+  if (retval == -1 || retval < argc) {
+    sc_options_print_usage (p4est_package_id, SC_LP_PRODUCTION, opt, NULL);
+    sc_abort_collective ("Usage error");
+  }
+
+  refine_level = level;
+
+  /* build a Morton-sorted input resembling adapted application meshes */
+#ifndef P4_TO_P8
+  conn = p4est_connectivity_new_unitsquare ();
+#else
+  conn = p8est_connectivity_new_unitcube ();
+#endif
+  p4est = p4est_new_ext (mpicomm, conn, 0, level / 2, 1, 0, NULL, NULL);
+  p4est_refine (p4est, 1, refine_fractal, NULL);
+
+  quads = sc_array_new (sizeof (p4est_quadrant_t));
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = (p4est_quadrant_t *) sc_array_push (quads);
+      *q = *p4est_quadrant_array_index (&tree->quadrants, zz);
+    }
+  }
+  P4EST_GLOBAL_PRODUCTIONF ("Benchmarking over %llu local quadrants,"
+                            " %d repetitions\n",
+                            (unsigned long long) quads->elem_count, reps);
+
+  if (quads->elem_count >= 2) {
+    bench_bits_run (quads, reps);
+  }
+
+  sc_array_destroy (quads);
+  p4est_destroy (p4est);
+  p4est_connectivity_destroy (conn);
+  sc_options_destroy (opt);
+
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
@@ -25,16 +25,32 @@
 #ifndef P4_TO_P8
 #include <p4est_bits.h>
 #include <p4est_extended.h>
+#include <p4est_ghost.h>
 #include <p4est_vtk.h>
 #else
 #include <p8est_bits.h>
 #include <p8est_extended.h>
+#include <p8est_ghost.h>
 #include <p8est_vtk.h>
 #endif
 #include <sc_options.h>
+#include <sc_statistics.h>
 
 /* #define BRICKS_VTK */
 
+typedef enum
+{
+  BRICKS_CREATE,
+  BRICKS_PARTITION,
+  BRICKS_BALANCE,
+  BRICKS_GHOST,
+  BRICKS_PARTITION_SENT,
+  BRICKS_BALANCE_SENT,
+  BRICKS_GHOST_SENT,
+  BRICKS_NUM_STATS
+}
+bricks_stats_t;
+
 static int          refine_level;
 static int          level_shift;
 
@@ -61,17 +77,46 @@ refine_fractal (p4est_t * p4est, p4est_topidx_t which_tree,
     );
 }
 
+/** Print the achieved fraction of node memory bandwidth for one phase.
+ * The traffic estimate is one read and one write of the global quadrant
+ * storage, which is a lower bound on what the phase actually moves; the
+ * reported fraction is thus conservative but portable across machines.
+ */
+static void
+bricks_roofline (const char *name, double elapsed,
+                 p4est_gloidx_t global_num_quadrants,
+                 double peak_bandwidth, int num_nodes)
+{
+  double              gbytes, achieved;
+
+  if (elapsed <= 0.) {
+    return;
+  }
+  gbytes = 2. * (double) global_num_quadrants *
+    (double) sizeof (p4est_quadrant_t) * 1e-9;
+  achieved = gbytes / elapsed;
+  P4EST_GLOBAL_PRODUCTIONF
+    ("Roofline %s %g GB/s achieved %.4f of %g GB/s peak on %d nodes\n",
+     name, achieved, achieved / (peak_bandwidth * (double) num_nodes),
+     peak_bandwidth, num_nodes);
+}
+
 static void
-run_bricks (sc_MPI_Comm mpicomm, int per, int l, int rlevel)
+run_bricks (sc_MPI_Comm mpicomm, int per, int l, int rlevel,
+            double peak_bandwidth, int ranks_per_node)
 {
   int                 mpiret;
   int                 tcount;
+  int                 num_nodes;
   double              elapsed_create, elapsed_partition, elapsed_balance;
+  double              elapsed_ghost;
+  sc_statinfo_t       stats[BRICKS_NUM_STATS];
 #ifdef BRICKS_VTK
   char                filename[BUFSIZ];
 #endif
   p4est_connectivity_t *conn;
   p4est_t            *p4est;
+  p4est_ghost_t      *ghost;
 
   P4EST_GLOBAL_PRODUCTIONF ("Run bricks on level %d/%d\n", l, rlevel);
   P4EST_ASSERT (l <= rlevel);
@@ -89,6 +134,7 @@ run_bricks (sc_MPI_Comm mpicomm, int per, int l, int rlevel)
   conn = p8est_connectivity_new_brick (tcount, tcount, tcount, per, per, per);
 #endif
   p4est = p4est_new_ext (mpicomm, conn, 0, rlevel - l, 1, 0, NULL, NULL);
+  p4est->inspect = P4EST_ALLOC_ZERO (p4est_inspect_t, 1);
 
   level_shift = 4;
   refine_level = rlevel - l + level_shift;
@@ -116,16 +162,58 @@ run_bricks (sc_MPI_Comm mpicomm, int per, int l, int rlevel)
 
   elapsed_balance += sc_MPI_Wtime ();
 
+  /* build the ghost layer */
+
+  mpiret = sc_MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  elapsed_ghost = -sc_MPI_Wtime ();
+
+  ghost = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+  p4est_ghost_destroy (ghost);
+
+  elapsed_ghost += sc_MPI_Wtime ();
+
   /* postprocessing */
 
-  P4EST_GLOBAL_PRODUCTIONF ("Timings %g %g %g\n", elapsed_create,
-                            elapsed_partition, elapsed_balance);
+  P4EST_GLOBAL_PRODUCTIONF ("Timings %g %g %g %g\n", elapsed_create,
+                            elapsed_partition, elapsed_balance,
+                            elapsed_ghost);
+
+  sc_stats_set1 (&stats[BRICKS_CREATE], elapsed_create, "Create");
+  sc_stats_set1 (&stats[BRICKS_PARTITION], elapsed_partition, "Partition");
+  sc_stats_set1 (&stats[BRICKS_BALANCE], elapsed_balance, "Balance");
+  sc_stats_set1 (&stats[BRICKS_GHOST], elapsed_ghost, "Ghost");
+  sc_stats_set1 (&stats[BRICKS_PARTITION_SENT],
+                 (double) p4est->inspect->partition_comm_sent,
+                 "Partition sent bytes");
+  sc_stats_set1 (&stats[BRICKS_BALANCE_SENT],
+                 (double) p4est->inspect->balance_comm_sent,
+                 "Balance sent bytes");
+  sc_stats_set1 (&stats[BRICKS_GHOST_SENT],
+                 (double) p4est->inspect->ghost_comm_sent,
+                 "Ghost sent bytes");
+  sc_stats_compute (mpicomm, BRICKS_NUM_STATS, stats);
+  sc_stats_print (p4est_package_id, SC_LP_STATISTICS,
+                  BRICKS_NUM_STATS, stats, 1, 1);
+
+  if (peak_bandwidth > 0.) {
+    num_nodes = (p4est->mpisize + ranks_per_node - 1) / ranks_per_node;
+    bricks_roofline ("create", stats[BRICKS_CREATE].max,
+                     p4est->global_num_quadrants, peak_bandwidth, num_nodes);
+    bricks_roofline ("partition", stats[BRICKS_PARTITION].max,
+                     p4est->global_num_quadrants, peak_bandwidth, num_nodes);
+    bricks_roofline ("balance", stats[BRICKS_BALANCE].max,
+                     p4est->global_num_quadrants, peak_bandwidth, num_nodes);
+    bricks_roofline ("ghost", stats[BRICKS_GHOST].max,
+                     p4est->global_num_quadrants, peak_bandwidth, num_nodes);
+  }
 
 #ifdef BRICKS_VTK
   snprintf (filename, BUFSIZ, "brick_%02d_%02d_B", rlevel, l);
   p4est_vtk_write_file (p4est, NULL, filename);
 #endif
 
+  P4EST_FREE (p4est->inspect);
   p4est_destroy (p4est);
   p4est_connectivity_destroy (conn);
 }
@@ -135,13 +223,20 @@ main (int argc, char **argv)
 {
   sc_MPI_Comm         mpicomm;
   int                 mpiret, retval;
+  int                 mpisize;
   int                 rlevel, l;
   int                 periodic;
+  int                 weak_count;
+  int                 ranks_per_node;
+  double              peak_bandwidth;
+  p4est_gloidx_t      target;
   sc_options_t       *opt;
 
   mpiret = sc_MPI_Init (&argc, &argv);
   SC_CHECK_MPI (mpiret);
   mpicomm = sc_MPI_COMM_WORLD;
+  mpiret = sc_MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
 
   sc_init (sc_MPI_COMM_WORLD, 1, 1, NULL, SC_LP_DEFAULT);
   p4est_init (NULL, SC_LP_DEFAULT);
@@ -151,14 +246,36 @@ main (int argc, char **argv)
                       "Upfront refinement level");
   sc_options_add_switch (opt, 'p', "periodic", &periodic,
                          "Periodic connectivity");
+  sc_options_add_int (opt, 'w', "weak-count", &weak_count, 0,
+                      "Quadrants per rank; overrides the level for"
+                      " weak scaling");
+  sc_options_add_double (opt, 'b', "bandwidth", &peak_bandwidth, 0.,
+                         "Peak node memory bandwidth in GB/s;"
+                         " enables roofline output");
+  sc_options_add_int (opt, 'n', "ranks-per-node", &ranks_per_node, 1,
+                      "Ranks per node for roofline output");
   retval = sc_options_parse (p4est_package_id, SC_LP_ERROR, opt, argc, argv);
-  if (retval == -1 || retval < argc) {
+  if (retval == -1 || retval < argc || ranks_per_node <= 0) {
     sc_options_print_usage (p4est_package_id, SC_LP_PRODUCTION, opt, NULL);
     sc_abort_collective ("Usage error");
   }
 
+  if (weak_count > 0) {
+    /* choose the smallest depth whose uniform part meets the target;
+       the same per-rank count then reproduces across machine sizes */
+    target = (p4est_gloidx_t) weak_count * (p4est_gloidx_t) mpisize;
+    for (rlevel = 0; ((p4est_gloidx_t) 1 << (P4EST_DIM * rlevel)) < target;
+         ++rlevel) {
+      SC_CHECK_ABORT (rlevel < P4EST_QMAXLEVEL, "Weak count too large");
+    }
+    P4EST_GLOBAL_PRODUCTIONF
+      ("Weak scaling %d quadrants per rank on %d ranks at level %d\n",
+       weak_count, mpisize, rlevel);
+  }
+
   for (l = 0; l <= rlevel; ++l) {
-    run_bricks (mpicomm, periodic, l, rlevel);
+    run_bricks (mpicomm, periodic, l, rlevel, peak_bandwidth,
+                ranks_per_node);
   }
 
   sc_options_destroy (opt);
@@ -0,0 +1,166 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Usage: p4est_ghost_bench [-l level] [-r reps]
+ *
+ * Benchmark the repeated-exchange steady state of the ghost layer.
+ * We build a uniformly refined forest once, create a full ghost layer,
+ * and then time p4est_ghost_exchange_data and p4est_ghost_exchange_custom
+ * over per-quadrant payload sizes from 8 bytes to 8 kilobytes.  The
+ * statistics output is compatible with timana.awk, so runs on different
+ * fabrics and rank counts can be compared directly.
+ */
+
+#ifndef P4_TO_P8
+#include <p4est_extended.h>
+#include <p4est_ghost.h>
+#else
+#include <p8est_extended.h>
+#include <p8est_ghost.h>
+#endif
+#include <sc_flops.h>
+#include <sc_statistics.h>
+#include <sc_options.h>
+
+/* payload sizes 8 << (2 * k) for k = 0 .. GHOST_BENCH_NUM_SIZES - 1 */
+#define GHOST_BENCH_NUM_SIZES   6
+#define GHOST_BENCH_NUM_STATS   (2 * GHOST_BENCH_NUM_SIZES)
+#define GHOST_BENCH_NAME_LENGTH 32
+
+int
+main (int argc, char **argv)
+{
+  sc_MPI_Comm         mpicomm;
+  int                 mpiret, retval;
+  int                 level, reps;
+  int                 k, r;
+  size_t              data_size;
+  size_t              zz;
+  char                names[GHOST_BENCH_NUM_STATS][GHOST_BENCH_NAME_LENGTH];
+  char               *mirror_payload;
+  char               *ghost_payload;
+  void              **mirror_data;
+  p4est_connectivity_t *conn;
+  p4est_t            *p4est;
+  p4est_ghost_t      *ghost;
+  sc_options_t       *opt;
+  sc_flopinfo_t       fi, snapshot;
+  sc_statinfo_t       stats[GHOST_BENCH_NUM_STATS];
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  opt = sc_options_new (argv[0]);
+  sc_options_add_int (opt, 'l', "level", &level, 5,
+                      "Uniform refinement level of the forest");
+  sc_options_add_int (opt, 'r', "reps", &reps, 16,
+                      "Repetitions per payload size");
+  retval = sc_options_parse (p4est_package_id, SC_LP_ERROR, opt, argc, argv);
+  if (retval == -1 || retval < argc) {
+    sc_options_print_usage (p4est_package_id, SC_LP_PRODUCTION, opt, NULL);
+    sc_abort_collective ("Usage error");
+  }
+
+  /* the forest and ghost layer are fixed over all payload sizes */
+#ifndef P4_TO_P8
+  conn = p4est_connectivity_new_unitsquare ();
+#else
+  conn = p8est_connectivity_new_unitcube ();
+#endif
+  p4est = p4est_new_ext (mpicomm, conn, 0, level, 1, 0, NULL, NULL);
+  ghost = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+
+  P4EST_GLOBAL_PRODUCTIONF ("Exchanging %llu ghosts and %llu mirrors,"
+                            " %d repetitions per size\n",
+                            (unsigned long long) ghost->ghosts.elem_count,
+                            (unsigned long long) ghost->mirrors.elem_count,
+                            reps);
+
+  /* allocate once at the largest payload size */
+  data_size = (size_t) 8 << (2 * (GHOST_BENCH_NUM_SIZES - 1));
+  mirror_payload =
+    P4EST_ALLOC_ZERO (char, data_size * ghost->mirrors.elem_count);
+  ghost_payload = P4EST_ALLOC (char, data_size * ghost->ghosts.elem_count);
+  mirror_data = P4EST_ALLOC (void *, ghost->mirrors.elem_count);
+
+  for (k = 0; k < GHOST_BENCH_NUM_SIZES; ++k) {
+    data_size = (size_t) 8 << (2 * k);
+
+    /* exchange out of the quadrant user data */
+    p4est_reset_data (p4est, data_size, NULL, NULL);
+    sc_flops_snap (&fi, &snapshot);
+    for (r = 0; r < reps; ++r) {
+      p4est_ghost_exchange_data (p4est, ghost, ghost_payload);
+    }
+    sc_flops_shot (&fi, &snapshot);
+    snprintf (names[2 * k], GHOST_BENCH_NAME_LENGTH,
+              "Ghost data %lluB", (unsigned long long) data_size);
+    sc_stats_set1 (&stats[2 * k], snapshot.iwtime / (double) reps,
+                   names[2 * k]);
+
+    /* exchange out of an application-owned mirror buffer */
+    for (zz = 0; zz < ghost->mirrors.elem_count; ++zz) {
+      mirror_data[zz] = mirror_payload + zz * data_size;
+    }
+    sc_flops_snap (&fi, &snapshot);
+    for (r = 0; r < reps; ++r) {
+      p4est_ghost_exchange_custom (p4est, ghost, data_size,
+                                   mirror_data, ghost_payload);
+    }
+    sc_flops_shot (&fi, &snapshot);
+    snprintf (names[2 * k + 1], GHOST_BENCH_NAME_LENGTH,
+              "Ghost custom %lluB", (unsigned long long) data_size);
+    sc_stats_set1 (&stats[2 * k + 1], snapshot.iwtime / (double) reps,
+                   names[2 * k + 1]);
+
+    P4EST_GLOBAL_VERBOSEF ("Done payload size %llu\n",
+                           (unsigned long long) data_size);
+  }
+
+  /* calculate and print timings */
+  sc_stats_compute (mpicomm, GHOST_BENCH_NUM_STATS, stats);
+  sc_stats_print (p4est_package_id, SC_LP_STATISTICS,
+                  GHOST_BENCH_NUM_STATS, stats, 1, 1);
+
+  P4EST_FREE (mirror_data);
+  P4EST_FREE (ghost_payload);
+  P4EST_FREE (mirror_payload);
+  p4est_ghost_destroy (ghost);
+  p4est_destroy (p4est);
+  p4est_connectivity_destroy (conn);
+  sc_options_destroy (opt);
+
+  /* clean up and exit */
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
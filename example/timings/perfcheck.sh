@@ -0,0 +1,81 @@
+#! /bin/sh
+
+# Run the canonical timings workloads and compare their phase timings
+# against a JSON baseline recorded on this machine.  On the first run
+# the baseline is written and the check passes; afterwards any phase
+# slower than the baseline by more than the tolerance fails the check.
+#
+# Usage: perfcheck.sh [bindir [tolerance_percent [baseline_dir]]]
+#
+# The baseline file name includes the machine profile (hostname) so
+# measurements from different machines are never compared against each
+# other.  Remove the baseline files to re-record after intended changes.
+
+BINDIR=${1:-.}
+TOLERANCE=${2:-25}
+BASEDIR=${3:-$BINDIR}
+
+PROFILE=`hostname | sed -e 's/[^A-Za-z0-9]/_/g'`
+STATUS=0
+
+for PROG in p4est_timings p8est_timings ; do
+	if test ! -x "$BINDIR/$PROG" ; then
+		continue
+	fi
+	if test "$PROG" = p4est_timings ; then
+		WORKLOADS="unit:8 periodic:8"
+	else
+		WORKLOADS="unit:5 periodic:5"
+	fi
+	for W in $WORKLOADS ; do
+		CONFIG=`echo $W | cut -d: -f1`
+		LEVEL=`echo $W | cut -d: -f2`
+		NAME="$PROG.$CONFIG.$LEVEL"
+		CURRENT="$BASEDIR/perfcheck.$PROFILE.$NAME.json"
+		BASELINE="$BASEDIR/perfcheck.$PROFILE.$NAME.baseline.json"
+		"$BINDIR/$PROG" -c "$CONFIG" -l "$LEVEL" \
+			--perf-json "$CURRENT" > /dev/null
+		if test $? -ne 0 ; then
+			echo "perfcheck: $NAME failed to run"
+			STATUS=1
+			continue
+		fi
+		if test ! -f "$BASELINE" ; then
+			echo "perfcheck: recording baseline for $NAME"
+			cp "$CURRENT" "$BASELINE"
+			continue
+		fi
+		awk -v tol="$TOLERANCE" -v name="$NAME" '
+			/"phases"/ { inphases = 1 ; next }
+			inphases && /}/ { inphases = 0 }
+			inphases {
+				if (split ($0, a, "\"") < 3) next
+				key = a[2]
+				val = a[3]
+				sub (/^[^0-9.eE+-]*/, "", val)
+				val = val + 0
+				if (NR == FNR) { base[key] = val ; next }
+				if (base[key] > 0 && \
+				    val > base[key] * (1 + tol / 100)) {
+					printf \
+	"perfcheck: %s phase %s regressed %.3gs -> %.3gs\n", \
+						name, key, base[key], val
+					bad = 1
+				}
+			}
+			END { exit bad }
+		' "$BASELINE" "$CURRENT"
+		if test $? -ne 0 ; then
+			STATUS=1
+		else
+			echo "perfcheck: $NAME within tolerance"
+		fi
+	done
+done
+
+if test $STATUS -ne 0 ; then
+	echo "perfcheck: FAILED"
+else
+	echo "perfcheck: passed"
+fi
+exit $STATUS
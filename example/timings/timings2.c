@@ -228,6 +228,40 @@ refine_fractal (p4est_t * p4est, p4est_topidx_t which_tree,
     );
 }
 
+/* indices of the timing phases recorded into a perfcheck baseline */
+static const int    timings_perf_phases[] = {
+  TIMINGS_REFINE, TIMINGS_BALANCE, TIMINGS_REBALANCE, TIMINGS_PARTITION,
+  TIMINGS_GHOSTS, TIMINGS_NODES, TIMINGS_REPARTITION, TIMINGS_LNODES, -1
+};
+
+/** Dump the computed phase averages as JSON for the perfcheck target. */
+static void
+timings_write_perf_json (const char *filename, const char *config_name,
+                         int mpisize, sc_statinfo_t * stats)
+{
+  const int          *pi;
+  int                 retval;
+  FILE               *file;
+
+  file = fopen (filename, "wb");
+  SC_CHECK_ABORTF (file != NULL, "Open file %s", filename);
+
+  fprintf (file, "{\n");
+  fprintf (file, "  \"program\": \"" P4EST_STRING "_timings\",\n");
+  fprintf (file, "  \"configuration\": \"%s\",\n", config_name);
+  fprintf (file, "  \"mpisize\": %d,\n", mpisize);
+  fprintf (file, "  \"level\": %d,\n", refine_level);
+  fprintf (file, "  \"phases\": {\n");
+  for (pi = timings_perf_phases; *pi >= 0; ++pi) {
+    fprintf (file, "    \"%s\": %.16g%s\n", stats[*pi].variable,
+             stats[*pi].average, pi[1] >= 0 ? "," : "");
+  }
+  fprintf (file, "  }\n}\n");
+
+  retval = fclose (file);
+  SC_CHECK_ABORTF (retval == 0, "Close file %s", filename);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -237,6 +271,7 @@ main (int argc, char **argv)
   unsigned            crc, gcrc;
   const char         *config_name;
   const char         *load_name;
+  const char         *perf_json_name;
   p4est_locidx_t     *quadrant_counts;
   p4est_gloidx_t      count_refined, count_balanced;
   p4est_gloidx_t      prev_quadrant, next_quadrant;
@@ -248,6 +283,7 @@ main (int argc, char **argv)
   p4est_lnodes_t     *lnodes;
   const timings_regression_t *r, *regression;
   timings_config_t    config;
+  p4est_level_statistics_t lstats;
   sc_statinfo_t       stats[TIMINGS_NUM_STATS];
   sc_flopinfo_t       fi, snapshot;
   mpi_context_t       mpi_context, *mpi = &mpi_context;
@@ -321,6 +357,8 @@ main (int argc, char **argv)
   sc_options_add_switch (opt, 0, "repartition-lnodes",
                          &repartition_lnodes,
                          "Repartition to load-balance lnodes");
+  sc_options_add_string (opt, 0, "perf-json", &perf_json_name, NULL,
+                         "Write phase timings to a JSON file");
 
   first_argc = sc_options_parse (p4est_package_id, SC_LP_DEFAULT,
                                  opt, argc, argv);
@@ -732,11 +770,32 @@ main (int argc, char **argv)
                             refine_level, (long long) count_refined,
                             (long long) count_balanced);
 
+  /* report the mesh shape alongside the times */
+  p4est_statistics_levels (p4est, &lstats);
+  for (i = lstats.global_minlevel; i <= lstats.global_maxlevel; ++i) {
+    P4EST_GLOBAL_STATISTICSF ("Level %2d quadrants %lld\n", i,
+                              (long long) lstats.global_per_level[i]);
+  }
+  P4EST_GLOBAL_STATISTICSF
+    ("Tree quadrants min %lld max %lld imbalance %.3g\n",
+     (long long) lstats.min_tree_quadrants,
+     (long long) lstats.max_tree_quadrants, lstats.tree_imbalance);
+  P4EST_GLOBAL_STATISTICSF
+    ("Rank quadrants min %lld max %lld imbalance %.3g\n",
+     (long long) lstats.min_rank_quadrants,
+     (long long) lstats.max_rank_quadrants, lstats.rank_imbalance);
+
   /* calculate and print timings */
   sc_stats_compute (mpi->mpicomm, TIMINGS_NUM_STATS, stats);
   sc_stats_print (p4est_package_id, SC_LP_STATISTICS,
                   TIMINGS_NUM_STATS, stats, 1, 1);
 
+  /* record the canonical phases for regression checking by perfcheck */
+  if (perf_json_name != NULL && mpi->mpirank == 0) {
+    timings_write_perf_json (perf_json_name, config_name, mpi->mpisize,
+                             stats);
+  }
+
   /* destroy the p4est and its connectivity structure */
   P4EST_FREE (quadrant_counts);
   P4EST_FREE (p4est->inspect);
@@ -0,0 +1,510 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Usage:
+ * p4est_tsearch [-l <LEVEL>] [-s <LEVEL-SHIFT>] [-N <NUM-POINTS>]
+ *               [-k <CLUSTERS>] [-R <CLUSTER-RADIUS>] [-S] [-V]
+ *
+ * NUM-POINTS determines how many points are positioned randomly and searched
+ * in the forest.  The domain is the unit square and the points are uniformly
+ * distributed unless CLUSTERS is positive, in which case they are drawn
+ * around that many uniformly placed cluster centers within CLUSTER-RADIUS.
+ * With -S the point count is swept in powers of four up to NUM-POINTS and
+ * the statistics are printed once per count, compatible with tsrana.awk.
+ *
+ * We compare three search strategies: one p4est_search call per point
+ * (Search_1), all points in one top-down pass (Search_N), and the sorted
+ * query stream of p4est_search_points_sorted (Search_S).
+ */
+
+#ifdef P4_TO_P8
+#error "This program is currently intended for 2D only"
+#else
+#include <p4est_bits.h>
+#include <p4est_extended.h>
+#include <p4est_search.h>
+#include <p4est_vtk.h>
+#endif
+#include <sc_flops.h>
+#include <sc_options.h>
+#include <sc_statistics.h>
+
+static int          refine_level, level_shift;
+
+typedef enum tsearch_stats
+{
+  TSEARCH_NEW,
+  TSEARCH_REFINE,
+  TSEARCH_BALANCE,
+  TSEARCH_PARTITION,
+  TSEARCH_SEARCH_1,
+  TSEARCH_SEARCH_N,
+  TSEARCH_SEARCH_S,
+  TSEARCH_NUM_STATS
+}
+tsearch_stats_t;
+
+typedef struct
+{
+  /* MPI related data */
+  sc_MPI_Comm         mpicomm;
+  int                 mpisize;
+  int                 mpirank;
+
+  /* global data for the program */
+  size_t              matches;
+  double              expected;
+  sc_array_t         *points;
+  int                 num_clusters;
+  double              cluster_radius;
+  int                 skip_1;
+
+  /* data for the currently active quadrant */
+  p4est_locidx_t      which_tree;
+  p4est_quadrant_t   *sq;
+  int                 is_leaf;
+  double              width;
+  double              qref[P4EST_DIM];
+}
+tsearch_global_t;
+
+static int
+refine_local_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                 p4est_quadrant_t * q)
+{
+  if ((int) q->level >= refine_level) {
+    return 0;
+  }
+  if ((int) q->level < refine_level - level_shift) {
+    return 1;
+  }
+
+  return which_tree == 0 && p4est_quadrant_child_id (q) == 0;
+}
+
+static int
+refine_fractal_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                   p4est_quadrant_t * q)
+{
+  int                 qid;
+
+  if ((int) q->level >= refine_level) {
+    return 0;
+  }
+  if ((int) q->level < refine_level - level_shift) {
+    return 1;
+  }
+
+  qid = p4est_quadrant_child_id (q);
+  return (qid == 0 || qid == 3);
+}
+
+typedef struct tsearch_point
+{
+  double              xy[P4EST_DIM];
+  p4est_locidx_t      lid;
+}
+tsearch_point_t;
+
+static int
+time_search_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                p4est_quadrant_t * q, p4est_locidx_t local_num, void *point)
+{
+  tsearch_global_t   *tsg = (tsearch_global_t *) p4est->user_pointer;
+  int                 j;
+  double              mlen;
+  tsearch_point_t    *t;
+
+  if (point == NULL) {
+    /* per-quadrant setup function */
+    mlen = 1. / P4EST_ROOT_LEN;
+    tsg->which_tree = which_tree;
+    tsg->sq = q;
+    tsg->is_leaf = local_num >= 0;
+    tsg->width = mlen * P4EST_QUADRANT_LEN (q->level);
+    tsg->qref[0] = q->x * mlen;
+    tsg->qref[1] = q->y * mlen;
+    return 1;
+  }
+  P4EST_ASSERT (tsg->sq == q);
+  P4EST_ASSERT (tsg->is_leaf == (local_num >= 0));
+
+  /* the unit square maps identically to reference coordinates */
+  t = (tsearch_point_t *) point;
+  for (j = 0; j < P4EST_DIM; ++j) {
+    if (t->xy[j] < tsg->qref[j] || t->xy[j] > tsg->qref[j] + tsg->width) {
+      return 0;
+    }
+  }
+  if (tsg->is_leaf) {
+    /* we have found a matching quadrant for this point */
+    ++tsg->matches;
+    t->lid = local_num;
+  }
+  return 1;
+}
+
+static int
+time_search_sorted_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                       p4est_quadrant_t * q, p4est_locidx_t local_num,
+                       void *point)
+{
+  tsearch_global_t   *tsg = (tsearch_global_t *) p4est->user_pointer;
+
+  P4EST_ASSERT (local_num >= 0);
+  ++tsg->matches;
+  return 1;
+}
+
+static void
+time_search_1 (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
+               sc_flopinfo_t * fi, sc_statinfo_t * stats)
+{
+  const double        expected = tsg->expected;
+  int                 mpiret;
+  long long           ll, gg;
+  size_t              zz;
+  sc_array_t          pview;
+  sc_flopinfo_t       snapshot;
+
+  /* search all points separately as the per-point baseline */
+
+  ll = 0;
+  sc_flops_snap (fi, &snapshot);
+  for (zz = 0; zz < znum_points; ++zz) {
+    tsg->matches = 0;
+    sc_array_init_view (&pview, tsg->points, zz, 1);
+    p4est_search (p4est, time_search_fn, time_search_fn, &pview);
+    ll += (long long) tsg->matches;
+  }
+  sc_flops_shot (fi, &snapshot);
+  sc_stats_set1 (&stats[TSEARCH_SEARCH_1], snapshot.iwtime, "Search_1");
+
+  mpiret = sc_MPI_Allreduce (&ll, &gg, 1, sc_MPI_LONG_LONG_INT, sc_MPI_SUM,
+                             tsg->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  P4EST_GLOBAL_STATISTICSF
+    ("Search_1 expected %lld found %lld of %lld error %.3g%%\n",
+     (long long) round (expected), gg, (long long) znum_points,
+     100. * fabs ((gg - expected) / SC_MAX (expected, 1.)));
+}
+
+static void
+time_search_N (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
+               sc_flopinfo_t * fi, sc_statinfo_t * stats)
+{
+  const double        expected = tsg->expected;
+  int                 mpiret;
+  long long           ll, gg;
+  sc_flopinfo_t       snapshot;
+
+  /* search all points in one top-down pass through the forest */
+
+  tsg->matches = 0;
+  sc_flops_snap (fi, &snapshot);
+  p4est_search (p4est, time_search_fn, time_search_fn, tsg->points);
+  sc_flops_shot (fi, &snapshot);
+  sc_stats_set1 (&stats[TSEARCH_SEARCH_N], snapshot.iwtime, "Search_N");
+  ll = (long long) tsg->matches;
+
+  mpiret = sc_MPI_Allreduce (&ll, &gg, 1, sc_MPI_LONG_LONG_INT, sc_MPI_SUM,
+                             tsg->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  P4EST_GLOBAL_STATISTICSF
+    ("Search_N expected %lld found %lld of %lld error %.3g%%\n",
+     (long long) round (expected), gg, (long long) znum_points,
+     100. * fabs ((gg - expected) / SC_MAX (expected, 1.)));
+}
+
+static void
+time_search_S (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
+               sc_flopinfo_t * fi, sc_statinfo_t * stats)
+{
+  const p4est_qcoord_t qmask =
+    ~(P4EST_QUADRANT_LEN (P4EST_QMAXLEVEL) - 1);
+  int                 mpiret;
+  long long           ll, gg;
+  size_t              zz;
+  p4est_qcoord_t      qc;
+  p4est_quadrant_t   *query;
+  sc_array_t         *queries;
+  tsearch_point_t    *t;
+  sc_flopinfo_t       snapshot;
+
+  /* convert the points into maximum-level quadrant queries */
+  queries = sc_array_new_size (sizeof (p4est_quadrant_t), znum_points);
+  for (zz = 0; zz < znum_points; ++zz) {
+    t = (tsearch_point_t *) sc_array_index (tsg->points, zz);
+    query = (p4est_quadrant_t *) sc_array_index (queries, zz);
+    P4EST_QUADRANT_INIT (query);
+    qc = (p4est_qcoord_t) (t->xy[0] * P4EST_ROOT_LEN);
+    query->x = SC_MIN (qc, P4EST_ROOT_LEN - 1) & qmask;
+    qc = (p4est_qcoord_t) (t->xy[1] * P4EST_ROOT_LEN);
+    query->y = SC_MIN (qc, P4EST_ROOT_LEN - 1) & qmask;
+    query->level = P4EST_QMAXLEVEL;
+    query->p.piggy3.which_tree = 0;
+    query->p.piggy3.local_num = (p4est_locidx_t) zz;
+  }
+
+  /* merge the sorted query stream against the linear quadrant storage */
+  tsg->matches = 0;
+  sc_flops_snap (fi, &snapshot);
+  p4est_search_points_sorted (p4est, time_search_sorted_fn, queries);
+  sc_flops_shot (fi, &snapshot);
+  sc_stats_set1 (&stats[TSEARCH_SEARCH_S], snapshot.iwtime, "Search_S");
+  ll = (long long) tsg->matches;
+  sc_array_destroy (queries);
+
+  mpiret = sc_MPI_Allreduce (&ll, &gg, 1, sc_MPI_LONG_LONG_INT, sc_MPI_SUM,
+                             tsg->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  /* the sorted search reports each point on exactly one process */
+  P4EST_GLOBAL_STATISTICSF
+    ("Search_S expected %lld found %lld of %lld\n",
+     (long long) znum_points, gg, (long long) znum_points);
+}
+
+static void
+time_search_all (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
+                 sc_flopinfo_t * fi, sc_statinfo_t * stats)
+{
+  int                 i, k;
+  size_t              zz;
+  double             *centers = NULL;
+  tsearch_point_t    *point;
+
+  /* the points are identical on all processors */
+  if (tsg->num_clusters > 0) {
+    centers = P4EST_ALLOC (double, P4EST_DIM * tsg->num_clusters);
+    for (i = 0; i < P4EST_DIM * tsg->num_clusters; ++i) {
+      centers[i] = rand () / (RAND_MAX + 1.);
+    }
+  }
+  tsg->points = sc_array_new_size (sizeof (tsearch_point_t), znum_points);
+  for (zz = 0; zz < znum_points; ++zz) {
+    point = (tsearch_point_t *) sc_array_index (tsg->points, zz);
+    if (centers == NULL) {
+      for (i = 0; i < P4EST_DIM; ++i) {
+        point->xy[i] = rand () / (RAND_MAX + 1.);
+      }
+    }
+    else {
+      k = rand () % tsg->num_clusters;
+      for (i = 0; i < P4EST_DIM; ++i) {
+        point->xy[i] = centers[P4EST_DIM * k + i] +
+          tsg->cluster_radius * (2. * (rand () / (RAND_MAX + 1.)) - 1.);
+        point->xy[i] = SC_MAX (point->xy[i], 0.);
+        point->xy[i] = SC_MIN (point->xy[i], 1. - 1e-12);
+      }
+    }
+    point->lid = -1;
+  }
+  if (centers != NULL) {
+    P4EST_FREE (centers);
+  }
+
+  /* the whole unit square is covered by the forest */
+  tsg->expected = (double) znum_points;
+
+  if (!tsg->skip_1) {
+    time_search_1 (tsg, p4est, znum_points, fi, stats);
+  }
+  else {
+    sc_stats_set1 (&stats[TSEARCH_SEARCH_1], 0., "Search_1");
+  }
+  time_search_N (tsg, p4est, znum_points, fi, stats);
+  time_search_S (tsg, p4est, znum_points, fi, stats);
+
+  sc_array_destroy (tsg->points);
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 first_argc;
+  int                 refine_local;
+  int                 write_vtk;
+  int                 num_clusters;
+  int                 sweep;
+  size_t              znum_points, zcur;
+  double              cluster_radius;
+  double              time_new, time_refine, time_balance, time_partition;
+  unsigned            crc;
+  p4est_gloidx_t      count_refined, count_balanced;
+  p4est_connectivity_t *connectivity;
+  p4est_t            *p4est;
+  sc_statinfo_t       stats[TSEARCH_NUM_STATS];
+  sc_flopinfo_t       fi, snapshot;
+  sc_options_t       *opt;
+  tsearch_global_t    tsgt, *tsg = &tsgt;
+  int                 skip_1;
+
+  /* initialize MPI */
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  tsg->mpicomm = sc_MPI_COMM_WORLD;
+  mpiret = sc_MPI_Comm_size (tsg->mpicomm, &tsg->mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (tsg->mpicomm, &tsg->mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  /* initialize p4est internals */
+  sc_init (tsg->mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+#ifndef P4EST_ENABLE_DEBUG
+  sc_set_log_defaults (NULL, NULL, SC_LP_STATISTICS);
+#endif
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  /* initialize global data */
+  srand (tsg->mpisize);
+
+  /* process command line arguments */
+  opt = sc_options_new (argv[0]);
+  sc_options_add_int (opt, 'l', "level", &refine_level, 0,
+                      "Refinement level");
+  sc_options_add_int (opt, 's', "level-shift", &level_shift, 4,
+                      "Refinement shift");
+  sc_options_add_bool (opt, 'L', "refine-local", &refine_local, 0,
+                       "Refine around one point");
+  sc_options_add_bool (opt, 'V', "write-vtk", &write_vtk, 0,
+                       "Write VTK files");
+  sc_options_add_size_t (opt, 'N', "num-points", &znum_points, 0,
+                         "Number of points");
+  sc_options_add_int (opt, 'k', "clusters", &num_clusters, 0,
+                      "Number of point clusters; 0 for uniform points");
+  sc_options_add_double (opt, 'R', "cluster-radius", &cluster_radius, .05,
+                         "Half width of each point cluster");
+  sc_options_add_switch (opt, 'S', "sweep", &sweep,
+                         "Sweep point counts in powers of four");
+  sc_options_add_switch (opt, 'm', "skip-1", &skip_1,
+                         "only test parallelized search");
+  first_argc = sc_options_parse (p4est_package_id, SC_LP_ERROR,
+                                 opt, argc, argv);
+  if (first_argc < 0 || first_argc != argc) {
+    sc_options_print_usage (p4est_package_id, SC_LP_ERROR, opt, NULL);
+    return 1;
+  }
+  sc_options_print_summary (p4est_package_id, SC_LP_PRODUCTION, opt);
+
+  tsg->num_clusters = num_clusters;
+  tsg->cluster_radius = cluster_radius;
+  tsg->skip_1 = skip_1;
+
+  /* start overall timing */
+  mpiret = sc_MPI_Barrier (tsg->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  sc_flops_start (&fi);
+
+  /* create connectivity and forest */
+  sc_flops_snap (&fi, &snapshot);
+  connectivity = p4est_connectivity_new_unitsquare ();
+  p4est = p4est_new_ext (tsg->mpicomm, connectivity,
+                         0, refine_level - level_shift, 1, 0, NULL, tsg);
+  sc_flops_shot (&fi, &snapshot);
+  time_new = snapshot.iwtime;
+  if (write_vtk) {
+    p4est_vtk_write_file (p4est, NULL, "tsearch_new");
+  }
+
+  /* time refine */
+  sc_flops_snap (&fi, &snapshot);
+  p4est_refine (p4est, 1,
+                refine_local ? refine_local_fn : refine_fractal_fn, NULL);
+  sc_flops_shot (&fi, &snapshot);
+  time_refine = snapshot.iwtime;
+  if (write_vtk) {
+    p4est_vtk_write_file (p4est, NULL, "tsearch_refined");
+  }
+  count_refined = p4est->global_num_quadrants;
+
+  /* time balance */
+  sc_flops_snap (&fi, &snapshot);
+  p4est_balance (p4est, P4EST_CONNECT_FULL, NULL);
+  sc_flops_shot (&fi, &snapshot);
+  time_balance = snapshot.iwtime;
+  if (write_vtk) {
+    p4est_vtk_write_file (p4est, NULL, "tsearch_balanced");
+  }
+  count_balanced = p4est->global_num_quadrants;
+  crc = p4est_checksum (p4est);
+
+  /* time a uniform partition */
+  sc_flops_snap (&fi, &snapshot);
+  p4est_partition (p4est, 0, NULL);
+  sc_flops_shot (&fi, &snapshot);
+  time_partition = snapshot.iwtime;
+  if (write_vtk) {
+    p4est_vtk_write_file (p4est, NULL, "tsearch_partitioned");
+  }
+  P4EST_ASSERT (crc == p4est_checksum (p4est));
+
+  /* run search timings, optionally sweeping the point count */
+  zcur = sweep ? 1 : znum_points;
+  for (;;) {
+    sc_stats_set1 (&stats[TSEARCH_NEW], time_new, "New");
+    sc_stats_set1 (&stats[TSEARCH_REFINE], time_refine, "Refine");
+    sc_stats_set1 (&stats[TSEARCH_BALANCE], time_balance, "Balance");
+    sc_stats_set1 (&stats[TSEARCH_PARTITION], time_partition, "Partition");
+
+    time_search_all (tsg, p4est, zcur, &fi, stats);
+
+    /* print status and checksum */
+    P4EST_GLOBAL_STATISTICSF
+      ("Processors %d level %d shift %d points %llu checksum 0x%08x\n",
+       tsg->mpisize, refine_level, level_shift,
+       (unsigned long long) zcur, crc);
+    P4EST_GLOBAL_STATISTICSF ("Level %d refined to %lld balanced to %lld\n",
+                              refine_level, (long long) count_refined,
+                              (long long) count_balanced);
+
+    /* calculate and print timings */
+    sc_stats_compute (tsg->mpicomm, TSEARCH_NUM_STATS, stats);
+    sc_stats_print (p4est_package_id, SC_LP_STATISTICS,
+                    TSEARCH_NUM_STATS, stats, 1, 1);
+
+    if (zcur >= znum_points) {
+      break;
+    }
+    zcur = SC_MIN (zcur * 4, znum_points);
+  }
+
+  /* destroy the p4est and its connectivity structure */
+  p4est_destroy (p4est);
+  p4est_connectivity_destroy (connectivity);
+
+  /* clean up and exit */
+  sc_options_destroy (opt);
+
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
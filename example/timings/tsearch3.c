@@ -24,11 +24,14 @@
 
 /*
  * Usage:
- * p8est_tsearch [-l <LEVEL>] [-s <LEVEL-SHIFT>] [-N <NUM-POINTS>] [-V]
+ * p8est_tsearch [-l <LEVEL>] [-s <LEVEL-SHIFT>] [-N <NUM-POINTS>]
+ *               [-k <CLUSTERS>] [-R <CLUSTER-RADIUS>] [-V]
  *
  * NUM-POINTS determines how many points are positioned randomly and searched
  * in the forest.  The domain is the spherical shell with radii 0.55 and 1 and
- * the points are uniformly distributed in the unit cube.
+ * the points are uniformly distributed in the unit cube unless CLUSTERS is
+ * positive, in which case they are drawn around that many uniformly placed
+ * cluster centers within CLUSTER-RADIUS.
  */
 
 #include <p4est_to_p8est.h>
@@ -58,6 +61,7 @@ typedef enum tsearch_stats
   TSEARCH_PARTITION,
   TSEARCH_SEARCH_1,
   TSEARCH_SEARCH_N,
+  TSEARCH_SEARCH_S,
   TSEARCH_NUM_STATS
 }
 tsearch_stats_t;
@@ -78,6 +82,8 @@ typedef struct
   sc_array_t         *points;
   int                 test_rays;
   int                 skip_1;
+  int                 num_clusters;
+  double              cluster_radius;
 
   /* data for the currently active quadrant */
   p4est_locidx_t      which_tree;
@@ -795,6 +801,108 @@ time_search_N (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
   }
 }
 
+static int
+time_search_sorted_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                       p4est_quadrant_t * q, p4est_locidx_t local_num,
+                       void *point)
+{
+  tsearch_global_t   *tsg = (tsearch_global_t *) p4est->user_pointer;
+
+  P4EST_ASSERT (local_num >= 0);
+  ++tsg->matches;
+  return 1;
+}
+
+/** Convert one physical point into a maximum-level quadrant query.
+ * \return          True if the point lies inside the shell and a tree
+ *                  containing it has been found, false otherwise.
+ */
+static int
+tsearch_point_to_query (tsearch_global_t * tsg, const double *xyz,
+                        p4est_quadrant_t * query)
+{
+  const p4est_qcoord_t qmask =
+    ~(P4EST_QUADRANT_LEN (P4EST_QMAXLEVEL) - 1);
+  int                 j;
+  p4est_topidx_t      tid;
+  double              r2;
+  double              ref[P4EST_DIM];
+  p4est_qcoord_t      qc[P4EST_DIM];
+
+  /* root level check to see if the point is contained in the shell */
+  r2 = xyz[0] * xyz[0] + xyz[1] * xyz[1] + xyz[2] * xyz[2];
+  if (r2 >= tsg->rout2 || r2 <= tsg->rin2) {
+    return 0;
+  }
+
+  /* identify a tree containing the point; boundary points match the
+   * first of the trees that share them, which is fine for a search */
+  for (tid = 0; tid < 24; ++tid) {
+    tsg->which_tree = tid;
+    if (physical_to_reference (tsg, xyz, ref)) {
+      /* shift x and y into the unit reference cube of this tree */
+      ref[0] += 1. - (double) (tid & 1);
+      ref[1] += 1. - (double) ((tid & 2) / 2);
+      for (j = 0; j < P4EST_DIM; ++j) {
+        qc[j] = (p4est_qcoord_t) (ref[j] * P4EST_ROOT_LEN);
+        qc[j] = SC_MIN (SC_MAX (qc[j], 0), P4EST_ROOT_LEN - 1) & qmask;
+      }
+      P4EST_QUADRANT_INIT (query);
+      query->x = qc[0];
+      query->y = qc[1];
+      query->z = qc[2];
+      query->level = P4EST_QMAXLEVEL;
+      query->p.piggy3.which_tree = tid;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void
+time_search_S (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
+               sc_flopinfo_t * fi, sc_statinfo_t * stats)
+{
+  const double        expected = tsg->expected;
+  int                 mpiret;
+  long long           ll, gg;
+  size_t              zz, zq;
+  p4est_quadrant_t    query;
+  sc_array_t         *queries;
+  tsearch_point_t    *t;
+  sc_flopinfo_t       snapshot;
+
+  /* convert the points into maximum-level quadrant queries */
+  queries = sc_array_new (sizeof (p4est_quadrant_t));
+  for (zz = zq = 0; zz < znum_points; ++zz) {
+    t = (tsearch_point_t *) sc_array_index (tsg->points, zz);
+    if (tsearch_point_to_query (tsg, t->xy, &query)) {
+      query.p.piggy3.local_num = (p4est_locidx_t) zz;
+      *(p4est_quadrant_t *) sc_array_push (queries) = query;
+      ++zq;
+    }
+  }
+
+  /* merge the sorted query stream against the linear quadrant storage */
+  tsg->matches = 0;
+  sc_flops_snap (fi, &snapshot);
+  p4est_search_points_sorted (p4est, time_search_sorted_fn, queries);
+  sc_flops_shot (fi, &snapshot);
+  sc_stats_set1 (&stats[TSEARCH_SEARCH_S], snapshot.iwtime, "Search_S");
+  ll = (long long) tsg->matches;
+  sc_array_destroy (queries);
+
+  mpiret = sc_MPI_Allreduce (&ll, &gg, 1, sc_MPI_LONG_LONG_INT, sc_MPI_SUM,
+                             tsg->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  /* the sorted search reports each contained point on one process */
+  P4EST_GLOBAL_STATISTICSF
+    ("Search_S expected %lld found %lld of %lld error %.3g%%\n",
+     (long long) round (expected), gg, (long long) zq,
+     100. * fabs ((gg - expected) / SC_MAX (expected, 1.)));
+}
+
 static void
 time_search_all (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
                  sc_flopinfo_t * fi, sc_statinfo_t * stats)
@@ -806,17 +914,52 @@ time_search_all (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
   ts_ray_t           *ray;
 
   if (!tsg->test_rays) {
+    double             *centers = NULL;
+    double              r2;
+    int                 k;
+    size_t              zinside = 0;
+
+    if (tsg->num_clusters > 0) {
+      centers = P4EST_ALLOC (double, P4EST_DIM * tsg->num_clusters);
+      for (i = 0; i < P4EST_DIM * tsg->num_clusters; ++i) {
+        centers[i] = 2. * (rand () / (RAND_MAX + 1.)) - 1.;
+      }
+    }
     tsg->points = sc_array_new_size (sizeof (tsearch_point_t), znum_points);
     for (zz = 0; zz < znum_points; ++zz) {
       point = (tsearch_point_t *) sc_array_index (tsg->points, zz);
-      for (i = 0; i < P4EST_DIM; ++i) {
-        point->xy[i] = 2. * (rand () / (RAND_MAX + 1.)) - 1.;
+      if (centers == NULL) {
+        for (i = 0; i < P4EST_DIM; ++i) {
+          point->xy[i] = 2. * (rand () / (RAND_MAX + 1.)) - 1.;
+        }
+      }
+      else {
+        k = rand () % tsg->num_clusters;
+        for (i = 0; i < P4EST_DIM; ++i) {
+          point->xy[i] = centers[P4EST_DIM * k + i] +
+            tsg->cluster_radius * (2. * (rand () / (RAND_MAX + 1.)) - 1.);
+          point->xy[i] = SC_MAX (point->xy[i], -1.);
+          point->xy[i] = SC_MIN (point->xy[i], 1.);
+        }
       }
       point->lid = -1;
+      r2 = point->xy[0] * point->xy[0] + point->xy[1] * point->xy[1]
+        + point->xy[2] * point->xy[2];
+      if (r2 < tsg->rout2 && r2 > tsg->rin2) {
+        ++zinside;
+      }
+    }
+    if (centers == NULL) {
+      ratio =
+        4. / 3. * M_PI * (pow (tsg->rout, 3.) - pow (tsg->rin, 3.)) / 8.;
+      tsg->expected = ratio * znum_points;
+    }
+    else {
+      /* the volume ratio does not apply to a clustered distribution;
+       * count the generated points that fall inside the shell instead */
+      tsg->expected = (double) zinside;
+      P4EST_FREE (centers);
     }
-
-    ratio = 4. / 3. * M_PI * (pow (tsg->rout, 3.) - pow (tsg->rin, 3.)) / 8.;
-    tsg->expected = ratio * znum_points;
   }
   else {
     tsg->points = sc_array_new_size (sizeof (ts_ray_t), znum_points);
@@ -907,6 +1050,12 @@ time_search_all (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
     sc_stats_set1 (&stats[TSEARCH_SEARCH_1], 0., "Search_1");
   }
   time_search_N (tsg, p4est, znum_points, fi, stats);
+  if (!tsg->test_rays) {
+    time_search_S (tsg, p4est, znum_points, fi, stats);
+  }
+  else {
+    sc_stats_set1 (&stats[TSEARCH_SEARCH_S], 0., "Search_S");
+  }
 
   sc_array_destroy (tsg->points);
   if (tsg->test_rays) {
@@ -923,6 +1072,8 @@ main (int argc, char **argv)
   int                 refine_local;
   int                 write_vtk;
   int                 test_rays;
+  int                 num_clusters;
+  double              cluster_radius;
   size_t              znum_points;
   unsigned            crc;
   p4est_gloidx_t      count_refined, count_balanced;
@@ -971,6 +1122,10 @@ main (int argc, char **argv)
                        "Write VTK files");
   sc_options_add_size_t (opt, 'N', "num-points", &znum_points, 0,
                          "Number of points");
+  sc_options_add_int (opt, 'k', "clusters", &num_clusters, 0,
+                      "Number of point clusters; 0 for uniform points");
+  sc_options_add_double (opt, 'R', "cluster-radius", &cluster_radius, .05,
+                         "Half width of each point cluster");
   sc_options_add_switch (opt, 'r', "rays", &test_rays,
                          "Test rays instead of points");
   sc_options_add_switch (opt, 'm', "skip-1", &skip_1,
@@ -985,6 +1140,8 @@ main (int argc, char **argv)
 
   tsg->test_rays = test_rays;
   tsg->skip_1 = skip_1;
+  tsg->num_clusters = num_clusters;
+  tsg->cluster_radius = cluster_radius;
 
   /* start overall timing */
   mpiret = sc_MPI_Barrier (tsg->mpicomm);
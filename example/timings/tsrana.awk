@@ -1,7 +1,7 @@
 #! /usr/bin/awk -f
 
 BEGIN {
-	print "# procs level shift refinelocal elements points Search_1 Search_N"
+	print "# procs level shift refinelocal elements points Search_1 Search_N Search_S"
 }
 /refine-local:/ {
 	if ($3 == "true") { refinelocal = 1 } else {refinelocal = 0 };
@@ -23,7 +23,7 @@ BEGIN {
 	elems = $9
 }
 /^\[p4est\] Summary =/ {
-	# Output runtimes for: Search_1 Search_N
-	printf "%d %d %d %d %d %d %g %g\n",
-	       procs, level, shift, refinelocal, elems, points, $9, $10
+	# Output runtimes for: Search_1 Search_N Search_S
+	printf "%d %d %d %d %d %d %g %g %g\n",
+	       procs, level, shift, refinelocal, elems, points, $9, $10, $11
 }
@@ -29,6 +29,7 @@
 #include <p8est_extended.h>
 #include <p8est_ghost.h>
 #include <p8est_io.h>
+#include <p8est_search.h>
 #else
 #include <p4est_algorithms.h>
 #include <p4est_bits.h>
@@ -36,9 +37,11 @@
 #include <p4est_extended.h>
 #include <p4est_ghost.h>
 #include <p4est_io.h>
+#include <p4est_search.h>
 #endif /* !P4_TO_P8 */
 #include <sc_io.h>
 #include <sc_notify.h>
+#include <sc_statistics.h>
 #include <sc_ranges.h>
 #include <sc_search.h>
 #ifdef P4EST_HAVE_ZLIB
@@ -60,6 +63,9 @@ typedef struct
   int                 recv_first_count, recv_second_count;
   int                 send_first_count, send_second_count;
   sc_array_t          send_first, send_second, recv_first, recv_second;
+  /* trimmed byte encodings of the above while a message is in flight */
+  sc_array_t          send_first_wire, send_second_wire;
+  sc_array_t          recv_first_wire, recv_second_wire;
 }
 p4est_balance_peer_t;
 
@@ -188,6 +194,78 @@ p4est_revision (p4est_t * p4est)
   return p4est->revision;
 }
 
+void
+p4est_statistics_levels (p4est_t * p4est, p4est_level_statistics_t * stats)
+{
+  const int           num_procs = p4est->mpisize;
+  int                 l;
+  int                 p;
+  p4est_topidx_t      nt;
+  const p4est_topidx_t num_trees = p4est->connectivity->num_trees;
+  p4est_tree_t       *tree;
+  p4est_gloidx_t      local_per_level[P4EST_MAXLEVEL + 1];
+  p4est_gloidx_t     *pertree;
+  p4est_gloidx_t      gcount;
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+#endif
+
+  P4EST_ASSERT (stats != NULL);
+
+  /* sum the per-level counters maintained with every tree */
+  memset (local_per_level, 0,
+          (P4EST_MAXLEVEL + 1) * sizeof (p4est_gloidx_t));
+  for (nt = p4est->first_local_tree; nt <= p4est->last_local_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    for (l = 0; l <= P4EST_QMAXLEVEL; ++l) {
+      local_per_level[l] += (p4est_gloidx_t) tree->quadrants_per_level[l];
+    }
+  }
+#ifdef P4EST_ENABLE_MPI
+  mpiret = MPI_Allreduce (local_per_level, stats->global_per_level,
+                          P4EST_MAXLEVEL + 1, P4EST_MPI_GLOIDX, MPI_SUM,
+                          p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+#else
+  memcpy (stats->global_per_level, local_per_level,
+          (P4EST_MAXLEVEL + 1) * sizeof (p4est_gloidx_t));
+#endif
+  stats->global_minlevel = P4EST_QMAXLEVEL;
+  stats->global_maxlevel = 0;
+  for (l = 0; l <= P4EST_QMAXLEVEL; ++l) {
+    if (stats->global_per_level[l] > 0) {
+      stats->global_minlevel = SC_MIN (stats->global_minlevel, l);
+      stats->global_maxlevel = SC_MAX (stats->global_maxlevel, l);
+    }
+  }
+
+  /* the per-process extremes come from the replicated partition array */
+  stats->min_rank_quadrants = p4est->global_num_quadrants;
+  stats->max_rank_quadrants = 0;
+  for (p = 0; p < num_procs; ++p) {
+    gcount = p4est->global_first_quadrant[p + 1] -
+      p4est->global_first_quadrant[p];
+    stats->min_rank_quadrants = SC_MIN (stats->min_rank_quadrants, gcount);
+    stats->max_rank_quadrants = SC_MAX (stats->max_rank_quadrants, gcount);
+  }
+  stats->rank_imbalance = (double) stats->max_rank_quadrants *
+    (double) num_procs / (double) p4est->global_num_quadrants;
+
+  /* the per-tree extremes take a second collective sum */
+  pertree = P4EST_ALLOC (p4est_gloidx_t, num_trees + 1);
+  p4est_comm_count_pertree (p4est, pertree);
+  stats->min_tree_quadrants = p4est->global_num_quadrants;
+  stats->max_tree_quadrants = 0;
+  for (nt = 0; nt < num_trees; ++nt) {
+    gcount = pertree[nt + 1] - pertree[nt];
+    stats->min_tree_quadrants = SC_MIN (stats->min_tree_quadrants, gcount);
+    stats->max_tree_quadrants = SC_MAX (stats->max_tree_quadrants, gcount);
+  }
+  stats->tree_imbalance = (double) stats->max_tree_quadrants *
+    (double) num_trees / (double) p4est->global_num_quadrants;
+  P4EST_FREE (pertree);
+}
+
 p4est_t            *
 p4est_new (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
            size_t data_size, p4est_init_t init_fn, void *user_pointer)
@@ -494,6 +572,115 @@ p4est_new_ext (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
   return p4est;
 }
 
+p4est_t            *
+p4est_new_replicated (p4est_connectivity_t * connectivity, int min_level,
+                      size_t data_size, p4est_init_t init_fn,
+                      void *user_pointer)
+{
+  /* on a one-process communicator the uniform construction fills the
+   * partition arrays from local knowledge and touches no collectives */
+  return p4est_new_ext (sc_MPI_COMM_SELF, connectivity, 0, min_level, 1,
+                        data_size, init_fn, user_pointer);
+}
+
+/** Recursively split one quadrant down to the mapped levels and append
+ * the resulting leaves to the tree in Morton order. */
+static void
+p4est_new_level_map_recursion (p4est_t * p4est, p4est_topidx_t which_tree,
+                               p4est_tree_t * tree,
+                               const p4est_quadrant_t * q,
+                               p4est_level_map_t level_fn,
+                               p4est_init_t init_fn)
+{
+  int                 i, l;
+  p4est_quadrant_t    c[P4EST_CHILDREN];
+  p4est_quadrant_t   *qp;
+
+  l = level_fn (p4est, which_tree, (p4est_quadrant_t *) q);
+  P4EST_ASSERT (l <= P4EST_QMAXLEVEL);
+  if (l <= (int) q->level) {
+    /* this region is fine enough: emit the leaf */
+    qp = p4est_quadrant_array_push (&tree->quadrants);
+    *qp = *q;
+    ++tree->quadrants_per_level[q->level];
+    tree->maxlevel = (int8_t) SC_MAX (tree->maxlevel, q->level);
+    p4est_quadrant_init_data (p4est, which_tree, qp, init_fn);
+    return;
+  }
+
+  p4est_quadrant_childrenv (q, c);
+  for (i = 0; i < P4EST_CHILDREN; ++i) {
+    p4est_new_level_map_recursion (p4est, which_tree, tree, &c[i],
+                                   level_fn, init_fn);
+  }
+}
+
+p4est_t            *
+p4est_new_from_level_map (sc_MPI_Comm mpicomm,
+                          p4est_connectivity_t * connectivity,
+                          size_t data_size, p4est_level_map_t level_fn,
+                          p4est_init_t init_fn, void *user_pointer)
+{
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  p4est_t            *p4est;
+  p4est_quadrant_t    root;
+  p4est_quadrant_t   *q;
+  sc_array_t         *tquadrants;
+
+  P4EST_GLOBAL_PRODUCTION ("Into " P4EST_STRING "_new_from_level_map\n");
+  p4est_log_indent_push ();
+  P4EST_ASSERT (level_fn != NULL);
+
+  /* the uniform level zero forest is partitioned at the granularity of
+   * whole trees, so local refinement cannot move partition boundaries */
+  p4est = p4est_new_ext (mpicomm, connectivity, 0, 0, 1,
+                         data_size, NULL, user_pointer);
+
+  /* build each local tree top-down in one pass */
+  p4est->local_num_quadrants = 0;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tquadrants = &tree->quadrants;
+    P4EST_ASSERT (tquadrants->elem_count == 1);
+
+    /* replace the root quadrant by the leaves selected by the map */
+    q = p4est_quadrant_array_index (tquadrants, 0);
+    root = *q;
+    p4est_quadrant_free_data (p4est, q);
+    --tree->quadrants_per_level[root.level];
+    sc_array_resize (tquadrants, 0);
+    p4est_new_level_map_recursion (p4est, jt, tree, &root,
+                                   level_fn, init_fn);
+    P4EST_ASSERT (tquadrants->elem_count > 0);
+
+    tree->quadrants_offset = p4est->local_num_quadrants;
+    p4est->local_num_quadrants += (p4est_locidx_t) tquadrants->elem_count;
+    P4EST_ASSERT (p4est_tree_is_sorted (tree));
+    P4EST_ASSERT (p4est_tree_is_complete (tree));
+
+    P4EST_VERBOSEF ("Level map tree %lld now %llu\n", (long long) jt,
+                    (unsigned long long) tquadrants->elem_count);
+  }
+  if (p4est->last_local_tree >= 0) {
+    for (jt = p4est->last_local_tree + 1; jt < connectivity->num_trees;
+         ++jt) {
+      tree = p4est_tree_array_index (p4est->trees, jt);
+      tree->quadrants_offset = p4est->local_num_quadrants;
+    }
+  }
+
+  /* compute global number of quadrants */
+  p4est_comm_count_quadrants (p4est);
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
+                            "_new_from_level_map with %lld total quadrants\n",
+                            (long long) p4est->global_num_quadrants);
+  return p4est;
+}
+
 void
 p4est_destroy (p4est_t * p4est)
 {
@@ -623,6 +810,143 @@ p4est_copy_ext (p4est_t * input, int copy_data, int duplicate_mpicomm)
   return p4est;
 }
 
+/** Read-only snapshot of a forest sharing unmutated trees. */
+struct p4est_view
+{
+  p4est_t            *source;   /**< the live forest */
+  long                revision; /**< its revision at snapshot time */
+  p4est_topidx_t      num_ltrees;       /**< number of local trees */
+  sc_array_t        **quadrants;        /**< per local tree: deep copy
+                                             of the quadrants, or NULL
+                                             while still sharing */
+  char              **payload;  /**< per local tree: copied user data
+                                     backing the copy, or NULL */
+};
+
+p4est_view_t       *
+p4est_view_new (p4est_t * p4est)
+{
+  p4est_view_t       *view;
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+
+  view = P4EST_ALLOC (p4est_view_t, 1);
+  view->source = p4est;
+  view->revision = p4est_revision (p4est);
+  view->num_ltrees = p4est->last_local_tree + 1 - p4est->first_local_tree;
+  if (view->num_ltrees < 0) {
+    /* this processor is empty */
+    view->num_ltrees = 0;
+  }
+
+  /* all trees start out shared with the source forest */
+  view->quadrants = P4EST_ALLOC_ZERO (sc_array_t *, view->num_ltrees);
+  view->payload = P4EST_ALLOC_ZERO (char *, view->num_ltrees);
+
+  return view;
+}
+
+void
+p4est_view_protect_tree (p4est_view_t * view, p4est_topidx_t which_tree)
+{
+  size_t              data_size;
+  size_t              zz, zcount;
+  p4est_topidx_t      zt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, *cq;
+  sc_array_t         *copy;
+  char               *cdata;
+
+  P4EST_ASSERT (view != NULL);
+  P4EST_ASSERT (view->source->first_local_tree <= which_tree &&
+                which_tree <= view->source->last_local_tree);
+  zt = which_tree - view->source->first_local_tree;
+
+  if (view->quadrants[zt] != NULL) {
+    /* this tree is already detached from the source */
+    return;
+  }
+
+  /* the shared storage must still be the snapshot's */
+  P4EST_ASSERT (p4est_revision (view->source) == view->revision);
+
+  tree = p4est_tree_array_index (view->source->trees, which_tree);
+  zcount = tree->quadrants.elem_count;
+  data_size = view->source->data_size;
+
+  copy = sc_array_new_count (sizeof (p4est_quadrant_t), zcount);
+  memcpy (copy->array, tree->quadrants.array,
+          zcount * sizeof (p4est_quadrant_t));
+  cdata = NULL;
+  if (data_size > 0) {
+    /* the payload moves into one block owned by the view */
+    cdata = P4EST_ALLOC (char, zcount * data_size);
+    for (zz = 0; zz < zcount; ++zz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      cq = p4est_quadrant_array_index (copy, zz);
+      cq->p.user_data = cdata + zz * data_size;
+      memcpy (cq->p.user_data, q->p.user_data, data_size);
+    }
+  }
+  view->quadrants[zt] = copy;
+  view->payload[zt] = cdata;
+}
+
+void
+p4est_view_protect (p4est_view_t * view)
+{
+  p4est_topidx_t      jt;
+
+  P4EST_ASSERT (view != NULL);
+
+  for (jt = view->source->first_local_tree;
+       jt <= view->source->last_local_tree; ++jt) {
+    p4est_view_protect_tree (view, jt);
+  }
+}
+
+sc_array_t         *
+p4est_view_tree (p4est_view_t * view, p4est_topidx_t which_tree)
+{
+  p4est_topidx_t      zt;
+  p4est_tree_t       *tree;
+
+  P4EST_ASSERT (view != NULL);
+  P4EST_ASSERT (view->source->first_local_tree <= which_tree &&
+                which_tree <= view->source->last_local_tree);
+  zt = which_tree - view->source->first_local_tree;
+
+  if (view->quadrants[zt] != NULL) {
+    return view->quadrants[zt];
+  }
+
+  /* a shared tree is only legal while the source is unmutated */
+  P4EST_ASSERT (p4est_revision (view->source) == view->revision);
+
+  tree = p4est_tree_array_index (view->source->trees, which_tree);
+  return &tree->quadrants;
+}
+
+void
+p4est_view_destroy (p4est_view_t * view)
+{
+  p4est_topidx_t      zt;
+
+  P4EST_ASSERT (view != NULL);
+
+  for (zt = 0; zt < view->num_ltrees; ++zt) {
+    if (view->quadrants[zt] != NULL) {
+      sc_array_destroy (view->quadrants[zt]);
+    }
+    if (view->payload[zt] != NULL) {
+      P4EST_FREE (view->payload[zt]);
+    }
+  }
+  P4EST_FREE (view->quadrants);
+  P4EST_FREE (view->payload);
+  P4EST_FREE (view);
+}
+
 void
 p4est_reset_data (p4est_t * p4est, size_t data_size,
                   p4est_init_t init_fn, void *user_pointer)
@@ -672,218 +996,722 @@ p4est_reset_data (p4est_t * p4est, size_t data_size,
 }
 
 void
-p4est_refine (p4est_t * p4est, int refine_recursive,
-              p4est_refine_t refine_fn, p4est_init_t init_fn)
+p4est_repack_data (p4est_t * p4est)
 {
-  p4est_refine_ext (p4est, refine_recursive, -1, refine_fn, init_fn, NULL);
+  size_t              zz;
+  p4est_topidx_t      jt;
+  void               *data;
+  p4est_quadrant_t   *q;
+  p4est_tree_t       *tree;
+  sc_array_t         *tquadrants;
+  sc_mempool_t       *newpool;
+
+  if (p4est->data_size == 0) {
+    P4EST_ASSERT (p4est->user_data_pool == NULL);
+    return;
+  }
+  P4EST_ASSERT (p4est->user_data_pool != NULL);
+
+  /* allocating from a fresh pool in quadrant order makes the data of
+   * Morton-adjacent quadrants address-adjacent again */
+  newpool = sc_mempool_new (p4est->data_size);
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tquadrants = &tree->quadrants;
+    for (zz = 0; zz < tquadrants->elem_count; ++zz) {
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      data = sc_mempool_alloc (newpool);
+      memcpy (data, q->p.user_data, p4est->data_size);
+      q->p.user_data = data;
+    }
+  }
+  sc_mempool_destroy (p4est->user_data_pool);
+  p4est->user_data_pool = newpool;
 }
 
 void
-p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
-                  p4est_refine_t refine_fn, p4est_init_t init_fn,
-                  p4est_replace_t replace_fn)
+p4est_memory_compact (p4est_t * p4est)
 {
-#ifdef P4EST_ENABLE_DEBUG
-  size_t              quadrant_pool_size, data_pool_size;
-#endif
-  int                 firsttime;
-  int                 i, maxlevel;
-  p4est_topidx_t      nt;
-  p4est_gloidx_t      old_gnq;
-  size_t              incount, current, restpos, movecount;
-  sc_list_t          *list;
+  size_t              zcount;
+  p4est_topidx_t      jt;
   p4est_tree_t       *tree;
-  p4est_quadrant_t   *q, *qalloc, *qpop;
-  p4est_quadrant_t   *c0, *c1, *c2, *c3;
-#ifdef P4_TO_P8
-  p4est_quadrant_t   *c4, *c5, *c6, *c7;
-#endif
   sc_array_t         *tquadrants;
-  p4est_quadrant_t   *family[8];
-  p4est_quadrant_t    parent, *pp = &parent;
+  sc_array_t          tight;
 
-  if (allowed_level < 0) {
-    allowed_level = P4EST_QMAXLEVEL;
+  /* rebuild each local tree's quadrant array with exact capacity */
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tquadrants = &tree->quadrants;
+    zcount = tquadrants->elem_count;
+    sc_array_init_size (&tight, sizeof (p4est_quadrant_t), zcount);
+    memcpy (tight.array, tquadrants->array,
+            zcount * sizeof (p4est_quadrant_t));
+    sc_array_reset (tquadrants);
+    memcpy (tquadrants, &tight, sizeof (sc_array_t));
   }
-  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING
-                            "_refine with %lld total quadrants,"
-                            " allowed level %d\n",
-                            (long long) p4est->global_num_quadrants,
-                            allowed_level);
-  p4est_log_indent_push ();
-  P4EST_ASSERT (p4est_is_valid (p4est));
-  P4EST_ASSERT (0 <= allowed_level && allowed_level <= P4EST_QMAXLEVEL);
-  P4EST_ASSERT (refine_fn != NULL);
 
-  /* remember input quadrant count; it will not decrease */
-  old_gnq = p4est->global_num_quadrants;
+  /* the quadrant pool holds no live elements between library calls;
+   * recreating it drops the chunks carved at the refinement peak */
+  P4EST_ASSERT (p4est->quadrant_pool->elem_count == 0);
+  sc_mempool_destroy (p4est->quadrant_pool);
+  p4est->quadrant_pool = sc_mempool_new (sizeof (p4est_quadrant_t));
 
-  /*
-     q points to a quadrant that is an array member
-     qalloc is a quadrant that has been allocated through quadrant_pool
-     qpop is a quadrant that has been allocated through quadrant_pool
-     never mix these two types of quadrant pointers
+  /* rebuilding the data pool drops its freed slots and old chunks
+   * and restores address adjacency along the Morton order */
+  p4est_repack_data (p4est);
 
-     The quadrant->pad8 field of list quadrants is interpreted as boolean
-     and set to true for quadrants that have already been refined.
-   */
-  list = sc_list_new (NULL);
-  p4est->local_num_quadrants = 0;
+  P4EST_ASSERT (p4est_is_valid (p4est));
+}
 
-  /* loop over all local trees */
-  for (nt = p4est->first_local_tree; nt <= p4est->last_local_tree; ++nt) {
-    tree = p4est_tree_array_index (p4est->trees, nt);
-    tree->quadrants_offset = p4est->local_num_quadrants;
-    tquadrants = &tree->quadrants;
-#ifdef P4EST_ENABLE_DEBUG
-    quadrant_pool_size = p4est->quadrant_pool->elem_count;
-    data_pool_size = 0;
-    if (p4est->user_data_pool != NULL) {
-      data_pool_size = p4est->user_data_pool->elem_count;
-    }
-#endif
+void
+p4est_numa_first_touch (p4est_t * p4est)
+{
+  p4est_topidx_t      jt;
+  p4est_topidx_t      first_local_tree = p4est->first_local_tree;
+  p4est_topidx_t      last_local_tree = p4est->last_local_tree;
 
-    /* initial log message for this tree */
-    P4EST_VERBOSEF ("Into refine tree %lld with %llu\n", (long long) nt,
-                    (unsigned long long) tquadrants->elem_count);
+  if (first_local_tree < 0) {
+    return;
+  }
 
-    /* reset the quadrant counters */
-    maxlevel = 0;
-    for (i = 0; i <= P4EST_QMAXLEVEL; ++i) {
-      tree->quadrants_per_level[i] = 0;
-    }
+  /* the static schedule pins each tree to the same thread that visits
+   * it in the volume pass of p4est_iterate_threaded */
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (static)
+#endif
+  for (jt = first_local_tree; jt <= last_local_tree; ++jt) {
+    p4est_tree_t       *tree;
+    sc_array_t         *tquadrants;
+    sc_array_t          moved;
 
-    /* run through the array to find first quadrant to be refined */
-    q = NULL;
-    incount = tquadrants->elem_count;
-    for (current = 0; current < incount; ++current) {
-      q = p4est_quadrant_array_index (tquadrants, current);
-      if (refine_fn (p4est, nt, q) && (int) q->level < allowed_level) {
-        break;
-      }
-      maxlevel = SC_MAX (maxlevel, (int) q->level);
-      ++tree->quadrants_per_level[q->level];
-    }
-    if (current == incount) {
-      /* no refinement occurs in this tree */
-      p4est->local_num_quadrants += incount;
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tquadrants = &tree->quadrants;
+    if (tquadrants->elem_count == 0) {
       continue;
     }
-    P4EST_ASSERT (q != NULL);
+    /* copying into fresh storage commits the pages on the touching
+     * thread's memory domain under the first-touch policy */
+    sc_array_init_size (&moved, sizeof (p4est_quadrant_t),
+                        tquadrants->elem_count);
+    memcpy (moved.array, tquadrants->array,
+            tquadrants->elem_count * sizeof (p4est_quadrant_t));
+    sc_array_reset (tquadrants);
+    *tquadrants = moved;
+  }
+}
 
-    /* now we have a quadrant to refine, prepend it to the list */
-    qalloc = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
-    *qalloc = *q;               /* never prepend array members directly */
-    qalloc->pad8 = 0;           /* this quadrant has not been refined yet */
-    (void) sc_list_prepend (list, qalloc);      /* only new quadrants */
+void
+p4est_advise_hugepages (p4est_t * p4est)
+{
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
 
-    P4EST_QUADRANT_INIT (&parent);
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    p4est_quadrant_array_advise_huge (&tree->quadrants);
+  }
+}
 
-    /*
-       current points to the next array member to write
-       restpos points to the next array member to read
-     */
-    restpos = current + 1;
-
-    /* run through the list and refine recursively */
-    firsttime = 1;
-    while (list->elem_count > 0) {
-      qpop = p4est_quadrant_list_pop (list);
-      if (firsttime ||
-          ((refine_recursive || !qpop->pad8) &&
-           refine_fn (p4est, nt, qpop) &&
-           (int) qpop->level < allowed_level)) {
-        firsttime = 0;
-        sc_array_resize (tquadrants,
-                         tquadrants->elem_count + P4EST_CHILDREN - 1);
+void
+p4est_reserve_quadrants (p4est_t * p4est)
+{
+  double              ratio;
+  size_t              zcount, znew;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  sc_array_t         *tquadrants;
+  p4est_inspect_t    *in = p4est->inspect;
 
-        if (replace_fn != NULL) {
-          /* do not free qpop's data yet: we will do this when the parent
-           * is replaced */
-          parent = *qpop;
+  if (in == NULL) {
+    return;
+  }
+  if (in->prealloc_quadrants > 0 &&
+      p4est->revision > in->prealloc_revision &&
+      p4est->local_num_quadrants > in->prealloc_quadrants) {
+    /* forecast the next count by replaying the growth measured since
+     * the last recorded revision, capped at uniform refinement */
+    ratio = (double) p4est->local_num_quadrants /
+      (double) in->prealloc_quadrants;
+    ratio = SC_MIN (ratio, (double) P4EST_CHILDREN);
+    for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+      tree = p4est_tree_array_index (p4est->trees, jt);
+      tquadrants = &tree->quadrants;
+      zcount = tquadrants->elem_count;
+      znew = (size_t) (ratio * (double) zcount);
+      if (znew > zcount) {
+        /* growing and shrinking back keeps the enlarged capacity, so
+         * the upcoming adaptation appends without fresh reallocation
+         * and the advice below covers the whole reserved range */
+        sc_array_resize (tquadrants, znew);
+        p4est_quadrant_array_advise_huge (tquadrants);
+        sc_array_resize (tquadrants, zcount);
+      }
+    }
+  }
+  /* record the current state as the base of the next forecast */
+  in->prealloc_revision = p4est->revision;
+  in->prealloc_quadrants = p4est->local_num_quadrants;
+}
+
+void
+p4est_inspect_report (p4est_t * p4est)
+{
+  p4est_inspect_t    *in = p4est->inspect;
+  sc_statinfo_t       stats[6];
+
+  if (in == NULL) {
+    return;
+  }
+  sc_stats_set1 (&stats[0], in->ghost_new_time, "Ghost new seconds");
+  sc_stats_set1 (&stats[1], in->partition_time, "Partition given seconds");
+  sc_stats_set1 (&stats[2], in->lnodes_time, "Lnodes new seconds");
+  sc_stats_set1 (&stats[3], in->iterate_time, "Iterate seconds");
+  sc_stats_set1 (&stats[4], (double) in->ghost_comm_sent,
+                 "Ghost bytes sent");
+  sc_stats_set1 (&stats[5], (double) in->partition_comm_sent,
+                 "Partition bytes sent");
+  sc_stats_compute (p4est->mpicomm, 6, stats);
+  sc_stats_print (p4est_package_id, SC_LP_STATISTICS, 6, stats, 1, 1);
+}
+
+void
+p4est_journal_log (p4est_t * p4est, p4est_topidx_t which_tree,
+                   const p4est_quadrant_t * first,
+                   const p4est_quadrant_t * last)
+{
+  sc_array_t         *journal;
+  p4est_journal_entry_t *entry;
+  p4est_quadrant_t    fd, ld;
+
+  if (p4est->inspect == NULL || (journal = p4est->inspect->journal) == NULL) {
+    return;
+  }
+  P4EST_ASSERT (journal->elem_size == sizeof (p4est_journal_entry_t));
+  P4EST_ASSERT (p4est_quadrant_is_extended (first));
+  P4EST_ASSERT (p4est_quadrant_is_extended (last));
+
+  p4est_quadrant_first_descendant (first, &fd, P4EST_QMAXLEVEL);
+  p4est_quadrant_last_descendant (last, &ld, P4EST_QMAXLEVEL);
+  P4EST_ASSERT (p4est_quadrant_compare (&fd, &ld) <= 0);
+
+  /* grow the previous entry in place when the new range connects to it */
+  if (journal->elem_count > 0) {
+    entry = (p4est_journal_entry_t *)
+      sc_array_index (journal, journal->elem_count - 1);
+    if (entry->revision == p4est->revision &&
+        entry->which_tree == which_tree &&
+        (p4est_quadrant_compare (&fd, &entry->last) <= 0 ||
+         p4est_quadrant_is_next (&entry->last, &fd))) {
+      if (p4est_quadrant_compare (&entry->last, &ld) < 0) {
+        entry->last = ld;
+      }
+      return;
+    }
+  }
+  entry = (p4est_journal_entry_t *) sc_array_push (journal);
+  entry->revision = p4est->revision;
+  entry->which_tree = which_tree;
+  entry->first = fd;
+  entry->last = ld;
+}
+
+p4est_workspace_t  *
+p4est_workspace_new (void)
+{
+  return P4EST_ALLOC_ZERO (p4est_workspace_t, 1);
+}
+
+void
+p4est_workspace_destroy (p4est_workspace_t * ws)
+{
+  size_t              zz;
+  sc_array_t         *qarray;
+
+  if (ws->refine_list != NULL) {
+    P4EST_ASSERT (ws->refine_list->elem_count == 0);
+    sc_list_destroy (ws->refine_list);
+  }
+  if (ws->balance_borders != NULL) {
+    for (zz = 0; zz < ws->balance_borders->elem_count; ++zz) {
+      qarray = (sc_array_t *) sc_array_index (ws->balance_borders, zz);
+      sc_array_reset (qarray);
+    }
+    sc_array_destroy (ws->balance_borders);
+  }
+  if (ws->iter_loop_args != NULL) {
+    P4EST_ASSERT (ws->iter_loop_args_destroy != NULL);
+    ws->iter_loop_args_destroy (ws->iter_loop_args);
+  }
+  P4EST_FREE (ws);
+}
+
+/** Return the workspace attached through the inspect structure, if any. */
+static p4est_workspace_t *
+p4est_workspace_get (p4est_t * p4est)
+{
+  return (p4est->inspect == NULL) ? NULL : p4est->inspect->workspace;
+}
+
+/** One recorded family replacement for the deferred callback mode. */
+typedef struct p4est_replace_entry
+{
+  int                 num_outgoing;     /**< 1 on refine, P4EST_CHILDREN
+                                             on coarsen */
+  p4est_quadrant_t    outgoing[P4EST_CHILDREN];  /**< replaced quadrants */
+  p4est_quadrant_t    incoming[P4EST_CHILDREN];  /**< replacing quadrants */
+}
+p4est_replace_entry_t;
+
+/** Invoke the replace callback for one recorded replacement.
+ * Incoming quadrants that are final leaves of \a tree are passed as
+ * pointers into the tree storage so that callback modifications stick;
+ * quadrants that only existed between recursive passes are passed as
+ * the recorded copies.
+ */
+static void
+p4est_replace_entry_invoke (p4est_t * p4est, p4est_topidx_t which_tree,
+                            p4est_tree_t * tree, p4est_replace_t replace_fn,
+                            p4est_replace_entry_t * e)
+{
+  int                 k, num_incoming;
+  ssize_t             sz;
+  p4est_quadrant_t   *q;
+  p4est_quadrant_t   *out[P4EST_CHILDREN], *in[P4EST_CHILDREN];
+
+  for (k = 0; k < e->num_outgoing; ++k) {
+    out[k] = &e->outgoing[k];
+  }
+  num_incoming = (e->num_outgoing == 1) ? P4EST_CHILDREN : 1;
+  for (k = 0; k < num_incoming; ++k) {
+    in[k] = &e->incoming[k];
+    sz = p4est_find_lower_bound (&tree->quadrants, in[k], 0);
+    if (sz >= 0) {
+      q = p4est_quadrant_array_index (&tree->quadrants, (size_t) sz);
+      if (p4est_quadrant_is_equal (q, in[k])) {
+        in[k] = q;
+      }
+    }
+  }
+  replace_fn (p4est, which_tree, e->num_outgoing, out, num_incoming, in);
+}
+
+/** Run the replace callback over all recorded replacements of one tree
+ * and release the user data of the outgoing quadrants afterwards.
+ * The log is truncated for reuse with the next tree.
+ */
+static void
+p4est_replace_log_flush (p4est_t * p4est, p4est_topidx_t which_tree,
+                         p4est_tree_t * tree, p4est_replace_t replace_fn,
+                         sc_array_t * rlog, int threaded)
+{
+  int                 k;
+  p4est_locidx_t      zi, zcount;
+  p4est_replace_entry_t *e;
+
+  zcount = (p4est_locidx_t) rlog->elem_count;
+  if (threaded) {
+#pragma omp parallel for schedule (dynamic) private (e)
+    for (zi = 0; zi < zcount; ++zi) {
+      e = (p4est_replace_entry_t *) sc_array_index (rlog, (size_t) zi);
+      p4est_replace_entry_invoke (p4est, which_tree, tree, replace_fn, e);
+    }
+  }
+  else {
+    for (zi = 0; zi < zcount; ++zi) {
+      e = (p4est_replace_entry_t *) sc_array_index (rlog, (size_t) zi);
+      p4est_replace_entry_invoke (p4est, which_tree, tree, replace_fn, e);
+    }
+  }
+
+  /* the user data pool is not thread safe; free serially afterwards */
+  for (zi = 0; zi < zcount; ++zi) {
+    e = (p4est_replace_entry_t *) sc_array_index (rlog, (size_t) zi);
+    for (k = 0; k < e->num_outgoing; ++k) {
+      p4est_quadrant_free_data (p4est, &e->outgoing[k]);
+    }
+  }
+  sc_array_resize (rlog, 0);
+}
+
+void
+p4est_refine (p4est_t * p4est, int refine_recursive,
+              p4est_refine_t refine_fn, p4est_init_t init_fn)
+{
+  p4est_refine_ext (p4est, refine_recursive, -1, refine_fn, init_fn, NULL);
+}
+
+void
+p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
+                  p4est_refine_t refine_fn, p4est_init_t init_fn,
+                  p4est_replace_t replace_fn)
+{
+#ifdef P4EST_ENABLE_DEBUG
+  size_t              quadrant_pool_size, data_pool_size;
+#endif
+  int                 firsttime;
+  int                 i, maxlevel;
+  p4est_topidx_t      nt;
+  p4est_gloidx_t      old_gnq;
+  size_t              incount, current, restpos, movecount;
+  size_t              zz, zout, zpredict;
+  int8_t             *rflags;
+  sc_list_t          *list;
+  p4est_workspace_t  *ws;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, *qalloc, *qpop;
+  p4est_quadrant_t   *c0, *c1, *c2, *c3;
+#ifdef P4_TO_P8
+  p4est_quadrant_t   *c4, *c5, *c6, *c7;
+#endif
+  sc_array_t         *tquadrants;
+  p4est_quadrant_t   *family[8];
+  p4est_quadrant_t    parent, *pp = &parent;
+  size_t              zbudget, zused, zsplit;
+  int                 dorefine, budget_hit;
+  int                 rthreaded;
+  sc_array_t         *rlog;
+  p4est_replace_entry_t *re;
+
+  if (allowed_level < 0) {
+    allowed_level = P4EST_QMAXLEVEL;
+  }
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING
+                            "_refine with %lld total quadrants,"
+                            " allowed level %d\n",
+                            (long long) p4est->global_num_quadrants,
+                            allowed_level);
+  p4est_log_indent_push ();
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (0 <= allowed_level && allowed_level <= P4EST_QMAXLEVEL);
+  P4EST_ASSERT (refine_fn != NULL);
+
+  /* remember input quadrant count; it will not decrease */
+  old_gnq = p4est->global_num_quadrants;
+
+  /* an attached memory budget stops refinement before it overruns */
+  zbudget = zused = zsplit = 0;
+  budget_hit = 0;
+  if (p4est->inspect != NULL && p4est->inspect->memory_budget > 0) {
+    zbudget = p4est->inspect->memory_budget;
+    zused = p4est_memory_used (p4est);
+    zsplit = (P4EST_CHILDREN - 1) *
+      (sizeof (p4est_quadrant_t) + p4est->data_size);
+  }
+
+  /* in deferred mode the replace callbacks run batched per tree */
+  rlog = NULL;
+  rthreaded = 0;
+  if (replace_fn != NULL && p4est->inspect != NULL &&
+      p4est->inspect->replace_defer) {
+    rlog = sc_array_new (sizeof (p4est_replace_entry_t));
+    rthreaded = p4est->inspect->replace_defer > 1;
+  }
+
+  /*
+     q points to a quadrant that is an array member
+     qalloc is a quadrant that has been allocated through quadrant_pool
+     qpop is a quadrant that has been allocated through quadrant_pool
+     never mix these two types of quadrant pointers
+
+     The quadrant->pad8 field of list quadrants is interpreted as boolean
+     and set to true for quadrants that have already been refined.
+   */
+  ws = p4est_workspace_get (p4est);
+  if (ws != NULL) {
+    if (ws->refine_list == NULL) {
+      ws->refine_list = sc_list_new (NULL);
+    }
+    list = ws->refine_list;
+    P4EST_ASSERT (list->elem_count == 0);
+  }
+  else {
+    list = sc_list_new (NULL);
+  }
+  p4est->local_num_quadrants = 0;
+
+  /* loop over all local trees */
+  for (nt = p4est->first_local_tree; nt <= p4est->last_local_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    tree->quadrants_offset = p4est->local_num_quadrants;
+    tquadrants = &tree->quadrants;
+#ifdef P4EST_ENABLE_DEBUG
+    quadrant_pool_size = p4est->quadrant_pool->elem_count;
+    data_pool_size = 0;
+    if (p4est->user_data_pool != NULL) {
+      data_pool_size = p4est->user_data_pool->elem_count;
+    }
+#endif
+
+    /* initial log message for this tree */
+    P4EST_VERBOSEF ("Into refine tree %lld with %llu\n", (long long) nt,
+                    (unsigned long long) tquadrants->elem_count);
+
+    /* reset the quadrant counters */
+    maxlevel = 0;
+    for (i = 0; i <= P4EST_QMAXLEVEL; ++i) {
+      tree->quadrants_per_level[i] = 0;
+    }
+
+    /* run through the array to find first quadrant to be refined */
+    q = NULL;
+    incount = tquadrants->elem_count;
+    for (current = 0; current < incount; ++current) {
+      q = p4est_quadrant_array_index (tquadrants, current);
+      if (refine_fn (p4est, nt, q) && (int) q->level < allowed_level) {
+        break;
+      }
+      maxlevel = SC_MAX (maxlevel, (int) q->level);
+      ++tree->quadrants_per_level[q->level];
+    }
+    if (current == incount) {
+      /* no refinement occurs in this tree */
+      p4est->local_num_quadrants += incount;
+      continue;
+    }
+    P4EST_ASSERT (q != NULL);
+
+    if (!refine_recursive && (replace_fn == NULL || rlog != NULL)) {
+      /* Without recursion one scan of the flags yields the exact output
+       * count.  Grow the quadrant array a single time and write every
+       * child directly to its final position, filling from the back so
+       * that input quadrants are read before they are overwritten. */
+      zpredict = incount;
+      rflags = P4EST_ALLOC (int8_t, incount - current);
+      for (zz = current; zz < incount; ++zz) {
+        q = p4est_quadrant_array_index (tquadrants, zz);
+        dorefine = (zz == current ||
+                    (refine_fn (p4est, nt, q) &&
+                     (int) q->level < allowed_level));
+        if (dorefine && zbudget > 0) {
+          if (budget_hit || zused + zsplit > zbudget) {
+            /* refuse this split and report instead of running out */
+            if (!budget_hit) {
+              P4EST_NOTICEF ("Refinement stopped by memory budget"
+                             " of %llu bytes\n",
+                             (unsigned long long) zbudget);
+              p4est->inspect->memory_budget_hit = 1;
+              budget_hit = 1;
+            }
+            dorefine = 0;
+          }
+          else {
+            zused += zsplit;
+          }
         }
-        else {
-          p4est_quadrant_free_data (p4est, qpop);
+        if (dorefine) {
+          p4est_journal_log (p4est, nt, q, q);
+          zpredict += P4EST_CHILDREN - 1;
         }
-        c0 = qpop;
-        c1 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
-        c2 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
-        c3 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
-
+        rflags[zz - current] = (int8_t) dorefine;
+      }
+      sc_array_resize (tquadrants, zpredict);
+
+      zout = zpredict;
+      for (zz = incount; zz > current; --zz) {
+        q = p4est_quadrant_array_index (tquadrants, zz - 1);
+        if (!rflags[zz - 1 - current]) {
+          /* this leaf survives: move it to its output slot */
+          *p4est_quadrant_array_index (tquadrants, --zout) = *q;
+          maxlevel = SC_MAX (maxlevel, (int) q->level);
+          ++tree->quadrants_per_level[q->level];
+          continue;
+        }
+        parent = *q;
+        zout -= P4EST_CHILDREN;
+        c0 = p4est_quadrant_array_index (tquadrants, zout);
+        c1 = c0 + 1;
+        c2 = c0 + 2;
+        c3 = c0 + 3;
 #ifdef P4_TO_P8
-        c4 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
-        c5 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
-        c6 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
-        c7 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
+        c4 = c0 + 4;
+        c5 = c0 + 5;
+        c6 = c0 + 6;
+        c7 = c0 + 7;
 
-        p8est_quadrant_children (qpop, c0, c1, c2, c3, c4, c5, c6, c7);
+        p8est_quadrant_children (pp, c0, c1, c2, c3, c4, c5, c6, c7);
 #else
-        p4est_quadrant_children (qpop, c0, c1, c2, c3);
+        p4est_quadrant_children (pp, c0, c1, c2, c3);
 #endif
         p4est_quadrant_init_data (p4est, nt, c0, init_fn);
         p4est_quadrant_init_data (p4est, nt, c1, init_fn);
         p4est_quadrant_init_data (p4est, nt, c2, init_fn);
         p4est_quadrant_init_data (p4est, nt, c3, init_fn);
-        c0->pad8 = c1->pad8 = c2->pad8 = c3->pad8 = 1;
-
 #ifdef P4_TO_P8
         p4est_quadrant_init_data (p4est, nt, c4, init_fn);
         p4est_quadrant_init_data (p4est, nt, c5, init_fn);
         p4est_quadrant_init_data (p4est, nt, c6, init_fn);
         p4est_quadrant_init_data (p4est, nt, c7, init_fn);
-        c4->pad8 = c5->pad8 = c6->pad8 = c7->pad8 = 1;
+#endif
+        maxlevel = SC_MAX (maxlevel, (int) parent.level + 1);
+        tree->quadrants_per_level[parent.level + 1] +=
+          (p4est_locidx_t) P4EST_CHILDREN;
+        if (replace_fn == NULL) {
+          p4est_quadrant_free_data (p4est, pp);
+        }
+        else {
+          /* record the replacement; the callback runs after the pass */
+          re = (p4est_replace_entry_t *) sc_array_push (rlog);
+          re->num_outgoing = 1;
+          re->outgoing[0] = parent;
+          for (i = 0; i < P4EST_CHILDREN; ++i) {
+            re->incoming[i] = c0[i];
+          }
+        }
+      }
+      P4EST_ASSERT (zout == current);
+      P4EST_FREE (rflags);
+      current = tquadrants->elem_count;
+      restpos = incount;
+    }
+    else {
+      /* now we have a quadrant to refine, prepend it to the list */
+      qalloc = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
+      *qalloc = *q;             /* never prepend array members directly */
+      qalloc->pad8 = 0;         /* this quadrant has not been refined yet */
+      (void) sc_list_prepend (list, qalloc);    /* only new quadrants */
+
+      P4EST_QUADRANT_INIT (&parent);
+
+      /*
+         current points to the next array member to write
+         restpos points to the next array member to read
+       */
+      restpos = current + 1;
+
+      /* run through the list and refine recursively */
+      firsttime = 1;
+      while (list->elem_count > 0) {
+        qpop = p4est_quadrant_list_pop (list);
+        dorefine = (firsttime ||
+                    ((refine_recursive || !qpop->pad8) &&
+                     refine_fn (p4est, nt, qpop) &&
+                     (int) qpop->level < allowed_level));
+        if (dorefine && zbudget > 0) {
+          if (budget_hit || zused + zsplit > zbudget) {
+            /* refuse this split and report instead of running out */
+            if (!budget_hit) {
+              P4EST_NOTICEF ("Refinement stopped by memory budget"
+                             " of %llu bytes\n",
+                             (unsigned long long) zbudget);
+              p4est->inspect->memory_budget_hit = 1;
+              budget_hit = 1;
+            }
+            dorefine = 0;
+          }
+          else {
+            zused += zsplit;
+          }
+        }
+        if (dorefine) {
+          firsttime = 0;
+          p4est_journal_log (p4est, nt, qpop, qpop);
+          sc_array_resize (tquadrants,
+                           tquadrants->elem_count + P4EST_CHILDREN - 1);
+
+          if (replace_fn != NULL) {
+            /* do not free qpop's data yet: we will do this when the parent
+             * is replaced */
+            parent = *qpop;
+          }
+          else {
+            p4est_quadrant_free_data (p4est, qpop);
+          }
+          c0 = qpop;
+          c1 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
+          c2 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
+          c3 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
 
-        (void) sc_list_prepend (list, c7);
-        (void) sc_list_prepend (list, c6);
-        (void) sc_list_prepend (list, c5);
-        (void) sc_list_prepend (list, c4);
+#ifdef P4_TO_P8
+          c4 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
+          c5 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
+          c6 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
+          c7 = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
+
+          p8est_quadrant_children (qpop, c0, c1, c2, c3, c4, c5, c6, c7);
+#else
+          p4est_quadrant_children (qpop, c0, c1, c2, c3);
 #endif
-        (void) sc_list_prepend (list, c3);
-        (void) sc_list_prepend (list, c2);
-        (void) sc_list_prepend (list, c1);
-        (void) sc_list_prepend (list, c0);
+          p4est_quadrant_init_data (p4est, nt, c0, init_fn);
+          p4est_quadrant_init_data (p4est, nt, c1, init_fn);
+          p4est_quadrant_init_data (p4est, nt, c2, init_fn);
+          p4est_quadrant_init_data (p4est, nt, c3, init_fn);
+          c0->pad8 = c1->pad8 = c2->pad8 = c3->pad8 = 1;
 
-        if (replace_fn != NULL) {
-          /* in family mode we always call the replace callback right
-           * away */
-          family[0] = c0;
-          family[1] = c1;
-          family[2] = c2;
-          family[3] = c3;
 #ifdef P4_TO_P8
-          family[4] = c4;
-          family[5] = c5;
-          family[6] = c6;
-          family[7] = c7;
+          p4est_quadrant_init_data (p4est, nt, c4, init_fn);
+          p4est_quadrant_init_data (p4est, nt, c5, init_fn);
+          p4est_quadrant_init_data (p4est, nt, c6, init_fn);
+          p4est_quadrant_init_data (p4est, nt, c7, init_fn);
+          c4->pad8 = c5->pad8 = c6->pad8 = c7->pad8 = 1;
+
+          (void) sc_list_prepend (list, c7);
+          (void) sc_list_prepend (list, c6);
+          (void) sc_list_prepend (list, c5);
+          (void) sc_list_prepend (list, c4);
 #endif
-          replace_fn (p4est, nt, 1, &pp, P4EST_CHILDREN, family);
-          p4est_quadrant_free_data (p4est, &parent);
-        }
-      }
-      else {
-        /* need to make room in the array to store this new quadrant */
-        if (restpos < incount && current == restpos) {
-          movecount = SC_MIN (incount - restpos, number_toread_quadrants);
-          while (movecount > 0) {
-            q = p4est_quadrant_array_index (tquadrants, restpos);
-            qalloc = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
-            *qalloc = *q;       /* never append array members directly */
-            qalloc->pad8 = 0;   /* has not been refined yet */
-            (void) sc_list_append (list, qalloc);       /* only new quadrants */
-            --movecount;
-            ++restpos;
+          (void) sc_list_prepend (list, c3);
+          (void) sc_list_prepend (list, c2);
+          (void) sc_list_prepend (list, c1);
+          (void) sc_list_prepend (list, c0);
+
+          if (replace_fn != NULL) {
+            family[0] = c0;
+            family[1] = c1;
+            family[2] = c2;
+            family[3] = c3;
+#ifdef P4_TO_P8
+            family[4] = c4;
+            family[5] = c5;
+            family[6] = c6;
+            family[7] = c7;
+#endif
+            if (rlog == NULL) {
+              /* in family mode we call the replace callback right away */
+              replace_fn (p4est, nt, 1, &pp, P4EST_CHILDREN, family);
+              p4est_quadrant_free_data (p4est, &parent);
+            }
+            else {
+              /* record the replacement; the callback runs after the pass */
+              re = (p4est_replace_entry_t *) sc_array_push (rlog);
+              re->num_outgoing = 1;
+              re->outgoing[0] = parent;
+              for (i = 0; i < P4EST_CHILDREN; ++i) {
+                re->incoming[i] = *family[i];
+              }
+            }
           }
         }
+        else {
+          /* need to make room in the array to store this new quadrant */
+          if (restpos < incount && current == restpos) {
+            movecount = SC_MIN (incount - restpos, number_toread_quadrants);
+            while (movecount > 0) {
+              q = p4est_quadrant_array_index (tquadrants, restpos);
+              qalloc = p4est_quadrant_mempool_alloc (p4est->quadrant_pool);
+              *qalloc = *q;     /* never append array members directly */
+              qalloc->pad8 = 0; /* has not been refined yet */
+              (void) sc_list_append (list, qalloc);     /* only new quadrants */
+              --movecount;
+              ++restpos;
+            }
+          }
 
-        /* store new quadrant and update counters */
-        q = p4est_quadrant_array_index (tquadrants, current);
-        *q = *qpop;
-        maxlevel = SC_MAX (maxlevel, (int) qpop->level);
-        ++tree->quadrants_per_level[qpop->level];
-        ++current;
-        sc_mempool_free (p4est->quadrant_pool, qpop);
+          /* store new quadrant and update counters */
+          q = p4est_quadrant_array_index (tquadrants, current);
+          *q = *qpop;
+          maxlevel = SC_MAX (maxlevel, (int) qpop->level);
+          ++tree->quadrants_per_level[qpop->level];
+          ++current;
+          sc_mempool_free (p4est->quadrant_pool, qpop);
+        }
       }
     }
+
+    /* in deferred mode run the batched replace phase for this tree */
+    if (rlog != NULL && rlog->elem_count > 0) {
+      p4est_replace_log_flush (p4est, nt, tree, replace_fn, rlog, rthreaded);
+    }
+
     tree->maxlevel = (int8_t) maxlevel;
     p4est->local_num_quadrants += tquadrants->elem_count;
 
@@ -909,7 +1737,14 @@ p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
     }
   }
 
-  sc_list_destroy (list);
+  /* the list is empty again; a workspace keeps it for the next call */
+  P4EST_ASSERT (list->elem_count == 0);
+  if (ws == NULL) {
+    sc_list_destroy (list);
+  }
+  if (rlog != NULL) {
+    sc_array_destroy (rlog);
+  }
 
   /* compute global number of quadrants */
   p4est_comm_count_quadrants (p4est);
@@ -925,38 +1760,233 @@ p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
                             (long long) p4est->global_num_quadrants);
 }
 
-void
-p4est_coarsen (p4est_t * p4est, int coarsen_recursive,
-               p4est_coarsen_t coarsen_fn, p4est_init_t init_fn)
+/** Expand one leaf into the output array, splitting it down to
+ * \a target_level wherever it intersects the range [\a rlo, \a rhi].
+ * Both range bounds are given as descendants of level P4EST_QMAXLEVEL.
+ */
+static void
+p4est_refine_range_expand (p4est_t * p4est, p4est_tree_t * tree,
+                           p4est_topidx_t jt, const p4est_quadrant_t * q,
+                           const p4est_quadrant_t * rlo,
+                           const p4est_quadrant_t * rhi,
+                           int target_level, sc_array_t * out,
+                           p4est_init_t init_fn, p4est_replace_t replace_fn)
 {
-  p4est_coarsen_ext (p4est, coarsen_recursive, 0, coarsen_fn, init_fn, NULL);
+  int                 i;
+  p4est_quadrant_t    fd, ld, parent;
+  p4est_quadrant_t    c[P4EST_CHILDREN];
+  p4est_quadrant_t   *cp[P4EST_CHILDREN], *qp;
+
+  p4est_quadrant_first_descendant (q, &fd, P4EST_QMAXLEVEL);
+  p4est_quadrant_last_descendant (q, &ld, P4EST_QMAXLEVEL);
+  if ((int) q->level >= target_level ||
+      p4est_quadrant_compare (&ld, rlo) < 0 ||
+      p4est_quadrant_compare (&fd, rhi) > 0) {
+    /* outside the range or already fine enough */
+    qp = p4est_quadrant_array_push (out);
+    *qp = *q;
+    return;
+  }
+
+  /* split this quadrant and recurse into the intersecting children */
+  parent = *q;
+  p4est_quadrant_childrenv (&parent, c);
+  tree->quadrants_per_level[parent.level] -= 1;
+  tree->quadrants_per_level[c[0].level] += P4EST_CHILDREN;
+  for (i = 0; i < P4EST_CHILDREN; ++i) {
+    cp[i] = &c[i];
+    p4est_quadrant_init_data (p4est, jt, &c[i], init_fn);
+  }
+  if (replace_fn != NULL) {
+    qp = &parent;
+    replace_fn (p4est, jt, 1, &qp, P4EST_CHILDREN, cp);
+  }
+  p4est_quadrant_free_data (p4est, &parent);
+  for (i = 0; i < P4EST_CHILDREN; ++i) {
+    p4est_refine_range_expand (p4est, tree, jt, &c[i], rlo, rhi,
+                               target_level, out, init_fn, replace_fn);
+  }
 }
 
 void
-p4est_coarsen_ext (p4est_t * p4est,
-                   int coarsen_recursive, int callback_orphans,
-                   p4est_coarsen_t coarsen_fn, p4est_init_t init_fn,
-                   p4est_replace_t replace_fn)
+p4est_refine_ranges (p4est_t * p4est, int num_ranges,
+                     const p4est_refine_range_t * ranges,
+                     p4est_init_t init_fn, p4est_replace_t replace_fn)
 {
-#ifdef P4EST_ENABLE_DEBUG
-  size_t              data_pool_size;
-#endif
-  int                 i, maxlevel;
-  int                 isfamily;
-  size_t              zz;
-  size_t              incount, removed;
-  size_t              window, start, length, cidz;
-  p4est_locidx_t      num_quadrants, prev_offset;
+  int                 k, i, maxlevel;
+  size_t              zz, incount, wlen, olen;
+  ssize_t             lo, hi;
   p4est_topidx_t      jt;
+  p4est_locidx_t      lq;
   p4est_gloidx_t      old_gnq;
   p4est_tree_t       *tree;
-  p4est_quadrant_t   *c[P4EST_CHILDREN];
-  p4est_quadrant_t   *cfirst, *clast;
+  p4est_quadrant_t    rq, rlo, rhi, cld;
+  p4est_quadrant_t   *q;
+  const p4est_refine_range_t *r;
+  sc_array_t          out;
   sc_array_t         *tquadrants;
-  p4est_quadrant_t    qtemp;
 
   P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING
-                            "_coarsen with %lld total quadrants\n",
+                            "_refine_ranges with %lld total quadrants\n",
+                            (long long) p4est->global_num_quadrants);
+  p4est_log_indent_push ();
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (num_ranges >= 0);
+  P4EST_ASSERT (num_ranges == 0 || ranges != NULL);
+
+  /* remember input quadrant count; it will not decrease */
+  old_gnq = p4est->global_num_quadrants;
+
+  for (k = 0; k < num_ranges; ++k) {
+    r = ranges + k;
+    P4EST_ASSERT (0 <= r->which_tree &&
+                  r->which_tree < p4est->connectivity->num_trees);
+    P4EST_ASSERT (0 < r->level && r->level <= P4EST_QMAXLEVEL);
+    P4EST_ASSERT (r->first_id <= r->last_id);
+
+    /* ranges outside the local quadrant window are free to skip */
+    if (r->which_tree < p4est->first_local_tree ||
+        r->which_tree > p4est->last_local_tree) {
+      continue;
+    }
+    tree = p4est_tree_array_index (p4est->trees, r->which_tree);
+    tquadrants = &tree->quadrants;
+    incount = tquadrants->elem_count;
+    if (incount == 0) {
+      continue;
+    }
+
+    /* normalize the range to descendants of maximum level */
+    p4est_quadrant_set_morton (&rq, (int) r->level, r->first_id);
+    p4est_quadrant_first_descendant (&rq, &rlo, P4EST_QMAXLEVEL);
+    p4est_quadrant_set_morton (&rq, (int) r->level, r->last_id);
+    p4est_quadrant_last_descendant (&rq, &rhi, P4EST_QMAXLEVEL);
+
+    /* locate the window of leaves intersecting the range */
+    lo = p4est_find_lower_bound (tquadrants, &rlo, 0);
+    if (lo < 0) {
+      lo = (ssize_t) incount;
+    }
+    if (lo > 0) {
+      /* the preceding leaf may still contain the range start */
+      q = p4est_quadrant_array_index (tquadrants, (size_t) (lo - 1));
+      p4est_quadrant_last_descendant (q, &cld, P4EST_QMAXLEVEL);
+      if (p4est_quadrant_compare (&cld, &rlo) >= 0) {
+        --lo;
+      }
+    }
+    hi = p4est_find_higher_bound (tquadrants, &rhi, incount - 1);
+    if (hi < 0 || hi < lo) {
+      continue;
+    }
+    wlen = (size_t) (hi - lo + 1);
+    p4est_journal_log (p4est, r->which_tree,
+                       p4est_quadrant_array_index (tquadrants, (size_t) lo),
+                       p4est_quadrant_array_index (tquadrants, (size_t) hi));
+
+    /* expand the intersecting leaves into a scratch array */
+    sc_array_init (&out, sizeof (p4est_quadrant_t));
+    for (zz = (size_t) lo; zz <= (size_t) hi; ++zz) {
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      p4est_refine_range_expand (p4est, tree, r->which_tree, q,
+                                 &rlo, &rhi, (int) r->level, &out,
+                                 init_fn, replace_fn);
+    }
+    olen = out.elem_count;
+    P4EST_ASSERT (olen >= wlen);
+
+    /* splice the expanded window back into the tree */
+    if (olen != wlen) {
+      sc_array_resize (tquadrants, incount + olen - wlen);
+      memmove (tquadrants->array +
+               ((size_t) lo + olen) * sizeof (p4est_quadrant_t),
+               tquadrants->array +
+               ((size_t) hi + 1) * sizeof (p4est_quadrant_t),
+               (incount - (size_t) hi - 1) * sizeof (p4est_quadrant_t));
+    }
+    memcpy (tquadrants->array + (size_t) lo * sizeof (p4est_quadrant_t),
+            out.array, olen * sizeof (p4est_quadrant_t));
+    sc_array_reset (&out);
+
+    /* update the maximum level of this tree */
+    maxlevel = 0;
+    for (i = 0; i <= P4EST_QMAXLEVEL; ++i) {
+      P4EST_ASSERT (tree->quadrants_per_level[i] >= 0);
+      if (tree->quadrants_per_level[i] > 0) {
+        maxlevel = i;
+      }
+    }
+    tree->maxlevel = (int8_t) maxlevel;
+    P4EST_ASSERT (p4est_tree_is_sorted (tree));
+    P4EST_ASSERT (p4est_tree_is_complete (tree));
+  }
+
+  /* recompute local quadrant counts and tree offsets */
+  lq = 0;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tree->quadrants_offset = lq;
+    lq += (p4est_locidx_t) tree->quadrants.elem_count;
+  }
+  if (p4est->last_local_tree >= 0) {
+    for (; jt < p4est->connectivity->num_trees; ++jt) {
+      tree = p4est_tree_array_index (p4est->trees, jt);
+      tree->quadrants_offset = lq;
+    }
+  }
+  p4est->local_num_quadrants = lq;
+
+  /* compute global number of quadrants */
+  p4est_comm_count_quadrants (p4est);
+  P4EST_ASSERT (p4est->global_num_quadrants >= old_gnq);
+  if (old_gnq != p4est->global_num_quadrants) {
+    ++p4est->revision;
+  }
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
+                            "_refine_ranges with %lld total quadrants\n",
+                            (long long) p4est->global_num_quadrants);
+}
+
+void
+p4est_coarsen (p4est_t * p4est, int coarsen_recursive,
+               p4est_coarsen_t coarsen_fn, p4est_init_t init_fn)
+{
+  p4est_coarsen_ext (p4est, coarsen_recursive, 0, coarsen_fn, init_fn, NULL);
+}
+
+void
+p4est_coarsen_ext (p4est_t * p4est,
+                   int coarsen_recursive, int callback_orphans,
+                   p4est_coarsen_t coarsen_fn, p4est_init_t init_fn,
+                   p4est_replace_t replace_fn)
+{
+#ifdef P4EST_ENABLE_DEBUG
+  size_t              data_pool_size;
+#endif
+  int                 i, maxlevel;
+  int                 isfamily;
+  size_t              zz;
+  size_t              incount, removed;
+  size_t              window, start, length, cidz;
+  size_t              scancount;
+  int8_t             *family_scan;
+  p4est_locidx_t      num_quadrants, prev_offset;
+  p4est_topidx_t      jt;
+  p4est_gloidx_t      old_gnq;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *c[P4EST_CHILDREN];
+  p4est_quadrant_t   *cfirst, *clast;
+  sc_array_t         *tquadrants;
+  p4est_quadrant_t    qtemp;
+  int                 rthreaded;
+  sc_array_t         *rlog;
+  p4est_replace_entry_t *re;
+
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING
+                            "_coarsen with %lld total quadrants\n",
                             (long long) p4est->global_num_quadrants);
   p4est_log_indent_push ();
   P4EST_ASSERT (p4est_is_valid (p4est));
@@ -967,6 +1997,15 @@ p4est_coarsen_ext (p4est_t * p4est,
 
   P4EST_QUADRANT_INIT (&qtemp);
 
+  /* in deferred mode the replace callbacks run batched per tree */
+  rlog = NULL;
+  rthreaded = 0;
+  if (replace_fn != NULL && p4est->inspect != NULL &&
+      p4est->inspect->replace_defer) {
+    rlog = sc_array_new (sizeof (p4est_replace_entry_t));
+    rthreaded = p4est->inspect->replace_defer > 1;
+  }
+
   /* loop over all local trees */
   prev_offset = 0;
   for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
@@ -991,23 +2030,46 @@ p4est_coarsen_ext (p4est_t * p4est,
 
     /* run through the array and coarsen recursively */
     incount = tquadrants->elem_count;
-    while (window + P4EST_CHILDREN + length <= incount) {
+
+    /* mark all family starts in a single pass over the quadrant array */
+    family_scan = NULL;
+    scancount = 1;
+    if (!callback_orphans && incount >= P4EST_CHILDREN) {
+      family_scan = P4EST_ALLOC (int8_t, incount);
+      scancount = p4est_quadrant_family_scan
+        (p4est_quadrant_array_index (tquadrants, 0), incount, family_scan);
+    }
+
+    while (scancount > 0 && window + P4EST_CHILDREN + length <= incount) {
       P4EST_ASSERT (window < start);
 
       cidz = incount;
       isfamily = 1;
-      for (zz = 0; zz < P4EST_CHILDREN; ++zz) {
-        c[zz] = (window + zz < start) ?
-          p4est_quadrant_array_index (tquadrants, window + zz) :
-          p4est_quadrant_array_index (tquadrants, window + length + zz);
-
-        if (zz != (size_t) p4est_quadrant_child_id (c[zz])) {
+      if (family_scan != NULL && length == 0) {
+        /* the window lies in unmodified storage; consult the scan */
+        if (family_scan[window]) {
+          for (zz = 0; zz < P4EST_CHILDREN; ++zz) {
+            c[zz] = p4est_quadrant_array_index (tquadrants, window + zz);
+          }
+        }
+        else {
           isfamily = 0;
-          if (callback_orphans) {
-            c[1] = NULL;
-            (void) coarsen_fn (p4est, jt, c);
+        }
+      }
+      else {
+        for (zz = 0; zz < P4EST_CHILDREN; ++zz) {
+          c[zz] = (window + zz < start) ?
+            p4est_quadrant_array_index (tquadrants, window + zz) :
+            p4est_quadrant_array_index (tquadrants, window + length + zz);
+
+          if (zz != (size_t) p4est_quadrant_child_id (c[zz])) {
+            isfamily = 0;
+            if (callback_orphans) {
+              c[1] = NULL;
+              (void) coarsen_fn (p4est, jt, c);
+            }
+            break;
           }
-          break;
         }
       }
       /* in a complete tree, the only way P4EST_CHILDREN consecutive quadrants
@@ -1029,6 +2091,7 @@ p4est_coarsen_ext (p4est_t * p4est,
           c[0] = &qtemp;
         }
         p4est_quadrant_parent (c[0], cfirst);
+        p4est_journal_log (p4est, jt, cfirst, cfirst);
         p4est_quadrant_init_data (p4est, jt, cfirst, init_fn);
         tree->quadrants_per_level[cfirst->level] += 1;
         p4est->local_num_quadrants -= P4EST_CHILDREN - 1;
@@ -1039,9 +2102,20 @@ p4est_coarsen_ext (p4est_t * p4est,
         length += P4EST_CHILDREN - 1;
 
         if (replace_fn != NULL) {
-          replace_fn (p4est, jt, P4EST_CHILDREN, c, 1, &cfirst);
-          for (zz = 0; zz < P4EST_CHILDREN; zz++) {
-            p4est_quadrant_free_data (p4est, c[zz]);
+          if (rlog == NULL) {
+            replace_fn (p4est, jt, P4EST_CHILDREN, c, 1, &cfirst);
+            for (zz = 0; zz < P4EST_CHILDREN; zz++) {
+              p4est_quadrant_free_data (p4est, c[zz]);
+            }
+          }
+          else {
+            /* record the replacement; the callback runs after the pass */
+            re = (p4est_replace_entry_t *) sc_array_push (rlog);
+            re->num_outgoing = P4EST_CHILDREN;
+            for (zz = 0; zz < P4EST_CHILDREN; zz++) {
+              re->outgoing[zz] = *c[zz];
+            }
+            re->incoming[0] = *cfirst;
           }
         }
       }
@@ -1062,6 +2136,8 @@ p4est_coarsen_ext (p4est_t * p4est,
       }
     }
 
+    P4EST_FREE (family_scan);
+
     /* adjust final array size */
     if (length > 0) {
       for (zz = start + length; zz < incount; ++zz) {
@@ -1081,6 +2157,11 @@ p4est_coarsen_ext (p4est_t * p4est,
       }
     }
 
+    /* in deferred mode run the batched replace phase for this tree */
+    if (rlog != NULL && rlog->elem_count > 0) {
+      p4est_replace_log_flush (p4est, jt, tree, replace_fn, rlog, rthreaded);
+    }
+
     /* compute maximum level */
     maxlevel = 0;
     num_quadrants = 0;
@@ -1115,6 +2196,9 @@ p4est_coarsen_ext (p4est_t * p4est,
       tree->quadrants_offset = p4est->local_num_quadrants;
     }
   }
+  if (rlog != NULL) {
+    sc_array_destroy (rlog);
+  }
 
   /* compute global number of quadrants */
   p4est_comm_count_quadrants (p4est);
@@ -1130,2405 +2214,5477 @@ p4est_coarsen_ext (p4est_t * p4est,
                             (long long) p4est->global_num_quadrants);
 }
 
-/** Check if the insulation layer of a quadrant overlaps anybody.
- * If yes, the quadrant itself is scheduled for sending.
- * Both quadrants are in the receiving tree's coordinates.
- * \param [in]  qtree       Tree id of the receiving tree.
- * \param [in]  inter_tree  Boolean flag to specify inter-tree communication.
- * \param [in]  q           The quadrant to be sent if there is overlap.
- * \param [in]  insul       An insulation quadrant of \a q.
- * \param [in,out]  first_peer  Lowest peer, will be updated.
- * \param [in,out]  last_peer   Highest peer, will be updated.
- */
-static void
-p4est_balance_schedule (p4est_t * p4est, p4est_balance_peer_t * peers,
-                        p4est_topidx_t qtree, int inter_tree,
-                        const p4est_quadrant_t * q,
-                        const p4est_quadrant_t * insul,
-                        int *first_peer, int *last_peer)
+void
+p4est_coarsen_batch (p4est_t * p4est, p4est_coarsen_batch_t coarsen_fn,
+                     p4est_init_t init_fn, p4est_replace_t replace_fn)
 {
-  const int           rank = p4est->mpirank;
-  int                 found;
-  int                 back, pos;
-  int                 owner, first_owner, last_owner;
-  p4est_gloidx_t     *global_first_quadrant = p4est->global_first_quadrant;
-  p4est_quadrant_t    ld, *s;
-  p4est_balance_peer_t *peer;
+#ifdef P4EST_ENABLE_DEBUG
+  size_t              data_pool_size;
+#endif
+  int                 i, maxlevel;
+  int                 isfamily;
+  size_t              zz, read, write;
+  size_t              incount, removed;
+  p4est_locidx_t      num_quadrants, prev_offset;
+  p4est_locidx_t      num_families, fam;
+  p4est_locidx_t     *family_first;
+  int8_t             *coarsen_flags;
+  p4est_topidx_t      jt;
+  p4est_gloidx_t      old_gnq;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *c[P4EST_CHILDREN];
+  p4est_quadrant_t    fq[P4EST_CHILDREN];
+  p4est_quadrant_t   *cfirst, *q;
+  sc_array_t         *tquadrants;
 
-  P4EST_QUADRANT_INIT (&ld);
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING
+                            "_coarsen_batch with %lld total quadrants\n",
+                            (long long) p4est->global_num_quadrants);
+  p4est_log_indent_push ();
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (coarsen_fn != NULL);
 
-  /* querying insul is equivalent to querying first descendant */
-  first_owner = p4est_comm_find_owner (p4est, qtree, insul, rank);
-  /* querying last descendant */
-  p4est_quadrant_last_descendant (insul, &ld, P4EST_QMAXLEVEL);
-  last_owner = p4est_comm_find_owner (p4est, qtree, &ld, rank);
+  /* remember input quadrant count; it will not increase */
+  old_gnq = p4est->global_num_quadrants;
 
-  /* send to all processors possibly intersecting insulation */
-  for (owner = first_owner; owner <= last_owner; ++owner) {
-    if (owner == rank && !inter_tree) {
-      /* do not send to self for the same tree */
-      continue;
-    }
-    if (global_first_quadrant[owner] == global_first_quadrant[owner + 1]) {
-      /* do not send to empty processors */
-      continue;
+  /* loop over all local trees */
+  prev_offset = 0;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tquadrants = &tree->quadrants;
+#ifdef P4EST_ENABLE_DEBUG
+    data_pool_size = 0;
+    if (p4est->user_data_pool != NULL) {
+      data_pool_size = p4est->user_data_pool->elem_count;
     }
-    peer = peers + owner;
-    /* avoid duplicates in the send array */
-    found = 0;
-    for (back = 0; back < P4EST_INSUL - 1; ++back) {
-      pos = (int) peer->send_first.elem_count - back - 1;
-      if (pos < 0) {
-        break;
+#endif
+    removed = 0;
+    incount = tquadrants->elem_count;
+
+    /* initial log message for this tree */
+    P4EST_VERBOSEF ("Into coarsen_batch tree %lld with %llu\n",
+                    (long long) jt, (unsigned long long) incount);
+
+    /* collect the first sibling index of every candidate family */
+    family_first =
+      P4EST_ALLOC (p4est_locidx_t, incount / P4EST_CHILDREN + 1);
+    num_families = 0;
+    zz = 0;
+    while (zz + P4EST_CHILDREN <= incount) {
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      if (p4est_quadrant_child_id (q) != 0) {
+        ++zz;
+        continue;
       }
-      s = (p4est_quadrant_t *) sc_array_index_int (&peer->send_first, pos);
-      if (p4est_quadrant_is_equal (s, q) && s->p.piggy2.which_tree == qtree
-          && s->p.piggy2.from_tree == q->p.piggy2.from_tree
-          && s->pad16 == q->pad16) {
-        found = 1;
-        break;
+      isfamily = 1;
+      c[0] = q;
+      for (i = 1; i < P4EST_CHILDREN; ++i) {
+        c[i] = p4est_quadrant_array_index (tquadrants, zz + (size_t) i);
+        if (p4est_quadrant_child_id (c[i]) != i) {
+          isfamily = 0;
+          break;
+        }
+      }
+      /* in a complete tree, the only way P4EST_CHILDREN consecutive
+       * quadrants have the correct consecutive child_id's is if they
+       * are, in fact, a family */
+      P4EST_ASSERT (!isfamily || p4est_quadrant_is_familypv (c));
+      if (isfamily) {
+        family_first[num_families++] = (p4est_locidx_t) zz;
+        zz += P4EST_CHILDREN;
+      }
+      else {
+        ++zz;
       }
-    }
-    if (found) {
-      continue;
     }
 
-    /* copy quadrant into shipping list */
-    s = p4est_quadrant_array_push (&peer->send_first);
-    *s = *q;
-    s->p.piggy2.which_tree = qtree;     /* piggy back tree id */
+    /* decide all families of this tree with a single callback */
+    coarsen_flags = P4EST_ALLOC_ZERO (int8_t, num_families + 1);
+    if (num_families > 0) {
+      coarsen_fn (p4est, jt, tquadrants, num_families,
+                  family_first, coarsen_flags);
+    }
 
-    /* update lowest and highest peer */
-    if (owner != rank) {
-      *first_peer = SC_MIN (owner, *first_peer);
-      *last_peer = SC_MAX (owner, *last_peer);
+    /* replace flagged families with their parent in one compaction */
+    read = write = 0;
+    fam = 0;
+    while (read < incount) {
+      if (fam < num_families && (size_t) family_first[fam] == read) {
+        if (coarsen_flags[fam]) {
+          for (i = 0; i < P4EST_CHILDREN; ++i) {
+            fq[i] = *p4est_quadrant_array_index (tquadrants,
+                                                 read + (size_t) i);
+            c[i] = &fq[i];
+          }
+          if (replace_fn == NULL) {
+            for (i = 0; i < P4EST_CHILDREN; ++i) {
+              p4est_quadrant_free_data (p4est, &fq[i]);
+            }
+          }
+          tree->quadrants_per_level[fq[0].level] -= P4EST_CHILDREN;
+          cfirst = p4est_quadrant_array_index (tquadrants, write);
+          p4est_quadrant_parent (&fq[0], cfirst);
+          p4est_journal_log (p4est, jt, cfirst, cfirst);
+          p4est_quadrant_init_data (p4est, jt, cfirst, init_fn);
+          tree->quadrants_per_level[cfirst->level] += 1;
+          p4est->local_num_quadrants -= P4EST_CHILDREN - 1;
+          removed += P4EST_CHILDREN - 1;
+          if (replace_fn != NULL) {
+            replace_fn (p4est, jt, P4EST_CHILDREN, c, 1, &cfirst);
+            for (i = 0; i < P4EST_CHILDREN; ++i) {
+              p4est_quadrant_free_data (p4est, &fq[i]);
+            }
+          }
+          read += P4EST_CHILDREN;
+          ++write;
+          ++fam;
+          continue;
+        }
+        ++fam;
+      }
+      if (write != read) {
+        *p4est_quadrant_array_index (tquadrants, write) =
+          *p4est_quadrant_array_index (tquadrants, read);
+      }
+      ++write;
+      ++read;
     }
-  }
-}
+    sc_array_resize (tquadrants, write);
+    P4EST_FREE (coarsen_flags);
+    P4EST_FREE (family_first);
 
-static void
-p4est_balance_response (p4est_t * p4est, p4est_balance_peer_t * peer,
-                        p4est_connect_type_t balance, sc_array_t * borders)
-{
-  sc_array_t         *first_seeds = sc_array_new (sizeof (p4est_quadrant_t));
+    /* compute maximum level */
+    maxlevel = 0;
+    num_quadrants = 0;
+    for (i = 0; i <= P4EST_QMAXLEVEL; ++i) {
+      P4EST_ASSERT (tree->quadrants_per_level[i] >= 0);
+      num_quadrants += tree->quadrants_per_level[i];    /* same type */
+      if (tree->quadrants_per_level[i] > 0) {
+        maxlevel = i;
+      }
+    }
+    tree->maxlevel = (int8_t) maxlevel;
+    tree->quadrants_offset = prev_offset;
+    prev_offset += num_quadrants;
 
-/* compute and uniqify overlap quadrants */
-  p4est_tree_compute_overlap (p4est, &peer->recv_first,
-                              &peer->send_second, balance, borders,
-                              first_seeds);
-  /* replace peer->recv_first with first_seeds */
-  p4est_tree_uniqify_overlap (&peer->send_second);
-  p4est_tree_uniqify_overlap (first_seeds);
-  /* replace peer->recv_first with first_seeds */
-  sc_array_resize (&peer->recv_first, first_seeds->elem_count);
-  memcpy (peer->recv_first.array, first_seeds->array,
-          first_seeds->elem_size * first_seeds->elem_count);
-  sc_array_destroy (first_seeds);
+    /* do some sanity checks */
+    P4EST_ASSERT (num_quadrants == (p4est_locidx_t) tquadrants->elem_count);
+    P4EST_ASSERT (tquadrants->elem_count == incount - removed);
+    if (p4est->user_data_pool != NULL) {
+      P4EST_ASSERT (data_pool_size - removed ==
+                    p4est->user_data_pool->elem_count);
+    }
+    P4EST_ASSERT (p4est_tree_is_sorted (tree));
+    P4EST_ASSERT (p4est_tree_is_complete (tree));
 
-  if (p4est->inspect) {
-    p4est->inspect->balance_comm_sent += peer->send_second.elem_count;
-    if (peer->send_second.elem_count) {
-      p4est->inspect->balance_comm_nzpeers++;
+    /* final log message for this tree */
+    P4EST_VERBOSEF ("Done coarsen_batch tree %lld now %llu\n",
+                    (long long) jt,
+                    (unsigned long long) tquadrants->elem_count);
+  }
+  if (p4est->last_local_tree >= 0) {
+    for (; jt < p4est->connectivity->num_trees; ++jt) {
+      tree = p4est_tree_array_index (p4est->trees, jt);
+      tree->quadrants_offset = p4est->local_num_quadrants;
     }
   }
+
+  /* compute global number of quadrants */
+  p4est_comm_count_quadrants (p4est);
+  P4EST_ASSERT (p4est->global_num_quadrants <= old_gnq);
+  if (old_gnq != p4est->global_num_quadrants) {
+    ++p4est->revision;
+  }
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
+                            "_coarsen_batch with %lld total quadrants\n",
+                            (long long) p4est->global_num_quadrants);
 }
 
-void
-p4est_balance (p4est_t * p4est, p4est_connect_type_t btype,
-               p4est_init_t init_fn)
+/** Emit the arithmetically coarsened cover of a quadrant subrange.
+ * The subrange must be Morton-sorted, linear, and gap-free.  Wherever
+ * an aligned block is completely contained and none of its members is
+ * more than \a levels below the block, its ancestor is emitted;
+ * partial blocks at the range ends and blocks with too deep members
+ * retry with the next smaller block size.
+ * \param [in] inq      Input quadrant array of one tree.
+ * \param [in] begin    First index of the subrange to coarsen.
+ * \param [in] end      One past the last index of the subrange.
+ * \param [in] levels   Maximum number of levels any quadrant may rise.
+ * \param [in] step     Levels above the block's first quadrant to try,
+ *                      between 0 and \a levels.
+ * \param [in,out] outq The coarse quadrants are appended.
+ * \param [in,out] corr If not NULL, for every emitted quadrant the
+ *                      count of input quadrants it covers is appended.
+ */
+static void
+p4est_coarsen_uniform_range (sc_array_t * inq, size_t begin, size_t end,
+                             int levels, int step, sc_array_t * outq,
+                             sc_array_t * corr)
 {
-  p4est_balance_ext (p4est, btype, init_fn, NULL);
+  int                 l, maxl;
+  size_t              zz, zw;
+  uint64_t            afirst, alast, qfirst, qlast;
+  p4est_quadrant_t    fd, a;
+  p4est_quadrant_t   *q, *r;
+  p4est_locidx_t     *c;
+
+  if (step == 0) {
+    /* copy the subrange through unchanged */
+    for (zz = begin; zz < end; ++zz) {
+      q = p4est_quadrant_array_index (inq, zz);
+      r = (p4est_quadrant_t *) sc_array_push (outq);
+      *r = *q;
+      if (corr != NULL) {
+        c = (p4est_locidx_t *) sc_array_push (corr);
+        *c = 1;
+      }
+    }
+    return;
+  }
+
+  zz = begin;
+  while (zz < end) {
+    q = p4est_quadrant_array_index (inq, zz);
+    l = SC_MAX ((int) q->level - step, 0);
+    if (l == (int) q->level) {
+      /* the root quadrant cannot be coarsened any further */
+      r = (p4est_quadrant_t *) sc_array_push (outq);
+      *r = *q;
+      if (corr != NULL) {
+        c = (p4est_locidx_t *) sc_array_push (corr);
+        *c = 1;
+      }
+      ++zz;
+      continue;
+    }
+    P4EST_QUADRANT_INIT (&a);
+    p4est_quadrant_ancestor (q, l, &a);
+    p4est_quadrant_first_descendant (&a, &fd, P4EST_QMAXLEVEL);
+    afirst = p4est_quadrant_linear_id (&fd, P4EST_QMAXLEVEL);
+    alast = afirst +
+      ((uint64_t) 1 << (P4EST_DIM * (P4EST_QMAXLEVEL - l))) - 1;
+    p4est_quadrant_first_descendant (q, &fd, P4EST_QMAXLEVEL);
+    qfirst = p4est_quadrant_linear_id (&fd, P4EST_QMAXLEVEL);
+
+    /* scan the quadrants contained in the candidate ancestor */
+    maxl = (int) q->level;
+    qlast = qfirst +
+      ((uint64_t) 1 << (P4EST_DIM * (P4EST_QMAXLEVEL - (int) q->level)))
+      - 1;
+    zw = zz;
+    while (zw + 1 < end && qlast < alast) {
+      r = p4est_quadrant_array_index (inq, zw + 1);
+      p4est_quadrant_first_descendant (r, &fd, P4EST_QMAXLEVEL);
+      maxl = SC_MAX (maxl, (int) r->level);
+      qlast = p4est_quadrant_linear_id (&fd, P4EST_QMAXLEVEL) +
+        ((uint64_t) 1 <<
+         (P4EST_DIM * (P4EST_QMAXLEVEL - (int) r->level))) - 1;
+      ++zw;
+    }
+
+    if (qfirst == afirst && qlast == alast && maxl <= l + levels) {
+      /* the block is aligned, complete, and shallow enough to merge */
+      r = (p4est_quadrant_t *) sc_array_push (outq);
+      *r = a;
+      if (corr != NULL) {
+        c = (p4est_locidx_t *) sc_array_push (corr);
+        *c = (p4est_locidx_t) (zw + 1 - zz);
+      }
+    }
+    else {
+      /* retry the partial or too deep block with a smaller step */
+      p4est_coarsen_uniform_range (inq, zz, zw + 1, levels, step - 1,
+                                   outq, corr);
+    }
+    zz = zw + 1;
+  }
 }
 
-void
-p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
-                   p4est_init_t init_fn, p4est_replace_t replace_fn)
+p4est_t            *
+p4est_coarsen_uniform (p4est_t * p4est, int levels,
+                       p4est_init_t init_fn, sc_array_t * correspondence)
 {
-  const int           rank = p4est->mpirank;
-  const int           num_procs = p4est->mpisize;
-  int                 j, k, l, m, which;
-  int                 face;
-  int                 first_peer, last_peer;
-  int                 quad_contact[P4EST_FACES];
-  int                 any_face, tree_contact[P4EST_FACES];
-  int                 tree_fully_owned, full_tree[2];
-  int8_t             *tree_flags;
-  size_t              zz, treecount, ctree;
-  size_t              localcount;
-  size_t              qcount, qbytes;
-  size_t              all_incount, all_outcount;
-  p4est_qcoord_t      qh;
-  const p4est_qcoord_t rh = P4EST_ROOT_LEN;
-  p4est_topidx_t      qtree, nt;
-  p4est_topidx_t      first_tree, last_tree;
-  p4est_locidx_t      skipped;
-  p4est_gloidx_t      old_gnq;
-  p4est_balance_peer_t *peers, *peer;
-  p4est_tree_t       *tree;
-  p4est_quadrant_t    mylow, nextlow;
-  p4est_quadrant_t    tosend, insulq, tempq;
-  p4est_quadrant_t   *q, *s;
-  p4est_connectivity_t *conn = p4est->connectivity;
-  sc_array_t         *qarray, *tquadrants;
-  sc_array_t         *borders;
-#ifdef P4EST_ENABLE_DEBUG
-  size_t              data_pool_size;
-#endif
-  int                 ftransform[P4EST_FTRANSFORM];
-  int                 face_axis[3];     /* 3 not P4EST_DIM */
-  int                 contact_face_only, contact_edge_only;
-#ifdef P4_TO_P8
-  int                 edge;
-  size_t              etree;
-  p8est_edge_info_t   ei;
-  p8est_edge_transform_t *et;
-  sc_array_t         *eta;
-#endif
-  int                 corner;
-  p4est_corner_info_t ci;
-  p4est_corner_transform_t *ct;
-  sc_array_t         *cta;
-#ifdef P4EST_ENABLE_MPI
-#ifdef P4EST_ENABLE_DEBUG
-  unsigned            checksum;
-  sc_array_t          checkarray;
-  p4est_gloidx_t      ltotal[2], gtotal[2];
-#endif /* P4EST_ENABLE_DEBUG */
   int                 i;
-  int                 mpiret, rcount;
-  int                 first_bound;
-  int                 request_first_count, request_second_count, outcount;
-  int                 request_send_count, total_send_count, total_recv_count;
-  int                 nwin, maxpeers, maxwin, twomaxwin;
-  int                 send_zero[2], send_load[2];
-  int                 recv_zero[2], recv_load[2];
-  int                 my_ranges[2 * p4est_num_ranges];
-  int                *wait_indices;
-  int                *procs, *all_ranges;
-  int                *receiver_ranks, *sender_ranks;
-  int                 num_receivers, num_senders;
-  int                *receiver_ranks_ranges, *sender_ranks_ranges;
-  int                 num_receivers_ranges, num_senders_ranges;
-  int                *receiver_ranks_notify, *sender_ranks_notify;
-  int                 num_receivers_notify, num_senders_notify;
-  int                 is_ranges_primary, is_balance_verify;
-  int                 is_ranges_active, is_notify_active;
-  int                 max_ranges;
-  MPI_Request        *requests_first, *requests_second;
-  MPI_Request        *send_requests_first_count, *send_requests_first_load;
-  MPI_Request        *send_requests_second_count, *send_requests_second_load;
-  MPI_Status         *recv_statuses, *jstatus;
-#endif /* P4EST_ENABLE_MPI */
+  size_t              zz;
+  p4est_topidx_t      jt;
+  p4est_topidx_t      num_trees, first_tree, last_tree;
+  p4est_t            *coarse;
+  p4est_tree_t       *itree, *ctree;
+  p4est_quadrant_t   *q;
+  sc_array_t         *tquadrants;
 
   P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING
-                            "_balance %s with %lld total quadrants\n",
-                            p4est_connect_type_string (btype),
+                            "_coarsen_uniform %d with %lld total quadrants\n",
+                            levels,
                             (long long) p4est->global_num_quadrants);
   p4est_log_indent_push ();
   P4EST_ASSERT (p4est_is_valid (p4est));
-#ifndef P4_TO_P8
-  P4EST_ASSERT (btype == P4EST_CONNECT_FACE || btype == P4EST_CONNECT_CORNER);
-#else
-  P4EST_ASSERT (btype == P8EST_CONNECT_FACE || btype == P8EST_CONNECT_EDGE ||
-                btype == P8EST_CONNECT_CORNER);
-#endif
+  P4EST_ASSERT (levels >= 0);
+  P4EST_ASSERT (correspondence == NULL ||
+                (correspondence->elem_size == sizeof (p4est_locidx_t) &&
+                 correspondence->elem_count == 0));
 
-  /* remember input quadrant count; it will not decrease */
-  old_gnq = p4est->global_num_quadrants;
+  num_trees = p4est->connectivity->num_trees;
+  first_tree = p4est->first_local_tree;
+  last_tree = p4est->last_local_tree;
 
-#ifdef P4EST_ENABLE_DEBUG
-  data_pool_size = 0;
-  if (p4est->user_data_pool != NULL) {
-    data_pool_size = p4est->user_data_pool->elem_count;
-  }
-#endif
+  /* create a shallow copy and zero out dependent fields */
+  coarse = P4EST_ALLOC (p4est_t, 1);
+  memcpy (coarse, p4est, sizeof (p4est_t));
+  coarse->global_first_quadrant = NULL;
+  coarse->global_first_position = NULL;
+  coarse->trees = NULL;
+  coarse->user_data_pool = NULL;
+  coarse->quadrant_pool = NULL;
 
-  P4EST_QUADRANT_INIT (&mylow);
-  P4EST_QUADRANT_INIT (&nextlow);
-  P4EST_QUADRANT_INIT (&tosend);
-  P4EST_QUADRANT_INIT (&insulq);
-  P4EST_QUADRANT_INIT (&tempq);
+  /* set parallel environment */
+  p4est_comm_parallel_env_assign (coarse, p4est->mpicomm);
 
-  /* tree status flags (max 8 per tree) */
-  tree_flags = P4EST_ALLOC (int8_t, conn->num_trees);
-  for (nt = 0; nt < conn->num_trees; ++nt) {
-    tree_flags[nt] = 0x00;
+  /* allocate a user data pool if necessary and a quadrant pool */
+  if (coarse->data_size > 0) {
+    coarse->user_data_pool = sc_mempool_new (coarse->data_size);
   }
+  coarse->quadrant_pool = sc_mempool_new (sizeof (p4est_quadrant_t));
 
-  localcount = (size_t) (p4est->last_local_tree + 1 -
-                         p4est->first_local_tree);
-  borders = sc_array_new_size (sizeof (sc_array_t), localcount);
-  for (zz = 0; zz < localcount; zz++) {
-    qarray = (sc_array_t *) sc_array_index (borders, zz);
-    sc_array_init (qarray, sizeof (p4est_quadrant_t));
+  /* derive the coarse quadrants of each local tree in one sweep */
+  coarse->trees = sc_array_new (sizeof (p4est_tree_t));
+  sc_array_resize (coarse->trees, num_trees);
+  for (jt = 0; jt < num_trees; ++jt) {
+    itree = p4est_tree_array_index (p4est->trees, jt);
+    ctree = p4est_tree_array_index (coarse->trees, jt);
+    memcpy (ctree, itree, sizeof (p4est_tree_t));
+    sc_array_init (&ctree->quadrants, sizeof (p4est_quadrant_t));
   }
-
-#ifdef P4EST_ENABLE_MPI
-  requests_first = P4EST_ALLOC (MPI_Request, 6 * num_procs);
-  requests_second = requests_first + 1 * num_procs;
-  send_requests_first_count = requests_first + 2 * num_procs;
-  send_requests_first_load = requests_first + 3 * num_procs;
-  send_requests_second_count = requests_first + 4 * num_procs;
-  send_requests_second_load = requests_first + 5 * num_procs;
-  recv_statuses = P4EST_ALLOC (MPI_Status, num_procs);
-  for (j = 0; j < num_procs; ++j) {
-    requests_first[j] = requests_second[j] = MPI_REQUEST_NULL;
-    send_requests_first_count[j] = MPI_REQUEST_NULL;
-    send_requests_first_load[j] = MPI_REQUEST_NULL;
-    send_requests_second_count[j] = MPI_REQUEST_NULL;
-    send_requests_second_load[j] = MPI_REQUEST_NULL;
+  coarse->local_num_quadrants = 0;
+  for (jt = first_tree; jt <= last_tree; ++jt) {
+    itree = p4est_tree_array_index (p4est->trees, jt);
+    ctree = p4est_tree_array_index (coarse->trees, jt);
+    tquadrants = &ctree->quadrants;
+    p4est_coarsen_uniform_range (&itree->quadrants, 0,
+                                 itree->quadrants.elem_count, levels,
+                                 levels, tquadrants, correspondence);
+
+    /* rebuild the per-tree bookkeeping for the coarse quadrants */
+    for (i = 0; i <= P4EST_QMAXLEVEL; ++i) {
+      ctree->quadrants_per_level[i] = 0;
+    }
+    ctree->maxlevel = 0;
+    ctree->quadrants_offset = coarse->local_num_quadrants;
+    for (zz = 0; zz < tquadrants->elem_count; ++zz) {
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      ++ctree->quadrants_per_level[q->level];
+      ctree->maxlevel = (int8_t) SC_MAX (ctree->maxlevel, q->level);
+      p4est_quadrant_init_data (coarse, jt, q, init_fn);
+    }
+    coarse->local_num_quadrants += (p4est_locidx_t) tquadrants->elem_count;
   }
-  wait_indices = P4EST_ALLOC (int, num_procs);
-#ifdef P4EST_ENABLE_DEBUG
-  sc_array_init (&checkarray, 4);
-#endif /* P4EST_ENABLE_DEBUG */
-#endif /* P4EST_ENABLE_MPI */
-
-  /* allocate per peer storage and initialize requests */
-  peers = P4EST_ALLOC (p4est_balance_peer_t, num_procs);
-  for (j = 0; j < num_procs; ++j) {
-    peer = peers + j;
-    sc_array_init (&peer->send_first, sizeof (p4est_quadrant_t));
-    sc_array_init (&peer->send_second, sizeof (p4est_quadrant_t));
-    sc_array_init (&peer->recv_first, sizeof (p4est_quadrant_t));
-    sc_array_init (&peer->recv_second, sizeof (p4est_quadrant_t));
-    peer->send_first_count = peer->send_second_count = 0;
-    peer->recv_first_count = peer->recv_second_count = 0;
-    peer->have_first_count = peer->have_first_load = 0;
-    peer->have_second_count = peer->have_second_load = 0;
+  if (last_tree >= 0) {
+    for (jt = last_tree + 1; jt < num_trees; ++jt) {
+      ctree = p4est_tree_array_index (coarse->trees, jt);
+      ctree->quadrants_offset = coarse->local_num_quadrants;
+    }
   }
-#ifdef P4_TO_P8
-  eta = &ei.edge_transforms;
-  sc_array_init (eta, sizeof (p8est_edge_transform_t));
-#endif
-  cta = &ci.corner_transforms;
-  sc_array_init (cta, sizeof (p4est_corner_transform_t));
 
-  /* compute first quadrant on finest level */
-  mylow.x = p4est->global_first_position[rank].x;
-  mylow.y = p4est->global_first_position[rank].y;
-#ifdef P4_TO_P8
-  mylow.z = p4est->global_first_position[rank].z;
-#endif
-  mylow.level = P4EST_QMAXLEVEL;
+  /* the rank boundaries are unchanged since blocks never cross them */
+  coarse->global_first_position = P4EST_ALLOC (p4est_quadrant_t,
+                                               coarse->mpisize + 1);
+  memcpy (coarse->global_first_position, p4est->global_first_position,
+          (coarse->mpisize + 1) * sizeof (p4est_quadrant_t));
 
-  /* and the first finest quadrant of the next processor */
-  nextlow.x = p4est->global_first_position[rank + 1].x;
-  nextlow.y = p4est->global_first_position[rank + 1].y;
-#ifdef P4_TO_P8
-  nextlow.z = p4est->global_first_position[rank + 1].z;
-#endif
-  nextlow.level = P4EST_QMAXLEVEL;
+  /* count the coarse quadrants over all processes */
+  coarse->global_first_quadrant =
+    P4EST_ALLOC (p4est_gloidx_t, coarse->mpisize + 1);
+  p4est_comm_count_quadrants (coarse);
 
-  /* start balance_A timing */
-  if (p4est->inspect != NULL) {
-    p4est->inspect->balance_A = -sc_MPI_Wtime ();
-    p4est->inspect->balance_A_count_in = 0;
-    p4est->inspect->balance_A_count_out = 0;
-    p4est->inspect->use_B = 0;
-  }
+  /* the coarse forest starts with a revision count of zero */
+  coarse->revision = 0;
 
-  /* loop over all local trees to assemble first send list */
-  first_tree = p4est->first_local_tree;
-  last_tree = p4est->last_local_tree;
-  first_peer = num_procs;
-  last_peer = -1;
-  all_incount = 0;
-  skipped = 0;
-  for (nt = first_tree; nt <= last_tree; ++nt) {
-    p4est_comm_tree_info (p4est, nt, full_tree, tree_contact, NULL, NULL);
-    tree_fully_owned = full_tree[0] && full_tree[1];
-    any_face = 0;
-    for (face = 0; face < P4EST_FACES; ++face) {
-      any_face = any_face || tree_contact[face];
+  P4EST_ASSERT (p4est_is_valid (coarse));
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
+                            "_coarsen_uniform with %lld total quadrants\n",
+                            (long long) coarse->global_num_quadrants);
+
+  return coarse;
+}
+
+/** Check if the insulation layer of a quadrant overlaps anybody.
+ * If yes, the quadrant itself is scheduled for sending.
+ * Both quadrants are in the receiving tree's coordinates.
+ * \param [in]  qtree       Tree id of the receiving tree.
+ * \param [in]  inter_tree  Boolean flag to specify inter-tree communication.
+ * \param [in]  q           The quadrant to be sent if there is overlap.
+ * \param [in]  insul       An insulation quadrant of \a q.
+ * \param [in,out]  first_peer  Lowest peer, will be updated.
+ * \param [in,out]  last_peer   Highest peer, will be updated.
+ */
+static void
+p4est_balance_schedule (p4est_t * p4est, p4est_balance_peer_t * peers,
+                        p4est_topidx_t qtree, int inter_tree,
+                        const p4est_quadrant_t * q,
+                        const p4est_quadrant_t * insul,
+                        int *first_peer, int *last_peer)
+{
+  const int           rank = p4est->mpirank;
+  int                 found;
+  int                 back, pos;
+  int                 owner, first_owner, last_owner;
+  p4est_gloidx_t     *global_first_quadrant = p4est->global_first_quadrant;
+  p4est_quadrant_t    ld, *s;
+  p4est_balance_peer_t *peer;
+
+  P4EST_QUADRANT_INIT (&ld);
+
+  /* querying insul is equivalent to querying first descendant */
+  first_owner = p4est_comm_find_owner (p4est, qtree, insul, rank);
+  /* querying last descendant */
+  p4est_quadrant_last_descendant (insul, &ld, P4EST_QMAXLEVEL);
+  last_owner = p4est_comm_find_owner (p4est, qtree, &ld, rank);
+
+  /* send to all processors possibly intersecting insulation */
+  for (owner = first_owner; owner <= last_owner; ++owner) {
+    if (owner == rank && !inter_tree) {
+      /* do not send to self for the same tree */
+      continue;
     }
-    if (any_face) {
-      tree_flags[nt] |= any_face_flag;
+    if (global_first_quadrant[owner] == global_first_quadrant[owner + 1]) {
+      /* do not send to empty processors */
+      continue;
+    }
+    peer = peers + owner;
+    /* avoid duplicates in the send array */
+    found = 0;
+    for (back = 0; back < P4EST_INSUL - 1; ++back) {
+      pos = (int) peer->send_first.elem_count - back - 1;
+      if (pos < 0) {
+        break;
+      }
+      s = (p4est_quadrant_t *) sc_array_index_int (&peer->send_first, pos);
+      if (p4est_quadrant_is_equal (s, q) && s->p.piggy2.which_tree == qtree
+          && s->p.piggy2.from_tree == q->p.piggy2.from_tree
+          && s->pad16 == q->pad16) {
+        found = 1;
+        break;
+      }
+    }
+    if (found) {
+      continue;
     }
-    tree = p4est_tree_array_index (p4est->trees, nt);
-    tquadrants = &tree->quadrants;
-    all_incount += tquadrants->elem_count;
 
-    /* initial log message for this tree */
-    P4EST_VERBOSEF ("Into balance tree %lld with %llu\n", (long long) nt,
-                    (unsigned long long) tquadrants->elem_count);
+    /* copy quadrant into shipping list */
+    s = p4est_quadrant_array_push (&peer->send_first);
+    *s = *q;
+    s->p.piggy2.which_tree = qtree;     /* piggy back tree id */
 
-    /* local balance first pass */
-    p4est_balance_subtree_ext (p4est, btype, nt, init_fn, replace_fn);
-    treecount = tquadrants->elem_count;
-    P4EST_VERBOSEF ("Balance tree %lld A %llu\n",
-                    (long long) nt, (unsigned long long) treecount);
+    /* update lowest and highest peer */
+    if (owner != rank) {
+      *first_peer = SC_MIN (owner, *first_peer);
+      *last_peer = SC_MAX (owner, *last_peer);
+    }
+  }
+}
 
-    /* check if this tree is not shared with other processors */
-    if (tree_fully_owned) {
-      /* all quadrants in this tree are owned by me */
-      tree_flags[nt] |= fully_owned_flag;
-      if (!any_face) {
-        /* this tree is isolated, no balance between trees */
-        continue;
-      }
+static void
+p4est_balance_response (p4est_t * p4est, p4est_balance_peer_t * peer,
+                        p4est_connect_type_t balance, sc_array_t * borders)
+{
+  sc_array_t         *first_seeds = sc_array_new (sizeof (p4est_quadrant_t));
+
+/* compute and uniqify overlap quadrants */
+  p4est_tree_compute_overlap (p4est, &peer->recv_first,
+                              &peer->send_second, balance, borders,
+                              first_seeds);
+  /* replace peer->recv_first with first_seeds */
+  p4est_tree_uniqify_overlap (&peer->send_second);
+  p4est_tree_uniqify_overlap (first_seeds);
+  /* replace peer->recv_first with first_seeds */
+  sc_array_resize (&peer->recv_first, first_seeds->elem_count);
+  memcpy (peer->recv_first.array, first_seeds->array,
+          first_seeds->elem_size * first_seeds->elem_count);
+  sc_array_destroy (first_seeds);
+
+  if (p4est->inspect) {
+    p4est->inspect->balance_comm_sent += peer->send_second.elem_count;
+    if (peer->send_second.elem_count) {
+      p4est->inspect->balance_comm_nzpeers++;
     }
+  }
+}
 
-    if (borders != NULL) {
-      qarray = (sc_array_t *) sc_array_index (borders,
-                                              (size_t) (nt - first_tree));
+/** Simulate the balance send and receive with myself across trees.
+ * This is pure local work and serves as donated work while waiting
+ * for remote first-round messages.
+ */
+static void
+p4est_balance_self_response (p4est_t * p4est, p4est_balance_peer_t * peer,
+                             p4est_connect_type_t btype,
+                             sc_array_t * borders)
+{
+  size_t              qcount, qbytes;
+  sc_array_t         *qarray;
+
+  p4est_quadrant_array_sort (&peer->send_first,
+                             p4est_quadrant_compare_piggy);
+  qcount = peer->send_first.elem_count;
+  peer->recv_first_count = peer->send_first_count = (int) qcount;
+  qbytes = qcount * sizeof (p4est_quadrant_t);
+  qarray = &peer->recv_first;
+  sc_array_resize (qarray, qcount);
+  memcpy (qarray->array, peer->send_first.array, qbytes);
+  p4est_balance_response (p4est, peer, btype, borders);
+  qcount = peer->send_second.elem_count;
+  peer->recv_second_count = peer->send_second_count = (int) qcount;
+  qbytes = qcount * sizeof (p4est_quadrant_t);
+  qarray = &peer->recv_second;
+  sc_array_resize (qarray, qcount);
+  memcpy (qarray->array, peer->send_second.array, qbytes);
+}
+
+/** Merge one peer's received quadrants into the local storage.
+ * Safe to call as soon as both receives from this peer are complete;
+ * it only appends to the trees or borders and to the local counters.
+ */
+static void
+p4est_balance_merge_peer (p4est_t * p4est, p4est_balance_peer_t * peer,
+                          p4est_topidx_t first_tree,
+                          p4est_topidx_t last_tree,
+                          sc_array_t * borders, p4est_init_t init_fn)
+{
+  size_t              zz, qcount, fcount;
+  p4est_topidx_t      qtree;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, *s;
+  sc_array_t         *qarray;
+
+  fcount = peer->recv_first.elem_count;
+  qcount = fcount + peer->recv_second.elem_count;
+  P4EST_ASSERT (peer->send_first_count ==
+                (int) peer->send_first.elem_count);
+  P4EST_ASSERT (peer->send_second_count ==
+                (int) peer->send_second.elem_count);
+  P4EST_ASSERT (peer->recv_second_count ==
+                (int) peer->recv_second.elem_count);
+
+  /* merge received quadrants into correct tree */
+  for (zz = 0; zz < qcount; ++zz) {
+    s = zz < fcount ? p4est_quadrant_array_index (&peer->recv_first, zz) :
+      p4est_quadrant_array_index (&peer->recv_second, zz - fcount);
+    P4EST_ASSERT (p4est_quadrant_is_extended (s));
+    qtree = s->p.piggy2.which_tree;
+    if (qtree < first_tree || qtree > last_tree) {
+      /* this is a corner/edge quadrant from the second pass of balance */
+      continue;
+    }
+    if (borders == NULL) {
+      tree = p4est_tree_array_index (p4est->trees, qtree);
+      q = p4est_quadrant_array_push (&tree->quadrants);
+      *q = *s;
+      ++tree->quadrants_per_level[q->level];
+      tree->maxlevel = (int8_t) SC_MAX (tree->maxlevel, q->level);
+      ++p4est->local_num_quadrants;
+      p4est_quadrant_init_data (p4est, qtree, q, init_fn);
     }
     else {
-      qarray = NULL;
+      qarray = (sc_array_t *) sc_array_index (borders,
+                                              (int) (qtree - first_tree));
+      q = p4est_quadrant_array_push (qarray);
+      *q = *s;
     }
+  }
+}
 
-    /* identify boundary quadrants and prepare them to be sent */
-    for (zz = 0; zz < treecount; ++zz) {
-      /* this quadrant may be on the boundary with a range of processors */
-      q = p4est_quadrant_array_index (tquadrants, zz);
-      qh = P4EST_QUADRANT_LEN (q->level);
-      if (p4est_comm_neighborhood_owned (p4est, nt,
-                                         full_tree, tree_contact, q)) {
-        /* this quadrant's 3x3 neighborhood is owned by this processor */
-        ++skipped;
-        continue;
-      }
+void
+p4est_balance (p4est_t * p4est, p4est_connect_type_t btype,
+               p4est_init_t init_fn)
+{
+  p4est_balance_ext (p4est, btype, init_fn, NULL);
+}
 
-      if (qarray != NULL) {
-        s = (p4est_quadrant_t *) sc_array_push (qarray);
-        *s = *q;
-      }
+#ifdef P4EST_ENABLE_MPI
+
+/** Upper bound in bytes for the wire encoding of a balance message.
+ * Structure traffic does not ship the raw piggy union; only the tree
+ * ids that the receiver consumes travel with the coordinates.  The
+ * target tree is always needed, the tree of origin only in the first
+ * round where \ref p4est_tree_compute_overlap reads it.  Each value
+ * but the level is a varint of at most five bytes; the actual stream
+ * is usually much shorter due to the delta coding against the
+ * Morton-sorted predecessor.
+ */
+static size_t
+p4est_balance_wire_bound (size_t qcount, int with_from_tree)
+{
+  return qcount *
+    (5 * ((size_t) P4EST_DIM + 1 + (with_from_tree ? 1 : 0)) + 1);
+}
+
+/** Append one value to a varint wire stream, zigzagged so that small
+ * magnitudes of either sign encode into few bytes. */
+static char *
+p4est_balance_wire_put (char *wp, p4est_qcoord_t value)
+{
+  uint32_t            u;
+
+  u = ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+  while (u >= 0x80) {
+    *wp++ = (char) (u | 0x80);
+    u >>= 7;
+  }
+  *wp++ = (char) u;
+  return wp;
+}
+
+/** Read back one zigzagged varint value from a wire stream. */
+static const char *
+p4est_balance_wire_get (const char *wp, p4est_qcoord_t * value)
+{
+  uint32_t            u, byte;
+  int                 shift;
+
+  u = 0;
+  shift = 0;
+  do {
+    byte = (uint32_t) (unsigned char) *wp++;
+    u |= (byte & 0x7f) << shift;
+    shift += 7;
+  }
+  while (byte & 0x80);
+  *value = (p4est_qcoord_t) ((u >> 1) ^ (0U - (u & 1)));
+  return wp;
+}
 
+/** Pack quadrants into the delta-compressed wire encoding for sending.
+ * The quadrants are in piggy order, so coordinates and tree numbers of
+ * neighbors in the array differ by little and their deltas compress to
+ * one or two bytes each.
+ */
+static void
+p4est_balance_wire_pack (sc_array_t * quadrants, int with_from_tree,
+                         sc_array_t * wire)
+{
+  size_t              zz;
+  char               *wp;
+  p4est_qcoord_t      px, py;
 #ifdef P4_TO_P8
-      for (m = 0; m < 3; ++m) {
-#if 0
-      }
+  p4est_qcoord_t      pz;
 #endif
-#else
-      m = 0;
+  p4est_topidx_t      ptree;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (wire->elem_size == 1);
+  sc_array_resize (wire, p4est_balance_wire_bound (quadrants->elem_count,
+                                                   with_from_tree));
+  wp = wire->array;
+  px = py = 0;
+#ifdef P4_TO_P8
+  pz = 0;
 #endif
-      for (k = 0; k < 3; ++k) {
-        for (l = 0; l < 3; ++l) {
-          which = m * 9 + k * 3 + l;    /* 2D: 0..8, 3D: 0..26 */
-          /* exclude myself from the queries */
-          if (which == P4EST_INSUL / 2) {
-            continue;
-          }
-          /* may modify insulq below, never modify q itself! */
-          insulq = *q;
-          insulq.x += (l - 1) * qh;
-          insulq.y += (k - 1) * qh;
+  ptree = 0;
+  for (zz = 0; zz < quadrants->elem_count; ++zz) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    P4EST_ASSERT (p4est_quadrant_is_extended (q));
+    *wp++ = (char) q->level;
+    wp = p4est_balance_wire_put (wp, (p4est_qcoord_t)
+                                 (q->p.piggy2.which_tree - ptree));
+    ptree = q->p.piggy2.which_tree;
+    if (with_from_tree) {
+      wp = p4est_balance_wire_put (wp, (p4est_qcoord_t)
+                                   (q->p.piggy2.from_tree - ptree));
+    }
+    wp = p4est_balance_wire_put (wp, q->x - px);
+    px = q->x;
+    wp = p4est_balance_wire_put (wp, q->y - py);
+    py = q->y;
 #ifdef P4_TO_P8
-          insulq.z += (m - 1) * qh;
+    wp = p4est_balance_wire_put (wp, q->z - pz);
+    pz = q->z;
 #endif
-          /* check boundary status of insulation quadrant */
-          quad_contact[0] = (insulq.x < 0);
-          quad_contact[1] = (insulq.x >= rh);
-          face_axis[0] = quad_contact[0] || quad_contact[1];
-          quad_contact[2] = (insulq.y < 0);
-          quad_contact[3] = (insulq.y >= rh);
-          face_axis[1] = quad_contact[2] || quad_contact[3];
-#ifndef P4_TO_P8
-          face_axis[2] = 0;
-#else
-          quad_contact[4] = (insulq.z < 0);
-          quad_contact[5] = (insulq.z >= rh);
-          face_axis[2] = quad_contact[4] || quad_contact[5];
-          edge = -1;
+  }
+  P4EST_ASSERT ((size_t) (wp - wire->array) <= wire->elem_count);
+  sc_array_resize (wire, (size_t) (wp - wire->array));
+}
+
+/** Expand a received wire buffer into full quadrants.
+ * The wire array holds exactly the bytes of the incoming message.
+ */
+static void
+p4est_balance_wire_unpack (sc_array_t * wire, int with_from_tree,
+                           sc_array_t * quadrants)
+{
+  size_t              zz;
+  const char         *wp;
+  p4est_qcoord_t      d, px, py;
+#ifdef P4_TO_P8
+  p4est_qcoord_t      pz;
 #endif
-          contact_edge_only = contact_face_only = 0;
-          face = -1;
-          if (face_axis[0] || face_axis[1] || face_axis[2]) {
-            /* this quadrant is relevant for inter-tree balancing */
-            if (!face_axis[1] && !face_axis[2]) {
-              contact_face_only = 1;
-              face = 0 + quad_contact[1];
-            }
-            else if (!face_axis[0] && !face_axis[2]) {
-              contact_face_only = 1;
-              face = 2 + quad_contact[3];
-            }
+  p4est_topidx_t      ptree;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (wire->elem_size == 1);
+  wp = (const char *) wire->array;
+  px = py = 0;
 #ifdef P4_TO_P8
-            else if (!face_axis[0] && !face_axis[1]) {
-              contact_face_only = 1;
-              face = 4 + quad_contact[5];
-            }
-            else if (!face_axis[0]) {
+  pz = 0;
+#endif
+  ptree = 0;
+  for (zz = 0; zz < quadrants->elem_count; ++zz) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    P4EST_QUADRANT_INIT (q);
+    q->level = (int8_t) * wp++;
+    wp = p4est_balance_wire_get (wp, &d);
+    ptree += (p4est_topidx_t) d;
+    q->p.piggy2.which_tree = ptree;
+    if (with_from_tree) {
+      wp = p4est_balance_wire_get (wp, &d);
+      q->p.piggy2.from_tree = ptree + (p4est_topidx_t) d;
+    }
+    wp = p4est_balance_wire_get (wp, &d);
+    q->x = px += d;
+    wp = p4est_balance_wire_get (wp, &d);
+    q->y = py += d;
+#ifdef P4_TO_P8
+    wp = p4est_balance_wire_get (wp, &d);
+    q->z = pz += d;
+#endif
+    P4EST_ASSERT (p4est_quadrant_is_extended (q));
+  }
+  SC_CHECK_ABORT (wp == (const char *) wire->array + wire->elem_count,
+                  "Wire decode mismatch in balance");
+}
+
+/** Number of balance calls timed per candidate pattern while tuning. */
+#define P4EST_BALANCE_AUTOTUNE_TRIALS 2
+
+/** Choose the communication pattern of this balance call while tuning.
+ * The first measured calls alternate between sc_notify and sc_ranges
+ * so that both candidates see comparable meshes; once each has run
+ * \ref P4EST_BALANCE_AUTOTUNE_TRIALS times the faster one is locked in
+ * by \ref p4est_balance_autotune_record.  A locked measurement reopens
+ * when the global quadrant count moves by more than a factor of two
+ * from the workload it was taken on. */
+static void
+p4est_balance_autotune_select (p4est_t * p4est)
+{
+  p4est_inspect_t    *in = p4est->inspect;
+
+  P4EST_ASSERT (in != NULL);
+  if (!in->balance_autotune) {
+    return;
+  }
+  if (in->balance_autotune_quads > 0) {
+    if (p4est->global_num_quadrants < 2 * in->balance_autotune_quads &&
+        in->balance_autotune_quads < 2 * p4est->global_num_quadrants) {
+      /* the workload still resembles the one measured: keep the lock */
+      return;
+    }
+    in->balance_autotune_calls = 0;
+    in->balance_autotune_cost[0] = in->balance_autotune_cost[1] = 0.;
+    in->balance_autotune_quads = 0;
+  }
+  in->use_balance_ranges = in->balance_autotune_calls % 2;
+}
+
+/** Account the communication time of a measured balance call.
+ * Locks in the pattern with the smaller cost summed over all
+ * processes, so every process arrives at the same decision. */
+static void
+p4est_balance_autotune_record (p4est_t * p4est)
+{
+  int                 mpiret;
+  double              gcost[2];
+  p4est_inspect_t    *in = p4est->inspect;
+
+  P4EST_ASSERT (in != NULL);
+  if (!in->balance_autotune || in->balance_autotune_quads > 0) {
+    return;
+  }
+  in->balance_autotune_cost[in->use_balance_ranges ? 1 : 0] +=
+    in->balance_comm;
+  if (++in->balance_autotune_calls >= 2 * P4EST_BALANCE_AUTOTUNE_TRIALS) {
+    mpiret = sc_MPI_Allreduce (in->balance_autotune_cost, gcost, 2,
+                               sc_MPI_DOUBLE, sc_MPI_SUM, p4est->mpicomm);
+    SC_CHECK_MPI (mpiret);
+    in->use_balance_ranges = gcost[1] < gcost[0];
+    in->balance_autotune_quads = p4est->global_num_quadrants;
+    P4EST_GLOBAL_INFOF ("Balance autotune locked %s: %.3g vs %.3g s\n",
+                        in->use_balance_ranges ? "ranges" : "notify",
+                        gcost[1], gcost[0]);
+  }
+}
+
+#endif /* P4EST_ENABLE_MPI */
+
+static void
+p4est_balance_internal (p4est_t * p4est, p4est_connect_type_t btype,
+                        p4est_init_t init_fn, p4est_replace_t replace_fn,
+                        const int8_t * dirty_trees)
+{
+  const int           rank = p4est->mpirank;
+  const int           num_procs = p4est->mpisize;
+  int                 j, k, l, m, which;
+  int                 face;
+  int                 first_peer, last_peer;
+  int                 quad_contact[P4EST_FACES];
+  int                 any_face, tree_contact[P4EST_FACES];
+  int                 tree_fully_owned, full_tree[2];
+  int8_t             *tree_flags;
+  size_t              zz, treecount, ctree;
+  size_t              localcount;
+  size_t             *journal_counts;
+  size_t              all_incount, all_outcount;
+  p4est_qcoord_t      qh;
+  const p4est_qcoord_t rh = P4EST_ROOT_LEN;
+  p4est_topidx_t      qtree, nt;
+  p4est_topidx_t      first_tree, last_tree;
+  p4est_locidx_t      skipped;
+  p4est_gloidx_t      old_gnq;
+  p4est_balance_peer_t *peers, *peer;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t    mylow, nextlow;
+  p4est_quadrant_t    tosend, insulq, tempq;
+  p4est_quadrant_t   *q, *s;
+  p4est_connectivity_t *conn = p4est->connectivity;
+  sc_array_t         *qarray, *tquadrants;
+  sc_array_t         *borders;
+  p4est_workspace_t  *ws;
+#ifdef P4EST_ENABLE_DEBUG
+  size_t              data_pool_size;
+#endif
+  int                 ftransform[P4EST_FTRANSFORM];
+  int                 face_axis[3];     /* 3 not P4EST_DIM */
+  int                 contact_face_only, contact_edge_only;
+#ifdef P4_TO_P8
+  int                 edge;
+  size_t              etree;
+  p8est_edge_info_t   ei;
+  p8est_edge_transform_t *et;
+  sc_array_t         *eta;
+#endif
+  int                 corner;
+  p4est_corner_info_t ci;
+  p4est_corner_transform_t *ct;
+  sc_array_t         *cta;
+#ifdef P4EST_ENABLE_MPI
+#ifdef P4EST_ENABLE_DEBUG
+  unsigned            checksum;
+  sc_array_t          checkarray;
+  p4est_gloidx_t      ltotal[2], gtotal[2];
+#endif /* P4EST_ENABLE_DEBUG */
+  int                 i;
+  int                 mpiret, rcount;
+  int                 first_bound;
+  int                 request_first_count, request_second_count, outcount;
+  int                 request_send_count, total_send_count, total_recv_count;
+  int                 self_done;
+  int8_t             *merged;
+  size_t              qcount, qbytes;
+  int                 nwin, maxpeers, maxwin, twomaxwin;
+  int                 send_zero[2], send_load[2];
+  int                 recv_zero[2], recv_load[2];
+  int                 my_ranges[2 * p4est_num_ranges];
+  int                *wait_indices;
+  int                *procs, *all_ranges;
+  int                *receiver_ranks, *sender_ranks;
+  int                 num_receivers, num_senders;
+  int                *receiver_ranks_ranges, *sender_ranks_ranges;
+  int                 num_receivers_ranges, num_senders_ranges;
+  int                *receiver_ranks_notify, *sender_ranks_notify;
+  int                 num_receivers_notify, num_senders_notify;
+  int                 is_ranges_primary, is_balance_verify;
+  int                 is_ranges_active, is_notify_active;
+  int                 max_ranges;
+  MPI_Request        *requests_first, *requests_second;
+  MPI_Request        *send_requests_first_count, *send_requests_first_load;
+  MPI_Request        *send_requests_second_count, *send_requests_second_load;
+  MPI_Status         *recv_statuses, *jstatus;
+#endif /* P4EST_ENABLE_MPI */
+
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING
+                            "_balance %s with %lld total quadrants\n",
+                            p4est_connect_type_string (btype),
+                            (long long) p4est->global_num_quadrants);
+  p4est_log_indent_push ();
+  P4EST_ASSERT (p4est_is_valid (p4est));
+#ifndef P4_TO_P8
+  P4EST_ASSERT (btype == P4EST_CONNECT_FACE || btype == P4EST_CONNECT_CORNER);
+#else
+  P4EST_ASSERT (btype == P8EST_CONNECT_FACE || btype == P8EST_CONNECT_EDGE ||
+                btype == P8EST_CONNECT_CORNER);
+#endif
+
+  /* remember input quadrant count; it will not decrease */
+  old_gnq = p4est->global_num_quadrants;
+
+#ifdef P4EST_ENABLE_DEBUG
+  data_pool_size = 0;
+  if (p4est->user_data_pool != NULL) {
+    data_pool_size = p4est->user_data_pool->elem_count;
+  }
+#endif
+
+  P4EST_QUADRANT_INIT (&mylow);
+  P4EST_QUADRANT_INIT (&nextlow);
+  P4EST_QUADRANT_INIT (&tosend);
+  P4EST_QUADRANT_INIT (&insulq);
+  P4EST_QUADRANT_INIT (&tempq);
+
+  /* tree status flags (max 8 per tree) */
+  tree_flags = P4EST_ALLOC (int8_t, conn->num_trees);
+  for (nt = 0; nt < conn->num_trees; ++nt) {
+    tree_flags[nt] = 0x00;
+  }
+
+  localcount = (size_t) (p4est->last_local_tree + 1 -
+                         p4est->first_local_tree);
+  journal_counts = NULL;
+  if (p4est->inspect != NULL && p4est->inspect->journal != NULL) {
+    /* remember the tree sizes to identify the changed trees at the end */
+    journal_counts = P4EST_ALLOC (size_t, localcount);
+    for (nt = p4est->first_local_tree; nt <= p4est->last_local_tree; ++nt) {
+      tree = p4est_tree_array_index (p4est->trees, nt);
+      journal_counts[nt - p4est->first_local_tree] =
+        tree->quadrants.elem_count;
+    }
+  }
+  ws = p4est_workspace_get (p4est);
+  if (ws != NULL) {
+    /* reuse the border arrays from previous balance calls; the
+     * container only ever grows so no per-tree memory is orphaned */
+    if (ws->balance_borders == NULL) {
+      ws->balance_borders = sc_array_new (sizeof (sc_array_t));
+    }
+    borders = ws->balance_borders;
+    zz = borders->elem_count;
+    if (zz < localcount) {
+      sc_array_resize (borders, localcount);
+      for (; zz < localcount; zz++) {
+        qarray = (sc_array_t *) sc_array_index (borders, zz);
+        sc_array_init (qarray, sizeof (p4est_quadrant_t));
+      }
+    }
+  }
+  else {
+    borders = sc_array_new_size (sizeof (sc_array_t), localcount);
+    for (zz = 0; zz < localcount; zz++) {
+      qarray = (sc_array_t *) sc_array_index (borders, zz);
+      sc_array_init (qarray, sizeof (p4est_quadrant_t));
+    }
+  }
+
+#ifdef P4EST_ENABLE_MPI
+  requests_first = P4EST_ALLOC (MPI_Request, 6 * num_procs);
+  requests_second = requests_first + 1 * num_procs;
+  send_requests_first_count = requests_first + 2 * num_procs;
+  send_requests_first_load = requests_first + 3 * num_procs;
+  send_requests_second_count = requests_first + 4 * num_procs;
+  send_requests_second_load = requests_first + 5 * num_procs;
+  recv_statuses = P4EST_ALLOC (MPI_Status, num_procs);
+  for (j = 0; j < num_procs; ++j) {
+    requests_first[j] = requests_second[j] = MPI_REQUEST_NULL;
+    send_requests_first_count[j] = MPI_REQUEST_NULL;
+    send_requests_first_load[j] = MPI_REQUEST_NULL;
+    send_requests_second_count[j] = MPI_REQUEST_NULL;
+    send_requests_second_load[j] = MPI_REQUEST_NULL;
+  }
+  wait_indices = P4EST_ALLOC (int, num_procs);
+#ifdef P4EST_ENABLE_DEBUG
+  sc_array_init (&checkarray, 4);
+#endif /* P4EST_ENABLE_DEBUG */
+#endif /* P4EST_ENABLE_MPI */
+
+  /* allocate per peer storage and initialize requests */
+  peers = P4EST_ALLOC (p4est_balance_peer_t, num_procs);
+  for (j = 0; j < num_procs; ++j) {
+    peer = peers + j;
+    sc_array_init (&peer->send_first, sizeof (p4est_quadrant_t));
+    sc_array_init (&peer->send_second, sizeof (p4est_quadrant_t));
+    sc_array_init (&peer->recv_first, sizeof (p4est_quadrant_t));
+    sc_array_init (&peer->recv_second, sizeof (p4est_quadrant_t));
+    sc_array_init (&peer->send_first_wire, 1);
+    sc_array_init (&peer->send_second_wire, 1);
+    sc_array_init (&peer->recv_first_wire, 1);
+    sc_array_init (&peer->recv_second_wire, 1);
+    peer->send_first_count = peer->send_second_count = 0;
+    peer->recv_first_count = peer->recv_second_count = 0;
+    peer->have_first_count = peer->have_first_load = 0;
+    peer->have_second_count = peer->have_second_load = 0;
+  }
+#ifdef P4_TO_P8
+  eta = &ei.edge_transforms;
+  sc_array_init (eta, sizeof (p8est_edge_transform_t));
+#endif
+  cta = &ci.corner_transforms;
+  sc_array_init (cta, sizeof (p4est_corner_transform_t));
+
+  /* compute first quadrant on finest level */
+  mylow.x = p4est->global_first_position[rank].x;
+  mylow.y = p4est->global_first_position[rank].y;
+#ifdef P4_TO_P8
+  mylow.z = p4est->global_first_position[rank].z;
+#endif
+  mylow.level = P4EST_QMAXLEVEL;
+
+  /* and the first finest quadrant of the next processor */
+  nextlow.x = p4est->global_first_position[rank + 1].x;
+  nextlow.y = p4est->global_first_position[rank + 1].y;
+#ifdef P4_TO_P8
+  nextlow.z = p4est->global_first_position[rank + 1].z;
+#endif
+  nextlow.level = P4EST_QMAXLEVEL;
+
+  /* start balance_A timing */
+  P4EST_PHASE_BEGIN (P4EST_STRING "_balance_A");
+  if (p4est->inspect != NULL) {
+    p4est->inspect->balance_A = -sc_MPI_Wtime ();
+    p4est->inspect->balance_A_count_in = 0;
+    p4est->inspect->balance_A_count_out = 0;
+    p4est->inspect->use_B = 0;
+  }
+
+  /* local balance first pass over all trees; the trees are independent
+   * in this pass and their search phase may run on a thread pool */
+  first_tree = p4est->first_local_tree;
+  last_tree = p4est->last_local_tree;
+  all_incount = 0;
+  for (nt = first_tree; nt <= last_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    all_incount += tree->quadrants.elem_count;
+    P4EST_VERBOSEF ("Into balance tree %lld with %llu\n", (long long) nt,
+                    (unsigned long long) tree->quadrants.elem_count);
+  }
+  p4est_balance_subtrees (p4est, btype, init_fn, replace_fn, dirty_trees);
+
+  /* loop over all local trees to assemble first send list */
+  first_peer = num_procs;
+  last_peer = -1;
+  skipped = 0;
+  for (nt = first_tree; nt <= last_tree; ++nt) {
+    p4est_comm_tree_info (p4est, nt, full_tree, tree_contact, NULL, NULL);
+    tree_fully_owned = full_tree[0] && full_tree[1];
+    any_face = 0;
+    for (face = 0; face < P4EST_FACES; ++face) {
+      any_face = any_face || tree_contact[face];
+    }
+    if (any_face) {
+      tree_flags[nt] |= any_face_flag;
+    }
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    tquadrants = &tree->quadrants;
+    treecount = tquadrants->elem_count;
+    P4EST_VERBOSEF ("Balance tree %lld A %llu\n",
+                    (long long) nt, (unsigned long long) treecount);
+
+    /* check if this tree is not shared with other processors */
+    if (tree_fully_owned) {
+      /* all quadrants in this tree are owned by me */
+      tree_flags[nt] |= fully_owned_flag;
+      if (!any_face) {
+        /* this tree is isolated, no balance between trees */
+        continue;
+      }
+    }
+
+    if (borders != NULL) {
+      qarray = (sc_array_t *) sc_array_index (borders,
+                                              (size_t) (nt - first_tree));
+    }
+    else {
+      qarray = NULL;
+    }
+
+    /* identify boundary quadrants and prepare them to be sent */
+    for (zz = 0; zz < treecount; ++zz) {
+      /* this quadrant may be on the boundary with a range of processors */
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      qh = P4EST_QUADRANT_LEN (q->level);
+      if (p4est_comm_neighborhood_owned (p4est, nt,
+                                         full_tree, tree_contact, q)) {
+        /* this quadrant's 3x3 neighborhood is owned by this processor */
+        ++skipped;
+        continue;
+      }
+
+      if (qarray != NULL) {
+        s = (p4est_quadrant_t *) sc_array_push (qarray);
+        *s = *q;
+      }
+
+#ifdef P4_TO_P8
+      for (m = 0; m < 3; ++m) {
+#if 0
+      }
+#endif
+#else
+      m = 0;
+#endif
+      for (k = 0; k < 3; ++k) {
+        for (l = 0; l < 3; ++l) {
+          which = m * 9 + k * 3 + l;    /* 2D: 0..8, 3D: 0..26 */
+          /* exclude myself from the queries */
+          if (which == P4EST_INSUL / 2) {
+            continue;
+          }
+          /* may modify insulq below, never modify q itself! */
+          insulq = *q;
+          insulq.x += (l - 1) * qh;
+          insulq.y += (k - 1) * qh;
+#ifdef P4_TO_P8
+          insulq.z += (m - 1) * qh;
+#endif
+          /* check boundary status of insulation quadrant */
+          quad_contact[0] = (insulq.x < 0);
+          quad_contact[1] = (insulq.x >= rh);
+          face_axis[0] = quad_contact[0] || quad_contact[1];
+          quad_contact[2] = (insulq.y < 0);
+          quad_contact[3] = (insulq.y >= rh);
+          face_axis[1] = quad_contact[2] || quad_contact[3];
+#ifndef P4_TO_P8
+          face_axis[2] = 0;
+#else
+          quad_contact[4] = (insulq.z < 0);
+          quad_contact[5] = (insulq.z >= rh);
+          face_axis[2] = quad_contact[4] || quad_contact[5];
+          edge = -1;
+#endif
+          contact_edge_only = contact_face_only = 0;
+          face = -1;
+          if (face_axis[0] || face_axis[1] || face_axis[2]) {
+            /* this quadrant is relevant for inter-tree balancing */
+            if (!face_axis[1] && !face_axis[2]) {
+              contact_face_only = 1;
+              face = 0 + quad_contact[1];
+            }
+            else if (!face_axis[0] && !face_axis[2]) {
+              contact_face_only = 1;
+              face = 2 + quad_contact[3];
+            }
+#ifdef P4_TO_P8
+            else if (!face_axis[0] && !face_axis[1]) {
+              contact_face_only = 1;
+              face = 4 + quad_contact[5];
+            }
+            else if (!face_axis[0]) {
               contact_edge_only = 1;
               edge = 0 + 2 * quad_contact[5] + quad_contact[3];
             }
-            else if (!face_axis[1]) {
-              contact_edge_only = 1;
-              edge = 4 + 2 * quad_contact[5] + quad_contact[1];
+            else if (!face_axis[1]) {
+              contact_edge_only = 1;
+              edge = 4 + 2 * quad_contact[5] + quad_contact[1];
+            }
+            else if (!face_axis[2]) {
+              contact_edge_only = 1;
+              edge = 8 + 2 * quad_contact[3] + quad_contact[1];
+            }
+#endif
+            if (contact_face_only) {
+              /* square contact across a face */
+              P4EST_ASSERT (!contact_edge_only);
+              P4EST_ASSERT (face >= 0 && face < P4EST_FACES);
+              P4EST_ASSERT (quad_contact[face]);
+              qtree = p4est_find_face_transform (conn, nt, face, ftransform);
+              if (qtree >= 0) {
+                P4EST_ASSERT (tree_contact[face]);
+                p4est_quadrant_transform_face (q, &tosend, ftransform);
+                tosend.p.piggy2.from_tree = nt;
+                tosend.pad16 = face;
+                p4est_quadrant_transform_face (&insulq, &tempq, ftransform);
+                p4est_balance_schedule (p4est, peers, qtree, 1,
+                                        &tosend, &tempq,
+                                        &first_peer, &last_peer);
+              }
+              else {
+                /* goes across a face with no neighbor */
+                P4EST_ASSERT (!tree_contact[face]);
+              }
+            }
+#ifdef P4_TO_P8
+            else if (contact_edge_only) {
+              /* this quadrant crosses an edge */
+              P4EST_ASSERT (!contact_face_only);
+              P4EST_ASSERT (edge >= 0 && edge < P8EST_EDGES);
+              p8est_find_edge_transform (conn, nt, edge, &ei);
+              for (etree = 0; etree < eta->elem_count; ++etree) {
+                et = p8est_edge_array_index (eta, etree);
+                p8est_quadrant_transform_edge (q, &tosend, &ei, et, 0);
+                tosend.p.piggy2.from_tree = nt;
+                tosend.pad16 = edge;
+                p8est_quadrant_transform_edge (&insulq, &tempq, &ei, et, 1);
+                p4est_balance_schedule (p4est, peers, et->ntree, 1,
+                                        &tosend, &tempq,
+                                        &first_peer, &last_peer);
+              }
+            }
+#endif
+            else {
+              /* this quadrant crosses a corner */
+              P4EST_ASSERT (face_axis[0] && face_axis[1]);
+              corner = quad_contact[1] + 2 * quad_contact[3];
+#ifdef P4_TO_P8
+              P4EST_ASSERT (face_axis[2]);
+              corner += 4 * quad_contact[5];
+#endif
+              P4EST_ASSERT (p4est_quadrant_touches_corner (q, corner, 1));
+              P4EST_ASSERT (p4est_quadrant_touches_corner
+                            (&insulq, corner, 0));
+              p4est_find_corner_transform (conn, nt, corner, &ci);
+              for (ctree = 0; ctree < cta->elem_count; ++ctree) {
+                ct = p4est_corner_array_index (cta, ctree);
+                tosend = *q;
+                p4est_quadrant_transform_corner (&tosend, (int) ct->ncorner,
+                                                 0);
+                tosend.p.piggy2.from_tree = nt;
+                tosend.pad16 = corner;
+                tempq = insulq;
+                p4est_quadrant_transform_corner (&tempq, (int) ct->ncorner,
+                                                 1);
+                p4est_balance_schedule (p4est, peers, ct->ntree, 1,
+                                        &tosend, &tempq, &first_peer,
+                                        &last_peer);
+              }
+            }
+          }
+          else {
+            /* no inter-tree contact */
+            tosend = *q;
+            tosend.p.piggy2.from_tree = nt;
+            tosend.pad16 = -1;
+            p4est_balance_schedule (p4est, peers, nt, 0,
+                                    &tosend, &insulq, &first_peer,
+                                    &last_peer);
+          }
+        }
+      }
+#ifdef P4_TO_P8
+#if 0
+      {
+#endif
+      }
+#endif
+    }
+    tquadrants = NULL;          /* safeguard */
+  }
+
+  /* end balance_A, start balance_comm */
+  P4EST_PHASE_END (P4EST_STRING "_balance_A");
+  P4EST_PHASE_BEGIN (P4EST_STRING "_balance_comm");
+#ifdef P4EST_ENABLE_MPI
+  is_ranges_primary = 0;
+  is_ranges_active = 0;
+  is_notify_active = 1;
+  is_balance_verify = 0;
+#endif
+  if (p4est->inspect != NULL) {
+    p4est->inspect->balance_A += sc_MPI_Wtime ();
+    p4est->inspect->balance_memory_peak =
+      SC_MAX (p4est->inspect->balance_memory_peak, p4est_memory_used (p4est));
+    p4est->inspect->balance_comm = -sc_MPI_Wtime ();
+    p4est->inspect->balance_comm_sent = 0;
+    p4est->inspect->balance_comm_nzpeers = 0;
+    for (k = 0; k < 2; ++k) {
+      p4est->inspect->balance_zero_sends[k] = 0;
+      p4est->inspect->balance_zero_receives[k] = 0;
+    }
+    p4est->inspect->balance_ranges = 0.;
+    p4est->inspect->balance_notify = 0.;
+    p4est->inspect->balance_notify_allgather = 0.;
+#ifdef P4EST_ENABLE_MPI
+    p4est_balance_autotune_select (p4est);
+    is_ranges_primary = p4est->inspect->use_balance_ranges;
+    is_ranges_active = is_ranges_primary;
+    is_notify_active = !is_ranges_primary;
+    if (p4est->inspect->use_balance_ranges_notify) {
+      is_ranges_active = is_notify_active = 1;
+    }
+    is_balance_verify = p4est->inspect->use_balance_verify;
+#endif
+  }
+
+#ifdef P4EST_ENABLE_MPI
+  /* encode and distribute the asymmetric communication pattern */
+  procs = NULL;
+  receiver_ranks = sender_ranks = NULL;
+  num_receivers = num_senders = 0;
+  receiver_ranks_ranges = sender_ranks_ranges = NULL;
+  num_receivers_ranges = num_senders_ranges = 0;
+  receiver_ranks_notify = sender_ranks_notify = NULL;
+  num_receivers_notify = num_senders_notify = 0;
+
+  /* determine asymmetric communication pattern by sc_ranges function */
+  if (is_ranges_active) {
+    procs = P4EST_ALLOC (int, num_procs);
+    receiver_ranks_ranges = P4EST_ALLOC (int, num_procs);
+    sender_ranks_ranges = P4EST_ALLOC (int, num_procs);
+
+    for (j = 0; j < num_procs; ++j) {
+      procs[j] = (int) peers[j].send_first.elem_count;
+    }
+    maxpeers = first_peer;
+    maxwin = last_peer;
+    max_ranges = p4est_num_ranges;
+    if (p4est->inspect != NULL) {
+      if (p4est->inspect->balance_max_ranges > 0 &&
+          p4est->inspect->balance_max_ranges < p4est_num_ranges) {
+        max_ranges = p4est->inspect->balance_max_ranges;
+      }
+      p4est->inspect->balance_ranges = -MPI_Wtime ();
+    }
+    nwin = sc_ranges_adaptive (p4est_package_id,
+                               p4est->mpicomm, procs, &maxpeers, &maxwin,
+                               max_ranges, my_ranges, &all_ranges);
+    twomaxwin = 2 * maxwin;
+    if (p4est->inspect != NULL) {
+      p4est->inspect->balance_ranges += MPI_Wtime ();
+    }
+    sc_ranges_decode (num_procs, rank, maxwin, all_ranges,
+                      &num_receivers_ranges, receiver_ranks_ranges,
+                      &num_senders_ranges, sender_ranks_ranges);
+    if (is_balance_verify) {
+      /* verification written after using sc_ranges_decode */
+      k = 0;
+      for (j = 0; j < num_procs; ++j) {
+        if (j == rank) {
+          continue;
+        }
+        if (procs[j] > 0) {
+          P4EST_ASSERT (k < num_receivers_ranges &&
+                        receiver_ranks_ranges[k] == j);
+          ++k;
+        }
+        else {
+          if (k < num_receivers_ranges && receiver_ranks_ranges[k] == j) {
+            ++k;
+          }
+        }
+      }
+      P4EST_ASSERT (k == num_receivers_ranges);
+
+      /* original verification loop modified and partially redundant */
+      k = 0;
+      for (j = first_peer; j <= last_peer; ++j) {
+        if (j == rank) {
+          P4EST_ASSERT (k == num_receivers_ranges ||
+                        receiver_ranks_ranges[k] != j);
+          continue;
+        }
+        peer = peers + j;
+        qcount = peer->send_first.elem_count;
+
+        for (i = 0; i < nwin - 1; ++i) {
+          if (j > my_ranges[2 * i + 1] && j < my_ranges[2 * (i + 1)]) {
+            break;
+          }
+        }
+        if (i < nwin - 1) {
+          P4EST_ASSERT (qcount == 0);
+          P4EST_ASSERT (k == num_receivers_ranges ||
+                        receiver_ranks_ranges[k] != j);
+          continue;
+        }
+        P4EST_ASSERT (k < num_receivers_ranges &&
+                      receiver_ranks_ranges[k] == j);
+        ++k;
+      }
+      P4EST_ASSERT (k == num_receivers_ranges);
+
+      /* original verification loop of who is sending to me */
+      k = 0;
+      for (j = 0; j < num_procs; ++j) {
+        if (j == rank) {
+          P4EST_ASSERT (k == num_senders_ranges ||
+                        sender_ranks_ranges[k] != j);
+          continue;
+        }
+        for (i = 0; i < maxwin; ++i) {
+          first_bound = all_ranges[twomaxwin * j + 2 * i];
+          if (first_bound == -1 || first_bound > rank) {
+            P4EST_ASSERT (k == num_senders_ranges ||
+                          sender_ranks_ranges[k] != j);
+            break;
+          }
+          if (rank <= all_ranges[twomaxwin * j + 2 * i + 1]) {
+            /* processor j is sending to me */
+            P4EST_ASSERT (k < num_senders_ranges &&
+                          sender_ranks_ranges[k] == j);
+            ++k;
+            break;
+          }
+        }
+      }
+      P4EST_ASSERT (k == num_senders_ranges);
+    }
+#ifdef P4EST_ENABLE_DEBUG
+    P4EST_GLOBAL_STATISTICSF ("Max peers %d ranges %d/%d\n",
+                              maxpeers, maxwin, max_ranges);
+    sc_ranges_statistics (p4est_package_id, SC_LP_STATISTICS,
+                          p4est->mpicomm, num_procs, procs,
+                          rank, max_ranges, my_ranges);
+#endif
+    SC_FREE (all_ranges);
+    P4EST_FREE (procs);
+    P4EST_VERBOSEF ("Peer ranges %d/%d/%d first %d last %d\n",
+                    nwin, maxwin, max_ranges, first_peer, last_peer);
+  }
+
+  /* determine asymmetric communication pattern by sc_notify function */
+  if (is_notify_active) {
+    receiver_ranks_notify = P4EST_ALLOC (int, num_procs);
+    sender_ranks_notify = P4EST_ALLOC (int, num_procs);
+    num_receivers_notify = num_senders_notify = 0;
+
+    for (j = 0; j < num_procs; ++j) {
+      if (j != rank && peers[j].send_first.elem_count > 0) {
+        receiver_ranks_notify[num_receivers_notify++] = j;
+      }
+    }
+    if (p4est->inspect != NULL) {
+      p4est->inspect->balance_notify = -MPI_Wtime ();
+    }
+    mpiret = sc_notify (receiver_ranks_notify, num_receivers_notify,
+                        sender_ranks_notify, &num_senders_notify,
+                        p4est->mpicomm);
+    SC_CHECK_MPI (mpiret);
+    if (p4est->inspect != NULL) {
+      p4est->inspect->balance_notify += MPI_Wtime ();
+    }
+
+    /* double-check sc_notify results by sc_notify_allgather */
+    if (is_balance_verify) {
+      int                *sender_ranks2, num_senders2;
+
+      sender_ranks2 = P4EST_ALLOC (int, num_procs);
+      if (p4est->inspect != NULL) {
+        p4est->inspect->balance_notify_allgather = -MPI_Wtime ();
+      }
+      mpiret = sc_notify_allgather (receiver_ranks_notify,
+                                    num_receivers_notify,
+                                    sender_ranks2, &num_senders2,
+                                    p4est->mpicomm);
+      SC_CHECK_MPI (mpiret);
+      if (p4est->inspect != NULL) {
+        p4est->inspect->balance_notify_allgather += MPI_Wtime ();
+      }
+
+      /* run verification against sc_notify_allgather */
+      SC_CHECK_ABORT (num_senders2 == num_senders_notify,
+                      "Failed notify_allgather sender count");
+      for (j = 0; j < num_senders_notify; ++j) {
+        SC_CHECK_ABORT (sender_ranks2[j] == sender_ranks_notify[j],
+                        "Failed notify_allgather sender rank");
+      }
+      P4EST_FREE (sender_ranks2);
+    }
+  }
+
+  /* verify sc_ranges and sc_notify against each other */
+  if (is_ranges_active && is_notify_active && is_balance_verify) {
+#ifdef P4EST_ENABLE_DEBUG
+    int                 found_in_ranges, found_in_notify;
+#endif
+
+    /* verify receiver side */
+    P4EST_ASSERT (num_receivers_notify <= num_receivers_ranges);
+    k = l = 0;
+    for (j = 0; j < num_procs; ++j) {
+      P4EST_DEBUG_EXECUTE (found_in_ranges = found_in_notify = 0);
+      if (k < num_receivers_ranges && receiver_ranks_ranges[k] == j) {
+        P4EST_ASSERT (j != rank);
+        P4EST_DEBUG_EXECUTE (found_in_ranges = 1);
+        ++k;
+      }
+      if (l < num_receivers_notify && receiver_ranks_notify[l] == j) {
+        P4EST_ASSERT (j != rank && found_in_ranges);
+        P4EST_DEBUG_EXECUTE (found_in_notify = 1);
+        ++l;
+      }
+      if (j != rank && peers[j].send_first.elem_count > 0) {
+        P4EST_ASSERT (found_in_ranges && found_in_notify);
+      }
+      if (peers[j].send_first.elem_count == 0) {
+        P4EST_ASSERT (!found_in_notify);
+      }
+    }
+    P4EST_ASSERT (k == num_receivers_ranges);
+    P4EST_ASSERT (l == num_receivers_notify);
+
+    /* verify sender side */
+    P4EST_ASSERT (num_senders_notify <= num_senders_ranges);
+    k = l = 0;
+    for (j = 0; j < num_procs; ++j) {
+      P4EST_DEBUG_EXECUTE (found_in_ranges = found_in_notify = 0);
+      if (k < num_senders_ranges && sender_ranks_ranges[k] == j) {
+        P4EST_ASSERT (j != rank);
+        P4EST_DEBUG_EXECUTE (found_in_ranges = 1);
+        ++k;
+      }
+      if (l < num_senders_notify && sender_ranks_notify[l] == j) {
+        P4EST_ASSERT (j != rank && found_in_ranges);
+        P4EST_DEBUG_EXECUTE (found_in_notify = 1);      /* for symmetry */
+        ++l;
+      }
+    }
+    P4EST_ASSERT (k == num_senders_ranges);
+    P4EST_ASSERT (l == num_senders_notify);
+  }
+
+  /*
+   * loop over all peers and send first round of quadrants
+   * for intra-tree balancing, each load is contained in one tree
+   */
+  total_send_count = total_recv_count = 0;
+  request_first_count = request_second_count = request_send_count = 0;
+  send_zero[0] = send_load[0] = recv_zero[0] = recv_load[0] = 0;
+  send_zero[1] = send_load[1] = recv_zero[1] = recv_load[1] = 0;
+  if (is_ranges_primary) {
+    P4EST_ASSERT (is_ranges_active);
+    receiver_ranks = receiver_ranks_ranges;
+    sender_ranks = sender_ranks_ranges;
+    num_receivers = num_receivers_ranges;
+    num_senders = num_senders_ranges;
+  }
+  else {
+    P4EST_ASSERT (is_notify_active);
+    receiver_ranks = receiver_ranks_notify;
+    sender_ranks = sender_ranks_notify;
+    num_receivers = num_receivers_notify;
+    num_senders = num_senders_notify;
+  }
+  P4EST_ASSERT (receiver_ranks != NULL && sender_ranks != NULL);
+  num_receivers_ranges = num_senders_ranges = 0;
+  num_receivers_notify = num_senders_notify = 0;
+
+  /* Use receiver_ranks array to send to them */
+  for (k = 0; k < num_receivers; ++k) {
+    j = receiver_ranks[k];
+    P4EST_ASSERT (j >= first_peer && j <= last_peer && j != rank);
+    peer = peers + j;
+    qcount = peer->send_first.elem_count;
+
+    /* first send number of quadrants to be expected */
+    if (qcount > 0) {
+      P4EST_LDEBUGF ("Balance A send %llu quadrants to %d\n",
+                     (unsigned long long) qcount, j);
+      ++send_load[0];
+    }
+    else {
+      P4EST_ASSERT (is_ranges_primary);
+      ++send_zero[0];
+    }
+    peer->send_first_count = (int) qcount;
+    mpiret = MPI_Isend (&peer->send_first_count, 1, MPI_INT,
+                        j, P4EST_COMM_BALANCE_FIRST_COUNT,
+                        p4est->mpicomm, &send_requests_first_count[j]);
+    SC_CHECK_MPI (mpiret);
+    ++request_send_count;
+
+    /* sort and send the actual quadrants and post receive for reply */
+    if (qcount > 0) {
+      p4est_quadrant_array_sort (&peer->send_first,
+                                 p4est_quadrant_compare_piggy);
+
+#ifdef P4EST_ENABLE_DEBUG
+      checksum = p4est_quadrant_checksum (&peer->send_first, &checkarray, 0);
+      P4EST_LDEBUGF ("Balance A send checksum 0x%08x to %d\n", checksum, j);
+#endif /* P4EST_ENABLE_DEBUG */
+
+      total_send_count += qcount;
+      p4est_balance_wire_pack (&peer->send_first, 1, &peer->send_first_wire);
+      mpiret = MPI_Isend (peer->send_first_wire.array,
+                          (int) peer->send_first_wire.elem_count, MPI_BYTE,
+                          j, P4EST_COMM_BALANCE_FIRST_LOAD,
+                          p4est->mpicomm, &send_requests_first_load[j]);
+      SC_CHECK_MPI (mpiret);
+      ++request_send_count;
+      mpiret = MPI_Irecv (&peer->recv_second_count, 1, MPI_INT,
+                          j, P4EST_COMM_BALANCE_SECOND_COUNT,
+                          p4est->mpicomm, &requests_second[j]);
+      SC_CHECK_MPI (mpiret);
+      ++request_second_count;
+    }
+  }
+  peer = NULL;
+  P4EST_FREE (receiver_ranks_ranges);
+  P4EST_FREE (receiver_ranks_notify);
+  receiver_ranks = receiver_ranks_ranges = receiver_ranks_notify = NULL;
+
+  /* find out who is sending to me and receive quadrant counts */
+  for (k = 0; k < num_senders; ++k) {
+    j = sender_ranks[k];
+    ++request_first_count;
+    mpiret = MPI_Irecv (&peers[j].recv_first_count, 1, MPI_INT,
+                        j, P4EST_COMM_BALANCE_FIRST_COUNT,
+                        p4est->mpicomm, &requests_first[j]);
+    SC_CHECK_MPI (mpiret);
+  }
+  P4EST_FREE (sender_ranks_ranges);
+  P4EST_FREE (sender_ranks_notify);
+  sender_ranks = sender_ranks_ranges = sender_ranks_notify = NULL;
+
+  /* wait for quadrant counts and post receive and send for quadrants;
+   * while no message has landed, donate the wait time to the local
+   * cross-tree work instead of blocking idle */
+  self_done = 0;
+  while (request_first_count > 0) {
+    if (!self_done) {
+      mpiret = MPI_Testsome (num_procs, requests_first,
+                             &outcount, wait_indices, recv_statuses);
+      SC_CHECK_MPI (mpiret);
+      P4EST_ASSERT (outcount != MPI_UNDEFINED);
+      if (outcount == 0) {
+        /* nothing is ready yet: simulate send and receive with
+         * myself across tree boundaries in the meantime */
+        p4est_balance_self_response (p4est, peers + rank, btype, borders);
+        self_done = 1;
+        continue;
+      }
+    }
+    else {
+      mpiret = MPI_Waitsome (num_procs, requests_first,
+                             &outcount, wait_indices, recv_statuses);
+      SC_CHECK_MPI (mpiret);
+      P4EST_ASSERT (outcount != MPI_UNDEFINED);
+      P4EST_ASSERT (outcount > 0);
+    }
+    for (i = 0; i < outcount; ++i) {
+      /* retrieve sender's rank */
+      j = wait_indices[i];
+      jstatus = &recv_statuses[i];
+      wait_indices[i] = -1;
+      P4EST_ASSERT (j != rank && 0 <= j && j < num_procs);
+      P4EST_ASSERT (requests_first[j] == MPI_REQUEST_NULL);
+      P4EST_ASSERT (jstatus->MPI_SOURCE == j);
+
+      /* check if we are in receiving count or load */
+      peer = peers + j;
+      P4EST_ASSERT (!peer->have_first_load);
+      if (!peer->have_first_count) {
+        /* verify message size */
+        P4EST_ASSERT (jstatus->MPI_TAG == P4EST_COMM_BALANCE_FIRST_COUNT);
+        mpiret = MPI_Get_count (jstatus, MPI_INT, &rcount);
+        SC_CHECK_MPI (mpiret);
+        SC_CHECK_ABORTF (rcount == 1, "Receive count mismatch A %d", rcount);
+
+        /* process the count information received */
+        peer->have_first_count = 1;
+        qcount = (size_t) peer->recv_first_count;
+        if (qcount > 0) {
+          /* received nonzero count, post receive for load */
+          P4EST_LDEBUGF ("Balance A recv %llu quadrants from %d\n",
+                         (unsigned long long) qcount, j);
+          P4EST_ASSERT (peer->recv_first.elem_count == 0);
+          sc_array_resize (&peer->recv_first, qcount);
+          total_recv_count += qcount;
+          qbytes = p4est_balance_wire_bound (qcount, 1);
+          sc_array_resize (&peer->recv_first_wire, qbytes);
+          P4EST_ASSERT (requests_first[j] == MPI_REQUEST_NULL);
+          mpiret = MPI_Irecv (peer->recv_first_wire.array, (int) qbytes,
+                              MPI_BYTE, j, P4EST_COMM_BALANCE_FIRST_LOAD,
+                              p4est->mpicomm, &requests_first[j]);
+          SC_CHECK_MPI (mpiret);
+          ++recv_load[0];
+        }
+        else {
+          /* will not receive load, close this request */
+          P4EST_ASSERT (qcount == 0);
+          P4EST_ASSERT (requests_first[j] == MPI_REQUEST_NULL);
+          --request_first_count;
+          ++recv_zero[0];
+        }
+      }
+      else {
+        /* verify received size */
+        P4EST_ASSERT (jstatus->MPI_TAG == P4EST_COMM_BALANCE_FIRST_LOAD);
+        P4EST_ASSERT (peer->recv_first_count > 0);
+        mpiret = MPI_Get_count (jstatus, MPI_BYTE, &rcount);
+        SC_CHECK_MPI (mpiret);
+        SC_CHECK_ABORTF (rcount <= (int) peer->recv_first_wire.elem_count,
+                         "Receive load mismatch A %d %d", rcount,
+                         peer->recv_first_count);
+
+        /* received load, close this request */
+        peer->have_first_load = 1;
+        P4EST_ASSERT (requests_first[j] == MPI_REQUEST_NULL);
+        --request_first_count;
+
+        /* trim to the received length and expand the wire encoding */
+        sc_array_resize (&peer->recv_first_wire, (size_t) rcount);
+        p4est_balance_wire_unpack (&peer->recv_first_wire, 1,
+                                   &peer->recv_first);
+        sc_array_reset (&peer->recv_first_wire);
+
+#ifdef P4EST_ENABLE_DEBUG
+        checksum =
+          p4est_quadrant_checksum (&peer->recv_first, &checkarray, 0);
+        P4EST_LDEBUGF ("Balance A recv checksum 0x%08x from %d\n", checksum,
+                       j);
+#endif /* P4EST_ENABLE_DEBUG */
+
+        /* process incoming quadrants to interleave with communication */
+        p4est_balance_response (p4est, peer, btype, borders);
+        qcount = peer->send_second.elem_count;
+        if (qcount > 0) {
+          P4EST_LDEBUGF ("Balance B send %llu quadrants to %d\n",
+                         (unsigned long long) qcount, j);
+          ++send_load[1];
+        }
+        else {
+          ++send_zero[1];
+        }
+        peer->send_second_count = (int) qcount;
+        mpiret = MPI_Isend (&peer->send_second_count, 1, MPI_INT,
+                            j, P4EST_COMM_BALANCE_SECOND_COUNT,
+                            p4est->mpicomm, &send_requests_second_count[j]);
+        SC_CHECK_MPI (mpiret);
+        ++request_send_count;
+        if (qcount > 0) {
+
+#ifdef P4EST_ENABLE_DEBUG
+          checksum =
+            p4est_quadrant_checksum (&peer->send_second, &checkarray, 0);
+          P4EST_LDEBUGF ("Balance B send checksum 0x%08x to %d\n", checksum,
+                         j);
+#endif /* P4EST_ENABLE_DEBUG */
+
+          total_send_count += qcount;
+          p4est_balance_wire_pack (&peer->send_second, 0,
+                                   &peer->send_second_wire);
+          mpiret = MPI_Isend (peer->send_second_wire.array,
+                              (int) peer->send_second_wire.elem_count,
+                              MPI_BYTE, j, P4EST_COMM_BALANCE_SECOND_LOAD,
+                              p4est->mpicomm, &send_requests_second_load[j]);
+          SC_CHECK_MPI (mpiret);
+          ++request_send_count;
+        }
+      }
+    }
+  }
+  for (j = 0; j < num_procs; ++j) {
+    P4EST_ASSERT (requests_first[j] == MPI_REQUEST_NULL);
+  }
+#endif /* P4EST_ENABLE_MPI */
+
+  /* simulate send and receive with myself across tree boundaries,
+   * unless an idle poll above has already donated this work */
+#ifdef P4EST_ENABLE_MPI
+  if (!self_done) {
+    p4est_balance_self_response (p4est, peers + rank, btype, borders);
+  }
+#else
+  p4est_balance_self_response (p4est, peers + rank, btype, borders);
+#endif
+
+#ifdef P4EST_ENABLE_MPI
+  /* receive second round appending to the same receive buffer;
+   * while no message has landed, merge peers whose receives are
+   * already complete instead of blocking idle */
+  merged = P4EST_ALLOC_ZERO (int8_t, num_procs);
+  while (request_second_count > 0) {
+    /* look for a fully received peer that is not merged yet */
+    for (k = 0; k < num_procs; ++k) {
+      if (!merged[k] && requests_first[k] == MPI_REQUEST_NULL &&
+          requests_second[k] == MPI_REQUEST_NULL) {
+        break;
+      }
+    }
+    if (k < num_procs) {
+      mpiret = MPI_Testsome (num_procs, requests_second,
+                             &outcount, wait_indices, recv_statuses);
+      SC_CHECK_MPI (mpiret);
+      P4EST_ASSERT (outcount != MPI_UNDEFINED);
+      if (outcount == 0) {
+        /* nothing is ready yet: merge the complete peer's quadrants */
+        p4est_balance_merge_peer (p4est, peers + k, first_tree, last_tree,
+                                  borders, init_fn);
+        merged[k] = 1;
+        continue;
+      }
+    }
+    else {
+      mpiret = MPI_Waitsome (num_procs, requests_second,
+                             &outcount, wait_indices, recv_statuses);
+      SC_CHECK_MPI (mpiret);
+      P4EST_ASSERT (outcount != MPI_UNDEFINED);
+      P4EST_ASSERT (outcount > 0);
+    }
+    for (i = 0; i < outcount; ++i) {
+      /* retrieve sender's rank */
+      j = wait_indices[i];
+      jstatus = &recv_statuses[i];
+      wait_indices[i] = -1;
+      P4EST_ASSERT (j != rank && 0 <= j && j < num_procs);
+      P4EST_ASSERT (requests_second[j] == MPI_REQUEST_NULL);
+      P4EST_ASSERT (jstatus->MPI_SOURCE == j);
+
+      /* check if we are in receiving count or load */
+      peer = peers + j;
+      P4EST_ASSERT (!peer->have_second_load);
+      if (!peer->have_second_count) {
+        /* verify message size */
+        P4EST_ASSERT (jstatus->MPI_TAG == P4EST_COMM_BALANCE_SECOND_COUNT);
+        mpiret = MPI_Get_count (jstatus, MPI_INT, &rcount);
+        SC_CHECK_MPI (mpiret);
+        SC_CHECK_ABORTF (rcount == 1, "Receive count mismatch B %d", rcount);
+
+        /* process the count information received */
+        peer->have_second_count = 1;
+        qcount = (size_t) peer->recv_second_count;
+        if (qcount > 0) {
+          /* received nonzero count, post receive for load */
+          P4EST_LDEBUGF ("Balance B recv %llu quadrants from %d\n",
+                         (unsigned long long) qcount, j);
+          P4EST_ASSERT (peer->recv_second.elem_count == 0);
+          sc_array_resize (&peer->recv_second, qcount);
+          total_recv_count += qcount;
+          qbytes = p4est_balance_wire_bound (qcount, 0);
+          sc_array_resize (&peer->recv_second_wire, qbytes);
+          P4EST_ASSERT (requests_second[j] == MPI_REQUEST_NULL);
+          mpiret = MPI_Irecv (peer->recv_second_wire.array, (int) qbytes,
+                              MPI_BYTE, j, P4EST_COMM_BALANCE_SECOND_LOAD,
+                              p4est->mpicomm, &requests_second[j]);
+          SC_CHECK_MPI (mpiret);
+          ++recv_load[1];
+        }
+        else {
+          /* will not receive load, close this request */
+          P4EST_ASSERT (qcount == 0);
+          P4EST_ASSERT (requests_second[j] == MPI_REQUEST_NULL);
+          --request_second_count;
+          ++recv_zero[1];
+        }
+      }
+      else {
+        /* verify received size */
+        P4EST_ASSERT (jstatus->MPI_TAG == P4EST_COMM_BALANCE_SECOND_LOAD);
+        P4EST_ASSERT (peer->recv_second_count > 0);
+        mpiret = MPI_Get_count (jstatus, MPI_BYTE, &rcount);
+        SC_CHECK_MPI (mpiret);
+        SC_CHECK_ABORTF (rcount <= (int) peer->recv_second_wire.elem_count,
+                         "Receive load mismatch B %d %d", rcount,
+                         peer->recv_second_count);
+
+        /* received load, close this request */
+        peer->have_second_load = 1;
+        P4EST_ASSERT (requests_second[j] == MPI_REQUEST_NULL);
+        --request_second_count;
+
+        /* trim to the received length and expand the wire encoding */
+        sc_array_resize (&peer->recv_second_wire, (size_t) rcount);
+        p4est_balance_wire_unpack (&peer->recv_second_wire, 0,
+                                   &peer->recv_second);
+        sc_array_reset (&peer->recv_second_wire);
+
+#ifdef P4EST_ENABLE_DEBUG
+        checksum =
+          p4est_quadrant_checksum (&peer->recv_second, &checkarray, 0);
+        P4EST_LDEBUGF ("Balance B recv checksum 0x%08x from %d\n", checksum,
+                       j);
+#endif /* P4EST_ENABLE_DEBUG */
+      }
+    }
+  }
+  for (j = 0; j < num_procs; ++j) {
+    P4EST_ASSERT (requests_second[j] == MPI_REQUEST_NULL);
+  }
+
+  /* print buffer statistics */
+  P4EST_VERBOSEF ("first send Z %d L %d recv Z %d L %d\n",
+                  send_zero[0], send_load[0], recv_zero[0], recv_load[0]);
+  P4EST_VERBOSEF ("second send Z %d L %d recv Z %d L %d\n",
+                  send_zero[1], send_load[1], recv_zero[1], recv_load[1]);
+  P4EST_VERBOSEF ("total send %d recv %d\n", total_send_count,
+                  total_recv_count);
+  for (j = 0; j < num_procs; ++j) {
+    peer = peers + j;
+    if (peer->send_first.elem_count > 0 || peer->recv_first_count > 0 ||
+        peer->send_second.elem_count > 0 || peer->recv_second_count > 0) {
+      P4EST_VERBOSEF ("peer %d first S %llu R %d second S %llu R %d\n",
+                      j, (unsigned long long) peer->send_first.elem_count,
+                      peer->recv_first_count,
+                      (unsigned long long) peer->send_second.elem_count,
+                      peer->recv_second_count);
+    }
+  }
+#endif /* P4EST_ENABLE_MPI */
+
+  /* end balance_comm, start balance_B */
+  P4EST_PHASE_END (P4EST_STRING "_balance_comm");
+  P4EST_PHASE_BEGIN (P4EST_STRING "_balance_B");
+  if (p4est->inspect != NULL) {
+    p4est->inspect->balance_comm += sc_MPI_Wtime ();
+#ifdef P4EST_ENABLE_MPI
+    p4est_balance_autotune_record (p4est);
+#endif
+    p4est->inspect->balance_memory_peak =
+      SC_MAX (p4est->inspect->balance_memory_peak, p4est_memory_used (p4est));
+    p4est->inspect->balance_B = -sc_MPI_Wtime ();
+    p4est->inspect->balance_B_count_in = 0;
+    p4est->inspect->balance_B_count_out = 0;
+    p4est->inspect->use_B = 1;
+#ifdef P4EST_ENABLE_MPI
+    for (k = 0; k < 2; ++k) {
+      p4est->inspect->balance_zero_sends[k] = send_zero[k];
+      p4est->inspect->balance_zero_receives[k] = recv_zero[k];
+    }
+#endif
+  }
+
+  /* merge the received quadrants of all remaining peers */
+  for (j = 0; j < num_procs; ++j) {
+#ifdef P4EST_ENABLE_MPI
+    if (merged[j]) {
+      continue;
+    }
+#endif
+    p4est_balance_merge_peer (p4est, peers + j, first_tree, last_tree,
+                              borders, init_fn);
+  }
+#ifdef P4EST_ENABLE_MPI
+  P4EST_FREE (merged);
+#endif
+
+  /* rebalance and clamp result back to original tree boundaries */
+  p4est->local_num_quadrants = 0;
+  for (nt = first_tree; nt <= last_tree; ++nt) {
+    /* check if we are the only processor in an isolated tree */
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    tree->quadrants_offset = p4est->local_num_quadrants;
+    tquadrants = &tree->quadrants;
+    treecount = tquadrants->elem_count;
+    if (!(tree_flags[nt] & fully_owned_flag) ||
+        (tree_flags[nt] & any_face_flag)) {
+      /* we have most probably received quadrants, run sort and balance */
+      /* balance the border, add it back into the tree, and linearize */
+      p4est_balance_border (p4est, btype, nt, init_fn, replace_fn, borders);
+      P4EST_VERBOSEF ("Balance tree %lld B %llu to %llu\n",
+                      (long long) nt,
+                      (unsigned long long) treecount,
+                      (unsigned long long) tquadrants->elem_count);
+    }
+    p4est->local_num_quadrants += tquadrants->elem_count;
+    tquadrants = NULL;          /* safeguard */
+  }
+  if (last_tree >= 0) {
+    for (; nt < conn->num_trees; ++nt) {
+      tree = p4est_tree_array_index (p4est->trees, nt);
+      tree->quadrants_offset = p4est->local_num_quadrants;
+    }
+  }
+
+  /* end balance_B */
+  P4EST_PHASE_END (P4EST_STRING "_balance_B");
+  if (p4est->inspect != NULL) {
+    p4est->inspect->balance_B += sc_MPI_Wtime ();
+    p4est->inspect->balance_memory_peak =
+      SC_MAX (p4est->inspect->balance_memory_peak, p4est_memory_used (p4est));
+  }
+
+#ifdef P4EST_ENABLE_MPI
+  /* wait for all send operations */
+  if (request_send_count > 0) {
+    mpiret = MPI_Waitall (4 * num_procs,
+                          send_requests_first_count, MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+  }
+
+  /* compute global sum of send and receive counts */
+#ifdef P4EST_ENABLE_DEBUG
+  gtotal[0] = gtotal[1] = 0;
+  ltotal[0] = (p4est_gloidx_t) total_send_count;
+  ltotal[1] = (p4est_gloidx_t) total_recv_count;
+  mpiret = MPI_Reduce (ltotal, gtotal, 2, P4EST_MPI_GLOIDX,
+                       MPI_SUM, 0, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_GLOBAL_STATISTICSF ("Global number of shipped quadrants %lld\n",
+                            (long long) gtotal[0]);
+  P4EST_ASSERT (rank != 0 || gtotal[0] == gtotal[1]);
+#endif /* P4EST_ENABLE_DEBUG */
+#endif /* P4EST_ENABLE_MPI */
+
+  /* loop over all local trees to finalize balance */
+  all_outcount = 0;
+  for (nt = first_tree; nt <= last_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    all_outcount += tree->quadrants.elem_count;
+
+    if (journal_counts != NULL &&
+        journal_counts[nt - first_tree] != tree->quadrants.elem_count) {
+      /* balance only ever inserts quadrants, so a grown tree has been
+       * modified; log its full local extent as one conservative entry */
+      p4est_journal_log (p4est, nt,
+                         p4est_quadrant_array_index (&tree->quadrants, 0),
+                         p4est_quadrant_array_index (&tree->quadrants,
+                                                     tree->quadrants.
+                                                     elem_count - 1));
+    }
+
+    /* final log message for this tree */
+    P4EST_VERBOSEF ("Done balance tree %lld now %llu\n", (long long) nt,
+                    (unsigned long long) tree->quadrants.elem_count);
+  }
+
+  /* cleanup temporary storage */
+  P4EST_FREE (journal_counts);
+  P4EST_FREE (tree_flags);
+  for (j = 0; j < num_procs; ++j) {
+    peer = peers + j;
+    sc_array_reset (&peer->send_first);
+    sc_array_reset (&peer->send_second);
+    sc_array_reset (&peer->recv_first);
+    sc_array_reset (&peer->recv_second);
+    sc_array_reset (&peer->send_first_wire);
+    sc_array_reset (&peer->send_second_wire);
+    sc_array_reset (&peer->recv_first_wire);
+    sc_array_reset (&peer->recv_second_wire);
+  }
+  P4EST_FREE (peers);
+
+  if (borders != NULL) {
+    if (ws == NULL) {
+      for (zz = 0; zz < localcount; zz++) {
+        qarray = (sc_array_t *) sc_array_index (borders, zz);
+        sc_array_reset (qarray);
+      }
+      sc_array_destroy (borders);
+    }
+    else {
+      /* keep the allocations and only empty the used entries */
+      for (zz = 0; zz < localcount; zz++) {
+        qarray = (sc_array_t *) sc_array_index (borders, zz);
+        sc_array_resize (qarray, 0);
+      }
+    }
+  }
+
+#ifdef P4_TO_P8
+  sc_array_reset (eta);
+#endif
+  sc_array_reset (cta);
+
+#ifdef P4EST_ENABLE_MPI
+  P4EST_FREE (requests_first);  /* includes allocation for requests_second */
+  P4EST_FREE (recv_statuses);
+  P4EST_FREE (wait_indices);
+#ifdef P4EST_ENABLE_DEBUG
+  sc_array_reset (&checkarray);
+#endif /* P4EST_ENABLE_DEBUG */
+#endif /* P4EST_ENABLE_MPI */
+
+  /* compute global number of quadrants */
+  p4est_comm_count_quadrants (p4est);
+  P4EST_ASSERT (p4est->global_num_quadrants >= old_gnq);
+  if (old_gnq != p4est->global_num_quadrants) {
+    ++p4est->revision;
+  }
+
+  /* some sanity checks */
+  P4EST_ASSERT ((p4est_locidx_t) all_outcount == p4est->local_num_quadrants);
+  P4EST_ASSERT (all_outcount >= all_incount);
+  if (p4est->user_data_pool != NULL) {
+    P4EST_ASSERT (data_pool_size + all_outcount - all_incount ==
+                  p4est->user_data_pool->elem_count);
+  }
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (p4est_is_balanced (p4est, btype));
+  P4EST_VERBOSEF ("Balance skipped %lld\n", (long long) skipped);
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
+                            "_balance with %lld total quadrants\n",
+                            (long long) p4est->global_num_quadrants);
+}
+
+void
+p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
+                   p4est_init_t init_fn, p4est_replace_t replace_fn)
+{
+  p4est_balance_internal (p4est, btype, init_fn, replace_fn, NULL);
+}
+
+void
+p4est_balance_incremental (p4est_t * p4est, p4est_connect_type_t btype,
+                           p4est_init_t init_fn, p4est_replace_t replace_fn,
+                           const int8_t * dirty_trees)
+{
+  p4est_balance_internal (p4est, btype, init_fn, replace_fn, dirty_trees);
+}
+
+/** Context shared by the callbacks of \ref p4est_balance_levels. */
+typedef struct p4est_balance_levels_ctx
+{
+  void               *user_pointer;     /**< saved forest context */
+  p4est_t            *capped;           /**< balanced capped copy */
+  int                 lmin, lmax;       /**< the active level band */
+}
+p4est_balance_levels_ctx_t;
+
+/** Coarsen every family deeper than the top of the band. */
+static int
+p4est_balance_levels_coarsen (p4est_t * p4est, p4est_topidx_t which_tree,
+                              p4est_quadrant_t * quadrants[])
+{
+  p4est_balance_levels_ctx_t *ctx =
+    (p4est_balance_levels_ctx_t *) p4est->user_pointer;
+
+  return (int) quadrants[0]->level > ctx->lmax;
+}
+
+/** Refine towards the copy's additions that serve the band. */
+static int
+p4est_balance_levels_refine (p4est_t * p4est, p4est_topidx_t which_tree,
+                             p4est_quadrant_t * quadrant)
+{
+  p4est_balance_levels_ctx_t *ctx =
+    (p4est_balance_levels_ctx_t *) p4est->user_pointer;
+  size_t              zz;
+  ssize_t             lower;
+  p4est_tree_t       *ctree;
+  p4est_quadrant_t   *cq;
+  sc_array_t         *cquadrants;
+
+  if ((int) quadrant->level >= ctx->lmax) {
+    /* the capped copy cannot be finer than this quadrant */
+    return 0;
+  }
+  ctree = p4est_tree_array_index (ctx->capped->trees, which_tree);
+  cquadrants = &ctree->quadrants;
+  lower = p4est_find_lower_bound (cquadrants, quadrant, 0);
+  if (lower < 0) {
+    return 0;
+  }
+  for (zz = (size_t) lower; zz < cquadrants->elem_count; ++zz) {
+    cq = p4est_quadrant_array_index (cquadrants, zz);
+    if (!p4est_quadrant_is_ancestor (quadrant, cq)) {
+      break;
+    }
+    if ((int) cq->level >= ctx->lmin - 1) {
+      /* this addition borders the band and must be realized */
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void
+p4est_balance_levels (p4est_t * p4est, p4est_connect_type_t btype,
+                      int lmin, int lmax,
+                      p4est_init_t init_fn, p4est_replace_t replace_fn)
+{
+  p4est_t            *capped;
+  p4est_balance_levels_ctx_t ctx;
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (0 <= lmin && lmin <= lmax);
+
+  if (lmin <= 1 && lmax >= P4EST_QMAXLEVEL) {
+    /* the band covers all levels: run the full balance */
+    p4est_balance_ext (p4est, btype, init_fn, replace_fn);
+    return;
+  }
+
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING
+                            "_balance_levels %s band %d %d\n",
+                            p4est_connect_type_string (btype), lmin, lmax);
+  p4est_log_indent_push ();
+
+  /* balance a dataless view of the forest capped at the top of the band,
+   * so the collective phases never touch the levels beyond it */
+  ctx.lmin = lmin;
+  ctx.lmax = lmax;
+  capped = p4est_copy (p4est, 0);
+  capped->inspect = NULL;
+  capped->user_pointer = &ctx;
+  if (lmax < P4EST_QMAXLEVEL) {
+    p4est_coarsen_ext (capped, 1, 0, p4est_balance_levels_coarsen,
+                       NULL, NULL);
+  }
+  p4est_balance_ext (capped, btype, NULL, NULL);
+
+  /* transplant the additions bordering the band back into the forest;
+   * coarser ripple completion is deferred to the next full balance */
+  ctx.capped = capped;
+  ctx.user_pointer = p4est->user_pointer;
+  p4est->user_pointer = &ctx;
+  p4est_refine_ext (p4est, 1, lmax, p4est_balance_levels_refine,
+                    init_fn, replace_fn);
+  p4est->user_pointer = ctx.user_pointer;
+  p4est_destroy (capped);
+
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
+                            "_balance_levels with %lld total quadrants\n",
+                            (long long) p4est->global_num_quadrants);
+}
+
+void
+p4est_partition (p4est_t * p4est, int allow_for_coarsening,
+                 p4est_weight_t weight_fn)
+{
+  (void) p4est_partition_ext (p4est, allow_for_coarsening, weight_fn);
+}
+
+#ifdef P4EST_ENABLE_MPI
+
+/** Compute the new quadrant counts per process for a repartition.
+ * \param [in] tolerance   Load ratio tolerated without repartitioning;
+ *                         see \ref p4est_partition_lazy.  Values <= 1.
+ *                         always compute the full ideal partition.
+ * \return  Array of \a mpisize counts to pass to p4est_partition_given,
+ *          owned by the caller, or NULL if the partition cannot change
+ *          because all weights are zero or the imbalance is tolerated.
+ */
+static p4est_locidx_t *
+p4est_partition_counts (p4est_t * p4est, int partition_for_coarsening,
+                        p4est_weight_t weight_fn,
+                        p4est_weight_batch_t batch_fn,
+                        const int64_t * quad_weights, double tolerance)
+{
+  const p4est_gloidx_t global_num_quadrants = p4est->global_num_quadrants;
+  int                 mpiret;
+  int                 low_source, high_source;
+  const int           num_procs = p4est->mpisize;
+  const int           rank = p4est->mpirank;
+  const p4est_topidx_t first_tree = p4est->first_local_tree;
+  const p4est_topidx_t last_tree = p4est->last_local_tree;
+  const p4est_locidx_t local_num_quadrants = p4est->local_num_quadrants;
+  int                 i, p;
+  int                 send_lowest, send_highest;
+  int                 num_sends, rcount, base_index;
+  size_t              lz;
+  ssize_t             lowers;
+  p4est_topidx_t      nt;
+  p4est_locidx_t      kl, qlocal;
+  p4est_locidx_t     *num_quadrants_in_proc;
+  p4est_gloidx_t      prev_quadrant, next_quadrant;
+  p4est_gloidx_t      send_index, recv_low, recv_high, qcount;
+  p4est_gloidx_t     *send_array;
+  int64_t             weight, weight_sum;
+  int64_t             cut, my_lowcut, my_highcut;
+  int                *qweights;         /* weight per local quadrant */
+  int64_t            *local_weights;    /* cumulative weights by quadrant */
+  int64_t            *global_weight_sums;
+  p4est_quadrant_t   *q;
+  p4est_tree_t       *tree;
+  MPI_Request        *send_requests, recv_requests[2];
+  MPI_Status          recv_statuses[2];
+  p4est_gloidx_t      num_corrected;
+
+  /* allocate new quadrant distribution counts */
+  num_quadrants_in_proc = P4EST_ALLOC (p4est_locidx_t, num_procs);
+
+  if (weight_fn == NULL && batch_fn == NULL && quad_weights == NULL) {
+    /* a mild imbalance does not pay for the data movement */
+    if (tolerance > 1.) {
+      p4est_gloidx_t      maxq = 0;
+
+      for (i = 0; i < num_procs; ++i) {
+        maxq = SC_MAX (maxq, p4est->global_first_quadrant[i + 1] -
+                       p4est->global_first_quadrant[i]);
+      }
+      if ((double) maxq * (double) num_procs <=
+          tolerance * (double) global_num_quadrants) {
+        P4EST_GLOBAL_INFOF
+          ("Partition imbalance %.3g within tolerance %.3g\n",
+           (double) maxq * (double) num_procs /
+           (double) global_num_quadrants, tolerance);
+        P4EST_FREE (num_quadrants_in_proc);
+        return NULL;
+      }
+    }
+
+    /* Divide up the quadrants equally */
+    for (p = 0, next_quadrant = 0; p < num_procs; ++p) {
+      prev_quadrant = next_quadrant;
+      next_quadrant =
+        p4est_partition_cut_gloidx (global_num_quadrants, p + 1, num_procs);
+      qcount = next_quadrant - prev_quadrant;
+      P4EST_ASSERT (0 <= qcount
+                    && qcount <= (p4est_gloidx_t) P4EST_LOCIDX_MAX);
+      num_quadrants_in_proc[p] = (p4est_locidx_t) (qcount);
+    }
+  }
+  else {
+    /* do a weighted partition */
+    local_weights = P4EST_ALLOC (int64_t, local_num_quadrants + 1);
+    global_weight_sums = P4EST_ALLOC (int64_t, num_procs + 1);
+    P4EST_VERBOSEF ("local quadrant count %lld\n",
+                    (long long) local_num_quadrants);
+
+    if (quad_weights != NULL) {
+      /* the caller has combined its weights per quadrant already */
+      local_weights[0] = 0;
+      for (kl = 0; kl < local_num_quadrants; ++kl) {
+        P4EST_ASSERT (quad_weights[kl] >= 0);
+        local_weights[kl + 1] = local_weights[kl] + quad_weights[kl];
+      }
+    }
+    else {
+      /* evaluate all weights before the prefix sum; the evaluations are
+       * independent, so the scalar callback is distributed across threads
+       * with dynamic chunking, while a batched callback receives one whole
+       * tree per call so the caller can vectorize its cost model */
+      qweights = P4EST_ALLOC (int, local_num_quadrants);
+      kl = 0;
+      for (nt = first_tree; nt <= last_tree; ++nt) {
+        tree = p4est_tree_array_index (p4est->trees, nt);
+        if (batch_fn != NULL) {
+          batch_fn (p4est, nt, &tree->quadrants, qweights + kl);
+        }
+        else {
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (dynamic, 64) private (q)
+#endif
+          for (lz = 0; lz < tree->quadrants.elem_count; ++lz) {
+            q = p4est_quadrant_array_index (&tree->quadrants, lz);
+            qweights[kl + (p4est_locidx_t) lz] = weight_fn (p4est, nt, q);
+          }
+        }
+        kl += (p4est_locidx_t) tree->quadrants.elem_count;
+      }
+      P4EST_ASSERT (kl == local_num_quadrants);
+
+      /* linearly sum weights across all trees */
+      local_weights[0] = 0;
+      for (kl = 0; kl < local_num_quadrants; ++kl) {
+        weight = (int64_t) qweights[kl];
+        P4EST_ASSERT (weight >= 0);
+        local_weights[kl + 1] = local_weights[kl] + weight;
+      }
+      P4EST_FREE (qweights);
+    }
+    weight_sum = local_weights[local_num_quadrants];
+    P4EST_VERBOSEF ("local weight sum %lld\n", (long long) weight_sum);
+
+    /* distribute local weight sums */
+    global_weight_sums[0] = 0;
+    mpiret = MPI_Allgather (&weight_sum, 1, MPI_LONG_LONG_INT,
+                            &global_weight_sums[1], 1, MPI_LONG_LONG_INT,
+                            p4est->mpicomm);
+    SC_CHECK_MPI (mpiret);
+
+    /* adjust all arrays to reflect the global weight */
+    for (i = 0; i < num_procs; ++i) {
+      global_weight_sums[i + 1] += global_weight_sums[i];
+    }
+    if (rank > 0) {
+      weight_sum = global_weight_sums[rank];
+      for (kl = 0; kl <= local_num_quadrants; ++kl) {
+        local_weights[kl] += weight_sum;
+      }
+    }
+    P4EST_ASSERT (local_weights[0] == global_weight_sums[rank]);
+    P4EST_ASSERT (local_weights[local_num_quadrants] ==
+                  global_weight_sums[rank + 1]);
+    weight_sum = global_weight_sums[num_procs];
+
+    if (rank == 0) {
+      for (i = 0; i <= num_procs; ++i) {
+        P4EST_GLOBAL_VERBOSEF ("Global weight sum [%d] %lld\n",
+                               i, (long long) global_weight_sums[i]);
+      }
+    }
+
+    /* if all quadrants have zero weight we do nothing */
+    if (weight_sum == 0) {
+      P4EST_FREE (local_weights);
+      P4EST_FREE (global_weight_sums);
+      P4EST_FREE (num_quadrants_in_proc);
+      return NULL;
+    }
+
+    /* a mild imbalance does not pay for the data movement */
+    if (tolerance > 1.) {
+      int64_t             maxw = 0;
+
+      for (i = 0; i < num_procs; ++i) {
+        maxw = SC_MAX (maxw, global_weight_sums[i + 1] -
+                       global_weight_sums[i]);
+      }
+      if ((double) maxw * (double) num_procs <=
+          tolerance * (double) weight_sum) {
+        P4EST_GLOBAL_INFOF
+          ("Partition imbalance %.3g within tolerance %.3g\n",
+           (double) maxw * (double) num_procs / (double) weight_sum,
+           tolerance);
+        P4EST_FREE (local_weights);
+        P4EST_FREE (global_weight_sums);
+        P4EST_FREE (num_quadrants_in_proc);
+        return NULL;
+      }
+    }
+
+    /* determine processor ids to send to */
+    send_lowest = num_procs;
+    send_highest = 0;
+    for (i = 1; i <= num_procs; ++i) {
+      cut = p4est_partition_cut_uint64 (weight_sum, i, num_procs);
+      if (global_weight_sums[rank] < cut &&
+          cut <= global_weight_sums[rank + 1]) {
+        send_lowest = SC_MIN (send_lowest, i);
+        send_highest = SC_MAX (send_highest, i);
+      }
+    }
+    /*
+     * send low cut to send_lowest..send_highest
+     * and high cut to send_lowest-1..send_highest-1
+     */
+    P4EST_LDEBUGF ("my send peers %d %d\n", send_lowest, send_highest);
+
+    num_sends = 2 * (send_highest - send_lowest + 1);
+    if (num_sends <= 0) {
+      num_sends = 0;
+      send_requests = NULL;
+      send_array = NULL;
+    }
+    else {
+      send_requests = P4EST_ALLOC (MPI_Request, num_sends);
+      send_array = P4EST_ALLOC (p4est_gloidx_t, num_sends);
+      lowers = 0;
+      for (i = send_lowest; i <= send_highest; ++i) {
+        base_index = 2 * (i - send_lowest);
+        if (i < num_procs) {
+          /* do binary search in the weight array */
+          lowers = sc_search_lower_bound64 (p4est_partition_cut_uint64
+                                            (weight_sum, i, num_procs),
+                                            local_weights,
+                                            (size_t) local_num_quadrants + 1,
+                                            (size_t) lowers);
+          P4EST_ASSERT (lowers > 0
+                        && (p4est_locidx_t) lowers <= local_num_quadrants);
+
+          /* send low bound */
+          send_index = send_array[base_index + 1] =
+            (p4est_gloidx_t) lowers + p4est->global_first_quadrant[rank];
+          P4EST_LDEBUGF ("send A %d %d %d index %lld base %d to %d\n",
+                         send_lowest, i, send_highest,
+                         (long long) send_index, base_index + 1, i);
+          mpiret =
+            MPI_Isend (&send_array[base_index + 1], 1, P4EST_MPI_GLOIDX, i,
+                       P4EST_COMM_PARTITION_WEIGHTED_LOW, p4est->mpicomm,
+                       &send_requests[base_index + 1]);
+          SC_CHECK_MPI (mpiret);
+        }
+        else {
+          lowers = 0;
+          send_index = global_num_quadrants;
+          send_requests[base_index + 1] = MPI_REQUEST_NULL;
+          send_array[base_index + 1] = -1;
+        }
+
+        /* send high bound */
+        send_array[base_index] = send_index;
+        P4EST_LDEBUGF ("send B %d %d %d index %lld base %d to %d\n",
+                       send_lowest, i, send_highest,
+                       (long long) send_index, base_index, i - 1);
+        mpiret = MPI_Isend (&send_array[base_index], 1, P4EST_MPI_GLOIDX,
+                            i - 1, P4EST_COMM_PARTITION_WEIGHTED_HIGH,
+                            p4est->mpicomm, &send_requests[base_index]);
+        SC_CHECK_MPI (mpiret);
+      }
+    }
+
+    /* determine processor ids to receive from and post irecv */
+    i = 0;
+    my_lowcut = p4est_partition_cut_uint64 (weight_sum, rank, num_procs);
+    if (my_lowcut == 0) {
+      recv_low = 0;
+      recv_requests[0] = MPI_REQUEST_NULL;
+      low_source = -1;
+    }
+    else {
+      for (; i < num_procs; ++i) {
+        if (global_weight_sums[i] < my_lowcut &&
+            my_lowcut <= global_weight_sums[i + 1]) {
+          P4EST_LDEBUGF ("recv A from %d\n", i);
+          mpiret = MPI_Irecv (&recv_low, 1, P4EST_MPI_GLOIDX, i,
+                              P4EST_COMM_PARTITION_WEIGHTED_LOW,
+                              p4est->mpicomm, &recv_requests[0]);
+          SC_CHECK_MPI (mpiret);
+          break;
+        }
+      }
+      P4EST_ASSERT (i < num_procs);
+      low_source = i;
+    }
+    my_highcut = p4est_partition_cut_uint64 (weight_sum, rank + 1, num_procs);
+    if (my_highcut == 0) {
+      recv_high = 0;
+      recv_requests[1] = MPI_REQUEST_NULL;
+      high_source = -1;
+    }
+    else {
+      for (; i < num_procs; ++i) {
+        if (global_weight_sums[i] < my_highcut &&
+            my_highcut <= global_weight_sums[i + 1]) {
+          P4EST_LDEBUGF ("recv B from %d\n", i);
+          mpiret = MPI_Irecv (&recv_high, 1, P4EST_MPI_GLOIDX, i,
+                              P4EST_COMM_PARTITION_WEIGHTED_HIGH,
+                              p4est->mpicomm, &recv_requests[1]);
+          SC_CHECK_MPI (mpiret);
+          break;
+        }
+      }
+      P4EST_ASSERT (i < num_procs);
+      high_source = i;
+    }
+    P4EST_LDEBUGF ("my recv peers %d %d cuts %lld %lld\n",
+                   low_source, high_source,
+                   (long long) my_lowcut, (long long) my_highcut);
+
+    /* free temporary memory */
+    P4EST_FREE (local_weights);
+    P4EST_FREE (global_weight_sums);
+
+    /* wait for sends and receives to complete */
+    if (num_sends > 0) {
+      mpiret = MPI_Waitall (num_sends, send_requests, MPI_STATUSES_IGNORE);
+      SC_CHECK_MPI (mpiret);
+      P4EST_FREE (send_requests);
+      P4EST_FREE (send_array);
+    }
+    mpiret = MPI_Waitall (2, recv_requests, recv_statuses);
+    SC_CHECK_MPI (mpiret);
+    if (my_lowcut != 0) {
+      SC_CHECK_ABORT (recv_statuses[0].MPI_SOURCE == low_source,
+                      "Wait low source");
+      SC_CHECK_ABORT (recv_statuses[0].MPI_TAG ==
+                      P4EST_COMM_PARTITION_WEIGHTED_LOW, "Wait low tag");
+      mpiret = MPI_Get_count (&recv_statuses[0], P4EST_MPI_GLOIDX, &rcount);
+      SC_CHECK_MPI (mpiret);
+      SC_CHECK_ABORTF (rcount == 1, "Wait low count %d", rcount);
+    }
+    if (my_highcut != 0) {
+      SC_CHECK_ABORT (recv_statuses[1].MPI_SOURCE == high_source,
+                      "Wait high source");
+      SC_CHECK_ABORT (recv_statuses[1].MPI_TAG ==
+                      P4EST_COMM_PARTITION_WEIGHTED_HIGH, "Wait high tag");
+      mpiret = MPI_Get_count (&recv_statuses[1], P4EST_MPI_GLOIDX, &rcount);
+      SC_CHECK_MPI (mpiret);
+      SC_CHECK_ABORTF (rcount == 1, "Wait high count %d", rcount);
+    }
+
+    /* communicate the quadrant ranges */
+    qcount = recv_high - recv_low;
+    P4EST_LDEBUGF ("weighted partition count %lld\n", (long long) qcount);
+    P4EST_ASSERT (qcount >= 0 && qcount <= (p4est_gloidx_t) P4EST_LOCIDX_MAX);
+    qlocal = (p4est_locidx_t) qcount;
+    mpiret = MPI_Allgather (&qlocal, 1, P4EST_MPI_LOCIDX,
+                            num_quadrants_in_proc, 1, P4EST_MPI_LOCIDX,
+                            p4est->mpicomm);
+    SC_CHECK_MPI (mpiret);
+
+#if(0)
+    /* run through the count array and repair zero ranges */
+    for (i = 0; i < num_procs; ++i) {
+      if (num_quadrants_in_proc[i] == 0) {
+        for (p = i - 1; p >= 0; --p) {
+          P4EST_ASSERT (num_quadrants_in_proc[p] > 0);
+          if (num_quadrants_in_proc[p] > 1) {
+            --num_quadrants_in_proc[p];
+            ++num_quadrants_in_proc[i];
+            break;
+          }
+        }
+        if (p < 0) {
+          for (p = i + 1; p < num_procs; ++p) {
+            P4EST_ASSERT (num_quadrants_in_proc[p] >= 0);
+            if (num_quadrants_in_proc[p] > 1) {
+              --num_quadrants_in_proc[p];
+              ++num_quadrants_in_proc[i];
+              break;
             }
-            else if (!face_axis[2]) {
-              contact_edge_only = 1;
-              edge = 8 + 2 * quad_contact[3] + quad_contact[1];
+          }
+          P4EST_ASSERT (p < num_procs);
+        }
+      }
+    }
+#endif
+  }
+
+  /* in the lazy mode the imbalance exceeds the tolerance, but instead
+   * of realizing the ideal partition we only shift each cut towards it
+   * as far as no quadrant moves further than to an adjacent process,
+   * which trims the worst offenders at bounded communication cost */
+  if (tolerance > 1.) {
+    p4est_gloidx_t     *cuts;
+    p4est_gloidx_t      ideal, ctrim;
+
+    cuts = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
+    cuts[0] = 0;
+    ideal = 0;
+    for (i = 1; i < num_procs; ++i) {
+      ideal += (p4est_gloidx_t) num_quadrants_in_proc[i - 1];
+      ctrim = SC_MAX (ideal, p4est->global_first_quadrant[i - 1]);
+      ctrim = SC_MIN (ctrim, p4est->global_first_quadrant[i + 1]);
+      cuts[i] = SC_MAX (ctrim, cuts[i - 1]);
+    }
+    cuts[num_procs] = global_num_quadrants;
+    P4EST_ASSERT (cuts[num_procs] >= cuts[num_procs - 1]);
+    for (i = 0; i < num_procs; ++i) {
+      num_quadrants_in_proc[i] = (p4est_locidx_t) (cuts[i + 1] - cuts[i]);
+    }
+    P4EST_FREE (cuts);
+  }
+
+  /* correct partition */
+  if (partition_for_coarsening) {
+    num_corrected =
+      p4est_partition_for_coarsening (p4est, num_quadrants_in_proc);
+    P4EST_GLOBAL_INFOF
+      ("Designated partition for coarsening %lld quadrants moved\n",
+       (long long) num_corrected);
+  }
+
+  return num_quadrants_in_proc;
+}
+
+#endif /* P4EST_ENABLE_MPI */
+
+static p4est_gloidx_t
+p4est_partition_internal (p4est_t * p4est, int partition_for_coarsening,
+                          p4est_weight_t weight_fn,
+                          p4est_weight_batch_t batch_fn,
+                          const int64_t * quad_weights, double tolerance)
+{
+  p4est_gloidx_t      global_shipped = 0;
+  const p4est_gloidx_t global_num_quadrants = p4est->global_num_quadrants;
+#ifdef P4EST_ENABLE_MPI
+  p4est_locidx_t     *num_quadrants_in_proc;
+#endif
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_GLOBAL_PRODUCTIONF
+    ("Into " P4EST_STRING
+     "_partition with %lld total quadrants\n",
+     (long long) p4est->global_num_quadrants);
+
+  /* this function does nothing in a serial setup */
+  if (p4est->mpisize == 1) {
+    P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_partition no shipping\n");
+
+    /* in particular, there is no need to bumb the revision counter */
+    P4EST_ASSERT (global_shipped == 0);
+    return global_shipped;
+  }
+
+  p4est_log_indent_push ();
+
+#ifdef P4EST_ENABLE_MPI
+  num_quadrants_in_proc =
+    p4est_partition_counts (p4est, partition_for_coarsening,
+                            weight_fn, batch_fn, quad_weights, tolerance);
+  if (num_quadrants_in_proc == NULL) {
+    /* if all quadrants have zero weight we do nothing */
+    p4est_log_indent_pop ();
+    P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_partition no shipping\n");
+
+    /* in particular, there is no need to bumb the revision counter */
+    P4EST_ASSERT (global_shipped == 0);
+    return global_shipped;
+  }
+
+  /* run the partition algorithm with proper quadrant counts */
+  global_shipped = p4est_partition_given (p4est, num_quadrants_in_proc);
+  if (global_shipped) {
+    /* the partition of the forest has changed somewhere */
+    ++p4est->revision;
+  }
+  P4EST_FREE (num_quadrants_in_proc);
+
+  /* check validity of the p4est */
+  P4EST_ASSERT (p4est_is_valid (p4est));
+#endif /* P4EST_ENABLE_MPI */
+
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF
+    ("Done " P4EST_STRING "_partition shipped %lld quadrants %.3g%%\n",
+     (long long) global_shipped,
+     global_shipped * 100. / global_num_quadrants);
+
+  return global_shipped;
+}
+
+p4est_gloidx_t
+p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
+                     p4est_weight_t weight_fn)
+{
+  return p4est_partition_internal (p4est, partition_for_coarsening,
+                                   weight_fn, NULL, NULL, 0.);
+}
+
+p4est_gloidx_t
+p4est_partition_batch (p4est_t * p4est, int partition_for_coarsening,
+                       p4est_weight_batch_t batch_fn)
+{
+  P4EST_ASSERT (batch_fn != NULL);
+
+  return p4est_partition_internal (p4est, partition_for_coarsening,
+                                   NULL, batch_fn, NULL, 0.);
+}
+
+p4est_gloidx_t
+p4est_partition_vector (p4est_t * p4est, int partition_for_coarsening,
+                        int num_components,
+                        p4est_weight_vector_t weight_fn,
+                        p4est_partition_norm_t norm)
+{
+  const p4est_locidx_t local_num_quadrants = p4est->local_num_quadrants;
+  const double        scale = (double) ((int64_t) 1 << 40);
+  int                 mpiret;
+  int                 c;
+  size_t              lz;
+  double              v, s;
+  int                *cweights;
+  int64_t            *totals, *gtotals;
+  int64_t            *quad_weights;
+  p4est_topidx_t      nt;
+  p4est_locidx_t      kl;
+  p4est_gloidx_t      global_shipped;
+  p4est_quadrant_t   *q;
+  p4est_tree_t       *tree;
+
+  P4EST_ASSERT (num_components > 0);
+  P4EST_ASSERT (weight_fn != NULL);
+  P4EST_ASSERT (norm == P4EST_PARTITION_NORM_L1 ||
+                norm == P4EST_PARTITION_NORM_MAX);
+
+  /* evaluate all weight components and their local sums */
+  cweights = P4EST_ALLOC (int, (size_t) num_components *
+                          (size_t) local_num_quadrants);
+  totals = P4EST_ALLOC_ZERO (int64_t, num_components);
+  kl = 0;
+  for (nt = p4est->first_local_tree; nt <= p4est->last_local_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    for (lz = 0; lz < tree->quadrants.elem_count; ++lz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, lz);
+      weight_fn (p4est, nt, q,
+                 cweights + (size_t) num_components * (size_t) kl);
+      for (c = 0; c < num_components; ++c) {
+        P4EST_ASSERT (cweights[(size_t) num_components * (size_t) kl + c]
+                      >= 0);
+        totals[c] +=
+          (int64_t) cweights[(size_t) num_components * (size_t) kl + c];
+      }
+      ++kl;
+    }
+  }
+  P4EST_ASSERT (kl == local_num_quadrants);
+
+  /* every component is normalized by its global sum */
+  gtotals = P4EST_ALLOC (int64_t, num_components);
+  mpiret = sc_MPI_Allreduce (totals, gtotals, num_components,
+                             sc_MPI_LONG_LONG_INT, sc_MPI_SUM,
+                             p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (totals);
+
+  /* combine the normalized components by the requested norm */
+  quad_weights = P4EST_ALLOC (int64_t, local_num_quadrants);
+  for (kl = 0; kl < local_num_quadrants; ++kl) {
+    s = 0.;
+    for (c = 0; c < num_components; ++c) {
+      if (gtotals[c] <= 0) {
+        /* a globally empty component constrains nothing */
+        continue;
+      }
+      v = (double) cweights[(size_t) num_components * (size_t) kl + c] *
+        (scale / (double) gtotals[c]);
+      s = (norm == P4EST_PARTITION_NORM_L1) ? s + v : SC_MAX (s, v);
+    }
+    quad_weights[kl] = (int64_t) s;
+  }
+  P4EST_FREE (cweights);
+  P4EST_FREE (gtotals);
+
+  global_shipped = p4est_partition_internal (p4est, partition_for_coarsening,
+                                             NULL, NULL, quad_weights, 0.);
+  P4EST_FREE (quad_weights);
+
+  return global_shipped;
+}
+
+p4est_gloidx_t
+p4est_partition_lazy (p4est_t * p4est, int partition_for_coarsening,
+                      p4est_weight_t weight_fn, double tolerance)
+{
+  P4EST_ASSERT (tolerance >= 1.);
+
+  return p4est_partition_internal (p4est, partition_for_coarsening,
+                                   weight_fn, NULL, NULL, tolerance);
+}
+
+p4est_partition_context_t *
+p4est_partition_begin (p4est_t * p4est, int partition_for_coarsening,
+                       p4est_weight_t weight_fn)
+{
+  p4est_partition_context_t *ctx;
+#ifdef P4EST_ENABLE_MPI
+  p4est_locidx_t     *num_quadrants_in_proc;
+#endif
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_GLOBAL_PRODUCTIONF
+    ("Into " P4EST_STRING
+     "_partition_begin with %lld total quadrants\n",
+     (long long) p4est->global_num_quadrants);
+  p4est_log_indent_push ();
+
+#ifdef P4EST_ENABLE_MPI
+  if (p4est->mpisize > 1 &&
+      (num_quadrants_in_proc =
+       p4est_partition_counts (p4est, partition_for_coarsening,
+                               weight_fn, NULL, NULL, 0.)) != NULL) {
+    /* post all messages; the caller computes during the transfer */
+    ctx = p4est_partition_given_begin (p4est, num_quadrants_in_proc);
+    P4EST_FREE (num_quadrants_in_proc);
+    return ctx;
+  }
+#endif
+
+  /* nothing can be shipped; the completion call only cleans up */
+  ctx = P4EST_ALLOC_ZERO (p4est_partition_context_t, 1);
+  ctx->p4est = p4est;
+  ctx->nothing = 1;
+  return ctx;
+}
+
+p4est_gloidx_t
+p4est_partition_end (p4est_partition_context_t * ctx)
+{
+  p4est_t            *p4est = ctx->p4est;
+  p4est_gloidx_t      global_shipped = 0;
+
+  if (!ctx->nothing) {
+    global_shipped = p4est_partition_given_end (ctx);
+    if (global_shipped) {
+      /* the partition of the forest has changed somewhere */
+      ++p4est->revision;
+    }
+
+    /* check validity of the p4est */
+    P4EST_ASSERT (p4est_is_valid (p4est));
+  }
+  else {
+    P4EST_FREE (ctx);
+  }
+
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF
+    ("Done " P4EST_STRING "_partition_end shipped %lld quadrants %.3g%%\n",
+     (long long) global_shipped,
+     global_shipped * 100. / p4est->global_num_quadrants);
+
+  return global_shipped;
+}
+
+p4est_gloidx_t
+p4est_partition_for_coarsening (p4est_t * p4est,
+                                p4est_locidx_t * num_quadrants_in_proc)
+{
+#ifdef P4EST_ENABLE_MPI
+  int                 num_procs = p4est->mpisize;
+  int                 rank = p4est->mpirank;
+  int                 mpiret;
+  p4est_gloidx_t      global_num_quadrants = p4est->global_num_quadrants;
+  int                 i, send_lowest, send_highest, num_sends;
+  int                 parent_index;
+  p4est_quadrant_t   *q;
+  p4est_tree_t       *tree;
+  p4est_locidx_t      num_quadrants_in_tree;
+  p4est_topidx_t      it, tree_index;
+  p4est_gloidx_t      iq, quad_id_near_cut;
+  p4est_gloidx_t      min_quad_id, max_quad_id;
+  int8_t              quad_near_cut_level;
+  p4est_gloidx_t     *partition_now = p4est->global_first_quadrant;
+  p4est_gloidx_t     *partition_new;
+  p4est_quadrant_t   *parent_send;
+  MPI_Request        *send_requests;
+  MPI_Request        *receive_requests;
+  int                 receive_lowest, receive_highest, num_receives;
+  int                 process_with_cut = -1, process_with_cut_recv_id = -1;
+  p4est_quadrant_t   *parent_receive;
+  int                *receive_process;
+  int                *correction, correction_local = 0;
+  int                 current_proc, next_proc;
+  p4est_gloidx_t      num_moved_quadrants;
+
+  /* create array with first quadrants of new partition */
+  partition_new = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
+  partition_new[0] = 0;
+  for (i = 1; i < num_procs; i++) {     /* loop over all processes */
+    partition_new[i] = partition_new[i - 1] + num_quadrants_in_proc[i - 1];
+  }
+  partition_new[num_procs] = global_num_quadrants;
+
+  /* BEGIN: send */
+  if (partition_now[rank] < partition_now[rank + 1]) {
+    /* if this process has quadrants */
+    /* determine number and min/max process ids to send to */
+    num_sends = 0;              /* number of sends */
+    send_lowest = num_procs;    /* lowest process id */
+    send_highest = 0;           /* highest process id */
+    for (i = 1; i < num_procs; i++) {
+      /* loop over all processes (without first) */
+      if (partition_new[i] < partition_new[i + 1] &&
+          partition_now[rank] <= partition_new[i] + P4EST_CHILDREN - 2 &&
+          partition_new[i] - P4EST_CHILDREN + 1 < partition_now[rank + 1]) {
+        /* if this process has relevant quadrants for process `i` */
+        num_sends++;
+        send_lowest = SC_MIN (send_lowest, i);
+        send_highest = SC_MAX (send_highest, i);
+      }
+    }
+  }
+  else {
+    /* set number of messages to send */
+    num_sends = 0;
+  }
+
+  if (num_sends > 0) {          /* if this process sends messages */
+    /* allocate send messages */
+    send_requests = P4EST_ALLOC (MPI_Request, num_sends);
+    parent_send = P4EST_ALLOC (p4est_quadrant_t, num_sends);
+
+    /* array index of send messages */
+    parent_index = 0;
+
+    for (i = send_lowest; i <= send_highest; i++) {
+      /* loop over all process candidates to send to */
+      if (!(partition_new[i] < partition_new[i + 1] &&
+            partition_now[rank] <= partition_new[i] + P4EST_CHILDREN - 2 &&
+            partition_new[i] - P4EST_CHILDREN + 1 <
+            partition_now[rank + 1])) {
+        /* if this process has no relevant quadrants for process `i` */
+        continue;
+      }
+
+      /* get nearest quadrant `quad_id_near_cut` to cut `partition_new[i]` */
+      if (partition_now[rank] <= partition_new[i] &&
+          partition_new[i] < partition_now[rank + 1]) {
+        /* if cut is owned by this process */
+        quad_id_near_cut = partition_new[i];
+      }
+      else {
+        if (P4EST_GLOIDX_ABS (partition_new[i] - partition_now[rank]) <
+            P4EST_GLOIDX_ABS (partition_new[i] - partition_now[rank + 1] +
+                              1)) {
+          quad_id_near_cut = partition_now[rank];
+        }
+        else {
+          quad_id_near_cut = partition_now[rank + 1] - 1;
+        }
+      }
+
+      /* get tree `tree` of quadrant `quad_id_near_cut` by binary search
+       * over the ascending tree offsets */
+      tree_index = p4est->first_local_tree;
+      it = p4est->last_local_tree;
+      while (tree_index < it) {
+        p4est_topidx_t      mt = it - (it - tree_index) / 2;
+
+        tree = p4est_tree_array_index (p4est->trees, mt);
+        if (tree->quadrants_offset <= quad_id_near_cut - partition_now[rank]) {
+          tree_index = mt;
+        }
+        else {
+          it = mt - 1;
+        }
+      }
+      if (tree_index < p4est->last_local_tree) {
+        tree = p4est_tree_array_index (p4est->trees, tree_index + 1);
+        num_quadrants_in_tree = tree->quadrants_offset;
+      }
+      else {
+        num_quadrants_in_tree = partition_now[rank + 1] - partition_now[rank];
+      }
+      tree = p4est_tree_array_index (p4est->trees, tree_index);
+      num_quadrants_in_tree -= tree->quadrants_offset;
+
+      /* get quadrant with index `quad_id_near_cut` */
+      q = p4est_quadrant_array_index (&tree->quadrants,
+                                      quad_id_near_cut - partition_now[rank] -
+                                      tree->quadrants_offset);
+
+      /* get level of quadrant near cut */
+      quad_near_cut_level = q->level;
+
+      if (quad_near_cut_level > 0) {
+        /* if quadrant near cut is not root of tree, i.e. level is not zero */
+        /* get parent of quadrant near cut */
+        p4est_quadrant_parent (q, &parent_send[parent_index]);
+
+        /* get min quadrant with same parent */
+        min_quad_id = quad_id_near_cut;
+        for (iq = quad_id_near_cut;
+             iq >= SC_MAX (partition_now[rank] + tree->quadrants_offset,
+                           partition_new[i] - P4EST_CHILDREN + 1); iq--) {
+          /* loop over eligible quadrants */
+          /* get quadrant with index `iq` */
+          q = p4est_quadrant_array_index (&tree->quadrants,
+                                          iq - partition_now[rank] -
+                                          tree->quadrants_offset);
+
+          /* check quadrant `iq` */
+          if (q->level == quad_near_cut_level) {        /* if same level */
+            if (p4est_quadrant_is_parent (&parent_send[parent_index], q)) {
+              /* if same parent */
+              min_quad_id = iq;
             }
-#endif
-            if (contact_face_only) {
-              /* square contact across a face */
-              P4EST_ASSERT (!contact_edge_only);
-              P4EST_ASSERT (face >= 0 && face < P4EST_FACES);
-              P4EST_ASSERT (quad_contact[face]);
-              qtree = p4est_find_face_transform (conn, nt, face, ftransform);
-              if (qtree >= 0) {
-                P4EST_ASSERT (tree_contact[face]);
-                p4est_quadrant_transform_face (q, &tosend, ftransform);
-                tosend.p.piggy2.from_tree = nt;
-                tosend.pad16 = face;
-                p4est_quadrant_transform_face (&insulq, &tempq, ftransform);
-                p4est_balance_schedule (p4est, peers, qtree, 1,
-                                        &tosend, &tempq,
-                                        &first_peer, &last_peer);
-              }
-              else {
-                /* goes across a face with no neighbor */
-                P4EST_ASSERT (!tree_contact[face]);
-              }
+            else {
+              break;
             }
-#ifdef P4_TO_P8
-            else if (contact_edge_only) {
-              /* this quadrant crosses an edge */
-              P4EST_ASSERT (!contact_face_only);
-              P4EST_ASSERT (edge >= 0 && edge < P8EST_EDGES);
-              p8est_find_edge_transform (conn, nt, edge, &ei);
-              for (etree = 0; etree < eta->elem_count; ++etree) {
-                et = p8est_edge_array_index (eta, etree);
-                p8est_quadrant_transform_edge (q, &tosend, &ei, et, 0);
-                tosend.p.piggy2.from_tree = nt;
-                tosend.pad16 = edge;
-                p8est_quadrant_transform_edge (&insulq, &tempq, &ei, et, 1);
-                p4est_balance_schedule (p4est, peers, et->ntree, 1,
-                                        &tosend, &tempq,
-                                        &first_peer, &last_peer);
-              }
+          }
+          else {
+            break;
+          }
+        }
+
+        /* get max quadrant with same parent */
+        max_quad_id = quad_id_near_cut;
+        for (iq = quad_id_near_cut;
+             iq <=
+             SC_MIN (partition_now[rank] + tree->quadrants_offset +
+                     num_quadrants_in_tree - 1,
+                     partition_new[i] + P4EST_CHILDREN - 2); iq++) {
+          /* loop over eligible quadrants */
+
+          /* get quadrant `iq` */
+          q = p4est_quadrant_array_index (&tree->quadrants,
+                                          iq - partition_now[rank] -
+                                          tree->quadrants_offset);
+
+          /* check quadrant `iq` */
+          if (q->level == quad_near_cut_level) {        /* if same level */
+            if (p4est_quadrant_is_parent (&parent_send[parent_index], q)) {
+              /* if same parent */
+              max_quad_id = iq;
             }
-#endif
             else {
-              /* this quadrant crosses a corner */
-              P4EST_ASSERT (face_axis[0] && face_axis[1]);
-              corner = quad_contact[1] + 2 * quad_contact[3];
-#ifdef P4_TO_P8
-              P4EST_ASSERT (face_axis[2]);
-              corner += 4 * quad_contact[5];
-#endif
-              P4EST_ASSERT (p4est_quadrant_touches_corner (q, corner, 1));
-              P4EST_ASSERT (p4est_quadrant_touches_corner
-                            (&insulq, corner, 0));
-              p4est_find_corner_transform (conn, nt, corner, &ci);
-              for (ctree = 0; ctree < cta->elem_count; ++ctree) {
-                ct = p4est_corner_array_index (cta, ctree);
-                tosend = *q;
-                p4est_quadrant_transform_corner (&tosend, (int) ct->ncorner,
-                                                 0);
-                tosend.p.piggy2.from_tree = nt;
-                tosend.pad16 = corner;
-                tempq = insulq;
-                p4est_quadrant_transform_corner (&tempq, (int) ct->ncorner,
-                                                 1);
-                p4est_balance_schedule (p4est, peers, ct->ntree, 1,
-                                        &tosend, &tempq, &first_peer,
-                                        &last_peer);
-              }
+              break;
             }
           }
           else {
-            /* no inter-tree contact */
-            tosend = *q;
-            tosend.p.piggy2.from_tree = nt;
-            tosend.pad16 = -1;
-            p4est_balance_schedule (p4est, peers, nt, 0,
-                                    &tosend, &insulq, &first_peer,
-                                    &last_peer);
+            break;
           }
         }
+
+        /* write tree */
+        parent_send[parent_index].p.piggy3.which_tree = tree_index;
+
+        if (quad_id_near_cut == partition_new[i]) {
+          /* if this process has cut */
+          /* encode number of quadrants with same parent before and after
+           * `partition_new[i]` into one integer */
+          parent_send[parent_index].p.piggy3.local_num =
+            (partition_new[i] - min_quad_id) * P4EST_CHILDREN +
+            (max_quad_id - partition_new[i]);
+        }
+        else {
+          /* write number of quadrants with same parent */
+          parent_send[parent_index].p.piggy3.local_num =
+            max_quad_id - min_quad_id + 1;
+        }
+
+        /* MPI send: parent */
+        mpiret = MPI_Isend (&parent_send[parent_index],
+                            sizeof (p4est_quadrant_t), MPI_BYTE,
+                            i,
+                            P4EST_COMM_PARTITION_CORRECTION, p4est->mpicomm,
+                            &send_requests[parent_index]);
+        SC_CHECK_MPI (mpiret);
       }
+      else {
+        /* if quadrant near cut is root of tree, i.e., level is zero,
+           set parent as tree root `q` */
+        parent_send[parent_index].level = q->level;
+        parent_send[parent_index].x = q->x;
+        parent_send[parent_index].y = q->y;
 #ifdef P4_TO_P8
-#if 0
-      {
+        parent_send[parent_index].z = q->z;
 #endif
+
+        /* write tree */
+        parent_send[parent_index].p.piggy3.which_tree = tree_index;
+
+        /* write number of quadrants with same "parent" */
+        parent_send[parent_index].p.piggy3.local_num = 1;
+
+        /* MPI send: root of tree */
+        mpiret = MPI_Isend (&parent_send[parent_index],
+                            sizeof (p4est_quadrant_t), MPI_BYTE,
+                            i,
+                            P4EST_COMM_PARTITION_CORRECTION, p4est->mpicomm,
+                            &send_requests[parent_index]);
+        SC_CHECK_MPI (mpiret);
       }
-#endif
+
+      /* increment parent index */
+      parent_index++;
     }
-    tquadrants = NULL;          /* safeguard */
   }
+  /* END: send */
 
-  /* end balance_A, start balance_comm */
-#ifdef P4EST_ENABLE_MPI
-  is_ranges_primary = 0;
-  is_ranges_active = 0;
-  is_notify_active = 1;
-  is_balance_verify = 0;
-#endif
-  if (p4est->inspect != NULL) {
-    p4est->inspect->balance_A += sc_MPI_Wtime ();
-    p4est->inspect->balance_comm = -sc_MPI_Wtime ();
-    p4est->inspect->balance_comm_sent = 0;
-    p4est->inspect->balance_comm_nzpeers = 0;
-    for (k = 0; k < 2; ++k) {
-      p4est->inspect->balance_zero_sends[k] = 0;
-      p4est->inspect->balance_zero_receives[k] = 0;
-    }
-    p4est->inspect->balance_ranges = 0.;
-    p4est->inspect->balance_notify = 0.;
-    p4est->inspect->balance_notify_allgather = 0.;
-#ifdef P4EST_ENABLE_MPI
-    is_ranges_primary = p4est->inspect->use_balance_ranges;
-    is_ranges_active = is_ranges_primary;
-    is_notify_active = !is_ranges_primary;
-    if (p4est->inspect->use_balance_ranges_notify) {
-      is_ranges_active = is_notify_active = 1;
+  /* BEGIN: receive */
+  if (rank != 0 && partition_new[rank] < partition_new[rank + 1]) {
+    /* if this process should get quadrants */
+    /* determine process ids to receive from */
+    num_receives = 0;           /* number of receives */
+    receive_lowest = num_procs; /* lowest process id */
+    receive_highest = 0;        /* highest process id */
+    for (i = 0; i < num_procs; i++) {   /* loop over all processes */
+      if (partition_now[i] < partition_now[i + 1] &&
+          partition_now[i] <= partition_new[rank] + P4EST_CHILDREN - 2 &&
+          partition_new[rank] - P4EST_CHILDREN + 1 < partition_now[i + 1]) {
+        /* if process `i` has relevant quadrants for this process */
+        num_receives++;
+        receive_lowest = SC_MIN (receive_lowest, i);
+        receive_highest = SC_MAX (receive_highest, i);
+
+        if (partition_now[i] <= partition_new[rank] &&
+            partition_new[rank] < partition_now[i + 1]) {
+          /* if cut is owned by process `i` */
+          /* process id that sends parent of cut quadrant */
+          process_with_cut = i;
+
+          /* array index of receive messages of process with cut  */
+          process_with_cut_recv_id = num_receives - 1;
+        }
+      }
     }
-    is_balance_verify = p4est->inspect->use_balance_verify;
-#endif
   }
+  else {
+    /* set number of messages to receive */
+    num_receives = 0;
 
-#ifdef P4EST_ENABLE_MPI
-  /* encode and distribute the asymmetric communication pattern */
-  procs = NULL;
-  receiver_ranks = sender_ranks = NULL;
-  num_receivers = num_senders = 0;
-  receiver_ranks_ranges = sender_ranks_ranges = NULL;
-  num_receivers_ranges = num_senders_ranges = 0;
-  receiver_ranks_notify = sender_ranks_notify = NULL;
-  num_receivers_notify = num_senders_notify = 0;
+    /* set correction */
+    correction_local = 0;
+  }
 
-  /* determine asymmetric communication pattern by sc_ranges function */
-  if (is_ranges_active) {
-    procs = P4EST_ALLOC (int, num_procs);
-    receiver_ranks_ranges = P4EST_ALLOC (int, num_procs);
-    sender_ranks_ranges = P4EST_ALLOC (int, num_procs);
+  if (num_receives > 0) {       /* if this process receives messages */
+    /* allocate receive messages */
+    receive_requests = P4EST_ALLOC (MPI_Request, num_receives);
+    parent_receive = P4EST_ALLOC (p4est_quadrant_t, num_receives);
+    receive_process = P4EST_ALLOC (int, num_receives);
 
-    for (j = 0; j < num_procs; ++j) {
-      procs[j] = (int) peers[j].send_first.elem_count;
-    }
-    maxpeers = first_peer;
-    maxwin = last_peer;
-    max_ranges = p4est_num_ranges;
-    if (p4est->inspect != NULL) {
-      if (p4est->inspect->balance_max_ranges > 0 &&
-          p4est->inspect->balance_max_ranges < p4est_num_ranges) {
-        max_ranges = p4est->inspect->balance_max_ranges;
+    /* array index of receive messages */
+    parent_index = 0;
+
+    for (i = receive_lowest; i <= receive_highest; i++) {
+      /* loop over all process candidates to receive from */
+      if (!(partition_now[i] < partition_now[i + 1] &&
+            partition_now[i] <= partition_new[rank] + P4EST_CHILDREN - 2 &&
+            partition_new[rank] - P4EST_CHILDREN + 1 <
+            partition_now[i + 1])) {
+        /* if process `i` has no relevant quadrants for this process */
+        continue;
       }
-      p4est->inspect->balance_ranges = -MPI_Wtime ();
-    }
-    nwin = sc_ranges_adaptive (p4est_package_id,
-                               p4est->mpicomm, procs, &maxpeers, &maxwin,
-                               max_ranges, my_ranges, &all_ranges);
-    twomaxwin = 2 * maxwin;
-    if (p4est->inspect != NULL) {
-      p4est->inspect->balance_ranges += MPI_Wtime ();
+      /* store process index */
+      receive_process[parent_index] = i;
+
+      /* MPI receive */
+      mpiret = MPI_Irecv (&parent_receive[parent_index],
+                          sizeof (p4est_quadrant_t), MPI_BYTE,
+                          i,
+                          P4EST_COMM_PARTITION_CORRECTION, p4est->mpicomm,
+                          &receive_requests[parent_index]);
+      SC_CHECK_MPI (mpiret);
+
+      /* increment parent index */
+      parent_index++;
     }
-    sc_ranges_decode (num_procs, rank, maxwin, all_ranges,
-                      &num_receivers_ranges, receiver_ranks_ranges,
-                      &num_senders_ranges, sender_ranks_ranges);
-    if (is_balance_verify) {
-      /* verification written after using sc_ranges_decode */
-      k = 0;
-      for (j = 0; j < num_procs; ++j) {
-        if (j == rank) {
-          continue;
-        }
-        if (procs[j] > 0) {
-          P4EST_ASSERT (k < num_receivers_ranges &&
-                        receiver_ranks_ranges[k] == j);
-          ++k;
-        }
-        else {
-          if (k < num_receivers_ranges && receiver_ranks_ranges[k] == j) {
-            ++k;
-          }
-        }
-      }
-      P4EST_ASSERT (k == num_receivers_ranges);
+  }
+  /* END: receive */
 
-      /* original verification loop modified and partially redundant */
-      k = 0;
-      for (j = first_peer; j <= last_peer; ++j) {
-        if (j == rank) {
-          P4EST_ASSERT (k == num_receivers_ranges ||
-                        receiver_ranks_ranges[k] != j);
-          continue;
-        }
-        peer = peers + j;
-        qcount = peer->send_first.elem_count;
+  /* BEGIN: wait for MPI receive to complete */
+  if (num_receives > 0) {
+    /* wait for receives to complete */
+    mpiret =
+      MPI_Waitall (num_receives, receive_requests, MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
 
-        for (i = 0; i < nwin - 1; ++i) {
-          if (j > my_ranges[2 * i + 1] && j < my_ranges[2 * (i + 1)]) {
-            break;
-          }
-        }
-        if (i < nwin - 1) {
-          P4EST_ASSERT (qcount == 0);
-          P4EST_ASSERT (k == num_receivers_ranges ||
-                        receiver_ranks_ranges[k] != j);
-          continue;
-        }
-        P4EST_ASSERT (k < num_receivers_ranges &&
-                      receiver_ranks_ranges[k] == j);
-        ++k;
-      }
-      P4EST_ASSERT (k == num_receivers_ranges);
+    /* free receive memory */
+    P4EST_FREE (receive_requests);
+  }
+  /* END: wait for MPI recieve to complete */
 
-      /* original verification loop of who is sending to me */
-      k = 0;
-      for (j = 0; j < num_procs; ++j) {
-        if (j == rank) {
-          P4EST_ASSERT (k == num_senders_ranges ||
-                        sender_ranks_ranges[k] != j);
-          continue;
+  /* BEGIN: compute correction with received quadrants */
+  if (num_receives > 0) {
+    /* if this process received quadrants */
+    min_quad_id = partition_new[rank];  /* min quadrant id with same parent */
+    max_quad_id = partition_new[rank];  /* max quadrant id with same parent */
+
+    for (i = 0; i < num_receives; i++) {
+      /* loop over all received (parent or tree root) quadrants */
+      if (parent_receive[i].p.piggy3.which_tree ==
+          parent_receive[process_with_cut_recv_id].p.piggy3.which_tree
+          &&
+          p4est_quadrant_is_equal (&parent_receive[i],
+                                   &parent_receive[process_with_cut_recv_id]
+          )) {
+        /* if trees and parents are equal */
+        /* decrease/increase min/max quadrant with same parent */
+        if (receive_process[i] < process_with_cut) {
+          /* if before process with cut */
+          /* decrease min quadrant */
+          min_quad_id -= parent_receive[i].p.piggy3.local_num;
+        }
+        else if (receive_process[i] > process_with_cut) {
+          /* if after process with cut */
+          /* increase max quadrant */
+          max_quad_id += parent_receive[i].p.piggy3.local_num;
         }
-        for (i = 0; i < maxwin; ++i) {
-          first_bound = all_ranges[twomaxwin * j + 2 * i];
-          if (first_bound == -1 || first_bound > rank) {
-            P4EST_ASSERT (k == num_senders_ranges ||
-                          sender_ranks_ranges[k] != j);
-            break;
-          }
-          if (rank <= all_ranges[twomaxwin * j + 2 * i + 1]) {
-            /* processor j is sending to me */
-            P4EST_ASSERT (k < num_senders_ranges &&
-                          sender_ranks_ranges[k] == j);
-            ++k;
-            break;
-          }
+        else {
+          /* decrease min quadrant */
+          min_quad_id -=
+            parent_receive[i].p.piggy3.local_num / P4EST_CHILDREN;
+
+          /* increase max quadrant */
+          max_quad_id +=
+            parent_receive[i].p.piggy3.local_num % P4EST_CHILDREN;
         }
       }
-      P4EST_ASSERT (k == num_senders_ranges);
     }
-#ifdef P4EST_ENABLE_DEBUG
-    P4EST_GLOBAL_STATISTICSF ("Max peers %d ranges %d/%d\n",
-                              maxpeers, maxwin, max_ranges);
-    sc_ranges_statistics (p4est_package_id, SC_LP_STATISTICS,
-                          p4est->mpicomm, num_procs, procs,
-                          rank, max_ranges, my_ranges);
-#endif
-    SC_FREE (all_ranges);
-    P4EST_FREE (procs);
-    P4EST_VERBOSEF ("Peer ranges %d/%d/%d first %d last %d\n",
-                    nwin, maxwin, max_ranges, first_peer, last_peer);
+
+    /* compute correction */
+    correction_local =
+      (int) p4est_partition_correction (partition_new, num_procs, rank,
+                                        min_quad_id, max_quad_id);
+
+    /* free receive memory */
+    P4EST_FREE (parent_receive);
+    P4EST_FREE (receive_process);
   }
+  /* END: compute correction with received parent quadrants */
 
-  /* determine asymmetric communication pattern by sc_notify function */
-  if (is_notify_active) {
-    receiver_ranks_notify = P4EST_ALLOC (int, num_procs);
-    sender_ranks_notify = P4EST_ALLOC (int, num_procs);
-    num_receivers_notify = num_senders_notify = 0;
+  /* free memory */
+  P4EST_FREE (partition_new);
 
-    for (j = 0; j < num_procs; ++j) {
-      if (j != rank && peers[j].send_first.elem_count > 0) {
-        receiver_ranks_notify[num_receivers_notify++] = j;
-      }
-    }
-    if (p4est->inspect != NULL) {
-      p4est->inspect->balance_notify = -MPI_Wtime ();
-    }
-    mpiret = sc_notify (receiver_ranks_notify, num_receivers_notify,
-                        sender_ranks_notify, &num_senders_notify,
-                        p4est->mpicomm);
-    SC_CHECK_MPI (mpiret);
-    if (p4est->inspect != NULL) {
-      p4est->inspect->balance_notify += MPI_Wtime ();
-    }
+  /* communicate corrections */
+  correction = P4EST_ALLOC (int, num_procs);
+  mpiret = MPI_Allgather (&correction_local, 1, MPI_INT,
+                          correction, 1, MPI_INT, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
 
-    /* double-check sc_notify results by sc_notify_allgather */
-    if (is_balance_verify) {
-      int                *sender_ranks2, num_senders2;
+  /* BEGIN: wait for MPI send to complete */
+  if (num_sends > 0) {
+    /* wait for sends to complete */
+    mpiret = MPI_Waitall (num_sends, send_requests, MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
 
-      sender_ranks2 = P4EST_ALLOC (int, num_procs);
-      if (p4est->inspect != NULL) {
-        p4est->inspect->balance_notify_allgather = -MPI_Wtime ();
-      }
-      mpiret = sc_notify_allgather (receiver_ranks_notify,
-                                    num_receivers_notify,
-                                    sender_ranks2, &num_senders2,
-                                    p4est->mpicomm);
-      SC_CHECK_MPI (mpiret);
-      if (p4est->inspect != NULL) {
-        p4est->inspect->balance_notify_allgather += MPI_Wtime ();
-      }
+    /* free send memory */
+    P4EST_FREE (parent_send);
+    P4EST_FREE (send_requests);
+  }
+  /* END: wait for MPI send to complete */
 
-      /* run verification against sc_notify_allgather */
-      SC_CHECK_ABORT (num_senders2 == num_senders_notify,
-                      "Failed notify_allgather sender count");
-      for (j = 0; j < num_senders_notify; ++j) {
-        SC_CHECK_ABORT (sender_ranks2[j] == sender_ranks_notify[j],
-                        "Failed notify_allgather sender rank");
-      }
-      P4EST_FREE (sender_ranks2);
+  /* correct partition */
+  current_proc =
+    p4est_next_nonempty_process (0, num_procs, num_quadrants_in_proc);
+  next_proc =
+    p4est_next_nonempty_process (current_proc + 1, num_procs,
+                                 num_quadrants_in_proc);
+  num_moved_quadrants = 0;
+  while (current_proc < num_procs) {
+    /* loop over all non empty processes */
+    /* compute correct partition for process `current_proc` */
+    if (0 < current_proc && current_proc < num_procs) {
+      /* if any process but first */
+      num_quadrants_in_proc[current_proc] += correction[current_proc];
+      /* input is just a locidx, but the result is gloidx so we cast cleanly */
+      num_moved_quadrants += P4EST_GLOIDX_ABS (correction[current_proc]);
     }
+    if (next_proc < num_procs) {
+      /* if first process or next process is feasible */
+      num_quadrants_in_proc[current_proc] -= correction[next_proc];
+    }
+
+    /* increase process ids */
+    current_proc = next_proc;
+    next_proc =
+      p4est_next_nonempty_process (next_proc + 1, num_procs,
+                                   num_quadrants_in_proc);
   }
 
-  /* verify sc_ranges and sc_notify against each other */
-  if (is_ranges_active && is_notify_active && is_balance_verify) {
-#ifdef P4EST_ENABLE_DEBUG
-    int                 found_in_ranges, found_in_notify;
+  /* free memory */
+  P4EST_FREE (correction);
+
+  /* return absolute number of moved quadrants */
+  return num_moved_quadrants;
+#else
+  P4EST_ASSERT (num_quadrants_in_proc[0] == p4est->local_num_quadrants);
+
+  return 0;
 #endif
+}
 
-    /* verify receiver side */
-    P4EST_ASSERT (num_receivers_notify <= num_receivers_ranges);
-    k = l = 0;
-    for (j = 0; j < num_procs; ++j) {
-      P4EST_DEBUG_EXECUTE (found_in_ranges = found_in_notify = 0);
-      if (k < num_receivers_ranges && receiver_ranks_ranges[k] == j) {
-        P4EST_ASSERT (j != rank);
-        P4EST_DEBUG_EXECUTE (found_in_ranges = 1);
-        ++k;
-      }
-      if (l < num_receivers_notify && receiver_ranks_notify[l] == j) {
-        P4EST_ASSERT (j != rank && found_in_ranges);
-        P4EST_DEBUG_EXECUTE (found_in_notify = 1);
-        ++l;
-      }
-      if (j != rank && peers[j].send_first.elem_count > 0) {
-        P4EST_ASSERT (found_in_ranges && found_in_notify);
-      }
-      if (peers[j].send_first.elem_count == 0) {
-        P4EST_ASSERT (!found_in_notify);
-      }
-    }
-    P4EST_ASSERT (k == num_receivers_ranges);
-    P4EST_ASSERT (l == num_receivers_notify);
+unsigned
+p4est_checksum (p4est_t * p4est)
+{
+  return p4est_checksum_ext (p4est, 0);
+}
 
-    /* verify sender side */
-    P4EST_ASSERT (num_senders_notify <= num_senders_ranges);
-    k = l = 0;
-    for (j = 0; j < num_procs; ++j) {
-      P4EST_DEBUG_EXECUTE (found_in_ranges = found_in_notify = 0);
-      if (k < num_senders_ranges && sender_ranks_ranges[k] == j) {
-        P4EST_ASSERT (j != rank);
-        P4EST_DEBUG_EXECUTE (found_in_ranges = 1);
-        ++k;
+unsigned
+p4est_checksum_ext (p4est_t * p4est, int checksum_data)
+{
+#ifdef P4EST_HAVE_ZLIB
+  const size_t        data_size = p4est->data_size;
+  uLong               treecrc, datacrc, crc;
+  size_t              scount, ssum;
+  size_t              zz, zcount, dfill;
+  char                dbuf[4096];
+  p4est_topidx_t      nt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+
+  crc = adler32 (0, Z_NULL, 0);
+  ssum = 0;
+  for (nt = p4est->first_local_tree; nt <= p4est->last_local_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    zcount = tree->quadrants.elem_count;
+
+    /* the NULL checkarray selects the batched streaming path */
+    treecrc = (uLong) p4est_quadrant_checksum (&tree->quadrants, NULL, 0);
+    scount = 4 * (P4EST_DIM + 1) * zcount;
+    ssum += scount;
+    crc = adler32_combine (crc, treecrc, (z_off_t) scount);
+
+    if (checksum_data && data_size > 0) {
+      /* the payload lives in the mempool; batch it through a buffer */
+      datacrc = adler32 (0, Z_NULL, 0);
+      dfill = 0;
+      for (zz = 0; zz < zcount; ++zz) {
+        q = p4est_quadrant_array_index (&tree->quadrants, zz);
+        if (data_size > sizeof (dbuf)) {
+          datacrc = adler32 (datacrc, (const Bytef *) q->p.user_data,
+                             (uInt) data_size);
+        }
+        else {
+          if (dfill + data_size > sizeof (dbuf)) {
+            datacrc = adler32 (datacrc, (const Bytef *) dbuf, (uInt) dfill);
+            dfill = 0;
+          }
+          memcpy (dbuf + dfill, q->p.user_data, data_size);
+          dfill += data_size;
+        }
       }
-      if (l < num_senders_notify && sender_ranks_notify[l] == j) {
-        P4EST_ASSERT (j != rank && found_in_ranges);
-        P4EST_DEBUG_EXECUTE (found_in_notify = 1);      /* for symmetry */
-        ++l;
+      if (dfill > 0) {
+        datacrc = adler32 (datacrc, (const Bytef *) dbuf, (uInt) dfill);
       }
+      scount = zcount * data_size;
+      ssum += scount;
+      crc = adler32_combine (crc, datacrc, (z_off_t) scount);
     }
-    P4EST_ASSERT (k == num_senders_ranges);
-    P4EST_ASSERT (l == num_senders_notify);
   }
+  P4EST_ASSERT (checksum_data || (p4est_locidx_t) ssum ==
+                p4est->local_num_quadrants * 4 * (P4EST_DIM + 1));
+
+  return p4est_comm_checksum (p4est, (unsigned) crc, ssum);
+#else
+  sc_abort_collective
+    ("Configure did not find a recent enough zlib.  Abort.\n");
+
+  return 0;
+#endif /* !P4EST_HAVE_ZLIB */
+}
+
+void
+p4est_save (const char *filename, p4est_t * p4est, int save_data)
+{
+  p4est_save_ext (filename, p4est, save_data, 1);
+}
+
+void
+p4est_save_ext (const char *filename, p4est_t * p4est,
+                int save_data, int save_partition)
+{
+  const int           headc = 6;
+  const int           align = 32;
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+#ifndef P4EST_MPIIO_WRITE
+  MPI_Status          mpistatus;
+#endif
+#endif
+  int                 retval;
+  int                 num_procs, save_num_procs, rank;
+  int                 i;
+  long                fpos = -1, foffset;
+  size_t              data_size, qbuf_size, comb_size, head_count;
+  size_t              zz, zcount;
+  uint64_t           *u64a;
+  FILE               *file;
+#ifdef P4EST_MPIIO_WRITE
+  MPI_File            mpifile;
+  MPI_Offset          mpipos;
+  MPI_Offset          mpithis;
+#else
+  long                fthis;
+#endif
+  p4est_topidx_t      jt, num_trees;
+  p4est_gloidx_t     *pertree;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+  char               *lbuf, *bp;
+  p4est_qcoord_t     *qpos;
+  sc_array_t         *tquadrants;
 
-  /*
-   * loop over all peers and send first round of quadrants
-   * for intra-tree balancing, each load is contained in one tree
-   */
-  total_send_count = total_recv_count = 0;
-  request_first_count = request_second_count = request_send_count = 0;
-  send_zero[0] = send_load[0] = recv_zero[0] = recv_load[0] = 0;
-  send_zero[1] = send_load[1] = recv_zero[1] = recv_load[1] = 0;
-  if (is_ranges_primary) {
-    P4EST_ASSERT (is_ranges_active);
-    receiver_ranks = receiver_ranks_ranges;
-    sender_ranks = sender_ranks_ranges;
-    num_receivers = num_receivers_ranges;
-    num_senders = num_senders_ranges;
-  }
-  else {
-    P4EST_ASSERT (is_notify_active);
-    receiver_ranks = receiver_ranks_notify;
-    sender_ranks = sender_ranks_notify;
-    num_receivers = num_receivers_notify;
-    num_senders = num_senders_notify;
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_save %s\n", filename);
+  p4est_log_indent_push ();
+
+  P4EST_ASSERT (p4est_connectivity_is_valid (p4est->connectivity));
+  P4EST_ASSERT (p4est_is_valid (p4est));
+
+  /* when data is not saved the size is set to zero */
+  data_size = save_data ? p4est->data_size : 0;
+
+  /* zero data size is effectively not saved */
+  if (data_size == 0) {
+    save_data = 0;
   }
-  P4EST_ASSERT (receiver_ranks != NULL && sender_ranks != NULL);
-  num_receivers_ranges = num_senders_ranges = 0;
-  num_receivers_notify = num_senders_notify = 0;
 
-  /* Use receiver_ranks array to send to them */
-  for (k = 0; k < num_receivers; ++k) {
-    j = receiver_ranks[k];
-    P4EST_ASSERT (j >= first_peer && j <= last_peer && j != rank);
-    peer = peers + j;
-    qcount = peer->send_first.elem_count;
+  /* other parameters */
+  num_trees = p4est->connectivity->num_trees;
+  num_procs = p4est->mpisize;
+  save_num_procs = save_partition ? num_procs : 1;
+  head_count = (size_t) (headc + save_num_procs) + (size_t) num_trees;
+  rank = p4est->mpirank;
+  qbuf_size = (P4EST_DIM + 1) * sizeof (p4est_qcoord_t);
+  comb_size = qbuf_size + data_size;
+  pertree = P4EST_ALLOC (p4est_gloidx_t, num_trees + 1);
+  p4est_comm_count_pertree (p4est, pertree);
 
-    /* first send number of quadrants to be expected */
-    if (qcount > 0) {
-      P4EST_LDEBUGF ("Balance A send %llu quadrants to %d\n",
-                     (unsigned long long) qcount, j);
-      ++send_load[0];
+  if (rank == 0) {
+    p4est_connectivity_save (filename, p4est->connectivity);
+
+    /* open file after writing connectivity to it */
+    file = fopen (filename, "ab");
+    SC_CHECK_ABORT (file != NULL, "file open");
+
+    /* align the start of the header */
+    fpos = ftell (file);
+    SC_CHECK_ABORT (fpos > 0, "first file tell");
+    while (fpos % align != 0) {
+      retval = fputc ('\0', file);
+      SC_CHECK_ABORT (retval == 0, "first file align");
+      ++fpos;
+    }
+
+    /* write format and partition information */
+    u64a = P4EST_ALLOC (uint64_t, head_count);
+    u64a[0] = P4EST_ONDISK_FORMAT;
+    u64a[1] = (uint64_t) sizeof (p4est_qcoord_t);
+    u64a[2] = (uint64_t) sizeof (p4est_quadrant_t);
+    u64a[3] = (uint64_t) data_size;
+    u64a[4] = (uint64_t) save_data;
+    u64a[5] = (uint64_t) save_num_procs;
+    if (save_partition) {
+      P4EST_ASSERT (save_num_procs == num_procs);
+      for (i = 0; i < num_procs; ++i) {
+        u64a[headc + i] = (uint64_t) p4est->global_first_quadrant[i + 1];
+      }
     }
     else {
-      P4EST_ASSERT (is_ranges_primary);
-      ++send_zero[0];
+      P4EST_ASSERT (save_num_procs == 1);
+      u64a[headc] = (uint64_t) p4est->global_first_quadrant[num_procs];
     }
-    peer->send_first_count = (int) qcount;
-    mpiret = MPI_Isend (&peer->send_first_count, 1, MPI_INT,
-                        j, P4EST_COMM_BALANCE_FIRST_COUNT,
-                        p4est->mpicomm, &send_requests_first_count[j]);
-    SC_CHECK_MPI (mpiret);
-    ++request_send_count;
-
-    /* sort and send the actual quadrants and post receive for reply */
-    if (qcount > 0) {
-      sc_array_sort (&peer->send_first, p4est_quadrant_compare_piggy);
-
-#ifdef P4EST_ENABLE_DEBUG
-      checksum = p4est_quadrant_checksum (&peer->send_first, &checkarray, 0);
-      P4EST_LDEBUGF ("Balance A send checksum 0x%08x to %d\n", checksum, j);
-#endif /* P4EST_ENABLE_DEBUG */
+    for (jt = 0; jt < num_trees; ++jt) {
+      u64a[headc + save_num_procs + jt] = (uint64_t) pertree[jt + 1];
+    }
+    sc_fwrite (u64a, sizeof (uint64_t), head_count,
+               file, "write header information");
+    P4EST_FREE (u64a);
+    fpos += head_count * sizeof (uint64_t);
 
-      total_send_count += qcount;
-      qbytes = qcount * sizeof (p4est_quadrant_t);
-      mpiret = MPI_Isend (peer->send_first.array, (int) qbytes, MPI_BYTE,
-                          j, P4EST_COMM_BALANCE_FIRST_LOAD,
-                          p4est->mpicomm, &send_requests_first_load[j]);
-      SC_CHECK_MPI (mpiret);
-      ++request_send_count;
-      mpiret = MPI_Irecv (&peer->recv_second_count, 1, MPI_INT,
-                          j, P4EST_COMM_BALANCE_SECOND_COUNT,
-                          p4est->mpicomm, &requests_second[j]);
-      SC_CHECK_MPI (mpiret);
-      ++request_second_count;
+    /* align the start of the quadrants */
+    fpos = ftell (file);
+    SC_CHECK_ABORT (fpos > 0, "second file tell");
+    while (fpos % align != 0) {
+      retval = fputc ('\0', file);
+      SC_CHECK_ABORT (retval == 0, "second file align");
+      ++fpos;
     }
-  }
-  peer = NULL;
-  P4EST_FREE (receiver_ranks_ranges);
-  P4EST_FREE (receiver_ranks_notify);
-  receiver_ranks = receiver_ranks_ranges = receiver_ranks_notify = NULL;
 
-  /* find out who is sending to me and receive quadrant counts */
-  for (k = 0; k < num_senders; ++k) {
-    j = sender_ranks[k];
-    ++request_first_count;
-    mpiret = MPI_Irecv (&peers[j].recv_first_count, 1, MPI_INT,
-                        j, P4EST_COMM_BALANCE_FIRST_COUNT,
-                        p4est->mpicomm, &requests_first[j]);
-    SC_CHECK_MPI (mpiret);
+#ifdef P4EST_MPIIO_WRITE
+    /* We will close the sequential access to the file */
+    /* best attempt to flush file to disk */
+    retval = fflush (file);
+    SC_CHECK_ABORT (retval == 0, "file flush");
+#ifdef P4EST_HAVE_FSYNC
+    retval = fsync (fileno (file));
+    SC_CHECK_ABORT (retval == 0, "file fsync");
+#endif
+    retval = fclose (file);
+    SC_CHECK_ABORT (retval == 0, "file close");
+    file = NULL;
+#else
+    /* file is still open for sequential write mode */
+#endif
   }
-  P4EST_FREE (sender_ranks_ranges);
-  P4EST_FREE (sender_ranks_notify);
-  sender_ranks = sender_ranks_ranges = sender_ranks_notify = NULL;
+  else {
+    file = NULL;
+  }
+  P4EST_FREE (pertree);
 
-  /* wait for quadrant counts and post receive and send for quadrants */
-  while (request_first_count > 0) {
-    mpiret = MPI_Waitsome (num_procs, requests_first,
-                           &outcount, wait_indices, recv_statuses);
+#ifndef P4EST_MPIIO_WRITE
+  if (rank > 0) {
+    /* wait for sequential synchronization */
+#ifdef P4EST_ENABLE_MPI
+    mpiret = MPI_Recv (&fpos, 1, MPI_LONG, rank - 1, P4EST_COMM_SAVE,
+                       p4est->mpicomm, &mpistatus);
     SC_CHECK_MPI (mpiret);
-    P4EST_ASSERT (outcount != MPI_UNDEFINED);
-    P4EST_ASSERT (outcount > 0);
-    for (i = 0; i < outcount; ++i) {
-      /* retrieve sender's rank */
-      j = wait_indices[i];
-      jstatus = &recv_statuses[i];
-      wait_indices[i] = -1;
-      P4EST_ASSERT (j != rank && 0 <= j && j < num_procs);
-      P4EST_ASSERT (requests_first[j] == MPI_REQUEST_NULL);
-      P4EST_ASSERT (jstatus->MPI_SOURCE == j);
-
-      /* check if we are in receiving count or load */
-      peer = peers + j;
-      P4EST_ASSERT (!peer->have_first_load);
-      if (!peer->have_first_count) {
-        /* verify message size */
-        P4EST_ASSERT (jstatus->MPI_TAG == P4EST_COMM_BALANCE_FIRST_COUNT);
-        mpiret = MPI_Get_count (jstatus, MPI_INT, &rcount);
-        SC_CHECK_MPI (mpiret);
-        SC_CHECK_ABORTF (rcount == 1, "Receive count mismatch A %d", rcount);
-
-        /* process the count information received */
-        peer->have_first_count = 1;
-        qcount = (size_t) peer->recv_first_count;
-        if (qcount > 0) {
-          /* received nonzero count, post receive for load */
-          P4EST_LDEBUGF ("Balance A recv %llu quadrants from %d\n",
-                         (unsigned long long) qcount, j);
-          P4EST_ASSERT (peer->recv_first.elem_count == 0);
-          sc_array_resize (&peer->recv_first, qcount);
-          total_recv_count += qcount;
-          qbytes = qcount * sizeof (p4est_quadrant_t);
-          P4EST_ASSERT (requests_first[j] == MPI_REQUEST_NULL);
-          mpiret = MPI_Irecv (peer->recv_first.array, (int) qbytes, MPI_BYTE,
-                              j, P4EST_COMM_BALANCE_FIRST_LOAD,
-                              p4est->mpicomm, &requests_first[j]);
-          SC_CHECK_MPI (mpiret);
-          ++recv_load[0];
-        }
-        else {
-          /* will not receive load, close this request */
-          P4EST_ASSERT (qcount == 0);
-          P4EST_ASSERT (requests_first[j] == MPI_REQUEST_NULL);
-          --request_first_count;
-          ++recv_zero[0];
-        }
-      }
-      else {
-        /* verify received size */
-        P4EST_ASSERT (jstatus->MPI_TAG == P4EST_COMM_BALANCE_FIRST_LOAD);
-        P4EST_ASSERT (peer->recv_first_count > 0);
-        mpiret = MPI_Get_count (jstatus, MPI_BYTE, &rcount);
-        SC_CHECK_MPI (mpiret);
-        SC_CHECK_ABORTF (rcount ==
-                         peer->recv_first_count *
-                         (int) sizeof (p4est_quadrant_t),
-                         "Receive load mismatch A %d %dx%llu", rcount,
-                         peer->recv_first_count,
-                         (unsigned long long) sizeof (p4est_quadrant_t));
-
-        /* received load, close this request */
-        peer->have_first_load = 1;
-        P4EST_ASSERT (requests_first[j] == MPI_REQUEST_NULL);
-        --request_first_count;
-
-#ifdef P4EST_ENABLE_DEBUG
-        checksum =
-          p4est_quadrant_checksum (&peer->recv_first, &checkarray, 0);
-        P4EST_LDEBUGF ("Balance A recv checksum 0x%08x from %d\n", checksum,
-                       j);
-#endif /* P4EST_ENABLE_DEBUG */
+#endif
 
-        /* process incoming quadrants to interleave with communication */
-        p4est_balance_response (p4est, peer, btype, borders);
-        qcount = peer->send_second.elem_count;
-        if (qcount > 0) {
-          P4EST_LDEBUGF ("Balance B send %llu quadrants to %d\n",
-                         (unsigned long long) qcount, j);
-          ++send_load[1];
-        }
-        else {
-          ++send_zero[1];
-        }
-        peer->send_second_count = (int) qcount;
-        mpiret = MPI_Isend (&peer->send_second_count, 1, MPI_INT,
-                            j, P4EST_COMM_BALANCE_SECOND_COUNT,
-                            p4est->mpicomm, &send_requests_second_count[j]);
-        SC_CHECK_MPI (mpiret);
-        ++request_send_count;
-        if (qcount > 0) {
+    /* open file after all previous processors have written to it */
+    file = fopen (filename, "rb+");
+    SC_CHECK_ABORT (file != NULL, "file open");
+  }
+#else
+  /* Every core opens the file in append mode */
+  mpiret = MPI_File_open (p4est->mpicomm, (char *) filename,
+                          MPI_MODE_WRONLY | MPI_MODE_APPEND |
+                          MPI_MODE_UNIQUE_OPEN, MPI_INFO_NULL, &mpifile);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_File_get_position (mpifile, &mpipos);
+  SC_CHECK_MPI (mpiret);
+#endif
 
-#ifdef P4EST_ENABLE_DEBUG
-          checksum =
-            p4est_quadrant_checksum (&peer->send_second, &checkarray, 0);
-          P4EST_LDEBUGF ("Balance B send checksum 0x%08x to %d\n", checksum,
-                         j);
-#endif /* P4EST_ENABLE_DEBUG */
+  foffset = (long) (p4est->global_first_quadrant[rank] * comb_size);
+#ifndef P4EST_MPIIO_WRITE
+  if (rank > 0) {
+    /* seek to the beginning of this processor's storage */
+    fthis = fpos + foffset;
+    retval = fseek (file, fthis, SEEK_SET);
+    SC_CHECK_ABORT (retval == 0, "seek data");
+  }
 
-          total_send_count += qcount;
-          qbytes = qcount * sizeof (p4est_quadrant_t);
-          mpiret = MPI_Isend (peer->send_second.array, (int) qbytes, MPI_BYTE,
-                              j, P4EST_COMM_BALANCE_SECOND_LOAD,
-                              p4est->mpicomm, &send_requests_second_load[j]);
-          SC_CHECK_MPI (mpiret);
-          ++request_send_count;
-        }
+  /* write quadrant coordinates and data interleaved */
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tquadrants = &tree->quadrants;
+    zcount = tquadrants->elem_count;
+
+    /* storage that will be written for this tree */
+    bp = lbuf = P4EST_ALLOC (char, comb_size * zcount);
+    for (zz = 0; zz < zcount; ++zz) {
+      qpos = (p4est_locidx_t *) bp;
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      *qpos++ = q->x;
+      *qpos++ = q->y;
+#ifdef P4_TO_P8
+      *qpos++ = q->z;
+#endif
+      *qpos++ = (p4est_qcoord_t) q->level;
+      if (save_data) {
+        memcpy (qpos, q->p.user_data, data_size);
       }
+      bp += comb_size;
     }
+    sc_fwrite (lbuf, comb_size, zcount, file, "write quadrants");
+    P4EST_FREE (lbuf);
   }
-  for (j = 0; j < num_procs; ++j) {
-    P4EST_ASSERT (requests_first[j] == MPI_REQUEST_NULL);
+#else
+  /* pack all local quadrants and write them with one collective call
+   * at this processor's explicit offset */
+  mpithis = mpipos + (MPI_Offset) foffset;
+  zcount = (size_t) p4est->local_num_quadrants;
+  bp = lbuf = P4EST_ALLOC (char, comb_size * zcount);
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tquadrants = &tree->quadrants;
+    for (zz = 0; zz < tquadrants->elem_count; ++zz) {
+      qpos = (p4est_locidx_t *) bp;
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      *qpos++ = q->x;
+      *qpos++ = q->y;
+#ifdef P4_TO_P8
+      *qpos++ = q->z;
+#endif
+      *qpos++ = (p4est_qcoord_t) q->level;
+      if (save_data) {
+        memcpy (qpos, q->p.user_data, data_size);
+      }
+      bp += comb_size;
+    }
   }
-#endif /* P4EST_ENABLE_MPI */
+  mpiret = MPI_File_write_at_all (mpifile, mpithis, lbuf,
+                                  (int) (comb_size * zcount), MPI_BYTE,
+                                  MPI_STATUS_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (lbuf);
+#endif
 
-  /* simulate send and receive with myself across tree boundaries */
-  peer = peers + rank;
-  sc_array_sort (&peer->send_first, p4est_quadrant_compare_piggy);
-  qcount = peer->send_first.elem_count;
-  peer->recv_first_count = peer->send_first_count = (int) qcount;
-  qbytes = qcount * sizeof (p4est_quadrant_t);
-  qarray = &peer->recv_first;
-  sc_array_resize (qarray, qcount);
-  memcpy (qarray->array, peer->send_first.array, qbytes);
-  p4est_balance_response (p4est, peer, btype, borders);
-  qcount = peer->send_second.elem_count;
-  peer->recv_second_count = peer->send_second_count = (int) qcount;
-  qbytes = qcount * sizeof (p4est_quadrant_t);
-  qarray = &peer->recv_second;
-  sc_array_resize (qarray, qcount);
-  memcpy (qarray->array, peer->send_second.array, qbytes);
+#ifndef P4EST_MPIIO_WRITE
+  /* best attempt to flush file to disk */
+  retval = fflush (file);
+  SC_CHECK_ABORT (retval == 0, "file flush");
+#ifdef P4EST_HAVE_FSYNC
+  retval = fsync (fileno (file));
+  SC_CHECK_ABORT (retval == 0, "file fsync");
+#endif
+  retval = fclose (file);
+  SC_CHECK_ABORT (retval == 0, "file close");
+  file = NULL;
 
+  /* initiate sequential synchronization */
 #ifdef P4EST_ENABLE_MPI
-  /* receive second round appending to the same receive buffer */
-  while (request_second_count > 0) {
-    mpiret = MPI_Waitsome (num_procs, requests_second,
-                           &outcount, wait_indices, recv_statuses);
+  if (rank < num_procs - 1) {
+    mpiret = MPI_Send (&fpos, 1, MPI_LONG, rank + 1, P4EST_COMM_SAVE,
+                       p4est->mpicomm);
     SC_CHECK_MPI (mpiret);
-    P4EST_ASSERT (outcount != MPI_UNDEFINED);
-    P4EST_ASSERT (outcount > 0);
-    for (i = 0; i < outcount; ++i) {
-      /* retrieve sender's rank */
-      j = wait_indices[i];
-      jstatus = &recv_statuses[i];
-      wait_indices[i] = -1;
-      P4EST_ASSERT (j != rank && 0 <= j && j < num_procs);
-      P4EST_ASSERT (requests_second[j] == MPI_REQUEST_NULL);
-      P4EST_ASSERT (jstatus->MPI_SOURCE == j);
+  }
+#endif
+#else
+  mpiret = MPI_File_close (&mpifile);
+  SC_CHECK_MPI (mpiret);
+#endif
 
-      /* check if we are in receiving count or load */
-      peer = peers + j;
-      P4EST_ASSERT (!peer->have_second_load);
-      if (!peer->have_second_count) {
-        /* verify message size */
-        P4EST_ASSERT (jstatus->MPI_TAG == P4EST_COMM_BALANCE_SECOND_COUNT);
-        mpiret = MPI_Get_count (jstatus, MPI_INT, &rcount);
-        SC_CHECK_MPI (mpiret);
-        SC_CHECK_ABORTF (rcount == 1, "Receive count mismatch B %d", rcount);
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_save\n");
+}
 
-        /* process the count information received */
-        peer->have_second_count = 1;
-        qcount = (size_t) peer->recv_second_count;
-        if (qcount > 0) {
-          /* received nonzero count, post receive for load */
-          P4EST_LDEBUGF ("Balance B recv %llu quadrants from %d\n",
-                         (unsigned long long) qcount, j);
-          P4EST_ASSERT (peer->recv_second.elem_count == 0);
-          sc_array_resize (&peer->recv_second, qcount);
-          total_recv_count += qcount;
-          qbytes = qcount * sizeof (p4est_quadrant_t);
-          P4EST_ASSERT (requests_second[j] == MPI_REQUEST_NULL);
-          mpiret = MPI_Irecv (peer->recv_second.array, (int) qbytes,
-                              MPI_BYTE, j, P4EST_COMM_BALANCE_SECOND_LOAD,
-                              p4est->mpicomm, &requests_second[j]);
-          SC_CHECK_MPI (mpiret);
-          ++recv_load[1];
-        }
-        else {
-          /* will not receive load, close this request */
-          P4EST_ASSERT (qcount == 0);
-          P4EST_ASSERT (requests_second[j] == MPI_REQUEST_NULL);
-          --request_second_count;
-          ++recv_zero[1];
-        }
-      }
-      else {
-        /* verify received size */
-        P4EST_ASSERT (jstatus->MPI_TAG == P4EST_COMM_BALANCE_SECOND_LOAD);
-        P4EST_ASSERT (peer->recv_second_count > 0);
-        mpiret = MPI_Get_count (jstatus, MPI_BYTE, &rcount);
-        SC_CHECK_MPI (mpiret);
-        SC_CHECK_ABORTF (rcount ==
-                         peer->recv_second_count *
-                         (int) sizeof (p4est_quadrant_t),
-                         "Receive load mismatch B %d %dx%llu", rcount,
-                         peer->recv_second_count,
-                         (unsigned long long) sizeof (p4est_quadrant_t));
+size_t
+p4est_save_buffer (p4est_t * p4est, int save_data, int save_partition,
+                   sc_array_t * buffer, size_t * my_offset)
+{
+  const int           headc = 6;
+  const int           align = 32;
+  int                 mpiret;
+  int                 num_procs, save_num_procs, rank;
+  int                 i;
+  size_t              data_size, qbuf_size, comb_size, head_count;
+  size_t              zz, zcount, zpadding;
+  size_t              data_pos, total_bytes;
+  uint64_t            conn_bytes;
+  uint64_t           *u64a;
+  p4est_topidx_t      jt, num_trees;
+  p4est_gloidx_t     *pertree;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+  char               *bp;
+  p4est_qcoord_t     *qpos;
+  sc_array_t         *conn_buf;
+  sc_array_t         *tquadrants;
 
-        /* received load, close this request */
-        peer->have_second_load = 1;
-        P4EST_ASSERT (requests_second[j] == MPI_REQUEST_NULL);
-        --request_second_count;
+  P4EST_GLOBAL_PRODUCTION ("Into " P4EST_STRING "_save_buffer\n");
+  p4est_log_indent_push ();
 
-#ifdef P4EST_ENABLE_DEBUG
-        checksum =
-          p4est_quadrant_checksum (&peer->recv_second, &checkarray, 0);
-        P4EST_LDEBUGF ("Balance B recv checksum 0x%08x from %d\n", checksum,
-                       j);
-#endif /* P4EST_ENABLE_DEBUG */
-      }
-    }
-  }
-  for (j = 0; j < num_procs; ++j) {
-    P4EST_ASSERT (requests_second[j] == MPI_REQUEST_NULL);
-  }
+  P4EST_ASSERT (p4est_connectivity_is_valid (p4est->connectivity));
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (buffer != NULL && buffer->elem_size == 1);
+  P4EST_ASSERT (my_offset != NULL);
 
-  /* print buffer statistics */
-  P4EST_VERBOSEF ("first send Z %d L %d recv Z %d L %d\n",
-                  send_zero[0], send_load[0], recv_zero[0], recv_load[0]);
-  P4EST_VERBOSEF ("second send Z %d L %d recv Z %d L %d\n",
-                  send_zero[1], send_load[1], recv_zero[1], recv_load[1]);
-  P4EST_VERBOSEF ("total send %d recv %d\n", total_send_count,
-                  total_recv_count);
-  for (j = 0; j < num_procs; ++j) {
-    peer = peers + j;
-    if (peer->send_first.elem_count > 0 || peer->recv_first_count > 0 ||
-        peer->send_second.elem_count > 0 || peer->recv_second_count > 0) {
-      P4EST_VERBOSEF ("peer %d first S %llu R %d second S %llu R %d\n",
-                      j, (unsigned long long) peer->send_first.elem_count,
-                      peer->recv_first_count,
-                      (unsigned long long) peer->send_second.elem_count,
-                      peer->recv_second_count);
-    }
+  /* when data is not saved the size is set to zero */
+  data_size = save_data ? p4est->data_size : 0;
+  if (data_size == 0) {
+    save_data = 0;
   }
-#endif /* P4EST_ENABLE_MPI */
 
-  /* end balance_comm, start balance_B */
-  if (p4est->inspect != NULL) {
-    p4est->inspect->balance_comm += sc_MPI_Wtime ();
-    p4est->inspect->balance_B = -sc_MPI_Wtime ();
-    p4est->inspect->balance_B_count_in = 0;
-    p4est->inspect->balance_B_count_out = 0;
-    p4est->inspect->use_B = 1;
-#ifdef P4EST_ENABLE_MPI
-    for (k = 0; k < 2; ++k) {
-      p4est->inspect->balance_zero_sends[k] = send_zero[k];
-      p4est->inspect->balance_zero_receives[k] = recv_zero[k];
-    }
-#endif
+  /* other parameters as in p4est_save_ext */
+  num_trees = p4est->connectivity->num_trees;
+  num_procs = p4est->mpisize;
+  save_num_procs = save_partition ? num_procs : 1;
+  head_count = (size_t) (headc + save_num_procs) + (size_t) num_trees;
+  rank = p4est->mpirank;
+  qbuf_size = (P4EST_DIM + 1) * sizeof (p4est_qcoord_t);
+  comb_size = qbuf_size + data_size;
+  pertree = P4EST_ALLOC (p4est_gloidx_t, num_trees + 1);
+  p4est_comm_count_pertree (p4est, pertree);
+
+  /* the connectivity bytes determine all offsets behind them */
+  conn_buf = NULL;
+  conn_bytes = 0;
+  if (rank == 0) {
+    conn_buf = p4est_connectivity_deflate (p4est->connectivity,
+                                           P4EST_CONN_ENCODE_NONE);
+    conn_bytes = (uint64_t) conn_buf->elem_count;
   }
+  mpiret = sc_MPI_Bcast (&conn_bytes, 1, sc_MPI_LONG_LONG_INT, 0,
+                         p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
 
-  /* merge received quadrants */
-  for (j = 0; j < num_procs; ++j) {
-    size_t              fcount;
+  /* every process computes the same image layout */
+  zpadding = (align - (size_t) conn_bytes % align) % align;
+  data_pos = (size_t) conn_bytes + zpadding +
+    head_count * sizeof (uint64_t) +
+    (align - (head_count * sizeof (uint64_t)) % align) % align;
+  total_bytes = data_pos +
+    (size_t) p4est->global_num_quadrants * comb_size;
 
-    /* access peer information */
-    peer = peers + j;
-    fcount = peer->recv_first.elem_count;
-    qcount = fcount + peer->recv_second.elem_count;
-    P4EST_ASSERT (peer->send_first_count ==
-                  (int) peer->send_first.elem_count);
-    P4EST_ASSERT (peer->send_second_count ==
-                  (int) peer->send_second.elem_count);
-    P4EST_ASSERT (peer->recv_second_count ==
-                  (int) peer->recv_second.elem_count);
-    if (qcount == 0) {
-      continue;
-    }
+  if (rank == 0) {
+    /* rank zero's segment carries connectivity and header */
+    sc_array_resize (buffer, data_pos + (size_t)
+                     p4est->local_num_quadrants * comb_size);
+    bp = buffer->array;
+    memset (bp, 0, data_pos);
+    memcpy (bp, conn_buf->array, (size_t) conn_bytes);
+    sc_array_destroy (conn_buf);
 
-    /* merge received quadrants into correct tree */
-    for (zz = 0; zz < qcount; ++zz) {
-      s = zz < fcount ? p4est_quadrant_array_index (&peer->recv_first, zz) :
-        p4est_quadrant_array_index (&peer->recv_second, zz - fcount);
-      P4EST_ASSERT (p4est_quadrant_is_extended (s));
-      qtree = s->p.piggy2.which_tree;
-      if (qtree < first_tree || qtree > last_tree) {
-        /* this is a corner/edge quadrant from the second pass of balance */
-        continue;
-      }
-      if (borders == NULL) {
-        tree = p4est_tree_array_index (p4est->trees, qtree);
-        q = p4est_quadrant_array_push (&tree->quadrants);
-        *q = *s;
-        ++tree->quadrants_per_level[q->level];
-        tree->maxlevel = (int8_t) SC_MAX (tree->maxlevel, q->level);
-        ++p4est->local_num_quadrants;
-        p4est_quadrant_init_data (p4est, qtree, q, init_fn);
-      }
-      else {
-        qarray = (sc_array_t *) sc_array_index (borders,
-                                                (int) (qtree - first_tree));
-        q = p4est_quadrant_array_push (qarray);
-        *q = *s;
+    /* write format and partition information */
+    u64a = (uint64_t *) (bp + (size_t) conn_bytes + zpadding);
+    u64a[0] = P4EST_ONDISK_FORMAT;
+    u64a[1] = (uint64_t) sizeof (p4est_qcoord_t);
+    u64a[2] = (uint64_t) sizeof (p4est_quadrant_t);
+    u64a[3] = (uint64_t) data_size;
+    u64a[4] = (uint64_t) save_data;
+    u64a[5] = (uint64_t) save_num_procs;
+    if (save_partition) {
+      for (i = 0; i < num_procs; ++i) {
+        u64a[headc + i] = (uint64_t) p4est->global_first_quadrant[i + 1];
       }
     }
-  }
-
-  /* rebalance and clamp result back to original tree boundaries */
-  p4est->local_num_quadrants = 0;
-  for (nt = first_tree; nt <= last_tree; ++nt) {
-    /* check if we are the only processor in an isolated tree */
-    tree = p4est_tree_array_index (p4est->trees, nt);
-    tree->quadrants_offset = p4est->local_num_quadrants;
-    tquadrants = &tree->quadrants;
-    treecount = tquadrants->elem_count;
-    if (!(tree_flags[nt] & fully_owned_flag) ||
-        (tree_flags[nt] & any_face_flag)) {
-      /* we have most probably received quadrants, run sort and balance */
-      /* balance the border, add it back into the tree, and linearize */
-      p4est_balance_border (p4est, btype, nt, init_fn, replace_fn, borders);
-      P4EST_VERBOSEF ("Balance tree %lld B %llu to %llu\n",
-                      (long long) nt,
-                      (unsigned long long) treecount,
-                      (unsigned long long) tquadrants->elem_count);
+    else {
+      u64a[headc] = (uint64_t) p4est->global_first_quadrant[num_procs];
     }
-    p4est->local_num_quadrants += tquadrants->elem_count;
-    tquadrants = NULL;          /* safeguard */
-  }
-  if (last_tree >= 0) {
-    for (; nt < conn->num_trees; ++nt) {
-      tree = p4est_tree_array_index (p4est->trees, nt);
-      tree->quadrants_offset = p4est->local_num_quadrants;
+    for (jt = 0; jt < num_trees; ++jt) {
+      u64a[headc + save_num_procs + jt] = (uint64_t) pertree[jt + 1];
     }
+    bp += data_pos;
+    *my_offset = 0;
   }
-
-  /* end balance_B */
-  if (p4est->inspect != NULL) {
-    p4est->inspect->balance_B += sc_MPI_Wtime ();
+  else {
+    /* other segments hold only this processor's quadrant records */
+    sc_array_resize (buffer, (size_t)
+                     p4est->local_num_quadrants * comb_size);
+    bp = buffer->array;
+    *my_offset = data_pos + (size_t)
+      p4est->global_first_quadrant[rank] * comb_size;
   }
+  P4EST_FREE (pertree);
 
-#ifdef P4EST_ENABLE_MPI
-  /* wait for all send operations */
-  if (request_send_count > 0) {
-    mpiret = MPI_Waitall (4 * num_procs,
-                          send_requests_first_count, MPI_STATUSES_IGNORE);
-    SC_CHECK_MPI (mpiret);
+  /* pack quadrant coordinates and data interleaved */
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tquadrants = &tree->quadrants;
+    zcount = tquadrants->elem_count;
+    for (zz = 0; zz < zcount; ++zz) {
+      qpos = (p4est_qcoord_t *) bp;
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      *qpos++ = q->x;
+      *qpos++ = q->y;
+#ifdef P4_TO_P8
+      *qpos++ = q->z;
+#endif
+      *qpos++ = (p4est_qcoord_t) q->level;
+      if (save_data) {
+        memcpy (qpos, q->p.user_data, data_size);
+      }
+      bp += comb_size;
+    }
   }
+  P4EST_ASSERT (bp == buffer->array + buffer->elem_count);
 
-  /* compute global sum of send and receive counts */
-#ifdef P4EST_ENABLE_DEBUG
-  gtotal[0] = gtotal[1] = 0;
-  ltotal[0] = (p4est_gloidx_t) total_send_count;
-  ltotal[1] = (p4est_gloidx_t) total_recv_count;
-  mpiret = MPI_Reduce (ltotal, gtotal, 2, P4EST_MPI_GLOIDX,
-                       MPI_SUM, 0, p4est->mpicomm);
-  SC_CHECK_MPI (mpiret);
-  P4EST_GLOBAL_STATISTICSF ("Global number of shipped quadrants %lld\n",
-                            (long long) gtotal[0]);
-  P4EST_ASSERT (rank != 0 || gtotal[0] == gtotal[1]);
-#endif /* P4EST_ENABLE_DEBUG */
-#endif /* P4EST_ENABLE_MPI */
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_save_buffer\n");
 
-  /* loop over all local trees to finalize balance */
-  all_outcount = 0;
-  for (nt = first_tree; nt <= last_tree; ++nt) {
-    tree = p4est_tree_array_index (p4est->trees, nt);
-    all_outcount += tree->quadrants.elem_count;
+  return total_bytes;
+}
 
-    /* final log message for this tree */
-    P4EST_VERBOSEF ("Done balance tree %lld now %llu\n", (long long) nt,
-                    (unsigned long long) tree->quadrants.elem_count);
-  }
+p4est_t            *
+p4est_load_buffer (sc_array_t * buffer, sc_MPI_Comm mpicomm,
+                   size_t data_size, int load_data, int autopartition,
+                   void *user_pointer, p4est_connectivity_t ** connectivity)
+{
+  int                 retval;
+  p4est_t            *p4est;
+  sc_io_source_t     *src;
 
-  /* cleanup temporary storage */
-  P4EST_FREE (tree_flags);
-  for (j = 0; j < num_procs; ++j) {
-    peer = peers + j;
-    sc_array_reset (&peer->send_first);
-    sc_array_reset (&peer->send_second);
-    sc_array_reset (&peer->recv_first);
-    sc_array_reset (&peer->recv_second);
-  }
-  P4EST_FREE (peers);
+  P4EST_GLOBAL_PRODUCTION ("Into " P4EST_STRING "_load_buffer\n");
+  p4est_log_indent_push ();
 
-  if (borders != NULL) {
-    for (zz = 0; zz < localcount; zz++) {
-      qarray = (sc_array_t *) sc_array_index (borders, zz);
-      sc_array_reset (qarray);
-    }
-    sc_array_destroy (borders);
-  }
+  P4EST_ASSERT (buffer != NULL && buffer->elem_size == 1);
 
-#ifdef P4_TO_P8
-  sc_array_reset (eta);
-#endif
-  sc_array_reset (cta);
+  src = sc_io_source_new (SC_IO_TYPE_BUFFER, SC_IO_ENCODE_NONE, buffer);
+  SC_CHECK_ABORT (src != NULL, "buffer source");
 
-#ifdef P4EST_ENABLE_MPI
-  P4EST_FREE (requests_first);  /* includes allocation for requests_second */
-  P4EST_FREE (recv_statuses);
-  P4EST_FREE (wait_indices);
-#ifdef P4EST_ENABLE_DEBUG
-  sc_array_reset (&checkarray);
-#endif /* P4EST_ENABLE_DEBUG */
-#endif /* P4EST_ENABLE_MPI */
+  p4est = p4est_source_ext (src, mpicomm, data_size, load_data,
+                            autopartition, 0, user_pointer, connectivity);
 
-  /* compute global number of quadrants */
-  p4est_comm_count_quadrants (p4est);
-  P4EST_ASSERT (p4est->global_num_quadrants >= old_gnq);
-  if (old_gnq != p4est->global_num_quadrants) {
-    ++p4est->revision;
-  }
+  retval = sc_io_source_destroy (src);
+  SC_CHECK_ABORT (!retval, "source destroy");
 
-  /* some sanity checks */
-  P4EST_ASSERT ((p4est_locidx_t) all_outcount == p4est->local_num_quadrants);
-  P4EST_ASSERT (all_outcount >= all_incount);
-  if (p4est->user_data_pool != NULL) {
-    P4EST_ASSERT (data_pool_size + all_outcount - all_incount ==
-                  p4est->user_data_pool->elem_count);
-  }
-  P4EST_ASSERT (p4est_is_valid (p4est));
-  P4EST_ASSERT (p4est_is_balanced (p4est, btype));
-  P4EST_VERBOSEF ("Balance skipped %lld\n", (long long) skipped);
   p4est_log_indent_pop ();
-  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
-                            "_balance with %lld total quadrants\n",
-                            (long long) p4est->global_num_quadrants);
+  P4EST_GLOBAL_PRODUCTIONF
+    ("Done " P4EST_STRING "_load_buffer with %lld total quadrants\n",
+     (long long) p4est->global_num_quadrants);
+
+  return p4est;
 }
 
-void
-p4est_partition (p4est_t * p4est, int allow_for_coarsening,
-                 p4est_weight_t weight_fn)
+/** Byte-stream magic of a delta record relative to a full checkpoint. */
+#define P4EST_ONDISK_FORMAT_DELTA (P4EST_ONDISK_FORMAT | 0x20000000)
+
+/** Order journal entries by tree, then by Morton index of the range start. */
+static int
+p4est_delta_entry_compare (const void *v1, const void *v2)
 {
-  (void) p4est_partition_ext (p4est, allow_for_coarsening, weight_fn);
+  const p4est_journal_entry_t *e1 = (const p4est_journal_entry_t *) v1;
+  const p4est_journal_entry_t *e2 = (const p4est_journal_entry_t *) v2;
+
+  if (e1->which_tree != e2->which_tree) {
+    return e1->which_tree < e2->which_tree ? -1 : 1;
+  }
+  return p4est_quadrant_compare (&e1->first, &e2->first);
 }
 
-p4est_gloidx_t
-p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
-                     p4est_weight_t weight_fn)
+size_t
+p4est_save_delta_buffer (p4est_t * p4est, int save_data, sc_array_t * buffer)
 {
-  p4est_gloidx_t      global_shipped = 0;
-  const p4est_gloidx_t global_num_quadrants = p4est->global_num_quadrants;
-#ifdef P4EST_ENABLE_MPI
-  int                 mpiret;
-  int                 low_source, high_source;
-  const int           num_procs = p4est->mpisize;
-  const int           rank = p4est->mpirank;
-  const p4est_topidx_t first_tree = p4est->first_local_tree;
-  const p4est_topidx_t last_tree = p4est->last_local_tree;
-  const p4est_locidx_t local_num_quadrants = p4est->local_num_quadrants;
-  int                 i, p;
-  int                 send_lowest, send_highest;
-  int                 num_sends, rcount, base_index;
-  size_t              lz;
-  ssize_t             lowers;
-  p4est_topidx_t      nt;
-  p4est_locidx_t      kl, qlocal;
-  p4est_locidx_t     *num_quadrants_in_proc;
-  p4est_gloidx_t      prev_quadrant, next_quadrant;
-  p4est_gloidx_t      send_index, recv_low, recv_high, qcount;
-  p4est_gloidx_t     *send_array;
-  int64_t             weight, weight_sum;
-  int64_t             cut, my_lowcut, my_highcut;
-  int64_t            *local_weights;    /* cumulative weights by quadrant */
-  int64_t            *global_weight_sums;
-  p4est_quadrant_t   *q;
+  const size_t        headc = 8;
+  const size_t        wordc = 2 * (1 + P4EST_DIM);
+  const size_t        intc = 2 + 2 * P4EST_DIM;
+  size_t              data_size, qbuf_size, comb_size;
+  size_t              zz, zk, nint, nquad, total_bytes;
+  size_t             *run_begin, *run_count;
+  ssize_t             lo, hi;
+  char               *bp;
+  uint64_t           *u64a;
+  sc_array_t         *journal, *work;
+  sc_array_t         *tquadrants;
+  p4est_journal_entry_t *e, *w;
   p4est_tree_t       *tree;
-  MPI_Request        *send_requests, recv_requests[2];
-  MPI_Status          recv_statuses[2];
-  p4est_gloidx_t      num_corrected;
-#endif /* P4EST_ENABLE_MPI */
+  p4est_quadrant_t   *q;
+  p4est_qcoord_t     *qpos;
+  const p4est_quadrant_t *gfp;
+
+  P4EST_GLOBAL_PRODUCTION ("Into " P4EST_STRING "_save_delta_buffer\n");
+  p4est_log_indent_push ();
 
   P4EST_ASSERT (p4est_is_valid (p4est));
-  P4EST_GLOBAL_PRODUCTIONF
-    ("Into " P4EST_STRING
-     "_partition with %lld total quadrants\n",
-     (long long) p4est->global_num_quadrants);
+  P4EST_ASSERT (buffer != NULL && buffer->elem_size == 1);
+  SC_CHECK_ABORT (p4est->inspect != NULL && p4est->inspect->journal != NULL,
+                  "delta save requires an attached change journal");
+  journal = p4est->inspect->journal;
+  P4EST_ASSERT (journal->elem_size == sizeof (p4est_journal_entry_t));
 
-  /* this function does nothing in a serial setup */
-  if (p4est->mpisize == 1) {
-    P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_partition no shipping\n");
+  /* when data is not saved the size is set to zero */
+  data_size = save_data ? p4est->data_size : 0;
+  if (data_size == 0) {
+    save_data = 0;
+  }
+  qbuf_size = (P4EST_DIM + 1) * sizeof (p4est_qcoord_t);
+  comb_size = qbuf_size + data_size;
 
-    /* in particular, there is no need to bumb the revision counter */
-    P4EST_ASSERT (global_shipped == 0);
-    return global_shipped;
+  /* normalize the journal into disjoint ascending Morton intervals */
+  work = sc_array_new_count (sizeof (p4est_journal_entry_t),
+                             journal->elem_count);
+  memcpy (work->array, journal->array,
+          journal->elem_count * sizeof (p4est_journal_entry_t));
+  sc_array_sort (work, p4est_delta_entry_compare);
+  nint = 0;
+  for (zz = 0; zz < work->elem_count; ++zz) {
+    e = (p4est_journal_entry_t *) sc_array_index (work, zz);
+    if (nint > 0) {
+      w = (p4est_journal_entry_t *) sc_array_index (work, nint - 1);
+      if (w->which_tree == e->which_tree &&
+          (p4est_quadrant_compare (&e->first, &w->last) <= 0 ||
+           p4est_quadrant_is_next (&w->last, &e->first))) {
+        /* overlapping or adjacent in the same tree: extend the previous */
+        if (p4est_quadrant_compare (&w->last, &e->last) < 0) {
+          w->last = e->last;
+        }
+        continue;
+      }
+    }
+    if (nint < zz + 1) {
+      *(p4est_journal_entry_t *) sc_array_index (work, nint) = *e;
+    }
+    ++nint;
   }
+  sc_array_resize (work, nint);
+
+  /* locate the run of local leaves covered by each interval */
+  run_begin = P4EST_ALLOC (size_t, nint);
+  run_count = P4EST_ALLOC (size_t, nint);
+  nquad = 0;
+  zk = 0;
+  for (zz = 0; zz < nint; ++zz) {
+    e = (p4est_journal_entry_t *) sc_array_index (work, zz);
+    if (e->which_tree < p4est->first_local_tree ||
+        e->which_tree > p4est->last_local_tree) {
+      /* migrated away since it was logged; the new owner records it */
+      continue;
+    }
+    tree = p4est_tree_array_index (p4est->trees, e->which_tree);
+    tquadrants = &tree->quadrants;
+    lo = p4est_find_lower_bound (tquadrants, &e->first, 0);
+    if (lo < 0) {
+      continue;
+    }
+    hi = p4est_find_higher_bound (tquadrants, &e->last, (size_t) lo);
+    if (hi < lo) {
+      continue;
+    }
 
-  p4est_log_indent_push ();
+    /* tighten the interval to the extent of the surviving local run */
+    q = p4est_quadrant_array_index (tquadrants, (size_t) lo);
+    p4est_quadrant_first_descendant (q, &e->first, P4EST_QMAXLEVEL);
+    q = p4est_quadrant_array_index (tquadrants, (size_t) hi);
+    p4est_quadrant_last_descendant (q, &e->last, P4EST_QMAXLEVEL);
+    run_begin[zk] = (size_t) lo;
+    run_count[zk] = (size_t) (hi - lo + 1);
+    nquad += run_count[zk];
+    if (zk < zz) {
+      *(p4est_journal_entry_t *) sc_array_index (work, zk) = *e;
+    }
+    ++zk;
+  }
+  nint = zk;
+  sc_array_resize (work, nint);
+
+  /* lay out header, ownership window, intervals and quadrant records */
+  total_bytes = (headc + wordc + nint * intc) * sizeof (uint64_t) +
+    nquad * comb_size;
+  sc_array_resize (buffer, total_bytes);
+  u64a = (uint64_t *) buffer->array;
+  u64a[0] = P4EST_ONDISK_FORMAT_DELTA;
+  u64a[1] = (uint64_t) sizeof (p4est_qcoord_t);
+  u64a[2] = (uint64_t) data_size;
+  u64a[3] = (uint64_t) p4est->mpisize;
+  u64a[4] = (uint64_t) p4est->mpirank;
+  u64a[5] = (uint64_t) p4est->revision;
+  u64a[6] = (uint64_t) nint;
+  u64a[7] = (uint64_t) nquad;
+
+  /* the recorded window allows replay to drop migrated-away leaves */
+  gfp = p4est->global_first_position + p4est->mpirank;
+  for (zz = 0; zz < 2; ++zz, ++gfp) {
+    u64a[headc + zz * (1 + P4EST_DIM)] = (uint64_t) gfp->p.which_tree;
+    u64a[headc + zz * (1 + P4EST_DIM) + 1] = (uint64_t) gfp->x;
+    u64a[headc + zz * (1 + P4EST_DIM) + 2] = (uint64_t) gfp->y;
+#ifdef P4_TO_P8
+    u64a[headc + zz * (1 + P4EST_DIM) + 3] = (uint64_t) gfp->z;
+#endif
+  }
 
-#ifdef P4EST_ENABLE_MPI
-  /* allocate new quadrant distribution counts */
-  num_quadrants_in_proc = P4EST_ALLOC (p4est_locidx_t, num_procs);
+  u64a += headc + wordc;
+  for (zz = 0; zz < nint; ++zz) {
+    e = (p4est_journal_entry_t *) sc_array_index (work, zz);
+    *u64a++ = (uint64_t) e->which_tree;
+    *u64a++ = (uint64_t) e->first.x;
+    *u64a++ = (uint64_t) e->first.y;
+#ifdef P4_TO_P8
+    *u64a++ = (uint64_t) e->first.z;
+#endif
+    *u64a++ = (uint64_t) e->last.x;
+    *u64a++ = (uint64_t) e->last.y;
+#ifdef P4_TO_P8
+    *u64a++ = (uint64_t) e->last.z;
+#endif
+    *u64a++ = (uint64_t) run_count[zz];
+  }
 
-  if (weight_fn == NULL) {
-    /* Divide up the quadrants equally */
-    for (p = 0, next_quadrant = 0; p < num_procs; ++p) {
-      prev_quadrant = next_quadrant;
-      next_quadrant =
-        p4est_partition_cut_gloidx (global_num_quadrants, p + 1, num_procs);
-      qcount = next_quadrant - prev_quadrant;
-      P4EST_ASSERT (0 <= qcount
-                    && qcount <= (p4est_gloidx_t) P4EST_LOCIDX_MAX);
-      num_quadrants_in_proc[p] = (p4est_locidx_t) (qcount);
+  /* pack the covered quadrants as in p4est_save_buffer */
+  bp = buffer->array + (headc + wordc + nint * intc) * sizeof (uint64_t);
+  for (zz = 0; zz < nint; ++zz) {
+    e = (p4est_journal_entry_t *) sc_array_index (work, zz);
+    tree = p4est_tree_array_index (p4est->trees, e->which_tree);
+    tquadrants = &tree->quadrants;
+    for (zk = 0; zk < run_count[zz]; ++zk) {
+      q = p4est_quadrant_array_index (tquadrants, run_begin[zz] + zk);
+      qpos = (p4est_qcoord_t *) bp;
+      *qpos++ = q->x;
+      *qpos++ = q->y;
+#ifdef P4_TO_P8
+      *qpos++ = q->z;
+#endif
+      *qpos++ = (p4est_qcoord_t) q->level;
+      if (save_data) {
+        memcpy (qpos, q->p.user_data, data_size);
+      }
+      bp += comb_size;
     }
   }
-  else {
-    /* do a weighted partition */
-    local_weights = P4EST_ALLOC (int64_t, local_num_quadrants + 1);
-    global_weight_sums = P4EST_ALLOC (int64_t, num_procs + 1);
-    P4EST_VERBOSEF ("local quadrant count %lld\n",
-                    (long long) local_num_quadrants);
+  P4EST_ASSERT (bp == buffer->array + buffer->elem_count);
+  P4EST_FREE (run_begin);
+  P4EST_FREE (run_count);
+  sc_array_destroy (work);
 
-    /* linearly sum weights across all trees */
-    kl = 0;
-    local_weights[0] = 0;
-    for (nt = first_tree; nt <= last_tree; ++nt) {
-      tree = p4est_tree_array_index (p4est->trees, nt);
-      for (lz = 0; lz < tree->quadrants.elem_count; ++lz, ++kl) {
-        q = p4est_quadrant_array_index (&tree->quadrants, lz);
-        weight = (int64_t) weight_fn (p4est, nt, q);
-        P4EST_ASSERT (weight >= 0);
-        local_weights[kl + 1] = local_weights[kl] + weight;
-      }
-    }
-    P4EST_ASSERT (kl == local_num_quadrants);
-    weight_sum = local_weights[local_num_quadrants];
-    P4EST_VERBOSEF ("local weight sum %lld\n", (long long) weight_sum);
+  /* an applied delta reproduces the state as of this call */
+  sc_array_reset (journal);
 
-    /* distribute local weight sums */
-    global_weight_sums[0] = 0;
-    mpiret = MPI_Allgather (&weight_sum, 1, MPI_LONG_LONG_INT,
-                            &global_weight_sums[1], 1, MPI_LONG_LONG_INT,
-                            p4est->mpicomm);
-    SC_CHECK_MPI (mpiret);
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
+                            "_save_delta_buffer with %lld changed quadrants\n",
+                            (long long) nquad);
 
-    /* adjust all arrays to reflect the global weight */
-    for (i = 0; i < num_procs; ++i) {
-      global_weight_sums[i + 1] += global_weight_sums[i];
-    }
-    if (rank > 0) {
-      weight_sum = global_weight_sums[rank];
-      for (kl = 0; kl <= local_num_quadrants; ++kl) {
-        local_weights[kl] += weight_sum;
-      }
-    }
-    P4EST_ASSERT (local_weights[0] == global_weight_sums[rank]);
-    P4EST_ASSERT (local_weights[local_num_quadrants] ==
-                  global_weight_sums[rank + 1]);
-    weight_sum = global_weight_sums[num_procs];
+  return total_bytes;
+}
 
-    if (rank == 0) {
-      for (i = 0; i <= num_procs; ++i) {
-        P4EST_GLOBAL_VERBOSEF ("Global weight sum [%d] %lld\n",
-                               i, (long long) global_weight_sums[i]);
-      }
-    }
+void
+p4est_apply_delta_buffer (p4est_t * p4est, int load_data, sc_array_t * buffer)
+{
+  const size_t        headc = 8;
+  const size_t        wordc = 2 * (1 + P4EST_DIM);
+  const size_t        intc = 2 + 2 * P4EST_DIM;
+  int                 i;
+  size_t              data_size, qbuf_size, comb_size;
+  size_t              zz, zk, nint, nquad, count, run_len, zcount;
+  size_t              kb, ke;
+  ssize_t             lo, hi;
+  char               *bp;
+  const uint64_t     *u64a, *iw;
+  p4est_topidx_t      jt, num_trees, wbtree, wetree;
+  p4est_locidx_t      new_local_num;
+  p4est_tree_t       *tree;
+  sc_array_t         *tquadrants;
+  p4est_quadrant_t    qfirst, qlast, wbegin, wend;
+  p4est_quadrant_t   *q;
+  const p4est_qcoord_t *qpos;
 
-    /* if all quadrants have zero weight we do nothing */
-    if (weight_sum == 0) {
-      P4EST_FREE (local_weights);
-      P4EST_FREE (global_weight_sums);
-      P4EST_FREE (num_quadrants_in_proc);
-      p4est_log_indent_pop ();
-      P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING
-                               "_partition no shipping\n");
+  P4EST_GLOBAL_PRODUCTION ("Into " P4EST_STRING "_apply_delta_buffer\n");
+  p4est_log_indent_push ();
 
-      /* in particular, there is no need to bumb the revision counter */
-      P4EST_ASSERT (global_shipped == 0);
-      return global_shipped;
-    }
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (buffer != NULL && buffer->elem_size == 1);
+  num_trees = p4est->connectivity->num_trees;
+  qbuf_size = (P4EST_DIM + 1) * sizeof (p4est_qcoord_t);
 
-    /* determine processor ids to send to */
-    send_lowest = num_procs;
-    send_highest = 0;
-    for (i = 1; i <= num_procs; ++i) {
-      cut = p4est_partition_cut_uint64 (weight_sum, i, num_procs);
-      if (global_weight_sums[rank] < cut &&
-          cut <= global_weight_sums[rank + 1]) {
-        send_lowest = SC_MIN (send_lowest, i);
-        send_highest = SC_MAX (send_highest, i);
-      }
-    }
-    /*
-     * send low cut to send_lowest..send_highest
-     * and high cut to send_lowest-1..send_highest-1
-     */
-    P4EST_LDEBUGF ("my send peers %d %d\n", send_lowest, send_highest);
+  /* validate the delta header against this forest */
+  SC_CHECK_ABORT (buffer->elem_count >= (headc + wordc) * sizeof (uint64_t),
+                  "apply delta truncated header");
+  u64a = (const uint64_t *) buffer->array;
+  SC_CHECK_ABORT (u64a[0] == P4EST_ONDISK_FORMAT_DELTA,
+                  "apply delta format mismatch");
+  SC_CHECK_ABORT (u64a[1] == (uint64_t) sizeof (p4est_qcoord_t),
+                  "apply delta coordinate size mismatch");
+  data_size = (size_t) u64a[2];
+  if (data_size != p4est->data_size) {
+    load_data = 0;
+  }
+  SC_CHECK_ABORT (u64a[3] == (uint64_t) p4est->mpisize,
+                  "apply delta process count mismatch");
+  SC_CHECK_ABORT (u64a[4] == (uint64_t) p4est->mpirank,
+                  "apply delta process rank mismatch");
+  nint = (size_t) u64a[6];
+  nquad = (size_t) u64a[7];
+  comb_size = qbuf_size + data_size;
+  SC_CHECK_ABORT (buffer->elem_count ==
+                  (headc + wordc + nint * intc) * sizeof (uint64_t) +
+                  nquad * comb_size, "apply delta buffer size mismatch");
+
+  /* reconstruct the ownership window recorded by the writer */
+  P4EST_QUADRANT_INIT (&wbegin);
+  P4EST_QUADRANT_INIT (&wend);
+  iw = u64a + headc;
+  wbtree = (p4est_topidx_t) iw[0];
+  wbegin.x = (p4est_qcoord_t) iw[1];
+  wbegin.y = (p4est_qcoord_t) iw[2];
+#ifdef P4_TO_P8
+  wbegin.z = (p4est_qcoord_t) iw[3];
+#endif
+  wbegin.level = P4EST_QMAXLEVEL;
+  iw += 1 + P4EST_DIM;
+  wetree = (p4est_topidx_t) iw[0];
+  wend.x = (p4est_qcoord_t) iw[1];
+  wend.y = (p4est_qcoord_t) iw[2];
+#ifdef P4_TO_P8
+  wend.z = (p4est_qcoord_t) iw[3];
+#endif
+  wend.level = P4EST_QMAXLEVEL;
+  iw += 1 + P4EST_DIM;
+
+  /* splice each interval's recorded leaves over the current run */
+  bp = buffer->array + (headc + wordc + nint * intc) * sizeof (uint64_t);
+  for (zz = 0; zz < nint; ++zz) {
+    jt = (p4est_topidx_t) iw[0];
+    SC_CHECK_ABORT (0 <= jt && jt < num_trees, "apply delta interval tree");
+    P4EST_QUADRANT_INIT (&qfirst);
+    qfirst.x = (p4est_qcoord_t) iw[1];
+    qfirst.y = (p4est_qcoord_t) iw[2];
+#ifdef P4_TO_P8
+    qfirst.z = (p4est_qcoord_t) iw[3];
+#endif
+    qfirst.level = P4EST_QMAXLEVEL;
+    P4EST_QUADRANT_INIT (&qlast);
+    qlast.x = (p4est_qcoord_t) iw[1 + P4EST_DIM];
+    qlast.y = (p4est_qcoord_t) iw[2 + P4EST_DIM];
+#ifdef P4_TO_P8
+    qlast.z = (p4est_qcoord_t) iw[3 + P4EST_DIM];
+#endif
+    qlast.level = P4EST_QMAXLEVEL;
+    count = (size_t) iw[1 + 2 * P4EST_DIM];
+    iw += intc;
 
-    num_sends = 2 * (send_highest - send_lowest + 1);
-    if (num_sends <= 0) {
-      num_sends = 0;
-      send_requests = NULL;
-      send_array = NULL;
+    /* the run may be empty, e.g. for content migrated in by a partition */
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tquadrants = &tree->quadrants;
+    run_len = 0;
+    if (tquadrants->elem_count == 0) {
+      lo = 0;
     }
     else {
-      send_requests = P4EST_ALLOC (MPI_Request, num_sends);
-      send_array = P4EST_ALLOC (p4est_gloidx_t, num_sends);
-      lowers = 0;
-      for (i = send_lowest; i <= send_highest; ++i) {
-        base_index = 2 * (i - send_lowest);
-        if (i < num_procs) {
-          /* do binary search in the weight array */
-          lowers = sc_search_lower_bound64 (p4est_partition_cut_uint64
-                                            (weight_sum, i, num_procs),
-                                            local_weights,
-                                            (size_t) local_num_quadrants + 1,
-                                            (size_t) lowers);
-          P4EST_ASSERT (lowers > 0
-                        && (p4est_locidx_t) lowers <= local_num_quadrants);
-
-          /* send low bound */
-          send_index = send_array[base_index + 1] =
-            (p4est_gloidx_t) lowers + p4est->global_first_quadrant[rank];
-          P4EST_LDEBUGF ("send A %d %d %d index %lld base %d to %d\n",
-                         send_lowest, i, send_highest,
-                         (long long) send_index, base_index + 1, i);
-          mpiret =
-            MPI_Isend (&send_array[base_index + 1], 1, P4EST_MPI_GLOIDX, i,
-                       P4EST_COMM_PARTITION_WEIGHTED_LOW, p4est->mpicomm,
-                       &send_requests[base_index + 1]);
-          SC_CHECK_MPI (mpiret);
-        }
-        else {
-          lowers = 0;
-          send_index = global_num_quadrants;
-          send_requests[base_index + 1] = MPI_REQUEST_NULL;
-          send_array[base_index + 1] = -1;
+      lo = p4est_find_lower_bound (tquadrants, &qfirst, 0);
+      if (lo < 0) {
+        lo = (ssize_t) tquadrants->elem_count;
+      }
+      else {
+        hi = p4est_find_higher_bound (tquadrants, &qlast, (size_t) lo);
+        if (hi >= lo) {
+          run_len = (size_t) (hi - lo + 1);
         }
-
-        /* send high bound */
-        send_array[base_index] = send_index;
-        P4EST_LDEBUGF ("send B %d %d %d index %lld base %d to %d\n",
-                       send_lowest, i, send_highest,
-                       (long long) send_index, base_index, i - 1);
-        mpiret = MPI_Isend (&send_array[base_index], 1, P4EST_MPI_GLOIDX,
-                            i - 1, P4EST_COMM_PARTITION_WEIGHTED_HIGH,
-                            p4est->mpicomm, &send_requests[base_index]);
-        SC_CHECK_MPI (mpiret);
       }
     }
 
-    /* determine processor ids to receive from and post irecv */
-    i = 0;
-    my_lowcut = p4est_partition_cut_uint64 (weight_sum, rank, num_procs);
-    if (my_lowcut == 0) {
-      recv_low = 0;
-      recv_requests[0] = MPI_REQUEST_NULL;
-      low_source = -1;
-    }
-    else {
-      for (; i < num_procs; ++i) {
-        if (global_weight_sums[i] < my_lowcut &&
-            my_lowcut <= global_weight_sums[i + 1]) {
-          P4EST_LDEBUGF ("recv A from %d\n", i);
-          mpiret = MPI_Irecv (&recv_low, 1, P4EST_MPI_GLOIDX, i,
-                              P4EST_COMM_PARTITION_WEIGHTED_LOW,
-                              p4est->mpicomm, &recv_requests[0]);
-          SC_CHECK_MPI (mpiret);
-          break;
-        }
+    /* release the payload of the leaves being replaced */
+    if (p4est->data_size > 0) {
+      for (zk = 0; zk < run_len; ++zk) {
+        q = p4est_quadrant_array_index (tquadrants, (size_t) lo + zk);
+        p4est_quadrant_free_data (p4est, q);
       }
-      P4EST_ASSERT (i < num_procs);
-      low_source = i;
     }
-    my_highcut = p4est_partition_cut_uint64 (weight_sum, rank + 1, num_procs);
-    if (my_highcut == 0) {
-      recv_high = 0;
-      recv_requests[1] = MPI_REQUEST_NULL;
-      high_source = -1;
+
+    /* make room for the recorded leaves in place */
+    zcount = tquadrants->elem_count;
+    if (count != run_len) {
+      if (count > run_len) {
+        sc_array_resize (tquadrants, zcount + (count - run_len));
+      }
+      memmove (tquadrants->array +
+               ((size_t) lo + count) * sizeof (p4est_quadrant_t),
+               tquadrants->array +
+               ((size_t) lo + run_len) * sizeof (p4est_quadrant_t),
+               (zcount - (size_t) lo - run_len) * sizeof (p4est_quadrant_t));
+      if (count < run_len) {
+        sc_array_resize (tquadrants, zcount - (run_len - count));
+      }
     }
-    else {
-      for (; i < num_procs; ++i) {
-        if (global_weight_sums[i] < my_highcut &&
-            my_highcut <= global_weight_sums[i + 1]) {
-          P4EST_LDEBUGF ("recv B from %d\n", i);
-          mpiret = MPI_Irecv (&recv_high, 1, P4EST_MPI_GLOIDX, i,
-                              P4EST_COMM_PARTITION_WEIGHTED_HIGH,
-                              p4est->mpicomm, &recv_requests[1]);
-          SC_CHECK_MPI (mpiret);
-          break;
+
+    /* unpack coordinates and data interleaved as written by the save */
+    for (zk = 0; zk < count; ++zk) {
+      q = p4est_quadrant_array_index (tquadrants, (size_t) lo + zk);
+      P4EST_QUADRANT_INIT (q);
+      qpos = (const p4est_qcoord_t *) bp;
+      q->x = *qpos++;
+      q->y = *qpos++;
+#ifdef P4_TO_P8
+      q->z = *qpos++;
+#endif
+      q->level = (int8_t) * qpos++;
+      P4EST_ASSERT (p4est_quadrant_is_valid (q));
+      if (p4est->data_size > 0) {
+        p4est_quadrant_init_data (p4est, jt, q, NULL);
+        if (load_data) {
+          memcpy (q->p.user_data, bp + qbuf_size, data_size);
         }
       }
-      P4EST_ASSERT (i < num_procs);
-      high_source = i;
+      bp += comb_size;
     }
-    P4EST_LDEBUGF ("my recv peers %d %d cuts %lld %lld\n",
-                   low_source, high_source,
-                   (long long) my_lowcut, (long long) my_highcut);
-
-    /* free temporary memory */
-    P4EST_FREE (local_weights);
-    P4EST_FREE (global_weight_sums);
+  }
+  P4EST_ASSERT (bp == buffer->array + buffer->elem_count);
 
-    /* wait for sends and receives to complete */
-    if (num_sends > 0) {
-      mpiret = MPI_Waitall (num_sends, send_requests, MPI_STATUSES_IGNORE);
-      SC_CHECK_MPI (mpiret);
-      P4EST_FREE (send_requests);
-      P4EST_FREE (send_array);
-    }
-    mpiret = MPI_Waitall (2, recv_requests, recv_statuses);
-    SC_CHECK_MPI (mpiret);
-    if (my_lowcut != 0) {
-      SC_CHECK_ABORT (recv_statuses[0].MPI_SOURCE == low_source,
-                      "Wait low source");
-      SC_CHECK_ABORT (recv_statuses[0].MPI_TAG ==
-                      P4EST_COMM_PARTITION_WEIGHTED_LOW, "Wait low tag");
-      mpiret = MPI_Get_count (&recv_statuses[0], P4EST_MPI_GLOIDX, &rcount);
-      SC_CHECK_MPI (mpiret);
-      SC_CHECK_ABORTF (rcount == 1, "Wait low count %d", rcount);
+  /* trim every tree to the recorded ownership window */
+  for (jt = 0; jt < num_trees; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tquadrants = &tree->quadrants;
+    zcount = tquadrants->elem_count;
+    if (zcount == 0) {
+      continue;
     }
-    if (my_highcut != 0) {
-      SC_CHECK_ABORT (recv_statuses[1].MPI_SOURCE == high_source,
-                      "Wait high source");
-      SC_CHECK_ABORT (recv_statuses[1].MPI_TAG ==
-                      P4EST_COMM_PARTITION_WEIGHTED_HIGH, "Wait high tag");
-      mpiret = MPI_Get_count (&recv_statuses[1], P4EST_MPI_GLOIDX, &rcount);
-      SC_CHECK_MPI (mpiret);
-      SC_CHECK_ABORTF (rcount == 1, "Wait high count %d", rcount);
+    kb = 0;
+    ke = zcount;
+    if (jt < wbtree || jt > wetree) {
+      ke = 0;
     }
-
-    /* communicate the quadrant ranges */
-    qcount = recv_high - recv_low;
-    P4EST_LDEBUGF ("weighted partition count %lld\n", (long long) qcount);
-    P4EST_ASSERT (qcount >= 0 && qcount <= (p4est_gloidx_t) P4EST_LOCIDX_MAX);
-    qlocal = (p4est_locidx_t) qcount;
-    mpiret = MPI_Allgather (&qlocal, 1, P4EST_MPI_LOCIDX,
-                            num_quadrants_in_proc, 1, P4EST_MPI_LOCIDX,
-                            p4est->mpicomm);
-    SC_CHECK_MPI (mpiret);
-
-#if(0)
-    /* run through the count array and repair zero ranges */
-    for (i = 0; i < num_procs; ++i) {
-      if (num_quadrants_in_proc[i] == 0) {
-        for (p = i - 1; p >= 0; --p) {
-          P4EST_ASSERT (num_quadrants_in_proc[p] > 0);
-          if (num_quadrants_in_proc[p] > 1) {
-            --num_quadrants_in_proc[p];
-            ++num_quadrants_in_proc[i];
-            break;
-          }
-        }
-        if (p < 0) {
-          for (p = i + 1; p < num_procs; ++p) {
-            P4EST_ASSERT (num_quadrants_in_proc[p] >= 0);
-            if (num_quadrants_in_proc[p] > 1) {
-              --num_quadrants_in_proc[p];
-              ++num_quadrants_in_proc[i];
-              break;
-            }
-          }
-          P4EST_ASSERT (p < num_procs);
+    else {
+      if (jt == wbtree) {
+        lo = p4est_find_lower_bound (tquadrants, &wbegin, 0);
+        kb = lo < 0 ? zcount : (size_t) lo;
+      }
+      if (jt == wetree) {
+        /* the window end is the first position of the next process */
+        lo = p4est_find_lower_bound (tquadrants, &wend, 0);
+        if (lo >= 0) {
+          ke = (size_t) lo;
         }
       }
     }
-#endif
+    P4EST_ASSERT (kb <= ke);
+    if (kb == 0 && ke == zcount) {
+      continue;
+    }
+    if (p4est->data_size > 0) {
+      for (zk = 0; zk < kb; ++zk) {
+        q = p4est_quadrant_array_index (tquadrants, zk);
+        p4est_quadrant_free_data (p4est, q);
+      }
+      for (zk = ke; zk < zcount; ++zk) {
+        q = p4est_quadrant_array_index (tquadrants, zk);
+        p4est_quadrant_free_data (p4est, q);
+      }
+    }
+    if (kb > 0 && ke > kb) {
+      memmove (tquadrants->array, tquadrants->array +
+               kb * sizeof (p4est_quadrant_t),
+               (ke - kb) * sizeof (p4est_quadrant_t));
+    }
+    sc_array_resize (tquadrants, ke - kb);
   }
 
-  /* correct partition */
-  if (partition_for_coarsening) {
-    num_corrected =
-      p4est_partition_for_coarsening (p4est, num_quadrants_in_proc);
-    P4EST_GLOBAL_INFOF
-      ("Designated partition for coarsening %lld quadrants moved\n",
-       (long long) num_corrected);
+  /* recompute the local tree range and per-tree metadata */
+  p4est->first_local_tree = -1;
+  p4est->last_local_tree = -2;
+  for (jt = 0; jt < num_trees; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    if (tree->quadrants.elem_count > 0) {
+      if (p4est->first_local_tree < 0) {
+        p4est->first_local_tree = jt;
+      }
+      p4est->last_local_tree = jt;
+    }
+  }
+  new_local_num = 0;
+  for (jt = 0; jt < p4est->first_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tree->quadrants_offset = 0;
+    P4EST_QUADRANT_INIT (&tree->first_desc);
+    P4EST_QUADRANT_INIT (&tree->last_desc);
   }
+  for (jt = SC_MAX (p4est->first_local_tree, 0);
+       jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tree->quadrants_offset = new_local_num;
+    tquadrants = &tree->quadrants;
+    P4EST_ASSERT (tquadrants->elem_count > 0);
+    new_local_num += (p4est_locidx_t) tquadrants->elem_count;
 
-  /* run the partition algorithm with proper quadrant counts */
-  global_shipped = p4est_partition_given (p4est, num_quadrants_in_proc);
-  if (global_shipped) {
-    /* the partition of the forest has changed somewhere */
-    ++p4est->revision;
+    for (i = 0; i <= P4EST_QMAXLEVEL; ++i) {
+      tree->quadrants_per_level[i] = 0;
+    }
+    tree->maxlevel = 0;
+    for (zz = 0; zz < tquadrants->elem_count; ++zz) {
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      ++tree->quadrants_per_level[q->level];
+      tree->maxlevel = (int8_t) SC_MAX (q->level, tree->maxlevel);
+    }
+
+    q = p4est_quadrant_array_index (tquadrants, 0);
+    p4est_quadrant_first_descendant (q, &tree->first_desc, P4EST_QMAXLEVEL);
+    q = p4est_quadrant_array_index (tquadrants,
+                                    tquadrants->elem_count - 1);
+    p4est_quadrant_last_descendant (q, &tree->last_desc, P4EST_QMAXLEVEL);
   }
-  P4EST_FREE (num_quadrants_in_proc);
+  for (jt = SC_MAX (p4est->last_local_tree + 1, 0); jt < num_trees; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tree->quadrants_offset = new_local_num;
+    P4EST_QUADRANT_INIT (&tree->first_desc);
+    P4EST_QUADRANT_INIT (&tree->last_desc);
+  }
+  p4est->local_num_quadrants = new_local_num;
+
+  /* re-establish the global partition markers and counts */
+  p4est_comm_count_quadrants (p4est);
+  p4est_comm_global_partition (p4est, NULL);
+  ++p4est->revision;
 
-  /* check validity of the p4est */
   P4EST_ASSERT (p4est_is_valid (p4est));
-#endif /* P4EST_ENABLE_MPI */
 
   p4est_log_indent_pop ();
   P4EST_GLOBAL_PRODUCTIONF
-    ("Done " P4EST_STRING "_partition shipped %lld quadrants %.3g%%\n",
-     (long long) global_shipped,
-     global_shipped * 100. / global_num_quadrants);
-
-  return global_shipped;
+    ("Done " P4EST_STRING "_apply_delta_buffer with %lld total quadrants\n",
+     (long long) p4est->global_num_quadrants);
 }
 
-p4est_gloidx_t
-p4est_partition_for_coarsening (p4est_t * p4est,
-                                p4est_locidx_t * num_quadrants_in_proc)
+/** Pending state of an asynchronous checkpoint write. */
+struct p4est_checkpoint
 {
-#ifdef P4EST_ENABLE_MPI
-  int                 num_procs = p4est->mpisize;
-  int                 rank = p4est->mpirank;
+  p4est_t            *p4est;      /**< The forest being saved. */
+  char               *lbuf;       /**< Staging copy of the local storage. */
+#ifdef P4EST_MPIIO_WRITE
+  size_t              byte_count; /**< Local bytes held in \a lbuf. */
+  MPI_File            mpifile;    /**< Open file with a write in flight. */
+#endif
+};
+
+p4est_checkpoint_t *
+p4est_checkpoint_begin (const char *filename, p4est_t * p4est, int save_data)
+{
+  p4est_checkpoint_t *ck;
+#ifdef P4EST_MPIIO_WRITE
+  const int           headc = 6;
+  const int           align = 32;
   int                 mpiret;
-  p4est_gloidx_t      global_num_quadrants = p4est->global_num_quadrants;
-  int                 i, send_lowest, send_highest, num_sends;
-  int                 parent_index;
-  p4est_quadrant_t   *q;
+  int                 retval;
+  int                 i, num_procs, rank;
+  long                fpos;
+  size_t              data_size, qbuf_size, comb_size, head_count;
+  size_t              zz, zcount;
+  uint64_t           *u64a;
+  FILE               *file;
+  MPI_Offset          mpipos;
+  MPI_Offset          mpithis;
+  p4est_topidx_t      jt, num_trees;
+  p4est_gloidx_t     *pertree;
   p4est_tree_t       *tree;
-  p4est_locidx_t      num_quadrants_in_tree;
-  p4est_topidx_t      it, tree_index;
-  p4est_gloidx_t      iq, quad_id_near_cut;
-  p4est_gloidx_t      min_quad_id, max_quad_id;
-  int8_t              quad_near_cut_level;
-  p4est_gloidx_t     *partition_now = p4est->global_first_quadrant;
-  p4est_gloidx_t     *partition_new;
-  p4est_quadrant_t   *parent_send;
-  MPI_Request        *send_requests;
-  MPI_Request        *receive_requests;
-  int                 receive_lowest, receive_highest, num_receives;
-  int                 process_with_cut = -1, process_with_cut_recv_id = -1;
-  p4est_quadrant_t   *parent_receive;
-  int                *receive_process;
-  int                *correction, correction_local = 0;
-  int                 current_proc, next_proc;
-  p4est_gloidx_t      num_moved_quadrants;
+  p4est_quadrant_t   *q;
+  char               *bp;
+  p4est_qcoord_t     *qpos;
+  sc_array_t         *tquadrants;
+#endif
 
-  /* create array with first quadrants of new partition */
-  partition_new = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
-  partition_new[0] = 0;
-  for (i = 1; i < num_procs; i++) {     /* loop over all processes */
-    partition_new[i] = partition_new[i - 1] + num_quadrants_in_proc[i - 1];
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_checkpoint_begin %s\n",
+                            filename);
+  p4est_log_indent_push ();
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+
+  ck = P4EST_ALLOC_ZERO (p4est_checkpoint_t, 1);
+  ck->p4est = p4est;
+
+#ifndef P4EST_MPIIO_WRITE
+  /* without MPI I/O there is no asynchronous write path */
+  p4est_save_ext (filename, p4est, save_data, 1);
+#else
+  /* when data is not saved the size is set to zero */
+  data_size = save_data ? p4est->data_size : 0;
+  if (data_size == 0) {
+    save_data = 0;
   }
-  partition_new[num_procs] = global_num_quadrants;
 
-  /* BEGIN: send */
-  if (partition_now[rank] < partition_now[rank + 1]) {
-    /* if this process has quadrants */
-    /* determine number and min/max process ids to send to */
-    num_sends = 0;              /* number of sends */
-    send_lowest = num_procs;    /* lowest process id */
-    send_highest = 0;           /* highest process id */
-    for (i = 1; i < num_procs; i++) {
-      /* loop over all processes (without first) */
-      if (partition_new[i] < partition_new[i + 1] &&
-          partition_now[rank] <= partition_new[i] + P4EST_CHILDREN - 2 &&
-          partition_new[i] - P4EST_CHILDREN + 1 < partition_now[rank + 1]) {
-        /* if this process has relevant quadrants for process `i` */
-        num_sends++;
-        send_lowest = SC_MIN (send_lowest, i);
-        send_highest = SC_MAX (send_highest, i);
+  /* the file layout is identical to p4est_save with the partition saved */
+  num_trees = p4est->connectivity->num_trees;
+  num_procs = p4est->mpisize;
+  head_count = (size_t) (headc + num_procs) + (size_t) num_trees;
+  rank = p4est->mpirank;
+  qbuf_size = (P4EST_DIM + 1) * sizeof (p4est_qcoord_t);
+  comb_size = qbuf_size + data_size;
+  pertree = P4EST_ALLOC (p4est_gloidx_t, num_trees + 1);
+  p4est_comm_count_pertree (p4est, pertree);
+
+  if (rank == 0) {
+    p4est_connectivity_save (filename, p4est->connectivity);
+
+    /* open file after writing connectivity to it */
+    file = fopen (filename, "ab");
+    SC_CHECK_ABORT (file != NULL, "file open");
+
+    /* align the start of the header */
+    fpos = ftell (file);
+    SC_CHECK_ABORT (fpos > 0, "first file tell");
+    while (fpos % align != 0) {
+      retval = fputc ('\0', file);
+      SC_CHECK_ABORT (retval == 0, "first file align");
+      ++fpos;
+    }
+
+    /* write format and partition information */
+    u64a = P4EST_ALLOC (uint64_t, head_count);
+    u64a[0] = P4EST_ONDISK_FORMAT;
+    u64a[1] = (uint64_t) sizeof (p4est_qcoord_t);
+    u64a[2] = (uint64_t) sizeof (p4est_quadrant_t);
+    u64a[3] = (uint64_t) data_size;
+    u64a[4] = (uint64_t) save_data;
+    u64a[5] = (uint64_t) num_procs;
+    for (i = 0; i < num_procs; ++i) {
+      u64a[headc + i] = (uint64_t) p4est->global_first_quadrant[i + 1];
+    }
+    for (jt = 0; jt < num_trees; ++jt) {
+      u64a[headc + num_procs + jt] = (uint64_t) pertree[jt + 1];
+    }
+    sc_fwrite (u64a, sizeof (uint64_t), head_count,
+               file, "write header information");
+    P4EST_FREE (u64a);
+
+    /* align the start of the quadrants */
+    fpos = ftell (file);
+    SC_CHECK_ABORT (fpos > 0, "second file tell");
+    while (fpos % align != 0) {
+      retval = fputc ('\0', file);
+      SC_CHECK_ABORT (retval == 0, "second file align");
+      ++fpos;
+    }
+
+    /* best attempt to flush file to disk before the collective open */
+    retval = fflush (file);
+    SC_CHECK_ABORT (retval == 0, "file flush");
+#ifdef P4EST_HAVE_FSYNC
+    retval = fsync (fileno (file));
+    SC_CHECK_ABORT (retval == 0, "file fsync");
+#endif
+    retval = fclose (file);
+    SC_CHECK_ABORT (retval == 0, "file close");
+    file = NULL;
+  }
+  P4EST_FREE (pertree);
+
+  /* every core opens the file in append mode */
+  mpiret = MPI_File_open (p4est->mpicomm, (char *) filename,
+                          MPI_MODE_WRONLY | MPI_MODE_APPEND |
+                          MPI_MODE_UNIQUE_OPEN, MPI_INFO_NULL, &ck->mpifile);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_File_get_position (ck->mpifile, &mpipos);
+  SC_CHECK_MPI (mpiret);
+
+  /* snapshot all local quadrants into the staging buffer; the forest
+   * may be modified again as soon as this function returns */
+  zcount = (size_t) p4est->local_num_quadrants;
+  ck->byte_count = comb_size * zcount;
+  bp = ck->lbuf = P4EST_ALLOC (char, ck->byte_count);
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tquadrants = &tree->quadrants;
+    for (zz = 0; zz < tquadrants->elem_count; ++zz) {
+      qpos = (p4est_locidx_t *) bp;
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      *qpos++ = q->x;
+      *qpos++ = q->y;
+#ifdef P4_TO_P8
+      *qpos++ = q->z;
+#endif
+      *qpos++ = (p4est_qcoord_t) q->level;
+      if (save_data) {
+        memcpy (qpos, q->p.user_data, data_size);
       }
+      bp += comb_size;
     }
   }
-  else {
-    /* set number of messages to send */
-    num_sends = 0;
+
+  /* start the split collective write; completion is in checkpoint_end */
+  mpithis = mpipos +
+    (MPI_Offset) (p4est->global_first_quadrant[rank] * comb_size);
+  mpiret = MPI_File_write_at_all_begin (ck->mpifile, mpithis, ck->lbuf,
+                                        (int) ck->byte_count, MPI_BYTE);
+  SC_CHECK_MPI (mpiret);
+#endif /* P4EST_MPIIO_WRITE */
+
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_checkpoint_begin\n");
+
+  return ck;
+}
+
+void
+p4est_checkpoint_end (p4est_checkpoint_t * ck)
+{
+#ifdef P4EST_MPIIO_WRITE
+  int                 mpiret;
+
+  mpiret = MPI_File_write_at_all_end (ck->mpifile, ck->lbuf,
+                                      MPI_STATUS_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_File_close (&ck->mpifile);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (ck->lbuf);
+#endif
+  P4EST_FREE (ck);
+}
+
+/* The compressed container shares the outline of p4est_save: the
+ * connectivity is stored unmodified, then an aligned header, then the
+ * quadrant payload.  The header differs in the format magic, carries the
+ * raw block size as a seventh entry, and appends one compressed byte
+ * count per process right after the pertree counts.  Each process'
+ * payload is an independent chunk: the per-block compressed sizes
+ * followed by zlib streams of fixed-size raw blocks, so both
+ * compression and decompression parallelize over the blocks. */
+#ifdef P4EST_HAVE_ZLIB
+#define P4EST_ONDISK_FORMAT_DEFLATE (P4EST_ONDISK_FORMAT | 0x10000000)
+
+/** Compress the local quadrant payload into an independent chunk.
+ * \param [in] lbuf         Raw payload of \a raw_bytes bytes.
+ * \param [in] raw_bytes    May be zero for an empty process.
+ * \param [in] bsize        Raw bytes per block; blocks are independent.
+ * \param [out] zbytes      Number of bytes in the returned chunk.
+ * \return                  Chunk allocated with P4EST_ALLOC: the
+ *                          per-block compressed sizes as uint64_t
+ *                          followed by the compressed blocks in order.
+ */
+static char        *
+p4est_save_deflate_chunk (const char *lbuf, size_t raw_bytes,
+                          size_t bsize, size_t * zbytes)
+{
+  const size_t        nblocks = (raw_bytes + bsize - 1) / bsize;
+  const size_t        bound = (size_t) compressBound ((uLong) bsize);
+  size_t              zb, ztotal;
+  uint64_t           *zindex;
+  uLongf             *destlen;
+  char               *scratch, *zbuf, *zp;
+  int                 zerror = Z_OK;
+
+  destlen = P4EST_ALLOC (uLongf, nblocks);
+  scratch = P4EST_ALLOC (char, nblocks * bound);
+
+  /* the blocks are independent; compress them across threads */
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (dynamic)
+#endif
+  for (zb = 0; zb < nblocks; zb++) {
+    size_t              zlen = SC_MIN (bsize, raw_bytes - zb * bsize);
+    int                 zret;
+
+    destlen[zb] = (uLongf) bound;
+    zret = compress2 ((Bytef *) (scratch + zb * bound), &destlen[zb],
+                      (const Bytef *) (lbuf + zb * bsize),
+                      (uLong) zlen, Z_DEFAULT_COMPRESSION);
+    if (zret != Z_OK) {
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp critical
+#endif
+      zerror = zret;
+    }
+  }
+  SC_CHECK_ABORT (zerror == Z_OK, "compress quadrants");
+
+  ztotal = nblocks * sizeof (uint64_t);
+  for (zb = 0; zb < nblocks; zb++) {
+    ztotal += (size_t) destlen[zb];
+  }
+  zbuf = P4EST_ALLOC (char, ztotal);
+  zindex = (uint64_t *) zbuf;
+  zp = zbuf + nblocks * sizeof (uint64_t);
+  for (zb = 0; zb < nblocks; zb++) {
+    zindex[zb] = (uint64_t) destlen[zb];
+    memcpy (zp, scratch + zb * bound, (size_t) destlen[zb]);
+    zp += (size_t) destlen[zb];
   }
+  P4EST_FREE (scratch);
+  P4EST_FREE (destlen);
+
+  *zbytes = ztotal;
+  return zbuf;
+}
+#endif /* P4EST_HAVE_ZLIB */
+
+void
+p4est_save_compressed (const char *filename, p4est_t * p4est, int save_data)
+{
+#ifdef P4EST_HAVE_ZLIB
+  const int           headc = 7;
+  const int           align = 32;
+  const size_t        bsize = (size_t) 1 << 20;
+  int                 mpiret;
+#if defined P4EST_ENABLE_MPI && !defined P4EST_MPIIO_WRITE
+  MPI_Status          mpistatus;
+#endif
+  int                 retval;
+  int                 num_procs, rank;
+  int                 i;
+  long                fpos = -1, foffset;
+  size_t              data_size, qbuf_size, comb_size, head_count;
+  size_t              zz, zcount, raw_bytes, zbytes;
+  uint64_t           *u64a;
+  uint64_t            zsend, *zsizes;
+  FILE               *file;
+#ifdef P4EST_MPIIO_WRITE
+  MPI_File            mpifile;
+  MPI_Offset          mpipos;
+  MPI_Offset          mpithis;
+#else
+  long                fthis;
+#endif
+  p4est_topidx_t      jt, num_trees;
+  p4est_gloidx_t     *pertree;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+  char               *lbuf, *bp, *zbuf;
+  p4est_qcoord_t     *qpos;
+  sc_array_t         *tquadrants;
 
-  if (num_sends > 0) {          /* if this process sends messages */
-    /* allocate send messages */
-    send_requests = P4EST_ALLOC (MPI_Request, num_sends);
-    parent_send = P4EST_ALLOC (p4est_quadrant_t, num_sends);
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_save_compressed %s\n",
+                            filename);
+  p4est_log_indent_push ();
 
-    /* array index of send messages */
-    parent_index = 0;
+  P4EST_ASSERT (p4est_connectivity_is_valid (p4est->connectivity));
+  P4EST_ASSERT (p4est_is_valid (p4est));
 
-    for (i = send_lowest; i <= send_highest; i++) {
-      /* loop over all process candidates to send to */
-      if (!(partition_new[i] < partition_new[i + 1] &&
-            partition_now[rank] <= partition_new[i] + P4EST_CHILDREN - 2 &&
-            partition_new[i] - P4EST_CHILDREN + 1 <
-            partition_now[rank + 1])) {
-        /* if this process has no relevant quadrants for process `i` */
-        continue;
-      }
+  /* when data is not saved the size is set to zero */
+  data_size = save_data ? p4est->data_size : 0;
+  if (data_size == 0) {
+    save_data = 0;
+  }
 
-      /* get nearest quadrant `quad_id_near_cut` to cut `partition_new[i]` */
-      if (partition_now[rank] <= partition_new[i] &&
-          partition_new[i] < partition_now[rank + 1]) {
-        /* if cut is owned by this process */
-        quad_id_near_cut = partition_new[i];
-      }
-      else {
-        if (P4EST_GLOIDX_ABS (partition_new[i] - partition_now[rank]) <
-            P4EST_GLOIDX_ABS (partition_new[i] - partition_now[rank + 1] +
-                              1)) {
-          quad_id_near_cut = partition_now[rank];
-        }
-        else {
-          quad_id_near_cut = partition_now[rank + 1] - 1;
-        }
-      }
+  /* other parameters; the partition is always saved since the chunk
+   * boundaries are only meaningful for the writing process count */
+  num_trees = p4est->connectivity->num_trees;
+  num_procs = p4est->mpisize;
+  head_count = (size_t) (headc + 2 * num_procs) + (size_t) num_trees;
+  rank = p4est->mpirank;
+  qbuf_size = (P4EST_DIM + 1) * sizeof (p4est_qcoord_t);
+  comb_size = qbuf_size + data_size;
+  pertree = P4EST_ALLOC (p4est_gloidx_t, num_trees + 1);
+  p4est_comm_count_pertree (p4est, pertree);
 
-      /* get tree `tree` of quadrant `quad_id_near_cut` */
-      num_quadrants_in_tree = partition_now[rank + 1] - partition_now[rank];
-      tree_index = -1;
-      for (it = p4est->first_local_tree; it <= p4est->last_local_tree; it++) {
-        /* loop over all local trees */
-        tree = p4est_tree_array_index (p4est->trees, it);
-        if (tree->quadrants_offset <= quad_id_near_cut - partition_now[rank]) {
-          tree_index = it;
-        }
-        else {
-          num_quadrants_in_tree = tree->quadrants_offset;
-          break;
-        }
+  /* pack all local quadrants into one raw buffer */
+  zcount = (size_t) p4est->local_num_quadrants;
+  raw_bytes = comb_size * zcount;
+  bp = lbuf = P4EST_ALLOC (char, raw_bytes);
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tquadrants = &tree->quadrants;
+    for (zz = 0; zz < tquadrants->elem_count; ++zz) {
+      qpos = (p4est_locidx_t *) bp;
+      q = p4est_quadrant_array_index (tquadrants, zz);
+      *qpos++ = q->x;
+      *qpos++ = q->y;
+#ifdef P4_TO_P8
+      *qpos++ = q->z;
+#endif
+      *qpos++ = (p4est_qcoord_t) q->level;
+      if (save_data) {
+        memcpy (qpos, q->p.user_data, data_size);
       }
-      tree = p4est_tree_array_index (p4est->trees, tree_index);
-      num_quadrants_in_tree -= tree->quadrants_offset;
-
-      /* get quadrant with index `quad_id_near_cut` */
-      q = p4est_quadrant_array_index (&tree->quadrants,
-                                      quad_id_near_cut - partition_now[rank] -
-                                      tree->quadrants_offset);
-
-      /* get level of quadrant near cut */
-      quad_near_cut_level = q->level;
+      bp += comb_size;
+    }
+  }
 
-      if (quad_near_cut_level > 0) {
-        /* if quadrant near cut is not root of tree, i.e. level is not zero */
-        /* get parent of quadrant near cut */
-        p4est_quadrant_parent (q, &parent_send[parent_index]);
+  /* compress the payload before any file access */
+  zbuf = p4est_save_deflate_chunk (lbuf, raw_bytes, bsize, &zbytes);
+  P4EST_FREE (lbuf);
 
-        /* get min quadrant with same parent */
-        min_quad_id = quad_id_near_cut;
-        for (iq = quad_id_near_cut;
-             iq >= SC_MAX (partition_now[rank] + tree->quadrants_offset,
-                           partition_new[i] - P4EST_CHILDREN + 1); iq--) {
-          /* loop over eligible quadrants */
-          /* get quadrant with index `iq` */
-          q = p4est_quadrant_array_index (&tree->quadrants,
-                                          iq - partition_now[rank] -
-                                          tree->quadrants_offset);
+  /* the chunk index goes into the header and every process needs the
+   * sizes of the lower ranks to know its own file offset */
+  zsizes = P4EST_ALLOC (uint64_t, num_procs);
+  zsend = (uint64_t) zbytes;
+  mpiret = sc_MPI_Allgather (&zsend, 1, sc_MPI_LONG_LONG_INT,
+                             zsizes, 1, sc_MPI_LONG_LONG_INT,
+                             p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  foffset = 0;
+  for (i = 0; i < rank; ++i) {
+    foffset += (long) zsizes[i];
+  }
 
-          /* check quadrant `iq` */
-          if (q->level == quad_near_cut_level) {        /* if same level */
-            if (p4est_quadrant_is_parent (&parent_send[parent_index], q)) {
-              /* if same parent */
-              min_quad_id = iq;
-            }
-            else {
-              break;
-            }
-          }
-          else {
-            break;
-          }
-        }
+  if (rank == 0) {
+    p4est_connectivity_save (filename, p4est->connectivity);
 
-        /* get max quadrant with same parent */
-        max_quad_id = quad_id_near_cut;
-        for (iq = quad_id_near_cut;
-             iq <=
-             SC_MIN (partition_now[rank] + tree->quadrants_offset +
-                     num_quadrants_in_tree - 1,
-                     partition_new[i] + P4EST_CHILDREN - 2); iq++) {
-          /* loop over eligible quadrants */
+    /* open file after writing connectivity to it */
+    file = fopen (filename, "ab");
+    SC_CHECK_ABORT (file != NULL, "file open");
 
-          /* get quadrant `iq` */
-          q = p4est_quadrant_array_index (&tree->quadrants,
-                                          iq - partition_now[rank] -
-                                          tree->quadrants_offset);
+    /* align the start of the header */
+    fpos = ftell (file);
+    SC_CHECK_ABORT (fpos > 0, "first file tell");
+    while (fpos % align != 0) {
+      retval = fputc ('\0', file);
+      SC_CHECK_ABORT (retval == 0, "first file align");
+      ++fpos;
+    }
 
-          /* check quadrant `iq` */
-          if (q->level == quad_near_cut_level) {        /* if same level */
-            if (p4est_quadrant_is_parent (&parent_send[parent_index], q)) {
-              /* if same parent */
-              max_quad_id = iq;
-            }
-            else {
-              break;
-            }
-          }
-          else {
-            break;
-          }
-        }
+    /* write format, partition, pertree, and chunk information */
+    u64a = P4EST_ALLOC (uint64_t, head_count);
+    u64a[0] = P4EST_ONDISK_FORMAT_DEFLATE;
+    u64a[1] = (uint64_t) sizeof (p4est_qcoord_t);
+    u64a[2] = (uint64_t) sizeof (p4est_quadrant_t);
+    u64a[3] = (uint64_t) data_size;
+    u64a[4] = (uint64_t) save_data;
+    u64a[5] = (uint64_t) num_procs;
+    u64a[6] = (uint64_t) bsize;
+    for (i = 0; i < num_procs; ++i) {
+      u64a[headc + i] = (uint64_t) p4est->global_first_quadrant[i + 1];
+    }
+    for (jt = 0; jt < num_trees; ++jt) {
+      u64a[headc + num_procs + jt] = (uint64_t) pertree[jt + 1];
+    }
+    for (i = 0; i < num_procs; ++i) {
+      u64a[headc + num_procs + num_trees + i] = zsizes[i];
+    }
+    sc_fwrite (u64a, sizeof (uint64_t), head_count,
+               file, "write header information");
+    P4EST_FREE (u64a);
+    fpos += head_count * sizeof (uint64_t);
 
-        /* write tree */
-        parent_send[parent_index].p.piggy3.which_tree = tree_index;
+    /* align the start of the chunks */
+    fpos = ftell (file);
+    SC_CHECK_ABORT (fpos > 0, "second file tell");
+    while (fpos % align != 0) {
+      retval = fputc ('\0', file);
+      SC_CHECK_ABORT (retval == 0, "second file align");
+      ++fpos;
+    }
 
-        if (quad_id_near_cut == partition_new[i]) {
-          /* if this process has cut */
-          /* encode number of quadrants with same parent before and after
-           * `partition_new[i]` into one integer */
-          parent_send[parent_index].p.piggy3.local_num =
-            (partition_new[i] - min_quad_id) * P4EST_CHILDREN +
-            (max_quad_id - partition_new[i]);
-        }
-        else {
-          /* write number of quadrants with same parent */
-          parent_send[parent_index].p.piggy3.local_num =
-            max_quad_id - min_quad_id + 1;
-        }
+#ifdef P4EST_MPIIO_WRITE
+    /* We will close the sequential access to the file */
+    /* best attempt to flush file to disk */
+    retval = fflush (file);
+    SC_CHECK_ABORT (retval == 0, "file flush");
+#ifdef P4EST_HAVE_FSYNC
+    retval = fsync (fileno (file));
+    SC_CHECK_ABORT (retval == 0, "file fsync");
+#endif
+    retval = fclose (file);
+    SC_CHECK_ABORT (retval == 0, "file close");
+    file = NULL;
+#else
+    /* file is still open for sequential write mode */
+#endif
+  }
+  else {
+    file = NULL;
+  }
+  P4EST_FREE (pertree);
 
-        /* MPI send: parent */
-        mpiret = MPI_Isend (&parent_send[parent_index],
-                            sizeof (p4est_quadrant_t), MPI_BYTE,
-                            i,
-                            P4EST_COMM_PARTITION_CORRECTION, p4est->mpicomm,
-                            &send_requests[parent_index]);
-        SC_CHECK_MPI (mpiret);
-      }
-      else {
-        /* if quadrant near cut is root of tree, i.e., level is zero,
-           set parent as tree root `q` */
-        parent_send[parent_index].level = q->level;
-        parent_send[parent_index].x = q->x;
-        parent_send[parent_index].y = q->y;
-#ifdef P4_TO_P8
-        parent_send[parent_index].z = q->z;
+#ifndef P4EST_MPIIO_WRITE
+  if (rank > 0) {
+    /* wait for sequential synchronization */
+#ifdef P4EST_ENABLE_MPI
+    mpiret = MPI_Recv (&fpos, 1, MPI_LONG, rank - 1, P4EST_COMM_SAVE,
+                       p4est->mpicomm, &mpistatus);
+    SC_CHECK_MPI (mpiret);
 #endif
 
-        /* write tree */
-        parent_send[parent_index].p.piggy3.which_tree = tree_index;
+    /* open file after all previous processors have written to it */
+    file = fopen (filename, "rb+");
+    SC_CHECK_ABORT (file != NULL, "file open");
+
+    /* seek to the beginning of this processor's chunk */
+    fthis = fpos + foffset;
+    retval = fseek (file, fthis, SEEK_SET);
+    SC_CHECK_ABORT (retval == 0, "seek chunk");
+  }
 
-        /* write number of quadrants with same "parent" */
-        parent_send[parent_index].p.piggy3.local_num = 1;
+  /* write this processor's compressed chunk */
+  sc_fwrite (zbuf, 1, zbytes, file, "write chunk");
 
-        /* MPI send: root of tree */
-        mpiret = MPI_Isend (&parent_send[parent_index],
-                            sizeof (p4est_quadrant_t), MPI_BYTE,
-                            i,
-                            P4EST_COMM_PARTITION_CORRECTION, p4est->mpicomm,
-                            &send_requests[parent_index]);
-        SC_CHECK_MPI (mpiret);
-      }
+  /* best attempt to flush file to disk */
+  retval = fflush (file);
+  SC_CHECK_ABORT (retval == 0, "file flush");
+#ifdef P4EST_HAVE_FSYNC
+  retval = fsync (fileno (file));
+  SC_CHECK_ABORT (retval == 0, "file fsync");
+#endif
+  retval = fclose (file);
+  SC_CHECK_ABORT (retval == 0, "file close");
+  file = NULL;
 
-      /* increment parent index */
-      parent_index++;
-    }
+  /* initiate sequential synchronization */
+#ifdef P4EST_ENABLE_MPI
+  if (rank < num_procs - 1) {
+    mpiret = MPI_Send (&fpos, 1, MPI_LONG, rank + 1, P4EST_COMM_SAVE,
+                       p4est->mpicomm);
+    SC_CHECK_MPI (mpiret);
   }
-  /* END: send */
+#endif
+#else
+  /* every core opens the file in append mode and writes its chunk at
+   * the explicit offset determined by the lower ranks' chunk sizes */
+  mpiret = MPI_File_open (p4est->mpicomm, (char *) filename,
+                          MPI_MODE_WRONLY | MPI_MODE_APPEND |
+                          MPI_MODE_UNIQUE_OPEN, MPI_INFO_NULL, &mpifile);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_File_get_position (mpifile, &mpipos);
+  SC_CHECK_MPI (mpiret);
+  mpithis = mpipos + (MPI_Offset) foffset;
+  mpiret = MPI_File_write_at_all (mpifile, mpithis, zbuf,
+                                  (int) zbytes, MPI_BYTE,
+                                  MPI_STATUS_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_File_close (&mpifile);
+  SC_CHECK_MPI (mpiret);
+#endif
+  P4EST_FREE (zsizes);
+  P4EST_FREE (zbuf);
 
-  /* BEGIN: receive */
-  if (rank != 0 && partition_new[rank] < partition_new[rank + 1]) {
-    /* if this process should get quadrants */
-    /* determine process ids to receive from */
-    num_receives = 0;           /* number of receives */
-    receive_lowest = num_procs; /* lowest process id */
-    receive_highest = 0;        /* highest process id */
-    for (i = 0; i < num_procs; i++) {   /* loop over all processes */
-      if (partition_now[i] < partition_now[i + 1] &&
-          partition_now[i] <= partition_new[rank] + P4EST_CHILDREN - 2 &&
-          partition_new[rank] - P4EST_CHILDREN + 1 < partition_now[i + 1]) {
-        /* if process `i` has relevant quadrants for this process */
-        num_receives++;
-        receive_lowest = SC_MIN (receive_lowest, i);
-        receive_highest = SC_MAX (receive_highest, i);
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_save_compressed\n");
+#else
+  sc_abort_collective
+    ("Configure did not find a recent enough zlib.  Abort.\n");
+#endif /* !P4EST_HAVE_ZLIB */
+}
 
-        if (partition_now[i] <= partition_new[rank] &&
-            partition_new[rank] < partition_now[i + 1]) {
-          /* if cut is owned by process `i` */
-          /* process id that sends parent of cut quadrant */
-          process_with_cut = i;
+p4est_t            *
+p4est_load (const char *filename, sc_MPI_Comm mpicomm, size_t data_size,
+            int load_data, void *user_pointer,
+            p4est_connectivity_t ** connectivity)
+{
+  return p4est_load_ext (filename, mpicomm, data_size, load_data,
+                         0, 0, user_pointer, connectivity);
+}
 
-          /* array index of receive messages of process with cut  */
-          process_with_cut_recv_id = num_receives - 1;
-        }
-      }
-    }
-  }
-  else {
-    /* set number of messages to receive */
-    num_receives = 0;
+p4est_t            *
+p4est_load_ext (const char *filename, sc_MPI_Comm mpicomm, size_t data_size,
+                int load_data, int autopartition, int broadcasthead,
+                void *user_pointer, p4est_connectivity_t ** connectivity)
+{
+  int                 retval;
+  p4est_t            *p4est;
+  sc_io_source_t     *src;
 
-    /* set correction */
-    correction_local = 0;
-  }
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_load %s\n", filename);
+  p4est_log_indent_push ();
 
-  if (num_receives > 0) {       /* if this process receives messages */
-    /* allocate receive messages */
-    receive_requests = P4EST_ALLOC (MPI_Request, num_receives);
-    parent_receive = P4EST_ALLOC (p4est_quadrant_t, num_receives);
-    receive_process = P4EST_ALLOC (int, num_receives);
+  /* open file on all processors */
 
-    /* array index of receive messages */
-    parent_index = 0;
+  src = sc_io_source_new (SC_IO_TYPE_FILENAME, SC_IO_ENCODE_NONE, filename);
+  SC_CHECK_ABORT (src != NULL, "file source: possibly file not found");
 
-    for (i = receive_lowest; i <= receive_highest; i++) {
-      /* loop over all process candidates to receive from */
-      if (!(partition_now[i] < partition_now[i + 1] &&
-            partition_now[i] <= partition_new[rank] + P4EST_CHILDREN - 2 &&
-            partition_new[rank] - P4EST_CHILDREN + 1 <
-            partition_now[i + 1])) {
-        /* if process `i` has no relevant quadrants for this process */
-        continue;
-      }
-      /* store process index */
-      receive_process[parent_index] = i;
+  p4est = p4est_source_ext (src, mpicomm, data_size, load_data, autopartition,
+                            broadcasthead, user_pointer, connectivity);
 
-      /* MPI receive */
-      mpiret = MPI_Irecv (&parent_receive[parent_index],
-                          sizeof (p4est_quadrant_t), MPI_BYTE,
-                          i,
-                          P4EST_COMM_PARTITION_CORRECTION, p4est->mpicomm,
-                          &receive_requests[parent_index]);
-      SC_CHECK_MPI (mpiret);
+  retval = sc_io_source_destroy (src);
+  SC_CHECK_ABORT (!retval, "source destroy");
 
-      /* increment parent index */
-      parent_index++;
-    }
-  }
-  /* END: receive */
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF
+    ("Done " P4EST_STRING "_load with %lld total quadrants\n",
+     (long long) p4est->global_num_quadrants);
 
-  /* BEGIN: wait for MPI receive to complete */
-  if (num_receives > 0) {
-    /* wait for receives to complete */
-    mpiret =
-      MPI_Waitall (num_receives, receive_requests, MPI_STATUSES_IGNORE);
-    SC_CHECK_MPI (mpiret);
+  return p4est;
+}
 
-    /* free receive memory */
-    P4EST_FREE (receive_requests);
+p4est_t            *
+p4est_source_ext (sc_io_source_t * src, sc_MPI_Comm mpicomm, size_t data_size,
+                  int load_data, int autopartition, int broadcasthead,
+                  void *user_pointer, p4est_connectivity_t ** connectivity)
+{
+  const int           headc = 6;
+  const int           align = 32;
+  int                 root = 0;
+  int                 retval;
+  int                 mpiret;
+  int                 num_procs, rank;
+  int                 save_num_procs;
+  int                 save_data;
+  int                 i;
+  uint64_t           *u64a, u64int;
+  size_t              conn_bytes, file_offset;
+  size_t              save_data_size;
+  size_t              qbuf_size, comb_size, head_count;
+  size_t              zz, zcount, zpadding;
+  p4est_topidx_t      jt, num_trees;
+  p4est_gloidx_t     *gfq;
+  p4est_gloidx_t     *pertree;
+  p4est_qcoord_t     *qap;
+  p4est_connectivity_t *conn;
+  p4est_t            *p4est;
+  sc_array_t         *qarr, *darr;
+  char               *dap, *lbuf;
+
+  /* set some parameters */
+  P4EST_ASSERT (src->bytes_out == 0);
+  P4EST_ASSERT (connectivity != NULL);
+  if (data_size == 0) {
+    load_data = 0;
   }
-  /* END: wait for MPI recieve to complete */
+  qbuf_size = (P4EST_DIM + 1) * sizeof (p4est_qcoord_t);
 
-  /* BEGIN: compute correction with received quadrants */
-  if (num_receives > 0) {
-    /* if this process received quadrants */
-    min_quad_id = partition_new[rank];  /* min quadrant id with same parent */
-    max_quad_id = partition_new[rank];  /* max quadrant id with same parent */
+  /* retrieve MPI information */
+  mpiret = sc_MPI_Comm_size (mpicomm, &num_procs);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
 
-    for (i = 0; i < num_receives; i++) {
-      /* loop over all received (parent or tree root) quadrants */
-      if (parent_receive[i].p.piggy3.which_tree ==
-          parent_receive[process_with_cut_recv_id].p.piggy3.which_tree
-          &&
-          p4est_quadrant_is_equal (&parent_receive[i],
-                                   &parent_receive[process_with_cut_recv_id]
-          )) {
-        /* if trees and parents are equal */
-        /* decrease/increase min/max quadrant with same parent */
-        if (receive_process[i] < process_with_cut) {
-          /* if before process with cut */
-          /* decrease min quadrant */
-          min_quad_id -= parent_receive[i].p.piggy3.local_num;
-        }
-        else if (receive_process[i] > process_with_cut) {
-          /* if after process with cut */
-          /* increase max quadrant */
-          max_quad_id += parent_receive[i].p.piggy3.local_num;
-        }
-        else {
-          /* decrease min quadrant */
-          min_quad_id -=
-            parent_receive[i].p.piggy3.local_num / P4EST_CHILDREN;
+  /* the first part of the header determines further offsets */
+  conn = NULL;
+  conn_bytes = 0;
+  u64a = P4EST_ALLOC (uint64_t, headc + 1);
+  if (!broadcasthead || rank == root) {
 
-          /* increase max quadrant */
-          max_quad_id +=
-            parent_receive[i].p.piggy3.local_num % P4EST_CHILDREN;
-        }
-      }
-    }
+    /* read the forest connectivity */
+    conn = p4est_connectivity_source (src);
+    SC_CHECK_ABORT (conn != NULL, "connectivity source");
+    zcount = src->bytes_out;
+    zpadding = (align - zcount % align) % align;
+    retval = sc_io_source_read (src, NULL, zpadding, NULL);
+    SC_CHECK_ABORT (!retval, "source padding");
+    conn_bytes = src->bytes_out;
 
-    /* compute correction */
-    correction_local =
-      (int) p4est_partition_correction (partition_new, num_procs, rank,
-                                        min_quad_id, max_quad_id);
+    /* read format and some basic partition parameters */
+    retval = sc_io_source_read (src, u64a, sizeof (uint64_t) * (size_t) headc,
+                                NULL);
+    SC_CHECK_ABORT (!retval, "read format");
+    SC_CHECK_ABORT (u64a[0] == P4EST_ONDISK_FORMAT, "invalid format");
+    SC_CHECK_ABORT (u64a[1] == (uint64_t) sizeof (p4est_qcoord_t),
+                    "invalid coordinate size");
+    SC_CHECK_ABORT (u64a[2] == (uint64_t) sizeof (p4est_quadrant_t),
+                    "invalid quadrant size");
+    save_data_size = (size_t) u64a[3];
+    save_data = (int) u64a[4];
+    if (load_data) {
+      SC_CHECK_ABORT (save_data_size == data_size, "invalid data size");
+      SC_CHECK_ABORT (save_data, "quadrant data not saved");
+    }
+    save_num_procs = (int) u64a[5];
+    SC_CHECK_ABORT (autopartition || num_procs == save_num_procs,
+                    "num procs mismatch");
 
-    /* free receive memory */
-    P4EST_FREE (parent_receive);
-    P4EST_FREE (receive_process);
+    /* piggy-back the bytes for the connectivity onto first message */
+    u64a[headc + 0] = (uint64_t) conn_bytes;
   }
-  /* END: compute correction with received parent quadrants */
-
-  /* free memory */
-  P4EST_FREE (partition_new);
-
-  /* communicate corrections */
-  correction = P4EST_ALLOC (int, num_procs);
-  mpiret = MPI_Allgather (&correction_local, 1, MPI_INT,
-                          correction, 1, MPI_INT, p4est->mpicomm);
-  SC_CHECK_MPI (mpiret);
+  if (broadcasthead) {
 
-  /* BEGIN: wait for MPI send to complete */
-  if (num_sends > 0) {
-    /* wait for sends to complete */
-    mpiret = MPI_Waitall (num_sends, send_requests, MPI_STATUSES_IGNORE);
+    /* broadcast connectivity and first part of header */
+    conn = p4est_connectivity_bcast (conn, root, mpicomm);
+    mpiret = sc_MPI_Bcast (u64a, headc + 1, sc_MPI_LONG_LONG_INT,
+                           root, mpicomm);
     SC_CHECK_MPI (mpiret);
+    if (rank != root) {
 
-    /* free send memory */
-    P4EST_FREE (parent_send);
-    P4EST_FREE (send_requests);
+      /* make sure the rest of the processes has the information */
+      SC_CHECK_ABORT (u64a[0] == P4EST_ONDISK_FORMAT, "invalid format");
+      save_data_size = (size_t) u64a[3];
+      save_data = (int) u64a[4];
+      save_num_procs = (int) u64a[5];
+      conn_bytes = (size_t) u64a[headc + 0];
+    }
   }
-  /* END: wait for MPI send to complete */
+  *connectivity = conn;
+  comb_size = qbuf_size + save_data_size;
+  file_offset = conn_bytes + headc * sizeof (uint64_t);
 
-  /* correct partition */
-  current_proc =
-    p4est_next_nonempty_process (0, num_procs, num_quadrants_in_proc);
-  next_proc =
-    p4est_next_nonempty_process (current_proc + 1, num_procs,
-                                 num_quadrants_in_proc);
-  num_moved_quadrants = 0;
-  while (current_proc < num_procs) {
-    /* loop over all non empty processes */
-    /* compute correct partition for process `current_proc` */
-    if (0 < current_proc && current_proc < num_procs) {
-      /* if any process but first */
-      num_quadrants_in_proc[current_proc] += correction[current_proc];
-      /* input is just a locidx, but the result is gloidx so we cast cleanly */
-      num_moved_quadrants += P4EST_GLOIDX_ABS (correction[current_proc]);
+  /* create partition data */
+  gfq = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
+  gfq[0] = 0;
+  if (!broadcasthead || rank == root) {
+    if (!autopartition) {
+      P4EST_ASSERT (num_procs == save_num_procs);
+      u64a = P4EST_REALLOC (u64a, uint64_t, num_procs);
+      sc_io_source_read (src, u64a, sizeof (uint64_t) * (size_t) num_procs,
+                         NULL);
+      SC_CHECK_ABORT (!retval, "read quadrant partition");
+      for (i = 0; i < num_procs; ++i) {
+        gfq[i + 1] = (p4est_gloidx_t) u64a[i];
+      }
     }
-    if (next_proc < num_procs) {
-      /* if first process or next process is feasible */
-      num_quadrants_in_proc[current_proc] -= correction[next_proc];
+    else {
+      /* ignore saved partition and compute a new uniform one */
+      retval = sc_io_source_read
+        (src, NULL, (long) ((save_num_procs - 1) * sizeof (uint64_t)), NULL);
+      SC_CHECK_ABORT (!retval, "seek over ignored partition");
+      retval = sc_io_source_read (src, &u64int, sizeof (uint64_t), NULL);
+      SC_CHECK_ABORT (!retval, "read quadrant count");
+      for (i = 1; i <= num_procs; ++i) {
+        gfq[i] = p4est_partition_cut_uint64 (u64int, i, num_procs);
+      }
     }
-
-    /* increase process ids */
-    current_proc = next_proc;
-    next_proc =
-      p4est_next_nonempty_process (next_proc + 1, num_procs,
-                                   num_quadrants_in_proc);
   }
+  if (broadcasthead) {
+    mpiret = sc_MPI_Bcast (gfq + 1, num_procs, P4EST_MPI_GLOIDX,
+                           root, mpicomm);
+    SC_CHECK_MPI (mpiret);
+  }
+  zcount = (size_t) (gfq[rank + 1] - gfq[rank]);
+  file_offset += save_num_procs * sizeof (uint64_t);
 
-  /* free memory */
-  P4EST_FREE (correction);
-
-  /* return absolute number of moved quadrants */
-  return num_moved_quadrants;
-#else
-  P4EST_ASSERT (num_quadrants_in_proc[0] == p4est->local_num_quadrants);
-
-  return 0;
-#endif
-}
+  /* read pertree data */
+  num_trees = conn->num_trees;
+  pertree = P4EST_ALLOC (p4est_gloidx_t, num_trees + 1);
+  pertree[0] = 0;
+  if (!broadcasthead || rank == root) {
+    u64a = P4EST_REALLOC (u64a, uint64_t, num_trees);
+    retval = sc_io_source_read (src, u64a, sizeof (uint64_t) * (size_t)
+                                num_trees, NULL);
+    SC_CHECK_ABORT (!retval, "read pertree information");
+    for (jt = 0; jt < num_trees; ++jt) {
+      pertree[jt + 1] = (p4est_gloidx_t) u64a[jt];
+    }
+    SC_CHECK_ABORT (gfq[num_procs] == pertree[num_trees], "pertree mismatch");
+  }
+  if (broadcasthead) {
+    mpiret = sc_MPI_Bcast (pertree + 1, num_trees, P4EST_MPI_GLOIDX,
+                           root, mpicomm);
+    SC_CHECK_MPI (mpiret);
+  }
+  P4EST_FREE (u64a);
+  file_offset += num_trees * sizeof (uint64_t);
 
-unsigned
-p4est_checksum (p4est_t * p4est)
-{
-#ifdef P4EST_HAVE_ZLIB
-  uLong               treecrc, crc;
-  size_t              scount, ssum;
-  p4est_topidx_t      nt;
-  p4est_tree_t       *tree;
-  sc_array_t          checkarray;
+  /* seek to the beginning of this processor's storage */
+  if (!broadcasthead || rank == root) {
+    P4EST_ASSERT (file_offset == src->bytes_out);
+    file_offset = 0;
+  }
+  head_count = (size_t) (headc + save_num_procs) + (size_t) num_trees;
+  zpadding = (align - (head_count * sizeof (uint64_t)) % align) % align;
+  if (zpadding > 0 || rank > 0) {
+    retval = sc_io_source_read (src, NULL, (long)
+                                (file_offset + zpadding +
+                                 gfq[rank] * comb_size), NULL);
+    SC_CHECK_ABORT (!retval, "seek data");
+  }
 
-  P4EST_ASSERT (p4est_is_valid (p4est));
+  /* read quadrant coordinates and data interleaved */
+  qarr =
+    sc_array_new_size (sizeof (p4est_qcoord_t), (P4EST_DIM + 1) * zcount);
+  qap = (p4est_qcoord_t *) qarr->array;
+  darr = NULL;
+  dap = NULL;
+  lbuf = NULL;
+  if (load_data) {
+    P4EST_ASSERT (data_size == save_data_size && data_size > 0);
+    darr = sc_array_new_size (data_size, zcount);
+    dap = darr->array;
+    lbuf = P4EST_ALLOC (char, comb_size);
+  }
+  for (zz = 0; zz < zcount; ++zz) {
+    if (load_data) {
+      retval = sc_io_source_read (src, lbuf, comb_size, NULL);
+      SC_CHECK_ABORT (!retval, "read quadrant with data");
+      memcpy (qap, lbuf, qbuf_size);
+      memcpy (dap, lbuf + qbuf_size, data_size);
+    }
+    else {
+      retval = sc_io_source_read (src, qap, qbuf_size, NULL);
+      SC_CHECK_ABORT (!retval, "read quadrant with data");
+      if (save_data_size > 0) {
+        retval = sc_io_source_read (src, NULL, save_data_size, NULL);
+        SC_CHECK_ABORT (!retval, "seek over data");
+      }
+    }
+    qap += P4EST_DIM + 1;
+    dap += data_size;
+  }
+  P4EST_FREE (lbuf);
 
-  sc_array_init (&checkarray, 4);
-  crc = adler32 (0, Z_NULL, 0);
-  ssum = 0;
-  for (nt = p4est->first_local_tree; nt <= p4est->last_local_tree; ++nt) {
-    tree = p4est_tree_array_index (p4est->trees, nt);
-    treecrc =
-      (uLong) p4est_quadrant_checksum (&tree->quadrants, &checkarray, 0);
-    scount = 4 * checkarray.elem_count;
-    ssum += scount;
-    crc = adler32_combine (crc, treecrc, (z_off_t) scount);
+  /* seek every process to the end of the source (in case there is data
+   * appended to the end of this source) */
+  if (gfq[num_procs] > gfq[rank + 1]) {
+    retval = sc_io_source_read
+      (src, NULL, (long) (gfq[num_procs] - gfq[rank + 1]) * comb_size, NULL);
+    SC_CHECK_ABORT (!retval, "seek to end of data");
   }
-  sc_array_reset (&checkarray);
-  P4EST_ASSERT ((p4est_locidx_t) ssum ==
-                p4est->local_num_quadrants * 4 * (P4EST_DIM + 1));
 
-  return p4est_comm_checksum (p4est, (unsigned) crc, ssum);
-#else
-  sc_abort_collective
-    ("Configure did not find a recent enough zlib.  Abort.\n");
+  /* create p4est from accumulated information */
+  p4est = p4est_inflate (mpicomm, conn, gfq, pertree,
+                         qarr, darr, user_pointer);
+  sc_array_destroy (qarr);
+  if (darr != NULL) {
+    sc_array_destroy (darr);
+  }
+  P4EST_FREE (pertree);
+  P4EST_FREE (gfq);
 
-  return 0;
-#endif /* !P4EST_HAVE_ZLIB */
-}
+  /* assert that we loaded a valid forest and return */
+  SC_CHECK_ABORT (p4est_is_valid (p4est), "invalid forest");
 
-void
-p4est_save (const char *filename, p4est_t * p4est, int save_data)
-{
-  p4est_save_ext (filename, p4est, save_data, 1);
+  return p4est;
 }
 
-void
-p4est_save_ext (const char *filename, p4est_t * p4est,
-                int save_data, int save_partition)
+p4est_t            *
+p4est_load_fast (const char *filename, sc_MPI_Comm mpicomm,
+                 size_t data_size, int load_data, void *user_pointer,
+                 p4est_connectivity_t ** connectivity)
 {
   const int           headc = 6;
   const int           align = 32;
-#ifdef P4EST_ENABLE_MPI
-  int                 mpiret;
-#ifndef P4EST_MPIIO_WRITE
-  MPI_Status          mpistatus;
-#endif
-#endif
+  const int           root = 0;
   int                 retval;
-  int                 num_procs, save_num_procs, rank;
+  int                 mpiret;
+  int                 num_procs, rank;
   int                 i;
-  long                fpos = -1, foffset;
-  size_t              data_size, qbuf_size, comb_size, head_count;
-  size_t              zz, zcount;
-  uint64_t           *u64a;
   FILE               *file;
-#ifdef P4EST_MPIIO_WRITE
-  MPI_File            mpifile;
-  MPI_Offset          mpipos;
-  MPI_Offset          mpithis;
-#else
-  long                fthis;
-#endif
-  p4est_topidx_t      jt, num_trees;
-  p4est_gloidx_t     *pertree;
-  p4est_tree_t       *tree;
-  p4est_quadrant_t   *q;
-  char               *lbuf, *bp;
-  p4est_qcoord_t     *qpos;
-  sc_array_t         *tquadrants;
+  char               *lbuf, *bp, *dap;
+  uint64_t           *u64a;
+  uint64_t            meta[2];
+  size_t              save_data_size;
+  size_t              qbuf_size, comb_size, head_count;
+  size_t              zz, zcount, zpadding;
+  size_t              data_pos;
+  long                fthis;
+  p4est_topidx_t      jt, num_trees;
+  p4est_gloidx_t     *gfq, *pertree;
+  p4est_qcoord_t     *qap;
+  p4est_connectivity_t *conn;
+  p4est_t            *p4est;
+  sc_array_t         *qarr, *darr;
+  sc_io_source_t     *src;
 
-  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_save %s\n", filename);
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_load_fast %s\n",
+                            filename);
   p4est_log_indent_push ();
 
-  P4EST_ASSERT (p4est_connectivity_is_valid (p4est->connectivity));
-  P4EST_ASSERT (p4est_is_valid (p4est));
-
-  /* when data is not saved the size is set to zero */
-  data_size = save_data ? p4est->data_size : 0;
-
-  /* zero data size is effectively not saved */
+  P4EST_ASSERT (connectivity != NULL);
   if (data_size == 0) {
-    save_data = 0;
+    load_data = 0;
   }
-
-  /* other parameters */
-  num_trees = p4est->connectivity->num_trees;
-  num_procs = p4est->mpisize;
-  save_num_procs = save_partition ? num_procs : 1;
-  head_count = (size_t) (headc + save_num_procs) + (size_t) num_trees;
-  rank = p4est->mpirank;
   qbuf_size = (P4EST_DIM + 1) * sizeof (p4est_qcoord_t);
-  comb_size = qbuf_size + data_size;
-  pertree = P4EST_ALLOC (p4est_gloidx_t, num_trees + 1);
-  p4est_comm_count_pertree (p4est, pertree);
 
-  if (rank == 0) {
-    p4est_connectivity_save (filename, p4est->connectivity);
+  /* retrieve MPI information */
+  mpiret = sc_MPI_Comm_size (mpicomm, &num_procs);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
 
-    /* open file after writing connectivity to it */
-    file = fopen (filename, "ab");
-    SC_CHECK_ABORT (file != NULL, "file open");
+  /* the root parses connectivity and header once for everybody */
+  conn = NULL;
+  src = NULL;
+  gfq = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
+  gfq[0] = 0;
+  meta[0] = meta[1] = 0;
+  if (rank == root) {
+    int                 save_data;
+    int                 save_num_procs;
+    size_t              conn_bytes;
+
+    src = sc_io_source_new (SC_IO_TYPE_FILENAME, SC_IO_ENCODE_NONE,
+                            filename);
+    SC_CHECK_ABORT (src != NULL, "file source: possibly file not found");
+    conn = p4est_connectivity_source (src);
+    SC_CHECK_ABORT (conn != NULL, "connectivity source");
+    zcount = src->bytes_out;
+    zpadding = (align - zcount % align) % align;
+    retval = sc_io_source_read (src, NULL, zpadding, NULL);
+    SC_CHECK_ABORT (!retval, "source padding");
+    conn_bytes = src->bytes_out;
 
-    /* align the start of the header */
-    fpos = ftell (file);
-    SC_CHECK_ABORT (fpos > 0, "first file tell");
-    while (fpos % align != 0) {
-      retval = fputc ('\0', file);
-      SC_CHECK_ABORT (retval == 0, "first file align");
-      ++fpos;
+    /* read format and basic partition parameters */
+    u64a = P4EST_ALLOC (uint64_t, headc);
+    retval = sc_io_source_read (src, u64a,
+                                sizeof (uint64_t) * (size_t) headc, NULL);
+    SC_CHECK_ABORT (!retval, "read format");
+    SC_CHECK_ABORT (u64a[0] == P4EST_ONDISK_FORMAT, "invalid format");
+    SC_CHECK_ABORT (u64a[1] == (uint64_t) sizeof (p4est_qcoord_t),
+                    "invalid coordinate size");
+    SC_CHECK_ABORT (u64a[2] == (uint64_t) sizeof (p4est_quadrant_t),
+                    "invalid quadrant size");
+    save_data_size = (size_t) u64a[3];
+    save_data = (int) u64a[4];
+    if (load_data) {
+      SC_CHECK_ABORT (save_data_size == data_size, "invalid data size");
+      SC_CHECK_ABORT (save_data, "quadrant data not saved");
     }
+    save_num_procs = (int) u64a[5];
+    SC_CHECK_ABORT (save_num_procs == num_procs,
+                    "fast reload requires the saving process count");
 
-    /* write format and partition information */
-    u64a = P4EST_ALLOC (uint64_t, head_count);
-    u64a[0] = P4EST_ONDISK_FORMAT;
-    u64a[1] = (uint64_t) sizeof (p4est_qcoord_t);
-    u64a[2] = (uint64_t) sizeof (p4est_quadrant_t);
-    u64a[3] = (uint64_t) data_size;
-    u64a[4] = (uint64_t) save_data;
-    u64a[5] = (uint64_t) save_num_procs;
-    if (save_partition) {
-      P4EST_ASSERT (save_num_procs == num_procs);
-      for (i = 0; i < num_procs; ++i) {
-        u64a[headc + i] = (uint64_t) p4est->global_first_quadrant[i + 1];
-      }
-    }
-    else {
-      P4EST_ASSERT (save_num_procs == 1);
-      u64a[headc] = (uint64_t) p4est->global_first_quadrant[num_procs];
-    }
-    for (jt = 0; jt < num_trees; ++jt) {
-      u64a[headc + save_num_procs + jt] = (uint64_t) pertree[jt + 1];
+    /* the saved partition becomes the reload partition verbatim */
+    u64a = P4EST_REALLOC (u64a, uint64_t, num_procs);
+    retval = sc_io_source_read (src, u64a,
+                                sizeof (uint64_t) * (size_t) num_procs,
+                                NULL);
+    SC_CHECK_ABORT (!retval, "read quadrant partition");
+    for (i = 0; i < num_procs; ++i) {
+      gfq[i + 1] = (p4est_gloidx_t) u64a[i];
     }
-    sc_fwrite (u64a, sizeof (uint64_t), head_count,
-               file, "write header information");
     P4EST_FREE (u64a);
-    fpos += head_count * sizeof (uint64_t);
-
-    /* align the start of the quadrants */
-    fpos = ftell (file);
-    SC_CHECK_ABORT (fpos > 0, "second file tell");
-    while (fpos % align != 0) {
-      retval = fputc ('\0', file);
-      SC_CHECK_ABORT (retval == 0, "second file align");
-      ++fpos;
-    }
 
-#ifdef P4EST_MPIIO_WRITE
-    /* We will close the sequential access to the file */
-    /* best attempt to flush file to disk */
-    retval = fflush (file);
-    SC_CHECK_ABORT (retval == 0, "file flush");
-#ifdef P4EST_HAVE_FSYNC
-    retval = fsync (fileno (file));
-    SC_CHECK_ABORT (retval == 0, "file fsync");
-#endif
-    retval = fclose (file);
-    SC_CHECK_ABORT (retval == 0, "file close");
-    file = NULL;
-#else
-    /* file is still open for sequential write mode */
-#endif
+    /* every process computes its byte range from this offset */
+    num_trees = conn->num_trees;
+    head_count = (size_t) (headc + num_procs) + (size_t) num_trees;
+    zpadding = (align - (head_count * sizeof (uint64_t)) % align) % align;
+    meta[0] = (uint64_t) save_data_size;
+    meta[1] = (uint64_t) (conn_bytes +
+                          head_count * sizeof (uint64_t) + zpadding);
   }
-  else {
-    file = NULL;
-  }
-  P4EST_FREE (pertree);
-
-#ifndef P4EST_MPIIO_WRITE
-  if (rank > 0) {
-    /* wait for sequential synchronization */
-#ifdef P4EST_ENABLE_MPI
-    mpiret = MPI_Recv (&fpos, 1, MPI_LONG, rank - 1, P4EST_COMM_SAVE,
-                       p4est->mpicomm, &mpistatus);
-    SC_CHECK_MPI (mpiret);
-#endif
 
-    /* open file after all previous processors have written to it */
-    file = fopen (filename, "rb+");
-    SC_CHECK_ABORT (file != NULL, "file open");
-  }
-#else
-  /* Every core opens the file in append mode */
-  mpiret = MPI_File_open (p4est->mpicomm, (char *) filename,
-                          MPI_MODE_WRONLY | MPI_MODE_APPEND |
-                          MPI_MODE_UNIQUE_OPEN, MPI_INFO_NULL, &mpifile);
+  /* distribute connectivity, header facts, partition and tree counts */
+  conn = p4est_connectivity_bcast (conn, root, mpicomm);
+  mpiret = sc_MPI_Bcast (meta, 2, sc_MPI_LONG_LONG_INT, root, mpicomm);
   SC_CHECK_MPI (mpiret);
-  mpiret = MPI_File_get_position (mpifile, &mpipos);
+  save_data_size = (size_t) meta[0];
+  data_pos = (size_t) meta[1];
+  comb_size = qbuf_size + save_data_size;
+  mpiret = sc_MPI_Bcast (gfq + 1, num_procs, P4EST_MPI_GLOIDX,
+                         root, mpicomm);
   SC_CHECK_MPI (mpiret);
-#endif
-
-  if (rank > 0) {
-    /* seek to the beginning of this processor's storage */
-    foffset = (long) (p4est->global_first_quadrant[rank] * comb_size);
-
-#ifndef P4EST_MPIIO_WRITE
-    fthis = fpos + foffset;
-    retval = fseek (file, fthis, SEEK_SET);
-    SC_CHECK_ABORT (retval == 0, "seek data");
-#else
-    mpithis = mpipos + (MPI_Offset) foffset;
-    mpiret = MPI_File_seek (mpifile, mpithis, MPI_SEEK_SET);
-    SC_CHECK_MPI (mpiret);
-#endif
-  }
-
-  /* write quadrant coordinates and data interleaved */
-  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
-    tree = p4est_tree_array_index (p4est->trees, jt);
-    tquadrants = &tree->quadrants;
-    zcount = tquadrants->elem_count;
-
-    /* storage that will be written for this tree */
-    bp = lbuf = P4EST_ALLOC (char, comb_size * zcount);
-    for (zz = 0; zz < zcount; ++zz) {
-      qpos = (p4est_locidx_t *) bp;
-      q = p4est_quadrant_array_index (tquadrants, zz);
-      *qpos++ = q->x;
-      *qpos++ = q->y;
-#ifdef P4_TO_P8
-      *qpos++ = q->z;
-#endif
-      *qpos++ = (p4est_qcoord_t) q->level;
-      if (save_data) {
-        memcpy (qpos, q->p.user_data, data_size);
-      }
-      bp += comb_size;
+  num_trees = conn->num_trees;
+  pertree = P4EST_ALLOC (p4est_gloidx_t, num_trees + 1);
+  pertree[0] = 0;
+  if (rank == root) {
+    u64a = P4EST_ALLOC (uint64_t, num_trees);
+    retval = sc_io_source_read (src, u64a,
+                                sizeof (uint64_t) * (size_t) num_trees,
+                                NULL);
+    SC_CHECK_ABORT (!retval, "read pertree information");
+    for (jt = 0; jt < num_trees; ++jt) {
+      pertree[jt + 1] = (p4est_gloidx_t) u64a[jt];
     }
-#ifndef P4EST_MPIIO_WRITE
-    sc_fwrite (lbuf, comb_size, zcount, file, "write quadrants");
-#else
-    sc_mpi_write (mpifile, lbuf, comb_size * zcount, MPI_BYTE,
-                  "write quadrants");
-#endif
-    P4EST_FREE (lbuf);
+    SC_CHECK_ABORT (gfq[num_procs] == pertree[num_trees],
+                    "pertree mismatch");
+    P4EST_FREE (u64a);
+    retval = sc_io_source_destroy (src);
+    SC_CHECK_ABORT (!retval, "source destroy");
   }
+  mpiret = sc_MPI_Bcast (pertree + 1, num_trees, P4EST_MPI_GLOIDX,
+                         root, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  *connectivity = conn;
 
-#ifndef P4EST_MPIIO_WRITE
-  /* best attempt to flush file to disk */
-  retval = fflush (file);
-  SC_CHECK_ABORT (retval == 0, "file flush");
-#ifdef P4EST_HAVE_FSYNC
-  retval = fsync (fileno (file));
-  SC_CHECK_ABORT (retval == 0, "file fsync");
-#endif
+  /* each process reads exactly its contiguous byte range in one call */
+  zcount = (size_t) (gfq[rank + 1] - gfq[rank]);
+  lbuf = P4EST_ALLOC (char, zcount * comb_size);
+  file = fopen (filename, "rb");
+  SC_CHECK_ABORT (file != NULL, "file open");
+  fthis = (long) (data_pos + (size_t) gfq[rank] * comb_size);
+  retval = fseek (file, fthis, SEEK_SET);
+  SC_CHECK_ABORT (retval == 0, "seek data");
+  sc_fread (lbuf, comb_size, zcount, file, "read quadrants");
   retval = fclose (file);
   SC_CHECK_ABORT (retval == 0, "file close");
-  file = NULL;
 
-  /* initiate sequential synchronization */
-#ifdef P4EST_ENABLE_MPI
-  if (rank < num_procs - 1) {
-    mpiret = MPI_Send (&fpos, 1, MPI_LONG, rank + 1, P4EST_COMM_SAVE,
-                       p4est->mpicomm);
-    SC_CHECK_MPI (mpiret);
+  /* split the raw bytes into coordinates and data */
+  qarr =
+    sc_array_new_size (sizeof (p4est_qcoord_t), (P4EST_DIM + 1) * zcount);
+  qap = (p4est_qcoord_t *) qarr->array;
+  darr = NULL;
+  dap = NULL;
+  if (load_data) {
+    P4EST_ASSERT (data_size == save_data_size && data_size > 0);
+    darr = sc_array_new_size (data_size, zcount);
+    dap = darr->array;
   }
-#endif
-#else
-  mpiret = MPI_File_close (&mpifile);
-  SC_CHECK_MPI (mpiret);
-#endif
+  bp = lbuf;
+  for (zz = 0; zz < zcount; ++zz) {
+    memcpy (qap, bp, qbuf_size);
+    qap += P4EST_DIM + 1;
+    if (load_data) {
+      memcpy (dap, bp + qbuf_size, data_size);
+      dap += data_size;
+    }
+    bp += comb_size;
+  }
+  P4EST_FREE (lbuf);
+
+  /* bulk-adopt the saved partition; the contents are trusted */
+  p4est = p4est_inflate (mpicomm, conn, gfq, pertree,
+                         qarr, darr, user_pointer);
+  sc_array_destroy (qarr);
+  if (darr != NULL) {
+    sc_array_destroy (darr);
+  }
+  P4EST_FREE (pertree);
+  P4EST_FREE (gfq);
+  P4EST_ASSERT (p4est_is_valid (p4est));
 
   p4est_log_indent_pop ();
-  P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_save\n");
-}
+  P4EST_GLOBAL_PRODUCTIONF
+    ("Done " P4EST_STRING "_load_fast with %lld total quadrants\n",
+     (long long) p4est->global_num_quadrants);
 
-p4est_t            *
-p4est_load (const char *filename, sc_MPI_Comm mpicomm, size_t data_size,
-            int load_data, void *user_pointer,
-            p4est_connectivity_t ** connectivity)
-{
-  return p4est_load_ext (filename, mpicomm, data_size, load_data,
-                         0, 0, user_pointer, connectivity);
+  return p4est;
 }
 
 p4est_t            *
-p4est_load_ext (const char *filename, sc_MPI_Comm mpicomm, size_t data_size,
-                int load_data, int autopartition, int broadcasthead,
-                void *user_pointer, p4est_connectivity_t ** connectivity)
+p4est_load_compressed (const char *filename, sc_MPI_Comm mpicomm,
+                       size_t data_size, int load_data,
+                       void *user_pointer,
+                       p4est_connectivity_t ** connectivity)
 {
+#ifdef P4EST_HAVE_ZLIB
+  const int           headc = 7;
+  const int           align = 32;
   int                 retval;
+  int                 mpiret;
+  int                 num_procs, rank;
+  int                 save_data;
+  int                 i;
+  uint64_t           *u64a;
+  uint64_t           *zsizes, *zindex;
+  size_t              save_data_size;
+  size_t              qbuf_size, comb_size, head_count;
+  size_t              zz, zcount, zpadding;
+  size_t              bsize, raw_bytes, zbytes, zskip;
+  size_t              nblocks, zb;
+  size_t             *zoffsets;
+  p4est_topidx_t      jt, num_trees;
+  p4est_gloidx_t     *gfq;
+  p4est_gloidx_t     *pertree;
+  p4est_qcoord_t     *qap;
+  p4est_connectivity_t *conn;
   p4est_t            *p4est;
   sc_io_source_t     *src;
+  sc_array_t         *qarr, *darr;
+  char               *dap, *lbuf, *zbuf, *bp;
+  int                 zerror = Z_OK;
 
-  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_load %s\n", filename);
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_load_compressed %s\n",
+                            filename);
   p4est_log_indent_push ();
 
-  /* open file on all processors */
+  P4EST_ASSERT (connectivity != NULL);
+  if (data_size == 0) {
+    load_data = 0;
+  }
+  qbuf_size = (P4EST_DIM + 1) * sizeof (p4est_qcoord_t);
+
+  /* retrieve MPI information */
+  mpiret = sc_MPI_Comm_size (mpicomm, &num_procs);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
 
+  /* open file on all processors */
   src = sc_io_source_new (SC_IO_TYPE_FILENAME, SC_IO_ENCODE_NONE, filename);
   SC_CHECK_ABORT (src != NULL, "file source: possibly file not found");
 
-  p4est = p4est_source_ext (src, mpicomm, data_size, load_data, autopartition,
-                            broadcasthead, user_pointer, connectivity);
+  /* read the forest connectivity */
+  conn = p4est_connectivity_source (src);
+  SC_CHECK_ABORT (conn != NULL, "connectivity source");
+  zcount = src->bytes_out;
+  zpadding = (align - zcount % align) % align;
+  retval = sc_io_source_read (src, NULL, zpadding, NULL);
+  SC_CHECK_ABORT (!retval, "source padding");
+  *connectivity = conn;
+
+  /* read format and basic parameters; the chunk boundaries only make
+   * sense for the process count that wrote the file */
+  u64a = P4EST_ALLOC (uint64_t, headc);
+  retval = sc_io_source_read (src, u64a, sizeof (uint64_t) * (size_t) headc,
+                              NULL);
+  SC_CHECK_ABORT (!retval, "read format");
+  SC_CHECK_ABORT (u64a[0] == P4EST_ONDISK_FORMAT_DEFLATE, "invalid format");
+  SC_CHECK_ABORT (u64a[1] == (uint64_t) sizeof (p4est_qcoord_t),
+                  "invalid coordinate size");
+  SC_CHECK_ABORT (u64a[2] == (uint64_t) sizeof (p4est_quadrant_t),
+                  "invalid quadrant size");
+  save_data_size = (size_t) u64a[3];
+  save_data = (int) u64a[4];
+  if (load_data) {
+    SC_CHECK_ABORT (save_data_size == data_size, "invalid data size");
+    SC_CHECK_ABORT (save_data, "quadrant data not saved");
+  }
+  SC_CHECK_ABORT (num_procs == (int) u64a[5], "num procs mismatch");
+  bsize = (size_t) u64a[6];
+  SC_CHECK_ABORT (bsize > 0, "invalid block size");
+  P4EST_FREE (u64a);
+  comb_size = qbuf_size + save_data_size;
+
+  /* read partition data */
+  gfq = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
+  gfq[0] = 0;
+  u64a = P4EST_ALLOC (uint64_t, num_procs);
+  retval = sc_io_source_read (src, u64a, sizeof (uint64_t) * (size_t)
+                              num_procs, NULL);
+  SC_CHECK_ABORT (!retval, "read quadrant partition");
+  for (i = 0; i < num_procs; ++i) {
+    gfq[i + 1] = (p4est_gloidx_t) u64a[i];
+  }
+
+  /* read pertree data */
+  num_trees = conn->num_trees;
+  pertree = P4EST_ALLOC (p4est_gloidx_t, num_trees + 1);
+  pertree[0] = 0;
+  u64a = P4EST_REALLOC (u64a, uint64_t, num_trees);
+  retval = sc_io_source_read (src, u64a, sizeof (uint64_t) * (size_t)
+                              num_trees, NULL);
+  SC_CHECK_ABORT (!retval, "read pertree information");
+  for (jt = 0; jt < num_trees; ++jt) {
+    pertree[jt + 1] = (p4est_gloidx_t) u64a[jt];
+  }
+  SC_CHECK_ABORT (gfq[num_procs] == pertree[num_trees], "pertree mismatch");
+  P4EST_FREE (u64a);
+
+  /* read the chunk index */
+  zsizes = P4EST_ALLOC (uint64_t, num_procs);
+  retval = sc_io_source_read (src, zsizes, sizeof (uint64_t) * (size_t)
+                              num_procs, NULL);
+  SC_CHECK_ABORT (!retval, "read chunk index");
+
+  /* seek to the beginning of this processor's chunk */
+  head_count = (size_t) (headc + 2 * num_procs) + (size_t) num_trees;
+  zpadding = (align - (head_count * sizeof (uint64_t)) % align) % align;
+  zskip = zpadding;
+  for (i = 0; i < rank; ++i) {
+    zskip += (size_t) zsizes[i];
+  }
+  if (zskip > 0) {
+    retval = sc_io_source_read (src, NULL, (long) zskip, NULL);
+    SC_CHECK_ABORT (!retval, "seek chunk");
+  }
+
+  /* read this processor's compressed chunk */
+  zcount = (size_t) (gfq[rank + 1] - gfq[rank]);
+  raw_bytes = comb_size * zcount;
+  nblocks = (raw_bytes + bsize - 1) / bsize;
+  zbytes = (size_t) zsizes[rank];
+  SC_CHECK_ABORT (zbytes >= nblocks * sizeof (uint64_t), "chunk too short");
+  zbuf = P4EST_ALLOC (char, zbytes);
+  retval = sc_io_source_read (src, zbuf, zbytes, NULL);
+  SC_CHECK_ABORT (!retval, "read chunk");
+
+  /* the per-block offsets are prefix sums of the stored sizes */
+  zindex = (uint64_t *) zbuf;
+  zoffsets = P4EST_ALLOC (size_t, nblocks + 1);
+  zoffsets[0] = nblocks * sizeof (uint64_t);
+  for (zb = 0; zb < nblocks; zb++) {
+    zoffsets[zb + 1] = zoffsets[zb] + (size_t) zindex[zb];
+  }
+  SC_CHECK_ABORT (zoffsets[nblocks] == zbytes, "chunk size mismatch");
+
+  /* the blocks are independent; decompress them across threads */
+  lbuf = P4EST_ALLOC (char, raw_bytes);
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (dynamic)
+#endif
+  for (zb = 0; zb < nblocks; zb++) {
+    size_t              zlen = SC_MIN (bsize, raw_bytes - zb * bsize);
+    uLongf              destlen = (uLongf) zlen;
+    int                 zret;
+
+    zret = uncompress ((Bytef *) (lbuf + zb * bsize), &destlen,
+                       (const Bytef *) (zbuf + zoffsets[zb]),
+                       (uLong) (zoffsets[zb + 1] - zoffsets[zb]));
+    if (zret != Z_OK || (size_t) destlen != zlen) {
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp critical
+#endif
+      zerror = (zret != Z_OK) ? zret : Z_DATA_ERROR;
+    }
+  }
+  SC_CHECK_ABORT (zerror == Z_OK, "uncompress quadrants");
+  P4EST_FREE (zoffsets);
+  P4EST_FREE (zbuf);
 
+  /* seek every process to the end of the source (in case there is data
+   * appended to the end of this source) */
+  zskip = 0;
+  for (i = rank + 1; i < num_procs; ++i) {
+    zskip += (size_t) zsizes[i];
+  }
+  if (zskip > 0) {
+    retval = sc_io_source_read (src, NULL, (long) zskip, NULL);
+    SC_CHECK_ABORT (!retval, "seek to end of data");
+  }
+  P4EST_FREE (zsizes);
   retval = sc_io_source_destroy (src);
   SC_CHECK_ABORT (!retval, "source destroy");
 
+  /* unpack quadrant coordinates and data interleaved */
+  qarr =
+    sc_array_new_size (sizeof (p4est_qcoord_t), (P4EST_DIM + 1) * zcount);
+  qap = (p4est_qcoord_t *) qarr->array;
+  darr = NULL;
+  dap = NULL;
+  if (load_data) {
+    P4EST_ASSERT (data_size == save_data_size && data_size > 0);
+    darr = sc_array_new_size (data_size, zcount);
+    dap = darr->array;
+  }
+  bp = lbuf;
+  for (zz = 0; zz < zcount; ++zz) {
+    memcpy (qap, bp, qbuf_size);
+    if (load_data) {
+      memcpy (dap, bp + qbuf_size, data_size);
+      dap += data_size;
+    }
+    qap += P4EST_DIM + 1;
+    bp += comb_size;
+  }
+  P4EST_FREE (lbuf);
+
+  /* create p4est from accumulated information */
+  p4est = p4est_inflate (mpicomm, conn, gfq, pertree,
+                         qarr, darr, user_pointer);
+  sc_array_destroy (qarr);
+  if (darr != NULL) {
+    sc_array_destroy (darr);
+  }
+  P4EST_FREE (pertree);
+  P4EST_FREE (gfq);
+
+  /* assert that we loaded a valid forest and return */
+  SC_CHECK_ABORT (p4est_is_valid (p4est), "invalid forest");
+
   p4est_log_indent_pop ();
   P4EST_GLOBAL_PRODUCTIONF
-    ("Done " P4EST_STRING "_load with %lld total quadrants\n",
+    ("Done " P4EST_STRING "_load_compressed with %lld total quadrants\n",
      (long long) p4est->global_num_quadrants);
 
   return p4est;
+#else
+  sc_abort_collective
+    ("Configure did not find a recent enough zlib.  Abort.\n");
+
+  return NULL;
+#endif /* !P4EST_HAVE_ZLIB */
 }
 
 p4est_t            *
-p4est_source_ext (sc_io_source_t * src, sc_MPI_Comm mpicomm, size_t data_size,
-                  int load_data, int autopartition, int broadcasthead,
-                  void *user_pointer, p4est_connectivity_t ** connectivity)
+p4est_load_parallel (const char *filename, sc_MPI_Comm mpicomm,
+                     size_t data_size, int load_data, void *user_pointer,
+                     p4est_connectivity_t ** connectivity)
 {
+#ifdef P4EST_MPIIO_WRITE
   const int           headc = 6;
   const int           align = 32;
   int                 root = 0;
@@ -3538,8 +7694,7 @@ p4est_source_ext (sc_io_source_t * src, sc_MPI_Comm mpicomm, size_t data_size,
   int                 save_num_procs;
   int                 save_data;
   int                 i;
-  uint64_t           *u64a, u64int;
-  size_t              conn_bytes, file_offset;
+  uint64_t           *u64a, *u64t;
   size_t              save_data_size;
   size_t              qbuf_size, comb_size, head_count;
   size_t              zz, zcount, zpadding;
@@ -3550,10 +7705,15 @@ p4est_source_ext (sc_io_source_t * src, sc_MPI_Comm mpicomm, size_t data_size,
   p4est_connectivity_t *conn;
   p4est_t            *p4est;
   sc_array_t         *qarr, *darr;
-  char               *dap, *lbuf;
+  sc_io_source_t     *src;
+  char               *dap, *lbuf, *bp;
+  MPI_File            mpifile;
+  MPI_Offset          mpithis;
+
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_load_parallel %s\n",
+                            filename);
+  p4est_log_indent_push ();
 
-  /* set some parameters */
-  P4EST_ASSERT (src->bytes_out == 0);
   P4EST_ASSERT (connectivity != NULL);
   if (data_size == 0) {
     load_data = 0;
@@ -3566,11 +7726,15 @@ p4est_source_ext (sc_io_source_t * src, sc_MPI_Comm mpicomm, size_t data_size,
   mpiret = sc_MPI_Comm_rank (mpicomm, &rank);
   SC_CHECK_MPI (mpiret);
 
-  /* the first part of the header determines further offsets */
+  /* the root process reads the connectivity and the header metadata;
+   * beyond the header entries we append the global quadrant count and
+   * the file offset of the quadrant records for the broadcast */
   conn = NULL;
-  conn_bytes = 0;
-  u64a = P4EST_ALLOC (uint64_t, headc + 1);
-  if (!broadcasthead || rank == root) {
+  u64a = P4EST_ALLOC (uint64_t, headc + 2);
+  if (rank == root) {
+    src = sc_io_source_new (SC_IO_TYPE_FILENAME, SC_IO_ENCODE_NONE,
+                            filename);
+    SC_CHECK_ABORT (src != NULL, "file source: possibly file not found");
 
     /* read the forest connectivity */
     conn = p4est_connectivity_source (src);
@@ -3579,162 +7743,121 @@ p4est_source_ext (sc_io_source_t * src, sc_MPI_Comm mpicomm, size_t data_size,
     zpadding = (align - zcount % align) % align;
     retval = sc_io_source_read (src, NULL, zpadding, NULL);
     SC_CHECK_ABORT (!retval, "source padding");
-    conn_bytes = src->bytes_out;
 
-    /* read format and some basic partition parameters */
-    retval = sc_io_source_read (src, u64a, sizeof (uint64_t) * (size_t) headc,
-                                NULL);
+    /* read format and basic partition parameters */
+    retval = sc_io_source_read (src, u64a, sizeof (uint64_t) * (size_t)
+                                headc, NULL);
     SC_CHECK_ABORT (!retval, "read format");
     SC_CHECK_ABORT (u64a[0] == P4EST_ONDISK_FORMAT, "invalid format");
     SC_CHECK_ABORT (u64a[1] == (uint64_t) sizeof (p4est_qcoord_t),
                     "invalid coordinate size");
     SC_CHECK_ABORT (u64a[2] == (uint64_t) sizeof (p4est_quadrant_t),
                     "invalid quadrant size");
-    save_data_size = (size_t) u64a[3];
-    save_data = (int) u64a[4];
-    if (load_data) {
-      SC_CHECK_ABORT (save_data_size == data_size, "invalid data size");
-      SC_CHECK_ABORT (save_data, "quadrant data not saved");
-    }
     save_num_procs = (int) u64a[5];
-    SC_CHECK_ABORT (autopartition || num_procs == save_num_procs,
-                    "num procs mismatch");
-
-    /* piggy-back the bytes for the connectivity onto first message */
-    u64a[headc + 0] = (uint64_t) conn_bytes;
-  }
-  if (broadcasthead) {
-
-    /* broadcast connectivity and first part of header */
-    conn = p4est_connectivity_bcast (conn, root, mpicomm);
-    mpiret = sc_MPI_Bcast (u64a, headc + 1, sc_MPI_LONG_LONG_INT,
-                           root, mpicomm);
-    SC_CHECK_MPI (mpiret);
-    if (rank != root) {
-
-      /* make sure the rest of the processes has the information */
-      SC_CHECK_ABORT (u64a[0] == P4EST_ONDISK_FORMAT, "invalid format");
-      save_data_size = (size_t) u64a[3];
-      save_data = (int) u64a[4];
-      save_num_procs = (int) u64a[5];
-      conn_bytes = (size_t) u64a[headc + 0];
-    }
-  }
-  *connectivity = conn;
-  comb_size = qbuf_size + save_data_size;
-  file_offset = conn_bytes + headc * sizeof (uint64_t);
 
-  /* create partition data */
-  gfq = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
-  gfq[0] = 0;
-  if (!broadcasthead || rank == root) {
-    if (!autopartition) {
-      P4EST_ASSERT (num_procs == save_num_procs);
-      u64a = P4EST_REALLOC (u64a, uint64_t, num_procs);
-      sc_io_source_read (src, u64a, sizeof (uint64_t) * (size_t) num_procs,
-                         NULL);
-      SC_CHECK_ABORT (!retval, "read quadrant partition");
-      for (i = 0; i < num_procs; ++i) {
-        gfq[i + 1] = (p4est_gloidx_t) u64a[i];
-      }
-    }
-    else {
-      /* ignore saved partition and compute a new uniform one */
+    /* only the global count is needed from the saved partition */
+    if (save_num_procs > 1) {
       retval = sc_io_source_read
         (src, NULL, (long) ((save_num_procs - 1) * sizeof (uint64_t)), NULL);
-      SC_CHECK_ABORT (!retval, "seek over ignored partition");
-      retval = sc_io_source_read (src, &u64int, sizeof (uint64_t), NULL);
-      SC_CHECK_ABORT (!retval, "read quadrant count");
-      for (i = 1; i <= num_procs; ++i) {
-        gfq[i] = p4est_partition_cut_uint64 (u64int, i, num_procs);
-      }
+      SC_CHECK_ABORT (!retval, "seek over saved partition");
     }
+    retval = sc_io_source_read (src, u64a + headc, sizeof (uint64_t), NULL);
+    SC_CHECK_ABORT (!retval, "read quadrant count");
+
+    /* the offset of the quadrant records follows from the header size */
+    save_data_size = (size_t) u64a[3];
+    head_count = (size_t) (headc + save_num_procs) +
+      (size_t) conn->num_trees;
+    zpadding = (align - (head_count * sizeof (uint64_t)) % align) % align;
+    u64a[headc + 1] = (uint64_t)
+      (src->bytes_out - headc * sizeof (uint64_t) -
+       save_num_procs * sizeof (uint64_t)) +
+      (uint64_t) (head_count * sizeof (uint64_t) + zpadding);
   }
-  if (broadcasthead) {
-    mpiret = sc_MPI_Bcast (gfq + 1, num_procs, P4EST_MPI_GLOIDX,
-                           root, mpicomm);
-    SC_CHECK_MPI (mpiret);
-  }
-  zcount = (size_t) (gfq[rank + 1] - gfq[rank]);
-  file_offset += save_num_procs * sizeof (uint64_t);
 
-  /* read pertree data */
+  /* broadcast connectivity and header metadata */
+  conn = p4est_connectivity_bcast (conn, root, mpicomm);
+  mpiret = sc_MPI_Bcast (u64a, headc + 2, sc_MPI_LONG_LONG_INT,
+                         root, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  *connectivity = conn;
   num_trees = conn->num_trees;
+  save_data_size = (size_t) u64a[3];
+  save_data = (int) u64a[4];
+  save_num_procs = (int) u64a[5];
+  if (load_data) {
+    SC_CHECK_ABORT (save_data_size == data_size, "invalid data size");
+    SC_CHECK_ABORT (save_data, "quadrant data not saved");
+  }
+  comb_size = qbuf_size + save_data_size;
+
+  /* read and broadcast the per-tree quadrant counts */
   pertree = P4EST_ALLOC (p4est_gloidx_t, num_trees + 1);
   pertree[0] = 0;
-  if (!broadcasthead || rank == root) {
-    u64a = P4EST_REALLOC (u64a, uint64_t, num_trees);
-    retval = sc_io_source_read (src, u64a, sizeof (uint64_t) * (size_t)
+  if (rank == root) {
+    u64t = P4EST_ALLOC (uint64_t, num_trees);
+    retval = sc_io_source_read (src, u64t, sizeof (uint64_t) * (size_t)
                                 num_trees, NULL);
     SC_CHECK_ABORT (!retval, "read pertree information");
     for (jt = 0; jt < num_trees; ++jt) {
-      pertree[jt + 1] = (p4est_gloidx_t) u64a[jt];
+      pertree[jt + 1] = (p4est_gloidx_t) u64t[jt];
     }
-    SC_CHECK_ABORT (gfq[num_procs] == pertree[num_trees], "pertree mismatch");
-  }
-  if (broadcasthead) {
-    mpiret = sc_MPI_Bcast (pertree + 1, num_trees, P4EST_MPI_GLOIDX,
-                           root, mpicomm);
-    SC_CHECK_MPI (mpiret);
+    P4EST_FREE (u64t);
+    SC_CHECK_ABORT ((uint64_t) pertree[num_trees] == u64a[headc],
+                    "pertree mismatch");
+    retval = sc_io_source_destroy (src);
+    SC_CHECK_ABORT (!retval, "source destroy");
   }
-  P4EST_FREE (u64a);
-  file_offset += num_trees * sizeof (uint64_t);
+  mpiret = sc_MPI_Bcast (pertree + 1, num_trees, P4EST_MPI_GLOIDX,
+                         root, mpicomm);
+  SC_CHECK_MPI (mpiret);
 
-  /* seek to the beginning of this processor's storage */
-  if (!broadcasthead || rank == root) {
-    P4EST_ASSERT (file_offset == src->bytes_out);
-    file_offset = 0;
-  }
-  head_count = (size_t) (headc + save_num_procs) + (size_t) num_trees;
-  zpadding = (align - (head_count * sizeof (uint64_t)) % align) % align;
-  if (zpadding > 0 || rank > 0) {
-    retval = sc_io_source_read (src, NULL, (long)
-                                (file_offset + zpadding +
-                                 gfq[rank] * comb_size), NULL);
-    SC_CHECK_ABORT (!retval, "seek data");
+  /* ignore the saved partition and compute a new uniform one */
+  gfq = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
+  for (i = 0; i <= num_procs; ++i) {
+    gfq[i] = p4est_partition_cut_uint64 (u64a[headc], i, num_procs);
   }
+  zcount = (size_t) (gfq[rank + 1] - gfq[rank]);
 
-  /* read quadrant coordinates and data interleaved */
+  /* every process reads exactly its slice collectively */
+  mpiret = MPI_File_open (mpicomm, (char *) filename,
+                          MPI_MODE_RDONLY | MPI_MODE_UNIQUE_OPEN,
+                          MPI_INFO_NULL, &mpifile);
+  SC_CHECK_MPI (mpiret);
+  lbuf = P4EST_ALLOC (char, zcount * comb_size);
+  mpithis = (MPI_Offset) u64a[headc + 1] +
+    (MPI_Offset) gfq[rank] * (MPI_Offset) comb_size;
+  mpiret = MPI_File_read_at_all (mpifile, mpithis, lbuf,
+                                 (int) (comb_size * zcount), MPI_BYTE,
+                                 MPI_STATUS_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_File_close (&mpifile);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (u64a);
+
+  /* unpack quadrant coordinates and data interleaved */
   qarr =
     sc_array_new_size (sizeof (p4est_qcoord_t), (P4EST_DIM + 1) * zcount);
   qap = (p4est_qcoord_t *) qarr->array;
   darr = NULL;
   dap = NULL;
-  lbuf = NULL;
   if (load_data) {
     P4EST_ASSERT (data_size == save_data_size && data_size > 0);
     darr = sc_array_new_size (data_size, zcount);
     dap = darr->array;
-    lbuf = P4EST_ALLOC (char, comb_size);
   }
+  bp = lbuf;
   for (zz = 0; zz < zcount; ++zz) {
+    memcpy (qap, bp, qbuf_size);
     if (load_data) {
-      retval = sc_io_source_read (src, lbuf, comb_size, NULL);
-      SC_CHECK_ABORT (!retval, "read quadrant with data");
-      memcpy (qap, lbuf, qbuf_size);
-      memcpy (dap, lbuf + qbuf_size, data_size);
-    }
-    else {
-      retval = sc_io_source_read (src, qap, qbuf_size, NULL);
-      SC_CHECK_ABORT (!retval, "read quadrant with data");
-      if (save_data_size > 0) {
-        retval = sc_io_source_read (src, NULL, save_data_size, NULL);
-        SC_CHECK_ABORT (!retval, "seek over data");
-      }
+      memcpy (dap, bp + qbuf_size, data_size);
+      dap += data_size;
     }
     qap += P4EST_DIM + 1;
-    dap += data_size;
+    bp += comb_size;
   }
   P4EST_FREE (lbuf);
 
-  /* seek every process to the end of the source (in case there is data
-   * appended to the end of this source) */
-  if (gfq[num_procs] > gfq[rank + 1]) {
-    retval = sc_io_source_read
-      (src, NULL, (long) (gfq[num_procs] - gfq[rank + 1]) * comb_size, NULL);
-    SC_CHECK_ABORT (!retval, "seek to end of data");
-  }
-
   /* create p4est from accumulated information */
   p4est = p4est_inflate (mpicomm, conn, gfq, pertree,
                          qarr, darr, user_pointer);
@@ -3748,5 +7871,15 @@ p4est_source_ext (sc_io_source_t * src, sc_MPI_Comm mpicomm, size_t data_size,
   /* assert that we loaded a valid forest and return */
   SC_CHECK_ABORT (p4est_is_valid (p4est), "invalid forest");
 
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF
+    ("Done " P4EST_STRING "_load_parallel with %lld total quadrants\n",
+     (long long) p4est->global_num_quadrants);
+
   return p4est;
+#else
+  /* without MPI-IO fall back to the streamed loader with repartitioning */
+  return p4est_load_ext (filename, mpicomm, data_size, load_data,
+                         1, 1, user_pointer, connectivity);
+#endif /* !P4EST_MPIIO_WRITE */
 }
@@ -26,12 +26,14 @@
 #include <p8est_algorithms.h>
 #include <p8est_bits.h>
 #include <p8est_communication.h>
+#include <p8est_extended.h>
 #include <p8est_search.h>
 #include <p8est_balance.h>
 #else
 #include <p4est_algorithms.h>
 #include <p4est_bits.h>
 #include <p4est_communication.h>
+#include <p4est_extended.h>
 #include <p4est_search.h>
 #include <p4est_balance.h>
 #endif /* !P4_TO_P8 */
@@ -43,6 +45,12 @@
 #ifdef P4EST_HAVE_NETINET_IN_H
 #include <netinet/in.h>
 #endif
+#ifdef P4EST_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef P4EST_HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 #ifndef P4_TO_P8
 
@@ -115,6 +123,41 @@ p4est_quadrant_checksum (sc_array_t * quadrants,
   P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
   P4EST_ASSERT (first_quadrant <= qcount);
 
+#ifdef P4EST_HAVE_ZLIB
+  if (checkarray == NULL) {
+    /* stream the encoded words through adler32 in cache-sized batches
+     * instead of materializing the whole temporary array; an adler32
+     * with SIMD support, such as zlib-ng's, is picked up unchanged */
+    uint32_t            cbuf[256 * (P4EST_DIM + 1)];
+    size_t              zz;
+    uLong               adler;
+
+    adler = adler32 (0, Z_NULL, 0);
+    zz = 0;
+    for (kz = first_quadrant; kz < qcount; ++kz) {
+      q = p4est_quadrant_array_index (quadrants, kz);
+      P4EST_ASSERT (p4est_quadrant_is_extended (q));
+      check = cbuf + zz * (P4EST_DIM + 1);
+      check[0] = htonl ((uint32_t) q->x);
+      check[1] = htonl ((uint32_t) q->y);
+#ifdef P4_TO_P8
+      check[2] = htonl ((uint32_t) q->z);
+#endif
+      check[P4EST_DIM] = htonl ((uint32_t) q->level);
+      if (++zz == 256) {
+        adler = adler32 (adler, (const Bytef *) cbuf,
+                         (uInt) (zz * (P4EST_DIM + 1) * 4));
+        zz = 0;
+      }
+    }
+    if (zz > 0) {
+      adler = adler32 (adler, (const Bytef *) cbuf,
+                       (uInt) (zz * (P4EST_DIM + 1) * 4));
+    }
+    return (unsigned) adler;
+  }
+#endif /* P4EST_HAVE_ZLIB */
+
   if (checkarray == NULL) {
     checkarray = sc_array_new (4);
     own_check = 1;
@@ -147,6 +190,24 @@ p4est_quadrant_checksum (sc_array_t * quadrants,
   return crc;
 }
 
+void
+p4est_quadrant_array_advise_huge (sc_array_t * quadrants)
+{
+#if defined P4EST_HAVE_SYS_MMAN_H && defined MADV_HUGEPAGE
+  const uintptr_t     hugesize = (uintptr_t) 1 << 21;
+  uintptr_t           begin, end;
+
+  /* only the aligned huge pages fully inside the storage can be backed */
+  begin = ((uintptr_t) quadrants->array + (hugesize - 1)) & ~(hugesize - 1);
+  end = ((uintptr_t) quadrants->array +
+         quadrants->elem_count * quadrants->elem_size) & ~(hugesize - 1);
+  if (begin < end) {
+    /* the advice is best effort; ignore kernels that refuse it */
+    (void) madvise ((void *) begin, (size_t) (end - begin), MADV_HUGEPAGE);
+  }
+#endif
+}
+
 int
 p4est_tree_is_sorted (p4est_tree_t * tree)
 {
@@ -418,6 +479,221 @@ p4est_is_equal (p4est_t * p4est1, p4est_t * p4est2, int compare_data)
   return 1;
 }
 
+p4est_tree_checksums_t *
+p4est_tree_checksums_new (p4est_t * p4est)
+{
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  p4est_tree_checksums_t *tc;
+
+  tc = P4EST_ALLOC_ZERO (p4est_tree_checksums_t, 1);
+  tc->p4est = p4est;
+  tc->num_trees = p4est->connectivity->num_trees;
+  tc->crcs = P4EST_ALLOC_ZERO (unsigned, tc->num_trees);
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tc->crcs[jt] = p4est_quadrant_checksum (&tree->quadrants, NULL, 0);
+  }
+  tc->revision = p4est->revision;
+  tc->first_local_tree = p4est->first_local_tree;
+  tc->last_local_tree = p4est->last_local_tree;
+  tc->journal_seen =
+    (p4est->inspect != NULL && p4est->inspect->journal != NULL) ?
+    p4est->inspect->journal->elem_count : 0;
+
+  return tc;
+}
+
+void
+p4est_tree_checksums_update (p4est_tree_checksums_t * tc)
+{
+  size_t              zz;
+  int8_t             *dirty;
+  p4est_t            *p4est = tc->p4est;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  sc_array_t         *journal;
+  p4est_journal_entry_t *entry;
+
+  P4EST_ASSERT (tc->num_trees == p4est->connectivity->num_trees);
+
+  if (tc->revision == p4est->revision) {
+    /* the forest has not changed since the last validation */
+    return;
+  }
+
+  journal = (p4est->inspect != NULL) ? p4est->inspect->journal : NULL;
+  if (journal == NULL || journal->elem_count < tc->journal_seen ||
+      tc->first_local_tree != p4est->first_local_tree ||
+      tc->last_local_tree != p4est->last_local_tree) {
+    /* without usable journal information, or after the local tree range
+     * moved under a repartition, fall back to a full recomputation */
+    memset (tc->crcs, 0, tc->num_trees * sizeof (unsigned));
+    for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+      tree = p4est_tree_array_index (p4est->trees, jt);
+      tc->crcs[jt] = p4est_quadrant_checksum (&tree->quadrants, NULL, 0);
+    }
+  }
+  else {
+    /* recompute only the trees touched since the last validation */
+    dirty = P4EST_ALLOC_ZERO (int8_t, tc->num_trees);
+    for (zz = tc->journal_seen; zz < journal->elem_count; ++zz) {
+      entry = (p4est_journal_entry_t *) sc_array_index (journal, zz);
+      P4EST_ASSERT (0 <= entry->which_tree &&
+                    entry->which_tree < tc->num_trees);
+      dirty[entry->which_tree] = 1;
+    }
+    for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+      if (dirty[jt]) {
+        tree = p4est_tree_array_index (p4est->trees, jt);
+        tc->crcs[jt] = p4est_quadrant_checksum (&tree->quadrants, NULL, 0);
+      }
+    }
+    P4EST_FREE (dirty);
+  }
+
+  tc->revision = p4est->revision;
+  tc->first_local_tree = p4est->first_local_tree;
+  tc->last_local_tree = p4est->last_local_tree;
+  tc->journal_seen = (journal != NULL) ? journal->elem_count : 0;
+}
+
+void
+p4est_tree_checksums_destroy (p4est_tree_checksums_t * tc)
+{
+  P4EST_FREE (tc->crcs);
+  P4EST_FREE (tc);
+}
+
+/** Decide whether one local tree differs between two forests.
+ * Checksums settle the answer when available; without zlib the adler32
+ * wrappers return constants, so the arrays are compared directly.
+ */
+static int
+p4est_divergence_tree_differs (sc_array_t * tqs1, sc_array_t * tqs2,
+                               unsigned crc1, unsigned crc2)
+{
+#ifdef P4EST_HAVE_ZLIB
+  return crc1 != crc2;
+#else
+  return tqs1->elem_count != tqs2->elem_count ||
+    memcmp (tqs1->array, tqs2->array,
+            tqs1->elem_count * sizeof (p4est_quadrant_t));
+#endif
+}
+
+p4est_topidx_t
+p4est_divergence (p4est_t * p4est1, p4est_t * p4est2,
+                  p4est_tree_checksums_t * tc1, p4est_tree_checksums_t * tc2,
+                  p4est_quadrant_t * first_diff, p4est_quadrant_t * last_diff)
+{
+  size_t              zz, zcount;
+  ssize_t             i1, i2;
+  unsigned            crc1, crc2;
+  p4est_topidx_t      jt, lo, hi;
+  p4est_tree_t       *tree1, *tree2;
+  p4est_quadrant_t   *q1, *q2, ld1, ld2;
+  sc_array_t         *tqs1, *tqs2;
+  int                 in1, in2;
+
+  P4EST_ASSERT (p4est1->connectivity->num_trees ==
+                p4est2->connectivity->num_trees);
+  P4EST_ASSERT (tc1 == NULL || (tc1->p4est == p4est1 &&
+                                tc1->revision == p4est1->revision));
+  P4EST_ASSERT (tc2 == NULL || (tc2->p4est == p4est2 &&
+                                tc2->revision == p4est2->revision));
+
+  lo = SC_MIN (p4est1->first_local_tree, p4est2->first_local_tree);
+  hi = SC_MAX (p4est1->last_local_tree, p4est2->last_local_tree);
+  for (jt = SC_MAX (lo, 0); jt <= hi; ++jt) {
+    in1 = p4est1->first_local_tree <= jt && jt <= p4est1->last_local_tree;
+    in2 = p4est2->first_local_tree <= jt && jt <= p4est2->last_local_tree;
+    if (!in1 && !in2) {
+      continue;
+    }
+    if (in1 != in2) {
+      /* the tree is local to only one forest: its whole extent differs */
+      tqs1 = in1 ? &p4est_tree_array_index (p4est1->trees, jt)->quadrants
+        : &p4est_tree_array_index (p4est2->trees, jt)->quadrants;
+      if (tqs1->elem_count == 0) {
+        continue;
+      }
+      if (first_diff != NULL) {
+        q1 = p4est_quadrant_array_index (tqs1, 0);
+        p4est_quadrant_first_descendant (q1, first_diff, P4EST_QMAXLEVEL);
+        first_diff->p.which_tree = jt;
+      }
+      if (last_diff != NULL) {
+        q1 = p4est_quadrant_array_index (tqs1, tqs1->elem_count - 1);
+        p4est_quadrant_last_descendant (q1, last_diff, P4EST_QMAXLEVEL);
+        last_diff->p.which_tree = jt;
+      }
+      return jt;
+    }
+
+    tree1 = p4est_tree_array_index (p4est1->trees, jt);
+    tqs1 = &tree1->quadrants;
+    tree2 = p4est_tree_array_index (p4est2->trees, jt);
+    tqs2 = &tree2->quadrants;
+
+    crc1 = (tc1 != NULL) ? tc1->crcs[jt] :
+      p4est_quadrant_checksum (tqs1, NULL, 0);
+    crc2 = (tc2 != NULL) ? tc2->crcs[jt] :
+      p4est_quadrant_checksum (tqs2, NULL, 0);
+    if (!p4est_divergence_tree_differs (tqs1, tqs2, crc1, crc2)) {
+      continue;
+    }
+
+    /* this tree differs: narrow down the Morton range from both ends */
+    if (first_diff != NULL) {
+      zcount = SC_MIN (tqs1->elem_count, tqs2->elem_count);
+      for (zz = 0; zz < zcount; ++zz) {
+        q1 = p4est_quadrant_array_index (tqs1, zz);
+        q2 = p4est_quadrant_array_index (tqs2, zz);
+        if (!p4est_quadrant_is_equal (q1, q2)) {
+          break;
+        }
+      }
+      P4EST_ASSERT (zz < tqs1->elem_count || zz < tqs2->elem_count);
+      q1 = (zz < tqs1->elem_count) ? p4est_quadrant_array_index (tqs1, zz)
+        : p4est_quadrant_array_index (tqs2, zz);
+      p4est_quadrant_first_descendant (q1, first_diff, P4EST_QMAXLEVEL);
+      first_diff->p.which_tree = jt;
+    }
+    if (last_diff != NULL) {
+      i1 = (ssize_t) tqs1->elem_count - 1;
+      i2 = (ssize_t) tqs2->elem_count - 1;
+      while (i1 >= 0 && i2 >= 0) {
+        q1 = p4est_quadrant_array_index (tqs1, (size_t) i1);
+        q2 = p4est_quadrant_array_index (tqs2, (size_t) i2);
+        if (!p4est_quadrant_is_equal (q1, q2)) {
+          break;
+        }
+        --i1;
+        --i2;
+      }
+      P4EST_ASSERT (i1 >= 0 || i2 >= 0);
+      if (i1 >= 0 && i2 >= 0) {
+        /* both trees end in the shared tail: take the later position */
+        q1 = p4est_quadrant_array_index (tqs1, (size_t) i1);
+        q2 = p4est_quadrant_array_index (tqs2, (size_t) i2);
+        p4est_quadrant_last_descendant (q1, &ld1, P4EST_QMAXLEVEL);
+        p4est_quadrant_last_descendant (q2, &ld2, P4EST_QMAXLEVEL);
+        *last_diff = (p4est_quadrant_compare (&ld1, &ld2) >= 0) ? ld1 : ld2;
+      }
+      else {
+        q1 = (i1 >= 0) ? p4est_quadrant_array_index (tqs1, (size_t) i1)
+          : p4est_quadrant_array_index (tqs2, (size_t) i2);
+        p4est_quadrant_last_descendant (q1, last_diff, P4EST_QMAXLEVEL);
+      }
+      last_diff->p.which_tree = jt;
+    }
+    return jt;
+  }
+
+  return -1;
+}
+
 int
 p4est_is_valid (p4est_t * p4est)
 {
@@ -1110,6 +1386,315 @@ p4est_tree_compute_overlap (p4est_t * p4est, sc_array_t * in,
   sc_array_destroy (seeds);
 }
 
+/** Key-index pair carried through the radix sort passes. */
+typedef struct
+{
+  uint64_t            key;      /**< Morton key of the quadrant */
+  size_t              orig;     /**< position in the input array */
+}
+p4est_radix_entry_t;
+
+/** Map a quadrant to a key that sorts like \ref p4est_quadrant_compare.
+ * The interleaved coordinates at full resolution occupy the high bits
+ * and the level breaks ties among ancestors sharing a position.  Both
+ * together fit into 64 bits for levels up to P4EST_QMAXLEVEL.
+ */
+static uint64_t
+p4est_quadrant_radix_key (const p4est_quadrant_t * q)
+{
+  const int           l = (int) q->level;
+
+  return (p4est_quadrant_linear_id (q, l) <<
+          (P4EST_DIM * (P4EST_QMAXLEVEL - l) + 5)) | (uint64_t) l;
+}
+
+/** Sort same-tree quadrants by a least-significant-digit radix sort.
+ * This runs in linear time and replaces the function pointer call per
+ * comparison by one key computation per quadrant.
+ * \param [in,out] quadrants  Array of p4est_quadrant_t.
+ * \return  True if the array has been sorted.  False if the quadrants
+ *          do not admit a 64 bit key and a comparison sort is required.
+ */
+static int
+p4est_quadrant_array_radix_sort (sc_array_t * quadrants)
+{
+  const size_t        incount = quadrants->elem_count;
+  int                 shift, d, maxlevel;
+  size_t              zz, total, c;
+  size_t              counts[256];
+  p4est_qcoord_t      ored;
+  p4est_quadrant_t   *in, *scratch;
+  p4est_radix_entry_t *aent, *bent, *a, *b, *swap;
+
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+
+  /* small arrays are served well enough by the comparison sort */
+  if (incount < 256) {
+    return 0;
+  }
+
+  /* the key requires non-negative coordinates and quadrant levels */
+  in = (p4est_quadrant_t *) quadrants->array;
+  ored = 0;
+  maxlevel = 0;
+  for (zz = 0; zz < incount; ++zz) {
+    ored |= in[zz].x | in[zz].y;
+#ifdef P4_TO_P8
+    ored |= in[zz].z;
+#endif
+    maxlevel = SC_MAX (maxlevel, (int) in[zz].level);
+  }
+  if (ored < 0 || maxlevel > P4EST_QMAXLEVEL) {
+    return 0;
+  }
+
+  /* compute each key once instead of log (n) comparisons per quadrant */
+  a = aent = P4EST_ALLOC (p4est_radix_entry_t, incount);
+  b = bent = P4EST_ALLOC (p4est_radix_entry_t, incount);
+  for (zz = 0; zz < incount; ++zz) {
+    a[zz].key = p4est_quadrant_radix_key (in + zz);
+    a[zz].orig = zz;
+  }
+
+  /* stable counting passes over the key, eight bits at a time */
+  for (shift = 0; shift < 64; shift += 8) {
+    memset (counts, 0, sizeof (counts));
+    for (zz = 0; zz < incount; ++zz) {
+      ++counts[(a[zz].key >> shift) & 0xff];
+    }
+    if (counts[(a[0].key >> shift) & 0xff] == incount) {
+      /* all keys agree on this digit */
+      continue;
+    }
+    total = 0;
+    for (d = 0; d < 256; ++d) {
+      c = counts[d];
+      counts[d] = total;
+      total += c;
+    }
+    for (zz = 0; zz < incount; ++zz) {
+      b[counts[(a[zz].key >> shift) & 0xff]++] = a[zz];
+    }
+    swap = a;
+    a = b;
+    b = swap;
+  }
+
+  /* apply the resulting permutation to the quadrants */
+  scratch = P4EST_ALLOC (p4est_quadrant_t, incount);
+  memcpy (scratch, in, incount * sizeof (p4est_quadrant_t));
+  for (zz = 0; zz < incount; ++zz) {
+    in[zz] = scratch[a[zz].orig];
+  }
+  P4EST_FREE (scratch);
+  P4EST_FREE (aent);
+  P4EST_FREE (bent);
+
+  return 1;
+}
+
+/** Key-tree-index triple for the piggybacked radix sort passes. */
+typedef struct
+{
+  uint64_t            key;      /**< Morton key of the quadrant */
+  p4est_topidx_t      tree;     /**< tree number from p.piggy3 */
+  size_t              orig;     /**< position in the input array */
+}
+p4est_radix_piggy_entry_t;
+
+/** Sort quadrants carrying their tree number in p.piggy3 by a
+ * least-significant-digit radix sort, matching the order of
+ * \ref p4est_quadrant_compare_piggy.  The Morton digits are processed
+ * first and the tree digits last, so the stable passes leave the tree
+ * number as the most significant part of the combined key.
+ * \param [in,out] quadrants  Array of p4est_quadrant_t with valid
+ *                            p.piggy3.which_tree fields.
+ * \return  True if the array has been sorted.  False if the quadrants
+ *          do not admit a 64 bit key and a comparison sort is required.
+ */
+static int
+p4est_quadrant_array_radix_sort_piggy (sc_array_t * quadrants)
+{
+  const size_t        incount = quadrants->elem_count;
+  int                 shift, d, maxlevel;
+  size_t              zz, total, c;
+  size_t              counts[256];
+  p4est_qcoord_t      ored;
+  p4est_quadrant_t   *in, *scratch;
+  p4est_radix_piggy_entry_t *aent, *bent, *a, *b, *swap;
+
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+
+  /* small arrays are served well enough by the comparison sort */
+  if (incount < 256) {
+    return 0;
+  }
+
+  /* the key requires non-negative coordinates and quadrant levels */
+  in = (p4est_quadrant_t *) quadrants->array;
+  ored = 0;
+  maxlevel = 0;
+  for (zz = 0; zz < incount; ++zz) {
+    P4EST_ASSERT (in[zz].p.piggy3.which_tree >= 0);
+    ored |= in[zz].x | in[zz].y;
+#ifdef P4_TO_P8
+    ored |= in[zz].z;
+#endif
+    maxlevel = SC_MAX (maxlevel, (int) in[zz].level);
+  }
+  if (ored < 0 || maxlevel > P4EST_QMAXLEVEL) {
+    return 0;
+  }
+
+  /* compute each key once instead of log (n) comparisons per quadrant */
+  a = aent = P4EST_ALLOC (p4est_radix_piggy_entry_t, incount);
+  b = bent = P4EST_ALLOC (p4est_radix_piggy_entry_t, incount);
+  for (zz = 0; zz < incount; ++zz) {
+    a[zz].key = p4est_quadrant_radix_key (in + zz);
+    a[zz].tree = in[zz].p.piggy3.which_tree;
+    a[zz].orig = zz;
+  }
+
+  /* stable counting passes over the Morton key, eight bits at a time */
+  for (shift = 0; shift < 64; shift += 8) {
+    memset (counts, 0, sizeof (counts));
+    for (zz = 0; zz < incount; ++zz) {
+      ++counts[(a[zz].key >> shift) & 0xff];
+    }
+    if (counts[(a[0].key >> shift) & 0xff] == incount) {
+      /* all keys agree on this digit */
+      continue;
+    }
+    total = 0;
+    for (d = 0; d < 256; ++d) {
+      c = counts[d];
+      counts[d] = total;
+      total += c;
+    }
+    for (zz = 0; zz < incount; ++zz) {
+      b[counts[(a[zz].key >> shift) & 0xff]++] = a[zz];
+    }
+    swap = a;
+    a = b;
+    b = swap;
+  }
+
+  /* the tree number sorts last and thus most significantly */
+  for (shift = 0; shift < 32; shift += 8) {
+    memset (counts, 0, sizeof (counts));
+    for (zz = 0; zz < incount; ++zz) {
+      ++counts[((uint32_t) a[zz].tree >> shift) & 0xff];
+    }
+    if (counts[((uint32_t) a[0].tree >> shift) & 0xff] == incount) {
+      /* all keys agree on this digit */
+      continue;
+    }
+    total = 0;
+    for (d = 0; d < 256; ++d) {
+      c = counts[d];
+      counts[d] = total;
+      total += c;
+    }
+    for (zz = 0; zz < incount; ++zz) {
+      b[counts[((uint32_t) a[zz].tree >> shift) & 0xff]++] = a[zz];
+    }
+    swap = a;
+    a = b;
+    b = swap;
+  }
+
+  /* apply the resulting permutation to the quadrants */
+  scratch = P4EST_ALLOC (p4est_quadrant_t, incount);
+  memcpy (scratch, in, incount * sizeof (p4est_quadrant_t));
+  for (zz = 0; zz < incount; ++zz) {
+    in[zz] = scratch[a[zz].orig];
+  }
+  P4EST_FREE (scratch);
+  P4EST_FREE (aent);
+  P4EST_FREE (bent);
+
+  return 1;
+}
+
+void
+p4est_quadrant_array_sort (sc_array_t * quadrants,
+                           int (*compar) (const void *, const void *))
+{
+#ifdef P4EST_ENABLE_OPENMP
+  const size_t        csize = (size_t) 1 << 15;
+  const size_t        incount = quadrants->elem_count;
+  size_t              lo, mid, hi, li, ri, oi;
+  size_t              width;
+  p4est_quadrant_t   *in, *out, *scratch, *swap;
+#endif
+
+  /* arrays in same-tree Morton order admit a key-based linear sort */
+  if (compar == p4est_quadrant_compare &&
+      p4est_quadrant_array_radix_sort (quadrants)) {
+    P4EST_ASSERT (sc_array_is_sorted (quadrants, compar));
+    return;
+  }
+
+  /* the same holds for the piggybacked tree-then-Morton order */
+  if (compar == p4est_quadrant_compare_piggy &&
+      p4est_quadrant_array_radix_sort_piggy (quadrants)) {
+    P4EST_ASSERT (sc_array_is_sorted (quadrants, compar));
+    return;
+  }
+
+#ifdef P4EST_ENABLE_OPENMP
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+
+  /* small arrays are not worth the thread startup and scratch copy */
+  if (incount <= 2 * csize) {
+    sc_array_sort (quadrants, compar);
+    return;
+  }
+
+  /* sort fixed-size chunks independently in parallel */
+  in = (p4est_quadrant_t *) quadrants->array;
+#pragma omp parallel for schedule (dynamic)
+  for (lo = 0; lo < incount; lo += csize) {
+    qsort (in + lo, SC_MIN (csize, incount - lo),
+           sizeof (p4est_quadrant_t), compar);
+  }
+
+  /* merge sorted runs of doubling width, one thread per output run */
+  out = scratch = P4EST_ALLOC (p4est_quadrant_t, incount);
+  for (width = csize; width < incount; width *= 2) {
+#pragma omp parallel for schedule (dynamic) private (mid, hi, li, ri, oi)
+    for (lo = 0; lo < incount; lo += 2 * width) {
+      mid = SC_MIN (lo + width, incount);
+      hi = SC_MIN (lo + 2 * width, incount);
+      li = lo;
+      ri = mid;
+      oi = lo;
+      while (li < mid && ri < hi) {
+        out[oi++] = (compar (in + li, in + ri) <= 0) ? in[li++] : in[ri++];
+      }
+      while (li < mid) {
+        out[oi++] = in[li++];
+      }
+      while (ri < hi) {
+        out[oi++] = in[ri++];
+      }
+    }
+    swap = in;
+    in = out;
+    out = swap;
+  }
+  if (in == scratch) {
+    memcpy (quadrants->array, scratch,
+            incount * sizeof (p4est_quadrant_t));
+  }
+  P4EST_FREE (scratch);
+#else
+  sc_array_sort (quadrants, compar);
+#endif
+
+  P4EST_ASSERT (sc_array_is_sorted (quadrants, compar));
+}
+
 void
 p4est_tree_uniqify_overlap (sc_array_t * out)
 {
@@ -1123,7 +1708,7 @@ p4est_tree_uniqify_overlap (sc_array_t * out)
   }
 
   /* sort array and remove duplicates */
-  sc_array_sort (out, p4est_quadrant_compare_piggy);
+  p4est_quadrant_array_sort (out, p4est_quadrant_compare_piggy);
   dupcount = olcount = 0;
   iz = 0;                       /* read counter */
   jz = 0;                       /* write counter */
@@ -1449,65 +2034,338 @@ p4est_quadrant_disjoint_parent (const void *a, const void *b)
   return 0;
 }
 
-/** Complete/balance a region of an tree.
- *
- * \param [in] inlist             List of quadrants to consider: should be
- *                                sorted and reduced, i.e., every quadrant
- *                                should have child_id == 0.
- * \param [in]     dom            Least common ancestor of all quadrants in
- *                                \a inlist.
- * \param [in]     bound          The number of quadrants in a neighborhood to
- *                                consider when balancing.
- *                                bound = 1 : just the quadrant itself, i.e.,
- *                                            completion.
- *                                bound = P4EST_DIM + 1 : face balance
- *                                bound = 2**P4EST_DIM  : full balance
- *                                bound = 2**P4EST_DIM - 1 : edge balance
- * \param [in/out] qpool          quadrant pool for temporary quadrants
- * \param [in/out] list_alloc     list mempool for hash tables
- * \param [in/out] out            the sorted, complete, balance quadrants in
- *                                the region will be appended to out
- * \param [in]     first_desc     the first quadrant defining the start of the
- *                                region.  if NULL, the region is understood
- *                                to start with the first descendant of \a
- *                                dom.
- * \param [in]     last_desc      the last quadrant defining the start of the
- *                                region.  if NULL, the region is understood
- *                                to end with the last descendant of \a
- *                                dom.
- * \param [in/out] count_in       If not NULL, points to an accumulator for
- *                                the number of times the balance algorithm
- *                                tries to insert a quadrant that already
- *                                exists
- * \param [in/out] count_out      If not NULL, points to an accumulator for
- *                                the number of times the balance algorithm
- *                                tries to duplicate the insertion of a new
- *                                quadrant
- * \param [in/out] count_an       If not NULL, points to an accumulator for
- *                                the number of times the balance algorithm
- *                                tries to insert the ancestor of an existing
- *                                quadrant
+/** Reduced-tree size above which balance insertion candidates are
+ * deduplicated by sort-unique instead of per-entry hash tables; see
+ * \ref p4est_complete_or_balance_sort. */
+#define P4EST_BALANCE_SORT_THRESHOLD ((size_t) 1 << 12)
+
+/** Construct candidate \a sid of the insulation neighborhood of \a par.
+ * \param [in]  par     The parent shifted to its zeroth sibling.
+ * \param [in]  sid     Candidate number within the insulation bound.
+ * \param [in]  pid     Child id of the original parent position.
+ * \param [in]  ph      Twice the parent's quadrant length.
+ * \param [out] qalloc  Filled with the shifted candidate.
  */
 static void
-p4est_complete_or_balance_kernel (sc_array_t * inlist,
-                                  p4est_quadrant_t * dom,
-                                  int bound,
-                                  sc_mempool_t * qpool,
-                                  sc_mempool_t * list_alloc,
-                                  sc_array_t * out,
-                                  p4est_quadrant_t * first_desc,
-                                  p4est_quadrant_t * last_desc,
-                                  size_t * count_in, size_t * count_out,
-                                  size_t * count_an)
+p4est_balance_candidate (const p4est_quadrant_t * par, int sid, int pid,
+                         p4est_qcoord_t ph, p4est_quadrant_t * qalloc)
 {
-  int                 inserted;
-  size_t              iz, jz;
-  size_t              incount, ocount;
-#ifdef P4EST_ENABLE_DEBUG
-  size_t              quadrant_pool_size;
-  sc_array_t          outview;
-#endif
-  size_t              count_already_inlist, count_already_outlist;
+  *qalloc = *par;
+  if (!sid) {
+    /* the parent sibling itself is left in place */
+  }
+  else if (sid <= P4EST_DIM) {
+    /* include face neighbors */
+    switch (sid - 1) {
+    case 0:
+      qalloc->x += ((pid & 1) ? ph : -ph);
+      break;
+    case 1:
+      qalloc->y += ((pid & 2) ? ph : -ph);
+      break;
+#ifdef P4_TO_P8
+    case 2:
+      qalloc->z += ((pid & 4) ? ph : -ph);
+      break;
+#endif
+    default:
+      SC_ABORT_NOT_REACHED ();
+    }
+  }
+#ifdef P4_TO_P8
+  else if (sid < 7) {
+    /* include edge neighbors */
+    switch (sid - 4) {
+    case 0:
+      qalloc->y += ((pid & 2) ? ph : -ph);
+      qalloc->z += ((pid & 4) ? ph : -ph);
+      break;
+    case 1:
+      qalloc->x += ((pid & 1) ? ph : -ph);
+      qalloc->z += ((pid & 4) ? ph : -ph);
+      break;
+    case 2:
+      qalloc->x += ((pid & 1) ? ph : -ph);
+      qalloc->y += ((pid & 2) ? ph : -ph);
+      break;
+    default:
+      SC_ABORT_NOT_REACHED ();
+    }
+  }
+#endif
+  else {
+    /* include corner neighbor */
+    qalloc->x += ((pid & 1) ? ph : -ph);
+    qalloc->y += ((pid & 2) ? ph : -ph);
+#ifdef P4_TO_P8
+    qalloc->z += ((pid & 4) ? ph : -ph);
+#endif
+  }
+}
+
+/** Compare candidate quadrants, breaking ties by generation order. */
+static int
+p4est_balance_seq_compare (const void *v1, const void *v2)
+{
+  const p4est_quadrant_t *q1 = (const p4est_quadrant_t *) v1;
+  const p4est_quadrant_t *q2 = (const p4est_quadrant_t *) v2;
+  int                 comp = p4est_quadrant_compare (v1, v2);
+
+  if (comp) {
+    return comp;
+  }
+  return q1->p.user_long < q2->p.user_long ? -1 :
+    q1->p.user_long > q2->p.user_long ? 1 : 0;
+}
+
+/** Candidate engine of \ref p4est_complete_or_balance_kernel without
+ * hash tables.  The insulation candidates of one level are collected
+ * into a flat array, sorted with the generation order as tie breaker,
+ * and deduplicated in a single pass.  This trades the per-candidate
+ * allocation and scattered lookups of the hash tables for two
+ * cache-friendly sweeps, which wins for large adaptation fronts.
+ * The marks left in \a inlist and the appended candidates are the same
+ * as those of the hash engine.
+ * \param [in] fd       First accepted quadrant, or NULL for no bound.
+ * \param [in] last_desc  Last accepted quadrant, or NULL for no bound.
+ */
+static void
+p4est_complete_or_balance_sort (sc_array_t * inlist, p4est_quadrant_t * dom,
+                                int bound, int minlevel, int maxlevel,
+                                const p4est_quadrant_t * fd,
+                                const p4est_quadrant_t * last_desc,
+                                size_t * count_already_inlist,
+                                size_t * count_already_outlist,
+                                size_t * count_ancestor_inlist)
+{
+  const int           duplicate = 1;
+  const int           precluded = 2;
+  int                 l;
+  int                 sid, pid;
+  int                 search, prec;
+  size_t              iz, jz, zz;
+  size_t              incount, ocount, ccount;
+  long                nseq;
+  ssize_t             srindex;
+  p4est_qcoord_t      ph;
+  p4est_quadrant_t   *q, *p, *r, *c;
+  p4est_quadrant_t    par, cq;
+  sc_array_t          raw;
+  sc_array_t          cand[P4EST_MAXLEVEL + 1];
+
+  incount = inlist->elem_count;
+
+  /* one candidate array per level replaces the hash tables */
+  for (l = minlevel + 1; l <= maxlevel; ++l) {
+    sc_array_init (&cand[l], sizeof (p4est_quadrant_t));
+  }
+  sc_array_init (&raw, sizeof (p4est_quadrant_t));
+
+  P4EST_QUADRANT_INIT (&par);
+  par.p.user_int = 0;
+  P4EST_QUADRANT_INIT (&cq);
+
+  /* walk through the input tree bottom-up */
+  for (l = maxlevel; l > minlevel + 1; l--) {
+    ocount = cand[l].elem_count;
+    nseq = 0;
+    for (jz = 0; jz < incount + ocount; ++jz) {
+      if (jz < incount) {
+        q = p4est_quadrant_array_index (inlist, jz);
+        if ((int) q->level != l || (q->p.user_int & duplicate)) {
+          /* if a duplicate, don't run */
+          continue;
+        }
+      }
+      else {
+        q = p4est_quadrant_array_index (&cand[l], jz - incount);
+        P4EST_ASSERT ((int) q->level == l);
+      }
+      P4EST_ASSERT (p4est_quadrant_is_ancestor (dom, q));
+      P4EST_ASSERT (p4est_quadrant_child_id (q) == 0);
+
+      p4est_quadrant_parent (q, &par);  /* get the parent */
+      ph = P4EST_QUADRANT_LEN (par.level - 1);  /* twice its size */
+      pid = p4est_quadrant_child_id (&par);     /* and position */
+      p4est_quadrant_sibling (&par, &par, 0);   /* now shift to 0 */
+
+      for (sid = 0; sid < bound; sid++) {
+        p4est_balance_candidate (&par, sid, pid, ph, &cq);
+        P4EST_ASSERT (p4est_quadrant_is_extended (&cq));
+        P4EST_ASSERT (p4est_quadrant_child_id (&cq) == 0);
+        P4EST_ASSERT ((int) cq.level == l - 1);
+
+        /* do not add quadrants outside of the domain */
+        if (sid && !p4est_quadrant_is_ancestor (dom, &cq)) {
+          continue;
+        }
+
+        /* remember the generation order and the parent sibling flag */
+        c = (p4est_quadrant_t *) sc_array_push (&raw);
+        *c = cq;
+        c->p.user_long = (nseq++ << 1) | (sid == 0);
+      }
+    }
+
+    /* sort-unique replaces the per-candidate hash insertion */
+    sc_array_sort (&raw, p4est_balance_seq_compare);
+    ccount = raw.elem_count;
+    for (iz = 0; iz < ccount; iz = zz) {
+      q = p4est_quadrant_array_index (&raw, iz);
+      /* the earliest generated copy decides whether to search, exactly
+       * like the successful insertion does in the hash engine */
+      search = !(q->p.user_long & 1);
+      prec = (int) (q->p.user_long & 1);
+      for (zz = iz + 1; zz < ccount; ++zz) {
+        p = p4est_quadrant_array_index (&raw, zz);
+        if (!p4est_quadrant_is_equal (q, p)) {
+          break;
+        }
+        /* a later parent sibling copy relays the precluded mark */
+        prec |= (int) (p->p.user_long & 1);
+        ++*count_already_outlist;
+      }
+      c = (p4est_quadrant_t *) sc_array_push (&cand[l - 1]);
+      *c = *q;
+      c->p.user_int = prec ? precluded : 0;
+
+      if (search) {
+        /* identical to the insertion search of the hash engine */
+        srindex = sc_array_bsearch (inlist, c,
+                                    p4est_quadrant_disjoint_parent);
+        if (srindex != -1) {
+          r = p4est_quadrant_array_index (inlist, srindex);
+          if (r->level >= l - 1) {
+            /* either c duplicates r or is precluded by r: either way,
+             * we do not need to add c to inlist in the final merge */
+            c->p.user_int = precluded;
+            if (r->level > l - 1) {
+              ++*count_ancestor_inlist;
+            }
+            else {
+              ++*count_already_inlist;
+            }
+          }
+          if (r->level <= l - 1) {
+            /* either c duplicates r, or an octant that can be traced
+             * to c will duplicate r */
+            r->p.user_int |= duplicate;
+            if (r->level < l - 1) {
+              /* if c precluded r, we can remove r before the final
+               * merge */
+              r->p.user_int |= precluded;
+            }
+          }
+        }
+      }
+    }
+    sc_array_reset (&raw);
+  }
+
+  /* remove unneeded octants */
+  jz = 0;
+  for (iz = 0; iz < incount; iz++) {
+    q = p4est_quadrant_array_index (inlist, iz);
+    if ((q->p.user_int & precluded) == 0) {
+      if (jz != iz) {
+        p = p4est_quadrant_array_index (inlist, jz++);
+        *p = *q;
+      }
+      else {
+        jz++;
+      }
+    }
+  }
+  sc_array_resize (inlist, jz);
+  incount = jz;
+
+  /* merge valid candidates from cand into inlist */
+  for (l = minlevel + 1; l <= maxlevel; ++l) {
+    ccount = cand[l].elem_count;
+    for (jz = 0; jz < ccount; ++jz) {
+      c = p4est_quadrant_array_index (&cand[l], jz);
+      P4EST_ASSERT ((int) c->level == l);
+      P4EST_ASSERT (p4est_quadrant_is_ancestor (dom, c));
+      P4EST_ASSERT (p4est_quadrant_child_id (c) == 0);
+      if (fd != NULL && p4est_quadrant_compare (c, fd) < 0) {
+        continue;
+      }
+      if (last_desc != NULL && p4est_quadrant_compare (c, last_desc) > 0) {
+        continue;
+      }
+      if (c->p.user_int != precluded) {
+        q = p4est_quadrant_array_push (inlist);
+        *q = *c;
+      }
+    }
+    sc_array_reset (&cand[l]);
+  }
+
+  /* sort inlist */
+  if (inlist->elem_count > incount) {
+    p4est_quadrant_array_sort (inlist, p4est_quadrant_compare);
+  }
+}
+
+/** Complete/balance a region of an tree.
+ *
+ * \param [in] inlist             List of quadrants to consider: should be
+ *                                sorted and reduced, i.e., every quadrant
+ *                                should have child_id == 0.
+ * \param [in]     dom            Least common ancestor of all quadrants in
+ *                                \a inlist.
+ * \param [in]     bound          The number of quadrants in a neighborhood to
+ *                                consider when balancing.
+ *                                bound = 1 : just the quadrant itself, i.e.,
+ *                                            completion.
+ *                                bound = P4EST_DIM + 1 : face balance
+ *                                bound = 2**P4EST_DIM  : full balance
+ *                                bound = 2**P4EST_DIM - 1 : edge balance
+ * \param [in/out] qpool          quadrant pool for temporary quadrants
+ * \param [in/out] list_alloc     list mempool for hash tables
+ * \param [in/out] out            the sorted, complete, balance quadrants in
+ *                                the region will be appended to out
+ * \param [in]     first_desc     the first quadrant defining the start of the
+ *                                region.  if NULL, the region is understood
+ *                                to start with the first descendant of \a
+ *                                dom.
+ * \param [in]     last_desc      the last quadrant defining the start of the
+ *                                region.  if NULL, the region is understood
+ *                                to end with the last descendant of \a
+ *                                dom.
+ * \param [in/out] count_in       If not NULL, points to an accumulator for
+ *                                the number of times the balance algorithm
+ *                                tries to insert a quadrant that already
+ *                                exists
+ * \param [in/out] count_out      If not NULL, points to an accumulator for
+ *                                the number of times the balance algorithm
+ *                                tries to duplicate the insertion of a new
+ *                                quadrant
+ * \param [in/out] count_an       If not NULL, points to an accumulator for
+ *                                the number of times the balance algorithm
+ *                                tries to insert the ancestor of an existing
+ *                                quadrant
+ */
+static void
+p4est_complete_or_balance_kernel (sc_array_t * inlist,
+                                  p4est_quadrant_t * dom,
+                                  int bound,
+                                  sc_mempool_t * qpool,
+                                  sc_mempool_t * list_alloc,
+                                  sc_array_t * out,
+                                  p4est_quadrant_t * first_desc,
+                                  p4est_quadrant_t * last_desc,
+                                  size_t * count_in, size_t * count_out,
+                                  size_t * count_an)
+{
+  int                 inserted;
+  size_t              iz, jz;
+  size_t              incount, ocount;
+#ifdef P4EST_ENABLE_DEBUG
+  size_t              quadrant_pool_size;
+  sc_array_t          outview;
+#endif
+  size_t              count_already_inlist, count_already_outlist;
   size_t              count_ancestor_inlist;
   p4est_quadrant_t   *q, *p, *r;
   int                 minlevel = dom->level + 1, maxlevel;
@@ -1622,7 +2480,17 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
 
   P4EST_ASSERT (sc_array_is_sorted (inlist, p4est_quadrant_compare));
 
-  if (bound > 1) {
+  if (bound > 1 && incount >= P4EST_BALANCE_SORT_THRESHOLD) {
+    /* large fronts dedupe candidates by sort-unique on a flat array
+     * instead of paying for one hash insertion per candidate */
+    p4est_complete_or_balance_sort (inlist, dom, bound, minlevel, maxlevel,
+                                    first_desc != NULL ? &fd : NULL,
+                                    last_desc,
+                                    &count_already_inlist,
+                                    &count_already_outlist,
+                                    &count_ancestor_inlist);
+  }
+  else if (bound > 1) {
     /* initialize temporary storage */
     for (l = 0; l <= minlevel; ++l) {
       /* we don't need a hash table for minlevel, because all minlevel
@@ -1677,58 +2545,11 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
         p4est_quadrant_sibling (&par, &par, 0); /* now shift to 0 */
 
         for (sid = 0; sid < bound; sid++) {
-          *qalloc = par;
+          p4est_balance_candidate (&par, sid, pid, ph, qalloc);
           if (!sid) {
             qalloc->p.user_int = precluded;
             P4EST_ASSERT (p4est_quadrant_is_ancestor (dom, qalloc));
           }
-          else if (sid <= P4EST_DIM) {
-            /* include face neighbors */
-            switch (sid - 1) {
-            case 0:
-              qalloc->x += ((pid & 1) ? ph : -ph);
-              break;
-            case 1:
-              qalloc->y += ((pid & 2) ? ph : -ph);
-              break;
-#ifdef P4_TO_P8
-            case 2:
-              qalloc->z += ((pid & 4) ? ph : -ph);
-              break;
-#endif
-            default:
-              SC_ABORT_NOT_REACHED ();
-            }
-          }
-#ifdef P4_TO_P8
-          else if (sid < 7) {
-            /* include edge neighbors */
-            switch (sid - 4) {
-            case 0:
-              qalloc->y += ((pid & 2) ? ph : -ph);
-              qalloc->z += ((pid & 4) ? ph : -ph);
-              break;
-            case 1:
-              qalloc->x += ((pid & 1) ? ph : -ph);
-              qalloc->z += ((pid & 4) ? ph : -ph);
-              break;
-            case 2:
-              qalloc->x += ((pid & 1) ? ph : -ph);
-              qalloc->y += ((pid & 2) ? ph : -ph);
-              break;
-            default:
-              SC_ABORT_NOT_REACHED ();
-            }
-          }
-#endif
-          else {
-            /* include corner neighbor */
-            qalloc->x += ((pid & 1) ? ph : -ph);
-            qalloc->y += ((pid & 2) ? ph : -ph);
-#ifdef P4_TO_P8
-            qalloc->z += ((pid & 4) ? ph : -ph);
-#endif
-          }
 
           P4EST_ASSERT (p4est_quadrant_is_extended (qalloc));
           P4EST_ASSERT (p4est_quadrant_child_id (qalloc) == 0);
@@ -1854,7 +2675,7 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
 
     /* sort inlist */
     if (inlist->elem_count > incount) {
-      sc_array_sort (inlist, p4est_quadrant_compare);
+      p4est_quadrant_array_sort (inlist, p4est_quadrant_compare);
     }
   }
 
@@ -2064,63 +2885,130 @@ p4est_balance_replace_recursive (p4est_t * p4est, p4est_topidx_t nt,
   }
 }
 
+static int          p4est_complete_or_balance_bound (int btype);
+static void         p4est_complete_or_balance_compute (p4est_tree_t * tree,
+                                                       int bound,
+                                                       sc_mempool_t * qpool,
+                                                       sc_array_t * outlist,
+                                                       size_t
+                                                       *count_already_inlist,
+                                                       size_t
+                                                       *count_already_outlist,
+                                                       size_t
+                                                       *count_ancestor_inlist);
+static void         p4est_complete_or_balance_apply (p4est_t * p4est,
+                                                     p4est_topidx_t
+                                                     which_tree,
+                                                     p4est_init_t init_fn,
+                                                     p4est_replace_t
+                                                     replace_fn,
+                                                     sc_array_t * outlist);
+
 static void
 p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
                            p4est_init_t init_fn, p4est_replace_t replace_fn,
                            int btype)
 {
   p4est_tree_t       *tree;
-  sc_array_t         *tquadrants;
   int                 bound;
-  int8_t              maxlevel;
-  sc_mempool_t       *qpool;
-#ifdef P4EST_ENABLE_DEBUG
-  size_t              data_pool_size;
-#endif
-  size_t              tcount;
+  size_t              tcount, ocount;
   size_t              count_already_inlist, count_already_outlist;
   size_t              count_ancestor_inlist;
-  p4est_quadrant_t   *q, *p;
-  sc_mempool_t       *list_alloc;
-  sc_array_t         *inlist, *outlist;
-  size_t              iz, jz, jzstart = 0, jzend, ocount;
-  p4est_quadrant_t    tempq, root;
+  sc_array_t         *outlist;
 
   P4EST_ASSERT (which_tree >= p4est->first_local_tree);
   P4EST_ASSERT (which_tree <= p4est->last_local_tree);
   tree = p4est_tree_array_index (p4est->trees, which_tree);
-  tquadrants = &(tree->quadrants);
 
+  bound = p4est_complete_or_balance_bound (btype);
+
+  /* initialize some counters */
+  count_already_inlist = count_already_outlist = 0;
+  count_ancestor_inlist = 0;
+
+  /* run the search phase and merge its result into the tree */
+  tcount = tree->quadrants.elem_count;
+  outlist = sc_array_new (sizeof (p4est_quadrant_t));
+  p4est_complete_or_balance_compute (tree, bound, p4est->quadrant_pool,
+                                     outlist,
+                                     &count_already_inlist,
+                                     &count_already_outlist,
+                                     &count_ancestor_inlist);
+  ocount = outlist->elem_count;
+  p4est_complete_or_balance_apply (p4est, which_tree, init_fn, replace_fn,
+                                   outlist);
+  sc_array_destroy (outlist);
+
+  if (ocount > 0) {
+    P4EST_VERBOSEF
+      ("Tree %lld inlist %llu outlist %llu ancestor %llu insert %llu\n",
+       (long long) which_tree, (unsigned long long) count_already_inlist,
+       (unsigned long long) count_already_outlist,
+       (unsigned long long) count_ancestor_inlist,
+       (unsigned long long) (ocount - tcount));
+  }
+
+  if (p4est->inspect) {
+    if (!p4est->inspect->use_B) {
+      p4est->inspect->balance_A_count_in += count_already_inlist;
+      p4est->inspect->balance_A_count_in += count_ancestor_inlist;
+      p4est->inspect->balance_A_count_out += count_already_outlist;
+    }
+    else {
+      p4est->inspect->balance_B_count_in += count_already_inlist;
+      p4est->inspect->balance_B_count_in += count_ancestor_inlist;
+      p4est->inspect->balance_B_count_out += count_already_outlist;
+    }
+  }
+}
+
+/** Map the integer balance type onto the kernel's insulation bound. */
+static int
+p4est_complete_or_balance_bound (int btype)
+{
   P4EST_ASSERT (0 <= btype && btype <= P4EST_DIM);
-  P4EST_ASSERT (sc_array_is_sorted (tquadrants, p4est_quadrant_compare));
 
   switch (btype) {
   case 0:
-    bound = 1;
-    break;
+    return 1;
   case 1:
-    bound = P4EST_DIM + 1;
-    break;
+    return P4EST_DIM + 1;
   case P4EST_DIM:
-    bound = (1 << P4EST_DIM);
-    break;
+    return (1 << P4EST_DIM);
 #ifdef P4_TO_P8
   case 2:
-    bound = 7;
-    break;
+    return 7;
 #endif
   default:
     SC_ABORT_NOT_REACHED ();
   }
+}
 
-  qpool = p4est->quadrant_pool;
+/** Search phase of \ref p4est_complete_or_balance for one tree.
+ * Only reads the tree and writes the scratch objects passed in, so
+ * independent trees may be processed concurrently as long as every
+ * thread works with its own \a qpool.
+ * \param [in,out] outlist  Empty array; filled with the completed tree,
+ *                          or left empty if the tree needs no change.
+ */
+static void
+p4est_complete_or_balance_compute (p4est_tree_t * tree, int bound,
+                                   sc_mempool_t * qpool,
+                                   sc_array_t * outlist,
+                                   size_t *count_already_inlist,
+                                   size_t *count_already_outlist,
+                                   size_t *count_ancestor_inlist)
+{
+  sc_array_t         *tquadrants = &tree->quadrants;
+  size_t              tcount;
+  size_t              iz;
+  p4est_quadrant_t   *q, *p;
+  sc_mempool_t       *list_alloc;
+  sc_array_t         *inlist;
+  p4est_quadrant_t    tempq, root;
 
-#ifdef P4EST_ENABLE_DEBUG
-  data_pool_size = 0;
-  if (p4est->user_data_pool != NULL) {
-    data_pool_size = p4est->user_data_pool->elem_count;
-  }
-#endif
+  P4EST_ASSERT (sc_array_is_sorted (tquadrants, p4est_quadrant_compare));
+  P4EST_ASSERT (outlist->elem_count == 0);
 
   tcount = tquadrants->elem_count;
   /* if tree is empty, there is nothing to do */
@@ -2128,10 +3016,6 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
     return;
   }
 
-  /* initialize some counters */
-  count_already_inlist = count_already_outlist = 0;
-  count_ancestor_inlist = 0;
-
   /* get containing quadrant */
   P4EST_QUADRANT_INIT (&root);
   p4est_nearest_common_ancestor (&tree->first_desc, &tree->last_desc, &root);
@@ -2139,7 +3023,7 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
   if (tcount == 1) {
     p = p4est_quadrant_array_index (tquadrants, 0);
     if (p4est_quadrant_is_equal (p, &root)) {
-      /* nothing to be done, clean up and exit */
+      /* nothing to be done, the empty outlist tells the caller */
       return;
     }
   }
@@ -2148,7 +3032,6 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
   list_alloc = sc_mempool_new (sizeof (sc_link_t));
 
   inlist = sc_array_new (sizeof (p4est_quadrant_t));
-  outlist = sc_array_new (sizeof (p4est_quadrant_t));
 
   /* get the reduced representation of the tree */
   q = (p4est_quadrant_t *) sc_array_push (inlist);
@@ -2173,11 +3056,53 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
                                     list_alloc, outlist,
                                     &(tree->first_desc),
                                     &(tree->last_desc),
-                                    &count_already_inlist,
-                                    &count_already_outlist,
-                                    &count_ancestor_inlist);
+                                    count_already_inlist,
+                                    count_already_outlist,
+                                    count_ancestor_inlist);
+
+  sc_array_destroy (inlist);
+  sc_mempool_destroy (list_alloc);
+}
+
+/** Merge phase of \ref p4est_complete_or_balance for one tree.
+ * Initializes the user data of new quadrants and installs the outlist
+ * into the tree, which touches the forest's memory pools and therefore
+ * must run serially.
+ * \param [in] outlist  Result of \ref p4est_complete_or_balance_compute.
+ */
+static void
+p4est_complete_or_balance_apply (p4est_t * p4est, p4est_topidx_t which_tree,
+                                 p4est_init_t init_fn,
+                                 p4est_replace_t replace_fn,
+                                 sc_array_t * outlist)
+{
+  p4est_tree_t       *tree;
+  sc_array_t         *tquadrants;
+  int8_t              maxlevel;
+#ifdef P4EST_ENABLE_DEBUG
+  size_t              data_pool_size;
+#endif
+  size_t              tcount;
+  p4est_quadrant_t   *q, *p;
+  size_t              iz, jz, jzstart = 0, jzend, ocount;
+  p4est_quadrant_t    tempq;
 
   ocount = outlist->elem_count;
+  if (ocount == 0) {
+    /* the compute phase found nothing to be done */
+    return;
+  }
+
+  tree = p4est_tree_array_index (p4est->trees, which_tree);
+  tquadrants = &(tree->quadrants);
+  tcount = tquadrants->elem_count;
+
+#ifdef P4EST_ENABLE_DEBUG
+  data_pool_size = 0;
+  if (p4est->user_data_pool != NULL) {
+    data_pool_size = p4est->user_data_pool->elem_count;
+  }
+#endif
 
   iz = 0;                       /* tquadrants */
   jz = 0;                       /* outlist */
@@ -2255,30 +3180,6 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
     P4EST_ASSERT (data_pool_size + (ocount - tcount) ==
                   p4est->user_data_pool->elem_count);
   }
-
-  P4EST_VERBOSEF
-    ("Tree %lld inlist %llu outlist %llu ancestor %llu insert %llu\n",
-     (long long) which_tree, (unsigned long long) count_already_inlist,
-     (unsigned long long) count_already_outlist,
-     (unsigned long long) count_ancestor_inlist,
-     (unsigned long long) (ocount - tcount));
-
-  sc_array_destroy (inlist);
-  sc_array_destroy (outlist);
-  sc_mempool_destroy (list_alloc);
-
-  if (p4est->inspect) {
-    if (!p4est->inspect->use_B) {
-      p4est->inspect->balance_A_count_in += count_already_inlist;
-      p4est->inspect->balance_A_count_in += count_ancestor_inlist;
-      p4est->inspect->balance_A_count_out += count_already_outlist;
-    }
-    else {
-      p4est->inspect->balance_B_count_in += count_already_inlist;
-      p4est->inspect->balance_B_count_in += count_ancestor_inlist;
-      p4est->inspect->balance_B_count_out += count_already_outlist;
-    }
-  }
 }
 
 void
@@ -2354,7 +3255,7 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
   flist = sc_array_new (sizeof (p4est_quadrant_t));
 
   /* sort the border and remove duplicates */
-  sc_array_sort (qarray, p4est_quadrant_compare);
+  p4est_quadrant_array_sort (qarray, p4est_quadrant_compare);
   jz = 1;                       /* number included */
   kz = 0;                       /* number skipped */
   p = p4est_quadrant_array_index (qarray, 0);
@@ -2556,6 +3457,90 @@ p4est_balance_subtree_ext (p4est_t * p4est, p4est_connect_type_t btype,
                              p4est_connect_type_int (btype));
 }
 
+void
+p4est_balance_subtrees (p4est_t * p4est, p4est_connect_type_t btype,
+                        p4est_init_t init_fn, p4est_replace_t replace_fn,
+                        const int8_t * dirty_trees)
+{
+  const p4est_topidx_t first_tree = p4est->first_local_tree;
+  const p4est_topidx_t last_tree = p4est->last_local_tree;
+  const int           bound =
+    p4est_complete_or_balance_bound (p4est_connect_type_int (btype));
+  p4est_topidx_t      nt, num_trees;
+  size_t             *counters;
+  size_t              count_in, count_an, count_out;
+  sc_array_t        **outlists;
+  sc_array_t         *outlist;
+
+  if (first_tree > last_tree) {
+    /* this processor is empty */
+    return;
+  }
+  num_trees = last_tree - first_tree + 1;
+
+  outlists = P4EST_ALLOC (sc_array_t *, num_trees);
+  counters = P4EST_ALLOC_ZERO (size_t, 3 * num_trees);
+
+  /* The search phase of one tree only reads the tree and writes its
+   * own scratch objects, so the trees are distributed over the thread
+   * pool with one quadrant pool confined to each thread.  Only the
+   * merge below touches the forest's memory pools and runs serially. */
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel
+#endif
+  {
+    sc_mempool_t       *qpool = sc_mempool_new (sizeof (p4est_quadrant_t));
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp for schedule (dynamic)
+#endif
+    for (nt = first_tree; nt <= last_tree; ++nt) {
+      if (dirty_trees != NULL && !dirty_trees[nt - first_tree]) {
+        /* a tree marked clean is already balanced internally */
+        outlists[nt - first_tree] = NULL;
+        continue;
+      }
+      outlists[nt - first_tree] = sc_array_new (sizeof (p4est_quadrant_t));
+      p4est_complete_or_balance_compute (p4est_tree_array_index
+                                         (p4est->trees, nt), bound, qpool,
+                                         outlists[nt - first_tree],
+                                         &counters[3 * (nt - first_tree)],
+                                         &counters[3 * (nt - first_tree) +
+                                                   1],
+                                         &counters[3 * (nt - first_tree) +
+                                                   2]);
+    }
+    sc_mempool_destroy (qpool);
+  }
+
+  /* merge the completed trees and sum up the statistics */
+  count_in = count_an = count_out = 0;
+  for (nt = first_tree; nt <= last_tree; ++nt) {
+    outlist = outlists[nt - first_tree];
+    if (outlist == NULL) {
+      continue;
+    }
+    p4est_complete_or_balance_apply (p4est, nt, init_fn, replace_fn,
+                                     outlist);
+    sc_array_destroy (outlist);
+    count_in += counters[3 * (nt - first_tree)];
+    count_out += counters[3 * (nt - first_tree) + 1];
+    count_an += counters[3 * (nt - first_tree) + 2];
+  }
+  P4EST_FREE (outlists);
+  P4EST_FREE (counters);
+
+  if (p4est->inspect) {
+    if (!p4est->inspect->use_B) {
+      p4est->inspect->balance_A_count_in += count_in + count_an;
+      p4est->inspect->balance_A_count_out += count_out;
+    }
+    else {
+      p4est->inspect->balance_B_count_in += count_in + count_an;
+      p4est->inspect->balance_B_count_out += count_out;
+    }
+  }
+}
+
 size_t
 p4est_linearize_tree (p4est_t * p4est, p4est_tree_t * tree)
 {
@@ -2568,6 +3553,10 @@ p4est_linearize_tree (p4est_t * p4est, p4est_tree_t * tree)
   int                 i, maxlevel;
   p4est_quadrant_t   *q1, *q2;
   sc_array_t         *tquadrants = &tree->quadrants;
+  char               *marks = NULL;
+#ifdef P4EST_ENABLE_OPENMP
+  size_t              zi;
+#endif
 
   P4EST_ASSERT (sc_array_is_sorted (tquadrants, p4est_quadrant_compare));
 
@@ -2583,14 +3572,32 @@ p4est_linearize_tree (p4est_t * p4est, p4est_tree_t * tree)
 #endif
   removed = 0;
 
+#ifdef P4EST_ENABLE_OPENMP
+  /* In a sorted array the first descendant of an ancestor follows it
+   * directly, so removal only depends on the immediate successor.
+   * Evaluate this predicate for all quadrants in parallel and leave
+   * the dependent compaction to the serial loop below. */
+  if (incount > (size_t) 1 << 15) {
+    marks = P4EST_ALLOC (char, incount - 1);
+#pragma omp parallel for schedule (static) private (q1, q2)
+    for (zi = 0; zi < incount - 1; ++zi) {
+      q1 = p4est_quadrant_array_index (tquadrants, zi);
+      q2 = p4est_quadrant_array_index (tquadrants, zi + 1);
+      marks[zi] = (char) (p4est_quadrant_is_equal (q1, q2) ||
+                          p4est_quadrant_is_ancestor (q1, q2));
+    }
+  }
+#endif
+
   /* run through the array and remove ancestors */
   current = 0;
   rest = current + 1;
   q1 = p4est_quadrant_array_index (tquadrants, current);
   while (rest < incount) {
     q2 = p4est_quadrant_array_index (tquadrants, rest);
-    if (p4est_quadrant_is_equal (q1, q2) ||
-        p4est_quadrant_is_ancestor (q1, q2)) {
+    if (marks != NULL ? (int) marks[rest - 1] :
+        (p4est_quadrant_is_equal (q1, q2) ||
+         p4est_quadrant_is_ancestor (q1, q2))) {
       --tree->quadrants_per_level[q1->level];
       p4est_quadrant_free_data (p4est, q1);
       *q1 = *q2;
@@ -2610,6 +3617,8 @@ p4est_linearize_tree (p4est_t * p4est, p4est_tree_t * tree)
     }
   }
 
+  P4EST_FREE (marks);
+
   /* resize array */
   sc_array_resize (tquadrants, current + 1);
 
@@ -2704,9 +3713,70 @@ p4est_next_nonempty_process (int rank, int num_procs,
   return rank;
 }
 
-p4est_gloidx_t
-p4est_partition_given (p4est_t * p4est,
-                       const p4est_locidx_t * new_num_quadrants_in_proc)
+/** Derive the contiguous old-to-new quadrant ranges of a repartition.
+ * See the migrate hooks in \ref p4est_inspect for their use.
+ */
+static sc_array_t  *
+p4est_partition_migrate_ranges (p4est_t * p4est,
+                                const p4est_gloidx_t *
+                                new_global_last_quad_index)
+{
+  const int           num_procs = p4est->mpisize;
+  const int           rank = p4est->mpirank;
+  const p4est_gloidx_t *old_gfq = p4est->global_first_quadrant;
+  const p4est_gloidx_t old_begin = old_gfq[rank];
+  const p4est_gloidx_t old_end = old_gfq[rank + 1];
+  int                 r;
+  p4est_gloidx_t      new_begin, new_end;
+  p4est_gloidx_t      rbegin, rend, lo, hi;
+  sc_array_t         *ranges;
+  p4est_migrate_range_t *mr;
+
+  new_begin = rank == 0 ? 0 : new_global_last_quad_index[rank - 1] + 1;
+  new_end = new_global_last_quad_index[rank] + 1;
+  ranges = sc_array_new (sizeof (p4est_migrate_range_t));
+
+  /* the quadrants this rank owns now, split by their new owner */
+  for (r = 0; r < num_procs; ++r) {
+    rbegin = r == 0 ? 0 : new_global_last_quad_index[r - 1] + 1;
+    rend = new_global_last_quad_index[r] + 1;
+    lo = SC_MAX (old_begin, rbegin);
+    hi = SC_MIN (old_end, rend);
+    if (lo < hi) {
+      mr = (p4est_migrate_range_t *) sc_array_push (ranges);
+      mr->from_rank = rank;
+      mr->to_rank = r;
+      mr->old_first = (p4est_locidx_t) (lo - old_begin);
+      mr->new_first = r == rank ? (p4est_locidx_t) (lo - new_begin) : -1;
+      mr->count = (p4est_locidx_t) (hi - lo);
+    }
+  }
+
+  /* the quadrants this rank will own, split by their current owner;
+   * the range that stays in place is already listed above */
+  for (r = 0; r < num_procs; ++r) {
+    if (r == rank) {
+      continue;
+    }
+    lo = SC_MAX (new_begin, old_gfq[r]);
+    hi = SC_MIN (new_end, old_gfq[r + 1]);
+    if (lo < hi) {
+      mr = (p4est_migrate_range_t *) sc_array_push (ranges);
+      mr->from_rank = r;
+      mr->to_rank = rank;
+      mr->old_first = -1;
+      mr->new_first = (p4est_locidx_t) (lo - new_begin);
+      mr->count = (p4est_locidx_t) (hi - lo);
+    }
+  }
+
+  return ranges;
+}
+
+p4est_partition_context_t *
+p4est_partition_given_begin (p4est_t * p4est,
+                             const p4est_locidx_t *
+                             new_num_quadrants_in_proc)
 {
   const int           num_procs = p4est->mpisize;
   const int           rank = p4est->mpirank;
@@ -2727,42 +3797,36 @@ p4est_partition_given (p4est_t * p4est,
   int                 from_proc, to_proc;
   int                 num_proc_recv_from, num_proc_send_to;
   char               *user_data_send_buf;
-  char               *user_data_recv_buf;
   char              **recv_buf, **send_buf;
-  size_t              recv_size, send_size, zz, zoffset;
-  p4est_topidx_t      it;
+  size_t              recv_size, send_size;
+  size_t              zbuffer_bytes;
   p4est_topidx_t      which_tree;
-  p4est_topidx_t      first_tree, last_tree;
   p4est_topidx_t      num_recv_trees;
-  p4est_topidx_t      new_first_local_tree, new_last_local_tree;
-  p4est_topidx_t      first_from_tree, last_from_tree, from_tree;
   p4est_locidx_t      il;
   p4est_locidx_t      num_copy;
-  p4est_locidx_t      num_quadrants;
-  p4est_locidx_t      new_local_num_quadrants;
   p4est_locidx_t     *num_recv_from, *num_send_to;
-  p4est_locidx_t     *new_local_tree_elem_count;
-  p4est_locidx_t     *new_local_tree_elem_count_before;
   p4est_locidx_t     *num_per_tree_local;
   p4est_locidx_t     *num_per_tree_send_buf;
-  p4est_locidx_t     *num_per_tree_recv_buf;
   p4est_gloidx_t     *begin_send_to;
   p4est_gloidx_t      tree_from_begin, tree_from_end, num_copy_global;
   p4est_gloidx_t      from_begin, from_end;
   p4est_gloidx_t      to_begin, to_end;
   p4est_gloidx_t      my_base, my_begin, my_end;
+  p4est_gloidx_t      journal_old_begin, journal_old_end;
   p4est_gloidx_t     *global_last_quad_index;
   p4est_gloidx_t     *new_global_last_quad_index;
   p4est_gloidx_t     *local_tree_last_quad_index;
   p4est_gloidx_t      diff64, total_quadrants_shipped;
-  sc_array_t         *quadrants;
   p4est_quadrant_t   *quad_send_buf;
-  p4est_quadrant_t   *quad_recv_buf;
-  p4est_quadrant_t   *quad;
   p4est_tree_t       *tree;
+  p4est_partition_context_t *ctx;
+  sc_array_t         *migrate_ranges;
+  size_t              zmr;
 #ifdef P4EST_ENABLE_MPI
   int                 mpiret;
+  int                *recv_proc;
   MPI_Comm            comm = p4est->mpicomm;
+  MPI_Request        *head_request;
   MPI_Request        *recv_request, *send_request;
 #endif
 #ifdef P4EST_ENABLE_DEBUG
@@ -2770,6 +3834,14 @@ p4est_partition_given (p4est_t * p4est,
   p4est_gloidx_t      total_requested_quadrants = 0;
 #endif
 
+  double              tstart = 0.;
+
+  if (p4est->inspect != NULL) {
+    tstart = sc_MPI_Wtime ();
+  }
+  P4EST_PHASE_BEGIN (P4EST_STRING "_partition_given_begin");
+  journal_old_begin = p4est->global_first_quadrant[rank];
+  journal_old_end = p4est->global_first_quadrant[rank + 1];
   P4EST_GLOBAL_INFOF
     ("Into " P4EST_STRING "_partition_given with %lld total quadrants\n",
      (long long) p4est->global_num_quadrants);
@@ -2808,8 +3880,26 @@ p4est_partition_given (p4est_t * p4est,
   P4EST_ASSERT (global_last_quad_index[num_procs - 1] ==
                 new_global_last_quad_index[num_procs - 1]);
 
+  /* derive the old-to-new quadrant ranges for external array migration
+   * while the old ownership is still in effect */
+  migrate_ranges = NULL;
+  if (p4est->inspect != NULL &&
+      (p4est->inspect->migrate_pre_fn != NULL ||
+       p4est->inspect->migrate_post_fn != NULL)) {
+    migrate_ranges =
+      p4est_partition_migrate_ranges (p4est, new_global_last_quad_index);
+    if (p4est->inspect->migrate_pre_fn != NULL) {
+      for (zmr = 0; zmr < migrate_ranges->elem_count; ++zmr) {
+        p4est->inspect->migrate_pre_fn (p4est, (p4est_migrate_range_t *)
+                                        sc_array_index (migrate_ranges, zmr),
+                                        p4est->inspect->migrate_user);
+      }
+    }
+  }
+
   /* Calculate the global number of shipped (= received) quadrants */
   total_quadrants_shipped = 0;
+  zbuffer_bytes = 0;
   for (i = 1; i < num_procs; ++i) {
     diff64 =
       global_last_quad_index[i - 1] - new_global_last_quad_index[i - 1];
@@ -2898,10 +3988,15 @@ p4est_partition_given (p4est_t * p4est,
   /* Post receives for the quadrants and their data */
   recv_buf = P4EST_ALLOC_ZERO (char *, num_procs);
 #ifdef P4EST_ENABLE_MPI
+  head_request = P4EST_ALLOC (MPI_Request, num_proc_recv_from);
   recv_request = P4EST_ALLOC (MPI_Request, num_proc_recv_from);
+  recv_proc = P4EST_ALLOC (int, num_proc_recv_from);
 #endif
 
-  /* Allocate space for receiving quadrants and user data */
+  /* Allocate space for receiving quadrants and user data.
+   * The per-tree counts and the quadrant payload arrive as separate
+   * messages, so the payloads can be inserted in completion order while
+   * later transfers are still in flight. */
   for (from_proc = 0, sk = 0; from_proc < num_procs; ++from_proc) {
     if (from_proc != rank && num_recv_from[from_proc] > 0) {
       num_recv_trees =          /* same type */
@@ -2911,15 +4006,25 @@ p4est_partition_given (p4est_t * p4est,
         + quad_plus_data_size * num_recv_from[from_proc];
 
       recv_buf[from_proc] = P4EST_ALLOC (char, recv_size);
+      zbuffer_bytes += recv_size;
 
-      /* Post receives for the quadrants and their data */
+      /* Post receives for the counts, quadrants, and their data */
 #ifdef P4EST_ENABLE_MPI
       P4EST_LDEBUGF ("partition recv %lld quadrants from %d\n",
                      (long long) num_recv_from[from_proc], from_proc);
-      mpiret = MPI_Irecv (recv_buf[from_proc], (int) recv_size, MPI_BYTE,
-                          from_proc, P4EST_COMM_PARTITION_GIVEN,
+      mpiret = MPI_Irecv (recv_buf[from_proc],
+                          (int) (num_recv_trees * sizeof (p4est_locidx_t)),
+                          MPI_BYTE, from_proc, P4EST_COMM_PARTITION_GIVEN,
+                          comm, head_request + sk);
+      SC_CHECK_MPI (mpiret);
+      mpiret = MPI_Irecv (recv_buf[from_proc]
+                          + num_recv_trees * sizeof (p4est_locidx_t),
+                          (int) (quad_plus_data_size *
+                                 num_recv_from[from_proc]), MPI_BYTE,
+                          from_proc, P4EST_COMM_PARTITION_GIVEN_LOAD,
                           comm, recv_request + sk);
       SC_CHECK_MPI (mpiret);
+      recv_proc[sk] = from_proc;
 #endif
       ++sk;
     }
@@ -2927,7 +4032,9 @@ p4est_partition_given (p4est_t * p4est,
 #ifdef P4EST_ENABLE_MPI
   for (; sk < num_proc_recv_from; ++sk) {
     /* for empty processors in receiving range */
+    head_request[sk] = MPI_REQUEST_NULL;
     recv_request[sk] = MPI_REQUEST_NULL;
+    recv_proc[sk] = -1;
   }
 #endif
 
@@ -2978,7 +4085,7 @@ p4est_partition_given (p4est_t * p4est,
   /* Communicate the quadrants and their data */
   send_buf = P4EST_ALLOC (char *, num_procs);
 #ifdef P4EST_ENABLE_MPI
-  send_request = P4EST_ALLOC (MPI_Request, num_proc_send_to);
+  send_request = P4EST_ALLOC (MPI_Request, 2 * num_proc_send_to);
 #endif
 
   /* Set the num_per_tree_local */
@@ -3014,6 +4121,7 @@ p4est_partition_given (p4est_t * p4est,
         + quad_plus_data_size * num_send_to[to_proc];
 
       send_buf[to_proc] = P4EST_ALLOC (char, send_size);
+      zbuffer_bytes += send_size;
 
       num_per_tree_send_buf = (p4est_locidx_t *) send_buf[to_proc];
       memset (num_per_tree_send_buf, 0,
@@ -3074,14 +4182,24 @@ p4est_partition_given (p4est_t * p4est,
         }
       }
 
-      /* Post send operation for the quadrants and their data */
+      /* Post send operations for the counts, quadrants, and their data */
 #ifdef P4EST_ENABLE_MPI
       P4EST_LDEBUGF ("partition send %lld quadrants to %d\n",
                      (long long) num_send_to[to_proc], to_proc);
-      mpiret = MPI_Isend (send_buf[to_proc], (int) send_size, MPI_BYTE,
-                          to_proc, P4EST_COMM_PARTITION_GIVEN,
-                          comm, send_request + sk);
+      mpiret = MPI_Isend (send_buf[to_proc],
+                          (int) (num_send_trees * sizeof (p4est_locidx_t)),
+                          MPI_BYTE, to_proc, P4EST_COMM_PARTITION_GIVEN,
+                          comm, send_request + 2 * sk);
+      SC_CHECK_MPI (mpiret);
+      mpiret = MPI_Isend (send_buf[to_proc]
+                          + num_send_trees * sizeof (p4est_locidx_t),
+                          (int) (quad_plus_data_size * num_send_to[to_proc]),
+                          MPI_BYTE, to_proc, P4EST_COMM_PARTITION_GIVEN_LOAD,
+                          comm, send_request + 2 * sk + 1);
       SC_CHECK_MPI (mpiret);
+      if (p4est->inspect != NULL) {
+        p4est->inspect->partition_comm_sent += send_size;
+      }
       ++sk;
 #endif
     }
@@ -3091,12 +4209,118 @@ p4est_partition_given (p4est_t * p4est,
   }
 #ifdef P4EST_ENABLE_MPI
   for (; sk < num_proc_send_to; ++sk) {
-    send_request[sk] = MPI_REQUEST_NULL;
+    send_request[2 * sk] = MPI_REQUEST_NULL;
+    send_request[2 * sk + 1] = MPI_REQUEST_NULL;
   }
+#endif
+
+  /* the old layout and all message buffers coexist at this point */
+  if (p4est->inspect != NULL) {
+    p4est->inspect->partition_memory_peak =
+      SC_MAX (p4est->inspect->partition_memory_peak,
+              p4est_memory_used (p4est) + zbuffer_bytes);
+  }
+
+  /* park the transient state; all messages are now in flight */
+  ctx = P4EST_ALLOC_ZERO (p4est_partition_context_t, 1);
+  ctx->p4est = p4est;
+  ctx->num_proc_recv_from = num_proc_recv_from;
+  ctx->num_proc_send_to = num_proc_send_to;
+  ctx->recv_buf = recv_buf;
+  ctx->send_buf = send_buf;
+  ctx->num_recv_from = num_recv_from;
+  ctx->num_send_to = num_send_to;
+  ctx->begin_send_to = begin_send_to;
+  ctx->num_per_tree_local = num_per_tree_local;
+  ctx->global_last_quad_index = global_last_quad_index;
+  ctx->new_global_last_quad_index = new_global_last_quad_index;
+  ctx->local_tree_last_quad_index = local_tree_last_quad_index;
+  ctx->total_quadrants_shipped = total_quadrants_shipped;
+  ctx->journal_old_begin = journal_old_begin;
+  ctx->journal_old_end = journal_old_end;
+  ctx->migrate_ranges = migrate_ranges;
+  ctx->tstart = tstart;
+#ifdef P4EST_ENABLE_MPI
+  ctx->recv_proc = recv_proc;
+  ctx->head_request = head_request;
+  ctx->recv_request = recv_request;
+  ctx->send_request = send_request;
+#endif
+#ifdef P4EST_ENABLE_DEBUG
+  ctx->crc = crc;
+#endif
+
+  P4EST_PHASE_END (P4EST_STRING "_partition_given_begin");
+  return ctx;
+}
+
+p4est_gloidx_t
+p4est_partition_given_end (p4est_partition_context_t * ctx)
+{
+  p4est_t            *p4est = ctx->p4est;
+  const int           num_procs = p4est->mpisize;
+  const int           rank = p4est->mpirank;
+  const p4est_topidx_t first_local_tree = p4est->first_local_tree;
+  const p4est_topidx_t last_local_tree = p4est->last_local_tree;
+  const size_t        data_size = p4est->data_size;
+  sc_array_t         *trees = p4est->trees;
+  char              **recv_buf = ctx->recv_buf;
+  char              **send_buf = ctx->send_buf;
+  p4est_locidx_t     *num_recv_from = ctx->num_recv_from;
+  p4est_locidx_t     *num_send_to = ctx->num_send_to;
+  p4est_gloidx_t     *begin_send_to = ctx->begin_send_to;
+  p4est_locidx_t     *num_per_tree_local = ctx->num_per_tree_local;
+  p4est_gloidx_t     *global_last_quad_index = ctx->global_last_quad_index;
+  p4est_gloidx_t     *new_global_last_quad_index =
+    ctx->new_global_last_quad_index;
+  p4est_gloidx_t     *local_tree_last_quad_index =
+    ctx->local_tree_last_quad_index;
+  p4est_gloidx_t      total_quadrants_shipped = ctx->total_quadrants_shipped;
+  p4est_gloidx_t      journal_old_begin = ctx->journal_old_begin;
+  p4est_gloidx_t      journal_old_end = ctx->journal_old_end;
+  int                 i;
+  int                 from_proc;
+  size_t              zz, zoffset;
+  p4est_topidx_t      it;
+  p4est_topidx_t      which_tree;
+  p4est_topidx_t      first_tree, last_tree;
+  p4est_topidx_t      num_recv_trees;
+  p4est_topidx_t      new_first_local_tree, new_last_local_tree;
+  p4est_topidx_t      first_from_tree, last_from_tree, from_tree;
+  p4est_locidx_t      num_copy;
+  p4est_locidx_t      num_quadrants;
+  p4est_locidx_t      new_local_num_quadrants;
+  p4est_locidx_t     *new_local_tree_elem_count;
+  p4est_locidx_t     *new_local_tree_elem_count_before;
+  p4est_locidx_t     *num_per_tree_recv_buf;
+  p4est_gloidx_t      tree_from_begin, tree_from_end;
+  p4est_gloidx_t      from_begin, from_end;
+  p4est_gloidx_t      my_base, my_begin, my_end;
+  sc_array_t         *quadrants;
+  p4est_quadrant_t   *quad;
+  p4est_tree_t       *tree;
+  p4est_locidx_t    **before_offsets;
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+  int                 sk, which;
+  int                 num_proc_recv_from = ctx->num_proc_recv_from;
+  int                 num_proc_send_to = ctx->num_proc_send_to;
+  int                *recv_proc = ctx->recv_proc;
+  char               *user_data_recv_buf;
+  p4est_quadrant_t   *quad_recv_buf;
+  MPI_Request        *head_request = ctx->head_request;
+  MPI_Request        *recv_request = ctx->recv_request;
+  MPI_Request        *send_request = ctx->send_request;
+#endif
 
-  /* Fill in forest */
+  P4EST_PHASE_BEGIN (P4EST_STRING "_partition_given_end");
+
+#ifdef P4EST_ENABLE_MPI
+  /* Fill in forest; the per-tree counts suffice to compute the new local
+   * layout, so only those are waited for while the payloads overlap with
+   * the local tree reconstruction below */
   mpiret =
-    MPI_Waitall (num_proc_recv_from, recv_request, MPI_STATUSES_IGNORE);
+    MPI_Waitall (num_proc_recv_from, head_request, MPI_STATUSES_IGNORE);
   SC_CHECK_MPI (mpiret);
 #endif
 
@@ -3266,6 +4490,11 @@ p4est_partition_given (p4est_t * p4est,
 
   /* Copy in received quadrants */
 
+  /* Precompute the insertion offset of every sender's contribution to
+   * every tree from the per-tree counts alone.  This decouples the copy
+   * phase from the rank order of the senders, so each payload can be
+   * inserted as soon as its transfer completes. */
+  before_offsets = P4EST_ALLOC_ZERO (p4est_locidx_t *, num_procs);
   memset (new_local_tree_elem_count_before, 0,
           trees->elem_count * sizeof (p4est_locidx_t));
   for (from_proc = 0; from_proc < num_procs; ++from_proc) {
@@ -3275,22 +4504,12 @@ p4est_partition_given (p4est_t * p4est,
         p4est->global_first_position[from_proc + 1].p.which_tree;
       num_recv_trees =          /* same type */
         last_from_tree - first_from_tree + 1;
-
-      P4EST_LDEBUGF
-        ("partition copy from %d with trees [%lld,%lld] get %lld trees\n",
-         from_proc, (long long) first_from_tree,
-         (long long) last_from_tree, (long long) num_recv_trees);
       num_per_tree_recv_buf =
         (from_proc == rank) ? num_per_tree_local :
         (p4est_locidx_t *) recv_buf[from_proc];
 
-      quad_recv_buf = (p4est_quadrant_t *) (recv_buf[from_proc]
-                                            + num_recv_trees *
-                                            sizeof (p4est_locidx_t));
-      user_data_recv_buf =
-        recv_buf[from_proc] + num_recv_trees * sizeof (p4est_locidx_t)
-        + num_recv_from[from_proc] * sizeof (p4est_quadrant_t);
-
+      before_offsets[from_proc] =
+        P4EST_ALLOC (p4est_locidx_t, num_recv_trees);
       for (it = 0; it < num_recv_trees; ++it) {
         from_tree = first_from_tree + it;       /* same type */
         num_copy = num_per_tree_recv_buf[it];
@@ -3302,52 +4521,94 @@ p4est_partition_given (p4est_t * p4est,
                       || (num_copy > 0 && from_tree >= 0
                           && from_tree < (p4est_topidx_t) trees->elem_count));
 
-        if (num_copy > 0 && rank != from_proc) {
-          tree = p4est_tree_array_index (trees, from_tree);
-          quadrants = &tree->quadrants;
-          num_quadrants = new_local_tree_elem_count[from_tree];
-          sc_array_resize (quadrants, num_quadrants);
-
-          /* copy quadrants */
-          P4EST_LDEBUGF ("copying %lld remote quads to tree %lld"
-                         " with %lld quads from proc %d\n",
-                         (long long) num_copy, (long long) from_tree,
-                         (long long) num_quadrants, from_proc);
-          memcpy (quadrants->array +
-                  new_local_tree_elem_count_before[from_tree]
-                  * sizeof (p4est_quadrant_t), quad_recv_buf,
-                  num_copy * sizeof (p4est_quadrant_t));
-
-          /* copy user data */
-          zoffset = (size_t) new_local_tree_elem_count_before[from_tree];
-          for (zz = 0; zz < (size_t) num_copy; ++zz) {
-            quad = p4est_quadrant_array_index (quadrants, zz + zoffset);
-
-            if (data_size > 0) {
-              quad->p.user_data = sc_mempool_alloc (p4est->user_data_pool);
-              memcpy (quad->p.user_data, user_data_recv_buf + zz * data_size,
-                      data_size);
-            }
-          }
-        }
-
+        before_offsets[from_proc][it] = (num_copy > 0) ?
+          new_local_tree_elem_count_before[from_tree] : 0;
         if (num_copy > 0) {
-          P4EST_ASSERT (from_tree >= 0
-                        && from_tree < (p4est_topidx_t) trees->elem_count);
           new_local_tree_elem_count_before[from_tree] +=        /* same type */
             num_copy;
         }
-
-        /* increment the recv quadrant pointers */
-        quad_recv_buf += num_copy;
-        user_data_recv_buf += num_copy * data_size;
       }
-      if (recv_buf[from_proc] != NULL) {
-        P4EST_FREE (recv_buf[from_proc]);
-        recv_buf[from_proc] = NULL;
+    }
+  }
+
+  /* Insert the remote payloads in the order in which they complete.
+   * The local quadrants have been moved into place above, so any
+   * transfer that was still in flight overlapped with that work. */
+#ifdef P4EST_ENABLE_MPI
+  for (sk = 0; sk < num_proc_recv_from; ++sk) {
+    mpiret = MPI_Waitany (num_proc_recv_from, recv_request, &which,
+                          MPI_STATUS_IGNORE);
+    SC_CHECK_MPI (mpiret);
+    if (which == MPI_UNDEFINED) {
+      break;
+    }
+    from_proc = recv_proc[which];
+    P4EST_ASSERT (from_proc != rank && num_recv_from[from_proc] > 0);
+
+    first_from_tree = p4est->global_first_position[from_proc].p.which_tree;
+    last_from_tree = p4est->global_first_position[from_proc + 1].p.which_tree;
+    num_recv_trees =            /* same type */
+      last_from_tree - first_from_tree + 1;
+
+    P4EST_LDEBUGF
+      ("partition copy from %d with trees [%lld,%lld] get %lld trees\n",
+       from_proc, (long long) first_from_tree,
+       (long long) last_from_tree, (long long) num_recv_trees);
+    num_per_tree_recv_buf = (p4est_locidx_t *) recv_buf[from_proc];
+
+    quad_recv_buf = (p4est_quadrant_t *) (recv_buf[from_proc]
+                                          + num_recv_trees *
+                                          sizeof (p4est_locidx_t));
+    user_data_recv_buf =
+      recv_buf[from_proc] + num_recv_trees * sizeof (p4est_locidx_t)
+      + num_recv_from[from_proc] * sizeof (p4est_quadrant_t);
+
+    for (it = 0; it < num_recv_trees; ++it) {
+      from_tree = first_from_tree + it; /* same type */
+      num_copy = num_per_tree_recv_buf[it];
+
+      if (num_copy > 0) {
+        tree = p4est_tree_array_index (trees, from_tree);
+        quadrants = &tree->quadrants;
+        num_quadrants = new_local_tree_elem_count[from_tree];
+        sc_array_resize (quadrants, num_quadrants);
+
+        /* copy quadrants */
+        P4EST_LDEBUGF ("copying %lld remote quads to tree %lld"
+                       " with %lld quads from proc %d\n",
+                       (long long) num_copy, (long long) from_tree,
+                       (long long) num_quadrants, from_proc);
+        memcpy (quadrants->array +
+                before_offsets[from_proc][it]
+                * sizeof (p4est_quadrant_t), quad_recv_buf,
+                num_copy * sizeof (p4est_quadrant_t));
+
+        /* copy user data */
+        zoffset = (size_t) before_offsets[from_proc][it];
+        for (zz = 0; zz < (size_t) num_copy; ++zz) {
+          quad = p4est_quadrant_array_index (quadrants, zz + zoffset);
+
+          if (data_size > 0) {
+            quad->p.user_data = sc_mempool_alloc (p4est->user_data_pool);
+            memcpy (quad->p.user_data, user_data_recv_buf + zz * data_size,
+                    data_size);
+          }
+        }
       }
+
+      /* increment the recv quadrant pointers */
+      quad_recv_buf += num_copy;
+      user_data_recv_buf += num_copy * data_size;
     }
+    P4EST_FREE (recv_buf[from_proc]);
+    recv_buf[from_proc] = NULL;
   }
+#endif
+
+  for (from_proc = 0; from_proc < num_procs; ++from_proc) {
+    P4EST_FREE (before_offsets[from_proc]);
+  }
+  P4EST_FREE (before_offsets);
 
   /* Set the global index and count of quadrants instead
    * of calling p4est_comm_count_quadrants
@@ -3409,18 +4670,21 @@ p4est_partition_given (p4est_t * p4est,
   /* Clean up */
 
 #ifdef P4EST_ENABLE_MPI
-  mpiret = MPI_Waitall (num_proc_send_to, send_request, MPI_STATUSES_IGNORE);
+  mpiret = MPI_Waitall (2 * num_proc_send_to, send_request,
+                        MPI_STATUSES_IGNORE);
   SC_CHECK_MPI (mpiret);
 
 #ifdef P4EST_ENABLE_DEBUG
   for (i = 0; i < num_proc_recv_from; ++i) {
     P4EST_ASSERT (recv_request[i] == MPI_REQUEST_NULL);
   }
-  for (i = 0; i < num_proc_send_to; ++i) {
+  for (i = 0; i < 2 * num_proc_send_to; ++i) {
     P4EST_ASSERT (send_request[i] == MPI_REQUEST_NULL);
   }
 #endif
+  P4EST_FREE (head_request);
   P4EST_FREE (recv_request);
+  P4EST_FREE (recv_proc);
   P4EST_FREE (send_request);
 #endif
 
@@ -3443,13 +4707,77 @@ p4est_partition_given (p4est_t * p4est,
 
   p4est_comm_global_partition (p4est, NULL);
 
+  if (p4est->inspect != NULL && p4est->inspect->journal != NULL) {
+    p4est_gloidx_t      jremain, jtake;
+
+    /* quadrants received from lower ranks sit at the front of the
+     * new local window, those from higher ranks at the back */
+    jremain = SC_MIN (journal_old_begin,
+                      p4est->global_first_quadrant[rank + 1]) -
+      p4est->global_first_quadrant[rank];
+    for (which_tree = new_first_local_tree;
+         jremain > 0 && which_tree <= new_last_local_tree; ++which_tree) {
+      tree = p4est_tree_array_index (trees, which_tree);
+      quadrants = &tree->quadrants;
+      jtake = SC_MIN (jremain, (p4est_gloidx_t) quadrants->elem_count);
+      p4est_journal_log (p4est, which_tree,
+                         p4est_quadrant_array_index (quadrants, 0),
+                         p4est_quadrant_array_index (quadrants,
+                                                     (size_t) jtake - 1));
+      jremain -= jtake;
+    }
+    jremain = p4est->global_first_quadrant[rank + 1] -
+      SC_MAX (journal_old_end, p4est->global_first_quadrant[rank]);
+    for (which_tree = new_last_local_tree;
+         jremain > 0 && which_tree >= new_first_local_tree; --which_tree) {
+      tree = p4est_tree_array_index (trees, which_tree);
+      quadrants = &tree->quadrants;
+      jtake = SC_MIN (jremain, (p4est_gloidx_t) quadrants->elem_count);
+      p4est_journal_log (p4est, which_tree,
+                         p4est_quadrant_array_index (quadrants,
+                                                     quadrants->elem_count -
+                                                     (size_t) jtake),
+                         p4est_quadrant_array_index (quadrants,
+                                                     quadrants->elem_count -
+                                                     1));
+      jremain -= jtake;
+    }
+  }
+
+  /* hand the same old-to-new ranges to the post-partition migration
+   * hook now that the new layout is in place */
+  if (ctx->migrate_ranges != NULL) {
+    if (p4est->inspect != NULL && p4est->inspect->migrate_post_fn != NULL) {
+      for (zz = 0; zz < ctx->migrate_ranges->elem_count; ++zz) {
+        p4est->inspect->migrate_post_fn (p4est, (p4est_migrate_range_t *)
+                                         sc_array_index (ctx->migrate_ranges,
+                                                         zz),
+                                         p4est->inspect->migrate_user);
+      }
+    }
+    sc_array_destroy (ctx->migrate_ranges);
+  }
+
   /* Assert that we have a valid partition */
-  P4EST_ASSERT (crc == p4est_checksum (p4est));
+  P4EST_ASSERT (ctx->crc == p4est_checksum (p4est));
   P4EST_GLOBAL_INFOF
     ("Done " P4EST_STRING
      "_partition_given shipped %lld quadrants %.3g%%\n",
      (long long) total_quadrants_shipped,
      total_quadrants_shipped * 100. / p4est->global_num_quadrants);
 
+  if (p4est->inspect != NULL) {
+    p4est->inspect->partition_time += sc_MPI_Wtime () - ctx->tstart;
+  }
+  P4EST_FREE (ctx);
+  P4EST_PHASE_END (P4EST_STRING "_partition_given_end");
   return total_quadrants_shipped;
 }
+
+p4est_gloidx_t
+p4est_partition_given (p4est_t * p4est,
+                       const p4est_locidx_t * new_num_quadrants_in_proc)
+{
+  return p4est_partition_given_end
+    (p4est_partition_given_begin (p4est, new_num_quadrants_in_proc));
+}
@@ -50,7 +50,9 @@ void                p4est_quadrant_free_data (p4est_t * p4est,
  * \param [in] quadrants       Array of quadrants.
  * \param [in,out] checkarray  Temporary array of elem_size 4.
  *                             Will be resized to quadrants->elem_count * 3.
- *                             If it is NULL, will be allocated internally.
+ *                             If it is NULL, the quadrants are streamed
+ *                             through the checksum in batches without
+ *                             allocating, which is the fastest path.
  * \param [in] first_quadrant  Index of the quadrant to start with.
  *                             Can be between 0 and elem_count (inclusive).
  */
@@ -58,6 +60,16 @@ unsigned            p4est_quadrant_checksum (sc_array_t * quadrants,
                                              sc_array_t * checkarray,
                                              size_t first_quadrant);
 
+/** Request huge page backing for one quadrant array where supported.
+ * Advises the kernel to back the array's storage with transparent huge
+ * pages, which reduces TLB pressure when iterating over large arrays.
+ * On systems without madvise or MADV_HUGEPAGE this is a no-op, as it is
+ * for arrays smaller than one aligned huge page.
+ * \param [in] quadrants    Array whose current storage is advised.
+ */
+void                p4est_quadrant_array_advise_huge (sc_array_t *
+                                                      quadrants);
+
 /** Test if a tree is sorted in Morton ordering.
  * \return Returns true if sorted, false otherwise.
  * \note Duplicate quadrants are not allowed.
@@ -107,6 +119,71 @@ void                p4est_tree_print (int log_priority, p4est_tree_t * tree);
 int                 p4est_is_equal (p4est_t * p4est1, p4est_t * p4est2,
                                     int compare_data);
 
+/** Cached per-tree checksums of the local quadrant arrays.
+ * Together with \ref p4est_divergence this localizes the difference
+ * between two forests without rescanning the trees that are unchanged.
+ * The cache stays valid while the forest's revision is unchanged and is
+ * refreshed by \ref p4est_tree_checksums_update.
+ */
+typedef struct p4est_tree_checksums
+{
+  p4est_t            *p4est;       /**< The forest the cache refers to. */
+  long                revision;    /**< Its revision at the last refresh. */
+  p4est_topidx_t      num_trees;   /**< Trees in the connectivity. */
+  p4est_topidx_t      first_local_tree;    /**< Local range at refresh. */
+  p4est_topidx_t      last_local_tree;     /**< Local range at refresh. */
+  size_t              journal_seen;    /**< Consumed journal entries. */
+  unsigned           *crcs;        /**< One checksum per tree; zero for
+                                        trees without local quadrants. */
+}
+p4est_tree_checksums_t;
+
+/** Compute the per-tree checksums of a forest's local quadrants.
+ * \return          A cache to be refreshed with
+ *                  \ref p4est_tree_checksums_update and freed with
+ *                  \ref p4est_tree_checksums_destroy.
+ */
+p4est_tree_checksums_t *p4est_tree_checksums_new (p4est_t * p4est);
+
+/** Bring a checksum cache up to date after the forest changed.
+ * If the forest carries a change journal (see the inspect structure in
+ * \ref p4est_extended.h), only the trees named by journal entries since
+ * the last refresh are rescanned; otherwise, or after the local tree
+ * range moved under a repartition, all local trees are recomputed.
+ */
+void                p4est_tree_checksums_update (p4est_tree_checksums_t *
+                                                 tc);
+
+/** Free a cache created by \ref p4est_tree_checksums_new. */
+void                p4est_tree_checksums_destroy (p4est_tree_checksums_t *
+                                                  tc);
+
+/** Locally find the first tree and Morton range where two forests differ.
+ * Trees whose checksums agree are skipped in constant time when caches
+ * are passed in, so the cost is proportional to the difference rather
+ * than the forest size.  Only the refinement structure is compared; use
+ * \ref p4est_is_equal to compare quadrant payload as well.  Without
+ * zlib support no checksums exist and the arrays are compared directly.
+ * \param [in] p4est1   The first forest to be compared.
+ * \param [in] p4est2   The second forest to be compared.
+ * \param [in] tc1      Up-to-date checksum cache of \a p4est1 or NULL,
+ *                      in which case checksums are computed on the fly.
+ * \param [in] tc2      Same for \a p4est2.
+ * \param [out] first_diff  If not NULL and the forests differ, filled
+ *                      with the first diverging position as a level
+ *                      \ref P4EST_QMAXLEVEL descendant, its tree stored
+ *                      in p.which_tree.
+ * \param [out] last_diff   Same for the last diverging position within
+ *                      the first differing tree.
+ * \return          The smallest tree index where the local parts of the
+ *                  forests differ, or -1 if they are locally equal.
+ */
+p4est_topidx_t      p4est_divergence (p4est_t * p4est1, p4est_t * p4est2,
+                                      p4est_tree_checksums_t * tc1,
+                                      p4est_tree_checksums_t * tc2,
+                                      p4est_quadrant_t * first_diff,
+                                      p4est_quadrant_t * last_diff);
+
 /** Check a forest for validity and allreduce the result.
  * Some properties of a valid forest are:
  *    the quadrant counters are consistent
@@ -145,6 +222,20 @@ void                p4est_tree_compute_overlap (p4est_t * p4est,
                                                 sc_array_t * borders,
                                                 sc_array_t * inseeds);
 
+/** Sorts an array of quadrants, using threads when enabled.
+ * Large arrays sorted by \ref p4est_quadrant_compare or
+ * \ref p4est_quadrant_compare_piggy are handled by a linear-time
+ * radix sort on 64 bit Morton keys whenever the quadrants permit one.
+ * Otherwise, without --enable-openmp this falls back to
+ * \ref sc_array_sort, and with it to a parallel chunked merge sort.
+ * \param [in,out] quadrants  Array of p4est_quadrant_t to be sorted.
+ * \param [in]     compar     Comparison function, e.g.
+ *                            \ref p4est_quadrant_compare.
+ */
+void                p4est_quadrant_array_sort (sc_array_t * quadrants,
+                                               int (*compar) (const void *,
+                                                              const void *));
+
 /** Gets the reduced representation of the overlap that results from using
  * p4est_tree_compute_overlap_new
  * \param [in,out] out  A piggy-sorted subset of tree->quadrants.
@@ -214,6 +305,25 @@ void                p4est_balance_subtree (p4est_t * p4est,
                                            p4est_topidx_t which_tree,
                                            p4est_init_t init_fn);
 
+/** Balances all local trees of a p4est independently of each other.
+ * Equivalent to calling \ref p4est_balance_subtree on every local tree
+ * that is not marked clean.  The search phase of the trees is
+ * independent and runs over the thread pool under \c --enable-openmp,
+ * while the merge initializing new user data stays serial.
+ * \param [in,out] p4est       The p4est to work on.
+ * \param [in]     btype       The balance type (face or corner).
+ * \param [in]     init_fn     Callback function to initialize the user_data
+ *                             which is already allocated automatically.
+ * \param [in]     replace_fn  Callback function to replace quadrants.
+ * \param [in]     dirty_trees Array with one entry per local tree or NULL.
+ *                             A zero entry skips the tree's local balance.
+ */
+void                p4est_balance_subtrees (p4est_t * p4est,
+                                            p4est_connect_type_t btype,
+                                            p4est_init_t init_fn,
+                                            p4est_replace_t replace_fn,
+                                            const int8_t * dirty_trees);
+
 void                p4est_balance_border (p4est_t * p4est,
                                           p4est_connect_type_t btype,
                                           p4est_topidx_t which_tree,
@@ -301,6 +411,21 @@ int                 p4est_next_nonempty_process (int rank,
  *                                        quadrants desired per processor.
  * \return  Returns the global count of shipped quadrants.
  */
+/** Post all messages of \ref p4est_partition_given without waiting.
+ * The returned context must be passed to \ref p4est_partition_given_end,
+ * which completes the transfer and rebuilds the local trees.  The forest
+ * must not be accessed or modified in between.
+ */
+p4est_partition_context_t *p4est_partition_given_begin
+  (p4est_t * p4est, const p4est_locidx_t * num_quadrants_in_proc);
+
+/** Complete the transfer started by \ref p4est_partition_given_begin.
+ * The context is deallocated before this function returns.
+ * \return  Returns the global count of shipped quadrants.
+ */
+p4est_gloidx_t      p4est_partition_given_end (p4est_partition_context_t *
+                                               context);
+
 p4est_gloidx_t      p4est_partition_given (p4est_t * p4est,
                                            const p4est_locidx_t *
                                            num_quadrants_in_proc);
@@ -26,6 +26,25 @@
 
 int                 p4est_package_id = -1;
 
+/* the registered trace sink; see p4est_trace_set_sink */
+static p4est_trace_fn_t p4est_trace_sink = NULL;
+static void        *p4est_trace_sink_data = NULL;
+
+void
+p4est_trace_set_sink (p4est_trace_fn_t sink, void *user_data)
+{
+  p4est_trace_sink = sink;
+  p4est_trace_sink_data = user_data;
+}
+
+void
+p4est_trace_emit (const char *phase, int enter)
+{
+  if (p4est_trace_sink != NULL) {
+    p4est_trace_sink (phase, enter, p4est_trace_sink_data);
+  }
+}
+
 void
 p4est_init (sc_log_handler_t log_handler, int log_threshold)
 {
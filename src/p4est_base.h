@@ -50,6 +50,17 @@
 
 SC_EXTERN_C_BEGIN;
 
+/** Hint to move an address into cache ahead of its use.
+ * This compiles to a non-faulting software prefetch where the compiler
+ * supports one and to nothing otherwise, so passing a not yet validated
+ * address is safe.
+ */
+#ifdef __GNUC__
+#define P4EST_PREFETCH(a) __builtin_prefetch ((const void *) (a))
+#else
+#define P4EST_PREFETCH(a) ((void) (a))
+#endif
+
 /** Typedef for quadrant coordinates. */
 typedef int32_t     p4est_qcoord_t;
 #define p4est_qcoord_compare sc_int32_compare
@@ -105,17 +116,20 @@ typedef enum p4est_comm_tag
   P4EST_COMM_BALANCE_SECOND_COUNT,
   P4EST_COMM_BALANCE_SECOND_LOAD,
   P4EST_COMM_PARTITION_GIVEN,
+  P4EST_COMM_PARTITION_GIVEN_LOAD,
   P4EST_COMM_PARTITION_WEIGHTED_LOW,
   P4EST_COMM_PARTITION_WEIGHTED_HIGH,
   P4EST_COMM_PARTITION_CORRECTION,
   P4EST_COMM_GHOST_COUNT,
   P4EST_COMM_GHOST_LOAD,
   P4EST_COMM_GHOST_EXCHANGE,
+  P4EST_COMM_GHOST_EXCHANGE_GROUP,
   P4EST_COMM_GHOST_EXPAND_COUNT,
   P4EST_COMM_GHOST_EXPAND_LOAD,
   P4EST_COMM_GHOST_SUPPORT_COUNT,
   P4EST_COMM_GHOST_SUPPORT_LOAD,
   P4EST_COMM_GHOST_CHECKSUM,
+  P4EST_COMM_GHOST_UPDATE,
   P4EST_COMM_NODES_QUERY,
   P4EST_COMM_NODES_REPLY,
   P4EST_COMM_SAVE,
@@ -123,6 +137,10 @@ typedef enum p4est_comm_tag
   P4EST_COMM_LNODES_PASS,
   P4EST_COMM_LNODES_OWNED,
   P4EST_COMM_LNODES_ALL,
+  P4EST_COMM_DATA_VECTOR,
+  P4EST_COMM_TRANSFER_FIXED,
+  P4EST_COMM_TRANSFER_CUSTOM,
+  P4EST_COMM_FLAGS_MIGRATE,
   P4EST_COMM_TAG_LAST
 }
 p4est_comm_tag_t;
@@ -300,6 +318,49 @@ p4est_log_indent_pop ()
 void                p4est_init (sc_log_handler_t log_handler,
                                 int log_threshold);
 
+/** Callback prototype for a trace sink; see \ref p4est_trace_set_sink.
+ * The sink is expected to take its own timestamps, so adapters for
+ * profilers such as Tracy or perf reduce to a zone begin/end call.
+ * It must be safe to call from any phase of a p4est algorithm and
+ * must not call back into p4est.
+ * \param [in] phase      Static string naming the phase, for example
+ *                        "p4est_balance_comm".
+ * \param [in] enter      True on phase entry, false on phase exit.
+ * \param [in] user_data  Pointer registered with the sink.
+ */
+typedef void        (*p4est_trace_fn_t) (const char *phase, int enter,
+                                         void *user_data);
+
+/** Register a process-wide sink for phase trace points.
+ * The trace points compile to noops unless the library is built with
+ * P4EST_ENABLE_TRACE defined, so production builds pay nothing; with
+ * the define, an unset sink costs one branch per phase boundary.
+ * This function must only be called before additional threads are
+ * created; pass NULL to unregister.
+ * \param [in] sink       Called at every phase boundary, or NULL.
+ * \param [in] user_data  Passed through to \b sink uninterpreted.
+ */
+void                p4est_trace_set_sink (p4est_trace_fn_t sink,
+                                          void *user_data);
+
+/** Invoke the registered trace sink; usually called through
+ * \ref P4EST_PHASE_BEGIN and \ref P4EST_PHASE_END.
+ * \param [in] phase      Static string naming the phase.
+ * \param [in] enter      True on phase entry, false on phase exit.
+ */
+void                p4est_trace_emit (const char *phase, int enter);
+
+/* phase trace points; compile-time noops without P4EST_ENABLE_TRACE */
+#ifdef P4EST_ENABLE_TRACE
+/** Mark the entry into the named phase for the trace sink. */
+#define P4EST_PHASE_BEGIN(name) p4est_trace_emit ((name), 1)
+/** Mark the exit from the named phase for the trace sink. */
+#define P4EST_PHASE_END(name) p4est_trace_emit ((name), 0)
+#else
+#define P4EST_PHASE_BEGIN(name) SC_NOOP ()
+#define P4EST_PHASE_END(name) SC_NOOP ()
+#endif
+
 /** Compute hash value for two p4est_topidx_t integers.
  * \param [in] tt     Array of (at least) two values.
  * \return            An unsigned hash value.
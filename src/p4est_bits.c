@@ -28,6 +28,20 @@
 #include <p4est_bits.h>
 #endif /* !P4_TO_P8 */
 
+#ifdef __BMI2__
+#include <immintrin.h>
+
+/* bit i of a coordinate maps to bit P4EST_DIM * i + lane of the Morton id */
+#ifndef P4_TO_P8
+#define P4EST_MORTON_MASK_X     ((uint64_t) 0x5555555555555555ULL)
+#define P4EST_MORTON_MASK_Y     ((uint64_t) 0xAAAAAAAAAAAAAAAAULL)
+#else
+#define P4EST_MORTON_MASK_X     ((uint64_t) 0x1249249249249249ULL)
+#define P4EST_MORTON_MASK_Y     ((uint64_t) 0x2492492492492492ULL)
+#define P4EST_MORTON_MASK_Z     ((uint64_t) 0x4924924924924924ULL)
+#endif
+#endif /* __BMI2__ */
+
 void
 p4est_quadrant_print (int log_priority, const p4est_quadrant_t * q)
 {
@@ -575,6 +589,56 @@ p4est_quadrant_is_familypv (p4est_quadrant_t * q[])
     );
 }
 
+size_t
+p4est_quadrant_family_scan (const p4est_quadrant_t * q, size_t num_quadrants,
+                            int8_t * family_start)
+{
+  int                 k;
+  size_t              zz, count;
+  p4est_qcoord_t      inc, bits;
+  const p4est_quadrant_t *q0, *qk;
+
+  count = 0;
+  memset (family_start, 0, num_quadrants * sizeof (int8_t));
+  if (num_quadrants < P4EST_CHILDREN) {
+    return 0;
+  }
+
+  for (zz = 0; zz + P4EST_CHILDREN <= num_quadrants; ++zz) {
+    q0 = q + zz;
+    P4EST_ASSERT (p4est_quadrant_is_extended (q0));
+    if (q0->level <= 0) {
+      continue;
+    }
+    inc = P4EST_QUADRANT_LEN (q0->level);
+
+    /* the first member of a family is the zero child of its parent */
+    bits = (q0->x | q0->y
+#ifdef P4_TO_P8
+            | q0->z
+#endif
+      ) & inc;
+
+    /* accumulate coordinate and level mismatches of the siblings */
+    for (k = 1; k < P4EST_CHILDREN; ++k) {
+      qk = q0 + k;
+      bits |= (p4est_qcoord_t) (q0->level ^ qk->level);
+      bits |= (q0->x + ((k & 1) ? inc : 0)) ^ qk->x;
+      bits |= (q0->y + ((k & 2) ? inc : 0)) ^ qk->y;
+#ifdef P4_TO_P8
+      bits |= (q0->z + ((k & 4) ? inc : 0)) ^ qk->z;
+#endif
+    }
+    if (bits == 0) {
+      P4EST_ASSERT (p4est_quadrant_is_familyv (q0));
+      family_start[zz] = 1;
+      ++count;
+    }
+  }
+
+  return count;
+}
+
 int
 p4est_quadrant_is_parent (const p4est_quadrant_t * q,
                           const p4est_quadrant_t * r)
@@ -1184,6 +1248,141 @@ p4est_quadrant_corner_neighbor_extra (const p4est_quadrant_t * q,
   sc_array_reset (cta);
 }
 
+/** A cached transform set for one tree corner of the connectivity. */
+typedef struct p4est_corner_resolver_entry
+{
+  p4est_topidx_t      key[2];   /**< tree number and corner */
+  sc_array_t          transforms;       /**< of p4est_corner_transform_t */
+}
+p4est_corner_resolver_entry_t;
+
+static unsigned
+p4est_corner_resolver_hash (const void *v, const void *u)
+{
+  const p4est_corner_resolver_entry_t *e =
+    (const p4est_corner_resolver_entry_t *) v;
+
+  return p4est_topidx_hash2 (e->key);
+}
+
+static int
+p4est_corner_resolver_equal (const void *v1, const void *v2, const void *u)
+{
+  const p4est_corner_resolver_entry_t *e1 =
+    (const p4est_corner_resolver_entry_t *) v1;
+  const p4est_corner_resolver_entry_t *e2 =
+    (const p4est_corner_resolver_entry_t *) v2;
+
+  return e1->key[0] == e2->key[0] && e1->key[1] == e2->key[1];
+}
+
+struct p4est_corner_resolver
+{
+  p4est_connectivity_t *conn;   /**< the connectivity queried, borrowed */
+  sc_hash_array_t    *cache;    /**< of p4est_corner_resolver_entry_t */
+};
+
+p4est_corner_resolver_t *
+p4est_corner_resolver_new (p4est_connectivity_t * conn)
+{
+  p4est_corner_resolver_t *res;
+
+  res = P4EST_ALLOC (p4est_corner_resolver_t, 1);
+  res->conn = conn;
+  res->cache = sc_hash_array_new (sizeof (p4est_corner_resolver_entry_t),
+                                  p4est_corner_resolver_hash,
+                                  p4est_corner_resolver_equal, NULL);
+
+  return res;
+}
+
+void
+p4est_quadrant_corner_neighbor_resolve (p4est_corner_resolver_t * res,
+                                        const p4est_quadrant_t * q,
+                                        p4est_locidx_t t, int corner,
+                                        sc_array_t * quads,
+                                        sc_array_t * treeids,
+                                        sc_array_t * ncorners)
+{
+  p4est_quadrant_t    temp;
+  p4est_quadrant_t   *qp;
+  p4est_topidx_t     *tp;
+  int                *ip;
+  size_t              position, ctree;
+  p4est_corner_info_t ci;
+  p4est_corner_transform_t *ct;
+  p4est_corner_resolver_entry_t ekey, *entry;
+  sc_array_t         *cta;
+
+  P4EST_ASSERT (SC_ARRAY_IS_OWNER (quads));
+  P4EST_ASSERT (quads->elem_count == 0);
+  P4EST_ASSERT (quads->elem_size == sizeof (p4est_quadrant_t));
+  P4EST_ASSERT (SC_ARRAY_IS_OWNER (treeids));
+  P4EST_ASSERT (treeids->elem_count == 0);
+  P4EST_ASSERT (treeids->elem_size == sizeof (p4est_topidx_t));
+
+  p4est_quadrant_corner_neighbor (q, corner, &temp);
+  if (p4est_quadrant_is_inside_root (&temp) ||
+      !p4est_quadrant_is_outside_corner (&temp)) {
+    /* no tree corner is crossed; these cases build no transform set */
+    p4est_quadrant_corner_neighbor_extra (q, t, corner, quads, treeids,
+                                          ncorners, res->conn);
+    return;
+  }
+
+  /* retrieve the transform set of this tree corner, deriving it once */
+  ekey.key[0] = (p4est_topidx_t) t;
+  ekey.key[1] = (p4est_topidx_t) corner;
+  entry = (p4est_corner_resolver_entry_t *)
+    sc_hash_array_insert_unique (res->cache, &ekey, &position);
+  if (entry != NULL) {
+    cta = &ci.corner_transforms;
+    sc_array_init (cta, sizeof (p4est_corner_transform_t));
+    p4est_find_corner_transform (res->conn, t, corner, &ci);
+    /* move ownership of the heap buffer into the cache entry */
+    entry->transforms = *cta;
+  }
+  else {
+    entry = (p4est_corner_resolver_entry_t *)
+      sc_array_index (&res->cache->a, position);
+    P4EST_ASSERT (p4est_corner_resolver_equal (entry, &ekey, NULL));
+  }
+  cta = &entry->transforms;
+
+  sc_array_resize (quads, cta->elem_count);
+  sc_array_resize (treeids, cta->elem_count);
+  if (ncorners != NULL) {
+    sc_array_resize (ncorners, cta->elem_count);
+  }
+  for (ctree = 0; ctree < cta->elem_count; ++ctree) {
+    qp = p4est_quadrant_array_index (quads, ctree);
+    tp = (p4est_topidx_t *) sc_array_index (treeids, ctree);
+    ct = p4est_corner_array_index (cta, ctree);
+    p4est_quadrant_transform_corner (&temp, (int) ct->ncorner, 1);
+    *qp = temp;
+    *tp = ct->ntree;
+    if (ncorners != NULL) {
+      ip = (int *) sc_array_index (ncorners, ctree);
+      *ip = ct->ncorner;
+    }
+  }
+}
+
+void
+p4est_corner_resolver_destroy (p4est_corner_resolver_t * res)
+{
+  size_t              zz;
+  p4est_corner_resolver_entry_t *entry;
+
+  for (zz = 0; zz < res->cache->a.elem_count; ++zz) {
+    entry = (p4est_corner_resolver_entry_t *)
+      sc_array_index (&res->cache->a, zz);
+    sc_array_reset (&entry->transforms);
+  }
+  sc_hash_array_destroy (res->cache);
+  P4EST_FREE (res);
+}
+
 void
 p4est_quadrant_half_corner_neighbor (const p4est_quadrant_t * q, int corner,
                                      p4est_quadrant_t * r)
@@ -1723,7 +1922,9 @@ p4est_quadrant_shift_corner (const p4est_quadrant_t * q,
 uint64_t
 p4est_quadrant_linear_id (const p4est_quadrant_t * quadrant, int level)
 {
+#ifndef __BMI2__
   int                 i;
+#endif
   uint64_t            id;
   uint64_t            x, y;
 #ifdef P4_TO_P8
@@ -1740,6 +1941,18 @@ p4est_quadrant_linear_id (const p4est_quadrant_t * quadrant, int level)
   z = quadrant->z >> (P4EST_MAXLEVEL - level);
 #endif
 
+#ifdef __BMI2__
+  /* deposit the low level + 2 bits of each coordinate into its lane */
+  {
+    const uint64_t      cmask = (((uint64_t) 1 << (level + 2)) - 1);
+
+    id = _pdep_u64 (x & cmask, P4EST_MORTON_MASK_X);
+    id |= _pdep_u64 (y & cmask, P4EST_MORTON_MASK_Y);
+#ifdef P4_TO_P8
+    id |= _pdep_u64 (z & cmask, P4EST_MORTON_MASK_Z);
+#endif
+  }
+#else
   id = 0;
   for (i = 0; i < level + 2; ++i) {
     id |= ((x & ((uint64_t) 1 << i)) << ((P4EST_DIM - 1) * i));
@@ -1748,6 +1961,7 @@ p4est_quadrant_linear_id (const p4est_quadrant_t * quadrant, int level)
     id |= ((z & ((uint64_t) 1 << i)) << ((P4EST_DIM - 1) * i + 2));
 #endif
   }
+#endif
 
   return id;
 }
@@ -1756,7 +1970,9 @@ void
 p4est_quadrant_set_morton (p4est_quadrant_t * quadrant,
                            int level, uint64_t id)
 {
+#ifndef __BMI2__
   int                 i;
+#endif
 
   P4EST_ASSERT (0 <= level && level <= P4EST_QMAXLEVEL);
   if (level < P4EST_QMAXLEVEL) {
@@ -1771,6 +1987,21 @@ p4est_quadrant_set_morton (p4est_quadrant_t * quadrant,
 #endif
 
   /* this may set the sign bit to create negative numbers */
+#ifdef __BMI2__
+  {
+    const int           nbits = P4EST_DIM * (level + 2);
+
+    /* the scalar loop below ignores id bits past the used lanes */
+    if (nbits < 64) {
+      id &= ((uint64_t) 1 << nbits) - 1;
+    }
+    quadrant->x = (p4est_qcoord_t) _pext_u64 (id, P4EST_MORTON_MASK_X);
+    quadrant->y = (p4est_qcoord_t) _pext_u64 (id, P4EST_MORTON_MASK_Y);
+#ifdef P4_TO_P8
+    quadrant->z = (p4est_qcoord_t) _pext_u64 (id, P4EST_MORTON_MASK_Z);
+#endif
+  }
+#else
   for (i = 0; i < level + 2; ++i) {
     quadrant->x |= (p4est_qcoord_t) ((id & (1ULL << (P4EST_DIM * i)))
                                      >> ((P4EST_DIM - 1) * i));
@@ -1781,6 +2012,7 @@ p4est_quadrant_set_morton (p4est_quadrant_t * quadrant,
                                      >> ((P4EST_DIM - 1) * i + 2));
 #endif
   }
+#endif
 
   quadrant->x <<= (P4EST_MAXLEVEL - level);
   quadrant->y <<= (P4EST_MAXLEVEL - level);
@@ -1798,3 +2030,150 @@ p4est_quadrant_set_morton (p4est_quadrant_t * quadrant,
 
   P4EST_ASSERT (p4est_quadrant_is_extended (quadrant));
 }
+
+void
+p4est_quadrant_array_to_soa (sc_array_t * quadrants,
+                             p4est_qcoord_t * x, p4est_qcoord_t * y,
+#ifdef P4_TO_P8
+                             p4est_qcoord_t * z,
+#endif
+                             int8_t * level)
+{
+  size_t              zz;
+  const p4est_quadrant_t *q;
+
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+
+  for (zz = 0; zz < quadrants->elem_count; ++zz) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    P4EST_ASSERT (p4est_quadrant_is_extended (q));
+    x[zz] = q->x;
+    y[zz] = q->y;
+#ifdef P4_TO_P8
+    z[zz] = q->z;
+#endif
+    level[zz] = q->level;
+  }
+}
+
+void
+p4est_quadrant_array_from_soa (sc_array_t * quadrants,
+                               const p4est_qcoord_t * x,
+                               const p4est_qcoord_t * y,
+#ifdef P4_TO_P8
+                               const p4est_qcoord_t * z,
+#endif
+                               const int8_t * level)
+{
+  size_t              zz;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+
+  for (zz = 0; zz < quadrants->elem_count; ++zz) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    q->x = x[zz];
+    q->y = y[zz];
+#ifdef P4_TO_P8
+    q->z = z[zz];
+#endif
+    q->level = level[zz];
+    P4EST_ASSERT (p4est_quadrant_is_extended (q));
+  }
+}
+
+void
+p4est_quadrant_compact_pack (const p4est_quadrant_t * q,
+                             p4est_quadrant_compact_t * c)
+{
+  const int           shift = P4EST_MAXLEVEL - P4EST_COMPACT_MAXLEVEL;
+
+  P4EST_ASSERT (0 <= q->level && (int) q->level <= P4EST_COMPACT_MAXLEVEL);
+  P4EST_ASSERT (0 <= q->x && q->x < P4EST_ROOT_LEN);
+  P4EST_ASSERT (0 <= q->y && q->y < P4EST_ROOT_LEN);
+#ifdef P4_TO_P8
+  P4EST_ASSERT (0 <= q->z && q->z < P4EST_ROOT_LEN);
+#endif
+
+  c->x = (uint16_t) (q->x >> shift);
+  c->y = (uint16_t) (q->y >> shift);
+#ifdef P4_TO_P8
+  c->z = (uint16_t) (q->z >> shift);
+#endif
+  c->level = (uint8_t) q->level;
+  c->pad8 = (uint8_t) q->pad8;
+#ifndef P4_TO_P8
+  c->pad16 = 0;
+#endif
+}
+
+void
+p4est_quadrant_compact_unpack (const p4est_quadrant_compact_t * c,
+                               p4est_quadrant_t * q)
+{
+  const int           shift = P4EST_MAXLEVEL - P4EST_COMPACT_MAXLEVEL;
+
+  P4EST_ASSERT ((int) c->level <= P4EST_COMPACT_MAXLEVEL);
+
+  q->x = (p4est_qcoord_t) c->x << shift;
+  q->y = (p4est_qcoord_t) c->y << shift;
+#ifdef P4_TO_P8
+  q->z = (p4est_qcoord_t) c->z << shift;
+#endif
+  q->level = (int8_t) c->level;
+  q->pad8 = (int8_t) c->pad8;
+
+  P4EST_ASSERT (p4est_quadrant_is_valid (q));
+}
+
+void
+p4est_quadrant_array_to_compact (sc_array_t * quadrants, sc_array_t * compact)
+{
+  size_t              zz;
+  const p4est_quadrant_t *q;
+  p4est_quadrant_compact_t *c;
+
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+  P4EST_ASSERT (compact->elem_size == sizeof (p4est_quadrant_compact_t));
+
+  sc_array_resize (compact, quadrants->elem_count);
+  for (zz = 0; zz < quadrants->elem_count; ++zz) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    c = (p4est_quadrant_compact_t *) sc_array_index (compact, zz);
+    p4est_quadrant_compact_pack (q, c);
+  }
+}
+
+void
+p4est_quadrant_array_from_compact (sc_array_t * compact,
+                                   sc_array_t * quadrants)
+{
+  size_t              zz;
+  const p4est_quadrant_compact_t *c;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (compact->elem_size == sizeof (p4est_quadrant_compact_t));
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+
+  sc_array_resize (quadrants, compact->elem_count);
+  for (zz = 0; zz < compact->elem_count; ++zz) {
+    c = (const p4est_quadrant_compact_t *) sc_array_index (compact, zz);
+    q = p4est_quadrant_array_index (quadrants, zz);
+    P4EST_QUADRANT_INIT (q);
+    p4est_quadrant_compact_unpack (c, q);
+  }
+}
+
+void
+p4est_quadrant_linear_id_v (sc_array_t * quadrants, int level, uint64_t * ids)
+{
+  size_t              zz;
+  const p4est_quadrant_t *q;
+
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+
+  for (zz = 0; zz < quadrants->elem_count; ++zz) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    ids[zz] = p4est_quadrant_linear_id (q, level);
+  }
+}
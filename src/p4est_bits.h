@@ -242,6 +242,20 @@ int                 p4est_quadrant_is_familyv (const p4est_quadrant_t q[]);
  */
 int                 p4est_quadrant_is_familypv (p4est_quadrant_t * q[]);
 
+/** Mark all positions in a quadrant array where a family starts.
+ * The test runs over the coordinate and level entries with mask
+ * arithmetic and avoids per-window function calls.
+ * \param [in] q             Array of \a num_quadrants valid quadrants.
+ * \param [in] num_quadrants Number of quadrants in \a q.
+ * \param [out] family_start Array of \a num_quadrants flags.  The entry
+ *                           at index i is set to 1 if the 4 quadrants
+ *                           beginning at i form a family, 0 otherwise.
+ * \return                   The number of family starts found.
+ */
+size_t              p4est_quadrant_family_scan (const p4est_quadrant_t * q,
+                                                size_t num_quadrants,
+                                                int8_t * family_start);
+
 /** Test if a quadrant is the parent of another quadrant.
  * \param [in] q Quadrant to be tested.
  * \param [in] r Possible child quadrant.
@@ -451,6 +465,47 @@ void                p4est_quadrant_corner_neighbor_extra (const
                                                           p4est_connectivity_t
                                                           * conn);
 
+/** A resolver for corner neighbors that caches inter-tree transforms.
+ * \ref p4est_quadrant_corner_neighbor_extra derives the transform set of
+ * a tree corner from the connectivity on every call; the resolver
+ * derives it on the first query per (tree, corner) pair and reuses it
+ * afterwards, which pays off on meshes with many trees.
+ */
+typedef struct p4est_corner_resolver p4est_corner_resolver_t;
+
+/** Create a corner resolver with an empty transform cache.
+ * \param [in] conn   The connectivity to be queried; it must stay
+ *                    unchanged and alive for the resolver's lifetime.
+ * \return            A resolver to be freed with
+ *                    \ref p4est_corner_resolver_destroy.
+ */
+p4est_corner_resolver_t *p4est_corner_resolver_new (p4est_connectivity_t *
+                                                    conn);
+
+/** Compute corner neighbors like \ref p4est_quadrant_corner_neighbor_extra
+ * but answer tree-corner crossings from the resolver's cache.
+ * The results are identical to the uncached function.
+ * \param [in]     res    The resolver; its cache grows as needed.
+ * \param [in]     q      Input quadrant, must be valid.
+ * \param [in]     t      Tree that contains \a q.
+ * \param [in]     corner The corner across which to generate the neighbor.
+ * \param [in,out] quads  An initialized but empty array where the corner
+ *                        neighbors will be placed.
+ * \param [in,out] treeids An initialized but empty array where the ids of
+ *                        the trees containing the corner neighbors will be
+ *                        placed.
+ * \param [in,out] ncorners if not NULL, filled with the corners of \a quads
+ *                          that neighbor \a q.
+ */
+void                p4est_quadrant_corner_neighbor_resolve
+  (p4est_corner_resolver_t * res, const p4est_quadrant_t * q,
+   p4est_locidx_t t, int corner, sc_array_t * quads, sc_array_t * treeids,
+   sc_array_t * ncorners);
+
+/** Free a corner resolver and its cached transform sets. */
+void                p4est_corner_resolver_destroy (p4est_corner_resolver_t *
+                                                   res);
+
 /** Compute the half size corner neighbor of a quadrant.
  *
  * \param [in]  q       The quadrant whose corner neighbor will be constructed.
@@ -609,6 +664,113 @@ uint64_t            p4est_quadrant_linear_id (const p4est_quadrant_t *
 void                p4est_quadrant_set_morton (p4est_quadrant_t * quadrant,
                                                int level, uint64_t id);
 
+/** Computes the linear position on a uniform grid for an array of quadrants.
+ * This amortizes per-call overhead over the whole array; on processors
+ * with BMI2 the bit interleaving additionally uses the PDEP instruction.
+ * \param [in]  quadrants  Array of p4est_quadrant_t.
+ * \param [in]  level      The level of the regular grid; no quadrant in
+ *                         the array may be of smaller level.
+ * \param [out] ids        Array of at least \a quadrants->elem_count
+ *                         entries receiving the linear positions.
+ */
+void                p4est_quadrant_linear_id_v (sc_array_t * quadrants,
+                                               int level, uint64_t * ids);
+
+/** Gather the coordinates and levels of an array of quadrants into
+ * separate contiguous arrays.
+ * The structure-of-arrays form allows scans over sorted quadrant arrays
+ * to be vectorized over the coordinate lanes.  The piggy data is not
+ * copied; use the array index to refer back to the original quadrants.
+ * \param [in]  quadrants  Array of p4est_quadrant_t.
+ * \param [out] x          Array of at least \a quadrants->elem_count
+ *                         entries receiving the x coordinates.
+ * \param [out] y          Likewise for the y coordinates.
+ * \param [out] level      Likewise for the levels.
+ */
+void                p4est_quadrant_array_to_soa (sc_array_t * quadrants,
+                                                p4est_qcoord_t * x,
+                                                p4est_qcoord_t * y,
+                                                int8_t * level);
+
+/** Scatter separate coordinate and level arrays back into quadrants.
+ * This is the inverse operation of p4est_quadrant_array_to_soa.
+ * The quadrant array must already have its final element count; the
+ * piggy data of the quadrants is never modified.
+ * \param [in,out] quadrants  Array of p4est_quadrant_t to be overwritten.
+ * \param [in]     x          Array of x coordinates.
+ * \param [in]     y          Array of y coordinates.
+ * \param [in]     level      Array of levels.
+ */
+void                p4est_quadrant_array_from_soa (sc_array_t * quadrants,
+                                                  const p4est_qcoord_t * x,
+                                                  const p4est_qcoord_t * y,
+                                                  const int8_t * level);
+
+/** Deepest level representable by \ref p4est_quadrant_compact_t. */
+#define P4EST_COMPACT_MAXLEVEL 16
+
+/** Compact 8 byte encoding of a quadrant for shallow forests.
+ * Quadrants of level at most \ref P4EST_COMPACT_MAXLEVEL have
+ * coordinates that are multiples of a fixed power of two, so 16 bits
+ * per coordinate encode them exactly.  The encoding is meant for
+ * memory bound storage and transport of quadrant sets -- snapshots,
+ * caches, application messages -- at a third of the in-core struct
+ * size; the algorithms of this library keep operating on the full
+ * \ref p4est_quadrant_t.  The piggy data union is not represented.
+ */
+typedef struct p4est_quadrant_compact
+{
+  uint16_t            x, y;     /**< coordinates scaled down by
+                                     2^(P4EST_MAXLEVEL -
+                                     P4EST_COMPACT_MAXLEVEL) */
+  uint8_t             level;    /**< level of refinement */
+  uint8_t             pad8;     /**< copied from the quadrant verbatim */
+  uint16_t            pad16;    /**< padding, set to zero */
+}
+p4est_quadrant_compact_t;
+
+/** Encode one quadrant into its compact form.
+ * \param [in] q    Valid quadrant of level at most
+ *                  \ref P4EST_COMPACT_MAXLEVEL with coordinates
+ *                  inside the root, i.e. not a tree neighbor.
+ * \param [out] c   The compact encoding of \a q.
+ */
+void                p4est_quadrant_compact_pack (const p4est_quadrant_t * q,
+                                                 p4est_quadrant_compact_t *
+                                                 c);
+
+/** Decode one quadrant from its compact form.
+ * This is the inverse operation of \ref p4est_quadrant_compact_pack.
+ * Only the coordinates, the level, and the pad8 member of \a q are
+ * written; the user_data of \a q is never modified.
+ * \param [in] c    A compact encoding created by the pack function.
+ * \param [out] q   The decoded quadrant.
+ */
+void                p4est_quadrant_compact_unpack (const
+                                                   p4est_quadrant_compact_t *
+                                                   c, p4est_quadrant_t * q);
+
+/** Encode an array of quadrants into compact form.
+ * \param [in] quadrants     Array of p4est_quadrant_t, all of level at
+ *                           most \ref P4EST_COMPACT_MAXLEVEL.
+ * \param [in,out] compact   Initialized array of
+ *                           \ref p4est_quadrant_compact_t; it is
+ *                           resized to match and overwritten.
+ */
+void                p4est_quadrant_array_to_compact (sc_array_t * quadrants,
+                                                     sc_array_t * compact);
+
+/** Decode an array of quadrants from compact form.
+ * This is the inverse operation of \ref p4est_quadrant_array_to_compact.
+ * The piggy data of the decoded quadrants is cleared.
+ * \param [in] compact       Array of \ref p4est_quadrant_compact_t.
+ * \param [in,out] quadrants Initialized array of p4est_quadrant_t; it
+ *                           is resized to match and overwritten.
+ */
+void                p4est_quadrant_array_from_compact (sc_array_t * compact,
+                                                       sc_array_t *
+                                                       quadrants);
+
 SC_EXTERN_C_END;
 
 #endif /* !P4EST_BITS_H */
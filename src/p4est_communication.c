@@ -301,6 +301,142 @@ p4est_comm_parallel_env_reduce_ext (p4est_t ** p4est_supercomm,
   return 1;
 }
 
+p4est_comm_active_t *
+p4est_comm_parallel_env_shrink (p4est_t * p4est)
+{
+  const char         *this_fn_name = "comm_parallel_env_shrink";
+  p4est_comm_active_t *active;
+  sc_MPI_Comm         supercomm = p4est->mpicomm;
+  sc_MPI_Comm         submpicomm;
+  sc_MPI_Group        group, subgroup;
+  int                 mpiret;
+  int                 mpisize = p4est->mpisize;
+  int                 submpisize;
+  int                *include;
+  int                 p;
+
+  active = P4EST_ALLOC_ZERO (p4est_comm_active_t, 1);
+  active->p4est = p4est;
+  active->supercomm = supercomm;
+  active->supersize = mpisize;
+  active->superrank = p4est->mpirank;
+  active->is_active = 1;
+
+  /* exit if the MPI communicator cannot be shrunk */
+  if (mpisize == 1) {
+    return active;
+  }
+
+  /* collect the non-empty processes; rank zero always stays so the
+   * active communicator exists even for a globally empty forest */
+  include = P4EST_ALLOC (int, mpisize);
+  submpisize = 0;
+  for (p = 0; p < mpisize; p++) {
+    if (p == 0 ||
+        p4est->global_first_quadrant[p] <
+        p4est->global_first_quadrant[p + 1]) {
+      include[submpisize++] = p;
+    }
+  }
+
+  /* exit if every process holds quadrants */
+  if (submpisize == mpisize) {
+    P4EST_FREE (include);
+    return active;
+  }
+
+  /* create the active sub-communicator on every process */
+  mpiret = sc_MPI_Comm_group (supercomm, &group);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Group_incl (group, submpisize, include, &subgroup);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Group_free (&group);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_create (supercomm, subgroup, &submpicomm);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Group_free (&subgroup);
+  SC_CHECK_MPI (mpiret);
+
+  /* empty processes are parked with their forest left untouched */
+  if (submpicomm == sc_MPI_COMM_NULL) {
+    P4EST_FREE (include);
+    active->is_active = 0;
+    return active;
+  }
+
+  /* keep the original parallel environment alive for the expansion */
+  active->super_owned = p4est->mpicomm_owned;
+  active->super_gfq = p4est->global_first_quadrant;
+  active->super_gfp = p4est->global_first_position;
+  p4est->mpicomm_owned = 0;
+
+  /* switch the forest to the active communicator */
+  p4est_comm_parallel_env_assign (p4est, submpicomm);
+  p4est_comm_parallel_env_duplicate (p4est);
+  mpiret = sc_MPI_Comm_free (&submpicomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_ASSERT (p4est->mpisize == submpisize);
+
+  if (p4est->mpirank == 0) {
+    P4EST_VERBOSEF ("%s: Shrink MPI communicator from %i to %i\n",
+                    this_fn_name, mpisize, submpisize);
+  }
+
+  /* compact the partition arrays communication-free */
+  p4est->global_first_quadrant = P4EST_ALLOC (p4est_gloidx_t,
+                                              submpisize + 1);
+  p4est->global_first_quadrant[0] = 0;
+  for (p = 0; p < submpisize; p++) {
+    p4est->global_first_quadrant[p + 1] =
+      active->super_gfq[include[p] + 1];
+  }
+  P4EST_ASSERT (p4est->global_first_quadrant[submpisize] ==
+                p4est->global_num_quadrants);
+  p4est->global_first_position = P4EST_ALLOC (p4est_quadrant_t,
+                                              submpisize + 1);
+  for (p = 0; p < submpisize; p++) {
+    p4est->global_first_position[p] = active->super_gfp[include[p]];
+  }
+  p4est->global_first_position[submpisize] = active->super_gfp[mpisize];
+  P4EST_FREE (include);
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+
+  return active;
+}
+
+void
+p4est_comm_parallel_env_expand (p4est_comm_active_t * active)
+{
+  p4est_t            *p4est = active->p4est;
+
+  if (active->super_gfq != NULL) {
+    /* this process was switched to the active communicator */
+    P4EST_ASSERT (active->is_active);
+
+    /* restore the original parallel environment */
+    p4est_comm_parallel_env_release (p4est);
+    P4EST_FREE (p4est->global_first_quadrant);
+    P4EST_FREE (p4est->global_first_position);
+    p4est_comm_parallel_env_assign (p4est, active->supercomm);
+    p4est->mpicomm_owned = active->super_owned;
+    P4EST_ASSERT (p4est->mpisize == active->supersize);
+    p4est->global_first_quadrant = active->super_gfq;
+    p4est->global_first_position = active->super_gfp;
+  }
+
+  /* refresh the partition arrays on the full communicator, picking up
+   * whatever adaptation happened while the forest was shrunk */
+  if (active->supersize > 1) {
+    P4EST_ASSERT (p4est->mpisize == active->supersize);
+    p4est_comm_count_quadrants (p4est);
+    p4est_comm_global_partition (p4est, NULL);
+  }
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_FREE (active);
+}
+
 void
 p4est_comm_count_quadrants (p4est_t * p4est)
 {
@@ -393,171 +529,34 @@ p4est_comm_global_partition (p4est_t * p4est, p4est_quadrant_t * first_quad)
 void
 p4est_comm_count_pertree (p4est_t * p4est, p4est_gloidx_t * pertree)
 {
-  const int           num_procs = p4est->mpisize;
-  const int           rank = p4est->mpirank;
-  const p4est_gloidx_t *gfq = p4est->global_first_quadrant;
-  const p4est_quadrant_t *gfp = p4est->global_first_position;
   const p4est_topidx_t num_trees = p4est->connectivity->num_trees;
-  int                 mpiret;
-  int                 p;
-  int                 mycount, c, addtomytree;
-  int                *treecount, *treeoffset;
   p4est_topidx_t      t;
-  p4est_locidx_t      recvbuf, sendbuf;
-  p4est_gloidx_t     *mypertree;
-  sc_MPI_Request      req_recv, req_send;
-  sc_MPI_Status       status;
   p4est_tree_t       *tree;
-#ifdef P4EST_ENABLE_DEBUG
-  const p4est_quadrant_t *q;
-#endif
-
-  /* Tip off valgrind in case input array is too small */
-  pertree[num_trees] = 0;
-
-  /*
-   * Determine which trees each rank will be counting.
-   * A tree is counted by the processor that starts on its first quadrant,
-   * even if this processor is empty.
-   */
-  treecount = P4EST_ALLOC (int, num_procs + 1);
-  treeoffset = P4EST_ALLOC (int, num_procs + 1);
-  p = 0;
-  t = 0;
-  treecount[0] = 1;
-  treeoffset[0] = 0;
-  for (;;) {
-    /* Invariant: Rank p is the first that mentions tree t in gfp[p]
-       and the ownership of t has been assigned to p or p - 1 */
-    P4EST_ASSERT (gfp[p].p.which_tree == t);
-    P4EST_ASSERT (p == 0 || gfp[p - 1].p.which_tree < t);
-    do {
-      treecount[++p] = 0;
-    }
-    while (gfp[p].p.which_tree == t);
-    /* Assign the trees before the next first quadrant */
-    P4EST_ASSERT (t < gfp[p].p.which_tree);
-    for (++t; t < gfp[p].p.which_tree; ++t) {
-      ++treecount[p - 1];
-    }
-    if (t < num_trees) {
-      P4EST_ASSERT (p < num_procs);
-      /* Check if the processor has the beginning of the tree */
-      if (gfp[p].x == 0 && gfp[p].y == 0
-#ifdef P4_TO_P8
-          && gfp[p].z == 0
-#endif
-        ) {
-        ++treecount[p];
-      }
-      else {
-        ++treecount[p - 1];
-      }
-    }
-    else {
-      while (p < num_procs) {
-        treecount[++p] = 0;
-      }
-      break;
-    }
-  }
-  P4EST_ASSERT (p == num_procs);
-  P4EST_ASSERT (t == num_trees);
-  P4EST_ASSERT (treecount[num_procs] == 0);
-  for (p = 0; p < num_procs; ++p) {
-    treeoffset[p + 1] = treeoffset[p] + treecount[p];
-  }
-  P4EST_ASSERT ((p4est_topidx_t) treeoffset[num_procs] == num_trees);
-  mycount = treecount[rank];
-#ifdef P4EST_ENABLE_DEBUG
-  P4EST_ASSERT (p4est->first_local_tree <= treeoffset[rank]);
-  P4EST_ASSERT (gfq[rank + 1] - gfq[rank] ==
-                (p4est_gloidx_t) p4est->local_num_quadrants);
-  for (c = 0; c < mycount; ++c) {
-    t = (p4est_topidx_t) (treeoffset[rank] + c);
-    P4EST_ASSERT (rank == 0 || gfp[rank - 1].p.which_tree < t);
-    if (p4est->local_num_quadrants > 0) {
-      tree = p4est_tree_array_index (p4est->trees, t);
-      q = p4est_quadrant_array_index (&tree->quadrants, 0);
-    }
-    else {
-      q = gfp + rank;
-    }
-    P4EST_ASSERT (q->x == 0 && q->y == 0);
-#ifdef P4_TO_P8
-    P4EST_ASSERT (q->z == 0);
-#endif
-  }
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
 #endif
 
-  /* Go through trees this rank is responsible for and collect information */
-  recvbuf = sendbuf = -1;
-  addtomytree = -1;
-  mypertree = P4EST_ALLOC (p4est_gloidx_t, mycount);
-  for (c = 0; c < mycount; ++c) {
-    /* Rank owns at least the first quadrant on this tree */
-    t = (p4est_topidx_t) (treeoffset[rank] + c);
-    tree = p4est_tree_array_index (p4est->trees, t);
-    mypertree[c] = (p4est_gloidx_t) tree->quadrants.elem_count;
-    if (c == mycount - 1) {
-      /* Only the last tree in the counted list may be partially owned */
-      for (p = rank + 1; p < num_procs && treecount[p] == 0; ++p) {
-        P4EST_ASSERT (p < num_procs);
-      }
-      mypertree[c] += gfq[p] - gfq[rank + 1];
-      if (gfp[p].p.which_tree == t) {
-        P4EST_ASSERT (p < num_procs);
-        /* Processor p has part of this tree too and needs to tell me */
-        mpiret = sc_MPI_Irecv (&recvbuf, 1, P4EST_MPI_LOCIDX, p,
-                               P4EST_COMM_COUNT_PERTREE, p4est->mpicomm,
-                               &req_recv);
-        SC_CHECK_MPI (mpiret);
-        addtomytree = c;
-      }
-      else {
-        P4EST_ASSERT (p <= num_procs);
-        P4EST_ASSERT (gfp[p].p.which_tree == t + 1);
-      }
-    }
-  }
-  if (mycount > 0 && (t = gfp[rank].p.which_tree) < treeoffset[rank]) {
-    /* Send information to processor that counts my first local quadrants */
-    P4EST_ASSERT (rank > 0 && p4est->first_local_tree == t);
+  /* Each process contributes the quadrant counts of its nonempty tree
+   * window; trees shared across a partition boundary sum up naturally. */
+  memset (pertree, 0, (size_t) (num_trees + 1) * sizeof (p4est_gloidx_t));
+  for (t = p4est->first_local_tree; t <= p4est->last_local_tree; ++t) {
     tree = p4est_tree_array_index (p4est->trees, t);
-    /* Always below the 32bit limit since this is processor-local data */
-    sendbuf = (p4est_locidx_t) tree->quadrants.elem_count;
-    for (p = rank - 1; treecount[p] == 0; --p) {
-      P4EST_ASSERT (p > 0);
-    }
-    mpiret = sc_MPI_Isend (&sendbuf, 1, P4EST_MPI_LOCIDX, p,
-                           P4EST_COMM_COUNT_PERTREE, p4est->mpicomm,
-                           &req_send);
-    SC_CHECK_MPI (mpiret);
+    pertree[t + 1] = (p4est_gloidx_t) tree->quadrants.elem_count;
   }
 
-  /* Complete MPI operations and cumulative count */
-  if (addtomytree >= 0) {
-    mpiret = sc_MPI_Wait (&req_recv, &status);
-    SC_CHECK_MPI (mpiret);
-    mypertree[addtomytree] += (p4est_gloidx_t) recvbuf;
-  }
-  pertree[0] = 0;
-  mpiret = sc_MPI_Allgatherv (mypertree, mycount, P4EST_MPI_GLOIDX,
-                              pertree + 1, treecount, treeoffset,
-                              P4EST_MPI_GLOIDX, p4est->mpicomm);
+#ifdef P4EST_ENABLE_MPI
+  /* one segmented reduction replaces the ownership bookkeeping */
+  mpiret = MPI_Allreduce (MPI_IN_PLACE, pertree + 1, (int) num_trees,
+                          P4EST_MPI_GLOIDX, MPI_SUM, p4est->mpicomm);
   SC_CHECK_MPI (mpiret);
-  for (c = 0; c < (int) num_trees; ++c) {
-    pertree[c + 1] += pertree[c];
-  }
-  if (sendbuf >= 0) {
-    mpiret = sc_MPI_Wait (&req_send, &status);
-    SC_CHECK_MPI (mpiret);
-  }
+#endif
 
-  /* Clean up */
-  P4EST_FREE (treecount);
-  P4EST_FREE (treeoffset);
-  P4EST_FREE (mypertree);
+  /* convert to cumulative counts */
+  pertree[0] = 0;
+  for (t = 0; t < num_trees; ++t) {
+    pertree[t + 1] += pertree[t];
+  }
+  P4EST_ASSERT (pertree[num_trees] == p4est->global_num_quadrants);
 }
 
 int
@@ -671,24 +670,82 @@ p4est_comm_is_owner (p4est_t * p4est, p4est_locidx_t which_tree,
   return 1;
 }
 
+/** Query whether (\a which_tree, \a q) sorts strictly before the partition
+ * position \a pos, that is, its owner is a lower rank than any processor
+ * whose range begins at \a pos.  Coordinate ties count as not before,
+ * matching the conventions of \ref p4est_comm_find_owner_bounded.
+ */
+static int
+p4est_comm_quadrant_before (p4est_topidx_t which_tree,
+                            const p4est_quadrant_t * q,
+                            const p4est_quadrant_t * pos)
+{
+  p4est_quadrant_t    cur;
+
+  cur.level = P4EST_QMAXLEVEL;
+  cur.x = pos->x;
+  cur.y = pos->y;
+#ifdef P4_TO_P8
+  cur.z = pos->z;
+#endif
+  return which_tree < pos->p.which_tree ||
+    (which_tree == pos->p.which_tree &&
+     (p4est_quadrant_compare (q, &cur) < 0 &&
+      (q->x != cur.x || q->y != cur.y
+#ifdef P4_TO_P8
+       || q->z != cur.z
+#endif
+      )));
+}
+
+/** Query whether (\a which_tree, \a q) sorts at or after the partition
+ * position \a pos, that is, its owner is at least the rank whose range
+ * begins at \a pos.
+ */
+static int
+p4est_comm_quadrant_reaches (p4est_topidx_t which_tree,
+                             const p4est_quadrant_t * q,
+                             const p4est_quadrant_t * pos)
+{
+  p4est_quadrant_t    cur;
+
+  cur.level = P4EST_QMAXLEVEL;
+  cur.x = pos->x;
+  cur.y = pos->y;
+#ifdef P4_TO_P8
+  cur.z = pos->z;
+#endif
+  return which_tree > pos->p.which_tree ||
+    (which_tree == pos->p.which_tree &&
+     (p4est_quadrant_compare (&cur, q) <= 0 ||
+      (q->x == cur.x && q->y == cur.y
+#ifdef P4_TO_P8
+       && q->z == cur.z
+#endif
+      )));
+}
+
 int
 p4est_comm_find_owner (p4est_t * p4est, p4est_locidx_t which_tree,
                        const p4est_quadrant_t * q, int guess)
+{
+  return p4est_comm_find_owner_bounded (p4est, which_tree, q,
+                                        0, p4est->mpisize - 1, guess);
+}
+
+int
+p4est_comm_find_owner_bounded (p4est_t * p4est, p4est_locidx_t which_tree,
+                               const p4est_quadrant_t * q,
+                               int proc_low, int proc_high, int guess)
 {
   const int           num_procs = p4est->mpisize;
   const p4est_quadrant_t *global_first_position =
     p4est->global_first_position;
-  int                 proc_low, proc_high;
-  p4est_topidx_t      ctree;
-  p4est_quadrant_t    cur;
 
   P4EST_ASSERT (0 <= which_tree &&
                 which_tree < p4est->connectivity->num_trees);
   P4EST_ASSERT (p4est_quadrant_is_node (q, 1) || p4est_quadrant_is_valid (q));
-
-  proc_low = 0;
-  proc_high = num_procs - 1;
-  cur.level = P4EST_QMAXLEVEL;
+  P4EST_ASSERT (0 <= proc_low && proc_high < num_procs);
 
   for (;;) {
     P4EST_ASSERT (proc_low <= proc_high);
@@ -697,40 +754,16 @@ p4est_comm_find_owner (p4est_t * p4est, p4est_locidx_t which_tree,
     P4EST_ASSERT (proc_low <= guess && guess <= proc_high);
 
     /* check if q is on a lower processor than guess */
-    ctree = global_first_position[guess].p.which_tree;
-    cur.x = global_first_position[guess].x;
-    cur.y = global_first_position[guess].y;
-#ifdef P4_TO_P8
-    cur.z = global_first_position[guess].z;
-#endif
-    if (which_tree < ctree ||
-        (which_tree == ctree &&
-         (p4est_quadrant_compare (q, &cur) < 0 &&
-          (q->x != cur.x || q->y != cur.y
-#ifdef P4_TO_P8
-           || q->z != cur.z
-#endif
-          )))) {
+    if (p4est_comm_quadrant_before (which_tree, q,
+                                    &global_first_position[guess])) {
       proc_high = guess - 1;
       guess = (proc_low + proc_high + 1) / 2;
       continue;
     }
 
     /* check if q is on a higher processor than guess */
-    ctree = global_first_position[guess + 1].p.which_tree;
-    cur.x = global_first_position[guess + 1].x;
-    cur.y = global_first_position[guess + 1].y;
-#ifdef P4_TO_P8
-    cur.z = global_first_position[guess + 1].z;
-#endif
-    if (which_tree > ctree ||
-        (which_tree == ctree &&
-         (p4est_quadrant_compare (&cur, q) <= 0 ||
-          (q->x == cur.x && q->y == cur.y
-#ifdef P4_TO_P8
-           && q->z == cur.z
-#endif
-          )))) {
+    if (p4est_comm_quadrant_reaches (which_tree, q,
+                                     &global_first_position[guess + 1])) {
       proc_low = guess + 1;
       guess = (proc_low + proc_high) / 2;
       continue;
@@ -748,6 +781,666 @@ p4est_comm_find_owner (p4est_t * p4est, p4est_locidx_t which_tree,
   return guess;
 }
 
+int
+p4est_comm_find_owner_interpolate (p4est_t * p4est, p4est_locidx_t which_tree,
+                                   const p4est_quadrant_t * q, int seed)
+{
+  const int           num_procs = p4est->mpisize;
+  const p4est_quadrant_t *global_first_position =
+    p4est->global_first_position;
+  int                 proc_low, proc_high, guess, step;
+  p4est_topidx_t      tree_low, tree_high;
+
+  P4EST_ASSERT (0 <= which_tree &&
+                which_tree < p4est->connectivity->num_trees);
+  P4EST_ASSERT (p4est_quadrant_is_node (q, 1) || p4est_quadrant_is_valid (q));
+  P4EST_ASSERT (0 <= seed && seed < num_procs);
+
+  /* gallop away from the seed to bracket the owner */
+  step = 1;
+  proc_low = proc_high = seed;
+  while (proc_low > 0 &&
+         p4est_comm_quadrant_before (which_tree, q,
+                                     &global_first_position[proc_low])) {
+    proc_high = proc_low - 1;
+    proc_low = SC_MAX (proc_low - step, 0);
+    step *= 2;
+  }
+  if (proc_high == seed) {
+    step = 1;
+    while (proc_high < num_procs - 1 &&
+           p4est_comm_quadrant_reaches (which_tree, q,
+                                        &global_first_position[proc_high +
+                                                               1])) {
+      proc_low = proc_high + 1;
+      proc_high = SC_MIN (proc_high + step, num_procs - 1);
+      step *= 2;
+    }
+  }
+
+  /* narrow the bracket by interpolating on the first tree index */
+  while (proc_low < proc_high) {
+    tree_low = global_first_position[proc_low].p.which_tree;
+    tree_high = global_first_position[proc_high + 1].p.which_tree;
+    if (tree_low < tree_high) {
+      guess = proc_low + (int)
+        (((double) (which_tree - tree_low) /
+          (double) (tree_high - tree_low)) * (double) (proc_high - proc_low));
+    }
+    else {
+      /* the bracket lies within one tree: bisect instead */
+      guess = (proc_low + proc_high) / 2;
+    }
+    P4EST_ASSERT (proc_low <= guess && guess <= proc_high);
+
+    if (p4est_comm_quadrant_reaches (which_tree, q,
+                                     &global_first_position[guess + 1])) {
+      proc_low = guess + 1;
+    }
+    else if (p4est_comm_quadrant_before (which_tree, q,
+                                         &global_first_position[guess])) {
+      proc_high = guess - 1;
+    }
+    else {
+      proc_low = proc_high = guess;
+    }
+  }
+  guess = proc_low;
+
+  /* make sure we found a valid processor with nonzero quadrant count */
+  P4EST_ASSERT (0 <= guess && guess < num_procs);
+  P4EST_ASSERT (memcmp (&global_first_position[guess],
+                        &global_first_position[guess + 1],
+                        sizeof (p4est_quadrant_t)) != 0);
+  return guess;
+}
+
+void
+p4est_comm_find_owner_batch (p4est_t * p4est, sc_array_t * queries,
+                             int *owners)
+{
+  const size_t        count = queries->elem_count;
+  size_t              zz;
+  int                 guess;
+  sc_array_t         *sorted;
+  p4est_quadrant_t   *q, *s;
+
+  P4EST_ASSERT (queries->elem_size == sizeof (p4est_quadrant_t));
+  P4EST_ASSERT (owners != NULL || count == 0);
+
+  if (count == 0) {
+    return;
+  }
+
+  /* sort a copy of the queries by tree and Morton index so the
+   * partition boundaries are visited monotonically */
+  sorted = sc_array_new_count (sizeof (p4est_quadrant_t), count);
+  for (zz = 0; zz < count; ++zz) {
+    q = p4est_quadrant_array_index (queries, zz);
+    s = p4est_quadrant_array_index (sorted, zz);
+    *s = *q;
+    s->p.piggy3.local_num = (p4est_locidx_t) zz;
+  }
+  sc_array_sort (sorted, p4est_quadrant_compare_piggy);
+
+  /* each search is seeded with the previous owner, which is never
+   * overshot by more than the local query spacing */
+  guess = p4est->mpirank;
+  for (zz = 0; zz < count; ++zz) {
+    s = p4est_quadrant_array_index (sorted, zz);
+    guess = p4est_comm_find_owner_interpolate (p4est,
+                                               s->p.piggy3.which_tree,
+                                               s, guess);
+    owners[s->p.piggy3.local_num] = guess;
+  }
+  sc_array_destroy (sorted);
+}
+
+p4est_comm_partition_dir_t *
+p4est_comm_partition_dir_new (p4est_t * p4est, int stride)
+{
+  const int           num_procs = p4est->mpisize;
+  int                 k;
+  p4est_comm_partition_dir_t *dir;
+
+  P4EST_ASSERT (p4est->global_first_position != NULL);
+  P4EST_ASSERT (stride >= 0);
+
+  if (stride == 0) {
+    /* balance the sample search against the refinement window */
+    stride = 1;
+    while (stride * stride < num_procs) {
+      stride <<= 1;
+    }
+  }
+
+  dir = P4EST_ALLOC (p4est_comm_partition_dir_t, 1);
+  dir->mpisize = num_procs;
+  dir->stride = stride;
+  dir->num_samples = (num_procs + stride - 1) / stride + 1;
+  dir->samples = P4EST_ALLOC (p4est_quadrant_t, dir->num_samples);
+
+  /* copy every stride-th boundary and always the closing one */
+  for (k = 0; k < dir->num_samples - 1; ++k) {
+    dir->samples[k] = p4est->global_first_position[k * stride];
+  }
+  dir->samples[dir->num_samples - 1] =
+    p4est->global_first_position[num_procs];
+
+  return dir;
+}
+
+void
+p4est_comm_partition_dir_destroy (p4est_comm_partition_dir_t * dir)
+{
+  P4EST_FREE (dir->samples);
+  P4EST_FREE (dir);
+}
+
+int
+p4est_comm_partition_dir_find_owner (p4est_t * p4est,
+                                     p4est_comm_partition_dir_t * dir,
+                                     p4est_locidx_t which_tree,
+                                     const p4est_quadrant_t * q)
+{
+  int                 k_low, k_high, k;
+  int                 proc_low, proc_high;
+  int                 comp;
+  p4est_quadrant_t    cur;
+
+  P4EST_ASSERT (dir != NULL && dir->mpisize == p4est->mpisize);
+  P4EST_ASSERT (p4est_quadrant_is_node (q, 1) || p4est_quadrant_is_valid (q));
+
+  /* binary search in the compact sample array for the last sample
+   * that is less equal q; touches only the small hot directory */
+  cur.level = P4EST_QMAXLEVEL;
+  k_low = 0;
+  k_high = dir->num_samples - 2;
+  while (k_low < k_high) {
+    k = (k_low + k_high + 1) / 2;
+    cur.x = dir->samples[k].x;
+    cur.y = dir->samples[k].y;
+#ifdef P4_TO_P8
+    cur.z = dir->samples[k].z;
+#endif
+    if (which_tree < dir->samples[k].p.which_tree) {
+      comp = -1;
+    }
+    else if (which_tree > dir->samples[k].p.which_tree) {
+      comp = 1;
+    }
+    else {
+      comp = (q->x == cur.x && q->y == cur.y
+#ifdef P4_TO_P8
+              && q->z == cur.z
+#endif
+        ) ? 1 : p4est_quadrant_compare (q, &cur);
+    }
+    if (comp < 0) {
+      k_high = k - 1;
+    }
+    else {
+      k_low = k;
+    }
+  }
+
+  /* refine on demand into a window of at most stride processors */
+  proc_low = k_low * dir->stride;
+  proc_high = SC_MIN ((k_low + 1) * dir->stride, dir->mpisize) - 1;
+  return p4est_comm_find_owner_bounded (p4est, which_tree, q,
+                                        proc_low, proc_high,
+                                        (proc_low + proc_high) / 2);
+}
+
+p4est_data_vector_t *
+p4est_data_vector_new (p4est_t * p4est, size_t data_size)
+{
+  p4est_data_vector_t *dvec;
+
+  dvec = P4EST_ALLOC (p4est_data_vector_t, 1);
+  dvec->data_size = data_size;
+  dvec->mpisize = p4est->mpisize;
+  dvec->num_quadrants = p4est->local_num_quadrants;
+  dvec->src_gfq = P4EST_ALLOC (p4est_gloidx_t, p4est->mpisize + 1);
+  memcpy (dvec->src_gfq, p4est->global_first_quadrant,
+          (p4est->mpisize + 1) * sizeof (p4est_gloidx_t));
+  dvec->data = P4EST_ALLOC (char, (size_t) dvec->num_quadrants * data_size);
+
+  return dvec;
+}
+
+void               *
+p4est_data_vector_index (p4est_data_vector_t * dvec, p4est_locidx_t li)
+{
+  P4EST_ASSERT (0 <= li && li < dvec->num_quadrants);
+
+  return (void *) (dvec->data + (size_t) li * dvec->data_size);
+}
+
+void
+p4est_data_vector_link (p4est_t * p4est, p4est_data_vector_t * dvec)
+{
+  size_t              zz;
+  p4est_topidx_t      jt;
+  p4est_locidx_t      li;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+
+  /* the quadrants' user data must not be owned by the memory pool */
+  P4EST_ASSERT (p4est->data_size == 0);
+  P4EST_ASSERT (dvec->num_quadrants == p4est->local_num_quadrants);
+
+  li = 0;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    P4EST_ASSERT (tree->quadrants_offset == li);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      q->p.user_data = (void *) (dvec->data + (size_t) li * dvec->data_size);
+      ++li;
+    }
+  }
+  P4EST_ASSERT (li == p4est->local_num_quadrants);
+}
+
+/** Searches the lowest rank whose range of quadrants reaches beyond \a g. */
+static int
+p4est_data_vector_first_overlap (const p4est_gloidx_t * gfq, int num_procs,
+                                 p4est_gloidx_t g)
+{
+  int                 proc_low, proc_high, guess;
+
+  proc_low = 0;
+  proc_high = num_procs - 1;
+  while (proc_low < proc_high) {
+    guess = (proc_low + proc_high) / 2;
+    if (gfq[guess + 1] <= g) {
+      proc_low = guess + 1;
+    }
+    else {
+      proc_high = guess;
+    }
+  }
+  return proc_low;
+}
+
+void
+p4est_data_vector_partition (p4est_t * p4est, p4est_data_vector_t * dvec)
+{
+  const int           num_procs = p4est->mpisize;
+  const int           rank = p4est->mpirank;
+  const size_t        data_size = dvec->data_size;
+  const p4est_gloidx_t *dest_gfq = p4est->global_first_quadrant;
+  int                 mpiret;
+  int                 q;
+  int                 num_requests;
+  char               *new_data;
+  p4est_gloidx_t      gbegin, gend;
+  sc_MPI_Request     *requests, *r;
+
+  P4EST_ASSERT (dvec->mpisize == num_procs);
+  P4EST_ASSERT (dvec->src_gfq[num_procs] == dest_gfq[num_procs]);
+  P4EST_ASSERT (dvec->src_gfq[rank + 1] - dvec->src_gfq[rank] ==
+                (p4est_gloidx_t) dvec->num_quadrants);
+
+  new_data = P4EST_ALLOC (char, (size_t) p4est->local_num_quadrants *
+                          data_size);
+
+  /* count the messages to allocate the requests in one block */
+  num_requests = 0;
+  if (dest_gfq[rank] < dest_gfq[rank + 1]) {
+    for (q = p4est_data_vector_first_overlap (dvec->src_gfq, num_procs,
+                                              dest_gfq[rank]);
+         q < num_procs && dvec->src_gfq[q] < dest_gfq[rank + 1]; ++q) {
+      num_requests += (q != rank && dvec->src_gfq[q] < dvec->src_gfq[q + 1]);
+    }
+  }
+  if (dvec->src_gfq[rank] < dvec->src_gfq[rank + 1]) {
+    for (q = p4est_data_vector_first_overlap (dest_gfq, num_procs,
+                                              dvec->src_gfq[rank]);
+         q < num_procs && dest_gfq[q] < dvec->src_gfq[rank + 1]; ++q) {
+      num_requests += (q != rank && dest_gfq[q] < dest_gfq[q + 1]);
+    }
+  }
+  r = requests = P4EST_ALLOC (sc_MPI_Request, num_requests);
+
+  /* receive each piece of the new local range from its previous owner */
+  if (dest_gfq[rank] < dest_gfq[rank + 1]) {
+    for (q = p4est_data_vector_first_overlap (dvec->src_gfq, num_procs,
+                                              dest_gfq[rank]);
+         q < num_procs && dvec->src_gfq[q] < dest_gfq[rank + 1]; ++q) {
+      gbegin = SC_MAX (dvec->src_gfq[q], dest_gfq[rank]);
+      gend = SC_MIN (dvec->src_gfq[q + 1], dest_gfq[rank + 1]);
+      if (gbegin >= gend) {
+        continue;
+      }
+      if (q == rank) {
+        /* the overlap with the previous local range is copied directly */
+        memcpy (new_data + (size_t) (gbegin - dest_gfq[rank]) * data_size,
+                dvec->data + (size_t) (gbegin - dvec->src_gfq[rank]) *
+                data_size, (size_t) (gend - gbegin) * data_size);
+        continue;
+      }
+      mpiret = sc_MPI_Irecv (new_data + (size_t) (gbegin - dest_gfq[rank]) *
+                             data_size, (size_t) (gend - gbegin) * data_size,
+                             sc_MPI_BYTE, q, P4EST_COMM_DATA_VECTOR,
+                             p4est->mpicomm, r++);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+
+  /* send each piece of the previous local range to its new owner */
+  if (dvec->src_gfq[rank] < dvec->src_gfq[rank + 1]) {
+    for (q = p4est_data_vector_first_overlap (dest_gfq, num_procs,
+                                              dvec->src_gfq[rank]);
+         q < num_procs && dest_gfq[q] < dvec->src_gfq[rank + 1]; ++q) {
+      gbegin = SC_MAX (dest_gfq[q], dvec->src_gfq[rank]);
+      gend = SC_MIN (dest_gfq[q + 1], dvec->src_gfq[rank + 1]);
+      if (gbegin >= gend || q == rank) {
+        continue;
+      }
+      mpiret = sc_MPI_Isend (dvec->data + (size_t)
+                             (gbegin - dvec->src_gfq[rank]) * data_size,
+                             (size_t) (gend - gbegin) * data_size,
+                             sc_MPI_BYTE, q, P4EST_COMM_DATA_VECTOR,
+                             p4est->mpicomm, r++);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+  P4EST_ASSERT (r == requests + num_requests);
+
+  mpiret = sc_MPI_Waitall (num_requests, requests, sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (requests);
+
+  /* install the new layout and remember the partition it matches */
+  P4EST_FREE (dvec->data);
+  dvec->data = new_data;
+  dvec->num_quadrants = p4est->local_num_quadrants;
+  memcpy (dvec->src_gfq, dest_gfq, (num_procs + 1) *
+          sizeof (p4est_gloidx_t));
+}
+
+void
+p4est_data_vector_destroy (p4est_data_vector_t * dvec)
+{
+  P4EST_FREE (dvec->src_gfq);
+  P4EST_FREE (dvec->data);
+  P4EST_FREE (dvec);
+}
+
+p4est_transfer_context_t *
+p4est_transfer_fixed_begin (const p4est_gloidx_t * dest_gfq,
+                            const p4est_gloidx_t * src_gfq,
+                            sc_MPI_Comm mpicomm, void *dest_data,
+                            const void *src_data, size_t data_size)
+{
+  int                 mpiret;
+  int                 num_procs, rank;
+  int                 q;
+  int                 num_requests;
+  p4est_gloidx_t      gbegin, gend;
+  p4est_transfer_context_t *tc;
+  sc_MPI_Request     *r;
+
+  mpiret = sc_MPI_Comm_size (mpicomm, &num_procs);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
+
+  P4EST_ASSERT (dest_gfq != NULL && src_gfq != NULL);
+  P4EST_ASSERT (dest_gfq[0] == 0 && src_gfq[0] == 0);
+  P4EST_ASSERT (dest_gfq[num_procs] == src_gfq[num_procs]);
+
+  tc = P4EST_ALLOC_ZERO (p4est_transfer_context_t, 1);
+  if (data_size == 0) {
+    /* the completion call only cleans up */
+    return tc;
+  }
+
+  /* count the messages to allocate the requests in one block */
+  num_requests = 0;
+  if (dest_gfq[rank] < dest_gfq[rank + 1]) {
+    for (q = p4est_data_vector_first_overlap (src_gfq, num_procs,
+                                              dest_gfq[rank]);
+         q < num_procs && src_gfq[q] < dest_gfq[rank + 1]; ++q) {
+      num_requests += (q != rank && src_gfq[q] < src_gfq[q + 1]);
+    }
+  }
+  if (src_gfq[rank] < src_gfq[rank + 1]) {
+    for (q = p4est_data_vector_first_overlap (dest_gfq, num_procs,
+                                              src_gfq[rank]);
+         q < num_procs && dest_gfq[q] < src_gfq[rank + 1]; ++q) {
+      num_requests += (q != rank && dest_gfq[q] < dest_gfq[q + 1]);
+    }
+  }
+  tc->num_requests = num_requests;
+  r = tc->requests = P4EST_ALLOC (sc_MPI_Request, num_requests);
+
+  /* receive each piece of the new local range from its previous owner */
+  if (dest_gfq[rank] < dest_gfq[rank + 1]) {
+    for (q = p4est_data_vector_first_overlap (src_gfq, num_procs,
+                                              dest_gfq[rank]);
+         q < num_procs && src_gfq[q] < dest_gfq[rank + 1]; ++q) {
+      gbegin = SC_MAX (src_gfq[q], dest_gfq[rank]);
+      gend = SC_MIN (src_gfq[q + 1], dest_gfq[rank + 1]);
+      if (gbegin >= gend) {
+        continue;
+      }
+      if (q == rank) {
+        /* the overlap with the previous local range is copied directly */
+        memcpy ((char *) dest_data +
+                (size_t) (gbegin - dest_gfq[rank]) * data_size,
+                (const char *) src_data +
+                (size_t) (gbegin - src_gfq[rank]) * data_size,
+                (size_t) (gend - gbegin) * data_size);
+        continue;
+      }
+      mpiret = sc_MPI_Irecv ((char *) dest_data +
+                             (size_t) (gbegin - dest_gfq[rank]) * data_size,
+                             (size_t) (gend - gbegin) * data_size,
+                             sc_MPI_BYTE, q, P4EST_COMM_TRANSFER_FIXED,
+                             mpicomm, r++);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+
+  /* send each piece of the previous local range to its new owner */
+  if (src_gfq[rank] < src_gfq[rank + 1]) {
+    for (q = p4est_data_vector_first_overlap (dest_gfq, num_procs,
+                                              src_gfq[rank]);
+         q < num_procs && dest_gfq[q] < src_gfq[rank + 1]; ++q) {
+      gbegin = SC_MAX (dest_gfq[q], src_gfq[rank]);
+      gend = SC_MIN (dest_gfq[q + 1], src_gfq[rank + 1]);
+      if (gbegin >= gend || q == rank) {
+        continue;
+      }
+      mpiret = sc_MPI_Isend ((const char *) src_data +
+                             (size_t) (gbegin - src_gfq[rank]) * data_size,
+                             (size_t) (gend - gbegin) * data_size,
+                             sc_MPI_BYTE, q, P4EST_COMM_TRANSFER_FIXED,
+                             mpicomm, r++);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+  P4EST_ASSERT (r == tc->requests + num_requests);
+
+  return tc;
+}
+
+void
+p4est_transfer_fixed_end (p4est_transfer_context_t * tc)
+{
+  int                 mpiret;
+
+  P4EST_ASSERT (tc != NULL && !tc->variable);
+
+  mpiret = sc_MPI_Waitall (tc->num_requests, tc->requests,
+                           sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (tc->requests);
+  P4EST_FREE (tc);
+}
+
+void
+p4est_transfer_fixed (const p4est_gloidx_t * dest_gfq,
+                      const p4est_gloidx_t * src_gfq,
+                      sc_MPI_Comm mpicomm, void *dest_data,
+                      const void *src_data, size_t data_size)
+{
+  p4est_transfer_fixed_end (p4est_transfer_fixed_begin
+                            (dest_gfq, src_gfq, mpicomm,
+                             dest_data, src_data, data_size));
+}
+
+p4est_transfer_context_t *
+p4est_transfer_custom_begin (const p4est_gloidx_t * dest_gfq,
+                             const p4est_gloidx_t * src_gfq,
+                             sc_MPI_Comm mpicomm,
+                             void *dest_data, const int *dest_sizes,
+                             const void *src_data, const int *src_sizes)
+{
+  int                 mpiret;
+  int                 num_procs, rank;
+  int                 q;
+  int                 num_requests;
+  size_t              zoffset, zbytes, zself;
+  p4est_gloidx_t      gbegin, gend, g;
+  p4est_transfer_context_t *tc;
+  sc_MPI_Request     *r;
+
+  mpiret = sc_MPI_Comm_size (mpicomm, &num_procs);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
+
+  P4EST_ASSERT (dest_gfq != NULL && src_gfq != NULL);
+  P4EST_ASSERT (dest_gfq[0] == 0 && src_gfq[0] == 0);
+  P4EST_ASSERT (dest_gfq[num_procs] == src_gfq[num_procs]);
+
+  tc = P4EST_ALLOC_ZERO (p4est_transfer_context_t, 1);
+  tc->variable = 1;
+
+  /* count the messages to allocate the requests in one block */
+  num_requests = 0;
+  if (dest_gfq[rank] < dest_gfq[rank + 1]) {
+    for (q = p4est_data_vector_first_overlap (src_gfq, num_procs,
+                                              dest_gfq[rank]);
+         q < num_procs && src_gfq[q] < dest_gfq[rank + 1]; ++q) {
+      num_requests += (q != rank && src_gfq[q] < src_gfq[q + 1]);
+    }
+  }
+  if (src_gfq[rank] < src_gfq[rank + 1]) {
+    for (q = p4est_data_vector_first_overlap (dest_gfq, num_procs,
+                                              src_gfq[rank]);
+         q < num_procs && dest_gfq[q] < src_gfq[rank + 1]; ++q) {
+      num_requests += (q != rank && dest_gfq[q] < dest_gfq[q + 1]);
+    }
+  }
+  tc->num_requests = num_requests;
+  r = tc->requests = P4EST_ALLOC (sc_MPI_Request, num_requests);
+
+  /* receive each piece of the new local range from its previous owner;
+   * the segments tile the local range, so a running byte offset over
+   * the per-quadrant sizes replaces an explicit prefix sum array */
+  if (dest_gfq[rank] < dest_gfq[rank + 1]) {
+    zoffset = 0;
+    for (q = p4est_data_vector_first_overlap (src_gfq, num_procs,
+                                              dest_gfq[rank]);
+         q < num_procs && src_gfq[q] < dest_gfq[rank + 1]; ++q) {
+      gbegin = SC_MAX (src_gfq[q], dest_gfq[rank]);
+      gend = SC_MIN (src_gfq[q + 1], dest_gfq[rank + 1]);
+      if (gbegin >= gend) {
+        continue;
+      }
+      zbytes = 0;
+      for (g = gbegin; g < gend; ++g) {
+        P4EST_ASSERT (dest_sizes[g - dest_gfq[rank]] >= 0);
+        zbytes += (size_t) dest_sizes[g - dest_gfq[rank]];
+      }
+      if (q == rank) {
+        /* the overlap with the previous local range is copied directly */
+        zself = 0;
+        for (g = src_gfq[rank]; g < gbegin; ++g) {
+          zself += (size_t) src_sizes[g - src_gfq[rank]];
+        }
+        memcpy ((char *) dest_data + zoffset,
+                (const char *) src_data + zself, zbytes);
+      }
+      else if (zbytes > 0) {
+        mpiret = sc_MPI_Irecv ((char *) dest_data + zoffset, zbytes,
+                               sc_MPI_BYTE, q, P4EST_COMM_TRANSFER_CUSTOM,
+                               mpicomm, r++);
+        SC_CHECK_MPI (mpiret);
+      }
+      else {
+        *r++ = sc_MPI_REQUEST_NULL;
+      }
+      zoffset += zbytes;
+    }
+  }
+
+  /* send each piece of the previous local range to its new owner */
+  if (src_gfq[rank] < src_gfq[rank + 1]) {
+    zoffset = 0;
+    for (q = p4est_data_vector_first_overlap (dest_gfq, num_procs,
+                                              src_gfq[rank]);
+         q < num_procs && dest_gfq[q] < src_gfq[rank + 1]; ++q) {
+      gbegin = SC_MAX (dest_gfq[q], src_gfq[rank]);
+      gend = SC_MIN (dest_gfq[q + 1], src_gfq[rank + 1]);
+      if (gbegin >= gend) {
+        continue;
+      }
+      zbytes = 0;
+      for (g = gbegin; g < gend; ++g) {
+        P4EST_ASSERT (src_sizes[g - src_gfq[rank]] >= 0);
+        zbytes += (size_t) src_sizes[g - src_gfq[rank]];
+      }
+      if (q != rank) {
+        if (zbytes > 0) {
+          mpiret = sc_MPI_Isend ((const char *) src_data + zoffset, zbytes,
+                                 sc_MPI_BYTE, q, P4EST_COMM_TRANSFER_CUSTOM,
+                                 mpicomm, r++);
+          SC_CHECK_MPI (mpiret);
+        }
+        else {
+          *r++ = sc_MPI_REQUEST_NULL;
+        }
+      }
+      zoffset += zbytes;
+    }
+  }
+  P4EST_ASSERT (r == tc->requests + num_requests);
+
+  return tc;
+}
+
+void
+p4est_transfer_custom_end (p4est_transfer_context_t * tc)
+{
+  int                 mpiret;
+
+  P4EST_ASSERT (tc != NULL && tc->variable);
+
+  mpiret = sc_MPI_Waitall (tc->num_requests, tc->requests,
+                           sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (tc->requests);
+  P4EST_FREE (tc);
+}
+
+void
+p4est_transfer_custom (const p4est_gloidx_t * dest_gfq,
+                       const p4est_gloidx_t * src_gfq,
+                       sc_MPI_Comm mpicomm,
+                       void *dest_data, const int *dest_sizes,
+                       const void *src_data, const int *src_sizes)
+{
+  p4est_transfer_custom_end (p4est_transfer_custom_begin
+                             (dest_gfq, src_gfq, mpicomm, dest_data,
+                              dest_sizes, src_data, src_sizes));
+}
+
 void
 p4est_comm_tree_info (p4est_t * p4est, p4est_locidx_t which_tree,
                       int full_tree[], int tree_contact[],
@@ -875,6 +1568,31 @@ p4est_comm_sync_flag (p4est_t * p4est, int flag, sc_MPI_Op operation)
   return (int) gbyte;
 }
 
+#if defined P4EST_HAVE_ZLIB && defined P4EST_ENABLE_MPI
+
+/** Combine two partial adler32 checksums; see MPI_Op_create.
+ * Each element is a pair of the checksum and the number of bytes it
+ * covers.  The operation appends the higher rank's byte range to the
+ * lower rank's, so it is associative but not commutative.
+ */
+static void
+p4est_comm_checksum_combine (void *invec, void *inoutvec, int *len,
+                             MPI_Datatype * datatype)
+{
+  int                 i;
+  uint64_t           *in = (uint64_t *) invec;
+  uint64_t           *inout = (uint64_t *) inoutvec;
+
+  for (i = 0; i < *len; ++i) {
+    inout[2 * i + 0] = (uint64_t)
+      adler32_combine ((uLong) in[2 * i + 0], (uLong) inout[2 * i + 0],
+                       (z_off_t) inout[2 * i + 1]);
+    inout[2 * i + 1] += in[2 * i + 1];
+  }
+}
+
+#endif /* P4EST_HAVE_ZLIB && P4EST_ENABLE_MPI */
+
 unsigned
 p4est_comm_checksum (p4est_t * p4est, unsigned local_crc, size_t local_bytes)
 {
@@ -883,30 +1601,32 @@ p4est_comm_checksum (p4est_t * p4est, unsigned local_crc, size_t local_bytes)
 
 #ifdef P4EST_ENABLE_MPI
   int                 mpiret;
-  int                 p;
   uint64_t            send[2];
-  uint64_t           *gather;
+  uint64_t            recv[2];
+  MPI_Datatype        ctype;
+  MPI_Op              cop;
 
   send[0] = (uint64_t) local_crc;
   send[1] = (uint64_t) local_bytes;
-  gather = NULL;
-  if (p4est->mpirank == 0) {
-    gather = P4EST_ALLOC (uint64_t, 2 * p4est->mpisize);
-  }
-  mpiret = sc_MPI_Gather (send, 2, sc_MPI_LONG_LONG_INT,
-                          gather, 2, sc_MPI_LONG_LONG_INT, 0, p4est->mpicomm);
+
+  /* combine the partial checksums over the library's reduction tree
+   * instead of gathering them all to one rank for serial combination */
+  mpiret = MPI_Type_contiguous (2, MPI_LONG_LONG_INT, &ctype);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Type_commit (&ctype);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Op_create (p4est_comm_checksum_combine, 0, &cop);
   SC_CHECK_MPI (mpiret);
 
-  if (p4est->mpirank == 0) {
-    for (p = 1; p < p4est->mpisize; ++p) {
-      crc = adler32_combine (crc, (uLong) gather[2 * p + 0],
-                             (z_off_t) gather[2 * p + 1]);
-    }
-    P4EST_FREE (gather);
-  }
-  else {
-    crc = 0;
-  }
+  mpiret = MPI_Reduce (send, recv, 1, ctype, cop, 0, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  mpiret = MPI_Op_free (&cop);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Type_free (&ctype);
+  SC_CHECK_MPI (mpiret);
+
+  crc = (p4est->mpirank == 0) ? (uLong) recv[0] : 0;
 #endif /* P4EST_ENABLE_MPI */
 
   return (unsigned) crc;
@@ -917,3 +1637,282 @@ p4est_comm_checksum (p4est_t * p4est, unsigned local_crc, size_t local_bytes)
   return 0;
 #endif /* !P4EST_HAVE_ZLIB */
 }
+
+#if defined P4EST_ENABLE_MPI && defined MPI_VERSION && MPI_VERSION >= 3
+#define P4EST_COMM_WINRMA
+#endif
+
+/** State of the remote query service; see \ref p4est_remote_open. */
+struct p4est_remote
+{
+  p4est_t            *p4est;    /**< the forest being served */
+  size_t              data_size;        /**< bytes per quadrant payload */
+  p4est_quadrant_t   *quads;    /**< own leaves packed in Morton order
+                                     with their tree and local number in
+                                     piggy3, or all leaves of the forest
+                                     when RMA windows are unavailable */
+  char               *data;     /**< payload snapshot matching quads */
+#ifdef P4EST_COMM_WINRMA
+  MPI_Win             win_quads;        /**< window over quads */
+  MPI_Win             win_data; /**< window over data if the forest
+                                     carries payload */
+#endif
+};
+
+/** Pack the local leaves and their payload into contiguous buffers. */
+static void
+p4est_remote_pack (p4est_t * p4est, p4est_quadrant_t * quads, char *data)
+{
+  const size_t        data_size = p4est->data_size;
+  size_t              zz;
+  p4est_locidx_t      il;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, *pq;
+
+  il = 0;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      pq = quads + il;
+      *pq = *q;
+      pq->p.piggy3.which_tree = jt;
+      pq->p.piggy3.local_num = il;
+      if (data_size > 0) {
+        memcpy (data + (size_t) il * data_size, q->p.user_data, data_size);
+      }
+      ++il;
+    }
+  }
+  P4EST_ASSERT (il == p4est->local_num_quadrants);
+}
+
+p4est_remote_t     *
+p4est_remote_open (p4est_t * p4est)
+{
+  const size_t        qbytes = sizeof (p4est_quadrant_t);
+  size_t              data_size;
+  p4est_locidx_t      lnq;
+  p4est_remote_t     *remote;
+#ifdef P4EST_COMM_WINRMA
+  int                 mpiret;
+#else
+  int                 mpiret;
+  int                 p;
+  int                *counts, *offsets;
+  p4est_quadrant_t   *own;
+  char               *owndata;
+#endif
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+
+  remote = P4EST_ALLOC (p4est_remote_t, 1);
+  remote->p4est = p4est;
+  remote->data_size = data_size = p4est->data_size;
+  lnq = p4est->local_num_quadrants;
+
+#ifdef P4EST_COMM_WINRMA
+  /* expose the packed local leaves and payload for one-sided access */
+  remote->quads = P4EST_ALLOC (p4est_quadrant_t, (size_t) lnq);
+  remote->data = data_size > 0 ?
+    P4EST_ALLOC (char, (size_t) lnq * data_size) : NULL;
+  p4est_remote_pack (p4est, remote->quads, remote->data);
+  mpiret = MPI_Win_create (remote->quads,
+                           (MPI_Aint) ((size_t) lnq * qbytes), 1,
+                           MPI_INFO_NULL, p4est->mpicomm,
+                           &remote->win_quads);
+  SC_CHECK_MPI (mpiret);
+  if (data_size > 0) {
+    mpiret = MPI_Win_create (remote->data,
+                             (MPI_Aint) ((size_t) lnq * data_size), 1,
+                             MPI_INFO_NULL, p4est->mpicomm,
+                             &remote->win_data);
+    SC_CHECK_MPI (mpiret);
+  }
+#else
+  /* without RMA windows remote leaves cannot be fetched on demand, so
+   * every process keeps all of them to preserve the query semantics */
+  own = P4EST_ALLOC (p4est_quadrant_t, (size_t) lnq);
+  owndata = data_size > 0 ?
+    P4EST_ALLOC (char, (size_t) lnq * data_size) : NULL;
+  p4est_remote_pack (p4est, own, owndata);
+  remote->quads = P4EST_ALLOC (p4est_quadrant_t,
+                               (size_t) p4est->global_num_quadrants);
+  remote->data = data_size > 0 ?
+    P4EST_ALLOC (char,
+                 (size_t) p4est->global_num_quadrants * data_size) : NULL;
+  counts = P4EST_ALLOC (int, p4est->mpisize);
+  offsets = P4EST_ALLOC (int, p4est->mpisize);
+  for (p = 0; p < p4est->mpisize; ++p) {
+    counts[p] = (int) ((size_t) (p4est->global_first_quadrant[p + 1] -
+                                 p4est->global_first_quadrant[p]) * qbytes);
+    offsets[p] = (int) ((size_t) p4est->global_first_quadrant[p] * qbytes);
+  }
+  mpiret = sc_MPI_Allgatherv (own, (int) ((size_t) lnq * qbytes),
+                              sc_MPI_BYTE, remote->quads, counts, offsets,
+                              sc_MPI_BYTE, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  if (data_size > 0) {
+    for (p = 0; p < p4est->mpisize; ++p) {
+      counts[p] = (int) ((size_t) (p4est->global_first_quadrant[p + 1] -
+                                   p4est->global_first_quadrant[p]) *
+                         data_size);
+      offsets[p] = (int) ((size_t) p4est->global_first_quadrant[p] *
+                          data_size);
+    }
+    mpiret = sc_MPI_Allgatherv (owndata, (int) ((size_t) lnq * data_size),
+                                sc_MPI_BYTE, remote->data, counts, offsets,
+                                sc_MPI_BYTE, p4est->mpicomm);
+    SC_CHECK_MPI (mpiret);
+  }
+  P4EST_FREE (offsets);
+  P4EST_FREE (counts);
+  P4EST_FREE (owndata);
+  P4EST_FREE (own);
+#endif
+
+  return remote;
+}
+
+void
+p4est_remote_get (p4est_remote_t * remote, sc_array_t * points,
+                  sc_array_t * leaves, sc_array_t * payload)
+{
+  const size_t        qbytes = sizeof (p4est_quadrant_t);
+  const size_t        data_size = remote->data_size;
+  size_t              zz;
+  int                 owner;
+  p4est_t            *p4est = remote->p4est;
+  const p4est_gloidx_t *gfq = p4est->global_first_quadrant;
+  p4est_locidx_t      nown, lo, hi, mid;
+  p4est_quadrant_t   *point, *leaf;
+#ifdef P4EST_COMM_WINRMA
+  int                 mpiret;
+  p4est_quadrant_t    fq;
+#else
+  const p4est_quadrant_t *base;
+#endif
+
+  P4EST_ASSERT (points->elem_size == qbytes);
+  P4EST_ASSERT (leaves->elem_size == qbytes);
+  P4EST_ASSERT (payload == NULL || data_size > 0);
+  P4EST_ASSERT (payload == NULL || payload->elem_size == data_size);
+
+  sc_array_resize (leaves, points->elem_count);
+  if (payload != NULL) {
+    sc_array_resize (payload, points->elem_count);
+  }
+
+#ifdef P4EST_COMM_WINRMA
+  mpiret = MPI_Win_lock_all (0, remote->win_quads);
+  SC_CHECK_MPI (mpiret);
+  if (payload != NULL) {
+    mpiret = MPI_Win_lock_all (0, remote->win_data);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+
+  owner = p4est->mpirank;
+  for (zz = 0; zz < points->elem_count; ++zz) {
+    point = p4est_quadrant_array_index (points, zz);
+    leaf = p4est_quadrant_array_index (leaves, zz);
+    owner = p4est_comm_find_owner (p4est, point->p.piggy3.which_tree,
+                                   point, owner);
+    nown = (p4est_locidx_t) (gfq[owner + 1] - gfq[owner]);
+    P4EST_ASSERT (nown > 0);
+
+    /* find the last leaf of the owner preceding or equal to the point
+     * in tree and Morton order; it is the one containing the point */
+    lo = 0;
+    hi = nown - 1;
+#ifdef P4EST_COMM_WINRMA
+    while (lo < hi) {
+      mid = (lo + hi + 1) / 2;
+      mpiret = MPI_Get (&fq, (int) qbytes, MPI_BYTE, owner,
+                        (MPI_Aint) ((size_t) mid * qbytes),
+                        (int) qbytes, MPI_BYTE, remote->win_quads);
+      SC_CHECK_MPI (mpiret);
+      mpiret = MPI_Win_flush (owner, remote->win_quads);
+      SC_CHECK_MPI (mpiret);
+      if (p4est_quadrant_compare_piggy (&fq, point) <= 0) {
+        lo = mid;
+      }
+      else {
+        hi = mid - 1;
+      }
+    }
+
+    /* fetch the leaf and its payload; completed by one flush for all */
+    mpiret = MPI_Get (leaf, (int) qbytes, MPI_BYTE, owner,
+                      (MPI_Aint) ((size_t) lo * qbytes),
+                      (int) qbytes, MPI_BYTE, remote->win_quads);
+    SC_CHECK_MPI (mpiret);
+    if (payload != NULL) {
+      mpiret = MPI_Get (sc_array_index (payload, zz), (int) data_size,
+                        MPI_BYTE, owner,
+                        (MPI_Aint) ((size_t) lo * data_size),
+                        (int) data_size, MPI_BYTE, remote->win_data);
+      SC_CHECK_MPI (mpiret);
+    }
+#else
+    base = remote->quads + gfq[owner];
+    while (lo < hi) {
+      mid = (lo + hi + 1) / 2;
+      if (p4est_quadrant_compare_piggy (base + mid, point) <= 0) {
+        lo = mid;
+      }
+      else {
+        hi = mid - 1;
+      }
+    }
+    *leaf = base[lo];
+    if (payload != NULL) {
+      memcpy (sc_array_index (payload, zz),
+              remote->data + ((size_t) gfq[owner] + (size_t) lo) *
+              data_size, data_size);
+    }
+#endif
+  }
+
+#ifdef P4EST_COMM_WINRMA
+  mpiret = MPI_Win_flush_all (remote->win_quads);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Win_unlock_all (remote->win_quads);
+  SC_CHECK_MPI (mpiret);
+  if (payload != NULL) {
+    mpiret = MPI_Win_flush_all (remote->win_data);
+    SC_CHECK_MPI (mpiret);
+    mpiret = MPI_Win_unlock_all (remote->win_data);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+
+#ifdef P4EST_ENABLE_DEBUG
+  for (zz = 0; zz < points->elem_count; ++zz) {
+    point = p4est_quadrant_array_index (points, zz);
+    leaf = p4est_quadrant_array_index (leaves, zz);
+    P4EST_ASSERT (leaf->p.piggy3.which_tree == point->p.piggy3.which_tree);
+    P4EST_ASSERT (p4est_quadrant_is_equal (leaf, point) ||
+                  p4est_quadrant_is_ancestor (leaf, point));
+  }
+#endif
+}
+
+void
+p4est_remote_close (p4est_remote_t * remote)
+{
+#ifdef P4EST_COMM_WINRMA
+  int                 mpiret;
+
+  mpiret = MPI_Win_free (&remote->win_quads);
+  SC_CHECK_MPI (mpiret);
+  if (remote->data_size > 0) {
+    mpiret = MPI_Win_free (&remote->win_data);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+  P4EST_FREE (remote->data);
+  P4EST_FREE (remote->quads);
+  P4EST_FREE (remote);
+}
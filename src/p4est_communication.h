@@ -102,6 +102,47 @@ int                 p4est_comm_parallel_env_reduce_ext (p4est_t **
                                                         int add_to_beginning,
                                                         int **ranks_subcomm);
 
+/** Bookkeeping for a temporarily shrunken parallel environment.
+ * Created by \ref p4est_comm_parallel_env_shrink and consumed by
+ * \ref p4est_comm_parallel_env_expand.
+ */
+typedef struct p4est_comm_active
+{
+  p4est_t            *p4est;
+  sc_MPI_Comm         supercomm;         /**< the original communicator */
+  int                 supersize, superrank;
+  int                 super_owned;       /**< the forest owned supercomm */
+  p4est_gloidx_t     *super_gfq;         /**< original partition counts,
+                                              NULL if not shrunk */
+  p4est_quadrant_t   *super_gfp;         /**< original partition markers */
+  int                 is_active;         /**< this process participates */
+}
+p4est_comm_active_t;
+
+/** Shrink the parallel environment to the non-empty processes.
+ * Unlike \ref p4est_comm_parallel_env_reduce, the forest survives on
+ * the empty processes: they are parked with their environment left
+ * untouched, while the remaining processes switch the forest to a
+ * communicator of active ranks only, so collectives in subsequent
+ * adaptation calls pay for the active ranks instead of the full
+ * communicator.  A parked process must not call any forest routine
+ * until \ref p4est_comm_parallel_env_expand brings it back.
+ * This function is collective on the forest's communicator.
+ * \return          A context whose is_active member tells whether this
+ *                  process takes part in the shrunken environment.
+ */
+p4est_comm_active_t *p4est_comm_parallel_env_shrink (p4est_t * p4est);
+
+/** Restore the full parallel environment after a shrunken phase.
+ * The forest returns to the communicator it had before the matching
+ * \ref p4est_comm_parallel_env_shrink and the partition arrays are
+ * refreshed over all processes, picking up any adaptation performed
+ * while the environment was shrunk.  This function is collective on
+ * the original communicator and deallocates the context.
+ */
+void                p4est_comm_parallel_env_expand (p4est_comm_active_t *
+                                                    active);
+
 /** Caculate the number and partition of quadrents.
  * \param [in,out] p4est  Adds all \c p4est->local_num_quadrant counters and
  *                        puts cumulative sums in p4est->global_first_quadrant.
@@ -121,8 +162,10 @@ void                p4est_comm_global_partition (p4est_t * p4est,
                                                  first_quad);
 
 /** Compute and distribute the cumulative number of quadrants per tree.
- * \param [in] p4est    This p4est needs to have correct values for
- *                      global_first_quadrant and global_first_position.
+ * Every process contributes the counts of its local tree window and
+ * the result is summed collectively, without any per-process
+ * bookkeeping arrays.
+ * \param [in] p4est    This p4est needs valid local quadrant storage.
  * \param [in,out] pertree      On input, memory for num_trees + 1 numbers.
  *                              On output, the cumulative quadrant counts.
  */
@@ -170,6 +213,254 @@ int                 p4est_comm_find_owner (p4est_t * p4est,
                                            const p4est_quadrant_t * q,
                                            int guess);
 
+/** Searches the owner of a quadrant within a window of processors.
+ * Behaves like \ref p4est_comm_find_owner restricted to
+ * [\a proc_low, \a proc_high]; the window must contain the owner.
+ * \param [in] proc_low    Lowest processor id of the search window.
+ * \param [in] proc_high   Highest processor id of the search window.
+ * \param [in] guess       Initial guess within the window.
+ * \return Returns the processor id of the owner.
+ */
+int                 p4est_comm_find_owner_bounded (p4est_t * p4est,
+                                                   p4est_locidx_t which_tree,
+                                                   const p4est_quadrant_t * q,
+                                                   int proc_low,
+                                                   int proc_high, int guess);
+
+/** Searches the owner of a quadrant starting from a previous result.
+ * The owner is bracketed by galloping away from \a seed and the bracket
+ * is narrowed by interpolating on the first tree index of each rank, so
+ * a query close to the previous result completes in O(1) comparisons.
+ * Assumes a tree with no overlaps.
+ * \param [in] seed    Result of a previous search, or any processor id.
+ * \return Returns the processor id of the owner.
+ */
+int                 p4est_comm_find_owner_interpolate (p4est_t * p4est,
+                                                       p4est_locidx_t
+                                                       which_tree,
+                                                       const p4est_quadrant_t
+                                                       * q, int seed);
+
+/** Searches the owners of many quadrants in one call.
+ * The queries are processed in ascending tree and Morton order, each
+ * search seeded with the owner of its predecessor, which makes the
+ * lookup amortized O(1) per query for spatially coherent query sets.
+ * \param [in] queries  Array of p4est_quadrant_t.  Each entry must be a
+ *                      valid quadrant or node and carry its tree number
+ *                      in the piggy3.which_tree member.  Not modified.
+ * \param [out] owners  Owner processor id per query, in input order.
+ */
+void                p4est_comm_find_owner_batch (p4est_t * p4est,
+                                                 sc_array_t * queries,
+                                                 int *owners);
+
+/** Sparse directory into the partition boundaries of a forest.
+ * It samples every \a stride-th entry of global_first_position into a
+ * small contiguous array.  Owner queries first search the samples and
+ * then refine into a window of at most \a stride processors, which
+ * touches O(log (P / stride)) hot entries plus a localized region of
+ * the full array instead of cache lines scattered across all of it.
+ * The directory is only valid as long as the partition is unchanged.
+ */
+typedef struct p4est_comm_partition_dir
+{
+  int                 mpisize;  /**< number of processors when sampled */
+  int                 stride;   /**< ranks covered by one sample */
+  int                 num_samples;      /**< entries in \a samples */
+  p4est_quadrant_t   *samples;  /**< sampled partition boundaries */
+}
+p4est_comm_partition_dir_t;
+
+/** Samples the partition boundaries into a sparse directory.
+ * \param [in] p4est     Its global_first_position array must be valid.
+ * \param [in] stride    Ranks per sample; 0 selects a default near
+ *                        the square root of the number of processors.
+ * \return Returns a directory valid until the next repartition.
+ */
+p4est_comm_partition_dir_t *p4est_comm_partition_dir_new (p4est_t * p4est,
+                                                          int stride);
+
+/** Frees a sparse partition directory.
+ * \param [in] dir       Directory created by
+ *                        \ref p4est_comm_partition_dir_new.
+ */
+void                p4est_comm_partition_dir_destroy
+  (p4est_comm_partition_dir_t * dir);
+
+/** Searches the owner of a quadrant through a sparse directory.
+ * Assumes a tree with no overlaps and an unchanged partition.
+ * \param [in] dir     Directory created for this forest's partition.
+ * \return Returns the processor id of the owner.
+ */
+int                 p4est_comm_partition_dir_find_owner (p4est_t * p4est,
+                                                         p4est_comm_partition_dir_t
+                                                         * dir,
+                                                         p4est_locidx_t
+                                                         which_tree,
+                                                         const p4est_quadrant_t
+                                                         * q);
+
+/** Per-quadrant payload stored in one contiguous array.
+ * The entry for a local quadrant lives at its cumulative quadrant index
+ * counted over all local trees, so bulk operations act on large
+ * contiguous ranges instead of chasing one pointer per quadrant.  In
+ * particular \ref p4est_data_vector_partition moves the payload to a
+ * new partition with one message per neighboring overlap.  The vector
+ * remembers the partition it is currently laid out for.
+ */
+typedef struct p4est_data_vector
+{
+  size_t              data_size;        /**< bytes per quadrant */
+  int                 mpisize;          /**< processes of the partition */
+  p4est_locidx_t      num_quadrants;    /**< local quadrants covered */
+  p4est_gloidx_t     *src_gfq;  /**< partition the data is laid out for */
+  char               *data;     /**< the contiguous payload array */
+}
+p4est_data_vector_t;
+
+/** Allocate a contiguous data array matching the current partition.
+ * The contents are not initialized.
+ * \param [in] data_size    Bytes to store per local quadrant.
+ * \return                  A vector to be freed with
+ *                          \ref p4est_data_vector_destroy.
+ */
+p4est_data_vector_t *p4est_data_vector_new (p4est_t * p4est,
+                                            size_t data_size);
+
+/** Access the payload of one local quadrant.
+ * \param [in] li   Cumulative local quadrant index, that is, the index
+ *                  within the tree plus the tree's quadrants_offset.
+ * \return          Pointer to the quadrant's entry in the array.
+ */
+void               *p4est_data_vector_index (p4est_data_vector_t * dvec,
+                                             p4est_locidx_t li);
+
+/** Point the local quadrants' user data into the vector.
+ * Every local quadrant's p.user_data is set to its entry in the array,
+ * which makes the payload accessible from iterator and search callbacks.
+ * The forest must have been created with data_size == 0 so the pointers
+ * are not owned by its user data pool.  The links are invalidated by
+ * any change to the forest or the vector and must then be recreated.
+ */
+void                p4est_data_vector_link (p4est_t * p4est,
+                                            p4est_data_vector_t * dvec);
+
+/** Move the payload of a vector to the forest's current partition.
+ * Collective over all processes.  The vector must be laid out for a
+ * previous partition of the same global quadrant count, as remembered
+ * from its creation or its last call to this function.  Every process
+ * exchanges one large message per process its old range overlaps with,
+ * independent of the number of quadrants transferred.
+ * \param [in,out] dvec     Its data array is reallocated and filled
+ *                          according to the current partition.
+ */
+void                p4est_data_vector_partition (p4est_t * p4est,
+                                                 p4est_data_vector_t * dvec);
+
+/** Free a vector created by \ref p4est_data_vector_new. */
+void                p4est_data_vector_destroy (p4est_data_vector_t * dvec);
+
+/** Transient storage for a pending user data transfer. */
+typedef struct p4est_transfer_context
+{
+  int                 variable;     /**< True for per-quadrant sizes. */
+  int                 num_requests; /**< Pending messages, both ways. */
+  sc_MPI_Request     *requests;     /**< Freed with the context. */
+}
+p4est_transfer_context_t;
+
+/** Move per-quadrant payload from an old partition to a new one.
+ * The old and new partitions are described by their cumulative quadrant
+ * counts, as in the global_first_quadrant member of \ref p4est_t; a
+ * typical use copies that array before \ref p4est_partition and calls
+ * this function afterwards to move application data along.  The data
+ * is not interpreted, only shuffled by the partition boundaries; the
+ * part of the range that stays local is copied without messaging.
+ * This function is equivalent to \ref p4est_transfer_fixed_begin
+ * directly followed by \ref p4est_transfer_fixed_end.
+ *
+ * \param [in] dest_gfq     Cumulative counts of the new partition,
+ *                          mpisize + 1 entries starting with zero.
+ * \param [in] src_gfq      Same for the old partition; the totals of
+ *                          both arrays must agree.
+ * \param [in] mpicomm      The communicator both partitions live on.
+ * \param [out] dest_data   Receives data_size bytes for each quadrant
+ *                          of the new local range.
+ * \param [in] src_data     Holds data_size bytes for each quadrant of
+ *                          the old local range.
+ * \param [in] data_size    Bytes per quadrant; zero moves nothing.
+ */
+void                p4est_transfer_fixed (const p4est_gloidx_t * dest_gfq,
+                                          const p4est_gloidx_t * src_gfq,
+                                          sc_MPI_Comm mpicomm,
+                                          void *dest_data,
+                                          const void *src_data,
+                                          size_t data_size);
+
+/** Post the messages of \ref p4est_transfer_fixed without blocking.
+ * The buffers must not be accessed before the completion call, while
+ * the caller may overlap unrelated computation with the transfer.
+ * \return          Transient state holding the pending messages; it
+ *                  must be passed to \ref p4est_transfer_fixed_end.
+ */
+p4est_transfer_context_t *p4est_transfer_fixed_begin (const p4est_gloidx_t *
+                                                      dest_gfq,
+                                                      const p4est_gloidx_t *
+                                                      src_gfq,
+                                                      sc_MPI_Comm mpicomm,
+                                                      void *dest_data,
+                                                      const void *src_data,
+                                                      size_t data_size);
+
+/** Complete a transfer started with \ref p4est_transfer_fixed_begin.
+ * \param [in,out] tc   Created by p4est_transfer_fixed_begin.
+ *                      It is deallocated before this function returns.
+ */
+void                p4est_transfer_fixed_end (p4est_transfer_context_t * tc);
+
+/** Move per-quadrant payload of individual sizes between partitions.
+ * Like \ref p4est_transfer_fixed, except that every quadrant carries
+ * its own number of bytes and the payloads are stored contiguously in
+ * quadrant order.  Both sides must know their sizes up front: the
+ * receiver's \a dest_sizes is typically obtained by first moving the
+ * size array itself with \ref p4est_transfer_fixed.
+ *
+ * \param [out] dest_data   Receives the payload for each quadrant of
+ *                          the new local range, packed contiguously.
+ * \param [in] dest_sizes   Bytes per quadrant of the new local range.
+ * \param [in] src_data     Payload for each quadrant of the old local
+ *                          range, packed contiguously.
+ * \param [in] src_sizes    Bytes per quadrant of the old local range.
+ */
+void                p4est_transfer_custom (const p4est_gloidx_t * dest_gfq,
+                                           const p4est_gloidx_t * src_gfq,
+                                           sc_MPI_Comm mpicomm,
+                                           void *dest_data,
+                                           const int *dest_sizes,
+                                           const void *src_data,
+                                           const int *src_sizes);
+
+/** Post the messages of \ref p4est_transfer_custom without blocking.
+ * The buffers must not be accessed before the completion call.
+ * \return          Transient state holding the pending messages; it
+ *                  must be passed to \ref p4est_transfer_custom_end.
+ */
+p4est_transfer_context_t *p4est_transfer_custom_begin (const p4est_gloidx_t *
+                                                       dest_gfq,
+                                                       const p4est_gloidx_t *
+                                                       src_gfq,
+                                                       sc_MPI_Comm mpicomm,
+                                                       void *dest_data,
+                                                       const int *dest_sizes,
+                                                       const void *src_data,
+                                                       const int *src_sizes);
+
+/** Complete a transfer started with \ref p4est_transfer_custom_begin.
+ * \param [in,out] tc   Created by p4est_transfer_custom_begin.
+ *                      It is deallocated before this function returns.
+ */
+void                p4est_transfer_custom_end (p4est_transfer_context_t * tc);
+
 /** Computes information about a tree being fully owned.
  * This is determined separately for the beginning and end of the tree.
  * \param [in] p4est            The p4est to work on.
@@ -220,6 +511,57 @@ unsigned            p4est_comm_checksum (p4est_t * p4est,
                                          unsigned local_crc,
                                          size_t local_bytes);
 
+/** Opaque handle of the remote quadrant query service.
+ * Created collectively by \ref p4est_remote_open.
+ */
+typedef struct p4est_remote p4est_remote_t;
+
+/** Open a query service for quadrant data at scattered remote points.
+ * Collective.  Each process packs its local quadrants and a snapshot
+ * of their user data into contiguous buffers and exposes them through
+ * passive-target MPI windows, keyed by the global_first_quadrant
+ * partition.  Subsequent \ref p4est_remote_get calls then resolve
+ * arbitrary points of the domain with one-sided traffic proportional
+ * to the number of queries, replacing gathers over all processes.
+ * Without MPI-3 window support the buffers are instead replicated on
+ * every process once at open time, preserving the query semantics.
+ * The snapshot is not refreshed: close and reopen the service after
+ * the forest or its data change.
+ * \param [in] p4est    Valid forest; must outlive the service.
+ * \return              Handle to close with \ref p4est_remote_close.
+ */
+p4est_remote_t     *p4est_remote_open (p4est_t * p4est);
+
+/** Fetch the leaves and data snapshots containing scattered points.
+ * Not collective; the owning processes are not involved.  Each remote
+ * point costs one binary search of MPI_Get round trips into its
+ * owner's window; the data fetches of all points are batched behind
+ * one flush.
+ * \param [in] remote   Service from \ref p4est_remote_open.
+ * \param [in] points   Array of p4est_quadrant_t.  Each entry must be
+ *                      a valid quadrant or node anywhere in the domain
+ *                      and carry its tree number in piggy3.which_tree.
+ * \param [in,out] leaves   Array of p4est_quadrant_t, resized to the
+ *                      number of points.  Entry \a i receives the leaf
+ *                      containing point \a i, with piggy3 set to its
+ *                      tree and owner-local number.
+ * \param [in,out] payload  May be NULL, and must be NULL if the forest
+ *                      carries no data.  Otherwise its element size
+ *                      must equal the forest's data size; it is resized
+ *                      to the number of points and filled with each
+ *                      leaf's data snapshot.
+ */
+void                p4est_remote_get (p4est_remote_t * remote,
+                                      sc_array_t * points,
+                                      sc_array_t * leaves,
+                                      sc_array_t * payload);
+
+/** Close the query service, freeing its windows and buffers.
+ * Collective.
+ * \param [in,out] remote   Service to deallocate.
+ */
+void                p4est_remote_close (p4est_remote_t * remote);
+
 SC_EXTERN_C_END;
 
 #endif /* !P4EST_COMMUNICATION_H */
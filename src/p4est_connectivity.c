@@ -28,10 +28,20 @@
 #include <p4est_connectivity.h>
 #endif
 #include <sc_io.h>
+#ifdef P4EST_HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #ifdef P4EST_WITH_METIS
 #include <metis.h>
 #endif
 
+#if defined P4EST_ENABLE_MPI && defined MPI_VERSION && MPI_VERSION >= 3
+#define P4EST_CONN_WINSHARED
+#endif
+
 #ifndef P4_TO_P8
 
 /* *INDENT-OFF* */
@@ -68,7 +78,7 @@ p4est_connectivity_face_neighbor_face_corner_orientation (int fc, int f,
 {
   int                 nfc;
 #ifdef P4_TO_P8
-  int                 pref, pset;
+  int                 pset;
 #endif
 
   /* sanity checks */
@@ -80,8 +90,7 @@ p4est_connectivity_face_neighbor_face_corner_orientation (int fc, int f,
 #ifndef P4_TO_P8
   nfc = fc ^ o;
 #else
-  pref = p8est_face_permutation_refs[f][nf];
-  pset = p8est_face_permutation_sets[pref][o];
+  pset = p8est_face_permutation_orientations[f][nf][o];
   nfc = p8est_face_permutations[pset][fc];
 #endif
   P4EST_ASSERT (0 <= nfc && nfc < P4EST_HALF);
@@ -1252,6 +1261,829 @@ p4est_connectivity_load (const char *filename, size_t * bytes)
   return conn;
 }
 
+#ifdef P4EST_HAVE_SYS_MMAN_H
+
+/** Bookkeeping for a connectivity whose arrays alias a file mapping. */
+typedef struct p4est_connectivity_mmap_context
+{
+  p4est_connectivity_t conn;        /**< must stay the first member */
+  void               *map_base;     /**< start of the read-only mapping */
+  size_t              map_length;   /**< byte length of the mapping */
+}
+p4est_connectivity_mmap_context_t;
+
+/** Hand out one on-disk array from the mapping.
+ * The array is aliased in place when its file offset is aligned for the
+ * element type and copied into fresh memory otherwise: the raw format
+ * carries no padding, so odd-sized int8 runs can shift later arrays.
+ */
+static void        *
+p4est_connectivity_mmap_array (char *base, size_t * offset,
+                               size_t align, size_t nbytes)
+{
+  char               *ptr = base + *offset;
+  char               *copy;
+
+  *offset += nbytes;
+  if (((uintptr_t) ptr) % align == 0) {
+    return ptr;
+  }
+  copy = P4EST_ALLOC (char, nbytes);
+  memcpy (copy, ptr, nbytes);
+  return copy;
+}
+
+p4est_connectivity_t *
+p4est_connectivity_mmap (const char *filename)
+{
+  int                 fd;
+  char               *base;
+  size_t              u64z, topsize, int8size;
+  size_t              offset, expected, tcount, tree_attr_bytes;
+  uint64_t            array10[10];
+  struct stat         st;
+  p4est_topidx_t      num_vertices, num_trees;
+  p4est_topidx_t      num_edges, num_ett, num_corners, num_ctt;
+  p4est_connectivity_mmap_context_t *mc;
+  p4est_connectivity_t *conn;
+
+  u64z = sizeof (uint64_t);
+  topsize = sizeof (p4est_topidx_t);
+  int8size = sizeof (int8_t);
+
+  fd = open (filename, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (fstat (fd, &st) || (size_t) st.st_size < 8 + 24 + 10 * u64z) {
+    /* "stat failed or header truncated" */
+    close (fd);
+    return NULL;
+  }
+  base = (char *) mmap (NULL, (size_t) st.st_size, PROT_READ,
+                        MAP_SHARED, fd, 0);
+  close (fd);
+  if (base == (char *) MAP_FAILED) {
+    return NULL;
+  }
+
+  mc = P4EST_ALLOC_ZERO (p4est_connectivity_mmap_context_t, 1);
+  mc->map_base = base;
+  mc->map_length = (size_t) st.st_size;
+  conn = &mc->conn;
+
+  if (strncmp (base, P4EST_STRING, 8)) {
+    /* "invalid magic" */
+    goto failure;
+  }
+  offset = 8 + 24;              /* skip magic and package version */
+  memcpy (array10, base + offset, 10 * u64z);
+  offset += 10 * u64z;
+  if (array10[0] != P4EST_ONDISK_FORMAT) {
+    /* "on-disk format mismatch" */
+    goto failure;
+  }
+  if (array10[1] != (uint64_t) topsize) {
+    /* "p4est_topidx_t size mismatch" */
+    goto failure;
+  }
+  num_vertices = (p4est_topidx_t) array10[2];
+  num_trees = (p4est_topidx_t) array10[3];
+  num_edges = (p4est_topidx_t) array10[4];
+  num_ett = (p4est_topidx_t) array10[5];
+  num_corners = (p4est_topidx_t) array10[6];
+  num_ctt = (p4est_topidx_t) array10[7];
+  tree_attr_bytes = (size_t) array10[8];
+  if (num_vertices < 0 || num_trees < 0 ||
+      num_corners < 0 || num_ctt < 0) {
+    /* "negative counts" */
+    goto failure;
+  }
+#ifdef P4_TO_P8
+  if (num_edges < 0 || num_ett < 0) {
+    /* "negative edge counts" */
+    goto failure;
+  }
+#else
+  if (num_edges != 0 || num_ett != 0) {
+    /* "num_edges and num_ett must be zero in 2D" */
+    goto failure;
+  }
+#endif
+
+  /* all array lengths are known from the header: check file size once */
+  expected = offset;
+  if (num_vertices > 0) {
+    expected += (size_t) (3 * num_vertices) * sizeof (double)
+      + (size_t) (P4EST_CHILDREN * num_trees) * topsize;
+  }
+#ifdef P4_TO_P8
+  if (num_edges > 0) {
+    expected += (size_t) (P8EST_EDGES * num_trees) * topsize;
+  }
+  expected += (size_t) (num_edges + 1) * topsize
+    + (size_t) num_ett * (topsize + int8size);
+#endif
+  if (num_corners > 0) {
+    expected += (size_t) (P4EST_CHILDREN * num_trees) * topsize;
+  }
+  expected += (size_t) (P4EST_FACES * num_trees) * (topsize + int8size)
+    + (size_t) num_trees * tree_attr_bytes
+    + (size_t) (num_corners + 1) * topsize
+    + (size_t) num_ctt * (topsize + int8size);
+  if (mc->map_length < expected) {
+    /* "file truncated" */
+    goto failure;
+  }
+
+  conn->num_vertices = num_vertices;
+  conn->num_trees = num_trees;
+#ifdef P4_TO_P8
+  conn->num_edges = num_edges;
+#endif
+  conn->num_corners = num_corners;
+  conn->tree_attr_bytes = tree_attr_bytes;
+
+  if (num_vertices > 0) {
+    tcount = (size_t) (3 * num_vertices);
+    conn->vertices = (double *)
+      p4est_connectivity_mmap_array (base, &offset, sizeof (double),
+                                     tcount * sizeof (double));
+  }
+#ifdef P4_TO_P8
+  if (num_edges > 0) {
+    tcount = (size_t) (P8EST_EDGES * num_trees);
+    conn->tree_to_edge = (p4est_topidx_t *)
+      p4est_connectivity_mmap_array (base, &offset, topsize,
+                                     tcount * topsize);
+  }
+#endif
+  tcount = (size_t) (P4EST_CHILDREN * num_trees);
+  if (num_vertices > 0) {
+    conn->tree_to_vertex = (p4est_topidx_t *)
+      p4est_connectivity_mmap_array (base, &offset, topsize,
+                                     tcount * topsize);
+  }
+  if (num_corners > 0) {
+    conn->tree_to_corner = (p4est_topidx_t *)
+      p4est_connectivity_mmap_array (base, &offset, topsize,
+                                     tcount * topsize);
+  }
+  tcount = (size_t) (P4EST_FACES * num_trees);
+  conn->tree_to_tree = (p4est_topidx_t *)
+    p4est_connectivity_mmap_array (base, &offset, topsize, tcount * topsize);
+  conn->tree_to_face = (int8_t *)
+    p4est_connectivity_mmap_array (base, &offset, int8size,
+                                   tcount * int8size);
+  if (tree_attr_bytes > 0) {
+    conn->tree_to_attr = (char *)
+      p4est_connectivity_mmap_array (base, &offset, 1,
+                                     (size_t) num_trees * tree_attr_bytes);
+  }
+
+#ifdef P4_TO_P8
+  conn->ett_offset = (p4est_topidx_t *)
+    p4est_connectivity_mmap_array (base, &offset, topsize,
+                                   topsize * (size_t) (num_edges + 1));
+  if (num_ett != conn->ett_offset[num_edges]) {
+    /* "ett_offset mismatch" */
+    goto failure;
+  }
+  if (num_edges > 0) {
+    conn->edge_to_tree = (p4est_topidx_t *)
+      p4est_connectivity_mmap_array (base, &offset, topsize,
+                                     topsize * (size_t) num_ett);
+    conn->edge_to_edge = (int8_t *)
+      p4est_connectivity_mmap_array (base, &offset, int8size,
+                                     int8size * (size_t) num_ett);
+  }
+#endif
+
+  conn->ctt_offset = (p4est_topidx_t *)
+    p4est_connectivity_mmap_array (base, &offset, topsize,
+                                   topsize * (size_t) (num_corners + 1));
+  if (num_ctt != conn->ctt_offset[num_corners]) {
+    /* "ctt_offset mismatch" */
+    goto failure;
+  }
+  if (num_corners > 0) {
+    conn->corner_to_tree = (p4est_topidx_t *)
+      p4est_connectivity_mmap_array (base, &offset, topsize,
+                                     topsize * (size_t) num_ctt);
+    conn->corner_to_corner = (int8_t *)
+      p4est_connectivity_mmap_array (base, &offset, int8size,
+                                     int8size * (size_t) num_ctt);
+  }
+
+  if (!p4est_connectivity_is_valid (conn)) {
+    /* "invalid connectivity" */
+    goto failure;
+  }
+
+  return conn;
+
+failure:
+  p4est_connectivity_munmap (conn);
+  return NULL;
+}
+
+void
+p4est_connectivity_munmap (p4est_connectivity_t * conn)
+{
+  p4est_connectivity_mmap_context_t *mc =
+    (p4est_connectivity_mmap_context_t *) conn;
+  char               *base = (char *) mc->map_base;
+  char               *top = base + mc->map_length;
+  size_t              zz;
+  void               *ptrs[] = {
+    conn->vertices, conn->tree_to_vertex, conn->tree_to_attr,
+    conn->tree_to_tree, conn->tree_to_face,
+#ifdef P4_TO_P8
+    conn->tree_to_edge, conn->ett_offset,
+    conn->edge_to_tree, conn->edge_to_edge,
+#endif
+    conn->tree_to_corner, conn->ctt_offset,
+    conn->corner_to_tree, conn->corner_to_corner
+  };
+
+  /* free the rare arrays that were copied out for alignment */
+  for (zz = 0; zz < sizeof (ptrs) / sizeof (ptrs[0]); ++zz) {
+    if (ptrs[zz] != NULL &&
+        !((char *) ptrs[zz] >= base && (char *) ptrs[zz] < top)) {
+      P4EST_FREE (ptrs[zz]);
+    }
+  }
+  munmap (mc->map_base, mc->map_length);
+  P4EST_FREE (mc);
+}
+
+#else /* !P4EST_HAVE_SYS_MMAN_H */
+
+p4est_connectivity_t *
+p4est_connectivity_mmap (const char *filename)
+{
+  /* no mmap on this system: fall back to an ordinary load */
+  return p4est_connectivity_load (filename, NULL);
+}
+
+void
+p4est_connectivity_munmap (p4est_connectivity_t * conn)
+{
+  p4est_connectivity_destroy (conn);
+}
+
+#endif /* !P4EST_HAVE_SYS_MMAN_H */
+
+#ifdef P4EST_CONN_WINSHARED
+
+/** Bookkeeping for a connectivity whose arrays live in a shared window. */
+typedef struct p4est_connectivity_shared_context
+{
+  p4est_connectivity_t conn;    /**< must stay the first member */
+  MPI_Win             win;      /**< node-shared memory window */
+}
+p4est_connectivity_shared_context_t;
+
+/** Reserve room for one array in the shared window layout.
+ * Offsets are kept 8-byte aligned so every element type is serviced.
+ */
+static size_t
+p4est_connectivity_share_offset (size_t * total, size_t nbytes)
+{
+  size_t              offset;
+
+  offset = (*total + 7) & ~(size_t) 7;
+  *total = offset + nbytes;
+  return offset;
+}
+
+p4est_connectivity_t *
+p4est_connectivity_share (p4est_connectivity_t * conn_in, int root,
+                          sc_MPI_Comm intranode_comm)
+{
+  int                 mpirank, mpiret;
+  int                 qdisp;
+  size_t              total, topsize, int8size;
+  size_t              o_vertices, o_ttv, o_attr, o_ttt, o_ttf, o_ttc;
+#ifdef P4_TO_P8
+  size_t              o_tte, o_eoff, o_ett, o_ete;
+#endif
+  size_t              o_coff, o_ctt, o_ctc;
+  char               *base, *unused;
+  MPI_Aint            winsize, qsize;
+  p4est_connectivity_shared_context_t *sc;
+  p4est_connectivity_t *conn;
+  struct
+  {
+    p4est_topidx_t      num_vertices, num_trees, num_corners, num_ctt;
+    size_t              tree_attr_bytes;
+#ifdef P4_TO_P8
+    p4est_topidx_t      num_edges, num_ett;
+#endif
+  }
+  conn_dimensions;
+
+  topsize = sizeof (p4est_topidx_t);
+  int8size = sizeof (int8_t);
+
+  mpiret = sc_MPI_Comm_rank (intranode_comm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  /* broadcast the dimensions exactly as in p4est_connectivity_bcast */
+  if (mpirank == root) {
+    P4EST_ASSERT (conn_in != NULL);
+    memset (&conn_dimensions, -1, sizeof (conn_dimensions));
+    conn_dimensions.num_corners = conn_in->num_corners;
+    conn_dimensions.num_trees = conn_in->num_trees;
+    conn_dimensions.num_vertices = conn_in->num_vertices;
+    conn_dimensions.tree_attr_bytes = conn_in->tree_attr_bytes;
+    conn_dimensions.num_ctt = conn_in->ctt_offset[conn_in->num_corners];
+#ifdef P4_TO_P8
+    conn_dimensions.num_edges = conn_in->num_edges;
+    conn_dimensions.num_ett = conn_in->ett_offset[conn_in->num_edges];
+#endif
+  }
+  else {
+    P4EST_ASSERT (conn_in == NULL);
+  }
+  mpiret = sc_MPI_Bcast (&conn_dimensions, sizeof (conn_dimensions),
+                         sc_MPI_BYTE, root, intranode_comm);
+  SC_CHECK_MPI (mpiret);
+
+  /* every process computes the same window layout from the dimensions */
+  total = 0;
+  o_vertices = o_ttv = o_attr = o_ttc = 0;
+#ifdef P4_TO_P8
+  o_tte = o_ett = o_ete = 0;
+#endif
+  o_ctt = o_ctc = 0;
+  if (conn_dimensions.num_vertices > 0) {
+    o_vertices = p4est_connectivity_share_offset
+      (&total, (size_t) (3 * conn_dimensions.num_vertices)
+       * sizeof (double));
+    o_ttv = p4est_connectivity_share_offset
+      (&total, (size_t) (P4EST_CHILDREN * conn_dimensions.num_trees)
+       * topsize);
+  }
+  if (conn_dimensions.tree_attr_bytes > 0) {
+    o_attr = p4est_connectivity_share_offset
+      (&total, (size_t) conn_dimensions.num_trees
+       * conn_dimensions.tree_attr_bytes);
+  }
+  o_ttt = p4est_connectivity_share_offset
+    (&total, (size_t) (P4EST_FACES * conn_dimensions.num_trees) * topsize);
+  o_ttf = p4est_connectivity_share_offset
+    (&total, (size_t) (P4EST_FACES * conn_dimensions.num_trees) * int8size);
+  if (conn_dimensions.num_corners > 0) {
+    o_ttc = p4est_connectivity_share_offset
+      (&total, (size_t) (P4EST_CHILDREN * conn_dimensions.num_trees)
+       * topsize);
+  }
+#ifdef P4_TO_P8
+  if (conn_dimensions.num_edges > 0) {
+    o_tte = p4est_connectivity_share_offset
+      (&total, (size_t) (P8EST_EDGES * conn_dimensions.num_trees)
+       * topsize);
+  }
+  o_eoff = p4est_connectivity_share_offset
+    (&total, (size_t) (conn_dimensions.num_edges + 1) * topsize);
+  if (conn_dimensions.num_edges > 0) {
+    o_ett = p4est_connectivity_share_offset
+      (&total, (size_t) conn_dimensions.num_ett * topsize);
+    o_ete = p4est_connectivity_share_offset
+      (&total, (size_t) conn_dimensions.num_ett * int8size);
+  }
+#endif
+  o_coff = p4est_connectivity_share_offset
+    (&total, (size_t) (conn_dimensions.num_corners + 1) * topsize);
+  if (conn_dimensions.num_corners > 0) {
+    o_ctt = p4est_connectivity_share_offset
+      (&total, (size_t) conn_dimensions.num_ctt * topsize);
+    o_ctc = p4est_connectivity_share_offset
+      (&total, (size_t) conn_dimensions.num_ctt * int8size);
+  }
+
+  /* the root process contributes all the memory of the shared window */
+  sc = P4EST_ALLOC_ZERO (p4est_connectivity_shared_context_t, 1);
+  winsize = (mpirank == root) ? (MPI_Aint) total : 0;
+  mpiret = MPI_Win_allocate_shared (winsize, 1, MPI_INFO_NULL,
+                                    intranode_comm, &unused, &sc->win);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Win_shared_query (sc->win, root, &qsize, &qdisp,
+                                 &base);
+  SC_CHECK_MPI (mpiret);
+  P4EST_ASSERT (qsize == (MPI_Aint) total);
+
+  if (mpirank == root) {
+    if (conn_in->num_vertices > 0) {
+      memcpy (base + o_vertices, conn_in->vertices,
+              (size_t) (3 * conn_in->num_vertices) * sizeof (double));
+      memcpy (base + o_ttv, conn_in->tree_to_vertex,
+              (size_t) (P4EST_CHILDREN * conn_in->num_trees) * topsize);
+    }
+    if (conn_in->tree_attr_bytes > 0) {
+      memcpy (base + o_attr, conn_in->tree_to_attr,
+              (size_t) conn_in->num_trees * conn_in->tree_attr_bytes);
+    }
+    memcpy (base + o_ttt, conn_in->tree_to_tree,
+            (size_t) (P4EST_FACES * conn_in->num_trees) * topsize);
+    memcpy (base + o_ttf, conn_in->tree_to_face,
+            (size_t) (P4EST_FACES * conn_in->num_trees) * int8size);
+    if (conn_in->num_corners > 0) {
+      memcpy (base + o_ttc, conn_in->tree_to_corner,
+              (size_t) (P4EST_CHILDREN * conn_in->num_trees) * topsize);
+    }
+#ifdef P4_TO_P8
+    if (conn_in->num_edges > 0) {
+      memcpy (base + o_tte, conn_in->tree_to_edge,
+              (size_t) (P8EST_EDGES * conn_in->num_trees) * topsize);
+    }
+    memcpy (base + o_eoff, conn_in->ett_offset,
+            (size_t) (conn_in->num_edges + 1) * topsize);
+    if (conn_in->num_edges > 0) {
+      memcpy (base + o_ett, conn_in->edge_to_tree,
+              (size_t) conn_dimensions.num_ett * topsize);
+      memcpy (base + o_ete, conn_in->edge_to_edge,
+              (size_t) conn_dimensions.num_ett * int8size);
+    }
+#endif
+    memcpy (base + o_coff, conn_in->ctt_offset,
+            (size_t) (conn_in->num_corners + 1) * topsize);
+    if (conn_in->num_corners > 0) {
+      memcpy (base + o_ctt, conn_in->corner_to_tree,
+              (size_t) conn_dimensions.num_ctt * topsize);
+      memcpy (base + o_ctc, conn_in->corner_to_corner,
+              (size_t) conn_dimensions.num_ctt * int8size);
+    }
+  }
+  mpiret = sc_MPI_Barrier (intranode_comm);
+  SC_CHECK_MPI (mpiret);
+
+  /* every process aliases the arrays out of the shared window */
+  conn = &sc->conn;
+  conn->num_vertices = conn_dimensions.num_vertices;
+  conn->num_trees = conn_dimensions.num_trees;
+#ifdef P4_TO_P8
+  conn->num_edges = conn_dimensions.num_edges;
+#endif
+  conn->num_corners = conn_dimensions.num_corners;
+  conn->tree_attr_bytes = conn_dimensions.tree_attr_bytes;
+  if (conn_dimensions.num_vertices > 0) {
+    conn->vertices = (double *) (base + o_vertices);
+    conn->tree_to_vertex = (p4est_topidx_t *) (base + o_ttv);
+  }
+  if (conn_dimensions.tree_attr_bytes > 0) {
+    conn->tree_to_attr = base + o_attr;
+  }
+  conn->tree_to_tree = (p4est_topidx_t *) (base + o_ttt);
+  conn->tree_to_face = (int8_t *) (base + o_ttf);
+  if (conn_dimensions.num_corners > 0) {
+    conn->tree_to_corner = (p4est_topidx_t *) (base + o_ttc);
+  }
+#ifdef P4_TO_P8
+  if (conn_dimensions.num_edges > 0) {
+    conn->tree_to_edge = (p4est_topidx_t *) (base + o_tte);
+  }
+  conn->ett_offset = (p4est_topidx_t *) (base + o_eoff);
+  if (conn_dimensions.num_edges > 0) {
+    conn->edge_to_tree = (p4est_topidx_t *) (base + o_ett);
+    conn->edge_to_edge = (int8_t *) (base + o_ete);
+  }
+#endif
+  conn->ctt_offset = (p4est_topidx_t *) (base + o_coff);
+  if (conn_dimensions.num_corners > 0) {
+    conn->corner_to_tree = (p4est_topidx_t *) (base + o_ctt);
+    conn->corner_to_corner = (int8_t *) (base + o_ctc);
+  }
+
+  P4EST_ASSERT (p4est_connectivity_is_valid (conn));
+
+  return conn;
+}
+
+void
+p4est_connectivity_unshare (p4est_connectivity_t * conn)
+{
+  int                 mpiret;
+  p4est_connectivity_shared_context_t *sc =
+    (p4est_connectivity_shared_context_t *) conn;
+
+  mpiret = MPI_Win_free (&sc->win);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (sc);
+}
+
+#else /* !P4EST_CONN_WINSHARED */
+
+p4est_connectivity_t *
+p4est_connectivity_share (p4est_connectivity_t * conn_in, int root,
+                          sc_MPI_Comm intranode_comm)
+{
+  int                 mpirank, mpiret;
+  sc_array_t         *buffer;
+  p4est_connectivity_t *conn;
+
+  mpiret = sc_MPI_Comm_rank (intranode_comm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  /* no shared windows: hand every process a private deep copy */
+  conn = NULL;
+  if (mpirank == root) {
+    P4EST_ASSERT (conn_in != NULL);
+    buffer = p4est_connectivity_deflate (conn_in, P4EST_CONN_ENCODE_NONE);
+    conn = p4est_connectivity_inflate (buffer);
+    sc_array_destroy (buffer);
+  }
+  else {
+    P4EST_ASSERT (conn_in == NULL);
+  }
+  return p4est_connectivity_bcast (conn, root, intranode_comm);
+}
+
+void
+p4est_connectivity_unshare (p4est_connectivity_t * conn)
+{
+  p4est_connectivity_destroy (conn);
+}
+
+#endif /* !P4EST_CONN_WINSHARED */
+
+#ifdef P4EST_CONN_WINSHARED
+
+/** Bookkeeping for a distribution that exposes its rows in a window. */
+typedef struct p4est_connectivity_dist_context
+{
+  p4est_connectivity_dist_t dist;       /**< must stay the first member */
+  MPI_Win             win;      /**< passive-target window over the
+                                     owned rows */
+}
+p4est_connectivity_dist_context_t;
+
+/** First tree of the uniform contiguous block owned by \a rank. */
+static              p4est_topidx_t
+p4est_connectivity_dist_begin (p4est_topidx_t num_trees, int mpisize,
+                               int rank)
+{
+  return (p4est_topidx_t) (((p4est_gloidx_t) num_trees * rank) / mpisize);
+}
+
+/** Return the process whose owned block contains \a which_tree. */
+static int
+p4est_connectivity_dist_owner (p4est_connectivity_dist_t * dist,
+                               p4est_topidx_t which_tree)
+{
+  int                 owner;
+
+  P4EST_ASSERT (0 <= which_tree && which_tree < dist->num_trees);
+
+  owner = (int) (((p4est_gloidx_t) which_tree * dist->mpisize) /
+                 dist->num_trees);
+  while (p4est_connectivity_dist_begin (dist->num_trees, dist->mpisize,
+                                        owner + 1) <= which_tree) {
+    ++owner;
+  }
+  while (p4est_connectivity_dist_begin (dist->num_trees, dist->mpisize,
+                                        owner) > which_tree) {
+    --owner;
+  }
+  return owner;
+}
+
+#endif /* P4EST_CONN_WINSHARED */
+
+/** Copy one tree's face adjacency out of a replicated connectivity. */
+static void
+p4est_connectivity_dist_fill (p4est_connectivity_t * conn,
+                              p4est_topidx_t which_tree,
+                              p4est_connectivity_row_t * row)
+{
+  int                 f;
+
+  row->which_tree = which_tree;
+  for (f = 0; f < P4EST_FACES; f++) {
+    row->tree_to_tree[f] = conn->tree_to_tree[which_tree * P4EST_FACES + f];
+    row->tree_to_face[f] = conn->tree_to_face[which_tree * P4EST_FACES + f];
+  }
+}
+
+/** Index of the first cached row with tree number >= \a which_tree. */
+static size_t
+p4est_connectivity_dist_position (sc_array_t * cached,
+                                  p4est_topidx_t which_tree)
+{
+  size_t              lo, hi, mid;
+  p4est_connectivity_row_t *row;
+
+  lo = 0;
+  hi = cached->elem_count;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    row = (p4est_connectivity_row_t *) sc_array_index (cached, mid);
+    if (row->which_tree < which_tree) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/** Insert a row into the sorted cache unless it is already present. */
+static p4est_connectivity_row_t *
+p4est_connectivity_dist_cache (p4est_connectivity_dist_t * dist,
+                               const p4est_connectivity_row_t * row)
+{
+  size_t              pos, old_count;
+  p4est_connectivity_row_t *ins;
+
+  old_count = dist->cached->elem_count;
+  pos = p4est_connectivity_dist_position (dist->cached, row->which_tree);
+  if (pos < old_count) {
+    ins = (p4est_connectivity_row_t *) sc_array_index (dist->cached, pos);
+    if (ins->which_tree == row->which_tree) {
+      return ins;
+    }
+  }
+  (void) sc_array_push (dist->cached);
+  ins = (p4est_connectivity_row_t *) sc_array_index (dist->cached, pos);
+  memmove (ins + 1, ins,
+           (old_count - pos) * sizeof (p4est_connectivity_row_t));
+  *ins = *row;
+  return ins;
+}
+
+p4est_connectivity_dist_t *
+p4est_connectivity_distribute (p4est_connectivity_t * conn,
+                               sc_MPI_Comm mpicomm,
+                               p4est_topidx_t cache_first,
+                               p4est_topidx_t cache_last)
+{
+  int                 mpiret;
+  int                 f;
+  p4est_topidx_t      t, nt, owned_end;
+  p4est_connectivity_dist_t *dist;
+  p4est_connectivity_row_t row, nrow;
+#ifdef P4EST_CONN_WINSHARED
+  p4est_connectivity_dist_context_t *dc;
+#endif
+
+  P4EST_ASSERT (p4est_connectivity_is_valid (conn));
+  P4EST_ASSERT (0 <= cache_first && cache_last < conn->num_trees);
+  P4EST_ASSERT (cache_first <= cache_last + 1);
+
+#ifdef P4EST_CONN_WINSHARED
+  dc = P4EST_ALLOC_ZERO (p4est_connectivity_dist_context_t, 1);
+  dist = &dc->dist;
+#else
+  dist = P4EST_ALLOC_ZERO (p4est_connectivity_dist_t, 1);
+#endif
+  dist->mpicomm = mpicomm;
+  mpiret = sc_MPI_Comm_size (mpicomm, &dist->mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (mpicomm, &dist->mpirank);
+  SC_CHECK_MPI (mpiret);
+  dist->num_trees = conn->num_trees;
+#ifdef P4EST_CONN_WINSHARED
+  dist->first_owned = p4est_connectivity_dist_begin (dist->num_trees,
+                                                     dist->mpisize,
+                                                     dist->mpirank);
+  dist->num_owned = p4est_connectivity_dist_begin (dist->num_trees,
+                                                   dist->mpisize,
+                                                   dist->mpirank + 1) -
+    dist->first_owned;
+#else
+  /* without RMA windows remote rows cannot be fetched on demand, so
+   * every process keeps all rows to preserve the query semantics */
+  dist->first_owned = 0;
+  dist->num_owned = dist->num_trees;
+#endif
+  owned_end = dist->first_owned + dist->num_owned;
+
+  dist->owned = P4EST_ALLOC (p4est_connectivity_row_t,
+                             (size_t) dist->num_owned);
+  for (t = 0; t < dist->num_owned; t++) {
+    p4est_connectivity_dist_fill (conn, dist->first_owned + t,
+                                  dist->owned + t);
+  }
+
+  /* seed the cache with the rows of the requested tree range and of
+   * everything reachable from it across one face */
+  dist->cached = sc_array_new (sizeof (p4est_connectivity_row_t));
+  for (t = cache_first; t <= cache_last; t++) {
+    p4est_connectivity_dist_fill (conn, t, &row);
+    if (t < dist->first_owned || t >= owned_end) {
+      (void) p4est_connectivity_dist_cache (dist, &row);
+    }
+    for (f = 0; f < P4EST_FACES; f++) {
+      nt = row.tree_to_tree[f];
+      if (nt >= dist->first_owned && nt < owned_end) {
+        continue;
+      }
+      if (nt >= cache_first && nt <= cache_last) {
+        /* seeded by its own pass of the outer loop */
+        continue;
+      }
+      p4est_connectivity_dist_fill (conn, nt, &nrow);
+      (void) p4est_connectivity_dist_cache (dist, &nrow);
+    }
+  }
+
+#ifdef P4EST_CONN_WINSHARED
+  /* expose the owned block for the on-demand fetches of other ranks */
+  mpiret = MPI_Win_create (dist->owned, (MPI_Aint)
+                           ((size_t) dist->num_owned *
+                            sizeof (p4est_connectivity_row_t)), 1,
+                           MPI_INFO_NULL, mpicomm, &dc->win);
+  SC_CHECK_MPI (mpiret);
+#endif
+
+  return dist;
+}
+
+void
+p4est_connectivity_dist_row (p4est_connectivity_dist_t * dist,
+                             p4est_topidx_t which_tree,
+                             p4est_topidx_t ttree[P4EST_FACES],
+                             int8_t tface[P4EST_FACES])
+{
+  int                 f;
+  size_t              pos;
+  p4est_connectivity_row_t *row;
+#ifdef P4EST_CONN_WINSHARED
+  int                 mpiret, owner;
+  MPI_Aint            disp;
+  p4est_connectivity_row_t fetched;
+  p4est_connectivity_dist_context_t *dc;
+#endif
+
+  P4EST_ASSERT (0 <= which_tree && which_tree < dist->num_trees);
+
+  if (which_tree >= dist->first_owned &&
+      which_tree < dist->first_owned + dist->num_owned) {
+    row = dist->owned + (which_tree - dist->first_owned);
+  }
+  else {
+    pos = p4est_connectivity_dist_position (dist->cached, which_tree);
+    if (pos < dist->cached->elem_count &&
+        ((p4est_connectivity_row_t *)
+         sc_array_index (dist->cached, pos))->which_tree == which_tree) {
+      row = (p4est_connectivity_row_t *) sc_array_index (dist->cached, pos);
+    }
+    else {
+#ifdef P4EST_CONN_WINSHARED
+      /* rare path: pull the row out of the owner's exposed block */
+      dc = (p4est_connectivity_dist_context_t *) dist;
+      owner = p4est_connectivity_dist_owner (dist, which_tree);
+      disp = (MPI_Aint) ((size_t)
+                         (which_tree -
+                          p4est_connectivity_dist_begin (dist->num_trees,
+                                                         dist->mpisize,
+                                                         owner)) *
+                         sizeof (p4est_connectivity_row_t));
+      mpiret = MPI_Win_lock (MPI_LOCK_SHARED, owner, 0, dc->win);
+      SC_CHECK_MPI (mpiret);
+      mpiret = MPI_Get (&fetched, (int) sizeof (p4est_connectivity_row_t),
+                        MPI_BYTE, owner, disp,
+                        (int) sizeof (p4est_connectivity_row_t), MPI_BYTE,
+                        dc->win);
+      SC_CHECK_MPI (mpiret);
+      mpiret = MPI_Win_unlock (owner, dc->win);
+      SC_CHECK_MPI (mpiret);
+      P4EST_ASSERT (fetched.which_tree == which_tree);
+      ++dist->num_fetches;
+      row = p4est_connectivity_dist_cache (dist, &fetched);
+#else
+      /* all rows are held locally in this configuration */
+      SC_ABORT_NOT_REACHED ();
+#endif
+    }
+  }
+
+  for (f = 0; f < P4EST_FACES; f++) {
+    ttree[f] = row->tree_to_tree[f];
+    tface[f] = row->tree_to_face[f];
+  }
+}
+
+void
+p4est_connectivity_dist_destroy (p4est_connectivity_dist_t * dist)
+{
+#ifdef P4EST_CONN_WINSHARED
+  int                 mpiret;
+  p4est_connectivity_dist_context_t *dc =
+    (p4est_connectivity_dist_context_t *) dist;
+
+  mpiret = MPI_Win_free (&dc->win);
+  SC_CHECK_MPI (mpiret);
+#endif
+  P4EST_VERBOSEF ("Distributed connectivity fetched %ld remote rows\n",
+                  dist->num_fetches);
+  sc_array_destroy (dist->cached);
+  P4EST_FREE (dist->owned);
+  P4EST_FREE (dist);
+}
+
 #ifndef P4_TO_P8
 
 p4est_connectivity_t *
@@ -2136,6 +2968,20 @@ p8est_connectivity_new_brick (int mi, int ni, int pi, int periodic_a,
   P4EST_ASSERT (tl == num_edges);
 #endif
 
+  /* Every iteration computes the neighbors of its own tree by index
+   * arithmetic and writes entries of the adjacency tables that no other
+   * iteration touches, so the fill is distributed across threads.  Only
+   * the vertex numbering below depends on the iteration order. */
+#ifdef P4EST_ENABLE_OPENMP
+#ifndef P4_TO_P8
+#pragma omp parallel for schedule (static) \
+  private (tj, tx, ty, coord, coord2, tf, tc, i, j, l, ttemp, c)
+#else
+#pragma omp parallel for schedule (static) \
+  private (tj, tx, ty, tz, coord, coord2, tf, te, tc, i, j, l, ttemp, \
+           dir1, dir2, c)
+#endif
+#endif
   for (ti = 0; ti < n_iter; ti++) {
     brick_linear_to_xyz (ti, logx, rankx, coord);
     tx = coord[0];
@@ -2317,20 +3163,47 @@ p8est_connectivity_new_brick (int mi, int ni, int pi, int periodic_a,
                              (P4EST_CHILDREN - 1 - i)] = (int8_t) i;
           }
         }
+      }
+    }
+  }
+
+  /* The vertex numbering copies values from face neighbors assigned
+   * earlier in the space filling order, so it runs after the threaded
+   * fill and stays serial.  Away from the domain boundary the face
+   * entries of tree_to_tree computed above are exactly the neighbors
+   * that the serial pass needs. */
+  for (ti = 0; ti < n_iter; ti++) {
+    brick_linear_to_xyz (ti, logx, rankx, coord);
+    tx = coord[0];
+    ty = coord[1];
+#ifdef P4_TO_P8
+    tz = coord[2];
+#endif
+    if (tx < m && ty < n &&
+#ifdef P4_TO_P8
+        tz < p &&
+#endif
+        1) {
+      tj = linear_to_tree[ti];
+      P4EST_ASSERT (tj >= 0);
+      for (i = 0; i < P4EST_CHILDREN; i++) {
 #ifdef P4_TO_P8
         if (tz > 0 && (i >> 2) == 0) {
           tree_to_vertex[tj * P4EST_CHILDREN + i] =
-            tree_to_vertex[tf[4] * P4EST_CHILDREN + i + 4];
+            tree_to_vertex[tree_to_tree[tj * P4EST_FACES + 4] *
+                           P4EST_CHILDREN + i + 4];
         }
         else
 #endif
         if (ty > 0 && ((i >> 1) & 1) == 0) {
           tree_to_vertex[tj * P4EST_CHILDREN + i] =
-            tree_to_vertex[tf[2] * P4EST_CHILDREN + i + 2];
+            tree_to_vertex[tree_to_tree[tj * P4EST_FACES + 2] *
+                           P4EST_CHILDREN + i + 2];
         }
         else if (tx > 0 && (i & 1) == 0) {
           tree_to_vertex[tj * P4EST_CHILDREN + i] =
-            tree_to_vertex[tf[0] * P4EST_CHILDREN + i + 1];
+            tree_to_vertex[tree_to_tree[tj * P4EST_FACES + 0] *
+                           P4EST_CHILDREN + i + 1];
         }
         else {
           tree_to_vertex[tj * P4EST_CHILDREN + i] = vcount++;
@@ -2568,14 +3441,49 @@ p4est_expand_face_transform_internal (int iface, int target_face,
 #endif
 }
 
+/** Cache of all face transformations, filled on first use.
+ * The transformation depends only on the face, the neighbor face, and
+ * the orientation, so the full domain fits into this small table and
+ * inter-tree neighbor queries reduce to a copy out of it.
+ */
+static int          p4est_ftransform_table
+  [P4EST_FACES][P4EST_FACES][P4EST_HALF][9];
+static int          p4est_ftransform_ready = 0;
+
+static void
+p4est_expand_face_transform_cached (int iface, int target_face,
+                                    int orientation, int ftransform[])
+{
+  int                 fi, ft, o;
+
+  if (!p4est_ftransform_ready) {
+    for (fi = 0; fi < P4EST_FACES; ++fi) {
+      for (ft = 0; ft < P4EST_FACES; ++ft) {
+        for (o = 0; o < P4EST_HALF; ++o) {
+          p4est_expand_face_transform_internal
+            (fi, ft, o, p4est_ftransform_table[fi][ft][o]);
+        }
+      }
+    }
+    p4est_ftransform_ready = 1;
+  }
+
+  P4EST_ASSERT (0 <= iface && iface < P4EST_FACES);
+  P4EST_ASSERT (0 <= target_face && target_face < P4EST_FACES);
+  P4EST_ASSERT (0 <= orientation && orientation < P4EST_HALF);
+
+  memcpy (ftransform, p4est_ftransform_table[iface][target_face][orientation],
+          9 * sizeof (int));
+}
+
 void
 p4est_expand_face_transform (int iface, int nface, int ftransform[])
 {
   const int           target_face = nface % P4EST_FACES;
   const int           orientation = nface / P4EST_FACES;
 
-  p4est_expand_face_transform_internal (iface, target_face, orientation,
-                                        ftransform);
+  p4est_expand_face_transform_cached (iface, target_face, orientation,
+                                      ftransform);
 }
 
 p4est_topidx_t
@@ -2598,8 +3506,8 @@ p4est_find_face_transform (p4est_connectivity_t * connectivity,
     return -1;
   }
 
-  p4est_expand_face_transform_internal (iface, target_face, orientation,
-                                        ftransform);
+  p4est_expand_face_transform_cached (iface, target_face, orientation,
+                                      ftransform);
 
   return target_tree;
 }
@@ -2619,7 +3527,7 @@ p4est_find_corner_transform_internal (p4est_connectivity_t * conn,
   p4est_topidx_t      ctree, nctree;
 #ifdef P4_TO_P8
   int                 iedge, iwhich, k;
-  int                 pref, pset;
+  int                 pset;
   size_t              jz;
   p4est_topidx_t      aedge;
   p8est_edge_info_t   ei;
@@ -2652,8 +3560,7 @@ p4est_find_corner_transform_internal (p4est_connectivity_t * conn,
       fcorner = p4est_corner_face_corners[icorner][iface];
       P4EST_ASSERT (fcorner >= 0);
 #ifdef P4_TO_P8
-      pref = p8est_face_permutation_refs[iface][nface];
-      pset = p8est_face_permutation_sets[pref][orient];
+      pset = p8est_face_permutation_orientations[iface][nface][orient];
       fc = p8est_face_permutations[pset][fcorner];
 #else
       fc = fcorner ^ orient;
@@ -3218,6 +4125,27 @@ p4est_connectivity_reduce (p4est_connectivity_t * conn)
   P4EST_ASSERT (p4est_connectivity_is_valid (conn));
 }
 
+void
+p4est_connectivity_require_corners (p4est_connectivity_t * conn)
+{
+  P4EST_ASSERT (p4est_connectivity_is_valid (conn));
+
+  if (conn->tree_to_corner != NULL
+#ifdef P4_TO_P8
+      && conn->tree_to_edge != NULL
+#endif
+    ) {
+    /* the adjacency tables are already present */
+    return;
+  }
+
+  /* completion matches corners across trees by their vertex numbers */
+  SC_CHECK_ABORT (conn->num_vertices > 0 && conn->tree_to_vertex != NULL,
+                  P4EST_STRING
+                  "_connectivity_require_corners needs vertex information");
+  p4est_connectivity_complete (conn);
+}
+
 void
 p4est_connectivity_permute (p4est_connectivity_t * conn, sc_array_t * inperm,
                             int is_current_to_new)
@@ -3689,7 +4617,6 @@ p8est_connectivity_store_edge (p4est_connectivity_t * conn, p4est_topidx_t t,
     int                 nf = conn->tree_to_face[P4EST_FACES * t + f];
     int                 o, c[2], nc[2];
     int                 ne;
-    int                 ref;
     int                 set;
     int                 j;
     int                 diff;
@@ -3700,8 +4627,7 @@ p8est_connectivity_store_edge (p4est_connectivity_t * conn, p4est_topidx_t t,
     if (t == nt && f == nf) {
       continue;
     }
-    ref = p8est_face_permutation_refs[f][nf];
-    set = p8est_face_permutation_sets[ref][o];
+    set = p8est_face_permutation_orientations[f][nf][o];
 
     for (j = 0; j < 2; j++) {
       c[j] = p8est_edge_corners[e][j];
@@ -3959,7 +4885,7 @@ p4est_connectivity_join_faces (p4est_connectivity_t * conn,
                                int face_left, int face_right, int orientation)
 {
 #ifdef P4_TO_P8
-  int                 ref, set, j;
+  int                 set, j;
 #endif
   int                 i;
 
@@ -3980,8 +4906,8 @@ p4est_connectivity_join_faces (p4est_connectivity_t * conn,
 
 #ifdef P4_TO_P8
   /* figure out which edges are next to each other */
-  ref = p8est_face_permutation_refs[face_left][face_right];
-  set = p8est_face_permutation_sets[ref][orientation];
+  set = p8est_face_permutation_orientations[face_left][face_right]
+    [orientation];
   for (i = 0; i < 4; i++) {
     int                 c[2], e_left, e_right, e_orient;
 
@@ -0,0 +1,233 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/** \file p4est_dim_dispatch.h
+ *
+ * Dimension-generic access to the hottest quadrant primitives.
+ *
+ * The library compiles every algorithm once per dimension, which
+ * leaves a caller that handles both dimensions with a branch and a
+ * shared-library call on every quadrant.  This header provides the
+ * comparison, linear id and face neighbor primitives as static inline
+ * functions for both dimensions, plus thin dispatchers on a runtime
+ * dimension argument, so per-quadrant inner loops inline the bit
+ * arithmetic instead of calling across the library boundary.  The
+ * inline variants implement the portable code path and omit the
+ * debug assertions of their library counterparts; results are
+ * identical.
+ */
+
+#ifndef P4EST_DIM_DISPATCH_H
+#define P4EST_DIM_DISPATCH_H
+
+#include <p4est.h>
+#include <p8est.h>
+
+SC_EXTERN_C_BEGIN;
+
+/** Inline equivalent of the 2D \ref p4est_quadrant_compare. */
+static inline int
+p4est_inline_quadrant_compare (const p4est_quadrant_t * q1,
+                               const p4est_quadrant_t * q2)
+{
+  uint32_t            exclorx, exclory, exclor;
+  int64_t             p1, p2, diff;
+
+  /* these are unsigned variables that inherit the sign bits */
+  exclorx = q1->x ^ q2->x;
+  exclory = q1->y ^ q2->y;
+  exclor = exclorx | exclory;
+
+  if (!exclor) {
+    return (int) q1->level - (int) q2->level;
+  }
+
+  if (exclory > (exclor ^ exclory)) {
+    p1 = q1->y + ((q1->y >= 0) ? 0 : ((int64_t) 1 << (P4EST_MAXLEVEL + 2)));
+    p2 = q2->y + ((q2->y >= 0) ? 0 : ((int64_t) 1 << (P4EST_MAXLEVEL + 2)));
+  }
+  else {
+    p1 = q1->x + ((q1->x >= 0) ? 0 : ((int64_t) 1 << (P4EST_MAXLEVEL + 2)));
+    p2 = q2->x + ((q2->x >= 0) ? 0 : ((int64_t) 1 << (P4EST_MAXLEVEL + 2)));
+  }
+  diff = p1 - p2;
+  return (diff == 0) ? 0 : ((diff < 0) ? -1 : 1);
+}
+
+/** Inline equivalent of the 3D \ref p8est_quadrant_compare. */
+static inline int
+p8est_inline_quadrant_compare (const p8est_quadrant_t * q1,
+                               const p8est_quadrant_t * q2)
+{
+  uint32_t            exclorx, exclory, exclorz, exclorxy, exclor;
+  int64_t             p1, p2, diff;
+
+  /* these are unsigned variables that inherit the sign bits */
+  exclorx = q1->x ^ q2->x;
+  exclory = q1->y ^ q2->y;
+  exclorxy = exclorx | exclory;
+  exclorz = q1->z ^ q2->z;
+  exclor = exclorxy | exclorz;
+
+  if (!exclor) {
+    return (int) q1->level - (int) q2->level;
+  }
+
+  /* if exclorz tops (exclor ^ exclorz), z owns the most significant bit */
+  if (exclorz > (exclor ^ exclorz)) {
+    p1 = q1->z + ((q1->z >= 0) ? 0 : ((int64_t) 1 << (P8EST_MAXLEVEL + 2)));
+    p2 = q2->z + ((q2->z >= 0) ? 0 : ((int64_t) 1 << (P8EST_MAXLEVEL + 2)));
+  }
+  else if (exclory > (exclorxy ^ exclory)) {
+    p1 = q1->y + ((q1->y >= 0) ? 0 : ((int64_t) 1 << (P8EST_MAXLEVEL + 2)));
+    p2 = q2->y + ((q2->y >= 0) ? 0 : ((int64_t) 1 << (P8EST_MAXLEVEL + 2)));
+  }
+  else {
+    p1 = q1->x + ((q1->x >= 0) ? 0 : ((int64_t) 1 << (P8EST_MAXLEVEL + 2)));
+    p2 = q2->x + ((q2->x >= 0) ? 0 : ((int64_t) 1 << (P8EST_MAXLEVEL + 2)));
+  }
+  diff = p1 - p2;
+  return (diff == 0) ? 0 : ((diff < 0) ? -1 : 1);
+}
+
+/** Inline equivalent of the 2D \ref p4est_quadrant_linear_id. */
+static inline uint64_t
+p4est_inline_quadrant_linear_id (const p4est_quadrant_t * quadrant,
+                                 int level)
+{
+  int                 i;
+  uint64_t            id;
+  uint64_t            x, y;
+
+  /* this preserves the high bits from negative numbers */
+  x = quadrant->x >> (P4EST_MAXLEVEL - level);
+  y = quadrant->y >> (P4EST_MAXLEVEL - level);
+
+  id = 0;
+  for (i = 0; i < level + 2; ++i) {
+    id |= ((x & ((uint64_t) 1 << i)) << i);
+    id |= ((y & ((uint64_t) 1 << i)) << (i + 1));
+  }
+
+  return id;
+}
+
+/** Inline equivalent of the 3D \ref p8est_quadrant_linear_id. */
+static inline uint64_t
+p8est_inline_quadrant_linear_id (const p8est_quadrant_t * quadrant,
+                                 int level)
+{
+  int                 i;
+  uint64_t            id;
+  uint64_t            x, y, z;
+
+  /* this preserves the high bits from negative numbers */
+  x = quadrant->x >> (P8EST_MAXLEVEL - level);
+  y = quadrant->y >> (P8EST_MAXLEVEL - level);
+  z = quadrant->z >> (P8EST_MAXLEVEL - level);
+
+  id = 0;
+  for (i = 0; i < level + 2; ++i) {
+    id |= ((x & ((uint64_t) 1 << i)) << (2 * i));
+    id |= ((y & ((uint64_t) 1 << i)) << (2 * i + 1));
+    id |= ((z & ((uint64_t) 1 << i)) << (2 * i + 2));
+  }
+
+  return id;
+}
+
+/** Inline equivalent of the 2D \ref p4est_quadrant_face_neighbor. */
+static inline void
+p4est_inline_quadrant_face_neighbor (const p4est_quadrant_t * q,
+                                     int face, p4est_quadrant_t * r)
+{
+  const p4est_qcoord_t qh = P4EST_QUADRANT_LEN (q->level);
+
+  r->x = q->x + ((face == 0) ? -qh : (face == 1) ? qh : 0);
+  r->y = q->y + ((face == 2) ? -qh : (face == 3) ? qh : 0);
+  r->level = q->level;
+}
+
+/** Inline equivalent of the 3D \ref p8est_quadrant_face_neighbor. */
+static inline void
+p8est_inline_quadrant_face_neighbor (const p8est_quadrant_t * q,
+                                     int face, p8est_quadrant_t * r)
+{
+  const p4est_qcoord_t qh = P8EST_QUADRANT_LEN (q->level);
+
+  r->x = q->x + ((face == 0) ? -qh : (face == 1) ? qh : 0);
+  r->y = q->y + ((face == 2) ? -qh : (face == 3) ? qh : 0);
+  r->z = q->z + ((face == 4) ? -qh : (face == 5) ? qh : 0);
+  r->level = q->level;
+}
+
+/** Compare two quadrants of a runtime dimension in Morton order.
+ * \param [in] dim      Either 2 or 3.
+ * \param [in] v1, v2   Point to p4est_quadrant_t for \a dim 2 and to
+ *                      p8est_quadrant_t for \a dim 3.
+ */
+static inline int
+p4est_dim_dispatch_quadrant_compare (int dim, const void *v1,
+                                     const void *v2)
+{
+  return dim == 2 ?
+    p4est_inline_quadrant_compare ((const p4est_quadrant_t *) v1,
+                                   (const p4est_quadrant_t *) v2) :
+    p8est_inline_quadrant_compare ((const p8est_quadrant_t *) v1,
+                                   (const p8est_quadrant_t *) v2);
+}
+
+/** Linear id of a quadrant of a runtime dimension.
+ * The argument conventions follow
+ * \ref p4est_dim_dispatch_quadrant_compare.
+ */
+static inline uint64_t
+p4est_dim_dispatch_quadrant_linear_id (int dim, const void *v, int level)
+{
+  return dim == 2 ?
+    p4est_inline_quadrant_linear_id ((const p4est_quadrant_t *) v, level) :
+    p8est_inline_quadrant_linear_id ((const p8est_quadrant_t *) v, level);
+}
+
+/** Face neighbor of a quadrant of a runtime dimension.
+ * The argument conventions follow
+ * \ref p4est_dim_dispatch_quadrant_compare.
+ */
+static inline void
+p4est_dim_dispatch_quadrant_face_neighbor (int dim, const void *v,
+                                           int face, void *r)
+{
+  if (dim == 2) {
+    p4est_inline_quadrant_face_neighbor ((const p4est_quadrant_t *) v,
+                                         face, (p4est_quadrant_t *) r);
+  }
+  else {
+    p8est_inline_quadrant_face_neighbor ((const p8est_quadrant_t *) v,
+                                         face, (p8est_quadrant_t *) r);
+  }
+}
+
+SC_EXTERN_C_END;
+
+#endif /* !P4EST_DIM_DISPATCH_H */
@@ -0,0 +1,141 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4_TO_P8
+#include <p4est_ensemble.h>
+#else
+#include <p8est_ensemble.h>
+#endif
+
+p4est_ensemble_t   *
+p4est_ensemble_new (p4est_t * structure, int num_members, size_t data_size)
+{
+  int                 m;
+  size_t              bytes;
+  p4est_ensemble_t   *ensemble;
+
+  P4EST_ASSERT (p4est_is_valid (structure));
+  P4EST_ASSERT (num_members > 0);
+
+  ensemble = P4EST_ALLOC (p4est_ensemble_t, 1);
+  ensemble->structure = structure;
+  ensemble->num_members = num_members;
+  ensemble->data_size = data_size;
+  ensemble->revision = p4est_revision (structure);
+  ensemble->member_data = P4EST_ALLOC (char *, num_members);
+  ensemble->forked = P4EST_ALLOC (p4est_t *, num_members);
+  bytes = (size_t) structure->local_num_quadrants * data_size;
+  for (m = 0; m < num_members; ++m) {
+    ensemble->member_data[m] =
+      data_size > 0 ? P4EST_ALLOC_ZERO (char, bytes) : NULL;
+    ensemble->forked[m] = NULL;
+  }
+
+  return ensemble;
+}
+
+p4est_t            *
+p4est_ensemble_forest (p4est_ensemble_t * ensemble, int member)
+{
+  P4EST_ASSERT (ensemble != NULL);
+  P4EST_ASSERT (0 <= member && member < ensemble->num_members);
+
+  return ensemble->forked[member] != NULL ?
+    ensemble->forked[member] : ensemble->structure;
+}
+
+void               *
+p4est_ensemble_data (p4est_ensemble_t * ensemble, int member,
+                     p4est_locidx_t local_num)
+{
+  P4EST_ASSERT (ensemble != NULL);
+  P4EST_ASSERT (0 <= member && member < ensemble->num_members);
+  P4EST_ASSERT (ensemble->data_size > 0);
+  P4EST_ASSERT (0 <= local_num && local_num <
+                p4est_ensemble_forest (ensemble,
+                                       member)->local_num_quadrants);
+
+  return ensemble->member_data[member] +
+    (size_t) local_num * ensemble->data_size;
+}
+
+p4est_t            *
+p4est_ensemble_fork (p4est_ensemble_t * ensemble, int member)
+{
+  P4EST_ASSERT (ensemble != NULL);
+  P4EST_ASSERT (0 <= member && member < ensemble->num_members);
+
+  if (ensemble->forked[member] == NULL) {
+    /* the shared structure must not have changed under the ensemble */
+    P4EST_ASSERT (p4est_revision (ensemble->structure) ==
+                  ensemble->revision);
+    ensemble->forked[member] =
+      p4est_copy (ensemble->structure, 0 /* don't copy data */ );
+  }
+
+  return ensemble->forked[member];
+}
+
+int
+p4est_ensemble_is_forked (p4est_ensemble_t * ensemble, int member)
+{
+  P4EST_ASSERT (ensemble != NULL);
+  P4EST_ASSERT (0 <= member && member < ensemble->num_members);
+
+  return ensemble->forked[member] != NULL;
+}
+
+void
+p4est_ensemble_reset_data (p4est_ensemble_t * ensemble, int member)
+{
+  size_t              bytes;
+
+  P4EST_ASSERT (ensemble != NULL);
+  P4EST_ASSERT (0 <= member && member < ensemble->num_members);
+  P4EST_ASSERT (ensemble->data_size > 0);
+
+  bytes = (size_t)
+    p4est_ensemble_forest (ensemble, member)->local_num_quadrants *
+    ensemble->data_size;
+  P4EST_FREE (ensemble->member_data[member]);
+  ensemble->member_data[member] = P4EST_ALLOC_ZERO (char, bytes);
+}
+
+void
+p4est_ensemble_destroy (p4est_ensemble_t * ensemble)
+{
+  int                 m;
+
+  P4EST_ASSERT (ensemble != NULL);
+
+  for (m = 0; m < ensemble->num_members; ++m) {
+    if (ensemble->forked[m] != NULL) {
+      p4est_destroy (ensemble->forked[m]);
+    }
+    P4EST_FREE (ensemble->member_data[m]);
+  }
+  P4EST_FREE (ensemble->forked);
+  P4EST_FREE (ensemble->member_data);
+  P4EST_FREE (ensemble);
+}
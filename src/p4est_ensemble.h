@@ -0,0 +1,139 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4EST_ENSEMBLE_H
+#define P4EST_ENSEMBLE_H
+
+/** \file p4est_ensemble.h
+ * An ensemble container for many forests that share one refinement
+ * structure.  All members reference a single structural forest and keep
+ * only their per-quadrant payload in private flat arrays, so the mesh
+ * memory and the adaptation cost are paid once for the whole ensemble.
+ * A member whose refinement needs to diverge is forked into a private
+ * forest on demand; the remaining members continue to share.
+ */
+
+#include <p4est.h>
+
+SC_EXTERN_C_BEGIN;
+
+/** Ensemble of forests sharing one structural forest. */
+typedef struct p4est_ensemble
+{
+  p4est_t            *structure;        /**< Shared structural forest;
+                                             borrowed, not owned. */
+  int                 num_members;      /**< Number of ensemble members. */
+  size_t              data_size;        /**< Per-quadrant payload bytes
+                                             of every member. */
+  long                revision;         /**< Revision of \a structure
+                                             when the ensemble was
+                                             created. */
+  char              **member_data;      /**< Per member: flat array of
+                                             local_num_quadrants payload
+                                             entries, or NULL if the
+                                             data size is zero. */
+  p4est_t           **forked;           /**< Per member: private forest
+                                             after divergence, or NULL
+                                             while still sharing the
+                                             structure. */
+}
+p4est_ensemble_t;
+
+/** Create an ensemble of members sharing one structural forest.
+ * The per-member payload arrays are allocated and zeroed; their entries
+ * correspond to the local quadrants of the structural forest in order.
+ * \param [in] structure    Valid forest providing the shared structure.
+ *                          It is borrowed and must outlive the ensemble
+ *                          unmutated, except through member forks.
+ * \param [in] num_members  Strictly positive number of members.
+ * \param [in] data_size    Payload bytes per quadrant and member.
+ *                          May be zero for structure-only ensembles.
+ * \return                  Fully initialized ensemble.
+ */
+p4est_ensemble_t   *p4est_ensemble_new (p4est_t * structure,
+                                        int num_members, size_t data_size);
+
+/** Access the forest seen by one member.
+ * \param [in] ensemble     Valid ensemble.
+ * \param [in] member       Member number in [0, num_members).
+ * \return                  The member's private fork if it has
+ *                          diverged and the shared structural forest
+ *                          otherwise.  Do not mutate a shared forest
+ *                          through this pointer; fork first.
+ */
+p4est_t            *p4est_ensemble_forest (p4est_ensemble_t * ensemble,
+                                           int member);
+
+/** Access one member's payload for one local quadrant.
+ * \param [in] ensemble     Valid ensemble with positive data size.
+ * \param [in] member       Member number in [0, num_members).
+ * \param [in] local_num    Quadrant index relative to the process-local
+ *                          storage of the member's forest.
+ * \return                  Pointer to data_size writable bytes.
+ */
+void               *p4est_ensemble_data (p4est_ensemble_t * ensemble,
+                                         int member,
+                                         p4est_locidx_t local_num);
+
+/** Fork one member into a private structural forest.
+ * The shared structure is deep-copied by \ref p4est_copy without user
+ * data, after which the member may be refined, coarsened, balanced,
+ * and partitioned independently of the ensemble.  The member's payload
+ * array is untouched: at fork time the copy has the identical quadrant
+ * order, so existing entries remain valid.  Forking an already forked
+ * member is a noop.
+ * \param [in,out] ensemble Valid ensemble.
+ * \param [in] member       Member number in [0, num_members).
+ * \return                  The member's private forest.
+ */
+p4est_t            *p4est_ensemble_fork (p4est_ensemble_t * ensemble,
+                                         int member);
+
+/** Query whether a member has been forked.
+ * \param [in] ensemble     Valid ensemble.
+ * \param [in] member       Member number in [0, num_members).
+ * \return                  True after \ref p4est_ensemble_fork.
+ */
+int                 p4est_ensemble_is_forked (p4est_ensemble_t * ensemble,
+                                              int member);
+
+/** Reallocate one member's payload array to its forest's current size.
+ * Call after adapting or partitioning a forked member.  The new array
+ * is zeroed: transferring values across an adaptation is up to the
+ * application, just as with the replace callbacks of the core library.
+ * \param [in,out] ensemble Valid ensemble with positive data size.
+ * \param [in] member       Member number in [0, num_members).
+ */
+void                p4est_ensemble_reset_data (p4est_ensemble_t * ensemble,
+                                               int member);
+
+/** Free an ensemble, its payload arrays, and all member forks.
+ * The shared structural forest is not touched.
+ * \param [in,out] ensemble Ensemble to deallocate.
+ */
+void                p4est_ensemble_destroy (p4est_ensemble_t * ensemble);
+
+SC_EXTERN_C_END;
+
+#endif /* !P4EST_ENSEMBLE_H */
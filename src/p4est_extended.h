@@ -55,6 +55,72 @@ SC_EXTERN_C_BEGIN;
  * whenever an inspect structure is present in p4est.
  */
 /* TODO: Describe the purpose of various switches, counters, and timings. */
+/** Opt-in scratch space that is retained across adaptation and
+ * iteration calls.
+ * Attach it through \ref p4est_inspect to avoid reallocating the
+ * temporary structures of refine, balance, and iterate in tight loops.
+ * Create with \ref p4est_workspace_new; the caller must destroy it
+ * with \ref p4est_workspace_destroy after detaching it.
+ */
+typedef struct p4est_workspace
+{
+  sc_list_t          *refine_list;      /**< quadrant stack reused by
+                                             refine between calls */
+  sc_array_t         *balance_borders;  /**< per-tree border arrays
+                                             reused by balance */
+  void               *iter_loop_args;   /**< search-state arrays reused by
+                                             \ref p4est_iterate between
+                                             calls; opaque to the caller
+                                             and managed by the iterator */
+  void              (*iter_loop_args_destroy) (void *data);
+                                        /**< teardown function matching
+                                             \b iter_loop_args */
+}
+p4est_workspace_t;
+
+/** Allocate an empty workspace; its buffers are created on first use. */
+p4est_workspace_t    *p4est_workspace_new (void);
+
+/** Release a workspace and all buffers it has accumulated. */
+void                p4est_workspace_destroy (p4est_workspace_t * ws);
+
+/** One entry of the optional change journal.
+ * The quadrant range [\b first, \b last] is inclusive and stored as
+ * descendants of level \ref P4EST_QMAXLEVEL, so it describes a Morton
+ * interval independent of the refinement pattern inside the region.
+ */
+typedef struct p4est_journal_entry
+{
+  long                revision;     /**< revision of the forest when the
+                                         logging operation began */
+  p4est_topidx_t      which_tree;   /**< tree containing the range */
+  p4est_quadrant_t    first;        /**< first affected position */
+  p4est_quadrant_t    last;         /**< last affected position */
+}
+p4est_journal_entry_t;
+
+/** One contiguous run of quadrants kept or moved by a repartition. */
+typedef struct p4est_migrate_range
+{
+  int                 from_rank;    /**< owner before the partition */
+  int                 to_rank;      /**< owner after the partition */
+  p4est_locidx_t      old_first;    /**< first local index before the
+                                         partition; -1 unless this rank
+                                         is \b from_rank */
+  p4est_locidx_t      new_first;    /**< first local index after the
+                                         partition; -1 unless this rank
+                                         is \b to_rank */
+  p4est_locidx_t      count;        /**< quadrants in the range */
+}
+p4est_migrate_range_t;
+
+/** Callback to migrate external per-quadrant arrays over a partition.
+ * See the migrate hooks in \ref p4est_inspect for when it is called.
+ */
+typedef void        (*p4est_migrate_fn_t) (p4est_t * p4est,
+                                           const p4est_migrate_range_t *
+                                           range, void *user);
+
 struct p4est_inspect
 {
   /** Use sc_ranges to determine the asymmetric communication pattern.
@@ -65,6 +131,20 @@ struct p4est_inspect
   int                 use_balance_ranges_notify;
   /** Verify sc_ranges and/or sc_notify as applicable. */
   int                 use_balance_verify;
+  /** If set, balance auto-tunes the communication pattern instead of
+   * relying on a hand-set \a use_balance_ranges: the first measured
+   * calls alternate between sc_notify and sc_ranges, their
+   * communication times are summed over all processes, and the faster
+   * pattern is locked in.  The measurement reopens when the global
+   * quadrant count moves by more than a factor of two from the
+   * workload it was taken on.  Must be set on all processes or none. */
+  int                 balance_autotune;
+  int                 balance_autotune_calls;   /**< measured calls so far */
+  double              balance_autotune_cost[2]; /**< local seconds spent by
+                                                     notify [0], ranges [1]
+                                                     while measuring */
+  /** Global quadrant count at lock-in; 0 while measuring. */
+  p4est_gloidx_t      balance_autotune_quads;
   /** If positive and smaller than p4est_num ranges, overrides it */
   int                 balance_max_ranges;
   size_t              balance_A_count_in;
@@ -82,8 +162,109 @@ struct p4est_inspect
   /** time spent in sc_notify_allgather */
   double              balance_notify_allgather;
   int                 use_B;
+  /** Cumulative hot-path statistics, updated whenever an inspect
+   * structure is attached; aggregate with \ref p4est_inspect_report.
+   * The caller may zero individual fields between measurement windows. */
+  double              ghost_new_time;   /**< seconds in ghost_new */
+  double              partition_time;   /**< seconds in partition_given */
+  double              lnodes_time;      /**< seconds in lnodes_new */
+  double              iterate_time;     /**< seconds in iterate */
+  size_t              ghost_comm_sent;  /**< quadrant bytes sent by
+                                             ghost_new */
+  size_t              partition_comm_sent;      /**< buffer bytes sent by
+                                                     partition_given */
+  /** Local memory high-water marks in bytes, estimated from the forest
+   * storage and message buffers at the phase boundaries of balance and
+   * partition; aggregate with \ref p4est_memory_report. */
+  size_t              balance_memory_peak;
+  size_t              partition_memory_peak;
+  /** If positive, \ref p4est_refine_ext stops splitting quadrants once
+   * the estimated local forest storage would exceed this many bytes.
+   * The refinement then finishes with a valid, partially refined forest
+   * and sets \a memory_budget_hit instead of overrunning the memory. */
+  size_t              memory_budget;
+  /** Set whenever the memory budget cut a refinement short. */
+  int                 memory_budget_hit;
+  /** If nonzero, \ref p4est_refine_ext and \ref p4est_coarsen_ext do
+   * not invoke the replace callback interleaved with the tree surgery.
+   * Instead they record every replaced family and run the callback in
+   * one dense batched phase per tree after the structural pass, which
+   * keeps user interpolation and tree modification out of each other's
+   * caches.  Incoming quadrants that are final leaves are passed as
+   * pointers into the tree storage, so callback modifications stick;
+   * quadrants that only exist between recursive passes are passed as
+   * stable copies, matching the lifetime rules of the immediate mode.
+   * With the value 1 the callback runs in recording order; with 2 the
+   * batched loop may additionally be threaded, in which case the
+   * callback must be safe to call concurrently and in any order. */
+  int                 replace_defer;
+  /** If nonzero, \ref p4est_lnodes_new may resolve the node numbers
+   * received from different peer processes on concurrent threads.  The
+   * messages are drained serially first; each peer's resolution writes
+   * only to that peer's node entries, and the shared sharers array is
+   * concatenated serially in arrival order afterwards, so the result
+   * does not depend on the thread count. */
+  int                 lnodes_recv_threads;
+  /** Growth history consumed by \ref p4est_reserve_quadrants: the
+   * revision and local quadrant count recorded at its last call.
+   * Maintained by that function itself; both start out zero. */
+  long                prealloc_revision;
+  p4est_locidx_t      prealloc_quadrants;
+  /** Optional scratch space retained across adapt calls; NULL by
+   * default and never created or destroyed by p4est itself. */
+  p4est_workspace_t  *workspace;
+  /** Optional change journal; NULL by default.  If the caller attaches
+   * an sc_array of \ref p4est_journal_entry_t, then refine, coarsen,
+   * balance, and partition append the Morton intervals they modify.
+   * The array is owned by the caller, who truncates it after consuming
+   * the entries; p4est itself only ever appends. */
+  sc_array_t         *journal;
+  /** Optional hooks to migrate application arrays that are indexed by
+   * local quadrant number across \ref p4est_partition.  If either is
+   * set, the partition derives the contiguous old-to-new quadrant
+   * ranges and calls \a migrate_pre_fn once per range while the old
+   * layout is still valid, so sends out of the old array can be
+   * posted, and \a migrate_post_fn once per range after the new
+   * layout is in place, so receives into the new array and copies of
+   * the ranges that stayed local can complete.  Both see the same
+   * ranges in the same order: first the ranges owned before the
+   * partition in ascending order of their new owner, then the ranges
+   * arriving from other processes in ascending order of their old
+   * owner; the range that stays on this process is listed once. */
+  p4est_migrate_fn_t  migrate_pre_fn;
+  p4est_migrate_fn_t  migrate_post_fn;
+  /** Passed through to the migrate hooks. */
+  void               *migrate_user;
 };
 
+/** Aggregate and log the hot-path statistics of the attached inspect
+ * structure over all processors via sc_statistics.
+ * Collective over \a p4est->mpicomm; prints at priority SC_LP_STATISTICS.
+ * Does nothing if no inspect structure is attached.
+ * \param [in] p4est   Forest with a valid communicator.
+ */
+void                p4est_inspect_report (p4est_t * p4est);
+
+/** Append one affected quadrant range to the attached change journal.
+ * Both quadrants are normalized to their first and last descendant of
+ * level \ref P4EST_QMAXLEVEL, respectively.  Whenever the new range
+ * overlaps or continues the most recently logged entry of the same
+ * tree and revision, that entry is grown in place instead, which keeps
+ * the journal compact during Morton-ordered traversals.
+ * Does nothing unless \a p4est->inspect carries a journal array.
+ * This is called internally by the adaptation and partition routines
+ * and may be called by applications that modify the forest directly.
+ * \param [in,out] p4est    The forest whose journal is appended to.
+ * \param [in] which_tree   Tree containing both quadrants.
+ * \param [in] first        First quadrant whose extent is affected.
+ * \param [in] last         Last affected quadrant, not before \a first;
+ *                          may be the same quadrant as \a first.
+ */
+void                p4est_journal_log (p4est_t * p4est,
+                                       p4est_topidx_t which_tree,
+                                       const p4est_quadrant_t * first,
+                                       const p4est_quadrant_t * last);
+
 /** Callback function prototype to replace one set of quadrants with another.
  *
  * This is used by extended routines when the quadrants of an existing, valid
@@ -130,6 +311,60 @@ p4est_t            *p4est_new_ext (sc_MPI_Comm mpicomm,
                                    size_t data_size, p4est_init_t init_fn,
                                    void *user_pointer);
 
+/** Create a serially replicated forest for low-latency small meshes.
+ * Every process that makes this call builds the complete forest over a
+ * one-process communicator, so construction and all later operations
+ * on the forest run without collective communication: the partition
+ * arrays are filled from local knowledge and \ref p4est_ghost_new
+ * returns immediately with an empty, trivially complete ghost layer,
+ * since no quadrant has a remote neighbor.  Intended for many tiny
+ * interface or coupling meshes whose update cost would otherwise be
+ * dominated by collective latency on the world communicator.  The
+ * caller remains responsible for keeping the replicas consistent
+ * between processes.  The arguments are as in \ref p4est_new_ext.
+ * \return          A valid forest on sc_MPI_COMM_SELF.
+ */
+p4est_t            *p4est_new_replicated (p4est_connectivity_t *
+                                          connectivity, int min_level,
+                                          size_t data_size,
+                                          p4est_init_t init_fn,
+                                          void *user_pointer);
+
+/** Callback prototype to query the desired refinement level of a region.
+ * \param [in] quadrant   The region covered by this quadrant is queried.
+ *                        It is not necessarily a leaf of the forest.
+ * \return                The refinement level desired within the
+ *                        region, at most P4EST_QMAXLEVEL.  If it is
+ *                        greater than the quadrant's level, the
+ *                        quadrant is split and its children queried.
+ */
+typedef int         (*p4est_level_map_t) (p4est_t * p4est,
+                                          p4est_topidx_t which_tree,
+                                          p4est_quadrant_t * quadrant);
+
+/** Create a new forest directly from a refinement level map.
+ * The final linear tree is built top-down in one pass, splitting each
+ * quadrant whose mapped level exceeds its own, so no intermediate
+ * levels are ever stored or traversed as they would be by repeated
+ * calls to \ref p4est_refine.  The user data of the resulting leaves is
+ * initialized by \a init_fn; interior quadrants never carry data.
+ * The forest is partitioned at the granularity of whole trees like the
+ * uniform level zero forest of \ref p4est_new_ext; to equilibrate the
+ * quadrant counts afterwards, call \ref p4est_partition.
+ * \param [in] level_fn   Level query callback, must not be NULL.  It
+ *                        must be consistent between processes in the
+ *                        sense of a valid refinement pattern, but is
+ *                        only called for local regions.
+ * \return                A valid forest realizing the level map.
+ */
+p4est_t            *p4est_new_from_level_map (sc_MPI_Comm mpicomm,
+                                              p4est_connectivity_t *
+                                              connectivity,
+                                              size_t data_size,
+                                              p4est_level_map_t level_fn,
+                                              p4est_init_t init_fn,
+                                              void *user_pointer);
+
 /** Create a new mesh.
  * \param [in] p4est                A forest that is fully 2:1 balanced.
  * \param [in] ghost                The ghost layer created from the
@@ -148,6 +383,70 @@ p4est_mesh_t       *p4est_mesh_new_ext (p4est_t * p4est,
                                         int compute_level_lists,
                                         p4est_connect_type_t btype);
 
+/** Create a new mesh restricted to a window of quadrant levels.
+ * Face adjacency is only stored for faces that touch a quadrant whose
+ * level lies in [\b level_min, \b level_max]; all other face entries
+ * keep their unassigned default values.  This cuts construction time
+ * and memory traffic for level-sweep workloads such as multigrid
+ * smoothers that only traverse one level at a time.
+ * \param [in] p4est                A forest that is fully 2:1 balanced.
+ * \param [in] ghost                The ghost layer created from the
+ *                                  provided p4est.
+ * \param [in] compute_tree_index   Boolean to decide whether to allocate and
+ *                                  compute the quad_to_tree list.
+ * \param [in] compute_level_lists  Boolean to decide whether to compute the
+ *                                  level lists in quad_level.
+ * \param [in] level_min            Lowest level of the face window.
+ * \param [in] level_max            Highest level of the face window.
+ *                                  Pass 0 and P4EST_QMAXLEVEL to build
+ *                                  the complete face adjacency.
+ * \param [in] defer_corners        If true and \b btype is
+ *                                  P4EST_CONNECT_FULL, the corner members
+ *                                  stay NULL until the first call to
+ *                                  \ref p4est_mesh_build_corners.
+ * \param [in] btype                Determines the highest codimension
+ *                                  of neighbors.
+ * \return                          A fully allocated mesh structure.
+ */
+p4est_mesh_t       *p4est_mesh_new_level_ext (p4est_t * p4est,
+                                              p4est_ghost_t * ghost,
+                                              int compute_tree_index,
+                                              int compute_level_lists,
+                                              int level_min, int level_max,
+                                              int defer_corners,
+                                              p4est_connect_type_t btype);
+
+/** Create a new mesh recycling the allocations of a retired one.
+ * Behaves exactly like \ref p4est_mesh_new_ext, but takes over the
+ * memory of \a mesh, which must no longer be used in its old state.
+ * The flat arrays are reallocated to the new quadrant count and the
+ * variable-length arrays keep their grown capacity, so a driver that
+ * rebuilds the mesh every adaptation cycle stops paying for the
+ * allocation churn once the sizes have settled.  Members built by
+ * \ref p4est_mesh_compress or \ref p4est_mesh_attach_data are freed
+ * and not carried over.
+ * \param [in] p4est                A forest that is fully 2:1 balanced.
+ * \param [in] ghost                The ghost layer created from the
+ *                                  provided p4est.
+ * \param [in] compute_tree_index   Boolean to decide whether to allocate and
+ *                                  compute the quad_to_tree list.
+ * \param [in] compute_level_lists  Boolean to decide whether to compute the
+ *                                  level lists in quad_level.
+ * \param [in] btype                Determines the highest codimension
+ *                                  of neighbors.
+ * \param [in] mesh                 Mesh whose allocations are recycled,
+ *                                  or NULL for a plain new mesh.
+ * \return                          A fully allocated mesh structure;
+ *                                  this is \a mesh itself when it was
+ *                                  not NULL.
+ */
+p4est_mesh_t       *p4est_mesh_reuse_ext (p4est_t * p4est,
+                                          p4est_ghost_t * ghost,
+                                          int compute_tree_index,
+                                          int compute_level_lists,
+                                          p4est_connect_type_t btype,
+                                          p4est_mesh_t * mesh);
+
 /** Make a deep copy of a p4est.
  * The connectivity is not duplicated.
  * Copying of quadrant user data is optional.
@@ -165,6 +464,61 @@ p4est_mesh_t       *p4est_mesh_new_ext (p4est_t * p4est,
 p4est_t            *p4est_copy_ext (p4est_t * input, int copy_data,
                                     int duplicate_mpicomm);
 
+/** Read-only snapshot of a forest that avoids a full \ref p4est_copy.
+ * A fresh view shares every tree's quadrant storage with the source
+ * forest, so creating one is cheap regardless of the forest size.
+ * Before the source is mutated in any way (refined, coarsened,
+ * balanced, partitioned, or its data reset), the mutating code must
+ * call \ref p4est_view_protect_tree for each tree that will change, or
+ * \ref p4est_view_protect for all of them; only those trees are then
+ * deep-copied into the view.  After the protect call returns, reader
+ * threads traversing the view and the thread mutating the source no
+ * longer touch common memory for the protected trees.  The view does
+ * not synchronize by itself: the protect call is the hand-off point
+ * between the mutating thread and the readers.
+ */
+typedef struct p4est_view p4est_view_t;
+
+/** Snapshot a forest for concurrent read-only traversal.
+ * All trees start out shared with the source; see \ref p4est_view_t.
+ * \param [in] p4est    Valid forest; it must outlive the view.
+ * \return              View sharing all quadrant storage.
+ */
+p4est_view_t       *p4est_view_new (p4est_t * p4est);
+
+/** Deep-copy one tree into the view before the source mutates it.
+ * Copies the tree's quadrants and, if the data size is positive, the
+ * quadrant payload; subsequent calls for the same tree do nothing.
+ * Must be called before the source forest's revision advances.
+ * \param [in,out] view      Valid view.
+ * \param [in] which_tree    Local tree about to be mutated.
+ */
+void                p4est_view_protect_tree (p4est_view_t * view,
+                                             p4est_topidx_t which_tree);
+
+/** Deep-copy all still-shared local trees into the view.
+ * Equivalent to \ref p4est_view_protect_tree on every local tree.
+ * \param [in,out] view      Valid view.
+ */
+void                p4est_view_protect (p4est_view_t * view);
+
+/** Access the quadrants of a local tree through the view.
+ * Returns the view's copy if the tree has been protected and the
+ * shared storage of the source forest otherwise; the latter is only
+ * legal while the source is unmutated since the snapshot.
+ * \param [in] view          Valid view.
+ * \param [in] which_tree    Local tree to read.
+ * \return                   Array of p4est_quadrant_t; do not modify.
+ */
+sc_array_t         *p4est_view_tree (p4est_view_t * view,
+                                     p4est_topidx_t which_tree);
+
+/** Free a view and all tree copies it holds.
+ * The source forest is not touched.
+ * \param [in,out] view      View to deallocate.
+ */
+void                p4est_view_destroy (p4est_view_t * view);
+
 /** Refine a forest with a bounded refinement level and a replace option.
  * \param [in,out] p4est The forest is changed in place.
  * \param [in] refine_recursive Boolean to decide on recursive refinement.
@@ -192,6 +546,43 @@ void                p4est_refine_ext (p4est_t * p4est,
                                       p4est_init_t init_fn,
                                       p4est_replace_t replace_fn);
 
+/** Descriptor of one Morton index range to be refined.
+ * The range covers the Morton indices [\a first_id, \a last_id] of
+ * level \a level within tree \a which_tree.
+ */
+typedef struct p4est_refine_range
+{
+  p4est_topidx_t      which_tree;   /**< tree containing the range */
+  uint64_t            first_id;     /**< first Morton index at \a level */
+  uint64_t            last_id;      /**< last Morton index at \a level,
+                                         inclusive */
+  int8_t              level;        /**< level of the Morton indices and
+                                         target level of the refinement */
+}
+p4est_refine_range_t;
+
+/** Refine exactly the quadrants intersecting a set of Morton ranges.
+ * Every local quadrant intersecting a range is split down to the
+ * range's level by direct child expansion; quadrants outside all
+ * ranges are never visited, so the cost is proportional to the size
+ * of the edit rather than to the size of the forest.
+ * This function is collective; ranges referring to remote quadrants
+ * are skipped locally.  The result is sorted and complete but not
+ * 2:1 balanced; call balance afterwards if required.
+ * \param [in,out] p4est    The forest is changed in place.
+ * \param [in] num_ranges Number of entries in \a ranges.
+ * \param [in] ranges     Refinement descriptors; they need not be
+ *                        sorted and may overlap.
+ * \param [in] init_fn    Callback to initialize the user_data which is
+ *                        already allocated automatically.
+ * \param [in] replace_fn Callback to replace a quadrant with its
+ *                        children; may be NULL.
+ */
+void                p4est_refine_ranges (p4est_t * p4est, int num_ranges,
+                                       const p4est_refine_range_t * ranges,
+                                       p4est_init_t init_fn,
+                                       p4est_replace_t replace_fn);
+
 /** Coarsen a forest.
  * \param [in,out] p4est The forest is changed in place.
  * \param [in] coarsen_recursive Boolean to decide on recursive coarsening.
@@ -216,6 +607,50 @@ void                p4est_coarsen_ext (p4est_t * p4est, int coarsen_recursive,
                                        p4est_init_t init_fn,
                                        p4est_replace_t replace_fn);
 
+/** Coarsen a forest with one batched callback per tree.
+ * All candidate families of a tree are collected first and decided by
+ * a single call to \a coarsen_fn, which receives the family start
+ * indices and sets per-family flags; see \ref p4est_coarsen_batch_t.
+ * The pass is not recursive; call the function repeatedly to coarsen
+ * multiple levels.
+ * \param [in,out] p4est   The forest is changed in place.
+ * \param [in] coarsen_fn Callback deciding all families of one tree.
+ * \param [in] init_fn    Callback to initialize the user_data which is
+ *                        already allocated automatically.
+ * \param [in] replace_fn Callback to replace quadrants with their
+ *                        parent; may be NULL.
+ */
+void                p4est_coarsen_batch (p4est_t * p4est,
+                                       p4est_coarsen_batch_t coarsen_fn,
+                                       p4est_init_t init_fn,
+                                       p4est_replace_t replace_fn);
+
+/** Derive a uniformly coarsened forest without callbacks.
+ * Equivalent to copying the forest and coarsening everywhere
+ * \a levels times, but computed arithmetically in a single sweep over
+ * the local quadrants: aligned blocks are replaced by their ancestor
+ * wherever all members are process-local and within \a levels of it.
+ * The input forest is not modified; the result shares its
+ * connectivity and its partition boundaries, so no quadrants move
+ * between processes.  This serves building a multigrid hierarchy.
+ * \param [in] p4est    Valid forest, left unchanged.
+ * \param [in] levels   Number of levels to coarsen by, non-negative.
+ * \param [in] init_fn  Callback to initialize the user_data of the
+ *                      coarse quadrants; may be NULL.
+ * \param [in,out] correspondence  If not NULL, an empty array of
+ *                      p4est_locidx_t; one entry is appended per
+ *                      coarse local quadrant holding the number of
+ *                      fine local quadrants it covers.  Both sides
+ *                      run over the same index space in order, so
+ *                      prefix sums yield the fine offsets needed by
+ *                      intergrid transfer operators.
+ * \return              The newly created coarse forest with a zero
+ *                      revision counter.
+ */
+p4est_t            *p4est_coarsen_uniform (p4est_t * p4est, int levels,
+                                           p4est_init_t init_fn,
+                                           sc_array_t * correspondence);
+
 /** 2:1 balance the size differences of neighboring elements in a forest.
  * \param [in,out] p4est  The p4est to be worked on.
  * \param [in] btype      Balance type (face or corner/full).
@@ -238,6 +673,51 @@ void                p4est_balance_subtree_ext (p4est_t * p4est,
                                                p4est_init_t init_fn,
                                                p4est_replace_t replace_fn);
 
+/** 2:1 balance a forest whose imbalance is known to be localized.
+ * This behaves like \ref p4est_balance_ext but skips the local
+ * first-pass balance for trees the caller marks as clean, i.e. trees
+ * whose quadrants have not changed since a previous balance call.
+ * The inter-tree and inter-processor phases still run in full, so the
+ * result is identical to a full balance.
+ * \param [in] dirty_trees   Array with one entry per local tree, indexed
+ *                           by which_tree - first_local_tree; nonzero
+ *                           marks a tree changed since the last balance.
+ *                           Passing NULL balances all trees.
+ */
+void                p4est_balance_incremental (p4est_t * p4est,
+                                               p4est_connect_type_t btype,
+                                               p4est_init_t init_fn,
+                                               p4est_replace_t replace_fn,
+                                               const int8_t * dirty_trees);
+
+/** 2:1 balance restricted to an active band of refinement levels.
+ * Enforces the size constraints generated by quadrants of levels
+ * [\a lmin, \a lmax] against their neighbors: the collective phases
+ * run on a view of the forest capped at \a lmax, and of the resulting
+ * refinements only those creating quadrants of level \a lmin - 1 or
+ * finer are applied.  Quadrants outside the band are left alone, so
+ * the forest is generally not fully balanced afterwards; a local time
+ * stepping scheme calls this per substep for the levels it advances
+ * and defers the full \ref p4est_balance to the synchronization step.
+ * With \a lmin <= 1 and \a lmax >= P4EST_QMAXLEVEL this is a full
+ * balance.  Quadrants deeper than \a lmax whose family straddles a
+ * process boundary cannot be capped and act at their true level.
+ * \param [in,out] p4est  The p4est to be worked on.
+ * \param [in] btype      Balance type (face or corner/full).
+ * \param [in] lmin       Coarsest level of the active band.
+ * \param [in] lmax       Finest level of the active band.
+ * \param [in] init_fn    Callback function to initialize the user_data
+ *                        which is already allocated automatically.
+ * \param [in] replace_fn Callback function that allows the user to change
+ *                        incoming quadrants based on the quadrants they
+ *                        replace.
+ */
+void                p4est_balance_levels (p4est_t * p4est,
+                                          p4est_connect_type_t btype,
+                                          int lmin, int lmax,
+                                          p4est_init_t init_fn,
+                                          p4est_replace_t replace_fn);
+
 /** Repartition the forest.
  *
  * The forest is partitioned between processors such that each processor
@@ -254,6 +734,128 @@ p4est_gloidx_t      p4est_partition_ext (p4est_t * p4est,
                                          int partition_for_coarsening,
                                          p4est_weight_t weight_fn);
 
+/** Repartition the forest with a batched weight callback.
+ *
+ * Identical to \ref p4est_partition_ext except that the weights are
+ * obtained with one callback invocation per local tree, which allows an
+ * expensive per-cell cost model to be vectorized.  A scalar
+ * \ref p4est_weight_t callback passed to p4est_partition_ext is instead
+ * evaluated across threads when p4est is configured with
+ * \c --enable-openmp; in either case the callback must not modify the
+ * forest.
+ *
+ * \param [in,out] p4est      The forest that will be partitioned.
+ * \param [in]     partition_for_coarsening     If true, the partition
+ *                            is modified to allow one level of coarsening.
+ * \param [in]     batch_fn   A batched weighting function; must not be NULL.
+ * \return         The global number of shipped quadrants
+ */
+p4est_gloidx_t      p4est_partition_batch (p4est_t * p4est,
+                                           int partition_for_coarsening,
+                                           p4est_weight_batch_t batch_fn);
+
+/** Repartition the forest by a vector of weights per quadrant.
+ *
+ * Like \ref p4est_partition_ext, but every quadrant carries one weight
+ * per constraint, e.g. memory and compute cost.  Each component is
+ * normalized by its global sum so that differently scaled constraints
+ * become comparable, and the requested norm combines them into the
+ * scalar that the space-filling curve prefix is cut on.  The L1 norm
+ * balances the aggregate of all constraints; the maximum norm
+ * emphasizes whichever constraint dominates a quadrant.  Since a
+ * single curve cut cannot optimize the constraints independently, the
+ * combined norm is a compromise, but it moves the data only once.
+ *
+ * \param [in,out] p4est      The forest that will be partitioned.
+ * \param [in]     partition_for_coarsening     If true, the partition
+ *                            is modified to allow one level of coarsening.
+ * \param [in]     num_components  Number of weight components, at least 1.
+ * \param [in]     weight_fn  A vector weighting function; must not be NULL.
+ * \param [in]     norm       How to combine the normalized components.
+ * \return         The global number of shipped quadrants
+ */
+p4est_gloidx_t      p4est_partition_vector (p4est_t * p4est,
+                                            int partition_for_coarsening,
+                                            int num_components,
+                                            p4est_weight_vector_t weight_fn,
+                                            p4est_partition_norm_t norm);
+
+/** Repartition the forest only if the imbalance warrants the cost.
+ *
+ * Like \ref p4est_partition_ext, but if the current ratio of the
+ * largest process load to the average load does not exceed
+ * \a tolerance, nothing is moved at all.  If it does, the cuts are
+ * shifted towards the ideal partition only as far as no quadrant moves
+ * further than to an adjacent process, which trims the worst local
+ * overloads at bounded communication cost.  Intended as a cheap
+ * load-smoothing step between full repartitions; a full
+ * \ref p4est_partition_ext should still be called periodically since
+ * the adjacent-shift restriction cannot resolve global imbalance.
+ *
+ * \param [in,out] p4est      The forest that will be partitioned.
+ * \param [in]     partition_for_coarsening     If true, the partition
+ *                            is modified to allow one level of coarsening.
+ * \param [in]     weight_fn  A weighting function or NULL
+ *                            for uniform partitioning.
+ * \param [in]     tolerance  Tolerated ratio of maximal to average load,
+ *                            at least 1.; e.g. 1.05 accepts 5% imbalance.
+ * \return         The global number of shipped quadrants
+ */
+p4est_gloidx_t      p4est_partition_lazy (p4est_t * p4est,
+                                          int partition_for_coarsening,
+                                          p4est_weight_t weight_fn,
+                                          double tolerance);
+
+/** Transient storage for an asynchronous repartition. */
+typedef struct p4est_partition_context
+{
+  p4est_t            *p4est;    /**< The forest being repartitioned. */
+  int                 nothing;  /**< True if the partition cannot change
+                                     and no messages are in flight. */
+  /* the remaining members are internal to the partition algorithm */
+  int                 num_proc_recv_from, num_proc_send_to;
+  int                *recv_proc;
+  char              **recv_buf, **send_buf;
+  p4est_locidx_t     *num_recv_from, *num_send_to;
+  p4est_gloidx_t     *begin_send_to;
+  p4est_locidx_t     *num_per_tree_local;
+  p4est_gloidx_t     *global_last_quad_index;
+  p4est_gloidx_t     *new_global_last_quad_index;
+  p4est_gloidx_t     *local_tree_last_quad_index;
+  p4est_gloidx_t      total_quadrants_shipped;
+  p4est_gloidx_t      journal_old_begin, journal_old_end;
+  sc_array_t         *migrate_ranges;   /**< ranges for the migrate
+                                             hooks, or NULL */
+  sc_MPI_Request     *head_request, *recv_request, *send_request;
+  double              tstart;
+  unsigned            crc;      /**< set with --enable-debug only */
+}
+p4est_partition_context_t;
+
+/** Begin an asynchronous repartition by posting all messages.
+ * The arguments are identical to \ref p4est_partition_ext.  The quadrant
+ * counts and payloads are in flight when this function returns, so the
+ * caller can overlap unrelated computation with the transfer.  The
+ * forest must not be accessed or modified before the completion call.
+ * The API follows the precedent of \ref p4est_ghost_exchange_data_begin.
+ * \return          Transient storage for messages in progress; always
+ *                  non-NULL and must be passed to p4est_partition_end.
+ */
+p4est_partition_context_t *p4est_partition_begin (p4est_t * p4est,
+                                                  int
+                                                  partition_for_coarsening,
+                                                  p4est_weight_t weight_fn);
+
+/** Complete an asynchronous repartition.
+ * This function waits for all pending messages and rebuilds the local
+ * trees.  The revision counter is bumped if the partition changed.
+ * \param [in,out] context  Created ONLY by p4est_partition_begin.
+ *                          It is deallocated before this function returns.
+ * \return         The global number of shipped quadrants
+ */
+p4est_gloidx_t      p4est_partition_end (p4est_partition_context_t *
+                                         context);
+
 /** Correct partition to allow one level of coarsening.
  *
  * \param [in] p4est                     forest whose partition is corrected
@@ -276,6 +878,37 @@ void                p4est_iterate_ext (p4est_t * p4est,
                                        p4est_iter_corner_t iter_corner,
                                        int remote);
 
+/** p4est_iterate_plan_execute_ext adds the option \a prefetch: if it is
+ * positive, the replay issues software prefetches into the quadrant user
+ * data of the volume event \a prefetch entries ahead, which hides cold
+ * payload loads behind the callbacks in between.  Useful distances are
+ * small, on the order of 4 to 16; the best value depends on the callback
+ * cost and must be measured.  With \a prefetch zero this is the same as
+ * \ref p4est_iterate_plan_execute.
+ */
+void                p4est_iterate_plan_execute_ext (p4est_iterate_plan_t *
+                                                    plan, void *user_data,
+                                                    p4est_iter_volume_t
+                                                    iter_volume,
+                                                    p4est_iter_face_t
+                                                    iter_face,
+                                                    p4est_iter_corner_t
+                                                    iter_corner,
+                                                    int prefetch);
+
+/** Compute the parallel checksum with optional quadrant data coverage.
+ * With \a checksum_data false this returns the same value as
+ * \ref p4est_checksum.  With it true and a positive data size, the raw
+ * payload bytes of every quadrant enter the checksum as well; unlike
+ * the quadrant coordinates, the payload is not converted to network
+ * byte order, so the data-covering checksum is only comparable between
+ * runs on machines of the same endianness.
+ * \param [in] p4est          Valid forest structure.
+ * \param [in] checksum_data  If true, include the quadrant payload.
+ * \return                    Parallel checksum on rank 0, 0 elsewhere.
+ */
+unsigned            p4est_checksum_ext (p4est_t * p4est, int checksum_data);
+
 /** Save the complete connectivity/p4est data to disk.  This is a collective
  * operation that all MPI processes need to call.  All processes write
  * into the same file, so the filename given needs to be identical over
@@ -332,6 +965,92 @@ p4est_t            *p4est_source_ext (sc_io_source_t * src,
                                       int broadcasthead, void *user_pointer,
                                       p4est_connectivity_t ** connectivity);
 
+/** Reload a file written by \ref p4est_save_ext on the saving partition.
+ * Requires the file to have been saved with save_partition true and the
+ * process count to match; it aborts otherwise.  Only rank zero parses
+ * the connectivity and header and broadcasts them; every process then
+ * seeks directly to its recorded byte range and reads it with a single
+ * bulk call, so the restart runs at raw filesystem bandwidth with no
+ * redistribution.  The file contents are adopted as saved and verified
+ * only in debug mode.  The parameters match \ref p4est_load_ext.
+ */
+p4est_t            *p4est_load_fast (const char *filename,
+                                     sc_MPI_Comm mpicomm, size_t data_size,
+                                     int load_data, void *user_pointer,
+                                     p4est_connectivity_t ** connectivity);
+
+/** Serialize the forest into caller-provided memory instead of a file.
+ * The byte layout is identical to the file written by \ref p4est_save_ext:
+ * concatenating the segments of all processes in rank order yields that
+ * file.  Rank zero's segment carries the connectivity and the header in
+ * front of its quadrants, so its offset is zero; every other segment
+ * holds only that processor's quadrant records.  This allows a transport
+ * layer to place the bytes directly, bypassing the filesystem.  This is
+ * a collective operation.
+ * \param [in] p4est       Valid forest structure.
+ * \param [in] save_data   If true, the element data is saved.
+ *                         Otherwise, a data size of 0 is saved.
+ * \param [in] save_partition   As in \ref p4est_save_ext.
+ * \param [in,out] buffer  Array of bytes (element size 1); it is resized
+ *                         and overwritten with this processor's segment.
+ * \param [out] my_offset  Byte offset of this segment in the image.
+ * \return                 Total byte count of the complete image,
+ *                         identical on all processes.
+ */
+size_t              p4est_save_buffer (p4est_t * p4est, int save_data,
+                                       int save_partition,
+                                       sc_array_t * buffer,
+                                       size_t * my_offset);
+
+/** The same as p4est_load_ext, but reading the connectivity/p4est from a
+ * memory buffer holding the complete image on every process.
+ * The buffer may come from a file written by \ref p4est_save_ext or from
+ * the concatenated segments of \ref p4est_save_buffer.
+ * \param [in] buffer      Array of bytes (element size 1) with the image.
+ */
+p4est_t            *p4est_load_buffer (sc_array_t * buffer,
+                                       sc_MPI_Comm mpicomm,
+                                       size_t data_size, int load_data,
+                                       int autopartition, void *user_pointer,
+                                       p4est_connectivity_t ** connectivity);
+
+/** Write an incremental checkpoint relative to the previous save.
+ * Requires the change journal (see \ref p4est_inspect_t) to have been
+ * attached before the operations since the last full or delta save; the
+ * recorded Morton intervals determine which quadrants are written.  The
+ * segment holds this processor's changed intervals, their quadrant
+ * records and the current ownership window; the caller persists it
+ * per rank, e.g. next to a base file from \ref p4est_save_buffer.
+ * On return the journal is truncated so that the next call records
+ * only subsequent changes.  This is a collective operation.
+ * \param [in] p4est       Valid forest with an attached change journal.
+ * \param [in] save_data   If true, the element data is saved.
+ *                         Otherwise, a data size of 0 is saved.
+ * \param [in,out] buffer  Array of bytes (element size 1); it is resized
+ *                         and overwritten with this processor's segment.
+ * \return                 Byte count of this processor's segment.
+ */
+size_t              p4est_save_delta_buffer (p4est_t * p4est, int save_data,
+                                             sc_array_t * buffer);
+
+/** Replay one incremental checkpoint on top of a loaded forest.
+ * The forest must equal the state at the time the delta was written,
+ * i.e. the base load followed by all earlier deltas in order, on the
+ * same number of processes.  Changed intervals are spliced over the
+ * current leaves and the local storage is trimmed to the recorded
+ * ownership window, which accounts for repartitions in between.
+ * This is a collective operation.
+ * \param [in,out] p4est   Valid forest to advance by one delta.
+ * \param [in] load_data   If true, the element data is restored;
+ *                         requires matching recorded and forest data
+ *                         sizes, otherwise the data is zero-initialized.
+ * \param [in] buffer      This processor's segment as written by
+ *                         \ref p4est_save_delta_buffer.
+ */
+void                p4est_apply_delta_buffer (p4est_t * p4est,
+                                              int load_data,
+                                              sc_array_t * buffer);
+
 /** Create the data necessary to create a PETsc DMPLEX representation of a
  * forest, as well as the accompanying lnodes and ghost layer.  The forest
  * must be at least face balanced (see p4est_balance()).  See
@@ -0,0 +1,336 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4_TO_P8
+#include <p4est_flags.h>
+#include <p4est_bits.h>
+#include <p4est_extended.h>
+#else
+#include <p8est_flags.h>
+#include <p8est_bits.h>
+#include <p8est_extended.h>
+#endif
+
+/** Record the current local quadrants as the bitmap's key snapshot.
+ * The \a keys array must already hold num_quadrants entries.
+ */
+static void
+p4est_flags_snapshot (p4est_flags_t * flags)
+{
+  size_t              zz;
+  p4est_topidx_t      nt;
+  p4est_locidx_t      il = 0;
+  p4est_t            *p4est = flags->p4est;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, *k;
+
+  for (nt = p4est->first_local_tree; nt <= p4est->last_local_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      k = flags->keys + il++;
+      *k = *q;
+      k->p.piggy3.which_tree = nt;
+    }
+  }
+  P4EST_ASSERT (il == flags->num_quadrants);
+}
+
+/** Rebuild the bitmap against the forest's current local quadrants.
+ * Both the key snapshot and the current leaves are in Morton order, so
+ * one merge sweep matches every current quadrant with the recorded
+ * quadrants it overlaps.
+ */
+static void
+p4est_flags_remap (p4est_flags_t * flags)
+{
+  size_t              zz;
+  size_t              bpq = flags->bytes_per_quad;
+  size_t              ib;
+  p4est_topidx_t      nt;
+  p4est_locidx_t      il, jl, jo;
+  p4est_locidx_t      newnum;
+  p4est_t            *p4est = flags->p4est;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, *k;
+  char               *newbits, *dest;
+
+  newnum = p4est->local_num_quadrants;
+  newbits = P4EST_ALLOC_ZERO (char, (size_t) newnum * bpq);
+
+  il = 0;
+  jl = 0;
+  for (nt = p4est->first_local_tree; nt <= p4est->last_local_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+
+      /* skip recorded quadrants that end before this quadrant begins */
+      while (jl < flags->num_quadrants &&
+             ((k = flags->keys + jl)->p.piggy3.which_tree < nt ||
+              (k->p.piggy3.which_tree == nt &&
+               !p4est_quadrant_overlaps (k, q) &&
+               p4est_quadrant_compare (k, q) < 0))) {
+        ++jl;
+      }
+
+      /* combine all recorded quadrants this quadrant overlaps */
+      dest = newbits + (size_t) il * bpq;
+      for (jo = jl; jo < flags->num_quadrants; ++jo) {
+        k = flags->keys + jo;
+        if (k->p.piggy3.which_tree != nt ||
+            !p4est_quadrant_overlaps (k, q)) {
+          break;
+        }
+        for (ib = 0; ib < bpq; ++ib) {
+          dest[ib] |= flags->bits[(size_t) jo * bpq + ib];
+        }
+        if (k->level <= q->level) {
+          /* an ancestor may cover further quadrants; keep it around */
+          break;
+        }
+      }
+      ++il;
+    }
+  }
+  P4EST_ASSERT (il == newnum);
+
+  P4EST_FREE (flags->bits);
+  P4EST_FREE (flags->keys);
+  flags->bits = newbits;
+  flags->num_quadrants = newnum;
+  flags->keys = P4EST_ALLOC (p4est_quadrant_t, newnum);
+  p4est_flags_snapshot (flags);
+  flags->revision = p4est_revision (p4est);
+}
+
+/** Complete a repartition transfer started by the migrate hooks. */
+static void
+p4est_flags_migrate_complete (p4est_flags_t * flags)
+{
+  int                 mpiret;
+  p4est_t            *p4est = flags->p4est;
+
+  P4EST_ASSERT (flags->migrating);
+
+  if (flags->new_bits == NULL) {
+    /* this process neither kept nor received any quadrants */
+    flags->new_num = p4est->local_num_quadrants;
+    flags->new_bits = P4EST_ALLOC_ZERO (char, (size_t) flags->new_num *
+                                        flags->bytes_per_quad);
+  }
+  P4EST_ASSERT (flags->new_num == p4est->local_num_quadrants);
+
+  mpiret = sc_MPI_Waitall ((int) flags->requests->elem_count,
+                           (sc_MPI_Request *) flags->requests->array,
+                           sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (flags->requests);
+
+  P4EST_FREE (flags->bits);
+  P4EST_FREE (flags->keys);
+  flags->bits = flags->new_bits;
+  flags->num_quadrants = flags->new_num;
+  flags->new_bits = NULL;
+  flags->new_num = 0;
+  flags->migrating = 0;
+  flags->keys = P4EST_ALLOC (p4est_quadrant_t, flags->num_quadrants);
+  p4est_flags_snapshot (flags);
+  flags->revision = p4est_revision (p4est);
+}
+
+/** Migrate hook posting the sends while the old layout is valid. */
+static void
+p4est_flags_migrate_pre (p4est_t * p4est,
+                         const p4est_migrate_range_t * range, void *user)
+{
+  int                 mpiret;
+  p4est_flags_t      *flags = (p4est_flags_t *) user;
+  sc_MPI_Request     *req;
+
+  P4EST_ASSERT (flags != NULL && flags->p4est == p4est);
+
+  if (!flags->migrating) {
+    /* fold any adaptations since the last access into the bitmap
+     * while the pre-partition layout is still in place */
+    p4est_flags_update (flags);
+    flags->migrating = 1;
+  }
+  if (range->from_rank == p4est->mpirank &&
+      range->to_rank != p4est->mpirank) {
+    req = (sc_MPI_Request *) sc_array_push (flags->requests);
+    mpiret = sc_MPI_Isend (flags->bits + (size_t) range->old_first *
+                           flags->bytes_per_quad,
+                           (int) ((size_t) range->count *
+                                  flags->bytes_per_quad), sc_MPI_BYTE,
+                           range->to_rank, P4EST_COMM_FLAGS_MIGRATE,
+                           p4est->mpicomm, req);
+    SC_CHECK_MPI (mpiret);
+  }
+}
+
+/** Migrate hook receiving into the new layout once it is in place. */
+static void
+p4est_flags_migrate_post (p4est_t * p4est,
+                          const p4est_migrate_range_t * range, void *user)
+{
+  int                 mpiret;
+  size_t              bpq;
+  p4est_flags_t      *flags = (p4est_flags_t *) user;
+  sc_MPI_Request     *req;
+
+  P4EST_ASSERT (flags != NULL && flags->p4est == p4est);
+  P4EST_ASSERT (flags->migrating);
+
+  bpq = flags->bytes_per_quad;
+  if (flags->new_bits == NULL) {
+    flags->new_num = p4est->local_num_quadrants;
+    flags->new_bits = P4EST_ALLOC_ZERO (char,
+                                        (size_t) flags->new_num * bpq);
+  }
+  if (range->to_rank == p4est->mpirank) {
+    if (range->from_rank == p4est->mpirank) {
+      memcpy (flags->new_bits + (size_t) range->new_first * bpq,
+              flags->bits + (size_t) range->old_first * bpq,
+              (size_t) range->count * bpq);
+    }
+    else {
+      req = (sc_MPI_Request *) sc_array_push (flags->requests);
+      mpiret = sc_MPI_Irecv (flags->new_bits +
+                             (size_t) range->new_first * bpq,
+                             (int) ((size_t) range->count * bpq),
+                             sc_MPI_BYTE, range->from_rank,
+                             P4EST_COMM_FLAGS_MIGRATE, p4est->mpicomm, req);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+}
+
+p4est_flags_t      *
+p4est_flags_attach (p4est_t * p4est, int bits_per_quad)
+{
+  p4est_flags_t      *flags;
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (bits_per_quad > 0);
+
+  flags = P4EST_ALLOC_ZERO (p4est_flags_t, 1);
+  flags->p4est = p4est;
+  flags->bits_per_quad = bits_per_quad;
+  flags->bytes_per_quad = ((size_t) bits_per_quad + 7) / 8;
+
+  if (p4est->inspect == NULL) {
+    p4est->inspect = P4EST_ALLOC_ZERO (p4est_inspect_t, 1);
+    flags->own_inspect = 1;
+  }
+  P4EST_ASSERT (p4est->inspect->migrate_pre_fn == NULL &&
+                p4est->inspect->migrate_post_fn == NULL);
+  p4est->inspect->migrate_pre_fn = p4est_flags_migrate_pre;
+  p4est->inspect->migrate_post_fn = p4est_flags_migrate_post;
+  p4est->inspect->migrate_user = flags;
+
+  flags->num_quadrants = p4est->local_num_quadrants;
+  flags->bits = P4EST_ALLOC_ZERO (char, (size_t) flags->num_quadrants *
+                                  flags->bytes_per_quad);
+  flags->keys = P4EST_ALLOC (p4est_quadrant_t, flags->num_quadrants);
+  p4est_flags_snapshot (flags);
+  flags->revision = p4est_revision (p4est);
+  flags->requests = sc_array_new (sizeof (sc_MPI_Request));
+
+  return flags;
+}
+
+void
+p4est_flags_detach (p4est_flags_t * flags)
+{
+  p4est_t            *p4est;
+
+  P4EST_ASSERT (flags != NULL);
+  p4est = flags->p4est;
+
+  p4est_flags_update (flags);
+
+  P4EST_ASSERT (p4est->inspect != NULL &&
+                p4est->inspect->migrate_user == flags);
+  p4est->inspect->migrate_pre_fn = NULL;
+  p4est->inspect->migrate_post_fn = NULL;
+  p4est->inspect->migrate_user = NULL;
+  if (flags->own_inspect) {
+    P4EST_FREE (p4est->inspect);
+    p4est->inspect = NULL;
+  }
+
+  sc_array_destroy (flags->requests);
+  P4EST_FREE (flags->keys);
+  P4EST_FREE (flags->bits);
+  P4EST_FREE (flags);
+}
+
+void
+p4est_flags_update (p4est_flags_t * flags)
+{
+  P4EST_ASSERT (flags != NULL && flags->p4est != NULL);
+
+  if (flags->migrating) {
+    p4est_flags_migrate_complete (flags);
+  }
+  if (flags->revision != p4est_revision (flags->p4est)) {
+    p4est_flags_remap (flags);
+  }
+}
+
+char               *
+p4est_flags_bytes (p4est_flags_t * flags, p4est_locidx_t local_num)
+{
+  p4est_flags_update (flags);
+
+  P4EST_ASSERT (0 <= local_num && local_num < flags->num_quadrants);
+
+  return flags->bits + (size_t) local_num * flags->bytes_per_quad;
+}
+
+int
+p4est_flags_test (p4est_flags_t * flags, p4est_locidx_t local_num, int bit)
+{
+  P4EST_ASSERT (0 <= bit && bit < flags->bits_per_quad);
+
+  return (p4est_flags_bytes (flags, local_num)[bit >> 3] >> (bit & 7)) & 1;
+}
+
+void
+p4est_flags_set (p4est_flags_t * flags, p4est_locidx_t local_num,
+                 int bit, int value)
+{
+  char               *b;
+
+  P4EST_ASSERT (0 <= bit && bit < flags->bits_per_quad);
+
+  b = p4est_flags_bytes (flags, local_num) + (bit >> 3);
+  if (value) {
+    *b |= (char) (1 << (bit & 7));
+  }
+  else {
+    *b &= (char) ~(1 << (bit & 7));
+  }
+}
@@ -0,0 +1,143 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4EST_FLAGS_H
+#define P4EST_FLAGS_H
+
+/** \file p4est_flags.h
+ * A dense per-quadrant flags bitmap maintained alongside a forest.
+ * Applications that encode small state words (active, boundary, phase)
+ * inside the quadrant user data pay a dereference for every test; this
+ * container keeps the same bits in one flat array indexed by the local
+ * quadrant number.  The library carries the bits through refinement,
+ * coarsening, balance, and partition: children inherit their parent's
+ * bits, a coarsened quadrant receives the bitwise or of its children,
+ * and a repartition ships the bits along with the quadrants.
+ */
+
+#include <p4est.h>
+
+SC_EXTERN_C_BEGIN;
+
+/** Dense per-quadrant flags attached to one forest.
+ * The member \b bits may be read and written directly inside iteration
+ * callbacks after \ref p4est_flags_update has brought it current; all
+ * other members are maintained by the library.
+ */
+typedef struct p4est_flags
+{
+  p4est_t            *p4est;            /**< Attached forest; borrowed,
+                                             not owned. */
+  int                 bits_per_quad;    /**< Flag bits per quadrant. */
+  size_t              bytes_per_quad;   /**< Bytes storing one
+                                             quadrant's bits. */
+  long                revision;         /**< Forest revision the bitmap
+                                             matches. */
+  p4est_locidx_t      num_quadrants;    /**< Local quadrant count
+                                             behind \b bits. */
+  char               *bits;             /**< num_quadrants times
+                                             bytes_per_quad bytes. */
+  p4est_quadrant_t   *keys;             /**< Snapshot of the local
+                                             quadrants the bitmap was
+                                             built for, with the tree
+                                             number in p.piggy3. */
+  int                 own_inspect;      /**< True if attaching created
+                                             the inspect structure. */
+  int                 migrating;        /**< True while a repartition
+                                             transfer is in flight. */
+  p4est_locidx_t      new_num;          /**< Local quadrant count after
+                                             the pending repartition. */
+  char               *new_bits;         /**< Receive bitmap of the
+                                             pending repartition. */
+  sc_array_t         *requests;         /**< Outstanding MPI requests of
+                                             the pending repartition. */
+}
+p4est_flags_t;
+
+/** Attach a zero-initialized flags bitmap to a forest.
+ * The bitmap occupies the migrate hooks of the forest's inspect
+ * structure, which is created if not yet present; the hooks must not
+ * be in use.  Maintenance is lazy: mutating the forest leaves the
+ * bitmap untouched until \ref p4est_flags_update or one of the
+ * accessors below remaps it, so any number of adaptations may pass
+ * between accesses at the cost of one sweep.
+ * \param [in,out] p4est    Valid forest; must outlive the attachment.
+ * \param [in] bits_per_quad  Strictly positive flag bits per quadrant.
+ * \return                  Fully initialized flags container.
+ */
+p4est_flags_t      *p4est_flags_attach (p4est_t * p4est,
+                                        int bits_per_quad);
+
+/** Detach and deallocate a flags bitmap.
+ * Any pending repartition transfer is completed first.  The migrate
+ * hooks are cleared and an inspect structure created by the attach is
+ * destroyed.  Must be called before the forest itself is destroyed.
+ * \param [in,out] flags    Flags container to deallocate.
+ */
+void                p4est_flags_detach (p4est_flags_t * flags);
+
+/** Bring the bitmap current with the attached forest.
+ * A noop if the forest revision has not moved.  Otherwise the old and
+ * the new local quadrants are swept in Morton order: every current
+ * quadrant receives the bitwise or over all recorded quadrants it
+ * overlaps, so refined children inherit their parent's bits and a
+ * coarsened quadrant combines its children.  A pending repartition
+ * transfer is completed by waiting on its messages.
+ * \param [in,out] flags    Valid flags container.
+ */
+void                p4est_flags_update (p4est_flags_t * flags);
+
+/** Access the flag bytes of one local quadrant.
+ * Calls \ref p4est_flags_update first.
+ * \param [in,out] flags    Valid flags container.
+ * \param [in] local_num    Quadrant index relative to the process.
+ * \return                  Pointer to bytes_per_quad writable bytes.
+ */
+char               *p4est_flags_bytes (p4est_flags_t * flags,
+                                       p4est_locidx_t local_num);
+
+/** Test one flag bit of one local quadrant.
+ * Calls \ref p4est_flags_update first.
+ * \param [in,out] flags    Valid flags container.
+ * \param [in] local_num    Quadrant index relative to the process.
+ * \param [in] bit          Bit number in [0, bits_per_quad).
+ * \return                  0 or 1.
+ */
+int                 p4est_flags_test (p4est_flags_t * flags,
+                                      p4est_locidx_t local_num, int bit);
+
+/** Set or clear one flag bit of one local quadrant.
+ * Calls \ref p4est_flags_update first.
+ * \param [in,out] flags    Valid flags container.
+ * \param [in] local_num    Quadrant index relative to the process.
+ * \param [in] bit          Bit number in [0, bits_per_quad).
+ * \param [in] value        Zero clears the bit, nonzero sets it.
+ */
+void                p4est_flags_set (p4est_flags_t * flags,
+                                     p4est_locidx_t local_num,
+                                     int bit, int value);
+
+SC_EXTERN_C_END;
+
+#endif /* !P4EST_FLAGS_H */
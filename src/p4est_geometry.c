@@ -45,22 +45,35 @@ p4est_geometry_destroy (p4est_geometry_t * geom)
   }
 }
 
+/** Gather the corner coordinates of a tree into a contiguous cache.
+ * All quadrants of a tree share these corners, so batched evaluation
+ * pays the tree_to_vertex indirection only once.
+ */
 static void
-p4est_geometry_connectivity_X (p4est_geometry_t * geom,
-                               p4est_topidx_t which_tree,
-                               const double abc[3], double xyz[3])
+p4est_geometry_tree_corners (p4est_connectivity_t * connectivity,
+                             p4est_topidx_t which_tree,
+                             double cv[P4EST_CHILDREN][3])
 {
-  p4est_connectivity_t *connectivity = (p4est_connectivity_t *) geom->user;
   const p4est_topidx_t *tree_to_vertex = connectivity->tree_to_vertex;
   const double       *v = connectivity->vertices;
-  double              eta_x, eta_y, eta_z = 0.;
   int                 j, k;
-  p4est_topidx_t      vt[P4EST_CHILDREN];
+  p4est_topidx_t      vt;
 
-  /* retrieve corners of the tree */
   for (k = 0; k < P4EST_CHILDREN; ++k) {
-    vt[k] = tree_to_vertex[which_tree * P4EST_CHILDREN + k];
+    vt = tree_to_vertex[which_tree * P4EST_CHILDREN + k];
+    for (j = 0; j < 3; ++j) {
+      cv[k][j] = v[3 * vt + j];
+    }
   }
+}
+
+/** Bi/trilinear blend of cached tree corners at one reference point. */
+static void
+p4est_geometry_corners_X (const double cv[P4EST_CHILDREN][3],
+                          const double abc[3], double xyz[3])
+{
+  double              eta_x, eta_y, eta_z = 0.;
+  int                 j;
 
   /* these are reference coordinates in [0, 1]**d */
   eta_x = abc[0];
@@ -71,21 +84,70 @@ p4est_geometry_connectivity_X (p4est_geometry_t * geom,
   for (j = 0; j < 3; ++j) {
     /* *INDENT-OFF* */
     xyz[j] =
-           ((1. - eta_z) * ((1. - eta_y) * ((1. - eta_x) * v[3 * vt[0] + j] +
-                                                  eta_x  * v[3 * vt[1] + j]) +
-                                  eta_y  * ((1. - eta_x) * v[3 * vt[2] + j] +
-                                                  eta_x  * v[3 * vt[3] + j]))
+           ((1. - eta_z) * ((1. - eta_y) * ((1. - eta_x) * cv[0][j] +
+                                                  eta_x  * cv[1][j]) +
+                                  eta_y  * ((1. - eta_x) * cv[2][j] +
+                                                  eta_x  * cv[3][j]))
 #ifdef P4_TO_P8
-            +     eta_z  * ((1. - eta_y) * ((1. - eta_x) * v[3 * vt[4] + j] +
-                                                  eta_x  * v[3 * vt[5] + j]) +
-                                  eta_y  * ((1. - eta_x) * v[3 * vt[6] + j] +
-                                                  eta_x  * v[3 * vt[7] + j]))
+            +     eta_z  * ((1. - eta_y) * ((1. - eta_x) * cv[4][j] +
+                                                  eta_x  * cv[5][j]) +
+                                  eta_y  * ((1. - eta_x) * cv[6][j] +
+                                                  eta_x  * cv[7][j]))
 #endif
            );
     /* *INDENT-ON* */
   }
 }
 
+static void
+p4est_geometry_connectivity_X (p4est_geometry_t * geom,
+                               p4est_topidx_t which_tree,
+                               const double abc[3], double xyz[3])
+{
+  p4est_connectivity_t *connectivity = (p4est_connectivity_t *) geom->user;
+  double              cv[P4EST_CHILDREN][3];
+
+  p4est_geometry_tree_corners (connectivity, which_tree, cv);
+  p4est_geometry_corners_X ((const double (*)[3]) cv, abc, xyz);
+}
+
+static void
+p4est_geometry_connectivity_X_v (p4est_geometry_t * geom,
+                                 p4est_topidx_t which_tree,
+                                 size_t num_points,
+                                 const double *abc, double *xyz)
+{
+  size_t              iz;
+  double              cv[P4EST_CHILDREN][3];
+
+  /* cache the tree corners once; the inner loop is free of gather
+   * indirections and amenable to vectorization */
+  p4est_geometry_tree_corners ((p4est_connectivity_t *) geom->user,
+                               which_tree, cv);
+  for (iz = 0; iz < num_points; ++iz) {
+    p4est_geometry_corners_X ((const double (*)[3]) cv,
+                              abc + 3 * iz, xyz + 3 * iz);
+  }
+}
+
+void
+p4est_geometry_X_v (p4est_geometry_t * geom, p4est_topidx_t which_tree,
+                    size_t num_points, const double *abc, double *xyz)
+{
+  size_t              iz;
+
+  if (geom->X_v != NULL) {
+    /* the geometry knows how to map all points in one batch */
+    geom->X_v (geom, which_tree, num_points, abc, xyz);
+    return;
+  }
+
+  /* arbitrary user transformations go point by point */
+  for (iz = 0; iz < num_points; ++iz) {
+    geom->X (geom, which_tree, abc + 3 * iz, xyz + 3 * iz);
+  }
+}
+
 p4est_geometry_t   *
 p4est_geometry_new_connectivity (p4est_connectivity_t * conn)
 {
@@ -98,6 +160,7 @@ p4est_geometry_new_connectivity (p4est_connectivity_t * conn)
   geom->name = P4EST_STRING "_connectivity";
   geom->user = conn;
   geom->X = p4est_geometry_connectivity_X;
+  geom->X_v = p4est_geometry_connectivity_X_v;
 
   return geom;
 }
@@ -47,6 +47,17 @@ typedef void        (*p4est_geometry_X_t) (p4est_geometry_t * geom,
                                            const double abc[3],
                                            double xyz[3]);
 
+/** Batched forward transformation of \a num_points reference points.
+ * This callback is optional: a geometry may leave it NULL, in which case
+ * \ref p4est_geometry_X_v falls back to the point-by-point X callback.
+ * The points are stored as 3 doubles each in \a abc and \a xyz.
+ */
+typedef void        (*p4est_geometry_X_v_t) (p4est_geometry_t * geom,
+                                             p4est_topidx_t which_tree,
+                                             size_t num_points,
+                                             const double *abc,
+                                             double *xyz);
+
 /** Destructor prototype for a user-allocated \a p4est_geometry_t.
  * It is invoked by p4est_geometry_destroy.  If the user chooses to
  * reserve the structure statically, simply don't call p4est_geometry_destroy.
@@ -61,6 +72,8 @@ struct p4est_geometry
   const char         *name;     /**< User's choice is arbitrary. */
   void               *user;     /**< User's choice is arbitrary. */
   p4est_geometry_X_t  X;        /**< Coordinate transformation. */
+  p4est_geometry_X_v_t X_v;     /**< Optional batched coordinate
+                                     transformation; may be NULL. */
   p4est_geometry_destroy_t destroy;     /**< Destructor called by
                                              p4est_geometry_destroy.  If
                                              NULL, P4EST_FREE is called. */
@@ -72,6 +85,24 @@ struct p4est_geometry
  */
 void                p4est_geometry_destroy (p4est_geometry_t * geom);
 
+/** Transform an array of reference points through a geometry.
+ * If the geometry provides the batched X_v callback, as all builtin
+ * geometries do, per-tree quantities are gathered once and reused for
+ * all points, leaving a dense vectorizable inner loop; any other
+ * geometry is evaluated by calling its X callback point by point.
+ * \param [in] geom        A valid geometry.
+ * \param [in] which_tree  Tree containing all of the points.
+ * \param [in] num_points  Number of reference points to transform.
+ * \param [in] abc         Array of \a num_points reference points
+ *                         stored as 3 doubles each.
+ * \param [out] xyz        Array of \a num_points transformed points
+ *                         stored as 3 doubles each.
+ */
+void                p4est_geometry_X_v (p4est_geometry_t * geom,
+                                      p4est_topidx_t which_tree,
+                                      size_t num_points,
+                                      const double *abc, double *xyz);
+
 /** Create a geometry structure based on the vertices in a connectivity.
  * The transformation is constructed using bilinear interpolation.
  * \param [in] conn A p4est_connectivity_t with valid vertices.  We do NOT
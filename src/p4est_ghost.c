@@ -45,6 +45,16 @@
 #ifdef P4EST_HAVE_NETINET_IN_H
 #include <netinet/in.h>
 #endif
+#ifdef P4EST_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#if defined P4EST_ENABLE_MPI && defined MPI_VERSION && MPI_VERSION >= 3
+#define P4EST_MPI_DIST_GRAPH
+#endif
+#if defined P4EST_ENABLE_MPI && defined MPI_VERSION && MPI_VERSION >= 4
+#define P4EST_MPI_PARTITIONED
+#endif
 
 typedef enum
 {
@@ -54,6 +64,23 @@ typedef enum
 }
 p4est_ghost_tolerance_t;
 
+/** Transient storage between p4est_ghost_new_begin and _end. */
+struct p4est_ghost_new_context
+{
+  p4est_t            *p4est;
+  p4est_ghost_t      *ghost;
+  int                 finished; /**< set when the layer completed without
+                                     communication; _end only cleans up */
+#ifdef P4EST_ENABLE_MPI
+  int                 num_peers;
+  MPI_Request        *recv_request;     /**< 2 * num_peers requests */
+  MPI_Request        *send_request;     /**< 2 * num_peers requests */
+  p4est_locidx_t     *recv_counts;      /**< 2 * num_peers counts */
+  sc_array_t          send_bufs;        /**< per-processor send buffers */
+  sc_array_t          procs[P4EST_DIM - 1];
+#endif
+};
+
 size_t
 p4est_ghost_memory_used (p4est_ghost_t * ghost)
 {
@@ -75,7 +102,11 @@ p4est_ghost_array_index (sc_array_t * array, int i)
 
 static p4est_ghost_t *p4est_ghost_new_check (p4est_t * p4est,
                                              p4est_connect_type_t btype,
-                                             p4est_ghost_tolerance_t tol);
+                                             p4est_ghost_tolerance_t tol,
+                                             int build,
+                                             p4est_ghost_new_t * gnc,
+                                             p4est_ghost_connect_fn_t
+                                             connect_fn);
 
 int
 p4est_quadrant_find_owner (p4est_t * p4est, p4est_topidx_t treeid,
@@ -879,7 +910,8 @@ p4est_is_balanced (p4est_t * p4est, p4est_connect_type_t btype)
 #endif
   p4est_ghost_t      *gl;
 
-  gl = p4est_ghost_new_check (p4est, btype, P4EST_GHOST_UNBALANCED_FAIL);
+  gl = p4est_ghost_new_check (p4est, btype, P4EST_GHOST_UNBALANCED_FAIL,
+                              P4EST_GHOST_BUILD_FULL, NULL, NULL);
   if (gl == NULL) {
     return 0;
   }
@@ -1205,6 +1237,7 @@ p4est_add_ghost_to_buf (sc_array_t * buf, p4est_topidx_t treeid,
 typedef struct p4est_ghost_mirror
 {
   int                 mpisize, mpirank;
+  int                 record;   /* build the persistent mirror structure? */
   int                 known;    /* was this mirror added before? */
   p4est_locidx_t      sum_all_procs;    /* sum of mirrors by processor */
   sc_array_t         *send_bufs;        /* lives in p4est_ghost_new_check */
@@ -1216,12 +1249,14 @@ p4est_ghost_mirror_t;
 /** Initialize temporary mirror storage */
 static void
 p4est_ghost_mirror_init (p4est_ghost_t * ghost, int mpirank,
-                         sc_array_t * send_bufs, p4est_ghost_mirror_t * m)
+                         sc_array_t * send_bufs, int record,
+                         p4est_ghost_mirror_t * m)
 {
   int                 p;
 
   m->mpisize = ghost->mpisize;
   m->mpirank = mpirank;
+  m->record = record;
   /* m->known is left undefined: it needs to be set to 0 for every quadrant */
   m->sum_all_procs = 0;
 
@@ -1257,19 +1292,21 @@ p4est_ghost_mirror_add (p4est_ghost_mirror_t * m, p4est_topidx_t treeid,
   P4EST_ASSERT (0 <= p && p < m->mpisize);
 
   if (!m->known) {
-    /* add this quadrant to the mirror array */
-    qnew = p4est_quadrant_array_push (m->mirrors);
-    *qnew = *q;
-
-    /* cram the tree id and the local number into the user_data pointer */
-    qnew->p.piggy3.which_tree = treeid;
-    qnew->p.piggy3.local_num = number;
+    if (m->record) {
+      /* add this quadrant to the mirror array */
+      qnew = p4est_quadrant_array_push (m->mirrors);
+      *qnew = *q;
+
+      /* cram the tree id and the local number into the user_data pointer */
+      qnew->p.piggy3.which_tree = treeid;
+      qnew->p.piggy3.local_num = number;
+    }
 
     m->known = 1;
   }
 
   buf = p4est_ghost_array_index (m->send_bufs, p);
-  if (p4est_add_ghost_to_buf (buf, treeid, number, q)) {
+  if (p4est_add_ghost_to_buf (buf, treeid, number, q) && m->record) {
     P4EST_ASSERT (m->mirrors->elem_count > 0);
 
     num = (p4est_locidx_t *) sc_array_push (m->offsets_by_proc + p);
@@ -1416,9 +1453,132 @@ p4est_ghost_test_add (p4est_t * p4est, p4est_ghost_mirror_t * m,
 
 #endif /* P4EST_ENABLE_MPI */
 
+#ifdef P4EST_ENABLE_MPI
+
+/** Wait for the ghost load messages and free the transient buffers. */
+static void
+p4est_ghost_new_wait (p4est_t * p4est, p4est_ghost_t * gl,
+                      int num_peers, MPI_Request * recv_request,
+                      MPI_Request * send_request,
+                      p4est_locidx_t * recv_counts,
+                      sc_array_t * send_bufs, sc_array_t * procs)
+{
+  const int           num_procs = p4est->mpisize;
+  int                 i;
+  int                 mpiret;
+  sc_array_t         *buf;
+#ifdef P4EST_ENABLE_DEBUG
+  const p4est_topidx_t num_trees = p4est->connectivity->num_trees;
+  sc_array_t         *ghost_layer = &gl->ghosts;
+  p4est_locidx_t      li, num_ghosts;
+  p4est_quadrant_t   *q, *q2;
+#endif
+
+  /* Wait for everything */
+  if (num_peers > 0) {
+    mpiret = MPI_Waitall (num_peers, recv_request + num_peers,
+                          MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+
+    mpiret = MPI_Waitall (num_peers, send_request + num_peers,
+                          MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+  }
+
+  /* Clean up */
+  P4EST_FREE (recv_counts);
+
+#ifdef P4EST_ENABLE_DEBUG
+  for (i = 0; i < num_peers; ++i) {
+    P4EST_ASSERT (recv_request[num_peers + i] == MPI_REQUEST_NULL);
+  }
+  for (i = 0; i < num_peers; ++i) {
+    P4EST_ASSERT (send_request[num_peers + i] == MPI_REQUEST_NULL);
+  }
+  q2 = NULL;
+  num_ghosts = (p4est_locidx_t) ghost_layer->elem_count;
+  for (li = 0; li < num_ghosts; ++li) {
+    q = p4est_quadrant_array_index (ghost_layer, (size_t) li);
+    P4EST_ASSERT (p4est_quadrant_is_valid (q));
+    P4EST_ASSERT (q->p.piggy1.which_tree >= 0 &&
+                  q->p.piggy1.which_tree < num_trees);
+    P4EST_ASSERT (q->p.piggy3.local_num >= 0);
+    if (q2 != NULL) {
+      P4EST_ASSERT (p4est_quadrant_compare_piggy (q2, q) < 0);
+    }
+    q2 = q;
+  }
+#endif
+
+  P4EST_FREE (recv_request);
+  P4EST_FREE (send_request);
+
+  for (i = 0; i < num_procs; ++i) {
+    buf = p4est_ghost_array_index (send_bufs, i);
+    sc_array_reset (buf);
+  }
+  sc_array_reset (send_bufs);
+  for (i = 0; i < P4EST_DIM - 1; ++i) {
+    sc_array_reset (&procs[i]);
+  }
+}
+
+#endif /* P4EST_ENABLE_MPI */
+
+/** Compute the tree offsets and finalize a received ghost layer. */
+static p4est_ghost_t *
+p4est_ghost_new_finish (p4est_t * p4est, p4est_ghost_t * gl, int build)
+{
+  const p4est_topidx_t num_trees = p4est->connectivity->num_trees;
+  sc_array_t         *ghost_layer = &gl->ghosts;
+  p4est_topidx_t      nt;
+  size_t             *ppz;
+  sc_array_t          split;
+
+  /* calculate tree offsets */
+  sc_array_init (&split, sizeof (size_t));
+  sc_array_split (ghost_layer, &split,
+                  (size_t) num_trees, ghost_tree_type, NULL);
+  P4EST_ASSERT (split.elem_count == (size_t) num_trees + 1);
+  for (nt = 0; nt <= num_trees; ++nt) {
+    ppz = (size_t *) sc_array_index (&split, (size_t) nt);
+    gl->tree_offsets[nt] = *ppz;
+#ifdef P4EST_ENABLE_DEBUG
+    if (nt > 0) {
+      p4est_locidx_t      lk;
+      p4est_quadrant_t   *q3;
+
+      for (lk = gl->tree_offsets[nt - 1]; lk < gl->tree_offsets[nt]; ++lk) {
+        q3 = p4est_quadrant_array_index (ghost_layer, (size_t) lk);
+        SC_CHECK_ABORT (q3->p.which_tree == nt - 1, "Ghost tree offset");
+      }
+    }
+#endif
+#ifndef P4EST_ENABLE_MPI
+    gl->mirror_tree_offsets[nt] = 0;
+#endif
+  }
+  sc_array_reset (&split);
+  P4EST_ASSERT (gl->tree_offsets[0] == 0);
+  P4EST_ASSERT (gl->proc_offsets[0] == 0);
+
+  gl->mirror_proc_fronts = gl->mirror_proc_mirrors;
+  gl->mirror_proc_front_offsets = gl->mirror_proc_offsets;
+
+  /* the validity check relies on both sides of the layer being present */
+  P4EST_ASSERT (build != P4EST_GHOST_BUILD_FULL ||
+                p4est_ghost_is_valid (p4est, gl));
+
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_ghost_new\n");
+  return gl;
+}
+
 static p4est_ghost_t *
 p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
-                       p4est_ghost_tolerance_t tol)
+                       p4est_ghost_tolerance_t tol, int build,
+                       p4est_ghost_new_t * gnc,
+                       p4est_ghost_connect_fn_t connect_fn)
 {
   const p4est_topidx_t num_trees = p4est->connectivity->num_trees;
   const int           num_procs = p4est->mpisize;
@@ -1438,9 +1598,6 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
   size_t              pz, zz;
   p4est_topidx_t      first_local_tree = p4est->first_local_tree;
   p4est_topidx_t      last_local_tree = p4est->last_local_tree;
-#ifdef P4EST_ENABLE_DEBUG
-  p4est_locidx_t      li;
-#endif
   p4est_locidx_t      local_num;
   p4est_locidx_t      num_ghosts, ghost_offset, skipped;
   p4est_locidx_t     *send_counts, *recv_counts;
@@ -1463,21 +1620,17 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
   int                 nc0, nc1;
   int                 oppedge;
   int                 n1ur_proc;
-#endif
-#ifdef P4EST_ENABLE_DEBUG
-  p4est_quadrant_t   *q2;
 #endif
   int                 ftransform[P4EST_FTRANSFORM];
   int32_t             touch;
   p4est_topidx_t      nnt;
+  p4est_connect_type_t qtype;
   p4est_corner_info_t ci;
   p4est_corner_transform_t *ct;
   sc_array_t         *cta;
   size_t              ctree;
   p4est_ghost_mirror_t m;
 #endif
-  size_t             *ppz;
-  sc_array_t          split;
   sc_array_t         *ghost_layer;
   p4est_topidx_t      nt;
   p4est_ghost_t      *gl;
@@ -1502,6 +1655,10 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
   gl->mirror_proc_offsets = P4EST_ALLOC (p4est_locidx_t, num_procs + 1);
   gl->mirror_proc_fronts = NULL;
   gl->mirror_proc_front_offsets = NULL;
+  gl->mirror_proc_by_level = NULL;
+  gl->mirror_proc_level_offsets = NULL;
+  gl->ghost_proc_by_level = NULL;
+  gl->ghost_proc_level_offsets = NULL;
 
   gl->proc_offsets[0] = 0;
   gl->mirror_proc_offsets[0] = 0;
@@ -1509,6 +1666,20 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
   gl->proc_offsets[1] = 0;
   gl->mirror_proc_offsets[1] = 0;
 #else
+  if (num_procs == 1) {
+    /* a single-process forest has no remote neighbors at all: skip the
+     * quadrant traversal and the notify handshake for minimal latency */
+    gl->proc_offsets[1] = 0;
+    gl->mirror_proc_offsets[1] = 0;
+    for (nt = 0; nt <= num_trees; ++nt) {
+      gl->mirror_tree_offsets[nt] = 0;
+    }
+    gl->mirror_proc_mirrors = P4EST_ALLOC (p4est_locidx_t, 0);
+    if (gnc != NULL) {
+      gnc->finished = 1;
+    }
+    return p4est_ghost_new_finish (p4est, gl, build);
+  }
 #ifdef P4_TO_P8
   eta = &ei.edge_transforms;
 #endif
@@ -1534,7 +1705,8 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
   }
 
   /* initialize structure to keep track of mirror quadrants */
-  p4est_ghost_mirror_init (gl, p4est->mpirank, &send_bufs, &m);
+  p4est_ghost_mirror_init (gl, p4est->mpirank, &send_bufs,
+                           build & P4EST_GHOST_BUILD_MIRRORS, &m);
 
   /* loop over all local trees */
   local_num = 0;
@@ -1561,6 +1733,13 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
         continue;
       }
 
+      /* determine the connect type requested for this quadrant */
+      qtype = btype;
+      if (connect_fn != NULL && btype != P4EST_CONNECT_FACE) {
+        qtype = connect_fn (p4est, nt, q);
+        P4EST_ASSERT (P4EST_CONNECT_FACE <= qtype && qtype <= btype);
+      }
+
       /* Find smaller face neighbors */
       for (face = 0; face < 2 * P4EST_DIM; ++face) {
         if (tol < P4EST_GHOST_UNBALANCED_ALLOW) {
@@ -1623,7 +1802,7 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
         }
       }
 
-      if (btype == P4EST_CONNECT_FACE)
+      if (qtype == P4EST_CONNECT_FACE)
         continue;
 
 #ifdef P4_TO_P8
@@ -1794,7 +1973,7 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
         }
       }
 
-      if (btype == P8EST_CONNECT_EDGE)
+      if (qtype == P8EST_CONNECT_EDGE)
         continue;
 #endif
 
@@ -1968,7 +2147,7 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
         }
       }
 
-      P4EST_ASSERT (btype == P4EST_CONNECT_FULL);
+      P4EST_ASSERT (qtype == P4EST_CONNECT_FULL);
     }
   }
   P4EST_ASSERT (local_num == p4est->local_num_quadrants);
@@ -2018,10 +2197,19 @@ failtest:
   recv_load_request = recv_request + num_peers;
   send_load_request = send_request + num_peers;
 
+  if (!(build & P4EST_GHOST_BUILD_GHOSTS)) {
+    /* a mirror-only layer is defined on the sender: no messages at all */
+    for (i = 0; i < 2 * num_peers; ++i) {
+      recv_request[i] = MPI_REQUEST_NULL;
+      send_request[i] = MPI_REQUEST_NULL;
+    }
+    memset (recv_counts, 0, 2 * num_peers * sizeof (p4est_locidx_t));
+  }
+
   /* Post receives for the counts of ghosts to be received */
   for (i = 0, peer = 0; i < num_procs; ++i) {
     buf = p4est_ghost_array_index (&send_bufs, i);
-    if (buf->elem_count > 0) {
+    if ((build & P4EST_GHOST_BUILD_GHOSTS) && buf->elem_count > 0) {
       peer_proc = i;
       P4EST_ASSERT (peer_proc != rank);
       P4EST_LDEBUGF ("ghost layer post count receive from %d\n", peer_proc);
@@ -2036,7 +2224,7 @@ failtest:
   /* Send the counts of ghosts that are going to be sent */
   for (i = 0, peer = 0; i < num_procs; ++i) {
     buf = p4est_ghost_array_index (&send_bufs, i);
-    if (buf->elem_count > 0) {
+    if ((build & P4EST_GHOST_BUILD_GHOSTS) && buf->elem_count > 0) {
       peer_proc = i;
       send_counts[peer] = (p4est_locidx_t) buf->elem_count;
       P4EST_LDEBUGF ("ghost layer post count send %lld to %d\n",
@@ -2072,7 +2260,8 @@ failtest:
 
   /* Count ghosts */
   for (peer = 0, num_ghosts = 0; peer < num_peers; ++peer) {
-    P4EST_ASSERT (recv_counts[peer] > 0);
+    P4EST_ASSERT (!(build & P4EST_GHOST_BUILD_GHOSTS) ||
+                  recv_counts[peer] > 0);
     num_ghosts += recv_counts[peer];    /* same type */
   }
   P4EST_VERBOSEF ("Total quadrants skipped %lld ghosts to receive %lld\n",
@@ -2084,7 +2273,7 @@ failtest:
   /* Post receives for the ghosts */
   for (i = 0, peer = 0, ghost_offset = 0; i < num_procs; ++i) {
     buf = p4est_ghost_array_index (&send_bufs, i);
-    if (buf->elem_count > 0) {
+    if ((build & P4EST_GHOST_BUILD_GHOSTS) && buf->elem_count > 0) {
       peer_proc = i;
       P4EST_LDEBUGF
         ("ghost layer post ghost receive %lld quadrants from %d\n",
@@ -2108,7 +2297,7 @@ failtest:
   /* Send the ghosts */
   for (i = 0, peer = 0; i < num_procs; ++i) {
     buf = p4est_ghost_array_index (&send_bufs, i);
-    if (buf->elem_count > 0) {
+    if ((build & P4EST_GHOST_BUILD_GHOSTS) && buf->elem_count > 0) {
       peer_proc = i;
       P4EST_ASSERT ((p4est_locidx_t) buf->elem_count == send_counts[peer]);
       P4EST_LDEBUGF ("ghost layer post ghost send %lld quadrants to %d\n",
@@ -2119,221 +2308,2059 @@ failtest:
                    MPI_BYTE, peer_proc, P4EST_COMM_GHOST_LOAD, comm,
                    send_load_request + peer);
       SC_CHECK_MPI (mpiret);
+      if (p4est->inspect != NULL) {
+        p4est->inspect->ghost_comm_sent +=
+          send_counts[peer] * sizeof (p4est_quadrant_t);
+      }
       ++peer;
     }
   }
 
-  /* Wait for everything */
-  if (num_peers > 0) {
-    mpiret = MPI_Waitall (num_peers, recv_load_request, MPI_STATUSES_IGNORE);
-    SC_CHECK_MPI (mpiret);
-
-    mpiret = MPI_Waitall (num_peers, send_load_request, MPI_STATUSES_IGNORE);
-    SC_CHECK_MPI (mpiret);
-  }
-
-  /* Clean up */
-  P4EST_FREE (recv_counts);
-
-#ifdef P4EST_ENABLE_DEBUG
-  for (i = 0; i < num_peers; ++i) {
-    P4EST_ASSERT (recv_load_request[i] == MPI_REQUEST_NULL);
-  }
-  for (i = 0; i < num_peers; ++i) {
-    P4EST_ASSERT (send_load_request[i] == MPI_REQUEST_NULL);
-  }
-  q2 = NULL;
-  for (li = 0; li < num_ghosts; ++li) {
-    q = p4est_quadrant_array_index (ghost_layer, (size_t) li);
-    P4EST_ASSERT (p4est_quadrant_is_valid (q));
-    P4EST_ASSERT (q->p.piggy1.which_tree >= 0 &&
-                  q->p.piggy1.which_tree < num_trees);
-    P4EST_ASSERT (q->p.piggy3.local_num >= 0);
-    if (q2 != NULL) {
-      P4EST_ASSERT (p4est_quadrant_compare_piggy (q2, q) < 0);
-    }
-    q2 = q;
+  if (gnc != NULL) {
+    /* defer the load waits and cleanup to p4est_ghost_new_end */
+    gnc->num_peers = num_peers;
+    gnc->recv_request = recv_request;
+    gnc->send_request = send_request;
+    gnc->recv_counts = recv_counts;
+    gnc->send_bufs = send_bufs;
+    memcpy (gnc->procs, procs, sizeof (procs));
+    return gl;
   }
-#endif
 
-  P4EST_FREE (recv_request);
-  P4EST_FREE (send_request);
-
-  for (i = 0; i < num_procs; ++i) {
-    buf = p4est_ghost_array_index (&send_bufs, i);
-    sc_array_reset (buf);
-  }
-  sc_array_reset (&send_bufs);
-  for (i = 0; i < P4EST_DIM - 1; ++i) {
-    sc_array_reset (&procs[i]);
+  p4est_ghost_new_wait (p4est, gl, num_peers, recv_request, send_request,
+                        recv_counts, &send_bufs, procs);
+#else
+  if (gnc != NULL) {
+    return gl;
   }
 #endif /* P4EST_ENABLE_MPI */
 
-  /* calculate tree offsets */
-  sc_array_init (&split, sizeof (size_t));
-  sc_array_split (ghost_layer, &split,
-                  (size_t) num_trees, ghost_tree_type, NULL);
-  P4EST_ASSERT (split.elem_count == (size_t) num_trees + 1);
-  for (nt = 0; nt <= num_trees; ++nt) {
-    ppz = (size_t *) sc_array_index (&split, (size_t) nt);
-    gl->tree_offsets[nt] = *ppz;
-#ifdef P4EST_ENABLE_DEBUG
-    if (nt > 0) {
-      p4est_locidx_t      lk;
-      p4est_quadrant_t   *q3;
-
-      for (lk = gl->tree_offsets[nt - 1]; lk < gl->tree_offsets[nt]; ++lk) {
-        q3 = p4est_quadrant_array_index (ghost_layer, (size_t) lk);
-        SC_CHECK_ABORT (q3->p.which_tree == nt - 1, "Ghost tree offset");
-      }
-    }
-#endif
-#ifndef P4EST_ENABLE_MPI
-    gl->mirror_tree_offsets[nt] = 0;
-#endif
-  }
-  sc_array_reset (&split);
-  P4EST_ASSERT (gl->tree_offsets[0] == 0);
-  P4EST_ASSERT (gl->proc_offsets[0] == 0);
-
-  gl->mirror_proc_fronts = gl->mirror_proc_mirrors;
-  gl->mirror_proc_front_offsets = gl->mirror_proc_offsets;
-
-  P4EST_ASSERT (p4est_ghost_is_valid (p4est, gl));
-
-  p4est_log_indent_pop ();
-  P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_ghost_new\n");
-  return gl;
+  return p4est_ghost_new_finish (p4est, gl, build);
 }
 
-p4est_ghost_t      *
-p4est_ghost_new (p4est_t * p4est, p4est_connect_type_t btype)
+/** A (receiver, local index) pair recorded while synthesizing mirrors. */
+typedef struct p4est_ghost_uniform_pair
 {
-  return p4est_ghost_new_check (p4est, btype, P4EST_GHOST_UNBALANCED_ALLOW);
+  int                 peer;     /**< process that sees the mirror */
+  p4est_locidx_t      lidx;     /**< cumulative local quadrant index */
 }
+p4est_ghost_uniform_pair_t;
 
-void
-p4est_ghost_destroy (p4est_ghost_t * ghost)
+static int
+p4est_ghost_uniform_pair_compare (const void *v1, const void *v2)
 {
-  sc_array_reset (&ghost->ghosts);
-  P4EST_FREE (ghost->tree_offsets);
-  P4EST_FREE (ghost->proc_offsets);
+  const p4est_ghost_uniform_pair_t *p1 =
+    (const p4est_ghost_uniform_pair_t *) v1;
+  const p4est_ghost_uniform_pair_t *p2 =
+    (const p4est_ghost_uniform_pair_t *) v2;
 
-  if (ghost->mirror_proc_fronts != ghost->mirror_proc_mirrors) {
-    P4EST_ASSERT (ghost->mirror_proc_front_offsets !=
-                  ghost->mirror_proc_offsets);
-    P4EST_FREE (ghost->mirror_proc_fronts);
-    P4EST_FREE (ghost->mirror_proc_front_offsets);
+  if (p1->peer != p2->peer) {
+    return p1->peer - p2->peer;
   }
-
-  sc_array_reset (&ghost->mirrors);
-  P4EST_FREE (ghost->mirror_tree_offsets);
-  P4EST_FREE (ghost->mirror_proc_mirrors);
-  P4EST_FREE (ghost->mirror_proc_offsets);
-
-  P4EST_FREE (ghost);
+  return (p1->lidx == p2->lidx) ? 0 : ((p1->lidx < p2->lidx) ? -1 : 1);
 }
 
-unsigned
-p4est_ghost_checksum (p4est_t * p4est, p4est_ghost_t * ghost)
+/** Return the process that owns the global quadrant number \a gidx. */
+static int
+p4est_ghost_uniform_owner (p4est_t * p4est, p4est_gloidx_t gidx)
 {
-  unsigned            crc;
-  uint32_t           *check;
-  size_t              zz, csize, qcount, offset;
-  size_t              nt1, np1, local_count;
-  sc_array_t         *quadrants, *checkarray;
-  p4est_quadrant_t   *q;
-
-  quadrants = &ghost->ghosts;
-  qcount = quadrants->elem_count;
-  nt1 = (size_t) p4est->connectivity->num_trees + 1;
-  np1 = (size_t) p4est->mpisize + 1;
-
-  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
-
-  csize = sizeof (uint32_t);
-  checkarray = sc_array_new (csize);
-
-  local_count = qcount * (P4EST_DIM + 3) + nt1 + np1;
-  sc_array_resize (checkarray, local_count);
-
-  /* checksum ghost quadrants */
-  for (zz = 0; zz < qcount; ++zz) {
-    q = p4est_quadrant_array_index (quadrants, zz);
-    P4EST_ASSERT (p4est_quadrant_is_valid (q));
-    check = (uint32_t *) sc_array_index (checkarray, zz * (P4EST_DIM + 3));
-    check[0] = htonl ((uint32_t) q->x);
-    check[1] = htonl ((uint32_t) q->y);
-#ifdef P4_TO_P8
-    check[2] = htonl ((uint32_t) q->z);
-#endif
-    check[P4EST_DIM] = htonl ((uint32_t) q->level);
-    check[P4EST_DIM + 1] = htonl ((uint32_t) q->p.piggy3.which_tree);
-    check[P4EST_DIM + 2] = htonl ((uint32_t) q->p.piggy3.local_num);
+  const p4est_gloidx_t *gfq = p4est->global_first_quadrant;
+  int                 lo, hi, mid;
+
+  P4EST_ASSERT (0 <= gidx && gidx < p4est->global_num_quadrants);
+
+  /* invariant: gfq[lo] <= gidx < gfq[hi]; empty processes repeat the
+   * offset of their successor and are never returned */
+  lo = 0;
+  hi = p4est->mpisize;
+  while (hi - lo > 1) {
+    mid = (lo + hi) / 2;
+    if (gfq[mid] <= gidx) {
+      lo = mid;
+    }
+    else {
+      hi = mid;
+    }
   }
+  return lo;
+}
 
-  /* checksum tree_offsets */
-  offset = qcount * (P4EST_DIM + 3);
-  for (zz = 0; zz < nt1; ++zz) {
-    check = (uint32_t *) sc_array_index (checkarray, offset + zz);
-    *check = htonl ((uint32_t) ghost->tree_offsets[zz]);
-  }
+/** Record one same-size neighbor while synthesizing a uniform ghost layer.
+ * Nothing is recorded for neighbors owned by the local process.
+ */
+static void
+p4est_ghost_uniform_add (p4est_t * p4est, int level,
+                         p4est_gloidx_t quads_per_tree,
+                         p4est_topidx_t nt, const p4est_quadrant_t * nq,
+                         p4est_locidx_t local_num, sc_array_t * gcand,
+                         sc_array_t * mcand)
+{
+  int                 owner;
+  p4est_gloidx_t      gidx;
+  p4est_quadrant_t   *g;
+  p4est_ghost_uniform_pair_t *pair;
 
-  /* checksum proc_offsets */
-  offset += nt1;
-  for (zz = 0; zz < np1; ++zz) {
-    check = (uint32_t *) sc_array_index (checkarray, offset + zz);
-    *check = htonl ((uint32_t) ghost->proc_offsets[zz]);
+  gidx = (p4est_gloidx_t) nt * quads_per_tree +
+    (p4est_gloidx_t) p4est_quadrant_linear_id (nq, level);
+  owner = p4est_ghost_uniform_owner (p4est, gidx);
+  if (owner == p4est->mpirank) {
+    return;
   }
-  P4EST_ASSERT (offset + zz == local_count);
 
-  /* compute parallel checksum */
-  crc = sc_array_checksum (checkarray);
-  sc_array_destroy (checkarray);
+  g = p4est_quadrant_array_push (gcand);
+  *g = *nq;
+  g->p.piggy3.which_tree = nt;
+  g->p.piggy3.local_num =
+    (p4est_locidx_t) (gidx - p4est->global_first_quadrant[owner]);
 
-  return p4est_comm_checksum (p4est, crc, csize * local_count);
+  pair = (p4est_ghost_uniform_pair_t *) sc_array_push (mcand);
+  pair->peer = owner;
+  pair->lidx = local_num;
 }
 
-void
+/** Synthesize the ghost layer of a globally uniform forest.
+ * When every leaf of the forest sits on one and the same level, all
+ * same-size neighbors exist and are computable arithmetically, so the
+ * ghost and mirror structure follows from a purely local enumeration
+ * without insulation searches or any quadrant communication; the only
+ * message is one allreduce agreeing on the refinement level.
+ * \return          the ghost layer, or NULL if the forest
+ *                  is not uniformly refined.
+ */
+static p4est_ghost_t *
+p4est_ghost_new_uniform (p4est_t * p4est, p4est_connect_type_t btype)
+{
+  const int           num_procs = p4est->mpisize;
+  const int           ctype_int = p4est_connect_type_int (btype);
+  int                 mpiret;
+  int                 f, c, level, uniform, proc;
+  int                 inlevel[2], outlevel[2];
+  size_t              zz, zy;
+  p4est_topidx_t      nt, ntree, wt, tcur;
+  p4est_topidx_t      first_local_tree = p4est->first_local_tree;
+  p4est_topidx_t      last_local_tree = p4est->last_local_tree;
+  p4est_topidx_t      num_trees = p4est->connectivity->num_trees;
+  p4est_connectivity_t *conn = p4est->connectivity;
+  p4est_locidx_t      local_num, ml, npairs;
+  p4est_gloidx_t      quads_per_tree, gidx;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, *g, *prev, *mirror;
+  p4est_quadrant_t    nq;
+  p4est_ghost_t      *gl;
+  p4est_ghost_uniform_pair_t *pair, *prevpair;
+  sc_array_t          gcand, mcand, mlidx;
+  sc_array_t         *tempquads, *temptrees;
+  p4est_corner_resolver_t *cres;
+#ifdef P4_TO_P8
+  int                 e;
+#endif
+
+  /* check whether all local quadrants sit on one refinement level */
+  level = -1;
+  uniform = 1;
+  if (p4est->local_num_quadrants > 0) {
+    tree = p4est_tree_array_index (p4est->trees, first_local_tree);
+    level = (int) p4est_quadrant_array_index (&tree->quadrants, 0)->level;
+    for (nt = first_local_tree; nt <= last_local_tree; ++nt) {
+      tree = p4est_tree_array_index (p4est->trees, nt);
+      if ((int) tree->maxlevel != level ||
+          (size_t) tree->quadrants_per_level[level] !=
+          tree->quadrants.elem_count) {
+        uniform = 0;
+        break;
+      }
+    }
+  }
+
+  /* agree globally on the level; empty processes stay neutral */
+  inlevel[0] = !uniform ? -1 :
+    (p4est->local_num_quadrants > 0 ? level : P4EST_MAXLEVEL + 1);
+  inlevel[1] = (uniform && p4est->local_num_quadrants > 0) ?
+    -level : P4EST_MAXLEVEL + 1;
+  mpiret = sc_MPI_Allreduce (inlevel, outlevel, 2, sc_MPI_INT, sc_MPI_MIN,
+                             p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  if (outlevel[0] < 0 || outlevel[0] > P4EST_MAXLEVEL ||
+      outlevel[0] != -outlevel[1]) {
+    return NULL;
+  }
+  level = outlevel[0];
+
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_ghost_new %s"
+                            " uniform level %d\n",
+                            p4est_connect_type_string (btype), level);
+  p4est_log_indent_push ();
+
+  gl = P4EST_ALLOC (p4est_ghost_t, 1);
+  gl->mpisize = num_procs;
+  gl->num_trees = num_trees;
+  gl->btype = btype;
+  sc_array_init (&gl->ghosts, sizeof (p4est_quadrant_t));
+  gl->tree_offsets = P4EST_ALLOC (p4est_locidx_t, num_trees + 1);
+  gl->proc_offsets = P4EST_ALLOC (p4est_locidx_t, num_procs + 1);
+  sc_array_init (&gl->mirrors, sizeof (p4est_quadrant_t));
+  gl->mirror_tree_offsets = P4EST_ALLOC (p4est_locidx_t, num_trees + 1);
+  gl->mirror_proc_offsets = P4EST_ALLOC (p4est_locidx_t, num_procs + 1);
+  gl->mirror_proc_mirrors = NULL;
+  gl->mirror_proc_fronts = NULL;
+  gl->mirror_proc_front_offsets = NULL;
+  gl->mirror_proc_by_level = NULL;
+  gl->mirror_proc_level_offsets = NULL;
+  gl->ghost_proc_by_level = NULL;
+  gl->ghost_proc_level_offsets = NULL;
+
+  /* enumerate the same-size neighborhood of every local quadrant and
+   * keep what other processes own; the relation is symmetric, so the
+   * same sweep yields the mirrors each peer will construct as ghosts */
+  quads_per_tree = (p4est_gloidx_t) 1 << (P4EST_DIM * level);
+  sc_array_init (&gcand, sizeof (p4est_quadrant_t));
+  sc_array_init (&mcand, sizeof (p4est_ghost_uniform_pair_t));
+  tempquads = sc_array_new (sizeof (p4est_quadrant_t));
+  temptrees = sc_array_new (sizeof (p4est_topidx_t));
+  /* every boundary quadrant of a tree corner repeats the same transform
+   * derivation, so answer the corner queries through a cached resolver */
+  cres = (ctype_int >= P4EST_DIM) ? p4est_corner_resolver_new (conn) : NULL;
+  local_num = 0;
+  for (nt = first_local_tree; nt <= last_local_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz, ++local_num) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      for (f = 0; f < P4EST_FACES; ++f) {
+        ntree = p4est_quadrant_face_neighbor_extra (q, nt, f, &nq, NULL,
+                                                    conn);
+        if (ntree < 0) {
+          continue;
+        }
+        p4est_ghost_uniform_add (p4est, level, quads_per_tree, ntree, &nq,
+                                 local_num, &gcand, &mcand);
+      }
+#ifdef P4_TO_P8
+      if (ctype_int >= 2) {
+        for (e = 0; e < P8EST_EDGES; ++e) {
+          p8est_quadrant_edge_neighbor_extra (q, nt, e, tempquads, temptrees,
+                                              NULL, conn);
+          for (zy = 0; zy < tempquads->elem_count; ++zy) {
+            p4est_ghost_uniform_add (p4est, level, quads_per_tree,
+                                     *(p4est_topidx_t *)
+                                     sc_array_index (temptrees, zy),
+                                     p4est_quadrant_array_index (tempquads,
+                                                                 zy),
+                                     local_num, &gcand, &mcand);
+          }
+          sc_array_reset (tempquads);
+          sc_array_reset (temptrees);
+        }
+      }
+#endif
+      if (ctype_int >= P4EST_DIM) {
+        for (c = 0; c < P4EST_CHILDREN; ++c) {
+          p4est_quadrant_corner_neighbor_resolve (cres, q, nt, c, tempquads,
+                                                  temptrees, NULL);
+          for (zy = 0; zy < tempquads->elem_count; ++zy) {
+            p4est_ghost_uniform_add (p4est, level, quads_per_tree,
+                                     *(p4est_topidx_t *)
+                                     sc_array_index (temptrees, zy),
+                                     p4est_quadrant_array_index (tempquads,
+                                                                 zy),
+                                     local_num, &gcand, &mcand);
+          }
+          sc_array_reset (tempquads);
+          sc_array_reset (temptrees);
+        }
+      }
+    }
+  }
+  sc_array_destroy (tempquads);
+  sc_array_destroy (temptrees);
+  if (cres != NULL) {
+    p4est_corner_resolver_destroy (cres);
+  }
+
+  /* the ghosts sorted by tree and Morton index are also grouped by
+   * ascending owner, since the partition follows the global order */
+  p4est_quadrant_array_sort (&gcand, p4est_quadrant_compare_piggy);
+  prev = NULL;
+  for (zz = 0; zz < gcand.elem_count; ++zz) {
+    g = p4est_quadrant_array_index (&gcand, zz);
+    if (prev != NULL && p4est_quadrant_is_equal_piggy (prev, g)) {
+      continue;
+    }
+    prev = p4est_quadrant_array_push (&gl->ghosts);
+    *prev = *g;
+  }
+  sc_array_reset (&gcand);
+
+  gl->tree_offsets[0] = 0;
+  gl->proc_offsets[0] = 0;
+  tcur = 0;
+  proc = 0;
+  for (zz = 0; zz < gl->ghosts.elem_count; ++zz) {
+    g = p4est_quadrant_array_index (&gl->ghosts, zz);
+    wt = g->p.piggy3.which_tree;
+    gidx = (p4est_gloidx_t) wt * quads_per_tree +
+      (p4est_gloidx_t) p4est_quadrant_linear_id (g, level);
+    while (tcur < wt) {
+      gl->tree_offsets[++tcur] = (p4est_locidx_t) zz;
+    }
+    while (proc < p4est_ghost_uniform_owner (p4est, gidx)) {
+      gl->proc_offsets[++proc] = (p4est_locidx_t) zz;
+    }
+  }
+  while (tcur < num_trees) {
+    gl->tree_offsets[++tcur] = (p4est_locidx_t) gl->ghosts.elem_count;
+  }
+  while (proc < num_procs) {
+    gl->proc_offsets[++proc] = (p4est_locidx_t) gl->ghosts.elem_count;
+  }
+
+  /* unique (peer, mirror) pairs grouped by peer; the distinct local
+   * indices in ascending order form the mirror array itself */
+  sc_array_sort (&mcand, p4est_ghost_uniform_pair_compare);
+  npairs = 0;
+  prevpair = NULL;
+  for (zz = 0; zz < mcand.elem_count; ++zz) {
+    pair = (p4est_ghost_uniform_pair_t *) sc_array_index (&mcand, zz);
+    if (prevpair != NULL && prevpair->peer == pair->peer &&
+        prevpair->lidx == pair->lidx) {
+      continue;
+    }
+    prevpair = (p4est_ghost_uniform_pair_t *) sc_array_index (&mcand,
+                                                              (size_t)
+                                                              npairs);
+    *prevpair = *pair;
+    ++npairs;
+  }
+  sc_array_resize (&mcand, (size_t) npairs);
+
+  sc_array_init (&mlidx, sizeof (p4est_locidx_t));
+  for (zz = 0; zz < mcand.elem_count; ++zz) {
+    pair = (p4est_ghost_uniform_pair_t *) sc_array_index (&mcand, zz);
+    *(p4est_locidx_t *) sc_array_push (&mlidx) = pair->lidx;
+  }
+  sc_array_sort (&mlidx, p4est_locidx_compare);
+  sc_array_uniq (&mlidx, p4est_locidx_compare);
+
+  /* reconstruct the mirror quadrants from their ascending local index */
+  gl->mirror_tree_offsets[0] = 0;
+  tcur = 0;
+  nt = first_local_tree;
+  for (zz = 0; zz < mlidx.elem_count; ++zz) {
+    ml = *(p4est_locidx_t *) sc_array_index (&mlidx, zz);
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    while (ml >= tree->quadrants_offset +
+           (p4est_locidx_t) tree->quadrants.elem_count) {
+      tree = p4est_tree_array_index (p4est->trees, ++nt);
+    }
+    while (tcur < nt) {
+      gl->mirror_tree_offsets[++tcur] = (p4est_locidx_t) zz;
+    }
+    mirror = p4est_quadrant_array_push (&gl->mirrors);
+    *mirror = *p4est_quadrant_array_index (&tree->quadrants,
+                                           (size_t) (ml -
+                                                     tree->
+                                                     quadrants_offset));
+    mirror->p.piggy3.which_tree = nt;
+    mirror->p.piggy3.local_num = ml;
+  }
+  while (tcur < num_trees) {
+    gl->mirror_tree_offsets[++tcur] = (p4est_locidx_t) gl->mirrors.elem_count;
+  }
+
+  /* per-peer mirror lists index into the mirror array */
+  gl->mirror_proc_mirrors = P4EST_ALLOC (p4est_locidx_t, (size_t) npairs);
+  gl->mirror_proc_offsets[0] = 0;
+  proc = 0;
+  for (zz = 0; zz < mcand.elem_count; ++zz) {
+    pair = (p4est_ghost_uniform_pair_t *) sc_array_index (&mcand, zz);
+    while (proc < pair->peer) {
+      gl->mirror_proc_offsets[++proc] = (p4est_locidx_t) zz;
+    }
+    gl->mirror_proc_mirrors[zz] = (p4est_locidx_t)
+      sc_array_bsearch (&mlidx, &pair->lidx, p4est_locidx_compare);
+    P4EST_ASSERT (gl->mirror_proc_mirrors[zz] >= 0);
+  }
+  while (proc < num_procs) {
+    gl->mirror_proc_offsets[++proc] = (p4est_locidx_t) mcand.elem_count;
+  }
+  sc_array_reset (&mlidx);
+  sc_array_reset (&mcand);
+
+  gl->mirror_proc_fronts = gl->mirror_proc_mirrors;
+  gl->mirror_proc_front_offsets = gl->mirror_proc_offsets;
+
+  P4EST_VERBOSEF ("Uniform ghost layer with %lld ghosts %lld mirrors\n",
+                  (long long) gl->ghosts.elem_count,
+                  (long long) gl->mirrors.elem_count);
+  P4EST_ASSERT (p4est_ghost_is_valid (p4est, gl));
+
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_ghost_new\n");
+
+  return gl;
+}
+
+p4est_ghost_t      *
+p4est_ghost_new (p4est_t * p4est, p4est_connect_type_t btype)
+{
+  double              tstart = 0.;
+  p4est_ghost_t      *gl;
+
+  if (p4est->inspect != NULL) {
+    tstart = sc_MPI_Wtime ();
+  }
+  P4EST_PHASE_BEGIN (P4EST_STRING "_ghost_new");
+  /* uniformly refined forests allow a communication-free synthesis */
+  gl = p4est_ghost_new_uniform (p4est, btype);
+  if (gl == NULL) {
+    gl = p4est_ghost_new_check (p4est, btype, P4EST_GHOST_UNBALANCED_ALLOW,
+                                P4EST_GHOST_BUILD_FULL, NULL, NULL);
+  }
+  P4EST_PHASE_END (P4EST_STRING "_ghost_new");
+  if (p4est->inspect != NULL) {
+    p4est->inspect->ghost_new_time += sc_MPI_Wtime () - tstart;
+  }
+  return gl;
+}
+
+p4est_ghost_t      *
+p4est_ghost_new_select (p4est_t * p4est, p4est_connect_type_t btype,
+                        p4est_ghost_connect_fn_t connect_fn)
+{
+  double              tstart = 0.;
+  p4est_ghost_t      *gl;
+
+  if (p4est->inspect != NULL) {
+    tstart = sc_MPI_Wtime ();
+  }
+  gl = p4est_ghost_new_check (p4est, btype, P4EST_GHOST_UNBALANCED_ALLOW,
+                              P4EST_GHOST_BUILD_FULL, NULL, connect_fn);
+  if (p4est->inspect != NULL) {
+    p4est->inspect->ghost_new_time += sc_MPI_Wtime () - tstart;
+  }
+  return gl;
+}
+
+p4est_ghost_t      *
+p4est_ghost_new_build (p4est_t * p4est, p4est_connect_type_t btype,
+                       int build)
+{
+  P4EST_ASSERT (build & P4EST_GHOST_BUILD_FULL);
+  P4EST_ASSERT (!(build & ~P4EST_GHOST_BUILD_FULL));
+
+  return p4est_ghost_new_check (p4est, btype, P4EST_GHOST_UNBALANCED_ALLOW,
+                                build, NULL, NULL);
+}
+
+p4est_ghost_new_t  *
+p4est_ghost_new_begin (p4est_t * p4est, p4est_connect_type_t btype)
+{
+  p4est_ghost_new_t  *gnc;
+
+  gnc = P4EST_ALLOC_ZERO (p4est_ghost_new_t, 1);
+  gnc->p4est = p4est;
+  gnc->ghost = p4est_ghost_new_check (p4est, btype,
+                                      P4EST_GHOST_UNBALANCED_ALLOW,
+                                      P4EST_GHOST_BUILD_FULL, gnc, NULL);
+  P4EST_ASSERT (gnc->ghost != NULL);
+
+  return gnc;
+}
+
+p4est_ghost_t      *
+p4est_ghost_new_end (p4est_ghost_new_t * gnc)
+{
+  p4est_ghost_t      *gl = gnc->ghost;
+
+  if (gnc->finished) {
+    /* the layer was complete at begin time; nothing is in flight */
+    P4EST_FREE (gnc);
+    return gl;
+  }
+
+#ifdef P4EST_ENABLE_MPI
+  p4est_ghost_new_wait (gnc->p4est, gl, gnc->num_peers, gnc->recv_request,
+                        gnc->send_request, gnc->recv_counts,
+                        &gnc->send_bufs, gnc->procs);
+#endif
+  gl = p4est_ghost_new_finish (gnc->p4est, gl, P4EST_GHOST_BUILD_FULL);
+  P4EST_FREE (gnc);
+
+  return gl;
+}
+
+void
+p4est_ghost_new_hierarchy (int nlevels, p4est_t * forests[],
+                           p4est_connect_type_t btype,
+                           p4est_ghost_t * ghosts[])
+{
+  int                 lv;
+  p4est_ghost_new_t **gncs;
+
+  P4EST_ASSERT (nlevels >= 1);
+  P4EST_ASSERT (forests != NULL && ghosts != NULL);
+
+  /* Start every level before finishing any: each level's boundary scan
+   * and message posting overlaps the ghost loads of the levels started
+   * before it, so all levels' payload traffic is in flight together. */
+  gncs = P4EST_ALLOC (p4est_ghost_new_t *, nlevels);
+  for (lv = 0; lv < nlevels; ++lv) {
+    P4EST_ASSERT (forests[lv] != NULL);
+    P4EST_ASSERT (forests[lv]->mpisize == forests[0]->mpisize &&
+                  forests[lv]->mpirank == forests[0]->mpirank);
+    gncs[lv] = p4est_ghost_new_begin (forests[lv], btype);
+  }
+
+  /* Complete the levels in the order they were begun.  The wait for a
+   * coarser level runs while the finer levels' messages still drain. */
+  for (lv = 0; lv < nlevels; ++lv) {
+    ghosts[lv] = p4est_ghost_new_end (gncs[lv]);
+  }
+  P4EST_FREE (gncs);
+}
+
+void
+/** Group the per-process mirror and ghost lists additionally by level.
+ * Both lists keep their relative order inside each level, so the wire
+ * order of a level band is identical on the sending and the receiving
+ * side.  The cache is built on the first level-banded exchange and
+ * dropped when the mirrors change in \ref p4est_ghost_expand.
+ */
+static void
+p4est_ghost_level_cache_build (p4est_ghost_t * ghost)
+{
+  const int           num_procs = ghost->mpisize;
+  const int           stride = P4EST_QMAXLEVEL + 2;
+  int                 q, l;
+  p4est_locidx_t      counts[P4EST_QMAXLEVEL + 1];
+  p4est_locidx_t      cursor[P4EST_QMAXLEVEL + 1];
+  p4est_locidx_t      lg, mirr, *loff;
+  p4est_quadrant_t   *m;
+
+  P4EST_ASSERT (ghost->mirror_proc_by_level == NULL);
+  P4EST_ASSERT (ghost->mirror_proc_level_offsets == NULL);
+  P4EST_ASSERT (ghost->ghost_proc_by_level == NULL);
+  P4EST_ASSERT (ghost->ghost_proc_level_offsets == NULL);
+
+  ghost->mirror_proc_by_level =
+    P4EST_ALLOC (p4est_locidx_t, ghost->mirror_proc_offsets[num_procs]);
+  ghost->mirror_proc_level_offsets =
+    P4EST_ALLOC (p4est_locidx_t, num_procs * stride);
+  ghost->ghost_proc_by_level =
+    P4EST_ALLOC (p4est_locidx_t, ghost->proc_offsets[num_procs]);
+  ghost->ghost_proc_level_offsets =
+    P4EST_ALLOC (p4est_locidx_t, num_procs * stride);
+
+  for (q = 0; q < num_procs; ++q) {
+    /* counting sort of this rank's mirror entries by level */
+    loff = ghost->mirror_proc_level_offsets + q * stride;
+    memset (counts, 0, sizeof (counts));
+    for (lg = ghost->mirror_proc_offsets[q];
+         lg < ghost->mirror_proc_offsets[q + 1]; ++lg) {
+      mirr = ghost->mirror_proc_mirrors[lg];
+      m = p4est_quadrant_array_index (&ghost->mirrors, (size_t) mirr);
+      ++counts[m->level];
+    }
+    loff[0] = ghost->mirror_proc_offsets[q];
+    for (l = 0; l <= P4EST_QMAXLEVEL; ++l) {
+      cursor[l] = loff[l];
+      loff[l + 1] = loff[l] + counts[l];
+    }
+    for (lg = ghost->mirror_proc_offsets[q];
+         lg < ghost->mirror_proc_offsets[q + 1]; ++lg) {
+      mirr = ghost->mirror_proc_mirrors[lg];
+      m = p4est_quadrant_array_index (&ghost->mirrors, (size_t) mirr);
+      ghost->mirror_proc_by_level[cursor[m->level]++] = mirr;
+    }
+
+    /* the same for this rank's ghosts, listing the ghost indices */
+    loff = ghost->ghost_proc_level_offsets + q * stride;
+    memset (counts, 0, sizeof (counts));
+    for (lg = ghost->proc_offsets[q]; lg < ghost->proc_offsets[q + 1]; ++lg) {
+      m = p4est_quadrant_array_index (&ghost->ghosts, (size_t) lg);
+      ++counts[m->level];
+    }
+    loff[0] = ghost->proc_offsets[q];
+    for (l = 0; l <= P4EST_QMAXLEVEL; ++l) {
+      cursor[l] = loff[l];
+      loff[l + 1] = loff[l] + counts[l];
+    }
+    for (lg = ghost->proc_offsets[q]; lg < ghost->proc_offsets[q + 1]; ++lg) {
+      m = p4est_quadrant_array_index (&ghost->ghosts, (size_t) lg);
+      ghost->ghost_proc_by_level[cursor[m->level]++] = lg;
+    }
+  }
+}
+
+/** Drop the level-banded exchange cache, e.g. when the mirrors change. */
+static void
+p4est_ghost_level_cache_reset (p4est_ghost_t * ghost)
+{
+  P4EST_FREE (ghost->mirror_proc_by_level);
+  P4EST_FREE (ghost->mirror_proc_level_offsets);
+  P4EST_FREE (ghost->ghost_proc_by_level);
+  P4EST_FREE (ghost->ghost_proc_level_offsets);
+  ghost->mirror_proc_by_level = NULL;
+  ghost->mirror_proc_level_offsets = NULL;
+  ghost->ghost_proc_by_level = NULL;
+  ghost->ghost_proc_level_offsets = NULL;
+}
+
+void
+p4est_ghost_destroy (p4est_ghost_t * ghost)
+{
+  sc_array_reset (&ghost->ghosts);
+  P4EST_FREE (ghost->tree_offsets);
+  P4EST_FREE (ghost->proc_offsets);
+
+  p4est_ghost_level_cache_reset (ghost);
+
+  if (ghost->mirror_proc_fronts != ghost->mirror_proc_mirrors) {
+    P4EST_ASSERT (ghost->mirror_proc_front_offsets !=
+                  ghost->mirror_proc_offsets);
+    P4EST_FREE (ghost->mirror_proc_fronts);
+    P4EST_FREE (ghost->mirror_proc_front_offsets);
+  }
+
+  sc_array_reset (&ghost->mirrors);
+  P4EST_FREE (ghost->mirror_tree_offsets);
+  P4EST_FREE (ghost->mirror_proc_mirrors);
+  P4EST_FREE (ghost->mirror_proc_offsets);
+
+  P4EST_FREE (ghost);
+}
+
+p4est_ghost_t      *
+p4est_ghost_update (p4est_t * p4est, p4est_ghost_t * ghost)
+{
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 q;
+  int                 lchanged, gchanged;
+  size_t              zz;
+  ssize_t             sz;
+  p4est_topidx_t      which_tree;
+  p4est_locidx_t      ng_excl, ng_incl, ng;
+  p4est_locidx_t      nm_excl, nm_incl, nm;
+  p4est_locidx_t      il;
+  p4est_locidx_t     *new_num, *recv_num, *send_num;
+  p4est_connect_type_t btype;
+  p4est_quadrant_t   *mirror, *g;
+  p4est_tree_t       *tree;
+  sc_array_t          requests;
+  sc_MPI_Request     *r;
+
+  P4EST_ASSERT (p4est != NULL && ghost != NULL);
+  P4EST_ASSERT (ghost->mpisize == num_procs);
+
+  /* recompute the cumulative local number of every mirror quadrant;
+   * a mirror that is no longer a local leaf means that the parallel
+   * boundary of this processor has changed and we must rebuild */
+  lchanged = 0;
+  new_num = P4EST_ALLOC (p4est_locidx_t, ghost->mirrors.elem_count);
+  for (zz = 0; zz < ghost->mirrors.elem_count; ++zz) {
+    mirror = p4est_quadrant_array_index (&ghost->mirrors, zz);
+    which_tree = mirror->p.piggy3.which_tree;
+    if (which_tree < p4est->first_local_tree ||
+        which_tree > p4est->last_local_tree) {
+      lchanged = 1;
+      break;
+    }
+    tree = p4est_tree_array_index (p4est->trees, which_tree);
+    sz = sc_array_bsearch (&tree->quadrants, mirror,
+                           p4est_quadrant_compare);
+    if (sz < 0) {
+      lchanged = 1;
+      break;
+    }
+    new_num[zz] = tree->quadrants_offset + (p4est_locidx_t) sz;
+  }
+
+  /* refinement and coarsening can only create or remove mirrors out of
+   * existing mirrors, so if no processor lost a mirror leaf the ghost
+   * and mirror sets are unchanged globally */
+  mpiret = sc_MPI_Allreduce (&lchanged, &gchanged, 1, sc_MPI_INT,
+                             sc_MPI_MAX, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  if (gchanged) {
+    P4EST_FREE (new_num);
+    btype = ghost->btype;
+    p4est_ghost_destroy (ghost);
+    return p4est_ghost_new (p4est, btype);
+  }
+
+  /* the quadrant sets match; only the cumulative local numbers may have
+   * shifted due to interior adaptation, so we refresh the piggy data of
+   * the mirrors locally and of the ghosts by point-to-point exchange */
+  for (zz = 0; zz < ghost->mirrors.elem_count; ++zz) {
+    mirror = p4est_quadrant_array_index (&ghost->mirrors, zz);
+    mirror->p.piggy3.local_num = new_num[zz];
+  }
+
+  sc_array_init (&requests, sizeof (sc_MPI_Request));
+  recv_num = P4EST_ALLOC (p4est_locidx_t, ghost->ghosts.elem_count);
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      r = (sc_MPI_Request *) sc_array_push (&requests);
+      mpiret = sc_MPI_Irecv (recv_num + ng_excl,
+                             ng * (int) sizeof (p4est_locidx_t),
+                             sc_MPI_BYTE, q, P4EST_COMM_GHOST_UPDATE,
+                             p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+
+  /* gather the new mirror numbers in mirror_proc_mirrors order */
+  send_num =
+    P4EST_ALLOC (p4est_locidx_t, ghost->mirror_proc_offsets[num_procs]);
+  for (il = 0; il < ghost->mirror_proc_offsets[num_procs]; ++il) {
+    send_num[il] = new_num[ghost->mirror_proc_mirrors[il]];
+  }
+  nm_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    nm_incl = ghost->mirror_proc_offsets[q + 1];
+    nm = nm_incl - nm_excl;
+    P4EST_ASSERT (nm >= 0);
+    if (nm > 0) {
+      r = (sc_MPI_Request *) sc_array_push (&requests);
+      mpiret = sc_MPI_Isend (send_num + nm_excl,
+                             nm * (int) sizeof (p4est_locidx_t),
+                             sc_MPI_BYTE, q, P4EST_COMM_GHOST_UPDATE,
+                             p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+      nm_excl = nm_incl;
+    }
+  }
+  mpiret = sc_MPI_Waitall ((int) requests.elem_count,
+                           (sc_MPI_Request *) requests.array,
+                           sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (&requests);
+  P4EST_FREE (send_num);
+  P4EST_FREE (new_num);
+
+  for (zz = 0; zz < ghost->ghosts.elem_count; ++zz) {
+    g = p4est_quadrant_array_index (&ghost->ghosts, zz);
+    g->p.piggy3.local_num = recv_num[zz];
+  }
+  P4EST_FREE (recv_num);
+
+  P4EST_ASSERT (p4est_ghost_is_valid (p4est, ghost));
+
+  return ghost;
+}
+
+unsigned
+p4est_ghost_checksum (p4est_t * p4est, p4est_ghost_t * ghost)
+{
+  size_t              zz, csize, qcount;
+  size_t              nt1, np1, local_count;
+  sc_array_t         *quadrants;
+  p4est_quadrant_t   *q;
+
+  quadrants = &ghost->ghosts;
+  qcount = quadrants->elem_count;
+  nt1 = (size_t) p4est->connectivity->num_trees + 1;
+  np1 = (size_t) p4est->mpisize + 1;
+
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+
+  csize = sizeof (uint32_t);
+  local_count = qcount * (P4EST_DIM + 3) + nt1 + np1;
+
+#ifdef P4EST_HAVE_ZLIB
+  {
+    /* stream the encoded words through adler32 in cache-sized batches
+     * instead of staging O(ghosts) scratch per call; the per-process
+     * results are combined over the reduction tree below, so the whole
+     * checksum is cheap enough for per-step validation */
+    const size_t        ncap = 256 * (P4EST_DIM + 3);
+    uint32_t            cbuf[256 * (P4EST_DIM + 3)];
+    uint32_t           *check;
+    size_t              nw;
+    uLong               adler;
+
+    adler = adler32 (0, Z_NULL, 0);
+    nw = 0;
+
+    /* checksum ghost quadrants */
+    for (zz = 0; zz < qcount; ++zz) {
+      q = p4est_quadrant_array_index (quadrants, zz);
+      P4EST_ASSERT (p4est_quadrant_is_valid (q));
+      check = cbuf + nw;
+      check[0] = htonl ((uint32_t) q->x);
+      check[1] = htonl ((uint32_t) q->y);
+#ifdef P4_TO_P8
+      check[2] = htonl ((uint32_t) q->z);
+#endif
+      check[P4EST_DIM] = htonl ((uint32_t) q->level);
+      check[P4EST_DIM + 1] = htonl ((uint32_t) q->p.piggy3.which_tree);
+      check[P4EST_DIM + 2] = htonl ((uint32_t) q->p.piggy3.local_num);
+      if ((nw += P4EST_DIM + 3) == ncap) {
+        adler = adler32 (adler, (const Bytef *) cbuf, (uInt) (nw * csize));
+        nw = 0;
+      }
+    }
+
+    /* checksum tree_offsets */
+    for (zz = 0; zz < nt1; ++zz) {
+      cbuf[nw] = htonl ((uint32_t) ghost->tree_offsets[zz]);
+      if (++nw == ncap) {
+        adler = adler32 (adler, (const Bytef *) cbuf, (uInt) (nw * csize));
+        nw = 0;
+      }
+    }
+
+    /* checksum proc_offsets */
+    for (zz = 0; zz < np1; ++zz) {
+      cbuf[nw] = htonl ((uint32_t) ghost->proc_offsets[zz]);
+      if (++nw == ncap) {
+        adler = adler32 (adler, (const Bytef *) cbuf, (uInt) (nw * csize));
+        nw = 0;
+      }
+    }
+    if (nw > 0) {
+      adler = adler32 (adler, (const Bytef *) cbuf, (uInt) (nw * csize));
+    }
+
+    /* compute parallel checksum */
+    return p4est_comm_checksum (p4est, (unsigned) adler,
+                                csize * local_count);
+  }
+#else
+  {
+    unsigned            crc;
+    uint32_t           *check;
+    size_t              offset;
+    sc_array_t         *checkarray;
+
+    checkarray = sc_array_new (csize);
+    sc_array_resize (checkarray, local_count);
+
+    /* checksum ghost quadrants */
+    for (zz = 0; zz < qcount; ++zz) {
+      q = p4est_quadrant_array_index (quadrants, zz);
+      P4EST_ASSERT (p4est_quadrant_is_valid (q));
+      check = (uint32_t *) sc_array_index (checkarray, zz * (P4EST_DIM + 3));
+      check[0] = htonl ((uint32_t) q->x);
+      check[1] = htonl ((uint32_t) q->y);
+#ifdef P4_TO_P8
+      check[2] = htonl ((uint32_t) q->z);
+#endif
+      check[P4EST_DIM] = htonl ((uint32_t) q->level);
+      check[P4EST_DIM + 1] = htonl ((uint32_t) q->p.piggy3.which_tree);
+      check[P4EST_DIM + 2] = htonl ((uint32_t) q->p.piggy3.local_num);
+    }
+
+    /* checksum tree_offsets */
+    offset = qcount * (P4EST_DIM + 3);
+    for (zz = 0; zz < nt1; ++zz) {
+      check = (uint32_t *) sc_array_index (checkarray, offset + zz);
+      *check = htonl ((uint32_t) ghost->tree_offsets[zz]);
+    }
+
+    /* checksum proc_offsets */
+    offset += nt1;
+    for (zz = 0; zz < np1; ++zz) {
+      check = (uint32_t *) sc_array_index (checkarray, offset + zz);
+      *check = htonl ((uint32_t) ghost->proc_offsets[zz]);
+    }
+    P4EST_ASSERT (offset + zz == local_count);
+
+    /* compute parallel checksum */
+    crc = sc_array_checksum (checkarray);
+    sc_array_destroy (checkarray);
+
+    return p4est_comm_checksum (p4est, crc, csize * local_count);
+  }
+#endif /* !P4EST_HAVE_ZLIB */
+}
+
+void
+p4est_ghost_advise_hugepages (p4est_ghost_t * ghost)
+{
+  p4est_quadrant_array_advise_huge (&ghost->ghosts);
+  p4est_quadrant_array_advise_huge (&ghost->mirrors);
+}
+
+void
 p4est_ghost_exchange_data (p4est_t * p4est, p4est_ghost_t * ghost,
                            void *ghost_data)
 {
-  p4est_ghost_exchange_data_end (p4est_ghost_exchange_data_begin
-                                 (p4est, ghost, ghost_data));
+  p4est_ghost_exchange_data_end (p4est_ghost_exchange_data_begin
+                                 (p4est, ghost, ghost_data));
+}
+
+p4est_ghost_exchange_t *
+p4est_ghost_exchange_data_begin (p4est_t * p4est, p4est_ghost_t * ghost,
+                                 void *ghost_data)
+{
+  size_t              zz;
+  size_t              data_size;
+#ifdef P4EST_ENABLE_DEBUG
+  p4est_topidx_t      prev_tree;
+#endif
+  p4est_topidx_t      which_tree;
+  p4est_locidx_t      which_quad;
+  p4est_quadrant_t   *mirror, *q;
+  p4est_tree_t       *tree;
+  p4est_ghost_exchange_t *exc;
+  void              **mirror_data;
+
+  /* allocate temporary storage */
+  mirror_data = P4EST_ALLOC (void *, ghost->mirrors.elem_count);
+
+  data_size = p4est->data_size == 0 ? sizeof (void *) : p4est->data_size;
+#ifdef P4EST_ENABLE_DEBUG
+  prev_tree = -1;
+#endif
+  for (zz = 0; zz < ghost->mirrors.elem_count; ++zz) {
+    mirror = p4est_quadrant_array_index (&ghost->mirrors, zz);
+    which_tree = mirror->p.piggy3.which_tree;
+    P4EST_ASSERT (p4est->first_local_tree <= which_tree &&
+                  which_tree <= p4est->last_local_tree);
+    P4EST_ASSERT (prev_tree <= which_tree);
+#ifdef P4EST_ENABLE_DEBUG
+    prev_tree = which_tree;
+#endif
+    tree = p4est_tree_array_index (p4est->trees, which_tree);
+    which_quad = mirror->p.piggy3.local_num - tree->quadrants_offset;
+    P4EST_ASSERT (0 <= which_quad &&
+                  which_quad < (p4est_locidx_t) tree->quadrants.elem_count);
+    q = p4est_quadrant_array_index (&tree->quadrants, which_quad);
+    mirror_data[zz] =
+      p4est->data_size == 0 ? &q->p.user_data : q->p.user_data;
+  }
+
+  /* delegate the rest of the work */
+  exc = p4est_ghost_exchange_custom_begin (p4est, ghost, data_size,
+                                           mirror_data, ghost_data);
+  P4EST_ASSERT (exc->is_custom);
+  P4EST_ASSERT (!exc->is_levels);
+  exc->is_custom = 0;
+
+  /* the mirror_data is copied before sending so it can be freed */
+  P4EST_FREE (mirror_data);
+
+  /* return message buffers */
+  return exc;
+}
+
+void
+p4est_ghost_exchange_data_end (p4est_ghost_exchange_t * exc)
+{
+  /* don't confuse this function with p4est_ghost_exchange_custom_end */
+  P4EST_ASSERT (!exc->is_custom);
+  P4EST_ASSERT (!exc->is_levels);
+
+  /* delegate the rest of the work, including freeing the context */
+  exc->is_custom = 1;
+  p4est_ghost_exchange_custom_end (exc);
+}
+
+void
+p4est_ghost_exchange_custom (p4est_t * p4est, p4est_ghost_t * ghost,
+                             size_t data_size,
+                             void **mirror_data, void *ghost_data)
+{
+  p4est_ghost_exchange_custom_end (p4est_ghost_exchange_custom_begin
+                                   (p4est, ghost, data_size,
+                                    mirror_data, ghost_data));
+}
+
+p4est_ghost_exchange_t *
+p4est_ghost_exchange_custom_begin (p4est_t * p4est, p4est_ghost_t * ghost,
+                                   size_t data_size,
+                                   void **mirror_data, void *ghost_data)
+{
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 q;
+  char               *mem, **sbuf;
+  p4est_locidx_t      ng_excl, ng_incl, ng, theg;
+  p4est_locidx_t      mirr;
+  p4est_ghost_exchange_t *exc;
+  sc_MPI_Request     *r;
+
+  /* initialize transient storage */
+  exc = P4EST_ALLOC_ZERO (p4est_ghost_exchange_t, 1);
+  exc->is_custom = 1;
+  exc->p4est = p4est;
+  exc->ghost = ghost;
+  exc->minlevel = 0;
+  exc->maxlevel = P4EST_QMAXLEVEL;
+  exc->data_size = data_size;
+  exc->ghost_data = ghost_data;
+  sc_array_init (&exc->requests, sizeof (sc_MPI_Request));
+  sc_array_init (&exc->sbuffers, sizeof (char *));
+
+  /* return early if there is nothing to do */
+  if (data_size == 0) {
+    return exc;
+  }
+
+  /* receive data from other processors */
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      r = (sc_MPI_Request *) sc_array_push (&exc->requests);
+      mpiret = sc_MPI_Irecv ((char *) ghost_data + ng_excl * data_size,
+                             ng * data_size, sc_MPI_BYTE, q,
+                             P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+  P4EST_ASSERT (ng_excl == (p4est_locidx_t) ghost->ghosts.elem_count);
+
+  /* send data to other processors */
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->mirror_proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      /* every peer populates its own send buffer */
+      sbuf = (char **) sc_array_push (&exc->sbuffers);
+      mem = *sbuf = P4EST_ALLOC (char, ng * data_size);
+      for (theg = 0; theg < ng; ++theg) {
+        mirr = ghost->mirror_proc_mirrors[ng_excl + theg];
+        P4EST_ASSERT (0 <= mirr && (size_t) mirr < ghost->mirrors.elem_count);
+        memcpy (mem, mirror_data[mirr], data_size);
+        mem += data_size;
+      }
+      r = (sc_MPI_Request *) sc_array_push (&exc->requests);
+      mpiret = sc_MPI_Isend (*sbuf, ng * data_size, sc_MPI_BYTE, q,
+                             P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+
+  /* we are done posting the messages */
+  return exc;
+}
+
+void
+p4est_ghost_exchange_custom_end (p4est_ghost_exchange_t * exc)
+{
+  int                 mpiret;
+  size_t              zz;
+  char              **sbuf;
+
+  /* don't confuse this function with p4est_ghost_exchange_data_end */
+  P4EST_ASSERT (exc->is_custom);
+
+  /* don't confuse it with p4est_ghost_exchange_custom_levels_end either */
+  P4EST_ASSERT (!exc->is_levels);
+
+  /* wait for messages to complete and clean up */
+  mpiret = sc_MPI_Waitall (exc->requests.elem_count, (sc_MPI_Request *)
+                           exc->requests.array, sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (&exc->requests);
+  for (zz = 0; zz < exc->sbuffers.elem_count; ++zz) {
+    sbuf = (char **) sc_array_index (&exc->sbuffers, zz);
+    P4EST_FREE (*sbuf);
+  }
+  sc_array_reset (&exc->sbuffers);
+
+  /* free the store */
+  P4EST_FREE (exc);
+}
+
+void
+p4est_ghost_exchange_custom_scatter (p4est_t * p4est, p4est_ghost_t * ghost,
+                                     size_t data_size, void **mirror_data,
+                                     p4est_ghost_unpack_t unpack_fn,
+                                     void *user)
+{
+  p4est_ghost_exchange_custom_scatter_end
+    (p4est_ghost_exchange_custom_scatter_begin (p4est, ghost, data_size,
+                                                mirror_data, unpack_fn,
+                                                user));
+}
+
+p4est_ghost_exchange_t *
+p4est_ghost_exchange_custom_scatter_begin (p4est_t * p4est,
+                                           p4est_ghost_t * ghost,
+                                           size_t data_size,
+                                           void **mirror_data,
+                                           p4est_ghost_unpack_t unpack_fn,
+                                           void *user)
+{
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 q;
+  char               *mem, **sbuf, **rbuf;
+  p4est_locidx_t      ng_excl, ng_incl, ng, theg;
+  p4est_locidx_t      mirr;
+  p4est_ghost_exchange_t *exc;
+  sc_MPI_Request     *r;
+
+  P4EST_ASSERT (unpack_fn != NULL);
+
+  /* initialize transient storage */
+  exc = P4EST_ALLOC_ZERO (p4est_ghost_exchange_t, 1);
+  exc->is_custom = 1;
+  exc->p4est = p4est;
+  exc->ghost = ghost;
+  exc->minlevel = 0;
+  exc->maxlevel = P4EST_QMAXLEVEL;
+  exc->data_size = data_size;
+  exc->unpack_fn = unpack_fn;
+  exc->unpack_user = user;
+  sc_array_init (&exc->requests, sizeof (sc_MPI_Request));
+  sc_array_init (&exc->sbuffers, sizeof (char *));
+  sc_array_init (&exc->rbuffers, sizeof (char *));
+
+  /* return early if there is nothing to do */
+  if (data_size == 0) {
+    return exc;
+  }
+
+  /* receive data from other processors into per-peer staging buffers */
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      rbuf = (char **) sc_array_push (&exc->rbuffers);
+      *rbuf = P4EST_ALLOC (char, ng * data_size);
+      r = (sc_MPI_Request *) sc_array_push (&exc->requests);
+      mpiret = sc_MPI_Irecv (*rbuf, ng * data_size, sc_MPI_BYTE, q,
+                             P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+  P4EST_ASSERT (ng_excl == (p4est_locidx_t) ghost->ghosts.elem_count);
+
+  /* send data to other processors */
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->mirror_proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      /* every peer populates its own send buffer */
+      sbuf = (char **) sc_array_push (&exc->sbuffers);
+      mem = *sbuf = P4EST_ALLOC (char, ng * data_size);
+      for (theg = 0; theg < ng; ++theg) {
+        mirr = ghost->mirror_proc_mirrors[ng_excl + theg];
+        P4EST_ASSERT (0 <= mirr && (size_t) mirr < ghost->mirrors.elem_count);
+        memcpy (mem, mirror_data[mirr], data_size);
+        mem += data_size;
+      }
+      r = (sc_MPI_Request *) sc_array_push (&exc->requests);
+      mpiret = sc_MPI_Isend (*sbuf, ng * data_size, sc_MPI_BYTE, q,
+                             P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+
+  /* we are done posting the messages */
+  return exc;
+}
+
+void
+p4est_ghost_exchange_custom_scatter_end (p4est_ghost_exchange_t * exc)
+{
+  const int           num_procs = exc->p4est->mpisize;
+  int                 mpiret;
+  int                 q;
+  size_t              zz;
+  char              **sbuf, **rbuf;
+  p4est_locidx_t      ng_excl, ng_incl, ng;
+  p4est_ghost_t      *ghost = exc->ghost;
+
+  /* don't confuse this function with p4est_ghost_exchange_custom_end */
+  P4EST_ASSERT (exc->is_custom);
+  P4EST_ASSERT (!exc->is_levels);
+  P4EST_ASSERT (exc->unpack_fn != NULL);
+
+  /* wait for messages to complete */
+  mpiret = sc_MPI_Waitall (exc->requests.elem_count, (sc_MPI_Request *)
+                           exc->requests.array, sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (&exc->requests);
+
+  /* hand each peer's contiguous ghost range to the application */
+  if (exc->data_size > 0) {
+    zz = 0;
+    ng_excl = 0;
+    for (q = 0; q < num_procs; ++q) {
+      ng_incl = ghost->proc_offsets[q + 1];
+      ng = ng_incl - ng_excl;
+      P4EST_ASSERT (ng >= 0);
+      if (ng > 0) {
+        rbuf = (char **) sc_array_index (&exc->rbuffers, zz++);
+        exc->unpack_fn (exc->p4est, ghost, q, ng_excl, ng,
+                        *rbuf, exc->unpack_user);
+        P4EST_FREE (*rbuf);
+        ng_excl = ng_incl;
+      }
+    }
+    P4EST_ASSERT (zz == exc->rbuffers.elem_count);
+  }
+  sc_array_reset (&exc->rbuffers);
+
+  /* clean up the send buffers */
+  for (zz = 0; zz < exc->sbuffers.elem_count; ++zz) {
+    sbuf = (char **) sc_array_index (&exc->sbuffers, zz);
+    P4EST_FREE (*sbuf);
+  }
+  sc_array_reset (&exc->sbuffers);
+
+  /* free the store */
+  P4EST_FREE (exc);
+}
+
+void
+p4est_ghost_exchange_active (p4est_t * p4est, p4est_ghost_t * ghost,
+                             size_t data_size,
+                             const int8_t * mirror_active,
+                             void **mirror_data, void *ghost_data,
+                             int8_t * ghost_active)
+{
+  const size_t        hdr = sizeof (p4est_locidx_t);
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 q;
+  char              **sbuf, **rbuf, *mem;
+  size_t              zz;
+  sc_array_t          requests, sbuffers, rbuffers;
+  p4est_locidx_t      ng_excl, ng_incl, ng, theg;
+  p4est_locidx_t      na, k, mirr;
+  p4est_locidx_t     *pos;
+  sc_MPI_Request     *r;
+
+  P4EST_ASSERT (mirror_active != NULL);
+  P4EST_ASSERT (ghost_active != NULL);
+
+  sc_array_init (&requests, sizeof (sc_MPI_Request));
+  sc_array_init (&sbuffers, sizeof (char *));
+  sc_array_init (&rbuffers, sizeof (char *));
+
+  /* Each message carries the active count, the active positions within
+   * the receiver's ghost range for this peer, and the packed payloads.
+   * The receives are sized for the worst case of all mirrors active;
+   * the matching send may be shorter, which MPI permits. */
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      rbuf = (char **) sc_array_push (&rbuffers);
+      *rbuf = P4EST_ALLOC (char, hdr + (size_t) ng * (hdr + data_size));
+      r = (sc_MPI_Request *) sc_array_push (&requests);
+      mpiret = sc_MPI_Irecv (*rbuf, (int)
+                             (hdr + (size_t) ng * (hdr + data_size)),
+                             sc_MPI_BYTE, q, P4EST_COMM_GHOST_EXCHANGE,
+                             p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+
+  /* pack and send only the active mirrors of every peer */
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->mirror_proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      na = 0;
+      for (theg = 0; theg < ng; ++theg) {
+        mirr = ghost->mirror_proc_mirrors[ng_excl + theg];
+        P4EST_ASSERT (0 <= mirr && (size_t) mirr < ghost->mirrors.elem_count);
+        na += (p4est_locidx_t) (mirror_active[mirr] != 0);
+      }
+      sbuf = (char **) sc_array_push (&sbuffers);
+      *sbuf = P4EST_ALLOC (char, hdr + (size_t) na * (hdr + data_size));
+      pos = (p4est_locidx_t *) * sbuf;
+      *pos++ = na;
+      mem = *sbuf + hdr + (size_t) na * hdr;
+      for (theg = 0; theg < ng; ++theg) {
+        mirr = ghost->mirror_proc_mirrors[ng_excl + theg];
+        if (mirror_active[mirr]) {
+          *pos++ = theg;
+          memcpy (mem, mirror_data[mirr], data_size);
+          mem += data_size;
+        }
+      }
+      r = (sc_MPI_Request *) sc_array_push (&requests);
+      mpiret = sc_MPI_Isend (*sbuf, (int)
+                             (hdr + (size_t) na * (hdr + data_size)),
+                             sc_MPI_BYTE, q, P4EST_COMM_GHOST_EXCHANGE,
+                             p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+
+  /* wait for messages to complete */
+  mpiret = sc_MPI_Waitall (requests.elem_count, (sc_MPI_Request *)
+                           requests.array, sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (&requests);
+
+  /* unpack the active subset of every peer's ghost range */
+  memset (ghost_active, 0, ghost->ghosts.elem_count * sizeof (int8_t));
+  zz = 0;
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    if (ng > 0) {
+      rbuf = (char **) sc_array_index (&rbuffers, zz++);
+      pos = (p4est_locidx_t *) * rbuf;
+      na = *pos++;
+      P4EST_ASSERT (0 <= na && na <= ng);
+      mem = *rbuf + hdr + (size_t) na * hdr;
+      for (k = 0; k < na; ++k) {
+        theg = pos[k];
+        P4EST_ASSERT (0 <= theg && theg < ng);
+        P4EST_ASSERT (k == 0 || pos[k - 1] < theg);
+        ghost_active[ng_excl + theg] = 1;
+        if (data_size > 0) {
+          memcpy ((char *) ghost_data +
+                  (size_t) (ng_excl + theg) * data_size,
+                  mem + (size_t) k * data_size, data_size);
+        }
+      }
+      P4EST_FREE (*rbuf);
+      ng_excl = ng_incl;
+    }
+  }
+  P4EST_ASSERT (zz == rbuffers.elem_count);
+  sc_array_reset (&rbuffers);
+
+  /* clean up the send buffers */
+  for (zz = 0; zz < sbuffers.elem_count; ++zz) {
+    sbuf = (char **) sc_array_index (&sbuffers, zz);
+    P4EST_FREE (*sbuf);
+  }
+  sc_array_reset (&sbuffers);
+}
+
+void
+p4est_ghost_exchange_custom_levels (p4est_t * p4est, p4est_ghost_t * ghost,
+                                    int minlevel, int maxlevel,
+                                    size_t data_size,
+                                    void **mirror_data, void *ghost_data)
+{
+  p4est_ghost_exchange_custom_levels_end
+    (p4est_ghost_exchange_custom_levels_begin (p4est, ghost,
+                                               minlevel, maxlevel, data_size,
+                                               mirror_data, ghost_data));
+}
+
+p4est_ghost_exchange_t *
+p4est_ghost_exchange_custom_levels_begin (p4est_t * p4est,
+                                          p4est_ghost_t * ghost,
+                                          int minlevel, int maxlevel,
+                                          size_t data_size,
+                                          void **mirror_data,
+                                          void *ghost_data)
+{
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 q;
+  int                 llo, lhi;
+  int                *theq, *qactive, *qbuffer;
+  char               *mem, **rbuf, **sbuf;
+  p4est_locidx_t      ng_excl, ng_incl, ng;
+  p4est_locidx_t      lmatches;
+  p4est_locidx_t      lz, mirr;
+  const p4est_locidx_t *loff;
+  p4est_ghost_exchange_t *exc;
+  sc_MPI_Request     *r;
+
+  if (minlevel <= 0 && maxlevel >= P4EST_QMAXLEVEL) {
+    /* this case can be processed by a more specialized function */
+    exc = p4est_ghost_exchange_custom_begin (p4est, ghost, data_size,
+                                             mirror_data, ghost_data);
+    P4EST_ASSERT (exc->is_custom);
+    P4EST_ASSERT (!exc->is_levels);
+    exc->is_levels = 1;
+
+    /* the completion function will have to switch for this case */
+    return exc;
+  }
+
+  /* initialize transient storage */
+  exc = P4EST_ALLOC_ZERO (p4est_ghost_exchange_t, 1);
+  exc->is_custom = 1;
+  exc->is_levels = 1;
+  exc->p4est = p4est;
+  exc->ghost = ghost;
+  exc->minlevel = minlevel;
+  exc->maxlevel = maxlevel;
+  exc->data_size = data_size;
+  exc->ghost_data = ghost_data;
+  sc_array_init (&exc->requests, sizeof (sc_MPI_Request));
+  sc_array_init (&exc->rrequests, sizeof (sc_MPI_Request));
+  sc_array_init (&exc->rbuffers, sizeof (char *));
+  sc_array_init (&exc->sbuffers, sizeof (char *));
+
+  /* return early if there is nothing to do */
+  if (data_size == 0 || minlevel > maxlevel) {
+    return exc;
+  }
+  qactive = exc->qactive = P4EST_ALLOC (int, num_procs);
+  qbuffer = exc->qbuffer = P4EST_ALLOC (int, num_procs);
+
+  /* the level cache counts and lists the band members per peer */
+  if (ghost->mirror_proc_by_level == NULL) {
+    p4est_ghost_level_cache_build (ghost);
+  }
+  llo = SC_MAX (minlevel, 0);
+  lhi = SC_MIN (maxlevel, P4EST_QMAXLEVEL);
+
+  /* receive data from other processors */
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    qactive[q] = -1;
+    qbuffer[q] = -1;
+    ng_incl = ghost->proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      P4EST_ASSERT (q != p4est->mpirank);
+      loff = ghost->ghost_proc_level_offsets + q * (P4EST_QMAXLEVEL + 2);
+      lmatches = (llo <= lhi) ? loff[lhi + 1] - loff[llo] : 0;
+      if (lmatches > 0) {
+        /* every peer populates its own receive buffer; even a full
+         * band cannot use the ghost data memory directly since the
+         * wire order groups the quadrants by level */
+        theq = qactive + exc->rrequests.elem_count;
+        r = (sc_MPI_Request *) sc_array_push (&exc->rrequests);
+        *theq = q;
+        qbuffer[q] = (int) exc->rbuffers.elem_count;
+        rbuf = (char **) sc_array_push (&exc->rbuffers);
+        *rbuf = P4EST_ALLOC (char, lmatches * data_size);
+        mpiret = sc_MPI_Irecv (*rbuf, lmatches * data_size, sc_MPI_BYTE, q,
+                               P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+        SC_CHECK_MPI (mpiret);
+      }
+      ng_excl = ng_incl;
+    }
+  }
+  P4EST_ASSERT (ng_excl == (p4est_locidx_t) ghost->ghosts.elem_count);
+
+  /* send data to other processors */
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->mirror_proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      P4EST_ASSERT (q != p4est->mpirank);
+      loff = ghost->mirror_proc_level_offsets + q * (P4EST_QMAXLEVEL + 2);
+      lmatches = (llo <= lhi) ? loff[lhi + 1] - loff[llo] : 0;
+      if (lmatches > 0) {
+        /* every peer populates its own send buffer */
+        sbuf = (char **) sc_array_push (&exc->sbuffers);
+        mem = *sbuf = P4EST_ALLOC (char, lmatches * data_size);
+        for (lz = loff[llo]; lz < loff[lhi + 1]; ++lz) {
+          mirr = ghost->mirror_proc_by_level[lz];
+          memcpy (mem, mirror_data[mirr], data_size);
+          mem += data_size;
+        }
+        r = (sc_MPI_Request *) sc_array_push (&exc->requests);
+        mpiret = sc_MPI_Isend (*sbuf, lmatches * data_size, sc_MPI_BYTE, q,
+                               P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+        SC_CHECK_MPI (mpiret);
+      }
+      ng_excl = ng_incl;
+    }
+  }
+
+  /* we are done posting messages */
+  return exc;
+}
+
+void
+p4est_ghost_exchange_custom_levels_end (p4est_ghost_exchange_t * exc)
+{
+  p4est_ghost_t      *ghost = exc->ghost;
+#ifdef P4EST_ENABLE_DEBUG
+  p4est_t            *p4est = exc->p4est;
+  const int           num_procs = p4est->mpisize;
+#endif
+  const int           minlevel = exc->minlevel;
+  const int           maxlevel = exc->maxlevel;
+  const size_t        data_size = exc->data_size;
+  int                 mpiret;
+  int                 i, expected, remaining, received, *peers;
+  int                 q;
+  int                 llo, lhi;
+  char              **rbuf, **sbuf;
+  size_t              zz;
+  p4est_locidx_t      lmatches;
+  p4est_locidx_t      lz;
+  const p4est_locidx_t *loff;
+
+  /* make sure that the begin function matches the end function */
+  P4EST_ASSERT (exc->is_custom);
+  P4EST_ASSERT (exc->is_levels);
+
+  /* check whether we have used the specialized function */
+  if (minlevel <= 0 && maxlevel >= P4EST_QMAXLEVEL) {
+    exc->is_levels = 0;
+    p4est_ghost_exchange_custom_end (exc);
+    return;
+  }
+
+  /* wait for receives and copy data into the proper result array */
+  peers = P4EST_ALLOC (int, exc->rrequests.elem_count);
+  expected = remaining = (int) exc->rrequests.elem_count;
+  while (remaining > 0) {
+    mpiret =
+      sc_MPI_Waitsome (expected, (sc_MPI_Request *) exc->rrequests.array,
+                       &received, peers, sc_MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+    P4EST_ASSERT (received != sc_MPI_UNDEFINED);
+    P4EST_ASSERT (received > 0);
+    for (i = 0; i < received; ++i) {
+      P4EST_ASSERT (0 <= peers[i] &&
+                    peers[i] < (int) exc->rrequests.elem_count);
+      q = exc->qactive[peers[i]];
+      if (q >= 0) {
+        P4EST_ASSERT (q != p4est->mpirank && q < num_procs);
+        P4EST_ASSERT (ghost->proc_offsets[q] < ghost->proc_offsets[q + 1]);
+        /* the level cache lists the matching ghosts in wire order */
+        llo = SC_MAX (minlevel, 0);
+        lhi = SC_MIN (maxlevel, P4EST_QMAXLEVEL);
+        P4EST_ASSERT (llo <= lhi);
+        rbuf = (char **) sc_array_index_int (&exc->rbuffers, exc->qbuffer[q]);
+        loff = ghost->ghost_proc_level_offsets + q * (P4EST_QMAXLEVEL + 2);
+        for (lmatches = 0, lz = loff[llo]; lz < loff[lhi + 1];
+             ++lz, ++lmatches) {
+          memcpy ((char *) exc->ghost_data +
+                  ghost->ghost_proc_by_level[lz] * data_size,
+                  *rbuf + lmatches * data_size, data_size);
+        }
+        P4EST_FREE (*rbuf);
+        exc->qactive[peers[i]] = -1;
+        exc->qbuffer[q] = -1;
+      }
+    }
+    remaining -= received;
+  }
+  P4EST_FREE (peers);
+  P4EST_FREE (exc->qactive);
+  P4EST_FREE (exc->qbuffer);
+  sc_array_reset (&exc->rrequests);
+  sc_array_reset (&exc->rbuffers);
+
+  /* wait for sends and clean up */
+  mpiret = sc_MPI_Waitall (exc->requests.elem_count, (sc_MPI_Request *)
+                           exc->requests.array, sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (&exc->requests);
+  for (zz = 0; zz < exc->sbuffers.elem_count; ++zz) {
+    sbuf = (char **) sc_array_index (&exc->sbuffers, zz);
+    P4EST_FREE (*sbuf);
+  }
+  sc_array_reset (&exc->sbuffers);
+
+  /* free temporary storage */
+  P4EST_FREE (exc);
+}
+
+void
+p4est_ghost_exchange_indexed (p4est_t * p4est, p4est_ghost_t * ghost,
+                              size_t data_size, const void *mirror_data,
+                              void *ghost_data)
+{
+#ifdef P4EST_ENABLE_MPI
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 q;
+  int                 i, nm;
+  int                *disps;
+  p4est_locidx_t      ng_excl, ng_incl, ng;
+  p4est_locidx_t      nm_excl, nm_incl;
+  sc_array_t          requests, types;
+  sc_MPI_Request     *r;
+  MPI_Datatype        elem_type, *t;
+
+  if (data_size == 0) {
+    return;
+  }
+
+  sc_array_init (&requests, sizeof (sc_MPI_Request));
+  sc_array_init (&types, sizeof (MPI_Datatype));
+
+  /* receive into the contiguous ghost data array as usual */
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      r = (sc_MPI_Request *) sc_array_push (&requests);
+      mpiret = sc_MPI_Irecv ((char *) ghost_data + ng_excl * data_size,
+                             ng * (int) data_size, sc_MPI_BYTE, q,
+                             P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+
+  /* send straight out of the caller's per-mirror array through an
+   * indexed datatype instead of packing a copy */
+  mpiret = MPI_Type_contiguous ((int) data_size, sc_MPI_BYTE, &elem_type);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Type_commit (&elem_type);
+  SC_CHECK_MPI (mpiret);
+  disps = P4EST_ALLOC (int, ghost->mirrors.elem_count);
+  nm_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    nm_incl = ghost->mirror_proc_offsets[q + 1];
+    nm = (int) (nm_incl - nm_excl);
+    P4EST_ASSERT (nm >= 0);
+    if (nm > 0) {
+      for (i = 0; i < nm; ++i) {
+        disps[i] = (int) ghost->mirror_proc_mirrors[nm_excl + i];
+      }
+      t = (MPI_Datatype *) sc_array_push (&types);
+      mpiret = MPI_Type_create_indexed_block (nm, 1, disps, elem_type, t);
+      SC_CHECK_MPI (mpiret);
+      mpiret = MPI_Type_commit (t);
+      SC_CHECK_MPI (mpiret);
+      r = (sc_MPI_Request *) sc_array_push (&requests);
+      mpiret = MPI_Isend ((void *) mirror_data, 1, *t, q,
+                          P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+      nm_excl = nm_incl;
+    }
+  }
+  P4EST_FREE (disps);
+
+  mpiret = sc_MPI_Waitall ((int) requests.elem_count,
+                           (sc_MPI_Request *) requests.array,
+                           sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (&requests);
+
+  for (i = 0; i < (int) types.elem_count; ++i) {
+    t = (MPI_Datatype *) sc_array_index_int (&types, i);
+    mpiret = MPI_Type_free (t);
+    SC_CHECK_MPI (mpiret);
+  }
+  sc_array_reset (&types);
+  mpiret = MPI_Type_free (&elem_type);
+  SC_CHECK_MPI (mpiret);
+#endif /* P4EST_ENABLE_MPI */
+}
+
+void
+p4est_ghost_exchange_reduce (p4est_t * p4est, p4est_ghost_t * ghost,
+                             size_t data_size, void **mirror_data,
+                             const void *ghost_data,
+                             p4est_ghost_combine_t combine_fn)
+{
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 q;
+  char               *mem, **rbuf;
+  p4est_locidx_t      ng_excl, ng_incl, ng, theg;
+  p4est_locidx_t      mirr;
+  size_t              zz;
+  sc_array_t          requests, rbuffers;
+  sc_MPI_Request     *r;
+
+  P4EST_ASSERT (combine_fn != NULL);
+
+  /* return early if there is nothing to do */
+  if (data_size == 0) {
+    return;
+  }
+
+  sc_array_init (&requests, sizeof (sc_MPI_Request));
+  sc_array_init (&rbuffers, sizeof (char *));
+
+  /* receive contributions to the mirrors, one buffer per peer */
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->mirror_proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      rbuf = (char **) sc_array_push (&rbuffers);
+      *rbuf = P4EST_ALLOC (char, ng * data_size);
+      r = (sc_MPI_Request *) sc_array_push (&requests);
+      mpiret = sc_MPI_Irecv (*rbuf, ng * data_size, sc_MPI_BYTE, q,
+                             P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+
+  /* return the local copy of every ghost quadrant to its owner */
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      r = (sc_MPI_Request *) sc_array_push (&requests);
+      mpiret = sc_MPI_Isend ((char *) ghost_data + ng_excl * data_size,
+                             ng * data_size, sc_MPI_BYTE, q,
+                             P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+  P4EST_ASSERT (ng_excl == (p4est_locidx_t) ghost->ghosts.elem_count);
+
+  mpiret = sc_MPI_Waitall (requests.elem_count, (sc_MPI_Request *)
+                           requests.array, sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (&requests);
+
+  /* fold the received contributions into the mirror payload */
+  zz = 0;
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->mirror_proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    if (ng > 0) {
+      rbuf = (char **) sc_array_index (&rbuffers, zz++);
+      mem = *rbuf;
+      for (theg = 0; theg < ng; ++theg) {
+        mirr = ghost->mirror_proc_mirrors[ng_excl + theg];
+        P4EST_ASSERT (0 <= mirr && (size_t) mirr < ghost->mirrors.elem_count);
+        combine_fn (mirror_data[mirr], mem, data_size);
+        mem += data_size;
+      }
+      P4EST_FREE (*rbuf);
+      ng_excl = ng_incl;
+    }
+  }
+  P4EST_ASSERT (zz == rbuffers.elem_count);
+  sc_array_reset (&rbuffers);
+}
+
+p4est_ghost_exchange_plan_t *
+p4est_ghost_exchange_plan_new (p4est_t * p4est, p4est_ghost_t * ghost,
+                               size_t data_size, void *ghost_data)
+{
+  p4est_ghost_exchange_plan_t *plan;
+#ifdef P4EST_ENABLE_MPI
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 q;
+  int                 num_requests;
+  p4est_locidx_t      ng_excl, ng_incl, ng;
+  sc_MPI_Request     *r;
+#endif
+
+  plan = P4EST_ALLOC_ZERO (p4est_ghost_exchange_plan_t, 1);
+  plan->p4est = p4est;
+  plan->ghost = ghost;
+  plan->data_size = data_size;
+  plan->ghost_data = ghost_data;
+  plan->num_requests = 0;
+  plan->requests = NULL;
+  plan->sbuffer = NULL;
+  plan->rbuffer = NULL;
+  plan->combine_fn = NULL;
+
+  if (data_size == 0) {
+    return plan;
+  }
+
+#ifdef P4EST_ENABLE_MPI
+  /* the send buffer is fixed so the requests can persist */
+  plan->sbuffer = P4EST_ALLOC (char, (size_t)
+                               ghost->mirror_proc_offsets[num_procs] *
+                               data_size);
+
+  /* count the peers to receive from and send to */
+  num_requests = 0;
+  for (q = 0; q < num_procs; ++q) {
+    if (ghost->proc_offsets[q + 1] > ghost->proc_offsets[q]) {
+      ++num_requests;
+    }
+    if (ghost->mirror_proc_offsets[q + 1] > ghost->mirror_proc_offsets[q]) {
+      ++num_requests;
+    }
+  }
+  plan->requests = P4EST_ALLOC (sc_MPI_Request, num_requests);
+
+  /* initialize persistent receives into the fixed ghost data array */
+  r = plan->requests;
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      mpiret = MPI_Recv_init ((char *) ghost_data + ng_excl * data_size,
+                              ng * (int) data_size, sc_MPI_BYTE, q,
+                              P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm,
+                              r++);
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+
+  /* initialize persistent sends out of the fixed pack buffer */
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->mirror_proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      mpiret = MPI_Send_init (plan->sbuffer + ng_excl * data_size,
+                              ng * (int) data_size, sc_MPI_BYTE, q,
+                              P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm,
+                              r++);
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+  P4EST_ASSERT (r == plan->requests + num_requests);
+  plan->num_requests = num_requests;
+#endif /* P4EST_ENABLE_MPI */
+
+  return plan;
+}
+
+p4est_ghost_exchange_plan_t *
+p4est_ghost_exchange_plan_symmetric_new (p4est_t * p4est,
+                                         p4est_ghost_t * ghost,
+                                         size_t data_size, void *ghost_data,
+                                         p4est_ghost_combine_t combine_fn)
+{
+  p4est_ghost_exchange_plan_t *plan;
+#ifdef P4EST_ENABLE_MPI
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 q;
+  int                 num_requests;
+  size_t              zoff;
+  p4est_locidx_t      ng, nm;
+  sc_MPI_Request     *r;
+#endif
+
+  P4EST_ASSERT (combine_fn != NULL);
+
+  plan = P4EST_ALLOC_ZERO (p4est_ghost_exchange_plan_t, 1);
+  plan->p4est = p4est;
+  plan->ghost = ghost;
+  plan->data_size = data_size;
+  plan->ghost_data = ghost_data;
+  plan->combine_fn = combine_fn;
+  plan->num_requests = 0;
+  plan->requests = NULL;
+  plan->sbuffer = NULL;
+  plan->rbuffer = NULL;
+
+  if (data_size == 0) {
+    return plan;
+  }
+
+#ifdef P4EST_ENABLE_MPI
+  /* every message carries the mirror payload and the returning ghost
+   * contributions of one peer pair back to back, so a single pair of
+   * fixed buffers holds both directions of the symmetric update */
+  zoff = (size_t) (ghost->mirror_proc_offsets[num_procs] +
+                   ghost->proc_offsets[num_procs]) * data_size;
+  plan->sbuffer = P4EST_ALLOC (char, zoff);
+  plan->rbuffer = P4EST_ALLOC (char, zoff);
+
+  /* a peer pair exchanges messages if data flows in either direction */
+  num_requests = 0;
+  for (q = 0; q < num_procs; ++q) {
+    if (ghost->proc_offsets[q + 1] - ghost->proc_offsets[q] +
+        ghost->mirror_proc_offsets[q + 1] -
+        ghost->mirror_proc_offsets[q] > 0) {
+      num_requests += 2;
+    }
+  }
+  plan->requests = P4EST_ALLOC (sc_MPI_Request, num_requests);
+
+  r = plan->requests;
+  zoff = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng = ghost->proc_offsets[q + 1] - ghost->proc_offsets[q];
+    nm = ghost->mirror_proc_offsets[q + 1] - ghost->mirror_proc_offsets[q];
+    P4EST_ASSERT (ng >= 0 && nm >= 0);
+    if (ng + nm > 0) {
+      mpiret = MPI_Recv_init (plan->rbuffer + zoff,
+                              (ng + nm) * (int) data_size, sc_MPI_BYTE, q,
+                              P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm,
+                              r++);
+      SC_CHECK_MPI (mpiret);
+      mpiret = MPI_Send_init (plan->sbuffer + zoff,
+                              (ng + nm) * (int) data_size, sc_MPI_BYTE, q,
+                              P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm,
+                              r++);
+      SC_CHECK_MPI (mpiret);
+      zoff += (size_t) (ng + nm) * data_size;
+    }
+  }
+  P4EST_ASSERT (r == plan->requests + num_requests);
+  plan->num_requests = num_requests;
+#endif /* P4EST_ENABLE_MPI */
+
+  return plan;
+}
+
+p4est_ghost_exchange_plan_t *
+p4est_ghost_exchange_plan_partitioned_new (p4est_t * p4est,
+                                           p4est_ghost_t * ghost,
+                                           size_t data_size,
+                                           void *ghost_data,
+                                           int num_partitions)
+{
+  p4est_ghost_exchange_plan_t *plan;
+#ifdef P4EST_ENABLE_MPI
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 q;
+  int                 p, parts;
+  int                 num_requests;
+  p4est_locidx_t      ng_excl, ng_incl, ng;
+  sc_MPI_Request     *r;
+#endif
+
+  P4EST_ASSERT (num_partitions > 0);
+
+  plan = P4EST_ALLOC_ZERO (p4est_ghost_exchange_plan_t, 1);
+  plan->p4est = p4est;
+  plan->ghost = ghost;
+  plan->data_size = data_size;
+  plan->ghost_data = ghost_data;
+  plan->num_partitions = num_partitions;
+
+  if (data_size == 0) {
+    return plan;
+  }
+
+#ifdef P4EST_ENABLE_MPI
+  /* the send buffer is fixed so the requests can persist */
+  plan->sbuffer = P4EST_ALLOC (char, (size_t)
+                               ghost->mirror_proc_offsets[num_procs] *
+                               data_size);
+
+  /* count the peers to receive from and send to */
+  num_requests = 0;
+  plan->num_send_peers = 0;
+  for (q = 0; q < num_procs; ++q) {
+    if (ghost->proc_offsets[q + 1] > ghost->proc_offsets[q]) {
+      ++num_requests;
+    }
+    if (ghost->mirror_proc_offsets[q + 1] > ghost->mirror_proc_offsets[q]) {
+      ++num_requests;
+      ++plan->num_send_peers;
+    }
+  }
+  plan->requests = P4EST_ALLOC (sc_MPI_Request, num_requests);
+  plan->send_offsets = P4EST_ALLOC (p4est_locidx_t,
+                                    plan->num_send_peers + 1);
+  plan->send_parts = P4EST_ALLOC (int, plan->num_send_peers);
+  plan->send_done = P4EST_ALLOC_ZERO (int, plan->num_send_peers);
+
+  /* initialize the receives into the fixed ghost data array; a
+   * partitioned send must be matched by a partitioned receive, which
+   * we leave in one partition since we consume the message as a whole */
+  r = plan->requests;
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+#ifdef P4EST_MPI_PARTITIONED
+      mpiret = MPI_Precv_init ((char *) ghost_data + ng_excl * data_size,
+                               1, (MPI_Count) ng * (MPI_Count) data_size,
+                               sc_MPI_BYTE, q, P4EST_COMM_GHOST_EXCHANGE,
+                               p4est->mpicomm, MPI_INFO_NULL, r++);
+#else
+      mpiret = MPI_Recv_init ((char *) ghost_data + ng_excl * data_size,
+                              ng * (int) data_size, sc_MPI_BYTE, q,
+                              P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm,
+                              r++);
+#endif
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+  plan->send_requests = r;
+
+  /* initialize the sends out of the fixed pack buffer; each message is
+   * split into equal partitions of whole quadrants so a stage can mark
+   * its packed range ready while later stages still compute */
+  p = 0;
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->mirror_proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0) {
+      parts = (p4est_locidx_t) num_partitions > ng ?
+        (int) ng : num_partitions;
+      while (ng % (p4est_locidx_t) parts) {
+        --parts;
+      }
+      plan->send_offsets[p] = ng_excl;
+      plan->send_parts[p++] = parts;
+#ifdef P4EST_MPI_PARTITIONED
+      mpiret = MPI_Psend_init (plan->sbuffer + ng_excl * data_size,
+                               parts, (MPI_Count) (ng / parts) *
+                               (MPI_Count) data_size, sc_MPI_BYTE, q,
+                               P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm,
+                               MPI_INFO_NULL, r++);
+#else
+      mpiret = MPI_Send_init (plan->sbuffer + ng_excl * data_size,
+                              ng * (int) data_size, sc_MPI_BYTE, q,
+                              P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm,
+                              r++);
+#endif
+      SC_CHECK_MPI (mpiret);
+      ng_excl = ng_incl;
+    }
+  }
+  P4EST_ASSERT (p == plan->num_send_peers);
+  plan->send_offsets[p] = ghost->mirror_proc_offsets[num_procs];
+  P4EST_ASSERT (r == plan->requests + num_requests);
+  plan->num_requests = num_requests;
+#endif /* P4EST_ENABLE_MPI */
+
+  return plan;
 }
 
-p4est_ghost_exchange_t *
-p4est_ghost_exchange_data_begin (p4est_t * p4est, p4est_ghost_t * ghost,
-                                 void *ghost_data)
+/** Look up the current payload address of every mirror quadrant. */
+static void       **
+p4est_ghost_exchange_mirror_data (p4est_t * p4est, p4est_ghost_t * ghost)
 {
   size_t              zz;
-  size_t              data_size;
-#ifdef P4EST_ENABLE_DEBUG
-  p4est_topidx_t      prev_tree;
-#endif
   p4est_topidx_t      which_tree;
   p4est_locidx_t      which_quad;
   p4est_quadrant_t   *mirror, *q;
   p4est_tree_t       *tree;
-  p4est_ghost_exchange_t *exc;
   void              **mirror_data;
 
-  /* allocate temporary storage */
   mirror_data = P4EST_ALLOC (void *, ghost->mirrors.elem_count);
-
-  data_size = p4est->data_size == 0 ? sizeof (void *) : p4est->data_size;
-#ifdef P4EST_ENABLE_DEBUG
-  prev_tree = -1;
-#endif
   for (zz = 0; zz < ghost->mirrors.elem_count; ++zz) {
     mirror = p4est_quadrant_array_index (&ghost->mirrors, zz);
     which_tree = mirror->p.piggy3.which_tree;
-    P4EST_ASSERT (p4est->first_local_tree <= which_tree &&
-                  which_tree <= p4est->last_local_tree);
-    P4EST_ASSERT (prev_tree <= which_tree);
-#ifdef P4EST_ENABLE_DEBUG
-    prev_tree = which_tree;
-#endif
     tree = p4est_tree_array_index (p4est->trees, which_tree);
     which_quad = mirror->p.piggy3.local_num - tree->quadrants_offset;
     P4EST_ASSERT (0 <= which_quad &&
@@ -2343,53 +4370,351 @@ p4est_ghost_exchange_data_begin (p4est_t * p4est, p4est_ghost_t * ghost,
       p4est->data_size == 0 ? &q->p.user_data : q->p.user_data;
   }
 
-  /* delegate the rest of the work */
-  exc = p4est_ghost_exchange_custom_begin (p4est, ghost, data_size,
-                                           mirror_data, ghost_data);
-  P4EST_ASSERT (exc->is_custom);
-  P4EST_ASSERT (!exc->is_levels);
-  exc->is_custom = 0;
+  return mirror_data;
+}
 
-  /* the mirror_data is copied before sending so it can be freed */
+/** Execute one combined replicate-and-reduce round of a symmetric plan. */
+static void
+p4est_ghost_exchange_plan_go_symmetric (p4est_ghost_exchange_plan_t * plan)
+{
+  p4est_t            *p4est = plan->p4est;
+  p4est_ghost_t      *ghost = plan->ghost;
+  const int           num_procs = p4est->mpisize;
+  const size_t        data_size = plan->data_size;
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+#endif
+  int                 q;
+  char               *mem;
+  size_t              zoff;
+  p4est_locidx_t      ng, nm, theg, mirr;
+  void              **mirror_data;
+
+  if (data_size == 0) {
+    return;
+  }
+
+  mirror_data = p4est_ghost_exchange_mirror_data (p4est, ghost);
+
+  /* pack the mirror payload and the outgoing ghost contributions of
+   * every peer back to back into the fixed send buffer */
+  zoff = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng = ghost->proc_offsets[q + 1] - ghost->proc_offsets[q];
+    nm = ghost->mirror_proc_offsets[q + 1] - ghost->mirror_proc_offsets[q];
+    if (ng + nm > 0) {
+      mem = plan->sbuffer + zoff;
+      for (theg = 0; theg < nm; ++theg) {
+        mirr =
+          ghost->mirror_proc_mirrors[ghost->mirror_proc_offsets[q] + theg];
+        P4EST_ASSERT (0 <= mirr && (size_t) mirr < ghost->mirrors.elem_count);
+        memcpy (mem, mirror_data[mirr], data_size);
+        mem += data_size;
+      }
+      memcpy (mem, (char *) plan->ghost_data +
+              (size_t) ghost->proc_offsets[q] * data_size,
+              (size_t) ng * data_size);
+      zoff += (size_t) (ng + nm) * data_size;
+    }
+  }
+
+#ifdef P4EST_ENABLE_MPI
+  if (plan->num_requests > 0) {
+    mpiret = MPI_Startall (plan->num_requests, plan->requests);
+    SC_CHECK_MPI (mpiret);
+    mpiret = sc_MPI_Waitall (plan->num_requests, plan->requests,
+                             sc_MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+
+  /* unpack the fresh ghost payload and fold the received
+   * contributions into the mirror quadrants */
+  zoff = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng = ghost->proc_offsets[q + 1] - ghost->proc_offsets[q];
+    nm = ghost->mirror_proc_offsets[q + 1] - ghost->mirror_proc_offsets[q];
+    if (ng + nm > 0) {
+      memcpy ((char *) plan->ghost_data +
+              (size_t) ghost->proc_offsets[q] * data_size,
+              plan->rbuffer + zoff, (size_t) ng * data_size);
+      mem = plan->rbuffer + zoff + (size_t) ng * data_size;
+      for (theg = 0; theg < nm; ++theg) {
+        mirr =
+          ghost->mirror_proc_mirrors[ghost->mirror_proc_offsets[q] + theg];
+        plan->combine_fn (mirror_data[mirr], mem, data_size);
+        mem += data_size;
+      }
+      zoff += (size_t) (ng + nm) * data_size;
+    }
+  }
   P4EST_FREE (mirror_data);
+}
 
-  /* return message buffers */
-  return exc;
+void
+p4est_ghost_exchange_plan_go (p4est_ghost_exchange_plan_t * plan)
+{
+  p4est_t            *p4est = plan->p4est;
+  p4est_ghost_t      *ghost = plan->ghost;
+  const size_t        data_size = plan->data_size;
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+#endif
+  p4est_locidx_t      il, mirr;
+  void              **mirror_data;
+
+  /* partitioned plans run through start, ready, and complete instead */
+  P4EST_ASSERT (plan->num_partitions == 0);
+
+  if (plan->combine_fn != NULL) {
+    p4est_ghost_exchange_plan_go_symmetric (plan);
+    return;
+  }
+
+  if (data_size == 0) {
+    return;
+  }
+
+  mirror_data = p4est_ghost_exchange_mirror_data (p4est, ghost);
+
+  /* pack the mirror payload into the persistent send buffer */
+  for (il = 0; il < ghost->mirror_proc_offsets[p4est->mpisize]; ++il) {
+    mirr = ghost->mirror_proc_mirrors[il];
+    P4EST_ASSERT (0 <= mirr && (size_t) mirr < ghost->mirrors.elem_count);
+    memcpy (plan->sbuffer + (size_t) il * data_size, mirror_data[mirr],
+            data_size);
+  }
+  P4EST_FREE (mirror_data);
+
+#ifdef P4EST_ENABLE_MPI
+  if (plan->num_requests > 0) {
+    mpiret = MPI_Startall (plan->num_requests, plan->requests);
+    SC_CHECK_MPI (mpiret);
+    mpiret = sc_MPI_Waitall (plan->num_requests, plan->requests,
+                             sc_MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+}
+
+/** Pack one contiguous range of the mirror copy sequence of a plan. */
+static void
+p4est_ghost_exchange_plan_pack (p4est_ghost_exchange_plan_t * plan,
+                                p4est_locidx_t mirror_first,
+                                p4est_locidx_t mirror_count)
+{
+  p4est_t            *p4est = plan->p4est;
+  p4est_ghost_t      *ghost = plan->ghost;
+  const size_t        data_size = plan->data_size;
+  p4est_topidx_t      which_tree;
+  p4est_locidx_t      il, mirr, which_quad;
+  p4est_quadrant_t   *mirror, *q;
+  p4est_tree_t       *tree;
+
+  for (il = mirror_first; il < mirror_first + mirror_count; ++il) {
+    mirr = ghost->mirror_proc_mirrors[il];
+    P4EST_ASSERT (0 <= mirr && (size_t) mirr < ghost->mirrors.elem_count);
+    mirror = p4est_quadrant_array_index (&ghost->mirrors, (size_t) mirr);
+    which_tree = mirror->p.piggy3.which_tree;
+    tree = p4est_tree_array_index (p4est->trees, which_tree);
+    which_quad = mirror->p.piggy3.local_num - tree->quadrants_offset;
+    P4EST_ASSERT (0 <= which_quad &&
+                  which_quad < (p4est_locidx_t) tree->quadrants.elem_count);
+    q = p4est_quadrant_array_index (&tree->quadrants, which_quad);
+    memcpy (plan->sbuffer + (size_t) il * data_size,
+            p4est->data_size == 0 ?
+            (void *) &q->p.user_data : q->p.user_data, data_size);
+  }
 }
 
 void
-p4est_ghost_exchange_data_end (p4est_ghost_exchange_t * exc)
+p4est_ghost_exchange_plan_start (p4est_ghost_exchange_plan_t * plan)
 {
-  /* don't confuse this function with p4est_ghost_exchange_custom_end */
-  P4EST_ASSERT (!exc->is_custom);
-  P4EST_ASSERT (!exc->is_levels);
+#ifdef P4EST_MPI_PARTITIONED
+  int                 mpiret;
+#endif
 
-  /* delegate the rest of the work, including freeing the context */
-  exc->is_custom = 1;
-  p4est_ghost_exchange_custom_end (exc);
+  P4EST_ASSERT (plan->num_partitions > 0);
+  P4EST_ASSERT (plan->ready_mirrors == 0);
+
+#ifdef P4EST_MPI_PARTITIONED
+  /* partitioned requests must be active before partitions are marked */
+  if (plan->num_requests > 0) {
+    mpiret = MPI_Startall (plan->num_requests, plan->requests);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
 }
 
 void
-p4est_ghost_exchange_custom (p4est_t * p4est, p4est_ghost_t * ghost,
-                             size_t data_size,
-                             void **mirror_data, void *ghost_data)
+p4est_ghost_exchange_plan_ready (p4est_ghost_exchange_plan_t * plan,
+                                 p4est_locidx_t mirror_first,
+                                 p4est_locidx_t mirror_count)
 {
-  p4est_ghost_exchange_custom_end (p4est_ghost_exchange_custom_begin
-                                   (p4est, ghost, data_size,
-                                    mirror_data, ghost_data));
+#ifdef P4EST_MPI_PARTITIONED
+  int                 mpiret;
+  int                 p, pdone;
+  p4est_locidx_t      lo, hi, quads;
+#endif
+
+  P4EST_ASSERT (plan->num_partitions > 0);
+  P4EST_ASSERT (mirror_count >= 0);
+  P4EST_ASSERT (mirror_first == plan->ready_mirrors);
+
+  if (mirror_count > 0 && plan->data_size > 0) {
+    p4est_ghost_exchange_plan_pack (plan, mirror_first, mirror_count);
+  }
+  plan->ready_mirrors += mirror_count;
+
+#ifdef P4EST_MPI_PARTITIONED
+  /* mark every send partition complete whose quadrants are all packed;
+   * the fabric may then transfer it while later stages still compute */
+  for (p = 0; p < plan->num_send_peers; ++p) {
+    lo = plan->send_offsets[p];
+    hi = plan->send_offsets[p + 1];
+    if (plan->ready_mirrors <= lo) {
+      break;
+    }
+    quads = (hi - lo) / (p4est_locidx_t) plan->send_parts[p];
+    pdone = (int) ((SC_MIN (plan->ready_mirrors, hi) - lo) / quads);
+    while (plan->send_done[p] < pdone) {
+      mpiret = MPI_Pready (plan->send_done[p]++, plan->send_requests[p]);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+#endif
+}
+
+void
+p4est_ghost_exchange_plan_complete (p4est_ghost_exchange_plan_t * plan)
+{
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+  int                 p;
+  p4est_locidx_t      total;
+#endif
+
+  P4EST_ASSERT (plan->num_partitions > 0);
+
+#ifdef P4EST_ENABLE_MPI
+  if (plan->data_size > 0) {
+    /* pack and mark whatever the caller has not declared ready */
+    total = plan->ghost->mirror_proc_offsets[plan->p4est->mpisize];
+    if (plan->ready_mirrors < total) {
+      p4est_ghost_exchange_plan_ready (plan, plan->ready_mirrors,
+                                       total - plan->ready_mirrors);
+    }
+    if (plan->num_requests > 0) {
+#ifndef P4EST_MPI_PARTITIONED
+      /* pre-MPI-4 fallback: the persistent sends start only now that
+       * the buffer is completely packed */
+      mpiret = MPI_Startall (plan->num_requests, plan->requests);
+      SC_CHECK_MPI (mpiret);
+#endif
+      mpiret = sc_MPI_Waitall (plan->num_requests, plan->requests,
+                               sc_MPI_STATUSES_IGNORE);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+  for (p = 0; p < plan->num_send_peers; ++p) {
+    plan->send_done[p] = 0;
+  }
+#endif
+  plan->ready_mirrors = 0;
+}
+
+void
+p4est_ghost_exchange_plan_destroy (p4est_ghost_exchange_plan_t * plan)
+{
+#ifdef P4EST_ENABLE_MPI
+  int                 i, mpiret;
+
+  for (i = 0; i < plan->num_requests; ++i) {
+    mpiret = MPI_Request_free (plan->requests + i);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+  P4EST_FREE (plan->requests);
+  P4EST_FREE (plan->send_offsets);
+  P4EST_FREE (plan->send_parts);
+  P4EST_FREE (plan->send_done);
+  P4EST_FREE (plan->sbuffer);
+  P4EST_FREE (plan->rbuffer);
+  P4EST_FREE (plan);
+}
+
+p4est_ghost_pack_plan_t *
+p4est_ghost_pack_plan_new (p4est_t * p4est, p4est_ghost_t * ghost)
+{
+  const int           num_procs = p4est->mpisize;
+  int                 q;
+  int                 p;
+  p4est_locidx_t      il, total, mirr;
+  p4est_quadrant_t   *mirror;
+  p4est_ghost_pack_plan_t *plan;
+
+  plan = P4EST_ALLOC (p4est_ghost_pack_plan_t, 1);
+
+  /* count the peers that receive a nonempty message from us */
+  plan->num_peers = 0;
+  for (q = 0; q < num_procs; ++q) {
+    if (ghost->mirror_proc_offsets[q + 1] > ghost->mirror_proc_offsets[q]) {
+      ++plan->num_peers;
+    }
+  }
+  plan->peers = P4EST_ALLOC (int, plan->num_peers);
+  plan->peer_offsets = P4EST_ALLOC (p4est_locidx_t, plan->num_peers + 1);
+  p = 0;
+  plan->peer_offsets[0] = 0;
+  for (q = 0; q < num_procs; ++q) {
+    if (ghost->mirror_proc_offsets[q + 1] > ghost->mirror_proc_offsets[q]) {
+      plan->peers[p] = q;
+      plan->peer_offsets[++p] = ghost->mirror_proc_offsets[q + 1];
+    }
+  }
+  P4EST_ASSERT (p == plan->num_peers);
+
+  /* translate each packed entry into the cumulative local quadrant index */
+  total = ghost->mirror_proc_offsets[num_procs];
+  plan->indices = P4EST_ALLOC (p4est_locidx_t, total);
+  for (il = 0; il < total; ++il) {
+    mirr = ghost->mirror_proc_mirrors[il];
+    P4EST_ASSERT (0 <= mirr && (size_t) mirr < ghost->mirrors.elem_count);
+    mirror = p4est_quadrant_array_index (&ghost->mirrors, mirr);
+    plan->indices[il] = mirror->p.piggy3.local_num;
+  }
+
+  return plan;
+}
+
+void
+p4est_ghost_pack_plan_destroy (p4est_ghost_pack_plan_t * plan)
+{
+  P4EST_FREE (plan->peers);
+  P4EST_FREE (plan->peer_offsets);
+  P4EST_FREE (plan->indices);
+  P4EST_FREE (plan);
+}
+
+void
+p4est_ghost_exchange_buffers (p4est_t * p4est, p4est_ghost_t * ghost,
+                              size_t data_size,
+                              void *send_buffer, void *recv_buffer)
+{
+  p4est_ghost_exchange_buffers_end (p4est_ghost_exchange_buffers_begin
+                                    (p4est, ghost, data_size,
+                                     send_buffer, recv_buffer));
 }
 
 p4est_ghost_exchange_t *
-p4est_ghost_exchange_custom_begin (p4est_t * p4est, p4est_ghost_t * ghost,
-                                   size_t data_size,
-                                   void **mirror_data, void *ghost_data)
+p4est_ghost_exchange_buffers_begin (p4est_t * p4est, p4est_ghost_t * ghost,
+                                    size_t data_size,
+                                    void *send_buffer, void *recv_buffer)
 {
   const int           num_procs = p4est->mpisize;
   int                 mpiret;
   int                 q;
-  char               *mem, **sbuf;
-  p4est_locidx_t      ng_excl, ng_incl, ng, theg;
-  p4est_locidx_t      mirr;
+  p4est_locidx_t      ng_excl, ng_incl, ng;
   p4est_ghost_exchange_t *exc;
   sc_MPI_Request     *r;
 
@@ -2401,7 +4726,7 @@ p4est_ghost_exchange_custom_begin (p4est_t * p4est, p4est_ghost_t * ghost,
   exc->minlevel = 0;
   exc->maxlevel = P4EST_QMAXLEVEL;
   exc->data_size = data_size;
-  exc->ghost_data = ghost_data;
+  exc->ghost_data = recv_buffer;
   sc_array_init (&exc->requests, sizeof (sc_MPI_Request));
   sc_array_init (&exc->sbuffers, sizeof (char *));
 
@@ -2418,7 +4743,7 @@ p4est_ghost_exchange_custom_begin (p4est_t * p4est, p4est_ghost_t * ghost,
     P4EST_ASSERT (ng >= 0);
     if (ng > 0) {
       r = (sc_MPI_Request *) sc_array_push (&exc->requests);
-      mpiret = sc_MPI_Irecv ((char *) ghost_data + ng_excl * data_size,
+      mpiret = sc_MPI_Irecv ((char *) recv_buffer + ng_excl * data_size,
                              ng * data_size, sc_MPI_BYTE, q,
                              P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
       SC_CHECK_MPI (mpiret);
@@ -2427,24 +4752,18 @@ p4est_ghost_exchange_custom_begin (p4est_t * p4est, p4est_ghost_t * ghost,
   }
   P4EST_ASSERT (ng_excl == (p4est_locidx_t) ghost->ghosts.elem_count);
 
-  /* send data to other processors */
+  /* send data to other processors out of the prepacked buffer.
+   * The buffer contents are never dereferenced on the host, so the
+   * address may refer to pinned or device memory. */
   ng_excl = 0;
   for (q = 0; q < num_procs; ++q) {
     ng_incl = ghost->mirror_proc_offsets[q + 1];
     ng = ng_incl - ng_excl;
     P4EST_ASSERT (ng >= 0);
-    if (ng > 0) {
-      /* every peer populates its own send buffer */
-      sbuf = (char **) sc_array_push (&exc->sbuffers);
-      mem = *sbuf = P4EST_ALLOC (char, ng * data_size);
-      for (theg = 0; theg < ng; ++theg) {
-        mirr = ghost->mirror_proc_mirrors[ng_excl + theg];
-        P4EST_ASSERT (0 <= mirr && (size_t) mirr < ghost->mirrors.elem_count);
-        memcpy (mem, mirror_data[mirr], data_size);
-        mem += data_size;
-      }
+    if (ng > 0) {
       r = (sc_MPI_Request *) sc_array_push (&exc->requests);
-      mpiret = sc_MPI_Isend (*sbuf, ng * data_size, sc_MPI_BYTE, q,
+      mpiret = sc_MPI_Isend ((char *) send_buffer + ng_excl * data_size,
+                             ng * data_size, sc_MPI_BYTE, q,
                              P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
       SC_CHECK_MPI (mpiret);
       ng_excl = ng_incl;
@@ -2456,272 +4775,390 @@ p4est_ghost_exchange_custom_begin (p4est_t * p4est, p4est_ghost_t * ghost,
 }
 
 void
-p4est_ghost_exchange_custom_end (p4est_ghost_exchange_t * exc)
+p4est_ghost_exchange_buffers_end (p4est_ghost_exchange_t * exc)
 {
   int                 mpiret;
-  size_t              zz;
-  char              **sbuf;
 
-  /* don't confuse this function with p4est_ghost_exchange_data_end */
   P4EST_ASSERT (exc->is_custom);
-
-  /* don't confuse it with p4est_ghost_exchange_custom_levels_end either */
   P4EST_ASSERT (!exc->is_levels);
 
-  /* wait for messages to complete and clean up */
+  /* both buffers are owned by the caller: just wait for completion */
+  P4EST_ASSERT (exc->sbuffers.elem_count == 0);
   mpiret = sc_MPI_Waitall (exc->requests.elem_count, (sc_MPI_Request *)
                            exc->requests.array, sc_MPI_STATUSES_IGNORE);
   SC_CHECK_MPI (mpiret);
   sc_array_reset (&exc->requests);
-  for (zz = 0; zz < exc->sbuffers.elem_count; ++zz) {
-    sbuf = (char **) sc_array_index (&exc->sbuffers, zz);
-    P4EST_FREE (*sbuf);
-  }
   sc_array_reset (&exc->sbuffers);
 
   /* free the store */
   P4EST_FREE (exc);
 }
 
+p4est_ghost_exchange_group_t *
+p4est_ghost_exchange_group_new (void)
+{
+  p4est_ghost_exchange_group_t *group;
+
+  group = P4EST_ALLOC_ZERO (p4est_ghost_exchange_group_t, 1);
+  group->mpicomm = sc_MPI_COMM_NULL;
+  sc_array_init (&group->members,
+                 sizeof (p4est_ghost_exchange_group_member_t));
+  sc_array_init (&group->requests, sizeof (sc_MPI_Request));
+  sc_array_init (&group->sbuffers, sizeof (char *));
+  sc_array_init (&group->rbuffers, sizeof (char *));
+
+  return group;
+}
+
 void
-p4est_ghost_exchange_custom_levels (p4est_t * p4est, p4est_ghost_t * ghost,
-                                    int minlevel, int maxlevel,
-                                    size_t data_size,
-                                    void **mirror_data, void *ghost_data)
+p4est_ghost_exchange_group_add (p4est_ghost_exchange_group_t * group,
+                                p4est_t * p4est, p4est_ghost_t * ghost,
+                                size_t data_size, void **mirror_data,
+                                void *ghost_data)
 {
-  p4est_ghost_exchange_custom_levels_end
-    (p4est_ghost_exchange_custom_levels_begin (p4est, ghost,
-                                               minlevel, maxlevel, data_size,
-                                               mirror_data, ghost_data));
+  p4est_ghost_exchange_group_member_t *member;
+
+  /* a round must not be in progress while the group is changed */
+  P4EST_ASSERT (group->requests.elem_count == 0);
+
+  if (group->members.elem_count == 0) {
+    group->mpicomm = p4est->mpicomm;
+    group->mpisize = p4est->mpisize;
+  }
+  else {
+    /* all members must share one communicator and thus one peer set */
+    P4EST_ASSERT (p4est->mpicomm == group->mpicomm);
+    P4EST_ASSERT (p4est->mpisize == group->mpisize);
+  }
+
+  member = (p4est_ghost_exchange_group_member_t *)
+    sc_array_push (&group->members);
+  member->p4est = p4est;
+  member->ghost = ghost;
+  member->data_size = data_size;
+  member->mirror_data = mirror_data;
+  member->ghost_data = ghost_data;
 }
 
-p4est_ghost_exchange_t *
-p4est_ghost_exchange_custom_levels_begin (p4est_t * p4est,
-                                          p4est_ghost_t * ghost,
-                                          int minlevel, int maxlevel,
-                                          size_t data_size,
-                                          void **mirror_data,
-                                          void *ghost_data)
+void
+p4est_ghost_exchange_group_begin (p4est_ghost_exchange_group_t * group)
 {
-  const int           num_procs = p4est->mpisize;
+  const int           num_procs = group->mpisize;
   int                 mpiret;
   int                 q;
-  int                *theq, *qactive, *qbuffer;
-  char               *mem, **rbuf, **sbuf;
-  p4est_locidx_t      ng_excl, ng_incl, ng, theg;
-  p4est_locidx_t      lmatches;
+  char               *mem, **sbuf, **rbuf;
+  size_t              zz, sbytes, rbytes;
+  p4est_locidx_t      ng, theg;
   p4est_locidx_t      mirr;
-  p4est_quadrant_t   *g, *m;
-  p4est_ghost_exchange_t *exc;
+  p4est_ghost_t      *ghost;
+  p4est_ghost_exchange_group_member_t *member;
   sc_MPI_Request     *r;
 
-  if (minlevel <= 0 && maxlevel >= P4EST_QMAXLEVEL) {
-    /* this case can be processed by a more specialized function */
-    exc = p4est_ghost_exchange_custom_begin (p4est, ghost, data_size,
-                                             mirror_data, ghost_data);
-    P4EST_ASSERT (exc->is_custom);
-    P4EST_ASSERT (!exc->is_levels);
-    exc->is_levels = 1;
-
-    /* the completion function will have to switch for this case */
-    return exc;
-  }
-
-  /* initialize transient storage */
-  exc = P4EST_ALLOC_ZERO (p4est_ghost_exchange_t, 1);
-  exc->is_custom = 1;
-  exc->is_levels = 1;
-  exc->p4est = p4est;
-  exc->ghost = ghost;
-  exc->minlevel = minlevel;
-  exc->maxlevel = maxlevel;
-  exc->data_size = data_size;
-  exc->ghost_data = ghost_data;
-  sc_array_init (&exc->requests, sizeof (sc_MPI_Request));
-  sc_array_init (&exc->rrequests, sizeof (sc_MPI_Request));
-  sc_array_init (&exc->rbuffers, sizeof (char *));
-  sc_array_init (&exc->sbuffers, sizeof (char *));
+  P4EST_ASSERT (group->requests.elem_count == 0);
+  P4EST_ASSERT (group->sbuffers.elem_count == 0);
+  P4EST_ASSERT (group->rbuffers.elem_count == 0);
 
-  /* return early if there is nothing to do */
-  if (data_size == 0 || minlevel > maxlevel) {
-    return exc;
+  /* post one combined receive per peer process */
+  for (q = 0; q < num_procs; ++q) {
+    rbytes = 0;
+    for (zz = 0; zz < group->members.elem_count; ++zz) {
+      member = (p4est_ghost_exchange_group_member_t *)
+        sc_array_index (&group->members, zz);
+      ghost = member->ghost;
+      ng = ghost->proc_offsets[q + 1] - ghost->proc_offsets[q];
+      P4EST_ASSERT (ng >= 0);
+      rbytes += (size_t) ng *member->data_size;
+    }
+    if (rbytes > 0) {
+      rbuf = (char **) sc_array_push (&group->rbuffers);
+      *rbuf = P4EST_ALLOC (char, rbytes);
+      r = (sc_MPI_Request *) sc_array_push (&group->requests);
+      mpiret = sc_MPI_Irecv (*rbuf, rbytes, sc_MPI_BYTE, q,
+                             P4EST_COMM_GHOST_EXCHANGE_GROUP,
+                             group->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+    }
   }
-  qactive = exc->qactive = P4EST_ALLOC (int, num_procs);
-  qbuffer = exc->qbuffer = P4EST_ALLOC (int, num_procs);
 
-  /* receive data from other processors */
-  ng_excl = 0;
+  /* pack the mirror payload of all members and send it as one message */
   for (q = 0; q < num_procs; ++q) {
-    qactive[q] = -1;
-    qbuffer[q] = -1;
-    ng_incl = ghost->proc_offsets[q + 1];
-    ng = ng_incl - ng_excl;
-    P4EST_ASSERT (ng >= 0);
-    if (ng > 0) {
-      P4EST_ASSERT (q != p4est->mpirank);
-      /* run through ghosts to count the matching level quadrants */
-      for (lmatches = 0, theg = 0; theg < ng; ++theg) {
-        g = p4est_quadrant_array_index (&ghost->ghosts, ng_excl + theg);
-        if (minlevel <= (int) g->level && (int) g->level <= maxlevel) {
-          ++lmatches;
-        }
-      }
-      if (lmatches > 0) {
-        theq = qactive + exc->rrequests.elem_count;
-        r = (sc_MPI_Request *) sc_array_push (&exc->rrequests);
-        if (lmatches < ng) {
-          /* every peer populates its own receive buffer */
-          *theq = q;
-          qbuffer[q] = (int) exc->rbuffers.elem_count;
-          rbuf = (char **) sc_array_push (&exc->rbuffers);
-          *rbuf = P4EST_ALLOC (char, lmatches * data_size);
-          mpiret = sc_MPI_Irecv (*rbuf, lmatches * data_size, sc_MPI_BYTE, q,
-                                 P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm,
-                                 r);
-        }
-        else {
-          /* use the ghost data memory as is */
-          *theq = -1;
-          mpiret = sc_MPI_Irecv ((char *) ghost_data + ng_excl * data_size,
-                                 ng * data_size, sc_MPI_BYTE, q,
-                                 P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm,
-                                 r);
+    sbytes = 0;
+    for (zz = 0; zz < group->members.elem_count; ++zz) {
+      member = (p4est_ghost_exchange_group_member_t *)
+        sc_array_index (&group->members, zz);
+      ghost = member->ghost;
+      ng = ghost->mirror_proc_offsets[q + 1] - ghost->mirror_proc_offsets[q];
+      P4EST_ASSERT (ng >= 0);
+      sbytes += (size_t) ng *member->data_size;
+    }
+    if (sbytes > 0) {
+      sbuf = (char **) sc_array_push (&group->sbuffers);
+      mem = *sbuf = P4EST_ALLOC (char, sbytes);
+      for (zz = 0; zz < group->members.elem_count; ++zz) {
+        member = (p4est_ghost_exchange_group_member_t *)
+          sc_array_index (&group->members, zz);
+        ghost = member->ghost;
+        for (theg = ghost->mirror_proc_offsets[q];
+             theg < ghost->mirror_proc_offsets[q + 1]; ++theg) {
+          mirr = ghost->mirror_proc_mirrors[theg];
+          P4EST_ASSERT (0 <= mirr &&
+                        (size_t) mirr < ghost->mirrors.elem_count);
+          memcpy (mem, member->mirror_data[mirr], member->data_size);
+          mem += member->data_size;
         }
-        SC_CHECK_MPI (mpiret);
       }
-      ng_excl = ng_incl;
+      P4EST_ASSERT (mem == *sbuf + sbytes);
+      r = (sc_MPI_Request *) sc_array_push (&group->requests);
+      mpiret = sc_MPI_Isend (*sbuf, sbytes, sc_MPI_BYTE, q,
+                             P4EST_COMM_GHOST_EXCHANGE_GROUP,
+                             group->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
     }
   }
-  P4EST_ASSERT (ng_excl == (p4est_locidx_t) ghost->ghosts.elem_count);
+}
 
-  /* send data to other processors */
-  ng_excl = 0;
+void
+p4est_ghost_exchange_group_end (p4est_ghost_exchange_group_t * group)
+{
+  const int           num_procs = group->mpisize;
+  int                 mpiret;
+  int                 q;
+  char               *mem, **sbuf, **rbuf;
+  size_t              zz, zr, rbytes;
+  p4est_locidx_t      ng;
+  p4est_ghost_t      *ghost;
+  p4est_ghost_exchange_group_member_t *member;
+
+  /* wait for messages to complete */
+  mpiret = sc_MPI_Waitall (group->requests.elem_count, (sc_MPI_Request *)
+                           group->requests.array, sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (&group->requests);
+  for (zz = 0; zz < group->sbuffers.elem_count; ++zz) {
+    sbuf = (char **) sc_array_index (&group->sbuffers, zz);
+    P4EST_FREE (*sbuf);
+  }
+  sc_array_reset (&group->sbuffers);
+
+  /* distribute the received payload into the members' ghost data */
+  zr = 0;
   for (q = 0; q < num_procs; ++q) {
-    ng_incl = ghost->mirror_proc_offsets[q + 1];
-    ng = ng_incl - ng_excl;
-    P4EST_ASSERT (ng >= 0);
-    if (ng > 0) {
-      P4EST_ASSERT (q != p4est->mpirank);
-      /* run through mirrors to count the matching level quadrants */
-      for (lmatches = 0, theg = 0; theg < ng; ++theg) {
-        mirr = ghost->mirror_proc_mirrors[ng_excl + theg];
-        m = p4est_quadrant_array_index (&ghost->mirrors, mirr);
-        if (minlevel <= (int) m->level && (int) m->level <= maxlevel) {
-          ++lmatches;
-        }
-      }
-      if (lmatches > 0) {
-        /* every peer populates its own send buffer */
-        sbuf = (char **) sc_array_push (&exc->sbuffers);
-        mem = *sbuf = P4EST_ALLOC (char, lmatches * data_size);
-        for (theg = 0; theg < ng; ++theg) {
-          mirr = ghost->mirror_proc_mirrors[ng_excl + theg];
-          m = p4est_quadrant_array_index (&ghost->mirrors, mirr);
-          if (minlevel <= (int) m->level && (int) m->level <= maxlevel) {
-            memcpy (mem, mirror_data[mirr], data_size);
-            mem += data_size;
-          }
+    rbytes = 0;
+    for (zz = 0; zz < group->members.elem_count; ++zz) {
+      member = (p4est_ghost_exchange_group_member_t *)
+        sc_array_index (&group->members, zz);
+      ghost = member->ghost;
+      ng = ghost->proc_offsets[q + 1] - ghost->proc_offsets[q];
+      rbytes += (size_t) ng *member->data_size;
+    }
+    if (rbytes > 0) {
+      rbuf = (char **) sc_array_index (&group->rbuffers, zr++);
+      mem = *rbuf;
+      for (zz = 0; zz < group->members.elem_count; ++zz) {
+        member = (p4est_ghost_exchange_group_member_t *)
+          sc_array_index (&group->members, zz);
+        ghost = member->ghost;
+        ng = ghost->proc_offsets[q + 1] - ghost->proc_offsets[q];
+        if (ng > 0 && member->data_size > 0) {
+          memcpy ((char *) member->ghost_data +
+                  (size_t) ghost->proc_offsets[q] * member->data_size,
+                  mem, (size_t) ng * member->data_size);
+          mem += (size_t) ng *member->data_size;
         }
-        r = (sc_MPI_Request *) sc_array_push (&exc->requests);
-        mpiret = sc_MPI_Isend (*sbuf, lmatches * data_size, sc_MPI_BYTE, q,
-                               P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
-        SC_CHECK_MPI (mpiret);
       }
-      ng_excl = ng_incl;
+      P4EST_ASSERT (mem == *rbuf + rbytes);
+      P4EST_FREE (*rbuf);
     }
   }
+  P4EST_ASSERT (zr == group->rbuffers.elem_count);
+  sc_array_reset (&group->rbuffers);
+}
 
-  /* we are done posting messages */
-  return exc;
+void
+p4est_ghost_exchange_group_go (p4est_ghost_exchange_group_t * group)
+{
+  p4est_ghost_exchange_group_begin (group);
+  p4est_ghost_exchange_group_end (group);
 }
 
 void
-p4est_ghost_exchange_custom_levels_end (p4est_ghost_exchange_t * exc)
+p4est_ghost_exchange_group_destroy (p4est_ghost_exchange_group_t * group)
 {
-  p4est_ghost_t      *ghost = exc->ghost;
-#ifdef P4EST_ENABLE_DEBUG
-  p4est_t            *p4est = exc->p4est;
+  P4EST_ASSERT (group->requests.elem_count == 0);
+  P4EST_ASSERT (group->sbuffers.elem_count == 0);
+  P4EST_ASSERT (group->rbuffers.elem_count == 0);
+
+  sc_array_reset (&group->members);
+  sc_array_reset (&group->requests);
+  sc_array_reset (&group->sbuffers);
+  sc_array_reset (&group->rbuffers);
+  P4EST_FREE (group);
+}
+
+sc_MPI_Comm
+p4est_ghost_graph_comm_new (p4est_t * p4est, p4est_ghost_t * ghost)
+{
+#ifdef P4EST_MPI_DIST_GRAPH
   const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 q;
+  int                 nsrc, ndst;
+  int                *srcs, *dsts;
+  MPI_Comm            graph_comm;
+
+  P4EST_ASSERT (p4est_ghost_is_valid (p4est, ghost));
+
+  /* sources send us ghost data and destinations receive our mirrors */
+  srcs = P4EST_ALLOC (int, num_procs);
+  dsts = P4EST_ALLOC (int, num_procs);
+  nsrc = ndst = 0;
+  for (q = 0; q < num_procs; ++q) {
+    if (ghost->proc_offsets[q + 1] > ghost->proc_offsets[q]) {
+      srcs[nsrc++] = q;
+    }
+    if (ghost->mirror_proc_offsets[q + 1] > ghost->mirror_proc_offsets[q]) {
+      dsts[ndst++] = q;
+    }
+  }
+  mpiret = MPI_Dist_graph_create_adjacent (p4est->mpicomm,
+                                           nsrc, srcs, MPI_UNWEIGHTED,
+                                           ndst, dsts, MPI_UNWEIGHTED,
+                                           MPI_INFO_NULL, 0, &graph_comm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (srcs);
+  P4EST_FREE (dsts);
+
+  return graph_comm;
+#else
+  /* without MPI-3 the collective variants fall back to point-to-point */
+  return sc_MPI_COMM_NULL;
 #endif
-  const int           minlevel = exc->minlevel;
-  const int           maxlevel = exc->maxlevel;
-  const size_t        data_size = exc->data_size;
+}
+
+void
+p4est_ghost_graph_comm_destroy (sc_MPI_Comm * graph_comm)
+{
+#ifdef P4EST_MPI_DIST_GRAPH
+  int                 mpiret;
+
+  if (*graph_comm != sc_MPI_COMM_NULL) {
+    mpiret = MPI_Comm_free (graph_comm);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+  *graph_comm = sc_MPI_COMM_NULL;
+}
+
+void
+p4est_ghost_exchange_custom_graph (p4est_t * p4est, p4est_ghost_t * ghost,
+                                   sc_MPI_Comm graph_comm, size_t data_size,
+                                   void **mirror_data, void *ghost_data)
+{
+#ifndef P4EST_MPI_DIST_GRAPH
+  p4est_ghost_exchange_custom (p4est, ghost, data_size,
+                               mirror_data, ghost_data);
+#else
+  const int           num_procs = p4est->mpisize;
   int                 mpiret;
-  int                 i, expected, remaining, received, *peers;
   int                 q;
-  char              **rbuf, **sbuf;
-  size_t              zz;
+  int                 nsrc, ndst;
+  int                *sendcounts, *sdispls, *recvcounts, *rdispls;
+  char               *sbuffer, *mem;
   p4est_locidx_t      ng_excl, ng_incl, ng, theg;
-  p4est_locidx_t      lmatches;
-  p4est_quadrant_t   *g;
-
-  /* make sure that the begin function matches the end function */
-  P4EST_ASSERT (exc->is_custom);
-  P4EST_ASSERT (exc->is_levels);
+  p4est_locidx_t      mirr;
 
-  /* check whether we have used the specialized function */
-  if (minlevel <= 0 && maxlevel >= P4EST_QMAXLEVEL) {
-    exc->is_levels = 0;
-    p4est_ghost_exchange_custom_end (exc);
+  if (graph_comm == sc_MPI_COMM_NULL) {
+    p4est_ghost_exchange_custom (p4est, ghost, data_size,
+                                 mirror_data, ghost_data);
+    return;
+  }
+  if (data_size == 0) {
     return;
   }
 
-  /* wait for receives and copy data into the proper result array */
-  peers = P4EST_ALLOC (int, exc->rrequests.elem_count);
-  expected = remaining = (int) exc->rrequests.elem_count;
-  while (remaining > 0) {
-    mpiret =
-      sc_MPI_Waitsome (expected, (sc_MPI_Request *) exc->rrequests.array,
-                       &received, peers, sc_MPI_STATUSES_IGNORE);
-    SC_CHECK_MPI (mpiret);
-    P4EST_ASSERT (received != sc_MPI_UNDEFINED);
-    P4EST_ASSERT (received > 0);
-    for (i = 0; i < received; ++i) {
-      P4EST_ASSERT (0 <= peers[i] &&
-                    peers[i] < (int) exc->rrequests.elem_count);
-      q = exc->qactive[peers[i]];
-      if (q >= 0) {
-        P4EST_ASSERT (q != p4est->mpirank && q < num_procs);
-        ng_excl = ghost->proc_offsets[q];
-        ng_incl = ghost->proc_offsets[q + 1];
-        ng = ng_incl - ng_excl;
-        P4EST_ASSERT (ng > 0);
-        /* run through ghosts to copy the matching level quadrants' data */
-        rbuf = (char **) sc_array_index_int (&exc->rbuffers, exc->qbuffer[q]);
-        for (lmatches = 0, theg = 0; theg < ng; ++theg) {
-          g = p4est_quadrant_array_index (&ghost->ghosts, ng_excl + theg);
-          if (minlevel <= (int) g->level && (int) g->level <= maxlevel) {
-            memcpy ((char *) exc->ghost_data + (ng_excl + theg) * data_size,
-                    *rbuf + lmatches * data_size, data_size);
-            ++lmatches;
-          }
-        }
-        P4EST_FREE (*rbuf);
-        exc->qactive[peers[i]] = -1;
-        exc->qbuffer[q] = -1;
-      }
+  /* counts and displacements follow the neighbor order used at creation */
+  sendcounts = P4EST_ALLOC (int, num_procs);
+  sdispls = P4EST_ALLOC (int, num_procs);
+  recvcounts = P4EST_ALLOC (int, num_procs);
+  rdispls = P4EST_ALLOC (int, num_procs);
+  nsrc = ndst = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng = ghost->proc_offsets[q + 1] - ghost->proc_offsets[q];
+    if (ng > 0) {
+      recvcounts[nsrc] = (int) (ng * data_size);
+      rdispls[nsrc] = (int) (ghost->proc_offsets[q] * data_size);
+      ++nsrc;
     }
-    remaining -= received;
+    ng = ghost->mirror_proc_offsets[q + 1] - ghost->mirror_proc_offsets[q];
+    if (ng > 0) {
+      sendcounts[ndst] = (int) (ng * data_size);
+      sdispls[ndst] = (int) (ghost->mirror_proc_offsets[q] * data_size);
+      ++ndst;
+    }
+  }
+
+  /* pack the mirror payload in mirror_proc_mirrors order */
+  ng_excl = 0;
+  sbuffer = mem =
+    P4EST_ALLOC (char, ghost->mirror_proc_offsets[num_procs] * data_size);
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->mirror_proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    for (theg = 0; theg < ng; ++theg) {
+      mirr = ghost->mirror_proc_mirrors[ng_excl + theg];
+      P4EST_ASSERT (0 <= mirr && (size_t) mirr < ghost->mirrors.elem_count);
+      memcpy (mem, mirror_data[mirr], data_size);
+      mem += data_size;
+    }
+    ng_excl = ng_incl;
+  }
+
+  /* one collective replaces the Isend/Irecv loops */
+  mpiret = MPI_Neighbor_alltoallv (sbuffer, sendcounts, sdispls, MPI_BYTE,
+                                   ghost_data, recvcounts, rdispls, MPI_BYTE,
+                                   graph_comm);
+  SC_CHECK_MPI (mpiret);
+
+  P4EST_FREE (sbuffer);
+  P4EST_FREE (sendcounts);
+  P4EST_FREE (sdispls);
+  P4EST_FREE (recvcounts);
+  P4EST_FREE (rdispls);
+#endif
+}
+
+void
+p4est_ghost_exchange_data_graph (p4est_t * p4est, p4est_ghost_t * ghost,
+                                 sc_MPI_Comm graph_comm, void *ghost_data)
+{
+  size_t              zz;
+  size_t              data_size;
+  p4est_topidx_t      which_tree;
+  p4est_locidx_t      which_quad;
+  p4est_quadrant_t   *mirror, *q;
+  p4est_tree_t       *tree;
+  void              **mirror_data;
+
+  /* gather the mirror payload pointers as in exchange_data_begin */
+  mirror_data = P4EST_ALLOC (void *, ghost->mirrors.elem_count);
+  data_size = p4est->data_size == 0 ? sizeof (void *) : p4est->data_size;
+  for (zz = 0; zz < ghost->mirrors.elem_count; ++zz) {
+    mirror = p4est_quadrant_array_index (&ghost->mirrors, zz);
+    which_tree = mirror->p.piggy3.which_tree;
+    tree = p4est_tree_array_index (p4est->trees, which_tree);
+    which_quad = mirror->p.piggy3.local_num - tree->quadrants_offset;
+    P4EST_ASSERT (0 <= which_quad &&
+                  which_quad < (p4est_locidx_t) tree->quadrants.elem_count);
+    q = p4est_quadrant_array_index (&tree->quadrants, which_quad);
+    mirror_data[zz] =
+      p4est->data_size == 0 ? &q->p.user_data : q->p.user_data;
   }
-  P4EST_FREE (peers);
-  P4EST_FREE (exc->qactive);
-  P4EST_FREE (exc->qbuffer);
-  sc_array_reset (&exc->rrequests);
-  sc_array_reset (&exc->rbuffers);
 
-  /* wait for sends and clean up */
-  mpiret = sc_MPI_Waitall (exc->requests.elem_count, (sc_MPI_Request *)
-                           exc->requests.array, sc_MPI_STATUSES_IGNORE);
-  SC_CHECK_MPI (mpiret);
-  sc_array_reset (&exc->requests);
-  for (zz = 0; zz < exc->sbuffers.elem_count; ++zz) {
-    sbuf = (char **) sc_array_index (&exc->sbuffers, zz);
-    P4EST_FREE (*sbuf);
-  }
-  sc_array_reset (&exc->sbuffers);
+  p4est_ghost_exchange_custom_graph (p4est, ghost, graph_comm, data_size,
+                                     mirror_data, ghost_data);
 
-  /* free temporary storage */
-  P4EST_FREE (exc);
+  P4EST_FREE (mirror_data);
 }
 
 #ifdef P4EST_ENABLE_MPI
@@ -2964,6 +5401,41 @@ p4est_ghost_expand_int (p4est_topidx_t t, p4est_quadrant_t * mq,
   sc_array_reset (&gview);
 }
 
+/** Query whether the subtree of a front mirror overlaps any range.
+ * The ranges are stored as pairs of quadrants; see
+ * \ref p4est_ghost_expand_ranges for the format.
+ */
+static int
+p4est_ghost_expand_range_hit (sc_array_t * ranges, p4est_topidx_t t,
+                              const p4est_quadrant_t * mq)
+{
+  size_t              zr;
+  p4est_quadrant_t    fd, ld, rfd, rld;
+  p4est_quadrant_t   *lq, *uq;
+
+  P4EST_ASSERT (ranges->elem_count % 2 == 0);
+
+  p4est_quadrant_first_descendant (mq, &fd, P4EST_QMAXLEVEL);
+  p4est_quadrant_last_descendant (mq, &ld, P4EST_QMAXLEVEL);
+
+  for (zr = 0; zr < ranges->elem_count; zr += 2) {
+    lq = p4est_quadrant_array_index (ranges, zr);
+    uq = p4est_quadrant_array_index (ranges, zr + 1);
+    P4EST_ASSERT (lq->p.which_tree == uq->p.which_tree);
+    if (lq->p.which_tree != t) {
+      continue;
+    }
+    p4est_quadrant_first_descendant (lq, &rfd, P4EST_QMAXLEVEL);
+    p4est_quadrant_last_descendant (uq, &rld, P4EST_QMAXLEVEL);
+    P4EST_ASSERT (p4est_quadrant_compare (&rfd, &rld) <= 0);
+    if (p4est_quadrant_compare (&ld, &rfd) >= 0 &&
+        p4est_quadrant_compare (&fd, &rld) <= 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 static int
 p4est_quadrant_compare_piggy_proc (const void *a, const void *b)
 {
@@ -2981,7 +5453,7 @@ p4est_quadrant_compare_piggy_proc (const void *a, const void *b)
 
 static void
 p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
-                             p4est_ghost_t * ghost)
+                             p4est_ghost_t * ghost, sc_array_t * ranges)
 {
 #ifdef P4EST_ENABLE_MPI
   int                 p;
@@ -3016,6 +5488,7 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
   sc_array_t         *tempquads2;
   sc_array_t         *temptrees2;
   sc_array_t         *npoints;
+  p4est_corner_resolver_t *cres;
   p4est_locidx_t     *ntq_offset = NULL;
   p4est_locidx_t     *node_to_quad = NULL;
   p4est_topidx_t     *node_to_tree = NULL;
@@ -3029,6 +5502,8 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
   tempquads2 = sc_array_new (sizeof (p4est_quadrant_t));
   temptrees2 = sc_array_new (sizeof (p4est_topidx_t));
   npoints = sc_array_new (sizeof (int));
+  /* cache the per tree corner transform sets across the mirror loop */
+  cres = p4est_corner_resolver_new (conn);
 
   /* if lnodes, build node_to_quad */
   if (lnodes) {
@@ -3303,6 +5778,12 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
 
       t = mq->p.piggy3.which_tree;
 
+      /* only probe the neighborhood of front mirrors inside the ranges;
+       * peers whose fronts all miss the ranges just exchange zero counts */
+      if (ranges != NULL && !p4est_ghost_expand_range_hit (ranges, t, mq)) {
+        continue;
+      }
+
       if (lnodes) {
         /* construct adjacency via lnodes */
         int                 v, vnodes = lnodes->vnodes;
@@ -3443,8 +5924,8 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
           nt = t;
 
           /* get the neighbors */
-          p4est_quadrant_corner_neighbor_extra (mq, t, c, tempquads2,
-                                                temptrees2, npoints, conn);
+          p4est_quadrant_corner_neighbor_resolve (cres, mq, t, c, tempquads2,
+                                                  temptrees2, npoints);
 
           /* for every neighbor */
           for (zz = 0; zz < tempquads2->elem_count; zz++) {
@@ -3475,6 +5956,7 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
   sc_array_destroy (tempquads);
   sc_array_destroy (temptrees);
   sc_array_destroy (tempquads2);
+  p4est_corner_resolver_destroy (cres);
   sc_array_destroy (temptrees2);
   sc_array_destroy (npoints);
 
@@ -3488,7 +5970,7 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
     }
 
     if (buf->elem_count) {
-      sc_array_sort (buf, p4est_quadrant_compare_piggy);
+      p4est_quadrant_array_sort (buf, p4est_quadrant_compare_piggy);
       sc_array_uniq (buf, p4est_quadrant_compare_piggy_proc);
     }
     send_counts[peer] = (p4est_locidx_t) buf->elem_count;
@@ -3720,7 +6202,7 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
     for (p = 0; p < mpisize; p++) {
       buf = (sc_array_t *) sc_array_index_int (send_bufs, p);
 
-      sc_array_sort (buf, p4est_quadrant_compare_piggy);
+      p4est_quadrant_array_sort (buf, p4est_quadrant_compare_piggy);
       sc_array_uniq (buf, p4est_quadrant_compare_piggy);
     }
 
@@ -3728,7 +6210,7 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
       /* update the ghost layer */
       sc_array_resize (ghost_layer,
                        (size_t) (old_num_ghosts + num_new_ghosts));
-      sc_array_sort (ghost_layer, p4est_quadrant_compare_piggy);
+      p4est_quadrant_array_sort (ghost_layer, p4est_quadrant_compare_piggy);
       sc_array_uniq (ghost_layer, p4est_quadrant_compare_piggy);
 
       num_new_ghosts = ghost_layer->elem_count - old_num_ghosts;
@@ -3781,7 +6263,7 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
               buf->array, buf->elem_count * buf->elem_size);
     }
   }
-  sc_array_sort (new_mirrors, p4est_quadrant_compare_piggy);
+  p4est_quadrant_array_sort (new_mirrors, p4est_quadrant_compare_piggy);
   sc_array_uniq (new_mirrors, p4est_quadrant_compare_piggy);
   new_num_mirrors = (p4est_locidx_t) new_mirrors->elem_count;
   P4EST_ASSERT (new_num_mirrors >= old_num_mirrors);
@@ -3882,6 +6364,9 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
   sc_array_copy (mirrors, new_mirrors);
   sc_array_destroy (new_mirrors);
 
+  /* the level-banded exchange cache refers to the old mirror lists */
+  p4est_ghost_level_cache_reset (ghost);
+
 #ifdef P4EST_ENABLE_DEBUG
   for (p = 0; p < mpisize; p++) {
     int                 ghost_count =
@@ -3904,14 +6389,141 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
 void
 p4est_ghost_expand (p4est_t * p4est, p4est_ghost_t * ghost)
 {
-  p4est_ghost_expand_internal (p4est, NULL, ghost);
+  p4est_ghost_expand_internal (p4est, NULL, ghost, NULL);
+}
+
+void
+p4est_ghost_expand_ranges (p4est_t * p4est, p4est_ghost_t * ghost,
+                           sc_array_t * ranges)
+{
+  P4EST_ASSERT (ranges != NULL &&
+                ranges->elem_size == sizeof (p4est_quadrant_t));
+  P4EST_ASSERT (ranges->elem_count % 2 == 0);
+
+  p4est_ghost_expand_internal (p4est, NULL, ghost, ranges);
+}
+
+p4est_ghost_t      *
+p4est_ghost_new_width (p4est_t * p4est, p4est_connect_type_t btype,
+                       int width)
+{
+  int                 k;
+  p4est_ghost_t      *gl;
+
+  P4EST_ASSERT (width >= 1);
+
+  gl = p4est_ghost_new_check (p4est, btype, P4EST_GHOST_UNBALANCED_ALLOW,
+                              P4EST_GHOST_BUILD_FULL, NULL, NULL);
+  for (k = 1; k < width; ++k) {
+    p4est_ghost_expand_internal (p4est, NULL, gl, NULL);
+  }
+
+  return gl;
 }
 
 void
 p4est_ghost_expand_by_lnodes (p4est_t * p4est, p4est_lnodes_t * lnodes,
                               p4est_ghost_t * ghost)
 {
-  p4est_ghost_expand_internal (p4est, lnodes, ghost);
+  p4est_ghost_expand_internal (p4est, lnodes, ghost, NULL);
+}
+
+/** Context for the split expansion; see \ref
+ * p4est_ghost_expand_by_lnodes_begin.  The last_* members fingerprint
+ * the previous expansion through this context. */
+struct p4est_ghost_expand_lnodes
+{
+  int                 pending;  /**< begin called, end outstanding */
+  int                 skip;     /**< pattern unchanged, end is a noop */
+  int                 have_last;        /**< last_* members are valid */
+  unsigned            last_checksum;    /**< sharers checksum */
+  long                last_revision;    /**< forest revision */
+  p4est_ghost_t      *last_ghost;       /**< ghost layer identity */
+  p4est_t            *p4est;
+  p4est_lnodes_t     *lnodes;
+  p4est_ghost_t      *ghost;
+};
+
+/** Checksum the communication pattern of an lnodes' sharers array. */
+static unsigned
+p4est_ghost_expand_lnodes_checksum (p4est_lnodes_t * lnodes)
+{
+  unsigned            hash = 2166136261U;
+  size_t              zr, zn;
+  p4est_lnodes_rank_t *lrank;
+
+  for (zr = 0; zr < lnodes->sharers->elem_count; ++zr) {
+    lrank = p4est_lnodes_rank_array_index (lnodes->sharers, zr);
+    hash ^= (unsigned) lrank->rank;
+    hash *= 16777619U;
+    hash ^= (unsigned) lrank->shared_nodes.elem_count;
+    hash *= 16777619U;
+    for (zn = 0; zn < lrank->shared_nodes.elem_count; ++zn) {
+      hash ^= (unsigned)
+        *(p4est_locidx_t *) sc_array_index (&lrank->shared_nodes, zn);
+      hash *= 16777619U;
+    }
+  }
+
+  return hash;
+}
+
+p4est_ghost_expand_lnodes_t *
+p4est_ghost_expand_lnodes_new (void)
+{
+  p4est_ghost_expand_lnodes_t *exp;
+
+  exp = P4EST_ALLOC_ZERO (p4est_ghost_expand_lnodes_t, 1);
+
+  return exp;
+}
+
+void
+p4est_ghost_expand_by_lnodes_begin (p4est_ghost_expand_lnodes_t * exp,
+                                    p4est_t * p4est,
+                                    p4est_lnodes_t * lnodes,
+                                    p4est_ghost_t * ghost)
+{
+  unsigned            checksum;
+
+  P4EST_ASSERT (exp != NULL && !exp->pending);
+  P4EST_ASSERT (lnodes != NULL);
+
+  /* an unchanged sharers pattern on the same ghost layer and forest
+   * revision means the previous expansion already did this work */
+  checksum = p4est_ghost_expand_lnodes_checksum (lnodes);
+  exp->skip = exp->have_last && exp->last_ghost == ghost &&
+    exp->last_revision == p4est->revision && exp->last_checksum == checksum;
+  exp->last_checksum = checksum;
+  exp->p4est = p4est;
+  exp->lnodes = lnodes;
+  exp->ghost = ghost;
+  exp->pending = 1;
+}
+
+void
+p4est_ghost_expand_by_lnodes_end (p4est_ghost_expand_lnodes_t * exp)
+{
+  P4EST_ASSERT (exp != NULL && exp->pending);
+
+  if (!exp->skip) {
+    p4est_ghost_expand_internal (exp->p4est, exp->lnodes, exp->ghost, NULL);
+  }
+  else {
+    P4EST_VERBOSE ("Skipping ghost expansion for unchanged sharers\n");
+  }
+  exp->last_revision = exp->p4est->revision;
+  exp->last_ghost = exp->ghost;
+  exp->have_last = 1;
+  exp->pending = 0;
+}
+
+void
+p4est_ghost_expand_lnodes_destroy (p4est_ghost_expand_lnodes_t * exp)
+{
+  P4EST_ASSERT (exp != NULL && !exp->pending);
+
+  P4EST_FREE (exp);
 }
 
 int
@@ -4069,3 +6681,640 @@ p4est_ghost_is_valid (p4est_t * p4est, p4est_ghost_t * ghost)
   P4EST_FREE (checksums_recv);
   return retval;
 }
+
+#if defined P4EST_ENABLE_MPI && defined MPI_VERSION && MPI_VERSION >= 3
+#define P4EST_GHOST_WINSHARED
+#endif
+
+/** The persistent state of the shared-window ghost data exchange. */
+struct p4est_ghost_shared
+{
+  p4est_t            *p4est;
+  p4est_ghost_t      *ghost;
+  size_t              data_size;        /**< bytes shipped per quadrant */
+#ifdef P4EST_GHOST_WINSHARED
+  MPI_Comm            intracomm;        /**< processes on the same node */
+  int                 intrasize;
+  int                 intrarank;
+  int                *node_peer;        /**< world rank to node rank, -1
+                                             for a different node */
+  p4est_locidx_t     *peer_start;       /**< start of this process' range
+                                             in each node peer's segment */
+  char              **peer_base;        /**< segment base per node peer */
+  char               *my_base;          /**< this process' segment */
+  MPI_Win             win;              /**< node-shared memory window */
+  /* mirrors shared by several ranks of a remote node are shipped once
+   * per node and fanned out through the node-shared receive window */
+  int                 my_leader;        /**< world rank of the node leader */
+  int                *node_id;          /**< world rank to its node leader */
+  int                 num_send_nodes;   /**< remote nodes with payload */
+  int                *send_node_leader; /**< leader world rank per node */
+  p4est_locidx_t     *send_node_offset; /**< offsets into the union lists */
+  p4est_locidx_t     *send_union_mirrors;       /**< concatenated unions of
+                                                     per-peer mirror lists */
+  char               *send_buf;         /**< packed union payloads */
+  int                 num_recv_senders; /**< remote senders of this node */
+  int                *recv_sender;      /**< their world ranks */
+  p4est_locidx_t     *recv_offset;      /**< offsets into the recv window */
+  p4est_locidx_t     *ghost_union_pos;  /**< per ghost the slot in the
+                                             recv window, -1 if the owner
+                                             shares this node */
+  char               *recv_base;        /**< the leader's receive segment */
+  MPI_Win             recv_win;         /**< node-shared receive window */
+#endif
+};
+
+#ifdef P4EST_GHOST_WINSHARED
+
+/** Locate the user data payload of one mirror quadrant. */
+static void        *
+p4est_ghost_shared_mirror_data (p4est_t * p4est, p4est_ghost_t * ghost,
+                                p4est_locidx_t mirr)
+{
+  p4est_topidx_t      which_tree;
+  p4est_locidx_t      which_quad;
+  p4est_quadrant_t   *mirror, *quad;
+  p4est_tree_t       *tree;
+
+  P4EST_ASSERT (0 <= mirr && (size_t) mirr < ghost->mirrors.elem_count);
+  mirror = p4est_quadrant_array_index (&ghost->mirrors, (size_t) mirr);
+  which_tree = mirror->p.piggy3.which_tree;
+  tree = p4est_tree_array_index (p4est->trees, which_tree);
+  which_quad = mirror->p.piggy3.local_num - tree->quadrants_offset;
+  quad = p4est_quadrant_array_index (&tree->quadrants, which_quad);
+
+  return p4est->data_size == 0 ? (void *) &quad->p.user_data :
+    quad->p.user_data;
+}
+
+/** Key identifying a quadrant of a known owner; ascending keys follow
+ * the tree-major Morton order of both mirror and ghost arrays. */
+static p4est_gloidx_t
+p4est_ghost_shared_quad_key (const p4est_quadrant_t * q)
+{
+  return ((p4est_gloidx_t) q->p.piggy3.which_tree << 32) |
+    (p4est_gloidx_t) (uint32_t) q->p.piggy3.local_num;
+}
+
+#endif /* P4EST_GHOST_WINSHARED */
+
+p4est_ghost_shared_t *
+p4est_ghost_shared_new (p4est_t * p4est, p4est_ghost_t * ghost)
+{
+  p4est_ghost_shared_t *sh;
+#ifdef P4EST_GHOST_WINSHARED
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 j, q, n;
+  int                 worldrank;
+  int                *wranks;
+  int                *nodeslot;
+  int                *keycounts, *keydispls, *cursor;
+  size_t              zz, zu, zt;
+  p4est_locidx_t     *sendstarts;
+  p4est_locidx_t     *gcounts, *gcounts_all;
+  p4est_locidx_t     *up;
+  p4est_locidx_t      g, cnt, lo, hi, mid;
+  p4est_gloidx_t     *mykeys, *allkeys, *tempkeys;
+  p4est_gloidx_t      key;
+  size_t              mykeycount, totalkeys;
+  sc_array_t         *usc;
+  MPI_Aint            winsize, qsize;
+  int                 qdisp;
+#endif
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+
+  sh = P4EST_ALLOC_ZERO (p4est_ghost_shared_t, 1);
+  sh->p4est = p4est;
+  sh->ghost = ghost;
+  sh->data_size =
+    p4est->data_size == 0 ? sizeof (void *) : p4est->data_size;
+
+#ifdef P4EST_GHOST_WINSHARED
+  /* group the processes that can map each other's memory */
+  mpiret = MPI_Comm_split_type (p4est->mpicomm, MPI_COMM_TYPE_SHARED,
+                                0, MPI_INFO_NULL, &sh->intracomm);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_size (sh->intracomm, &sh->intrasize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (sh->intracomm, &sh->intrarank);
+  SC_CHECK_MPI (mpiret);
+
+  /* map world ranks to node ranks */
+  worldrank = p4est->mpirank;
+  wranks = P4EST_ALLOC (int, sh->intrasize);
+  mpiret = MPI_Allgather (&worldrank, 1, MPI_INT, wranks, 1, MPI_INT,
+                          sh->intracomm);
+  SC_CHECK_MPI (mpiret);
+  sh->node_peer = P4EST_ALLOC (int, num_procs);
+  for (j = 0; j < num_procs; ++j) {
+    sh->node_peer[j] = -1;
+  }
+  for (j = 0; j < sh->intrasize; ++j) {
+    P4EST_ASSERT (0 <= wranks[j] && wranks[j] < num_procs);
+    sh->node_peer[wranks[j]] = j;
+  }
+
+  /* each process' segment holds all of its mirror payloads in
+   * mirror_proc_mirrors order, so the existing mirror_proc_offsets
+   * index into it */
+  winsize = (MPI_Aint) ghost->mirror_proc_offsets[num_procs] *
+    (MPI_Aint) sh->data_size;
+  mpiret = MPI_Win_allocate_shared (winsize, 1, MPI_INFO_NULL,
+                                    sh->intracomm, &sh->my_base, &sh->win);
+  SC_CHECK_MPI (mpiret);
+  sh->peer_base = P4EST_ALLOC (char *, sh->intrasize);
+  for (j = 0; j < sh->intrasize; ++j) {
+    mpiret = MPI_Win_shared_query (sh->win, j, &qsize, &qdisp,
+                                   &sh->peer_base[j]);
+    SC_CHECK_MPI (mpiret);
+  }
+
+  /* every node peer learns where its range starts in my segment */
+  sendstarts = P4EST_ALLOC (p4est_locidx_t, sh->intrasize);
+  for (j = 0; j < sh->intrasize; ++j) {
+    sendstarts[j] = ghost->mirror_proc_offsets[wranks[j]];
+  }
+  sh->peer_start = P4EST_ALLOC (p4est_locidx_t, sh->intrasize);
+  mpiret = MPI_Alltoall (sendstarts, 1, P4EST_MPI_LOCIDX,
+                         sh->peer_start, 1, P4EST_MPI_LOCIDX,
+                         sh->intracomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (sendstarts);
+
+  /* identify every process' node by the world rank of its node leader */
+  sh->my_leader = wranks[0];
+  P4EST_FREE (wranks);
+  sh->node_id = P4EST_ALLOC (int, num_procs);
+  mpiret = MPI_Allgather (&sh->my_leader, 1, MPI_INT, sh->node_id, 1,
+                          MPI_INT, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  /* union the mirror lists of the peers on each remote node so that a
+   * mirror shared by several of its ranks crosses the network once */
+  nodeslot = P4EST_ALLOC (int, num_procs);
+  for (j = 0; j < num_procs; ++j) {
+    nodeslot[j] = -1;
+  }
+  sh->send_node_leader = P4EST_ALLOC (int, num_procs);
+  sh->num_send_nodes = 0;
+  for (q = 0; q < num_procs; ++q) {
+    if (sh->node_peer[q] < 0 &&
+        ghost->mirror_proc_offsets[q] < ghost->mirror_proc_offsets[q + 1] &&
+        nodeslot[sh->node_id[q]] < 0) {
+      nodeslot[sh->node_id[q]] = sh->num_send_nodes;
+      sh->send_node_leader[sh->num_send_nodes++] = sh->node_id[q];
+    }
+  }
+  sh->send_node_leader = P4EST_REALLOC (sh->send_node_leader, int,
+                                        sh->num_send_nodes);
+  P4EST_FREE (nodeslot);
+  sh->send_node_offset = P4EST_ALLOC (p4est_locidx_t,
+                                      sh->num_send_nodes + 1);
+  sh->send_node_offset[0] = 0;
+  usc = sc_array_new (sizeof (p4est_locidx_t));
+  for (n = 0; n < sh->num_send_nodes; ++n) {
+    zt = usc->elem_count;
+    for (q = 0; q < num_procs; ++q) {
+      if (sh->node_peer[q] < 0 &&
+          sh->node_id[q] == sh->send_node_leader[n]) {
+        for (g = ghost->mirror_proc_offsets[q];
+             g < ghost->mirror_proc_offsets[q + 1]; ++g) {
+          *(p4est_locidx_t *) sc_array_push (usc) =
+            ghost->mirror_proc_mirrors[g];
+        }
+      }
+    }
+    /* sort and unique this node's concatenated mirror lists */
+    P4EST_ASSERT (usc->elem_count > zt);
+    up = (p4est_locidx_t *) sc_array_index (usc, zt);
+    qsort (up, usc->elem_count - zt, sizeof (p4est_locidx_t),
+           p4est_locidx_compare);
+    zu = 0;
+    for (zz = 0; zz < usc->elem_count - zt; ++zz) {
+      if (zz == 0 || up[zz] != up[zu - 1]) {
+        up[zu++] = up[zz];
+      }
+    }
+    sc_array_resize (usc, zt + zu);
+    sh->send_node_offset[n + 1] = (p4est_locidx_t) usc->elem_count;
+  }
+  sh->send_union_mirrors = P4EST_ALLOC (p4est_locidx_t, usc->elem_count);
+  memcpy (sh->send_union_mirrors, usc->array,
+          usc->elem_count * sizeof (p4est_locidx_t));
+  sc_array_destroy (usc);
+  sh->send_buf = P4EST_ALLOC (char, (size_t)
+                              sh->send_node_offset[sh->num_send_nodes] *
+                              sh->data_size);
+
+  /* all ranks of the node share the keys of their remote ghosts so
+   * each can derive the per-sender unions and its own slots in them */
+  gcounts = P4EST_ALLOC (p4est_locidx_t, num_procs);
+  mykeycount = 0;
+  for (q = 0; q < num_procs; ++q) {
+    gcounts[q] = ghost->proc_offsets[q + 1] - ghost->proc_offsets[q];
+    if (sh->node_peer[q] < 0) {
+      mykeycount += (size_t) gcounts[q];
+    }
+  }
+  gcounts_all = P4EST_ALLOC (p4est_locidx_t,
+                             (size_t) sh->intrasize * (size_t) num_procs);
+  mpiret = MPI_Allgather (gcounts, num_procs, P4EST_MPI_LOCIDX,
+                          gcounts_all, num_procs, P4EST_MPI_LOCIDX,
+                          sh->intracomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (gcounts);
+  mykeys = P4EST_ALLOC (p4est_gloidx_t, mykeycount);
+  zz = 0;
+  for (q = 0; q < num_procs; ++q) {
+    if (sh->node_peer[q] < 0) {
+      for (g = ghost->proc_offsets[q]; g < ghost->proc_offsets[q + 1]; ++g) {
+        mykeys[zz++] = p4est_ghost_shared_quad_key
+          (p4est_quadrant_array_index (&ghost->ghosts, (size_t) g));
+      }
+    }
+  }
+  P4EST_ASSERT (zz == mykeycount);
+  keycounts = P4EST_ALLOC (int, sh->intrasize);
+  keydispls = P4EST_ALLOC (int, sh->intrasize);
+  totalkeys = 0;
+  for (j = 0; j < sh->intrasize; ++j) {
+    cnt = 0;
+    for (q = 0; q < num_procs; ++q) {
+      if (sh->node_peer[q] < 0) {
+        cnt += gcounts_all[(size_t) j * (size_t) num_procs + q];
+      }
+    }
+    keycounts[j] = (int) cnt;
+    keydispls[j] = (int) totalkeys;
+    totalkeys += (size_t) cnt;
+  }
+  allkeys = P4EST_ALLOC (p4est_gloidx_t, totalkeys);
+  mpiret = MPI_Allgatherv (mykeys, (int) mykeycount, P4EST_MPI_GLOIDX,
+                           allkeys, keycounts, keydispls, P4EST_MPI_GLOIDX,
+                           sh->intracomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (mykeys);
+  P4EST_FREE (keycounts);
+
+  /* merge the node's key lists per remote sender */
+  cursor = keydispls;
+  sh->recv_sender = P4EST_ALLOC (int, num_procs);
+  sh->recv_offset = P4EST_ALLOC (p4est_locidx_t, num_procs + 1);
+  sh->recv_offset[0] = 0;
+  sh->ghost_union_pos = P4EST_ALLOC (p4est_locidx_t,
+                                     ghost->ghosts.elem_count);
+  memset (sh->ghost_union_pos, -1,
+          ghost->ghosts.elem_count * sizeof (p4est_locidx_t));
+  tempkeys = P4EST_ALLOC (p4est_gloidx_t, totalkeys);
+  sh->num_recv_senders = 0;
+  for (q = 0; q < num_procs; ++q) {
+    if (sh->node_peer[q] >= 0) {
+      continue;
+    }
+    zt = 0;
+    for (j = 0; j < sh->intrasize; ++j) {
+      cnt = gcounts_all[(size_t) j * (size_t) num_procs + q];
+      memcpy (tempkeys + zt, allkeys + cursor[j],
+              (size_t) cnt * sizeof (p4est_gloidx_t));
+      zt += (size_t) cnt;
+      cursor[j] += (int) cnt;
+    }
+    if (zt == 0) {
+      continue;
+    }
+    qsort (tempkeys, zt, sizeof (p4est_gloidx_t), p4est_gloidx_compare);
+    zu = 0;
+    for (zz = 0; zz < zt; ++zz) {
+      if (zz == 0 || tempkeys[zz] != tempkeys[zu - 1]) {
+        tempkeys[zu++] = tempkeys[zz];
+      }
+    }
+    n = sh->num_recv_senders;
+    sh->recv_sender[n] = q;
+    sh->recv_offset[n + 1] = sh->recv_offset[n] + (p4est_locidx_t) zu;
+    /* locate this rank's ghosts from q inside the union by bisection */
+    for (g = ghost->proc_offsets[q]; g < ghost->proc_offsets[q + 1]; ++g) {
+      key = p4est_ghost_shared_quad_key
+        (p4est_quadrant_array_index (&ghost->ghosts, (size_t) g));
+      lo = 0;
+      hi = (p4est_locidx_t) zu - 1;
+      while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (tempkeys[mid] < key) {
+          lo = mid + 1;
+        }
+        else {
+          hi = mid;
+        }
+      }
+      P4EST_ASSERT (tempkeys[lo] == key);
+      sh->ghost_union_pos[g] = sh->recv_offset[n] + lo;
+    }
+    ++sh->num_recv_senders;
+  }
+  P4EST_FREE (tempkeys);
+  P4EST_FREE (allkeys);
+  P4EST_FREE (keydispls);
+  P4EST_FREE (gcounts_all);
+  sh->recv_sender = P4EST_REALLOC (sh->recv_sender, int,
+                                   sh->num_recv_senders);
+  sh->recv_offset = P4EST_REALLOC (sh->recv_offset, p4est_locidx_t,
+                                   sh->num_recv_senders + 1);
+
+  /* the leader allocates the node's shared receive window */
+  winsize = sh->intrarank == 0 ?
+    (MPI_Aint) sh->recv_offset[sh->num_recv_senders] *
+    (MPI_Aint) sh->data_size : 0;
+  mpiret = MPI_Win_allocate_shared (winsize, 1, MPI_INFO_NULL,
+                                    sh->intracomm, &sh->recv_base,
+                                    &sh->recv_win);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Win_shared_query (sh->recv_win, 0, &qsize, &qdisp,
+                                 &sh->recv_base);
+  SC_CHECK_MPI (mpiret);
+#endif /* P4EST_GHOST_WINSHARED */
+
+  return sh;
+}
+
+void
+p4est_ghost_exchange_data_shared (p4est_ghost_shared_t * sh,
+                                  void *ghost_data)
+{
+#ifndef P4EST_GHOST_WINSHARED
+  /* without shared windows all ghosts go over the wire */
+  p4est_ghost_exchange_data (sh->p4est, sh->ghost, ghost_data);
+#else
+  p4est_t            *p4est = sh->p4est;
+  p4est_ghost_t      *ghost = sh->ghost;
+  const int           num_procs = p4est->mpisize;
+  const size_t        data_size = sh->data_size;
+  int                 mpiret;
+  int                 i, q, j;
+  p4est_locidx_t      ng_excl, ng_incl, ng, theg;
+  p4est_locidx_t      g, pos;
+  char               *mem;
+  sc_array_t          requests;
+  sc_MPI_Request     *r;
+
+  P4EST_ASSERT (sh->data_size ==
+                (p4est->data_size == 0 ? sizeof (void *) :
+                 p4est->data_size));
+
+  /* pack the mirror payloads read by the peers on this node */
+  for (q = 0; q < num_procs; ++q) {
+    if (sh->node_peer[q] < 0) {
+      continue;
+    }
+    mem = sh->my_base +
+      (size_t) ghost->mirror_proc_offsets[q] * data_size;
+    for (theg = ghost->mirror_proc_offsets[q];
+         theg < ghost->mirror_proc_offsets[q + 1]; ++theg) {
+      memcpy (mem, p4est_ghost_shared_mirror_data
+              (p4est, ghost, ghost->mirror_proc_mirrors[theg]), data_size);
+      mem += data_size;
+    }
+  }
+
+  /* pack every union payload once per destination node */
+  mem = sh->send_buf;
+  for (theg = 0; theg < sh->send_node_offset[sh->num_send_nodes]; ++theg) {
+    memcpy (mem, p4est_ghost_shared_mirror_data
+            (p4est, ghost, sh->send_union_mirrors[theg]), data_size);
+    mem += data_size;
+  }
+
+  /* all segments on the node must be packed before anyone reads them */
+  mpiret = MPI_Barrier (sh->intracomm);
+  SC_CHECK_MPI (mpiret);
+
+  /* inter-node payloads go over the wire once per node pair: the node
+   * leader receives the sender's union into the shared receive window */
+  sc_array_init (&requests, sizeof (sc_MPI_Request));
+  if (sh->intrarank == 0) {
+    for (i = 0; i < sh->num_recv_senders; ++i) {
+      r = (sc_MPI_Request *) sc_array_push (&requests);
+      mpiret = sc_MPI_Irecv (sh->recv_base +
+                             (size_t) sh->recv_offset[i] * data_size,
+                             (size_t) (sh->recv_offset[i + 1] -
+                                       sh->recv_offset[i]) * data_size,
+                             sc_MPI_BYTE, sh->recv_sender[i],
+                             P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+  for (i = 0; i < sh->num_send_nodes; ++i) {
+    r = (sc_MPI_Request *) sc_array_push (&requests);
+    mpiret = sc_MPI_Isend (sh->send_buf +
+                           (size_t) sh->send_node_offset[i] * data_size,
+                           (size_t) (sh->send_node_offset[i + 1] -
+                                     sh->send_node_offset[i]) * data_size,
+                           sc_MPI_BYTE, sh->send_node_leader[i],
+                           P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
+    SC_CHECK_MPI (mpiret);
+  }
+
+  /* same-node ghosts are read straight out of the peers' segments */
+  ng_excl = 0;
+  for (q = 0; q < num_procs; ++q) {
+    ng_incl = ghost->proc_offsets[q + 1];
+    ng = ng_incl - ng_excl;
+    P4EST_ASSERT (ng >= 0);
+    if (ng > 0 && (j = sh->node_peer[q]) >= 0) {
+      memcpy ((char *) ghost_data + ng_excl * data_size,
+              sh->peer_base[j] + sh->peer_start[j] * data_size,
+              ng * data_size);
+    }
+    ng_excl = ng_incl;
+  }
+
+  /* complete the remote messages */
+  mpiret = sc_MPI_Waitall (requests.elem_count, (sc_MPI_Request *)
+                           requests.array, sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (&requests);
+
+  /* the unions are complete once the leader's receives are in */
+  mpiret = MPI_Barrier (sh->intracomm);
+  SC_CHECK_MPI (mpiret);
+
+  /* fan the union payloads out of the node-shared receive window */
+  for (g = 0; g < (p4est_locidx_t) ghost->ghosts.elem_count; ++g) {
+    if ((pos = sh->ghost_union_pos[g]) >= 0) {
+      memcpy ((char *) ghost_data + (size_t) g * data_size,
+              sh->recv_base + (size_t) pos * data_size, data_size);
+    }
+  }
+
+  /* segments and the receive window may only be reused after every
+   * rank of the node has read its share */
+  mpiret = MPI_Barrier (sh->intracomm);
+  SC_CHECK_MPI (mpiret);
+#endif /* P4EST_GHOST_WINSHARED */
+}
+
+void
+p4est_ghost_shared_destroy (p4est_ghost_shared_t * sh)
+{
+#ifdef P4EST_GHOST_WINSHARED
+  int                 mpiret;
+
+  mpiret = MPI_Win_free (&sh->win);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Win_free (&sh->recv_win);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_free (&sh->intracomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (sh->node_peer);
+  P4EST_FREE (sh->peer_start);
+  P4EST_FREE (sh->peer_base);
+  P4EST_FREE (sh->node_id);
+  P4EST_FREE (sh->send_node_leader);
+  P4EST_FREE (sh->send_node_offset);
+  P4EST_FREE (sh->send_union_mirrors);
+  P4EST_FREE (sh->send_buf);
+  P4EST_FREE (sh->recv_sender);
+  P4EST_FREE (sh->recv_offset);
+  P4EST_FREE (sh->ghost_union_pos);
+#endif
+  P4EST_FREE (sh);
+}
+
+/** One slot of the read-only existence index. */
+typedef struct p4est_ghost_index_entry
+{
+  uint64_t            lid;      /**< linear id at the quadrant's level */
+  p4est_topidx_t      which_tree;
+  int8_t              level;
+  p4est_locidx_t      index;    /**< local or ghost number, -1 if free */
+}
+p4est_ghost_index_entry_t;
+
+/** The read-only existence index over local and ghost quadrants. */
+struct p4est_ghost_index
+{
+  p4est_locidx_t      num_local;        /**< local quadrant count */
+  size_t              mask;             /**< table size minus one */
+  p4est_ghost_index_entry_t *entries;
+};
+
+/** Scramble a quadrant key into a table position. */
+static size_t
+p4est_ghost_index_hash (p4est_topidx_t which_tree, int level, uint64_t lid)
+{
+  uint64_t            h;
+
+  h = lid ^ ((uint64_t) which_tree << 40) ^ ((uint64_t) level << 32);
+  h *= (uint64_t) 0x9E3779B97F4A7C15ULL;
+  h ^= h >> 32;
+
+  return (size_t) h;
+}
+
+/** Insert one quadrant into the table by linear probing. */
+static void
+p4est_ghost_index_insert (p4est_ghost_index_t * gidx,
+                          p4est_topidx_t which_tree,
+                          const p4est_quadrant_t * q, p4est_locidx_t index)
+{
+  const uint64_t      lid = p4est_quadrant_linear_id (q, (int) q->level);
+  size_t              zz;
+  p4est_ghost_index_entry_t *e;
+
+  zz = p4est_ghost_index_hash (which_tree, (int) q->level, lid) &
+    gidx->mask;
+  for (;;) {
+    e = gidx->entries + zz;
+    if (e->index == -1) {
+      e->lid = lid;
+      e->which_tree = which_tree;
+      e->level = q->level;
+      e->index = index;
+      return;
+    }
+    P4EST_ASSERT (e->lid != lid || e->which_tree != which_tree ||
+                  e->level != q->level);
+    zz = (zz + 1) & gidx->mask;
+  }
+}
+
+p4est_ghost_index_t *
+p4est_ghost_index_new (p4est_t * p4est, p4est_ghost_t * ghost)
+{
+  p4est_ghost_index_t *gidx;
+  p4est_locidx_t      lq, il;
+  p4est_topidx_t      tt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+  size_t              count, table_size, zz;
+
+  lq = p4est->local_num_quadrants;
+  count = (size_t) lq + ghost->ghosts.elem_count;
+
+  /* a power-of-two table at most half full keeps the probes short */
+  table_size = 16;
+  while (table_size < 2 * count) {
+    table_size <<= 1;
+  }
+
+  gidx = P4EST_ALLOC (p4est_ghost_index_t, 1);
+  gidx->num_local = lq;
+  gidx->mask = table_size - 1;
+  gidx->entries = P4EST_ALLOC (p4est_ghost_index_entry_t, table_size);
+  for (zz = 0; zz < table_size; ++zz) {
+    gidx->entries[zz].index = -1;
+  }
+
+  /* index the local quadrants by cumulative number */
+  il = 0;
+  for (tt = p4est->first_local_tree; tt <= p4est->last_local_tree; ++tt) {
+    tree = p4est_tree_array_index (p4est->trees, tt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      p4est_ghost_index_insert (gidx, tt, q, il++);
+    }
+  }
+  P4EST_ASSERT (il == lq);
+
+  /* index the ghost quadrants shifted by the local count */
+  for (zz = 0; zz < ghost->ghosts.elem_count; ++zz) {
+    q = p4est_quadrant_array_index (&ghost->ghosts, zz);
+    p4est_ghost_index_insert (gidx, q->p.piggy3.which_tree, q,
+                              lq + (p4est_locidx_t) zz);
+  }
+
+  return gidx;
+}
+
+p4est_locidx_t
+p4est_ghost_index_lookup (const p4est_ghost_index_t * gidx,
+                          p4est_topidx_t which_tree,
+                          const p4est_quadrant_t * q)
+{
+  const uint64_t      lid = p4est_quadrant_linear_id (q, (int) q->level);
+  size_t              zz;
+  const p4est_ghost_index_entry_t *e;
+
+  zz = p4est_ghost_index_hash (which_tree, (int) q->level, lid) &
+    gidx->mask;
+  for (;;) {
+    e = gidx->entries + zz;
+    if (e->index == -1) {
+      return -1;
+    }
+    if (e->lid == lid && e->which_tree == which_tree &&
+        e->level == q->level) {
+      return e->index;
+    }
+    zz = (zz + 1) & gidx->mask;
+  }
+}
+
+void
+p4est_ghost_index_destroy (p4est_ghost_index_t * gidx)
+{
+  P4EST_FREE (gidx->entries);
+  P4EST_FREE (gidx);
+}
@@ -75,6 +75,28 @@ typedef struct
   p4est_locidx_t     *mirror_proc_front_offsets;        /**< NULL until
                                                            p4est_ghost_expand is
                                                            called */
+
+  p4est_locidx_t     *mirror_proc_by_level;     /**< entries of
+                                                   mirror_proc_mirrors
+                                                   regrouped stably by
+                                                   quadrant level within each
+                                                   rank; NULL until the first
+                                                   level-banded data exchange
+                                                   builds it */
+  p4est_locidx_t     *mirror_proc_level_offsets;        /**< for each rank,
+                                                   P4EST_QMAXLEVEL + 2
+                                                   indices into
+                                                   mirror_proc_by_level; NULL
+                                                   with the above */
+  p4est_locidx_t     *ghost_proc_by_level;      /**< ghost indices regrouped
+                                                   stably by quadrant level
+                                                   within each rank; NULL
+                                                   with the above */
+  p4est_locidx_t     *ghost_proc_level_offsets; /**< for each rank,
+                                                   P4EST_QMAXLEVEL + 2
+                                                   indices into
+                                                   ghost_proc_by_level; NULL
+                                                   with the above */
 }
 p4est_ghost_t;
 
@@ -131,6 +153,151 @@ int                 p4est_quadrant_find_owner (p4est_t * p4est,
 p4est_ghost_t      *p4est_ghost_new (p4est_t * p4est,
                                      p4est_connect_type_t btype);
 
+/** Callback to choose the ghost connect type of an individual quadrant.
+ * It is called once per local quadrant on the parallel boundary, so it
+ * may decide per tree or per Morton range without noticeable overhead.
+ * \param [in] p4est        The forest whose ghost layer is being built.
+ * \param [in] which_tree   Tree of the quadrant under consideration.
+ * \param [in] quadrant     A local quadrant on the parallel boundary.
+ * \return                  Connect type for this quadrant; must be at
+ *                          least \ref P4EST_CONNECT_FACE and at most
+ *                          the \a btype of the overall construction.
+ */
+typedef p4est_connect_type_t (*p4est_ghost_connect_fn_t) (p4est_t * p4est,
+                                                          p4est_topidx_t
+                                                          which_tree,
+                                                          p4est_quadrant_t *
+                                                          quadrant);
+
+/** Builds a ghost layer with a per-quadrant choice of connect type.
+ * Behaves like \ref p4est_ghost_new, except that for every local
+ * quadrant on the parallel boundary the callback may lower the connect
+ * type below \a btype, e.g. to send corner ghosts only where a wider
+ * stencil is active and pay face-only communication elsewhere.  The
+ * decision is made on the sending side, so no symmetry of the callback
+ * between processes is required.  The resulting layer reports \a btype
+ * as its p4est_ghost_t::btype.
+ * \param [in] p4est        The forest for which the ghost layer will be
+ *                          generated.
+ * \param [in] btype        Maximum connect type; used verbatim where
+ *                          \a connect_fn is NULL.
+ * \param [in] connect_fn   Callback selecting the connect type per
+ *                          quadrant, or NULL for \ref p4est_ghost_new.
+ * \return                  A fully initialized ghost layer.
+ */
+p4est_ghost_t      *p4est_ghost_new_select (p4est_t * p4est,
+                                            p4est_connect_type_t btype,
+                                            p4est_ghost_connect_fn_t
+                                            connect_fn);
+
+/** Selection of the sides of a ghost layer to construct. */
+typedef enum p4est_ghost_build
+{
+  P4EST_GHOST_BUILD_GHOSTS = 0x01,      /**< receive the ghost quadrants */
+  P4EST_GHOST_BUILD_MIRRORS = 0x02,     /**< record the mirror structure */
+  P4EST_GHOST_BUILD_FULL = 0x03         /**< both; as \ref p4est_ghost_new */
+}
+p4est_ghost_build_t;
+
+/** Builds one or both sides of the ghost layer.
+ * Behaves like \ref p4est_ghost_new when \a build is
+ * \ref P4EST_GHOST_BUILD_FULL.  With \ref P4EST_GHOST_BUILD_GHOSTS the
+ * mirror structure (mirrors, mirror_proc_mirrors, mirror_proc_fronts)
+ * is left empty, which roughly halves the memory of the layer.  With
+ * \ref P4EST_GHOST_BUILD_MIRRORS the ghost quadrant array stays empty
+ * and no messages are exchanged at all, since the mirrors are defined
+ * entirely on the sender.
+ * This function is collective and \a build must be the same on every
+ * process.  A partial layer must not be passed to functions that rely
+ * on the missing side, in particular not to \ref p4est_ghost_expand.
+ * \param [in] p4est   The forest for which the ghost layer is generated.
+ * \param [in] btype   Which ghosts to include (across face, corner or full).
+ * \param [in] build   Bitwise OR of p4est_ghost_build_t flags; at least
+ *                     one side must be selected.
+ * \return             A ghost layer holding the selected sides.
+ */
+p4est_ghost_t      *p4est_ghost_new_build (p4est_t * p4est,
+                                           p4est_connect_type_t btype,
+                                           int build);
+
+/** Transient storage for a split ghost layer construction. */
+typedef struct p4est_ghost_new_context p4est_ghost_new_t;
+
+/** Begin building a ghost layer without waiting for its completion.
+ * The local parallel boundary is determined and all messages are posted,
+ * but the receipt of the ghost quadrants is not waited for, so the
+ * caller may overlap local computation with the communication.
+ * The arguments are identical to \ref p4est_ghost_new.
+ * \return          Transient storage for messages in progress; it must
+ *                  be passed to \ref p4est_ghost_new_end.
+ */
+p4est_ghost_new_t  *p4est_ghost_new_begin (p4est_t * p4est,
+                                           p4est_connect_type_t btype);
+
+/** Complete a split ghost layer construction.
+ * This function waits for all pending MPI communication and assembles
+ * the final offset arrays of the layer.
+ * \param [in,out] gnc  Data created ONLY by p4est_ghost_new_begin.
+ *                      It is deallocated before this function returns.
+ * \return              A fully initialized ghost layer.
+ */
+p4est_ghost_t      *p4est_ghost_new_end (p4est_ghost_new_t * gnc);
+
+/** Build the ghost layers of a hierarchy of forests in one shot.
+ * All levels are begun with \ref p4est_ghost_new_begin before any is
+ * completed, so the local boundary scan of each level overlaps the
+ * message traffic of the levels started before it and all levels'
+ * ghost loads are in flight together.  This cuts the exposed latency
+ * of building a multigrid hierarchy's ghost layers from one round per
+ * level to roughly a single round.
+ * \param [in] nlevels  Number of forests in the hierarchy; at least 1.
+ * \param [in] forests  Array of \a nlevels valid forests, typically a
+ *                      fine forest and its successive coarsenings.
+ *                      All must live on the same communicator.
+ * \param [in] btype    Which ghosts to include for every level.
+ * \param [out] ghosts  On output, \a ghosts[i] is a fully initialized
+ *                      ghost layer of \a forests[i].
+ */
+void                p4est_ghost_new_hierarchy (int nlevels,
+                                               p4est_t * forests[],
+                                               p4est_connect_type_t btype,
+                                               p4est_ghost_t * ghosts[]);
+
+/** Build a ghost layer that is multiple elements deep.
+ * Each ring beyond the first is only known once the quadrants of the
+ * previous ring have been received, so the halo grows by communication
+ * rounds internally; this entry point drives them in one call and is
+ * the preferred way to obtain the k-deep halos used by wide stencils.
+ * \param [in] p4est   The forest for which the ghost layer is generated.
+ * \param [in] btype   Which ghosts to include (across face, corner or full).
+ * \param [in] width   Depth of the halo in layers of adjacency; must be
+ *                     at least 1.  With 1 this is \ref p4est_ghost_new.
+ * \return             A fully initialized ghost layer of the given width.
+ */
+p4est_ghost_t      *p4est_ghost_new_width (p4est_t * p4est,
+                                           p4est_connect_type_t btype,
+                                           int width);
+
+/** Bring a ghost layer up to date after refinement or coarsening.
+ *
+ * If the adaptation did not touch the parallel boundary on any processor,
+ * the quadrant sets of the layer are still correct and only the cumulative
+ * local numbers stored in the piggy data are refreshed by a point-to-point
+ * exchange that reuses the existing communication pattern.  Otherwise the
+ * layer is destroyed and rebuilt from scratch.  This function must not be
+ * used across a repartition of the forest.
+ *
+ * \param [in] p4est            The forest after adaptation; it must match
+ *                              the partition \a ghost was built for.
+ * \param [in,out] ghost        A ghost layer previously built for an
+ *                              earlier adaptation state of \a p4est.  It is
+ *                              either updated in place or destroyed.
+ * \return                      The updated ghost layer, which is \a ghost
+ *                              itself unless a rebuild was necessary.
+ */
+p4est_ghost_t      *p4est_ghost_update (p4est_t * p4est,
+                                        p4est_ghost_t * ghost);
+
 /** Frees all memory used for the ghost layer. */
 void                p4est_ghost_destroy (p4est_ghost_t * ghost);
 
@@ -218,6 +385,41 @@ int                 p4est_quadrant_exists (p4est_t * p4est,
                                            sc_array_t * rproc_arr,
                                            sc_array_t * rquad_arr);
 
+/** Opaque read-only index over the local and ghost quadrants.
+ * The index is an open-addressing hash table keyed by tree, level and
+ * linear id.  It is built once and never modified afterwards, so any
+ * number of threads may query it concurrently without locking.
+ */
+typedef struct p4est_ghost_index p4est_ghost_index_t;
+
+/** Build the existence index over a forest and its ghost layer.
+ * The index matches quadrants exactly by tree, level and position; it
+ * does not answer the overlap queries of \ref p4est_quadrant_exists.
+ * It stays valid until the forest or the ghost layer changes.
+ * \return          An index to query with \ref p4est_ghost_index_lookup,
+ *                  to be freed with \ref p4est_ghost_index_destroy.
+ */
+p4est_ghost_index_t *p4est_ghost_index_new (p4est_t * p4est,
+                                            p4est_ghost_t * ghost);
+
+/** Look up one quadrant in the existence index.
+ * This function only reads the index and is safe to call from many
+ * threads at the same time.
+ * \param [in] which_tree   The tree the quadrant is searched in.
+ * \param [in] q            The quadrant searched by level and position.
+ * \return                  The cumulative number for a local quadrant,
+ *                          the ghost number shifted up by the local
+ *                          quadrant count for a ghost, and -1 if the
+ *                          quadrant is neither local nor a ghost.
+ */
+p4est_locidx_t      p4est_ghost_index_lookup (const p4est_ghost_index_t *
+                                              gidx,
+                                              p4est_topidx_t which_tree,
+                                              const p4est_quadrant_t * q);
+
+/** Free the memory of an existence index. */
+void                p4est_ghost_index_destroy (p4est_ghost_index_t * gidx);
+
 /** Check a forest to see if it is balanced.
  *
  * This function builds the ghost layer and discards it when done.
@@ -237,6 +439,15 @@ int                 p4est_is_balanced (p4est_t * p4est,
 unsigned            p4est_ghost_checksum (p4est_t * p4est,
                                           p4est_ghost_t * ghost);
 
+/** Request huge page backing for the quadrant arrays of a ghost layer.
+ * Advises the kernel to back the ghost and mirror arrays with
+ * transparent huge pages where the system supports it; see
+ * \ref p4est_advise_hugepages for the tree storage counterpart.
+ * A no-op where unsupported.
+ * \param [in,out] ghost    The ghost layer; its storage is advised.
+ */
+void                p4est_ghost_advise_hugepages (p4est_ghost_t * ghost);
+
 /** Transfer data for local quadrants that are ghosts to other processors.
  * Send the data stored in the quadrant's user_data.  This is either the
  * pointer variable itself if \c p4est->data_size is 0, or the content of
@@ -252,6 +463,25 @@ void                p4est_ghost_exchange_data (p4est_t * p4est,
                                                p4est_ghost_t * ghost,
                                                void *ghost_data);
 
+/** Callback to unpack received ghost payload into application storage.
+ * It is invoked once per sending process with the contiguous range of
+ * ghost quadrants owned by that process, in ascending rank order.
+ * \param [in] sender       The rank that owns the quadrants of the range.
+ * \param [in] ghost_first  Index of the first ghost of the range within
+ *                          the ghosts array of the layer.
+ * \param [in] ghost_count  Number of ghosts in the range; positive.
+ * \param [in] data         Their payload, \a ghost_count entries of the
+ *                          exchange's data size back to back.  The buffer
+ *                          is freed after the callback returns.
+ * \param [in,out] user     The pointer registered with the exchange.
+ */
+typedef void        (*p4est_ghost_unpack_t) (p4est_t * p4est,
+                                             p4est_ghost_t * ghost,
+                                             int sender,
+                                             p4est_locidx_t ghost_first,
+                                             p4est_locidx_t ghost_count,
+                                             const void *data, void *user);
+
 /** Transient storage for asynchronous ghost exchange. */
 typedef struct p4est_ghost_exchange
 {
@@ -262,6 +492,8 @@ typedef struct p4est_ghost_exchange
   int                 minlevel, maxlevel;       /**< Meaningful with is_levels */
   size_t              data_size;
   void               *ghost_data;
+  p4est_ghost_unpack_t unpack_fn;       /**< Scatter receives, else NULL */
+  void               *unpack_user;      /**< Passed through to unpack_fn */
   int                *qactive, *qbuffer;
   sc_array_t          requests, sbuffers;
   sc_array_t          rrequests, rbuffers;
@@ -326,10 +558,82 @@ p4est_ghost_exchange_t *p4est_ghost_exchange_custom_begin
 void                p4est_ghost_exchange_custom_end
   (p4est_ghost_exchange_t * exc);
 
+/** Transfer custom per-quadrant data and scatter it on arrival.
+ * The send side is identical to \ref p4est_ghost_exchange_custom.  On
+ * the receive side there is no contiguous ghost_data array: the payload
+ * of each sending process is handed to \a unpack_fn together with its
+ * ghost index range, so the application places the values directly into
+ * its own arrays and saves one full copy of the ghost payload.
+ * \param [in] mirror_data  One data pointer per mirror quadrant as input.
+ * \param [in] unpack_fn    Called once per sending process; see
+ *                          \ref p4est_ghost_unpack_t.
+ * \param [in,out] user     Arbitrary pointer passed to \a unpack_fn.
+ */
+void                p4est_ghost_exchange_custom_scatter
+  (p4est_t * p4est, p4est_ghost_t * ghost, size_t data_size,
+   void **mirror_data, p4est_ghost_unpack_t unpack_fn, void *user);
+
+/** Begin an asynchronous scattering ghost data exchange.
+ * The arguments are identical to p4est_ghost_exchange_custom_scatter.
+ * The mirror data can be safely discarded right after this function returns
+ * since it is copied into internal send buffers.
+ * \return          Transient storage for messages in progress; it must
+ *                  be passed to p4est_ghost_exchange_custom_scatter_end.
+ */
+p4est_ghost_exchange_t *p4est_ghost_exchange_custom_scatter_begin
+  (p4est_t * p4est, p4est_ghost_t * ghost, size_t data_size,
+   void **mirror_data, p4est_ghost_unpack_t unpack_fn, void *user);
+
+/** Complete an asynchronous scattering ghost data exchange.
+ * This function waits for all pending MPI communications and then runs
+ * the registered unpack callback once per sending process.
+ * \param [in,out] exc  Created ONLY by
+ *                      p4est_ghost_exchange_custom_scatter_begin.
+ *                      It is deallocated before this function returns.
+ */
+void                p4est_ghost_exchange_custom_scatter_end
+  (p4est_ghost_exchange_t * exc);
+
+/** Transfer data for an active subset of the mirror quadrants only.
+ * Like \ref p4est_ghost_exchange_custom, but each message carries only
+ * the mirrors currently flagged active together with their positions,
+ * so the exchange volume scales with the active fraction instead of
+ * the full layer.  Intended for solvers where only a small, slowly
+ * changing set of quadrants holds meaningful data each step.  No
+ * separate bitmap round is needed: the active positions travel inside
+ * the payload message, so the flags may change every call for free.
+ * \param [in] p4est            The forest used for reference.
+ * \param [in] ghost            The ghost layer used for reference.
+ * \param [in] data_size        The data size to transfer per quadrant.
+ * \param [in] mirror_active    One flag per mirror quadrant; only
+ *                              mirrors with a nonzero flag are sent.
+ * \param [in] mirror_data      One data pointer per mirror quadrant as
+ *                              in \ref p4est_ghost_exchange_custom;
+ *                              only active entries are dereferenced.
+ * \param [in,out] ghost_data   Contiguous storage for all ghosts as in
+ *                              \ref p4est_ghost_exchange_custom; only
+ *                              the entries of active ghosts are
+ *                              overwritten.
+ * \param [out] ghost_active    One flag per ghost quadrant; set to 1
+ *                              exactly for the ghosts whose data was
+ *                              received in this call.
+ */
+void                p4est_ghost_exchange_active (p4est_t * p4est,
+                                                 p4est_ghost_t * ghost,
+                                                 size_t data_size,
+                                                 const int8_t *
+                                                 mirror_active,
+                                                 void **mirror_data,
+                                                 void *ghost_data,
+                                                 int8_t * ghost_active);
+
 /** Transfer data for local quadrants that are ghosts to other processors.
  * The data size is the same for all quadrants and can be chosen arbitrarily.
  * This function restricts the transfer to a range of refinement levels.
  * The memory for quadrants outside the level range is not dereferenced.
+ * The first restricted call builds a per-level index cache inside the
+ * ghost layer, so repeated banded exchanges only touch the quadrants
+ * whose levels match.
  * \param [in] p4est            The forest used for reference.
  * \param [in] ghost            The ghost layer used for reference.
  * \param [in] minlevel         Level of the largest quads to be exchanged.
@@ -373,6 +677,392 @@ p4est_ghost_exchange_t *p4est_ghost_exchange_custom_levels_begin
 void                p4est_ghost_exchange_custom_levels_end
   (p4est_ghost_exchange_t * exc);
 
+/** Transfer ghost data without staging it through a pack buffer.
+ * The mirror payload must live in one contiguous array holding
+ * \a data_size bytes per mirror quadrant, in mirror array order.  The
+ * sends are described by MPI indexed datatypes over that array, so no
+ * send-side copy is made; receives fill \a ghost_data contiguously as
+ * in \ref p4est_ghost_exchange_data.  This saves time and transient
+ * memory for large per-quadrant payloads.
+ * \param [in]  mirror_data  Contiguous payload of all mirror quadrants.
+ * \param [out] ghost_data   Receives the payload of all ghosts.
+ */
+void                p4est_ghost_exchange_indexed (p4est_t * p4est,
+                                                  p4est_ghost_t * ghost,
+                                                  size_t data_size,
+                                                  const void *mirror_data,
+                                                  void *ghost_data);
+
+/** Combine one incoming contribution into a quadrant's payload.
+ * \param [in,out] dest     Payload of the owned (mirror) quadrant.
+ * \param [in] src          One received contribution.
+ * \param [in] data_size    The payload size in bytes.
+ */
+typedef void        (*p4est_ghost_combine_t) (void *dest, const void *src,
+                                              size_t data_size);
+
+/** Accumulate the ghost copies of every quadrant into its owner's data.
+ * This runs the pattern of \ref p4est_ghost_exchange_custom in reverse:
+ * every process returns its local copy of each ghost quadrant to the
+ * owning process, which folds the contributions into the mirror's
+ * payload by calling \a combine_fn once per received copy.  Use it to
+ * complete sums, minima, or maxima accumulated redundantly on ghosts.
+ * \param [in] mirror_data  One pointer per mirror quadrant as in
+ *                          \ref p4est_ghost_exchange_custom; the data
+ *                          behind them is updated in place.
+ * \param [in] ghost_data   Contiguous local ghost payload to send back.
+ * \param [in] combine_fn   Called on the owner for every contribution;
+ *                          the arrival order is not deterministic, so
+ *                          it must be associative and commutative.
+ */
+void                p4est_ghost_exchange_reduce (p4est_t * p4est,
+                                                 p4est_ghost_t * ghost,
+                                                 size_t data_size,
+                                                 void **mirror_data,
+                                                 const void *ghost_data,
+                                                 p4est_ghost_combine_t
+                                                 combine_fn);
+
+/** Precomputed plan for repeated ghost data exchanges on a fixed layer.
+ * The plan pins the receive addresses inside a fixed ghost data array
+ * and an internal send buffer, so the messages can use MPI persistent
+ * requests and skip per-call setup.  It stays valid until the forest or
+ * the ghost layer changes, at which point it must be destroyed.
+ */
+typedef struct p4est_ghost_exchange_plan
+{
+  p4est_t            *p4est;
+  p4est_ghost_t      *ghost;
+  size_t              data_size;
+  void               *ghost_data;       /**< fixed receive array */
+  char               *sbuffer;          /**< fixed packed send buffer */
+  char               *rbuffer;          /**< receive staging, symmetric
+                                             plans only */
+  p4est_ghost_combine_t combine_fn;     /**< NULL for plans that only
+                                             replicate */
+  int                 num_requests;
+  sc_MPI_Request     *requests;         /**< persistent requests */
+  int                 num_partitions;   /**< requested send partitions
+                                             per peer; 0 for plans that
+                                             run through the go call */
+  int                 num_send_peers;   /**< peers with nonempty sends */
+  p4est_locidx_t     *send_offsets;     /**< num_send_peers + 1 offsets
+                                             into the packed sequence */
+  int                *send_parts;       /**< partitions per send peer */
+  int                *send_done;        /**< partitions marked so far */
+  p4est_locidx_t      ready_mirrors;    /**< packed mirror copies */
+  sc_MPI_Request     *send_requests;    /**< aliases into \a requests */
+}
+p4est_ghost_exchange_plan_t;
+
+/** Create a persistent-communication plan for ghost data exchanges.
+ * The arguments are identical to \ref p4est_ghost_exchange_data except
+ * that \a data_size is explicit and \a ghost_data must remain the same
+ * array for the lifetime of the plan.
+ * \return          A plan to be passed to p4est_ghost_exchange_plan_go.
+ */
+p4est_ghost_exchange_plan_t *p4est_ghost_exchange_plan_new
+  (p4est_t * p4est, p4est_ghost_t * ghost, size_t data_size,
+   void *ghost_data);
+
+/** Create a plan that runs replication and reduction in one round.
+ * Each pairwise message carries the mirror payload and the returning
+ * ghost contributions back to back, so a symmetric update costs half
+ * the messages of following \ref p4est_ghost_exchange_plan_go with
+ * \ref p4est_ghost_exchange_reduce.  Executing the plan sends the
+ * quadrant payload together with the current contents of
+ * \a ghost_data, then overwrites \a ghost_data with the owners' fresh
+ * payload and folds the received contributions into the local
+ * quadrants with \a combine_fn.  The replicated values are those
+ * before any contribution is applied.
+ * \return          A plan to be passed to p4est_ghost_exchange_plan_go.
+ */
+p4est_ghost_exchange_plan_t *p4est_ghost_exchange_plan_symmetric_new
+  (p4est_t * p4est, p4est_ghost_t * ghost, size_t data_size,
+   void *ghost_data, p4est_ghost_combine_t combine_fn);
+
+/** Create a plan whose sends use MPI-4 partitioned communication.
+ * The messages are the same as in \ref p4est_ghost_exchange_plan_new,
+ * but each send is split into up to \a num_partitions equal partitions
+ * of whole quadrants.  A solver that fills the mirror payload in
+ * pieces, such as one stage of a Runge-Kutta step at a time, marks
+ * each finished range with \ref p4est_ghost_exchange_plan_ready and
+ * lets the fabric aggregate and transfer it while the remaining ranges
+ * are still being computed.  Built against an MPI library before
+ * version 4 the plan degrades to ordinary persistent requests that
+ * start once the buffer is complete; the calling sequence is the same.
+ * \param [in] num_partitions   Upper bound on the partitions per peer
+ *                              message; at least 1.
+ * \return          A plan to be driven by the start, ready, and
+ *                  complete calls below instead of the go call.
+ */
+p4est_ghost_exchange_plan_t *p4est_ghost_exchange_plan_partitioned_new
+  (p4est_t * p4est, p4est_ghost_t * ghost, size_t data_size,
+   void *ghost_data, int num_partitions);
+
+/** Activate the requests of a partitioned plan for one exchange round.
+ * Must be called before the first \ref p4est_ghost_exchange_plan_ready
+ * of the round and before any mirror data is packed.
+ */
+void                p4est_ghost_exchange_plan_start
+  (p4est_ghost_exchange_plan_t * plan);
+
+/** Pack a range of mirror copies and mark its partitions ready.
+ * The range counts entries of the packed send sequence, that is,
+ * indices into the mirror_proc_mirrors array of the ghost layer, and
+ * must continue exactly where the previous call of the round left off.
+ * The payload of the referenced quadrants is read at the time of this
+ * call, so it must be final for the marked range.
+ * \param [in] mirror_first  First packed entry of the range; equal to
+ *                           the accumulated count of earlier calls.
+ * \param [in] mirror_count  Number of entries that are now final.
+ */
+void                p4est_ghost_exchange_plan_ready
+  (p4est_ghost_exchange_plan_t * plan, p4est_locidx_t mirror_first,
+   p4est_locidx_t mirror_count);
+
+/** Finish one exchange round of a partitioned plan.
+ * Any mirror copies not yet marked ready are packed and marked now,
+ * then the call waits for all sends and receives of the round.  On
+ * return the ghost data array is current and the plan may start the
+ * next round.
+ */
+void                p4est_ghost_exchange_plan_complete
+  (p4est_ghost_exchange_plan_t * plan);
+
+/** Execute one ghost data exchange according to a plan.
+ * Packs the current mirror payload, starts the persistent requests,
+ * and waits for their completion.
+ */
+void                p4est_ghost_exchange_plan_go
+  (p4est_ghost_exchange_plan_t * plan);
+
+/** Free the persistent requests and buffers of an exchange plan. */
+void                p4est_ghost_exchange_plan_destroy
+  (p4est_ghost_exchange_plan_t * plan);
+
+/** Gather plan describing the packed send layout of a ghost exchange.
+ * Entry \a k of the packed send buffer is filled from the local quadrant
+ * with cumulative index indices[k], counted over all local trees.  The
+ * entries for one receiving rank are contiguous: peer number \a p covers
+ * the half-open index range [peer_offsets[p], peer_offsets[p + 1]) and
+ * sends to rank peers[p].  The plan is position independent, so a caller
+ * may upload \a indices once and execute the gather in any memory space,
+ * for example as a GPU kernel writing into a device-resident buffer.
+ */
+typedef struct p4est_ghost_pack_plan
+{
+  int                 num_peers;    /**< ranks with nonempty sends */
+  int                *peers;        /**< their ranks in ascending order */
+  p4est_locidx_t     *peer_offsets; /**< num_peers + 1 entries into indices */
+  p4est_locidx_t     *indices;      /**< source quadrant per packed entry */
+}
+p4est_ghost_pack_plan_t;
+
+/** Compute the gather plan for the send side of a ghost exchange.
+ * The indices are derived from the mirror_proc_mirrors array of the
+ * ghost layer and stay valid until the forest or the layer changes.
+ * \return          A plan to be freed with
+ *                  \ref p4est_ghost_pack_plan_destroy.
+ */
+p4est_ghost_pack_plan_t *p4est_ghost_pack_plan_new (p4est_t * p4est,
+                                                    p4est_ghost_t * ghost);
+
+/** Free a gather plan created by \ref p4est_ghost_pack_plan_new. */
+void                p4est_ghost_pack_plan_destroy
+  (p4est_ghost_pack_plan_t * plan);
+
+/** Transfer ghost data between externally packed buffers.
+ * Unlike \ref p4est_ghost_exchange_custom, this function never touches
+ * the buffer contents: the caller packs \a send_buffer according to
+ * \ref p4est_ghost_pack_plan_t before the call and the messages are
+ * posted directly on the given addresses.  The buffers may thus live in
+ * pinned or device memory when the MPI library understands such
+ * pointers.
+ * \param [in] data_size    The data size to transfer per quadrant.
+ * \param [in] send_buffer  Contiguous buffer of one entry per packed
+ *                          mirror, mirror_proc_offsets[mpisize] in total.
+ * \param [in,out] recv_buffer      Contiguous buffer of one entry per
+ *                          ghost quadrant, filled in ghost layer order.
+ */
+void                p4est_ghost_exchange_buffers (p4est_t * p4est,
+                                                  p4est_ghost_t * ghost,
+                                                  size_t data_size,
+                                                  void *send_buffer,
+                                                  void *recv_buffer);
+
+/** Begin a buffer-to-buffer ghost data exchange.
+ * The messaging is identical to \ref p4est_ghost_exchange_buffers.
+ * Neither buffer may be altered before the exchange is completed.
+ * \return          A handle to be passed to
+ *                  \ref p4est_ghost_exchange_buffers_end.
+ */
+p4est_ghost_exchange_t *p4est_ghost_exchange_buffers_begin
+  (p4est_t * p4est, p4est_ghost_t * ghost, size_t data_size,
+   void *send_buffer, void *recv_buffer);
+
+/** Complete a buffer-to-buffer ghost data exchange.
+ * \param [in,out] exc  Created by \ref p4est_ghost_exchange_buffers_begin.
+ *                      The handle is deallocated in this function.
+ */
+void                p4est_ghost_exchange_buffers_end
+  (p4est_ghost_exchange_t * exc);
+
+/** One registered member of a fused ghost data exchange.
+ * The semantics of the fields are those of the arguments to
+ * \ref p4est_ghost_exchange_custom.
+ */
+typedef struct p4est_ghost_exchange_group_member
+{
+  p4est_t            *p4est;
+  p4est_ghost_t      *ghost;
+  size_t              data_size;
+  void              **mirror_data;      /**< read when a round begins */
+  void               *ghost_data;       /**< written when a round ends */
+}
+p4est_ghost_exchange_group_member_t;
+
+/** A group of ghost data exchanges fused into one message round.
+ * Several forests held on the same partition usually talk to the same
+ * neighbor ranks; running their exchanges through a group sends one
+ * combined message per peer and direction instead of one per member,
+ * which cuts the message count by the number of members for runs that
+ * are limited by message rate rather than bandwidth.
+ */
+typedef struct p4est_ghost_exchange_group
+{
+  sc_MPI_Comm         mpicomm;  /**< taken from the first member */
+  int                 mpisize;  /**< matches every member's forest */
+  sc_array_t          members;  /**< of p4est_ghost_exchange_group_member_t */
+  sc_array_t          requests, sbuffers, rbuffers;
+}
+p4est_ghost_exchange_group_t;
+
+/** Create an empty exchange group.
+ * \return          A group to be populated with
+ *                  \ref p4est_ghost_exchange_group_add and freed with
+ *                  \ref p4est_ghost_exchange_group_destroy.
+ */
+p4est_ghost_exchange_group_t *p4est_ghost_exchange_group_new (void);
+
+/** Register one (ghost, data) pair with an exchange group.
+ * The arguments are those of \ref p4est_ghost_exchange_custom.  All
+ * members must live on the same communicator.  The \a mirror_data and
+ * \a ghost_data pointers are stored, not copied: they are read anew by
+ * every \ref p4est_ghost_exchange_group_begin, so one registration
+ * serves any number of exchange rounds.
+ */
+void                p4est_ghost_exchange_group_add
+  (p4est_ghost_exchange_group_t * group, p4est_t * p4est,
+   p4est_ghost_t * ghost, size_t data_size, void **mirror_data,
+   void *ghost_data);
+
+/** Begin one fused exchange round by posting messages.
+ * For each peer rank the mirror payload of all members is packed into
+ * a single send buffer and posted as one message; symmetrically one
+ * receive per peer is posted.  The mirror data of all members may be
+ * discarded right after this function returns; the ghost data must not
+ * be accessed before the matching
+ * \ref p4est_ghost_exchange_group_end.
+ */
+void                p4est_ghost_exchange_group_begin
+  (p4est_ghost_exchange_group_t * group);
+
+/** Complete a fused exchange round.
+ * This function waits for all pending messages and distributes the
+ * received payload into the ghost data of every member.
+ */
+void                p4est_ghost_exchange_group_end
+  (p4est_ghost_exchange_group_t * group);
+
+/** Execute one synchronous fused exchange round.
+ * Equivalent to \ref p4est_ghost_exchange_group_begin followed by
+ * \ref p4est_ghost_exchange_group_end.
+ */
+void                p4est_ghost_exchange_group_go
+  (p4est_ghost_exchange_group_t * group);
+
+/** Free an exchange group.  No round may be in progress. */
+void                p4est_ghost_exchange_group_destroy
+  (p4est_ghost_exchange_group_t * group);
+
+/** Create a distributed graph communicator for the ghost exchange pattern.
+ * The neighbor lists are taken from the ghost layer's proc_offsets and
+ * mirror_proc_offsets, so the fixed communication pattern is exposed to
+ * the MPI library once per partition and can be route-optimized.
+ * \return          A graph communicator to pass to the _graph exchange
+ *                  variants, to be freed with
+ *                  \ref p4est_ghost_graph_comm_destroy.  Without MPI-3
+ *                  support this is sc_MPI_COMM_NULL, in which case the
+ *                  _graph variants fall back to point-to-point messages.
+ */
+sc_MPI_Comm         p4est_ghost_graph_comm_new (p4est_t * p4est,
+                                                p4est_ghost_t * ghost);
+
+/** Free a communicator created by \ref p4est_ghost_graph_comm_new.
+ * \param [in,out] graph_comm   Set to sc_MPI_COMM_NULL on return.
+ *                              Passing sc_MPI_COMM_NULL is allowed.
+ */
+void                p4est_ghost_graph_comm_destroy (sc_MPI_Comm * graph_comm);
+
+/** Transfer data for local quadrants that are ghosts to other processors
+ * using one neighborhood collective on a graph communicator.
+ * Identical in semantics to \ref p4est_ghost_exchange_data.
+ * \param [in] graph_comm   Created by \ref p4est_ghost_graph_comm_new
+ *                          from the same ghost layer.
+ */
+void                p4est_ghost_exchange_data_graph (p4est_t * p4est,
+                                                     p4est_ghost_t * ghost,
+                                                     sc_MPI_Comm graph_comm,
+                                                     void *ghost_data);
+
+/** Transfer custom per-quadrant data with one neighborhood collective.
+ * Identical in semantics to \ref p4est_ghost_exchange_custom.
+ * \param [in] graph_comm   Created by \ref p4est_ghost_graph_comm_new
+ *                          from the same ghost layer.
+ */
+void                p4est_ghost_exchange_custom_graph (p4est_t * p4est,
+                                                       p4est_ghost_t * ghost,
+                                                       sc_MPI_Comm graph_comm,
+                                                       size_t data_size,
+                                                       void **mirror_data,
+                                                       void *ghost_data);
+
+/** Opaque context for intra-node shared-memory ghost data exchanges.
+ * It holds a node-local communicator and an MPI-3 shared memory window
+ * that stores the mirror payloads of every process on the node.  It
+ * stays valid until the forest or the ghost layer changes, at which
+ * point it must be destroyed.
+ */
+typedef struct p4est_ghost_shared p4est_ghost_shared_t;
+
+/** Create a shared mirror-payload window for a ghost layer.
+ * The window segment of each process holds its mirror payloads in
+ * mirror_proc_mirrors order, so the existing mirror_proc_offsets index
+ * into it.  The payload size per quadrant is taken from the forest as
+ * in \ref p4est_ghost_exchange_data.
+ * \return          A context to be passed to
+ *                  \ref p4est_ghost_exchange_data_shared, to be freed
+ *                  with \ref p4est_ghost_shared_destroy.
+ */
+p4est_ghost_shared_t *p4est_ghost_shared_new (p4est_t * p4est,
+                                              p4est_ghost_t * ghost);
+
+/** Transfer ghost data, reading same-node mirrors from shared memory.
+ * Identical in semantics to \ref p4est_ghost_exchange_data.  Ghosts
+ * owned by a process on the same node are copied directly out of the
+ * owner's window segment, so only inter-node mirrors travel as
+ * messages.  Without MPI-3 shared window support every ghost goes over
+ * the wire as before.  The call is collective over the forest's
+ * communicator.
+ * \param [in,out] ghost_data   As in \ref p4est_ghost_exchange_data.
+ */
+void                p4est_ghost_exchange_data_shared
+  (p4est_ghost_shared_t * sh, void *ghost_data);
+
+/** Free the window and communicator of a shared exchange context. */
+void                p4est_ghost_shared_destroy (p4est_ghost_shared_t * sh);
+
 /** Expand the size of the ghost layer and mirrors by one additional layer of
  * adjacency.
  * \param [in] p4est            The forest from which the ghost layer was
@@ -382,6 +1072,28 @@ void                p4est_ghost_exchange_custom_levels_end
 void                p4est_ghost_expand (p4est_t * p4est,
                                         p4est_ghost_t * ghost);
 
+/** Expand the ghost layer only in the neighborhood of the given ranges.
+ * Behaves like \ref p4est_ghost_expand restricted to front mirrors that
+ * overlap one of the ranges.  Peers whose fronts all miss the ranges
+ * only exchange empty message counts, so both the adjacency probing and
+ * the communication volume scale with the size of the ranges instead of
+ * the whole partition boundary.
+ * This function is collective; every process passes the ranges covering
+ * the region where it needs the ghost layer to grow, including any
+ * buffer of quadrants it wants probed around that region.
+ * \param [in] p4est     The forest from which the ghost layer was
+ *                       generated.
+ * \param [in,out] ghost The ghost layer to be expanded.
+ * \param [in] ranges    Array of p4est_quadrant_t with an even number of
+ *                       entries.  Entries 2i and 2i + 1 hold the first
+ *                       and last quadrant of range i in Morton order,
+ *                       both in the tree stored in their p.which_tree
+ *                       member.  The array is not modified.
+ */
+void                p4est_ghost_expand_ranges (p4est_t * p4est,
+                                               p4est_ghost_t * ghost,
+                                               sc_array_t * ranges);
+
 SC_EXTERN_C_END;
 
 #endif /* !P4EST_GHOST_H */
@@ -84,11 +84,212 @@ p4est_deflate_quadrants (p4est_t * p4est, sc_array_t ** data)
   return qarr;
 }
 
+/** Append one unsigned number in variable-length base-128 encoding. */
+static void
+p4est_varint_push (sc_array_t * bytes, uint64_t v)
+{
+  uint8_t            *bp;
+
+  for (;;) {
+    bp = (uint8_t *) sc_array_push (bytes);
+    if (v < 0x80) {
+      *bp = (uint8_t) v;
+      return;
+    }
+    *bp = (uint8_t) (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+}
+
+/** Read back one variable-length number; returns the bytes consumed. */
+static size_t
+p4est_varint_pull (const uint8_t * bp, uint64_t * v)
+{
+  int                 shift;
+  size_t              zb;
+
+  *v = 0;
+  shift = 0;
+  zb = 0;
+  do {
+    *v |= (uint64_t) (bp[zb] & 0x7F) << shift;
+    shift += 7;
+  }
+  while (bp[zb++] & 0x80);
+
+  return zb;
+}
+
+sc_array_t         *
+p4est_deflate_quadrants_compressed (p4est_t * p4est, sc_array_t ** data)
+{
+  const size_t        dsize = p4est->data_size;
+  size_t              qtreez, qz;
+  uint64_t            lid, prev;
+  sc_array_t         *barr, *darr;
+  p4est_topidx_t      tt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+  p4est_quadrant_t    fd;
+  uint8_t            *bp;
+  char               *dap;
+
+  barr = sc_array_new (sizeof (uint8_t));
+  darr = NULL;
+  dap = NULL;
+  if (data != NULL) {
+    P4EST_ASSERT (dsize > 0);
+    darr = sc_array_new_size (dsize, p4est->local_num_quadrants);
+    dap = darr->array;
+  }
+  for (tt = p4est->first_local_tree; tt <= p4est->last_local_tree; ++tt) {
+    tree = p4est_tree_array_index (p4est->trees, tt);
+    qtreez = tree->quadrants.elem_count;
+
+    /* the stream is Morton-sorted within each tree: a level byte and
+     * the delta of first-descendant linear ids encode each quadrant */
+    prev = 0;
+    for (qz = 0; qz < qtreez; ++qz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, qz);
+      p4est_quadrant_first_descendant (q, &fd, P4EST_QMAXLEVEL);
+      lid = p4est_quadrant_linear_id (&fd, P4EST_QMAXLEVEL);
+      P4EST_ASSERT (qz == 0 || lid > prev);
+      bp = (uint8_t *) sc_array_push (barr);
+      *bp = (uint8_t) q->level;
+      p4est_varint_push (barr, lid - prev);
+      prev = lid;
+      if (data != NULL) {
+        memcpy (dap, q->p.user_data, dsize);
+        dap += dsize;
+      }
+    }
+  }
+  if (data != NULL) {
+    P4EST_ASSERT (dap == darr->array + darr->elem_size * darr->elem_count);
+    *data = darr;
+  }
+  return barr;
+}
+
+/** Decode a delta-compressed quadrant stream into plain coordinates.
+ * \return    Array as accepted by \ref p4est_inflate; owned by caller.
+ */
+static sc_array_t  *
+p4est_inflate_decode (sc_MPI_Comm mpicomm,
+                      p4est_connectivity_t * connectivity,
+                      const p4est_gloidx_t * global_first_quadrant,
+                      const p4est_gloidx_t * pertree,
+                      sc_array_t * cquadrants)
+{
+  int                 mpiret;
+  int                 rank;
+  size_t              gk1, gk2;
+  size_t              zb, qz, zqthistree;
+  uint64_t            delta, prev;
+  p4est_topidx_t      num_trees, jt;
+  p4est_topidx_t      first_tree, last_tree;
+  p4est_gloidx_t      gkey, gtreeskip, gtreeremain, gquadremain;
+  p4est_quadrant_t    tmpq;
+  p4est_qcoord_t     *qap;
+  sc_array_t         *qarr;
+  const uint8_t      *bp;
+
+  P4EST_ASSERT (cquadrants != NULL);
+  P4EST_ASSERT (cquadrants->elem_size == sizeof (uint8_t));
+
+  mpiret = sc_MPI_Comm_rank (mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
+  num_trees = connectivity->num_trees;
+  gquadremain = global_first_quadrant[rank + 1] -
+    global_first_quadrant[rank];
+
+  /* find the first and last tree as in p4est_inflate */
+  if (gquadremain > 0) {
+    gkey = global_first_quadrant[rank];
+    gk1 = sc_bsearch_range (&gkey, pertree, num_trees,
+                            sizeof (p4est_gloidx_t), p4est_gloidx_compare);
+    P4EST_ASSERT (gk1 < (size_t) num_trees);
+    gtreeskip = gkey - pertree[gk1];
+    gkey = global_first_quadrant[rank + 1] - 1;
+    gk2 = sc_bsearch_range (&gkey, pertree, num_trees,
+                            sizeof (p4est_gloidx_t), p4est_gloidx_compare);
+    P4EST_ASSERT (gk1 <= gk2 && gk2 < (size_t) num_trees);
+    first_tree = (p4est_topidx_t) gk1;
+    last_tree = (p4est_topidx_t) gk2;
+  }
+  else {
+    gtreeskip = 0;
+    first_tree = -1;
+    last_tree = -2;
+  }
+
+  /* decode the byte stream into the plain coordinate representation */
+  qarr = sc_array_new_size (sizeof (p4est_qcoord_t),
+                            (P4EST_DIM + 1) * (size_t) gquadremain);
+  qap = (p4est_qcoord_t *) qarr->array;
+  bp = (const uint8_t *) cquadrants->array;
+  zb = 0;
+  for (jt = first_tree; jt <= last_tree; ++jt) {
+    gtreeremain = pertree[jt + 1] - pertree[jt] - gtreeskip;
+    P4EST_ASSERT (gtreeremain > 0 && gquadremain > 0);
+    zqthistree = (size_t) SC_MIN (gtreeremain, gquadremain);
+    prev = 0;
+    for (qz = 0; qz < zqthistree; ++qz) {
+      int8_t              ql;
+
+      P4EST_ASSERT (zb < cquadrants->elem_count);
+      ql = (int8_t) bp[zb++];
+      P4EST_ASSERT (ql >= 0 && ql <= P4EST_QMAXLEVEL);
+      zb += p4est_varint_pull (bp + zb, &delta);
+      prev += delta;
+      P4EST_QUADRANT_INIT (&tmpq);
+      p4est_quadrant_set_morton (&tmpq, P4EST_QMAXLEVEL, prev);
+      *qap++ = tmpq.x;
+      *qap++ = tmpq.y;
+#ifdef P4_TO_P8
+      *qap++ = tmpq.z;
+#endif
+      *qap++ = (p4est_qcoord_t) ql;
+    }
+    gquadremain -= (p4est_gloidx_t) zqthistree;
+    gtreeskip = 0;
+  }
+  P4EST_ASSERT (gquadremain == 0);
+  P4EST_ASSERT (zb == cquadrants->elem_count);
+  P4EST_ASSERT ((void *) qap ==
+                qarr->array + qarr->elem_size * qarr->elem_count);
+
+  return qarr;
+}
+
 p4est_t            *
-p4est_inflate (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
-               const p4est_gloidx_t * global_first_quadrant,
-               const p4est_gloidx_t * pertree,
-               sc_array_t * quadrants, sc_array_t * data, void *user_pointer)
+p4est_inflate_compressed (sc_MPI_Comm mpicomm,
+                          p4est_connectivity_t * connectivity,
+                          const p4est_gloidx_t * global_first_quadrant,
+                          const p4est_gloidx_t * pertree,
+                          sc_array_t * cquadrants, sc_array_t * data,
+                          void *user_pointer)
+{
+  p4est_t            *p4est;
+  sc_array_t         *qarr;
+
+  /* delegate forest construction to the uncompressed path */
+  qarr = p4est_inflate_decode (mpicomm, connectivity, global_first_quadrant,
+                               pertree, cquadrants);
+  p4est = p4est_inflate (mpicomm, connectivity, global_first_quadrant,
+                         pertree, qarr, data, user_pointer);
+  sc_array_destroy (qarr);
+
+  return p4est;
+}
+
+static p4est_t     *
+p4est_inflate_internal (sc_MPI_Comm mpicomm,
+                        p4est_connectivity_t * connectivity,
+                        const p4est_gloidx_t * global_first_quadrant,
+                        const p4est_gloidx_t * pertree,
+                        sc_array_t * quadrants, sc_array_t * data,
+                        void *user_pointer, int trusted)
 {
   const p4est_gloidx_t *gfq;
   int                 i;
@@ -111,7 +312,7 @@ p4est_inflate (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
   P4EST_GLOBAL_PRODUCTION ("Into " P4EST_STRING "_inflate\n");
   p4est_log_indent_push ();
 
-  P4EST_ASSERT (p4est_connectivity_is_valid (connectivity));
+  P4EST_ASSERT (trusted || p4est_connectivity_is_valid (connectivity));
   P4EST_ASSERT (global_first_quadrant != NULL);
   P4EST_ASSERT (pertree != NULL);
   P4EST_ASSERT (quadrants != NULL);
@@ -227,6 +428,11 @@ p4est_inflate (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
         P4EST_ASSERT (ql >= 0 && ql <= P4EST_QMAXLEVEL);
         ++tree->quadrants_per_level[ql];
         tml = SC_MAX (tml, ql);
+        if (trusted && (qz % 128) == 0) {
+          /* the trusted path still sampling-verifies about 1 percent */
+          SC_CHECK_ABORT (p4est_quadrant_is_valid (q), P4EST_STRING
+                          "_inflate_trusted: invalid quadrant in stream");
+        }
         p4est_quadrant_init_data (p4est, jt, q, NULL);
         if (data != NULL) {
           memcpy (q->p.user_data, dap, dsize);
@@ -257,9 +463,648 @@ p4est_inflate (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
                   (long long) p4est->local_num_quadrants);
 
   P4EST_ASSERT (p4est->revision == 0);
-  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (trusted || p4est_is_valid (p4est));
   p4est_log_indent_pop ();
   P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_inflate\n");
 
   return p4est;
 }
+
+p4est_t            *
+p4est_inflate (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
+               const p4est_gloidx_t * global_first_quadrant,
+               const p4est_gloidx_t * pertree,
+               sc_array_t * quadrants, sc_array_t * data, void *user_pointer)
+{
+  return p4est_inflate_internal (mpicomm, connectivity,
+                                 global_first_quadrant, pertree,
+                                 quadrants, data, user_pointer, 0);
+}
+
+p4est_t            *
+p4est_inflate_trusted (sc_MPI_Comm mpicomm,
+                       p4est_connectivity_t * connectivity,
+                       const p4est_gloidx_t * global_first_quadrant,
+                       const p4est_gloidx_t * pertree,
+                       sc_array_t * quadrants, sc_array_t * data,
+                       void *user_pointer)
+{
+  p4est_t            *p4est;
+  sc_array_t         *qarr;
+
+  if (quadrants->elem_size == sizeof (uint8_t)) {
+    /* accept the delta-compressed stream as well */
+    qarr = p4est_inflate_decode (mpicomm, connectivity,
+                                 global_first_quadrant, pertree, quadrants);
+    p4est = p4est_inflate_internal (mpicomm, connectivity,
+                                    global_first_quadrant, pertree,
+                                    qarr, data, user_pointer, 1);
+    sc_array_destroy (qarr);
+    return p4est;
+  }
+
+  return p4est_inflate_internal (mpicomm, connectivity,
+                                 global_first_quadrant, pertree,
+                                 quadrants, data, user_pointer, 1);
+}
+
+size_t
+p4est_save_data_encoded (p4est_t * p4est, p4est_data_codec_t * codec,
+                         sc_array_t * buffer)
+{
+  const size_t        data_size = p4est->data_size;
+  size_t              total_bytes;
+  size_t              zz, zcount;
+  char               *bp;
+  uint64_t           *u64a;
+  p4est_topidx_t      nt, tt;
+  sc_array_t        **chunks;
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (codec != NULL && codec->encode != NULL);
+  P4EST_ASSERT (buffer != NULL && buffer->elem_size == 1);
+  SC_CHECK_ABORT (data_size > 0, "encoded save requires quadrant data");
+
+  nt = p4est->first_local_tree < 0 ? 0 :
+    p4est->last_local_tree - p4est->first_local_tree + 1;
+  chunks = P4EST_ALLOC (sc_array_t *, nt);
+
+  /* gather each tree's payload contiguously and encode it as one
+   * chunk; the chunks are independent and run thread-parallel */
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (dynamic)
+#endif
+  for (tt = 0; tt < nt; ++tt) {
+    int                 retval;
+    size_t              tz, tcount;
+    char               *lbuf;
+    p4est_tree_t       *tree;
+    p4est_quadrant_t   *q;
+
+    tree = p4est_tree_array_index (p4est->trees,
+                                   p4est->first_local_tree + tt);
+    tcount = tree->quadrants.elem_count;
+    lbuf = P4EST_ALLOC (char, tcount * data_size);
+    for (tz = 0; tz < tcount; ++tz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, tz);
+      memcpy (lbuf + tz * data_size, q->p.user_data, data_size);
+    }
+    chunks[tt] = sc_array_new (1);
+    retval = codec->encode (lbuf, tcount, data_size,
+                            chunks[tt], codec->user);
+    SC_CHECK_ABORT (!retval, "payload encode");
+    P4EST_FREE (lbuf);
+  }
+
+  /* frame the chunks: record size and tree count, then the quadrant
+   * and byte counts per chunk, then the encoded bytes back to back */
+  total_bytes = (2 + 2 * (size_t) nt) * sizeof (uint64_t);
+  for (tt = 0; tt < nt; ++tt) {
+    total_bytes += chunks[tt]->elem_count;
+  }
+  sc_array_resize (buffer, total_bytes);
+  u64a = (uint64_t *) buffer->array;
+  u64a[0] = (uint64_t) data_size;
+  u64a[1] = (uint64_t) nt;
+  bp = buffer->array + (2 + 2 * (size_t) nt) * sizeof (uint64_t);
+  for (tt = 0; tt < nt; ++tt) {
+    zz = (size_t) tt;
+    zcount = p4est_tree_array_index (p4est->trees,
+                                     p4est->first_local_tree +
+                                     tt)->quadrants.elem_count;
+    u64a[2 + 2 * zz] = (uint64_t) zcount;
+    u64a[3 + 2 * zz] = (uint64_t) chunks[tt]->elem_count;
+    memcpy (bp, chunks[tt]->array, chunks[tt]->elem_count);
+    bp += chunks[tt]->elem_count;
+    sc_array_destroy (chunks[tt]);
+  }
+  P4EST_ASSERT (bp == buffer->array + buffer->elem_count);
+  P4EST_FREE (chunks);
+
+  return total_bytes;
+}
+
+void
+p4est_load_data_encoded (p4est_t * p4est, p4est_data_codec_t * codec,
+                         sc_array_t * buffer)
+{
+  const size_t        data_size = p4est->data_size;
+  size_t              zz;
+  char              **cpos;
+  const uint64_t     *u64a;
+  const char         *bp;
+  p4est_topidx_t      nt, tt;
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (codec != NULL && codec->decode != NULL);
+  P4EST_ASSERT (buffer != NULL && buffer->elem_size == 1);
+  SC_CHECK_ABORT (data_size > 0, "encoded load requires quadrant data");
+
+  nt = p4est->first_local_tree < 0 ? 0 :
+    p4est->last_local_tree - p4est->first_local_tree + 1;
+  SC_CHECK_ABORT (buffer->elem_count >=
+                  (2 + 2 * (size_t) nt) * sizeof (uint64_t),
+                  "encoded data truncated header");
+  u64a = (const uint64_t *) buffer->array;
+  SC_CHECK_ABORT (u64a[0] == (uint64_t) data_size,
+                  "encoded data size mismatch");
+  SC_CHECK_ABORT (u64a[1] == (uint64_t) nt,
+                  "encoded data tree count mismatch");
+
+  /* locate every chunk up front so the decodes can run in parallel */
+  cpos = P4EST_ALLOC (char *, nt);
+  bp = buffer->array + (2 + 2 * (size_t) nt) * sizeof (uint64_t);
+  for (tt = 0; tt < nt; ++tt) {
+    zz = (size_t) tt;
+    cpos[tt] = (char *) bp;
+    bp += (size_t) u64a[3 + 2 * zz];
+  }
+  SC_CHECK_ABORT (bp == buffer->array + buffer->elem_count,
+                  "encoded data byte count mismatch");
+
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (dynamic)
+#endif
+  for (tt = 0; tt < nt; ++tt) {
+    int                 retval;
+    size_t              tz, tcount;
+    char               *lbuf;
+    p4est_tree_t       *tree;
+    p4est_quadrant_t   *q;
+
+    tree = p4est_tree_array_index (p4est->trees,
+                                   p4est->first_local_tree + tt);
+    tcount = tree->quadrants.elem_count;
+    SC_CHECK_ABORT (u64a[2 + 2 * (size_t) tt] == (uint64_t) tcount,
+                    "encoded data quadrant count mismatch");
+    lbuf = P4EST_ALLOC (char, tcount * data_size);
+    retval = codec->decode (cpos[tt], (size_t) u64a[3 + 2 * (size_t) tt],
+                            tcount, data_size, lbuf, codec->user);
+    SC_CHECK_ABORT (!retval, "payload decode");
+    for (tz = 0; tz < tcount; ++tz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, tz);
+      memcpy (q->p.user_data, lbuf + tz * data_size, data_size);
+    }
+    P4EST_FREE (lbuf);
+  }
+  P4EST_FREE (cpos);
+}
+
+p4est_t            *
+p4est_gather_to_team (p4est_t * p4est, int team_size)
+{
+  const size_t        qsize = sizeof (p4est_qcoord_t);
+  const size_t        dsize = p4est->data_size;
+  const size_t        qper = (P4EST_DIM + 1) * qsize;
+  const int           num_procs = p4est->mpisize;
+  const int           rank = p4est->mpirank;
+  p4est_gloidx_t     *pertree;
+  p4est_gloidx_t      gfq_team[2];
+  p4est_t            *team;
+  sc_array_t         *qarr, *darr;
+  sc_array_t          qview, dview;
+  char               *fullq, *fulld;
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+  int                 p;
+  int                *qcounts, *qdispls;
+  int                *dcounts, *ddispls;
+  MPI_Comm            teamcomm;
+#endif
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (0 < team_size && team_size <= num_procs);
+
+  P4EST_GLOBAL_PRODUCTION ("Into " P4EST_STRING "_gather_to_team\n");
+  p4est_log_indent_push ();
+
+  /* the per-tree counts are needed to inflate the replicated forest */
+  pertree = P4EST_ALLOC (p4est_gloidx_t,
+                         p4est->connectivity->num_trees + 1);
+  p4est_comm_count_pertree (p4est, pertree);
+
+  /* serialize the local partition */
+  darr = NULL;
+  qarr = p4est_deflate_quadrants (p4est, dsize > 0 ? &darr : NULL);
+
+  fullq = fulld = NULL;
+#ifdef P4EST_ENABLE_MPI
+  if (num_procs > 1) {
+    /* gather the streams of all processes on the first team rank */
+    qcounts = P4EST_ALLOC (int, num_procs);
+    qdispls = P4EST_ALLOC (int, num_procs);
+    dcounts = P4EST_ALLOC (int, num_procs);
+    ddispls = P4EST_ALLOC (int, num_procs);
+    for (p = 0; p < num_procs; ++p) {
+      qcounts[p] = (int) (qper * (size_t)
+                          (p4est->global_first_quadrant[p + 1] -
+                           p4est->global_first_quadrant[p]));
+      qdispls[p] = (int) (qper * (size_t) p4est->global_first_quadrant[p]);
+      dcounts[p] = (int) (dsize * (size_t)
+                          (p4est->global_first_quadrant[p + 1] -
+                           p4est->global_first_quadrant[p]));
+      ddispls[p] = (int) (dsize * (size_t) p4est->global_first_quadrant[p]);
+    }
+    if (rank < team_size) {
+      fullq = P4EST_ALLOC (char, qper *
+                           (size_t) p4est->global_num_quadrants);
+      if (dsize > 0) {
+        fulld = P4EST_ALLOC (char, dsize *
+                             (size_t) p4est->global_num_quadrants);
+      }
+    }
+    mpiret = MPI_Gatherv (qarr->array,
+                          (int) (qarr->elem_count * qsize), MPI_BYTE,
+                          fullq, qcounts, qdispls, MPI_BYTE, 0,
+                          p4est->mpicomm);
+    SC_CHECK_MPI (mpiret);
+    if (dsize > 0) {
+      mpiret = MPI_Gatherv (darr->array,
+                            (int) (darr->elem_count * dsize), MPI_BYTE,
+                            fulld, dcounts, ddispls, MPI_BYTE, 0,
+                            p4est->mpicomm);
+      SC_CHECK_MPI (mpiret);
+    }
+    P4EST_FREE (qcounts);
+    P4EST_FREE (qdispls);
+    P4EST_FREE (dcounts);
+    P4EST_FREE (ddispls);
+
+    /* replicate the gathered streams over the remaining team ranks */
+    mpiret = MPI_Comm_split (p4est->mpicomm,
+                             rank < team_size ? 0 : MPI_UNDEFINED,
+                             rank, &teamcomm);
+    SC_CHECK_MPI (mpiret);
+    if (teamcomm != MPI_COMM_NULL) {
+      if (team_size > 1) {
+        mpiret = MPI_Bcast (fullq, (int) (qper * (size_t)
+                                          p4est->global_num_quadrants),
+                            MPI_BYTE, 0, teamcomm);
+        SC_CHECK_MPI (mpiret);
+        if (dsize > 0) {
+          mpiret = MPI_Bcast (fulld, (int) (dsize * (size_t)
+                                            p4est->global_num_quadrants),
+                              MPI_BYTE, 0, teamcomm);
+          SC_CHECK_MPI (mpiret);
+        }
+      }
+      mpiret = MPI_Comm_free (&teamcomm);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+#endif /* P4EST_ENABLE_MPI */
+
+  team = NULL;
+  if (rank < team_size) {
+    /* every team rank inflates the whole forest on its own */
+    gfq_team[0] = 0;
+    gfq_team[1] = p4est->global_num_quadrants;
+    if (fullq != NULL) {
+      sc_array_init_data (&qview, fullq, qsize, (P4EST_DIM + 1) *
+                          (size_t) p4est->global_num_quadrants);
+      if (dsize > 0) {
+        sc_array_init_data (&dview, fulld, dsize,
+                            (size_t) p4est->global_num_quadrants);
+      }
+      team = p4est_inflate (sc_MPI_COMM_SELF, p4est->connectivity,
+                            gfq_team, pertree, &qview,
+                            dsize > 0 ? &dview : NULL,
+                            p4est->user_pointer);
+    }
+    else {
+      /* a single process already holds the complete streams */
+      P4EST_ASSERT (num_procs == 1);
+      team = p4est_inflate (sc_MPI_COMM_SELF, p4est->connectivity,
+                            gfq_team, pertree, qarr, darr,
+                            p4est->user_pointer);
+    }
+  }
+
+  if (fullq != NULL) {
+    P4EST_FREE (fullq);
+  }
+  if (fulld != NULL) {
+    P4EST_FREE (fulld);
+  }
+  if (darr != NULL) {
+    sc_array_destroy (darr);
+  }
+  sc_array_destroy (qarr);
+  P4EST_FREE (pertree);
+
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_gather_to_team\n");
+
+  return team;
+}
+
+void
+p4est_scatter_from_team (p4est_t * p4est, p4est_t * team)
+{
+  const size_t        dsize = p4est->data_size;
+  const int           num_procs = p4est->mpisize;
+  const int           rank = p4est->mpirank;
+  size_t              qz;
+  char               *fulld, *slice, *dap;
+  sc_array_t         *qarr, *darr;
+  p4est_topidx_t      tt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+  int                 p;
+  int                *dcounts, *ddispls;
+#endif
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (rank != 0 || team != NULL);
+  P4EST_ASSERT (team == NULL ||
+                team->global_num_quadrants == p4est->global_num_quadrants);
+
+  /* without payload there is nothing to bring back */
+  if (dsize == 0) {
+    return;
+  }
+  P4EST_ASSERT (team == NULL || team->data_size == dsize);
+
+  /* the first team rank serializes the replicated payload */
+  fulld = NULL;
+  darr = NULL;
+  if (rank == 0) {
+    qarr = p4est_deflate_quadrants (team, &darr);
+    sc_array_destroy (qarr);
+    fulld = darr->array;
+  }
+
+  slice = P4EST_ALLOC (char, dsize * (size_t) p4est->local_num_quadrants);
+#ifdef P4EST_ENABLE_MPI
+  if (num_procs > 1) {
+    dcounts = P4EST_ALLOC (int, num_procs);
+    ddispls = P4EST_ALLOC (int, num_procs);
+    for (p = 0; p < num_procs; ++p) {
+      dcounts[p] = (int) (dsize * (size_t)
+                          (p4est->global_first_quadrant[p + 1] -
+                           p4est->global_first_quadrant[p]));
+      ddispls[p] = (int) (dsize * (size_t) p4est->global_first_quadrant[p]);
+    }
+    mpiret = MPI_Scatterv (fulld, dcounts, ddispls, MPI_BYTE, slice,
+                           (int) (dsize *
+                                  (size_t) p4est->local_num_quadrants),
+                           MPI_BYTE, 0, p4est->mpicomm);
+    SC_CHECK_MPI (mpiret);
+    P4EST_FREE (dcounts);
+    P4EST_FREE (ddispls);
+  }
+  else
+#endif
+  {
+    memcpy (slice, fulld + dsize *
+            (size_t) p4est->global_first_quadrant[rank],
+            dsize * (size_t) p4est->local_num_quadrants);
+  }
+
+  /* unpack the received payload into the local quadrants */
+  dap = slice;
+  for (tt = p4est->first_local_tree; tt <= p4est->last_local_tree; ++tt) {
+    tree = p4est_tree_array_index (p4est->trees, tt);
+    for (qz = 0; qz < tree->quadrants.elem_count; ++qz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, qz);
+      memcpy (q->p.user_data, dap, dsize);
+      dap += dsize;
+    }
+  }
+  P4EST_ASSERT (dap == slice + dsize * (size_t) p4est->local_num_quadrants);
+
+  P4EST_FREE (slice);
+  if (darr != NULL) {
+    sc_array_destroy (darr);
+  }
+}
+
+/* index of a local tree in the pager bookkeeping arrays */
+#define P4EST_PAGER_LOCAL(pager,jt) \
+  ((size_t) ((jt) - (pager)->p4est->first_local_tree))
+
+struct p4est_tree_pager
+{
+  p4est_t            *p4est;        /**< the forest being paged */
+  FILE               *file;         /**< per-rank backing file */
+  char               *filename;     /**< owned path for cleanup */
+  size_t              max_resident; /**< byte budget, 0 for no bound */
+  size_t              now_resident; /**< resident payload bytes */
+  size_t              num_ltrees;   /**< local trees under management */
+  long               *offsets;      /**< file offset per local tree */
+  size_t             *bytes;        /**< stream bytes per local tree */
+  int                *resident;     /**< nonzero while in memory */
+  long               *last_used;    /**< LRU stamp per local tree */
+  long                clock;        /**< monotone access counter */
+};
+
+p4est_tree_pager_t *
+p4est_tree_pager_new (p4est_t * p4est, const char *directory,
+                      size_t max_resident)
+{
+  const size_t        dsize = p4est->data_size;
+  const size_t        qper = (P4EST_DIM + 1) * sizeof (p4est_qcoord_t);
+  size_t              zt;
+  long                offset;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  p4est_tree_pager_t *pager;
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (directory != NULL);
+
+  pager = P4EST_ALLOC_ZERO (p4est_tree_pager_t, 1);
+  pager->p4est = p4est;
+  pager->max_resident = max_resident;
+  pager->num_ltrees = (size_t)
+    SC_MAX (p4est->last_local_tree - p4est->first_local_tree + 1, 0);
+  pager->offsets = P4EST_ALLOC (long, pager->num_ltrees);
+  pager->bytes = P4EST_ALLOC (size_t, pager->num_ltrees);
+  pager->resident = P4EST_ALLOC (int, pager->num_ltrees);
+  pager->last_used = P4EST_ALLOC_ZERO (long, pager->num_ltrees);
+
+  /* the stream of a tree has a fixed size, so offsets are known now */
+  offset = 0;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    zt = P4EST_PAGER_LOCAL (pager, jt);
+    pager->offsets[zt] = offset;
+    pager->bytes[zt] = tree->quadrants.elem_count * (qper + dsize);
+    pager->resident[zt] = 1;
+    pager->now_resident += pager->bytes[zt];
+    offset += (long) pager->bytes[zt];
+  }
+
+  pager->filename = P4EST_ALLOC (char, strlen (directory) + 32);
+  snprintf (pager->filename, strlen (directory) + 32,
+            "%s/" P4EST_STRING "_pager_%d.bin", directory, p4est->mpirank);
+  pager->file = fopen (pager->filename, "wb+");
+  SC_CHECK_ABORTF (pager->file != NULL,
+                   "Failed to open pager file %s", pager->filename);
+
+  return pager;
+}
+
+void
+p4est_tree_evict (p4est_tree_pager_t * pager, p4est_topidx_t which_tree)
+{
+  p4est_t            *p4est = pager->p4est;
+  const size_t        dsize = p4est->data_size;
+  const size_t        zt = P4EST_PAGER_LOCAL (pager, which_tree);
+  size_t              qz;
+  int                 retval;
+  char               *buf, *bp;
+  p4est_qcoord_t     *qp;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (p4est->first_local_tree <= which_tree &&
+                which_tree <= p4est->last_local_tree);
+  P4EST_ASSERT (pager->resident[zt]);
+
+  tree = p4est_tree_array_index (p4est->trees, which_tree);
+
+  /* serialize the tree's quadrants in the deflate stream layout */
+  buf = bp = P4EST_ALLOC (char, pager->bytes[zt]);
+  for (qz = 0; qz < tree->quadrants.elem_count; ++qz) {
+    q = p4est_quadrant_array_index (&tree->quadrants, qz);
+    qp = (p4est_qcoord_t *) bp;
+    *qp++ = q->x;
+    *qp++ = q->y;
+#ifdef P4_TO_P8
+    *qp++ = q->z;
+#endif
+    *qp++ = (p4est_qcoord_t) q->level;
+    bp = (char *) qp;
+    if (dsize > 0) {
+      memcpy (bp, q->p.user_data, dsize);
+      bp += dsize;
+    }
+    p4est_quadrant_free_data (p4est, q);
+  }
+  P4EST_ASSERT (bp == buf + pager->bytes[zt]);
+
+  retval = fseek (pager->file, pager->offsets[zt], SEEK_SET);
+  SC_CHECK_ABORT (retval == 0, "Failed to seek in pager file");
+  sc_fwrite (buf, 1, pager->bytes[zt], pager->file, "page out tree");
+  P4EST_FREE (buf);
+
+  /* the per-level counters and descendant range stay in the tree */
+  sc_array_reset (&tree->quadrants);
+  pager->resident[zt] = 0;
+  pager->now_resident -= pager->bytes[zt];
+}
+
+/** Read one tree back without applying the residency budget. */
+static void
+p4est_tree_pager_read (p4est_tree_pager_t * pager, p4est_topidx_t which_tree)
+{
+  p4est_t            *p4est = pager->p4est;
+  const size_t        dsize = p4est->data_size;
+  const size_t        qper = (P4EST_DIM + 1) * sizeof (p4est_qcoord_t);
+  const size_t        zt = P4EST_PAGER_LOCAL (pager, which_tree);
+  size_t              qz, zcount;
+  int                 retval;
+  char               *buf, *bp;
+  p4est_qcoord_t     *qp;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (!pager->resident[zt]);
+
+  buf = P4EST_ALLOC (char, pager->bytes[zt]);
+  retval = fseek (pager->file, pager->offsets[zt], SEEK_SET);
+  SC_CHECK_ABORT (retval == 0, "Failed to seek in pager file");
+  SC_CHECK_ABORT (fread (buf, 1, pager->bytes[zt], pager->file) ==
+                  pager->bytes[zt], "Failed to page in tree");
+
+  tree = p4est_tree_array_index (p4est->trees, which_tree);
+  zcount = pager->bytes[zt] / (qper + dsize);
+  sc_array_resize (&tree->quadrants, zcount);
+  bp = buf;
+  for (qz = 0; qz < zcount; ++qz) {
+    q = p4est_quadrant_array_index (&tree->quadrants, qz);
+    P4EST_QUADRANT_INIT (q);
+    qp = (p4est_qcoord_t *) bp;
+    q->x = *qp++;
+    q->y = *qp++;
+#ifdef P4_TO_P8
+    q->z = *qp++;
+#endif
+    q->level = (int8_t) * qp++;
+    bp = (char *) qp;
+    p4est_quadrant_init_data (p4est, which_tree, q, NULL);
+    if (dsize > 0) {
+      memcpy (q->p.user_data, bp, dsize);
+      bp += dsize;
+    }
+  }
+  P4EST_ASSERT (bp == buf + pager->bytes[zt]);
+  P4EST_FREE (buf);
+
+  pager->resident[zt] = 1;
+  pager->now_resident += pager->bytes[zt];
+}
+
+void
+p4est_tree_fetch (p4est_tree_pager_t * pager, p4est_topidx_t which_tree)
+{
+  p4est_t            *p4est = pager->p4est;
+  const size_t        zt = P4EST_PAGER_LOCAL (pager, which_tree);
+  size_t              zu, zvictim;
+  long                best;
+
+  P4EST_ASSERT (p4est->first_local_tree <= which_tree &&
+                which_tree <= p4est->last_local_tree);
+
+  pager->last_used[zt] = ++pager->clock;
+  if (!pager->resident[zt]) {
+    p4est_tree_pager_read (pager, which_tree);
+  }
+
+  /* evict least recently used trees until the budget is respected */
+  while (pager->max_resident > 0 &&
+         pager->now_resident > pager->max_resident) {
+    best = pager->clock;
+    zvictim = pager->num_ltrees;
+    for (zu = 0; zu < pager->num_ltrees; ++zu) {
+      if (zu != zt && pager->resident[zu] && pager->bytes[zu] > 0 &&
+          pager->last_used[zu] < best) {
+        best = pager->last_used[zu];
+        zvictim = zu;
+      }
+    }
+    if (zvictim == pager->num_ltrees) {
+      /* nothing but the requested tree is left to evict */
+      break;
+    }
+    p4est_tree_evict (pager, p4est->first_local_tree +
+                      (p4est_topidx_t) zvictim);
+  }
+}
+
+void
+p4est_tree_pager_destroy (p4est_tree_pager_t * pager)
+{
+  p4est_topidx_t      jt;
+  p4est_t            *p4est = pager->p4est;
+
+  /* leave the forest fully resident and valid */
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    if (!pager->resident[P4EST_PAGER_LOCAL (pager, jt)]) {
+      p4est_tree_pager_read (pager, jt);
+    }
+  }
+  P4EST_ASSERT (p4est_is_valid (p4est));
+
+  fclose (pager->file);
+  remove (pager->filename);
+  P4EST_FREE (pager->filename);
+  P4EST_FREE (pager->offsets);
+  P4EST_FREE (pager->bytes);
+  P4EST_FREE (pager->resident);
+  P4EST_FREE (pager->last_used);
+  P4EST_FREE (pager);
+}
@@ -25,11 +25,13 @@
 #ifdef P4_TO_P8
 #include <p8est_algorithms.h>
 #include <p8est_bits.h>
+#include <p8est_extended.h>
 #include <p8est_iterate.h>
 #include <p8est_search.h>
 #else
 #include <p4est_algorithms.h>
 #include <p4est_bits.h>
+#include <p4est_extended.h>
 #include <p4est_iterate.h>
 #include <p4est_search.h>
 #endif
@@ -99,6 +101,27 @@ p4est_iter_tier_rings_destroy (sc_array_t * tier_rings)
   sc_array_destroy (tier_rings);
 }
 
+/** Forget all cached tiers while keeping the ring storage allocated.
+ * The tiers key on quadrant addresses, which are only stable as long as the
+ * forest does not change, so reused rings must be emptied on a new revision.
+ */
+static void
+p4est_iter_tier_rings_invalidate (sc_array_t * tier_rings)
+{
+  size_t              zz, zt;
+  p4est_iter_tier_ring_t *ring;
+  p4est_iter_tier_t  *tier;
+
+  for (zz = 0; zz < tier_rings->elem_count; zz++) {
+    ring = (p4est_iter_tier_ring_t *) sc_array_index (tier_rings, zz);
+    ring->next = 0;
+    for (zt = 0; zt < ring->tiers.elem_count; zt++) {
+      tier = (p4est_iter_tier_t *) sc_array_index (&(ring->tiers), zt);
+      tier->key = NULL;
+    }
+  }
+}
+
 static void
 p4est_iter_tier_update (sc_array_t * view, int level, size_t * next_tier,
                         size_t shift)
@@ -167,6 +190,14 @@ typedef struct p4est_iter_loop_args
 {
   int                 alloc_size;       /* large enough to accomodate strange
                                            corners/edges between trees */
+  p4est_connectivity_t *conn;   /* the connectivity and ghost layer these
+                                   arrays were built for: a workspace may
+                                   only reuse them on a match */
+  p4est_ghost_t      *ghost_layer;
+  long                revision;         /* forest revision at the last use:
+                                           the cached split tiers key on
+                                           quadrant addresses and must be
+                                           dropped when the forest changes */
 #ifdef P4_TO_P8
   int8_t              loop_edge;        /* should edge_iterate be run */
 #endif
@@ -275,6 +306,9 @@ p4est_iter_loop_args_new (p4est_connectivity_t * conn,
 
   /** initialize arrays that keep track of where we are in the search */
   loop_args->alloc_size = alloc_size;
+  loop_args->conn = conn;
+  loop_args->ghost_layer = ghost_layer;
+  loop_args->revision = -1;
   loop_args->level_num = P4EST_ALLOC (int, (P4EST_QMAXLEVEL + 1));
   loop_args->quad_idx2 = P4EST_ALLOC (int, alloc_size / 2);
   loop_args->quadrants = P4EST_ALLOC (sc_array_t *, alloc_size);
@@ -324,6 +358,15 @@ p4est_iter_loop_args_destroy (p4est_iter_loop_args_t * loop_args)
   P4EST_FREE (loop_args);
 }
 
+/** Type-erased variant of \ref p4est_iter_loop_args_destroy, stored in the
+ * workspace so that \ref p4est_workspace_destroy can free cached scratch
+ * without knowing this file's private types. */
+static void
+p4est_iter_loop_args_vdestroy (void *data)
+{
+  p4est_iter_loop_args_destroy ((p4est_iter_loop_args_t *) data);
+}
+
 /* initialize loop_args for a volume search */
 static void
 p4est_iter_init_loop_volume (p4est_iter_loop_args_t * loop_args,
@@ -635,7 +678,7 @@ p4est_iter_init_corner (p4est_iter_corner_args_t * args,
   int8_t             *ctc = conn->corner_to_corner;
   p4est_topidx_t      corner = ttc != NULL ? ttc[t * P4EST_CHILDREN + c] : -1;
 #ifdef P4_TO_P8
-  int                 ref, set, nc2, orig_o;
+  int                 set, nc2, orig_o;
   int                 e, ne, l;
   p4est_topidx_t     *tte = conn->tree_to_edge;
   p4est_topidx_t     *ett_offset = conn->ett_offset;
@@ -695,8 +738,7 @@ p4est_iter_init_corner (p4est_iter_corner_args_t * args,
 #ifndef P4_TO_P8
       nc = p4est_face_corners[nf][(o == 0) ? c2 : (1 - c2)];
 #else
-      ref = p8est_face_permutation_refs[f][nf];
-      set = p8est_face_permutation_sets[ref][o];
+      set = p8est_face_permutation_orientations[f][nf][o];
       nc2 = p8est_face_permutations[set][c2];
       nc = p8est_face_corners[nf][nc2];
 #endif
@@ -807,8 +849,7 @@ p4est_iter_init_corner (p4est_iter_corner_args_t * args,
 #ifndef P4_TO_P8
           nnc = p4est_face_corners[nf][(o == 0) ? c2 : (1 - c2)];
 #else
-          ref = p8est_face_permutation_refs[f][nf];
-          set = p8est_face_permutation_sets[ref][o];
+          set = p8est_face_permutation_orientations[f][nf][o];
           nc2 = p8est_face_permutations[set][c2];
           nnc = p8est_face_corners[nf][nc2];
 #endif
@@ -884,8 +925,7 @@ p4est_iter_init_corner (p4est_iter_corner_args_t * args,
               if (nnt == nt && nf == f) {
                 continue;
               }
-              ref = p8est_face_permutation_refs[f][nf];
-              set = p8est_face_permutation_sets[ref][o];
+              set = p8est_face_permutation_orientations[f][nf][o];
               nc2 = p8est_face_permutations[set][c2];
               nnc = p8est_face_corners[nf][nc2];
               c2 = p8est_edge_corners[e][0] == nc ? p8est_edge_corners[e][1] :
@@ -1307,7 +1347,7 @@ p8est_iter_init_edge (p8est_iter_edge_args_t * args, p8est_t * p8est,
 {
   p4est_topidx_t      ti;
   int                 i, j, k;
-  int                 f, nf, o, ref, set;
+  int                 f, nf, o, set;
   int                 ne;
   int                 c0, c1, nc0, nc1, *cc;
   int                 count = 0;
@@ -1371,8 +1411,7 @@ p8est_iter_init_edge (p8est_iter_edge_args_t * args, p8est_t * p8est,
       c1 = p8est_edge_corners[e][1];
       c0 = p8est_corner_face_corners[c0][f];
       c1 = p8est_corner_face_corners[c1][f];
-      ref = p8est_face_permutation_refs[f][nf];
-      set = p8est_face_permutation_sets[ref][o];
+      set = p8est_face_permutation_orientations[f][nf][o];
       nc0 = p8est_face_permutations[set][c0];
       nc1 = p8est_face_permutations[set][c1];
       nc0 = p8est_face_corners[nf][nc0];
@@ -1441,8 +1480,7 @@ p8est_iter_init_edge (p8est_iter_edge_args_t * args, p8est_t * p8est,
           c1 = p8est_edge_corners[ne][1];
           c0 = p8est_corner_face_corners[c0][f];
           c1 = p8est_corner_face_corners[c1][f];
-          ref = p8est_face_permutation_refs[f][nf];
-          set = p8est_face_permutation_sets[ref][o];
+          set = p8est_face_permutation_orientations[f][nf][o];
           nc0 = p8est_face_permutations[set][c0];
           nc1 = p8est_face_permutations[set][c1];
           nc0 = p8est_face_corners[nf][nc0];
@@ -2048,7 +2086,7 @@ p4est_iter_init_face (p4est_iter_face_args_t * args, p4est_t * p4est,
   int                *num_to_child = args->num_to_child;
   int                *start_idx2 = args->start_idx2;
 #ifdef P4_TO_P8
-  int                 ref, set;
+  int                 set;
 #endif
   p4est_connectivity_t *conn = p4est->connectivity;
   p4est_topidx_t      nt = conn->tree_to_tree[t * P4EST_FACES + f];
@@ -2069,8 +2107,7 @@ p4est_iter_init_face (p4est_iter_face_args_t * args, p4est_t * p4est,
   sc_array_init (&(info->sides), sizeof (p4est_iter_face_side_t));
 
 #ifdef P4_TO_P8
-  ref = p8est_face_permutation_refs[f][nf];
-  set = p8est_face_permutation_sets[ref][o];
+  set = p8est_face_permutation_orientations[f][nf][o];
 #endif
 
   if (t == nt && nf == f) {
@@ -2907,7 +2944,7 @@ p4est_iter_get_boundaries (p4est_t * p4est, p4est_topidx_t * last_run_tree,
   p4est_topidx_t     *ett_offset = conn->ett_offset;
   p4est_topidx_t     *ett = conn->edge_to_tree;
   int8_t             *ete = conn->edge_to_edge;
-  int                 ref, set;
+  int                 set;
   int                 this_o;
 #endif
   p4est_topidx_t     *ttt = conn->tree_to_tree;
@@ -3011,8 +3048,7 @@ p4est_iter_get_boundaries (p4est_t * p4est, p4est_topidx_t * last_run_tree,
             if (t == nt && f == nf) {
               continue;
             }
-            ref = p8est_face_permutation_refs[f][nf];
-            set = p8est_face_permutation_sets[ref][o];
+            set = p8est_face_permutation_orientations[f][nf][o];
             nc = p8est_face_permutations[set][c];
             nc2 = p8est_face_permutations[set][c2];
             nc = p8est_face_corners[nf][nc];
@@ -3070,8 +3106,7 @@ p4est_iter_get_boundaries (p4est_t * p4est, p4est_topidx_t * last_run_tree,
 #ifndef P4_TO_P8
             nc = p4est_face_corners[nf][(o == 0) ? c2 : 1 - c2];
 #else
-            ref = p8est_face_permutation_refs[f][nf];
-            set = p8est_face_permutation_sets[ref][o];
+            set = p8est_face_permutation_orientations[f][nf][o];
             nc2 = p8est_face_permutations[set][c2];
             nc = p8est_face_corners[nf][nc2];
 #endif
@@ -3159,6 +3194,7 @@ p4est_iterate_ext (p4est_t * p4est, p4est_ghost_t * Ghost_layer,
   p4est_topidx_t      last_run_tree;
   int32_t            *owned;
   int32_t             mask, touch;
+  p4est_workspace_t  *ws;
 
   P4EST_ASSERT (p4est_is_valid (p4est));
 
@@ -3197,13 +3233,50 @@ p4est_iterate_ext (p4est_t * p4est, p4est_ghost_t * Ghost_layer,
     return;
   }
 
-  /** initialize arrays that keep track of where we are in the search */
-  loop_args = p4est_iter_loop_args_new (conn,
+  /** initialize arrays that keep track of where we are in the search; the
+   * temporary ghost layer lives on this stack frame, so only iterations over
+   * a caller-provided ghost layer may cache the arrays in the workspace */
+  ws = (Ghost_layer == NULL || p4est->inspect == NULL) ? NULL :
+    p4est->inspect->workspace;
+  if (ws != NULL) {
+    /* reuse the search-state arrays from previous iterate calls as long as
+     * they were built for the same ghost layer and callback combination */
+    loop_args = (p4est_iter_loop_args_t *) ws->iter_loop_args;
+    if (loop_args != NULL &&
+        (loop_args->conn != conn ||
+         loop_args->ghost_layer != ghost_layer ||
+#ifdef P4_TO_P8
+         loop_args->loop_edge !=
+         (int8_t) ((iter_edge != NULL) || (iter_corner != NULL)) ||
+#endif
+         loop_args->loop_corner != (int8_t) (iter_corner != NULL))) {
+      p4est_iter_loop_args_destroy (loop_args);
+      ws->iter_loop_args = NULL;
+      loop_args = NULL;
+    }
+    if (loop_args == NULL) {
+      loop_args = p4est_iter_loop_args_new (conn,
+#ifdef P4_TO_P8
+                                            iter_edge,
+#endif
+                                            iter_corner, ghost_layer,
+                                            p4est->mpisize);
+      ws->iter_loop_args = loop_args;
+      ws->iter_loop_args_destroy = p4est_iter_loop_args_vdestroy;
+    }
+    else if (loop_args->revision != p4est->revision) {
+      p4est_iter_tier_rings_invalidate (loop_args->tier_rings);
+    }
+    loop_args->revision = p4est->revision;
+  }
+  else {
+    loop_args = p4est_iter_loop_args_new (conn,
 #ifdef P4_TO_P8
-                                        iter_edge,
+                                          iter_edge,
 #endif
-                                        iter_corner, ghost_layer,
-                                        p4est->mpisize);
+                                          iter_corner, ghost_layer,
+                                          p4est->mpisize);
+  }
 
   owned = p4est_iter_get_boundaries (p4est, &last_run_tree, remote);
   last_run_tree = (last_run_tree < last_local_tree) ? last_local_tree :
@@ -3291,7 +3364,87 @@ p4est_iterate_ext (p4est_t * p4est, p4est_ghost_t * Ghost_layer,
   }
 
   P4EST_FREE (owned);
-  p4est_iter_loop_args_destroy (loop_args);
+  if (ws == NULL) {
+    p4est_iter_loop_args_destroy (loop_args);
+  }
+}
+
+void
+p4est_iterate_threaded (p4est_t * p4est, p4est_ghost_t * Ghost_layer,
+                        void *user_data, p4est_iter_volume_t iter_volume,
+                        p4est_iter_face_t iter_face,
+#ifdef P4_TO_P8
+                        p8est_iter_edge_t iter_edge,
+#endif
+                        p4est_iter_corner_t iter_corner)
+{
+  p4est_topidx_t      t;
+  p4est_topidx_t      first_local_tree = p4est->first_local_tree;
+  p4est_topidx_t      last_local_tree = p4est->last_local_tree;
+  p4est_ghost_t       empty_ghost_layer;
+  p4est_ghost_t      *ghost_layer;
+  sc_array_t         *trees = p4est->trees;
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+
+  if (Ghost_layer == NULL) {
+    sc_array_init (&(empty_ghost_layer.ghosts), sizeof (p4est_quadrant_t));
+    empty_ghost_layer.tree_offsets =
+      P4EST_ALLOC_ZERO (p4est_locidx_t, trees->elem_count + 1);
+    empty_ghost_layer.proc_offsets =
+      P4EST_ALLOC_ZERO (p4est_locidx_t, p4est->mpisize + 1);
+    ghost_layer = &empty_ghost_layer;
+  }
+  else {
+    ghost_layer = Ghost_layer;
+  }
+
+  /* the volume callback is tree-local and is distributed across threads;
+   * it must be safe to call concurrently from different threads */
+  if (iter_volume != NULL && first_local_tree >= 0) {
+  /* the static schedule keeps a stable tree-to-thread affinity so that
+   * storage placed by p4est_numa_first_touch stays local to its reader */
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (static)
+#endif
+    for (t = first_local_tree; t <= last_local_tree; t++) {
+      p4est_tree_t       *tree;
+      sc_array_t         *quadrants;
+      size_t              si, n_quads;
+      p4est_iter_volume_info_t info;
+
+      info.p4est = p4est;
+      info.ghost_layer = ghost_layer;
+      info.treeid = t;
+      tree = p4est_tree_array_index (trees, t);
+      quadrants = &(tree->quadrants);
+      n_quads = quadrants->elem_count;
+      for (si = 0; si < n_quads; si++) {
+        info.quad = p4est_quadrant_array_index (quadrants, si);
+        info.quadid = si;
+        iter_volume (&info, user_data);
+      }
+    }
+  }
+
+  if (Ghost_layer == NULL) {
+    P4EST_FREE (empty_ghost_layer.tree_offsets);
+    P4EST_FREE (empty_ghost_layer.proc_offsets);
+  }
+
+  /* the inter-quadrant callbacks share state between neighboring trees
+   * and still go through the serial code path */
+  if (iter_face != NULL || iter_corner != NULL
+#ifdef P4_TO_P8
+      || iter_edge != NULL
+#endif
+    ) {
+    p4est_iterate_ext (p4est, Ghost_layer, user_data, NULL, iter_face,
+#ifdef P4_TO_P8
+                       iter_edge,
+#endif
+                       iter_corner, 0);
+  }
 }
 
 void
@@ -3302,9 +3455,562 @@ p4est_iterate (p4est_t * p4est, p4est_ghost_t * Ghost_layer, void *user_data,
 #endif
                p4est_iter_corner_t iter_corner)
 {
+  double              tstart = 0.;
+
+  if (p4est->inspect != NULL) {
+    tstart = sc_MPI_Wtime ();
+  }
+  P4EST_PHASE_BEGIN (P4EST_STRING "_iterate");
   p4est_iterate_ext (p4est, Ghost_layer, user_data, iter_volume, iter_face,
 #ifdef P4_TO_P8
                      iter_edge,
 #endif
                      iter_corner, 0);
+  P4EST_PHASE_END (P4EST_STRING "_iterate");
+  if (p4est->inspect != NULL) {
+    p4est->inspect->iterate_time += sc_MPI_Wtime () - tstart;
+  }
+}
+
+/** Dispatch context of \ref p4est_iterate_fused. */
+typedef struct p4est_iter_fused
+{
+  int                 num_phases;       /**< number of callback sets */
+  const p4est_iter_phase_t *phases;     /**< the callback sets */
+}
+p4est_iter_fused_t;
+
+static void
+p4est_iter_fused_volume (p4est_iter_volume_info_t * info, void *user_data)
+{
+  int                 i;
+  const p4est_iter_fused_t *fused = (const p4est_iter_fused_t *) user_data;
+
+  for (i = 0; i < fused->num_phases; ++i) {
+    if (fused->phases[i].volume_fn != NULL) {
+      fused->phases[i].volume_fn (info, fused->phases[i].user_data);
+    }
+  }
+}
+
+static void
+p4est_iter_fused_face (p4est_iter_face_info_t * info, void *user_data)
+{
+  int                 i;
+  const p4est_iter_fused_t *fused = (const p4est_iter_fused_t *) user_data;
+
+  for (i = 0; i < fused->num_phases; ++i) {
+    if (fused->phases[i].face_fn != NULL) {
+      fused->phases[i].face_fn (info, fused->phases[i].user_data);
+    }
+  }
+}
+
+#ifdef P4_TO_P8
+
+static void
+p8est_iter_fused_edge (p8est_iter_edge_info_t * info, void *user_data)
+{
+  int                 i;
+  const p4est_iter_fused_t *fused = (const p4est_iter_fused_t *) user_data;
+
+  for (i = 0; i < fused->num_phases; ++i) {
+    if (fused->phases[i].edge_fn != NULL) {
+      fused->phases[i].edge_fn (info, fused->phases[i].user_data);
+    }
+  }
+}
+
+#endif /* P4_TO_P8 */
+
+static void
+p4est_iter_fused_corner (p4est_iter_corner_info_t * info, void *user_data)
+{
+  int                 i;
+  const p4est_iter_fused_t *fused = (const p4est_iter_fused_t *) user_data;
+
+  for (i = 0; i < fused->num_phases; ++i) {
+    if (fused->phases[i].corner_fn != NULL) {
+      fused->phases[i].corner_fn (info, fused->phases[i].user_data);
+    }
+  }
+}
+
+void
+p4est_iterate_fused (p4est_t * p4est, p4est_ghost_t * Ghost_layer,
+                     int num_phases, const p4est_iter_phase_t * phases)
+{
+  int                 i;
+  int                 any_volume, any_face, any_corner;
+#ifdef P4_TO_P8
+  int                 any_edge;
+#endif
+  p4est_iter_fused_t  fused;
+
+  P4EST_ASSERT (num_phases > 0);
+  P4EST_ASSERT (phases != NULL);
+
+  /* only hand dispatchers to the traversal for callback types that at
+   * least one phase provides, keeping the skipping optimizations */
+  any_volume = any_face = any_corner = 0;
+#ifdef P4_TO_P8
+  any_edge = 0;
+#endif
+  for (i = 0; i < num_phases; ++i) {
+    any_volume |= phases[i].volume_fn != NULL;
+    any_face |= phases[i].face_fn != NULL;
+#ifdef P4_TO_P8
+    any_edge |= phases[i].edge_fn != NULL;
+#endif
+    any_corner |= phases[i].corner_fn != NULL;
+  }
+
+  fused.num_phases = num_phases;
+  fused.phases = phases;
+  p4est_iterate (p4est, Ghost_layer, &fused,
+                 any_volume ? p4est_iter_fused_volume : NULL,
+                 any_face ? p4est_iter_fused_face : NULL,
+#ifdef P4_TO_P8
+                 any_edge ? p8est_iter_fused_edge : NULL,
+#endif
+                 any_corner ? p4est_iter_fused_corner : NULL);
+}
+
+void
+p4est_iterate_level (p4est_t * p4est, p4est_ghost_t * Ghost_layer,
+                     int level, void *user_data,
+                     p4est_iter_volume_t iter_volume)
+{
+  p4est_topidx_t      t;
+  p4est_topidx_t      first_local_tree = p4est->first_local_tree;
+  p4est_topidx_t      last_local_tree = p4est->last_local_tree;
+  p4est_ghost_t       empty_ghost_layer;
+  p4est_ghost_t      *ghost_layer;
+  sc_array_t         *trees = p4est->trees;
+  p4est_tree_t       *tree;
+  sc_array_t         *quadrants;
+  p4est_quadrant_t   *q;
+  p4est_quadrant_t    a, ld;
+  size_t              si, n_quads;
+  ssize_t             sidx;
+  p4est_iter_volume_info_t info;
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (0 <= level && level <= P4EST_QMAXLEVEL);
+
+  if (iter_volume == NULL || first_local_tree < 0) {
+    return;
+  }
+
+  if (Ghost_layer == NULL) {
+    sc_array_init (&(empty_ghost_layer.ghosts), sizeof (p4est_quadrant_t));
+    empty_ghost_layer.tree_offsets =
+      P4EST_ALLOC_ZERO (p4est_locidx_t, trees->elem_count + 1);
+    empty_ghost_layer.proc_offsets =
+      P4EST_ALLOC_ZERO (p4est_locidx_t, p4est->mpisize + 1);
+    ghost_layer = &empty_ghost_layer;
+  }
+  else {
+    ghost_layer = Ghost_layer;
+  }
+
+  info.p4est = p4est;
+  info.ghost_layer = ghost_layer;
+
+  for (t = first_local_tree; t <= last_local_tree; t++) {
+    tree = p4est_tree_array_index (trees, t);
+    if (tree->quadrants_per_level[level] == 0) {
+      /* the per-tree level histogram prunes whole trees up front */
+      continue;
+    }
+    info.treeid = t;
+    quadrants = &(tree->quadrants);
+    n_quads = quadrants->elem_count;
+    for (si = 0; si < n_quads; si++) {
+      q = p4est_quadrant_array_index (quadrants, si);
+      if ((int) q->level < level) {
+        continue;
+      }
+      if ((int) q->level > level) {
+        /* since this finer quadrant is a leaf, no leaf of the requested
+         * level lives inside its level-\a level ancestor, so the loop
+         * jumps past the ancestor's last descendant by binary search */
+        p4est_quadrant_ancestor (q, level, &a);
+        p4est_quadrant_last_descendant (&a, &ld, P4EST_QMAXLEVEL);
+        sidx = p4est_find_higher_bound (quadrants, &ld, si);
+        P4EST_ASSERT (sidx >= (ssize_t) si);
+        si = (size_t) sidx;
+        continue;
+      }
+      info.quad = q;
+      info.quadid = si;
+      iter_volume (&info, user_data);
+    }
+  }
+
+  if (Ghost_layer == NULL) {
+    P4EST_FREE (empty_ghost_layer.tree_offsets);
+    P4EST_FREE (empty_ghost_layer.proc_offsets);
+  }
+}
+
+/* event categories stored in the flattened iteration plan */
+#define P4EST_ITER_PLAN_VOLUME  0
+#define P4EST_ITER_PLAN_FACE    1
+#ifdef P4_TO_P8
+#define P8EST_ITER_PLAN_EDGE    2
+#endif
+#define P4EST_ITER_PLAN_CORNER  3
+
+static void
+p4est_iterate_plan_record_volume (p4est_iter_volume_info_t * info,
+                                  void *user_data)
+{
+  p4est_iterate_plan_t *plan = (p4est_iterate_plan_t *) user_data;
+
+  *(int8_t *) sc_array_push (plan->events) = P4EST_ITER_PLAN_VOLUME;
+  *(p4est_iter_volume_info_t *) sc_array_push (plan->volumes) = *info;
+}
+
+static void
+p4est_iterate_plan_record_face (p4est_iter_face_info_t * info,
+                                void *user_data)
+{
+  p4est_iterate_plan_t *plan = (p4est_iterate_plan_t *) user_data;
+  size_t              zz;
+
+  *(int8_t *) sc_array_push (plan->events) = P4EST_ITER_PLAN_FACE;
+  /* the sides view is recreated over the flat storage at replay time */
+  *(p4est_iter_face_info_t *) sc_array_push (plan->faces) = *info;
+  *(size_t *) sc_array_push (plan->face_counts) = info->sides.elem_count;
+  for (zz = 0; zz < info->sides.elem_count; zz++) {
+    *(p4est_iter_face_side_t *) sc_array_push (plan->face_sides) =
+      *(p4est_iter_face_side_t *) sc_array_index (&info->sides, zz);
+  }
+}
+
+#ifdef P4_TO_P8
+
+static void
+p8est_iterate_plan_record_edge (p8est_iter_edge_info_t * info,
+                                void *user_data)
+{
+  p4est_iterate_plan_t *plan = (p4est_iterate_plan_t *) user_data;
+  size_t              zz;
+
+  *(int8_t *) sc_array_push (plan->events) = P8EST_ITER_PLAN_EDGE;
+  *(p8est_iter_edge_info_t *) sc_array_push (plan->edges) = *info;
+  *(size_t *) sc_array_push (plan->edge_counts) = info->sides.elem_count;
+  for (zz = 0; zz < info->sides.elem_count; zz++) {
+    *(p8est_iter_edge_side_t *) sc_array_push (plan->edge_sides) =
+      *(p8est_iter_edge_side_t *) sc_array_index (&info->sides, zz);
+  }
+}
+
+#endif /* P4_TO_P8 */
+
+static void
+p4est_iterate_plan_record_corner (p4est_iter_corner_info_t * info,
+                                  void *user_data)
+{
+  p4est_iterate_plan_t *plan = (p4est_iterate_plan_t *) user_data;
+  size_t              zz;
+
+  *(int8_t *) sc_array_push (plan->events) = P4EST_ITER_PLAN_CORNER;
+  *(p4est_iter_corner_info_t *) sc_array_push (plan->corners) = *info;
+  *(size_t *) sc_array_push (plan->corner_counts) = info->sides.elem_count;
+  for (zz = 0; zz < info->sides.elem_count; zz++) {
+    *(p4est_iter_corner_side_t *) sc_array_push (plan->corner_sides) =
+      *(p4est_iter_corner_side_t *) sc_array_index (&info->sides, zz);
+  }
+}
+
+p4est_iterate_plan_t *
+p4est_iterate_plan_new (p4est_t * p4est, p4est_ghost_t * ghost_layer)
+{
+  p4est_iterate_plan_t *plan;
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+
+  plan = P4EST_ALLOC (p4est_iterate_plan_t, 1);
+  plan->p4est = p4est;
+  plan->ghost_layer = ghost_layer;
+  plan->revision = p4est->revision;
+  plan->events = sc_array_new (sizeof (int8_t));
+  plan->volumes = sc_array_new (sizeof (p4est_iter_volume_info_t));
+  plan->faces = sc_array_new (sizeof (p4est_iter_face_info_t));
+  plan->face_sides = sc_array_new (sizeof (p4est_iter_face_side_t));
+  plan->face_counts = sc_array_new (sizeof (size_t));
+#ifdef P4_TO_P8
+  plan->edges = sc_array_new (sizeof (p8est_iter_edge_info_t));
+  plan->edge_sides = sc_array_new (sizeof (p8est_iter_edge_side_t));
+  plan->edge_counts = sc_array_new (sizeof (size_t));
+#endif
+  plan->corners = sc_array_new (sizeof (p4est_iter_corner_info_t));
+  plan->corner_sides = sc_array_new (sizeof (p4est_iter_corner_side_t));
+  plan->corner_counts = sc_array_new (sizeof (size_t));
+
+  /* run the recursion once and record the flattened visit sequence */
+  p4est_iterate (p4est, ghost_layer, plan,
+                 p4est_iterate_plan_record_volume,
+                 p4est_iterate_plan_record_face,
+#ifdef P4_TO_P8
+                 p8est_iterate_plan_record_edge,
+#endif
+                 p4est_iterate_plan_record_corner);
+
+  return plan;
+}
+
+void
+p4est_iterate_plan_execute_ext (p4est_iterate_plan_t * plan,
+                                void *user_data,
+                                p4est_iter_volume_t iter_volume,
+                                p4est_iter_face_t iter_face,
+#ifdef P4_TO_P8
+                                p8est_iter_edge_t iter_edge,
+#endif
+                                p4est_iter_corner_t iter_corner,
+                                int prefetch)
+{
+  size_t              zz, nevents = plan->events->elem_count;
+  size_t              zv, zf, zfs, zc, zcs;
+  size_t              zvp, nvolumes = plan->volumes->elem_count;
+#ifdef P4_TO_P8
+  size_t              ze, zes;
+  p8est_iter_edge_info_t einfo;
+#endif
+  size_t              scount;
+  int8_t              etype;
+  p4est_iter_volume_info_t vinfo;
+  p4est_iter_face_info_t finfo;
+  p4est_iter_corner_info_t cinfo;
+
+  P4EST_ASSERT (prefetch >= 0);
+  /* the plan records quadrant pointers: any adaptation invalidates it */
+  P4EST_ASSERT (plan->revision == plan->p4est->revision);
+
+  zv = zf = zfs = zc = zcs = 0;
+#ifdef P4_TO_P8
+  ze = zes = 0;
+#endif
+  for (zz = 0; zz < nevents; zz++) {
+    etype = *(int8_t *) sc_array_index (plan->events, zz);
+    switch (etype) {
+    case P4EST_ITER_PLAN_VOLUME:
+      if (prefetch > 0) {
+        /* two-stage lookahead into the user data stream: pull the
+         * quadrant structure at twice the distance so that its payload
+         * pointer is warm when the data prefetch is issued at distance
+         * \a prefetch, hiding both dependent loads behind the callbacks
+         * in between */
+        zvp = zv + 2 * (size_t) prefetch;
+        if (zvp < nvolumes) {
+          P4EST_PREFETCH (((p4est_iter_volume_info_t *)
+                           sc_array_index (plan->volumes, zvp))->quad);
+        }
+        zvp = zv + (size_t) prefetch;
+        if (zvp < nvolumes) {
+          P4EST_PREFETCH (((p4est_iter_volume_info_t *)
+                           sc_array_index (plan->volumes,
+                                           zvp))->quad->p.user_data);
+        }
+      }
+      if (iter_volume != NULL) {
+        vinfo = *(p4est_iter_volume_info_t *)
+          sc_array_index (plan->volumes, zv);
+        iter_volume (&vinfo, user_data);
+      }
+      ++zv;
+      break;
+    case P4EST_ITER_PLAN_FACE:
+      scount = *(size_t *) sc_array_index (plan->face_counts, zf);
+      if (iter_face != NULL) {
+        finfo = *(p4est_iter_face_info_t *) sc_array_index (plan->faces, zf);
+        sc_array_init_view (&finfo.sides, plan->face_sides, zfs, scount);
+        iter_face (&finfo, user_data);
+      }
+      ++zf;
+      zfs += scount;
+      break;
+#ifdef P4_TO_P8
+    case P8EST_ITER_PLAN_EDGE:
+      scount = *(size_t *) sc_array_index (plan->edge_counts, ze);
+      if (iter_edge != NULL) {
+        einfo = *(p8est_iter_edge_info_t *) sc_array_index (plan->edges, ze);
+        sc_array_init_view (&einfo.sides, plan->edge_sides, zes, scount);
+        iter_edge (&einfo, user_data);
+      }
+      ++ze;
+      zes += scount;
+      break;
+#endif
+    case P4EST_ITER_PLAN_CORNER:
+      scount = *(size_t *) sc_array_index (plan->corner_counts, zc);
+      if (iter_corner != NULL) {
+        cinfo = *(p4est_iter_corner_info_t *)
+          sc_array_index (plan->corners, zc);
+        sc_array_init_view (&cinfo.sides, plan->corner_sides, zcs, scount);
+        iter_corner (&cinfo, user_data);
+      }
+      ++zc;
+      zcs += scount;
+      break;
+    default:
+      SC_ABORT_NOT_REACHED ();
+    }
+  }
+}
+
+void
+p4est_iterate_plan_execute (p4est_iterate_plan_t * plan, void *user_data,
+                            p4est_iter_volume_t iter_volume,
+                            p4est_iter_face_t iter_face,
+#ifdef P4_TO_P8
+                            p8est_iter_edge_t iter_edge,
+#endif
+                            p4est_iter_corner_t iter_corner)
+{
+  p4est_iterate_plan_execute_ext (plan, user_data, iter_volume, iter_face,
+#ifdef P4_TO_P8
+                                  iter_edge,
+#endif
+                                  iter_corner, 0);
+}
+
+void
+p4est_iterate_plan_destroy (p4est_iterate_plan_t * plan)
+{
+  sc_array_destroy (plan->events);
+  sc_array_destroy (plan->volumes);
+  sc_array_destroy (plan->faces);
+  sc_array_destroy (plan->face_sides);
+  sc_array_destroy (plan->face_counts);
+#ifdef P4_TO_P8
+  sc_array_destroy (plan->edges);
+  sc_array_destroy (plan->edge_sides);
+  sc_array_destroy (plan->edge_counts);
+#endif
+  sc_array_destroy (plan->corners);
+  sc_array_destroy (plan->corner_sides);
+  sc_array_destroy (plan->corner_counts);
+  P4EST_FREE (plan);
+}
+
+/** Pass the destination arrays of an export through the iteration. */
+typedef struct p4est_iterate_export_data
+{
+  p4est_t            *p4est;        /**< the forest being exported */
+  sc_array_t         *quadids;      /**< 2 * P4EST_HALF indices per face */
+  sc_array_t         *face_codes;   /**< one packed int16 code per face */
+  sc_array_t         *ghost_flags;  /**< one slot bitmask per face */
+}
+p4est_iterate_export_data_t;
+
+/** Flatten one side of a face event into \a P4EST_HALF index slots.
+ * Local quadrants are numbered over the whole process by adding the
+ * tree offset; ghosts keep their index into the ghost array and set
+ * their slot bit in \a gflag.  Unused slots are set to -1.
+ */
+static void
+p4est_iterate_export_fside (p4est_t * p4est, p4est_iter_face_side_t * side,
+                            p4est_locidx_t * ids, int base, uint8_t * gflag)
+{
+  int                 k;
+  p4est_locidx_t      offset;
+  p4est_tree_t       *tree;
+
+  tree = p4est_tree_array_index (p4est->trees, side->treeid);
+  offset = tree->quadrants_offset;
+  if (!side->is_hanging) {
+    ids[0] = side->is.full.is_ghost ?
+      side->is.full.quadid : side->is.full.quadid + offset;
+    if (side->is.full.is_ghost) {
+      *gflag |= (uint8_t) (1 << base);
+    }
+    for (k = 1; k < P4EST_HALF; k++) {
+      ids[k] = -1;
+    }
+  }
+  else {
+    for (k = 0; k < P4EST_HALF; k++) {
+      ids[k] = side->is.hanging.is_ghost[k] ?
+        side->is.hanging.quadid[k] : side->is.hanging.quadid[k] + offset;
+      if (side->is.hanging.is_ghost[k]) {
+        *gflag |= (uint8_t) (1 << (base + k));
+      }
+    }
+  }
+}
+
+static void
+p4est_iterate_export_face (p4est_iter_face_info_t * info, void *user_data)
+{
+  p4est_iterate_export_data_t *ed =
+    (p4est_iterate_export_data_t *) user_data;
+  int                 k;
+  int16_t             code;
+  uint8_t             gflag = 0;
+  p4est_locidx_t     *ids;
+  p4est_iter_face_side_t *sleft, *sright;
+
+  ids = (p4est_locidx_t *)
+    sc_array_push_count (ed->quadids, 2 * P4EST_HALF);
+  sleft = p4est_iter_fside_array_index_int (&info->sides, 0);
+  code = (int16_t) sleft->face;
+  code |= (int16_t) (info->orientation << 6);
+  if (sleft->is_hanging) {
+    code |= (int16_t) (1 << 8);
+  }
+  p4est_iterate_export_fside (ed->p4est, sleft, ids, 0, &gflag);
+  if (info->sides.elem_count > 1) {
+    sright = p4est_iter_fside_array_index_int (&info->sides, 1);
+    code |= (int16_t) (sright->face << 3);
+    if (sright->is_hanging) {
+      code |= (int16_t) (1 << 9);
+    }
+    p4est_iterate_export_fside (ed->p4est, sright,
+                                ids + P4EST_HALF, P4EST_HALF, &gflag);
+  }
+  else {
+    /* a face on the domain boundary has a single full side */
+    code |= (int16_t) (1 << 10);
+    for (k = 0; k < P4EST_HALF; k++) {
+      ids[P4EST_HALF + k] = -1;
+    }
+  }
+  *(int16_t *) sc_array_push (ed->face_codes) = code;
+  *(uint8_t *) sc_array_push (ed->ghost_flags) = gflag;
+}
+
+p4est_locidx_t
+p4est_iterate_export (p4est_t * p4est, p4est_ghost_t * ghost_layer,
+                      sc_array_t * quadids, sc_array_t * face_codes,
+                      sc_array_t * ghost_flags)
+{
+  p4est_iterate_export_data_t ed;
+
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (quadids->elem_size == sizeof (p4est_locidx_t));
+  P4EST_ASSERT (face_codes->elem_size == sizeof (int16_t));
+  P4EST_ASSERT (ghost_flags->elem_size == sizeof (uint8_t));
+
+  sc_array_resize (quadids, 0);
+  sc_array_resize (face_codes, 0);
+  sc_array_resize (ghost_flags, 0);
+  ed.p4est = p4est;
+  ed.quadids = quadids;
+  ed.face_codes = face_codes;
+  ed.ghost_flags = ghost_flags;
+
+  /* one recursion materializes every face event into the flat arrays */
+  p4est_iterate (p4est, ghost_layer, &ed, NULL, p4est_iterate_export_face,
+#ifdef P4_TO_P8
+                 NULL,
+#endif
+                 NULL);
+
+  P4EST_ASSERT (quadids->elem_count ==
+                2 * P4EST_HALF * face_codes->elem_count);
+  return (p4est_locidx_t) face_codes->elem_count;
 }
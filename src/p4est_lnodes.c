@@ -41,6 +41,10 @@
 #include <sc_statistics.h>
 #endif
 
+#if defined P4EST_ENABLE_MPI && defined MPI_VERSION && MPI_VERSION >= 3
+#define P4EST_MPI_DIST_GRAPH
+#endif
+
 #ifndef P4_TO_P8
 #define P4EST_LN_C_OFFSET 4
 #else
@@ -2147,6 +2151,94 @@ p4est_lnodes_test_comm (p4est_t * p4est, p4est_lnodes_data_t * data)
 }
 #endif
 
+/* p4est_lnodes_recv_peer:
+ *
+ * Resolve the node numbers received from one peer process.  Writes only
+ * to the inodes owned by that peer and to this peer's range of the
+ * nonlocal_nodes map, so different peers may be processed concurrently.
+ * Sharer lists are collected into the caller-provided \a sharers array
+ * with peer-local share offsets; the caller concatenates them into
+ * data->inode_sharers and rebases the offsets afterwards.
+ */
+static void
+p4est_lnodes_recv_peer (p4est_t * p4est, p4est_lnodes_data_t * data,
+                        p4est_lnodes_t * lnodes, int j,
+                        sc_array_t * recv, sc_array_t * sharers)
+{
+  int                 k;
+  int                 limit;
+  int                 share_count;
+  size_t              count, info_count, zz;
+  size_t              zindex;
+  sc_array_t         *recv_info = &(data->recv_buf_info[j]);
+  sc_array_t         *inodes = data->inodes;
+  sc_array_t         *sorter;
+  p4est_gloidx_t     *nonlocal_nodes = lnodes->nonlocal_nodes;
+  p4est_locidx_t     *poff = data->poff;
+  p4est_lnodes_buf_info_t *binfo;
+  p4est_locidx_t     *lp;
+  p4est_locidx_t     *inode;
+  int                *ip;
+  int                 nodes_per_face = data->nodes_per_face;
+#ifdef P4_TO_P8
+  int                 nodes_per_edge = data->nodes_per_edge;
+#endif
+  int                 nodes_per_corner = data->nodes_per_corner;
+
+  sorter = sc_array_new (2 * sizeof (p4est_locidx_t));
+  info_count = recv_info->elem_count;
+  count = 0;
+  for (zz = 0; zz < info_count; zz++) {
+    binfo = (p4est_lnodes_buf_info_t *) sc_array_index (recv_info, zz);
+    if (binfo->type >= P4EST_LN_C_OFFSET) {
+      limit = nodes_per_corner;
+    }
+#ifdef P4_TO_P8
+    else if (binfo->type >= P8EST_LN_E_OFFSET) {
+      limit = nodes_per_edge;
+    }
+#endif
+    else {
+      limit = nodes_per_face;
+    }
+    zindex = (size_t) binfo->first_index;
+    for (k = 0; k < limit; k++) {
+      inode = (p4est_locidx_t *) sc_array_index (inodes, zindex);
+      lp = (p4est_locidx_t *) sc_array_index (recv, count++);
+      P4EST_ASSERT (inode[0] == j);
+      P4EST_ASSERT (*lp >= 0);
+      inode[1] = *lp;
+      lp = (p4est_locidx_t *) sc_array_push (sorter);
+      lp[0] = (p4est_locidx_t) inode[1];
+      lp[1] = (p4est_locidx_t) zindex++;
+    }
+    if (binfo->send_sharers) {
+      lp = (p4est_locidx_t *) sc_array_index (recv, count++);
+      share_count = (int) (*lp);
+      P4EST_ASSERT (share_count > 0);
+      P4EST_ASSERT (binfo->share_count == -1);
+      P4EST_ASSERT (binfo->share_offset == -1);
+      binfo->share_count = (int8_t) share_count;
+      binfo->share_offset = (p4est_locidx_t) sharers->elem_count;
+      ip = (int *) sc_array_push_count (sharers, share_count);
+      for (k = 0; k < share_count; k++) {
+        lp = (p4est_locidx_t *) sc_array_index (recv, count++);
+        ip[k] = (int) (*lp);
+        P4EST_ASSERT (0 <= *ip && *ip < p4est->mpisize);
+      }
+    }
+  }
+  P4EST_ASSERT (count == recv->elem_count);
+  P4EST_ASSERT ((p4est_locidx_t) sorter->elem_count ==
+                poff[j + 1] - poff[j]);
+  sc_array_sort (sorter, p4est_locidx_compare);
+  for (zz = 0; zz < sorter->elem_count; zz++) {
+    lp = (p4est_locidx_t *) sc_array_index (sorter, zz);
+    nonlocal_nodes[poff[j] + zz] = lp[1];
+  }
+  sc_array_destroy (sorter);
+}
+
 /* p4est_lnodes_recv:
  *
  * Each process has its sorted receive lists.
@@ -2154,40 +2246,34 @@ p4est_lnodes_test_comm (p4est_t * p4est, p4est_lnodes_data_t * data)
  * When the nodes are received, they are put into a sorter list dedicated just
  * to the process that the nodes come from, this is then sorted in ascending
  * node order.
+ * All messages are drained first; the per-peer resolution then runs over
+ * the buffers, on concurrent threads when the inspect structure asks for
+ * it, and the sharer lists are concatenated in arrival order at the end.
  */
 static void
 p4est_lnodes_recv (p4est_t * p4est, p4est_lnodes_data_t * data,
                    p4est_lnodes_t * lnodes)
 {
   int                 mpisize = p4est->mpisize;
-  int                 i, j, k;
-  int                 limit;
+  int                 i, j;
+  int                 threaded;
   sc_array_t         *recv, *recv_info;
   sc_array_t         *recv_buf;
   sc_array_t         *recv_buf_info = data->recv_buf_info;
-  size_t              count, info_count, zz;
+  sc_array_t         *peer_sharers;
+  size_t              count, zz;
   int                 mpiret;
   sc_MPI_Status       probe_status, recv_status;
   int                 num_recv_procs = 0;
   size_t              total_recv = 0;
   int                *num_recv_expect = P4EST_ALLOC_ZERO (int, mpisize);
+  int                *peers;
   int                 byte_count;
   size_t              elem_count;
   p4est_lnodes_buf_info_t *binfo;
-  size_t              zindex;
-  int                 nodes_per_face = data->nodes_per_face;
-#ifdef P4_TO_P8
-  int                 nodes_per_edge = data->nodes_per_edge;
-#endif
-  int                 nodes_per_corner = data->nodes_per_corner;
-  p4est_locidx_t     *lp;
+  p4est_locidx_t      base;
   int                *ip;
-  p4est_locidx_t     *inode;
   sc_array_t         *inode_sharers = data->inode_sharers;
-  sc_array_t         *inodes = data->inodes;
-  int                 share_count;
-  sc_array_t         *sorter;
-  p4est_gloidx_t     *nonlocal_nodes = lnodes->nonlocal_nodes;
   p4est_locidx_t     *poff = data->poff;
 
   for (i = 0; i < mpisize; i++) {
@@ -2201,12 +2287,13 @@ p4est_lnodes_recv (p4est_t * p4est, p4est_lnodes_data_t * data,
     }
   }
 
-  sorter = sc_array_new (2 * sizeof (p4est_locidx_t));
-
   recv_buf = P4EST_ALLOC (sc_array_t, mpisize);
   for (i = 0; i < mpisize; i++) {
     sc_array_init (&(recv_buf[i]), sizeof (p4est_locidx_t));
   }
+
+  /* drain all messages before any of them is resolved */
+  peers = P4EST_ALLOC (int, num_recv_procs);
   for (i = 0; i < num_recv_procs; i++) {
     mpiret = sc_MPI_Probe (sc_MPI_ANY_SOURCE, P4EST_COMM_LNODES_PASS,
                            p4est->mpicomm, &probe_status);
@@ -2214,7 +2301,6 @@ p4est_lnodes_recv (p4est_t * p4est, p4est_lnodes_data_t * data,
     j = probe_status.MPI_SOURCE;
     P4EST_ASSERT (j != p4est->mpirank && num_recv_expect[j] == 1);
     recv = &(recv_buf[j]);
-    recv_info = &(recv_buf_info[j]);
     mpiret = sc_MPI_Get_count (&probe_status, sc_MPI_BYTE, &byte_count);
     SC_CHECK_MPI (mpiret);
     P4EST_ASSERT (byte_count % ((int) sizeof (p4est_locidx_t)) == 0);
@@ -2225,60 +2311,51 @@ p4est_lnodes_recv (p4est_t * p4est, p4est_lnodes_data_t * data,
                           &recv_status);
     SC_CHECK_MPI (mpiret);
     num_recv_expect[j]--;
+    total_recv += byte_count;
+    peers[i] = j;
+  }
 
-    info_count = recv_info->elem_count;
-    count = 0;
-    for (zz = 0; zz < info_count; zz++) {
-      binfo = (p4est_lnodes_buf_info_t *) sc_array_index (recv_info, zz);
-      if (binfo->type >= P4EST_LN_C_OFFSET) {
-        limit = nodes_per_corner;
-      }
-#ifdef P4_TO_P8
-      else if (binfo->type >= P8EST_LN_E_OFFSET) {
-        limit = nodes_per_edge;
-      }
-#endif
-      else {
-        limit = nodes_per_face;
-      }
-      zindex = (size_t) binfo->first_index;
-      for (k = 0; k < limit; k++) {
-        inode = (p4est_locidx_t *) sc_array_index (inodes, zindex);
-        lp = (p4est_locidx_t *) sc_array_index (recv, count++);
-        P4EST_ASSERT (inode[0] == j);
-        P4EST_ASSERT (*lp >= 0);
-        inode[1] = *lp;
-        lp = (p4est_locidx_t *) sc_array_push (sorter);
-        lp[0] = (p4est_locidx_t) inode[1];
-        lp[1] = (p4est_locidx_t) zindex++;
-      }
-      if (binfo->send_sharers) {
-        lp = (p4est_locidx_t *) sc_array_index (recv, count++);
-        share_count = (int) (*lp);
-        P4EST_ASSERT (share_count > 0);
-        P4EST_ASSERT (binfo->share_count == -1);
-        P4EST_ASSERT (binfo->share_offset == -1);
-        binfo->share_count = (int8_t) share_count;
-        binfo->share_offset = (p4est_locidx_t) inode_sharers->elem_count;
-        ip = (int *) sc_array_push_count (inode_sharers, share_count);
-        for (k = 0; k < share_count; k++) {
-          lp = (p4est_locidx_t *) sc_array_index (recv, count++);
-          ip[k] = (int) (*lp);
-          P4EST_ASSERT (0 <= *ip && *ip < mpisize);
+  /* the peers' node ranges are disjoint; resolve them independently */
+  peer_sharers = P4EST_ALLOC (sc_array_t, num_recv_procs);
+  for (i = 0; i < num_recv_procs; i++) {
+    sc_array_init (&(peer_sharers[i]), sizeof (int));
+  }
+  threaded = (p4est->inspect != NULL && p4est->inspect->lnodes_recv_threads);
+  if (threaded) {
+#pragma omp parallel for schedule (dynamic)
+    for (i = 0; i < num_recv_procs; i++) {
+      p4est_lnodes_recv_peer (p4est, data, lnodes, peers[i],
+                              &recv_buf[peers[i]], &peer_sharers[i]);
+    }
+  }
+  else {
+    for (i = 0; i < num_recv_procs; i++) {
+      p4est_lnodes_recv_peer (p4est, data, lnodes, peers[i],
+                              &recv_buf[peers[i]], &peer_sharers[i]);
+    }
+  }
+
+  /* concatenate the per-peer sharer lists and rebase their offsets */
+  for (i = 0; i < num_recv_procs; i++) {
+    j = peers[i];
+    if (peer_sharers[i].elem_count > 0) {
+      base = (p4est_locidx_t) inode_sharers->elem_count;
+      ip = (int *) sc_array_push_count (inode_sharers,
+                                        peer_sharers[i].elem_count);
+      memcpy (ip, peer_sharers[i].array,
+              peer_sharers[i].elem_count * sizeof (int));
+      recv_info = &(recv_buf_info[j]);
+      for (zz = 0; zz < recv_info->elem_count; zz++) {
+        binfo = (p4est_lnodes_buf_info_t *) sc_array_index (recv_info, zz);
+        if (binfo->send_sharers) {
+          binfo->share_offset += base;
         }
       }
     }
-    P4EST_ASSERT (count == elem_count);
-    total_recv += byte_count;
-    P4EST_ASSERT ((p4est_locidx_t) sorter->elem_count ==
-                  poff[j + 1] - poff[j]);
-    sc_array_sort (sorter, p4est_locidx_compare);
-    for (zz = 0; zz < sorter->elem_count; zz++) {
-      lp = (p4est_locidx_t *) sc_array_index (sorter, zz);
-      nonlocal_nodes[poff[j] + zz] = lp[1];
-    }
-    sc_array_reset (sorter);
+    sc_array_reset (&(peer_sharers[i]));
   }
+  P4EST_FREE (peer_sharers);
+  P4EST_FREE (peers);
 
   if (data->send_requests.elem_count > 0) {
     mpiret = sc_MPI_Waitall ((int) data->send_requests.elem_count,
@@ -2297,7 +2374,6 @@ p4est_lnodes_recv (p4est_t * p4est, p4est_lnodes_data_t * data,
   P4EST_FREE (data->send_buf);
   P4EST_FREE (recv_buf);
   P4EST_FREE (num_recv_expect);
-  sc_array_destroy (sorter);
 }
 
 /* p4est_lnodes_global_and_sharers:
@@ -2375,6 +2451,12 @@ p4est_lnodes_global_and_sharers (p4est_lnodes_data_t * data,
     }
   }
 
+  /* remap each element node from its inode index to the final local
+   * numbering; the entries are independent, so for high degrees this
+   * largest of the tree-local loops is distributed across threads */
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (static) private (inidx, inode)
+#endif
   for (li = 0; li < nlen; li++) {
     inidx = elnodes[li];
     P4EST_ASSERT (0 <= inidx && inidx < num_inodes);
@@ -2569,7 +2651,11 @@ p4est_lnodes_new (p4est_t * p4est, p4est_ghost_t * ghost_layer, int degree)
 #endif
   p4est_lnodes_t     *lnodes = P4EST_ALLOC (p4est_lnodes_t, 1);
   p4est_gloidx_t      gtotal;
+  double              tstart = 0.;
 
+  if (p4est->inspect != NULL) {
+    tstart = sc_MPI_Wtime ();
+  }
   P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_lnodes_new, degree %d\n",
                             degree);
   p4est_log_indent_push ();
@@ -2625,11 +2711,13 @@ p4est_lnodes_new (p4est_t * p4est, p4est_ghost_t * ghost_layer, int degree)
 #endif
   citer = data.nodes_per_corner ? p4est_lnodes_corner_callback : NULL;
 
+  P4EST_PHASE_BEGIN (P4EST_STRING "_lnodes_fill");
   p4est_iterate_ext (p4est, ghost_layer, &data, viter, fiter,
 #ifdef P4_TO_P8
                      eiter,
 #endif
                      citer, 1);
+  P4EST_PHASE_END (P4EST_STRING "_lnodes_fill");
 
 #ifdef P4EST_ENABLE_DEBUG
   for (lj = 0; lj < nlen; lj++) {
@@ -2639,11 +2727,17 @@ p4est_lnodes_new (p4est_t * p4est, p4est_ghost_t * ghost_layer, int degree)
 
   P4EST_ASSERT (p4est_lnodes_test_comm (p4est, &data));
 
+  P4EST_PHASE_BEGIN (P4EST_STRING "_lnodes_comm");
   p4est_lnodes_count_send (&data, p4est, lnodes);
 
   p4est_lnodes_recv (p4est, &data, lnodes);
 
   gtotal = p4est_lnodes_global_and_sharers (&data, lnodes, p4est);
+  P4EST_PHASE_END (P4EST_STRING "_lnodes_comm");
+
+  /* remember the mesh state so p4est_lnodes_update can detect changes */
+  lnodes->revision = p4est->revision;
+  lnodes->partition_offset = p4est->global_first_quadrant[p4est->mpirank];
 
   p4est_lnodes_reset_data (&data, p4est);
 
@@ -2662,9 +2756,169 @@ p4est_lnodes_new (p4est_t * p4est, p4est_ghost_t * ghost_layer, int degree)
   P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING "_lnodes_new with"
                             " %lld global nodes\n",
                             (unsigned long long) gtotal);
+  if (p4est->inspect != NULL) {
+    p4est->inspect->lnodes_time += sc_MPI_Wtime () - tstart;
+  }
   return lnodes;
 }
 
+p4est_locidx_t     *
+p4est_lnodes_sfc_permutation (p4est_lnodes_t * lnodes)
+{
+  const int           vnodes = lnodes->vnodes;
+  const p4est_locidx_t nel = lnodes->num_local_elements;
+  const p4est_locidx_t owned = lnodes->owned_count;
+  p4est_locidx_t      el, nid, next;
+  p4est_locidx_t      k;
+  p4est_locidx_t     *perm;
+
+  perm = P4EST_ALLOC (p4est_locidx_t, owned);
+  for (k = 0; k < owned; ++k) {
+    perm[k] = -1;
+  }
+
+  /* the local elements are stored along the space-filling curve, so
+   * numbering each owned node at its first touch orders the nodes by
+   * the curve position of their earliest touching element */
+  next = 0;
+  for (el = 0; el < nel; ++el) {
+    for (k = 0; k < (p4est_locidx_t) vnodes; ++k) {
+      nid = lnodes->element_nodes[el * vnodes + k];
+      if (nid < owned && perm[nid] == -1) {
+        perm[nid] = next++;
+      }
+    }
+  }
+
+  /* the owner of a node is a touching process, so every owned node has
+   * been visited by at least one local element above */
+  P4EST_ASSERT (next == owned);
+
+  return perm;
+}
+
+p4est_lnodes_blocks_t *
+p4est_lnodes_blocks_new (p4est_lnodes_t * lnodes,
+                         p4est_locidx_t max_block_nodes)
+{
+  const int           vnodes = lnodes->vnodes;
+  const p4est_locidx_t nel = lnodes->num_local_elements;
+  const p4est_locidx_t nln = lnodes->num_local_nodes;
+  const p4est_locidx_t *en = lnodes->element_nodes;
+  int                 k;
+  p4est_locidx_t      el, nid, bfirst, nb, ncount, newnodes;
+  p4est_locidx_t      b, iz, nz, total_nodes;
+  p4est_locidx_t     *stamp, *pos;
+  p4est_lnodes_blocks_t *blocks;
+
+  P4EST_ASSERT (max_block_nodes >= (p4est_locidx_t) vnodes);
+
+  blocks = P4EST_ALLOC (p4est_lnodes_blocks_t, 1);
+  blocks->lnodes = lnodes;
+  blocks->block_offsets = P4EST_ALLOC (p4est_locidx_t, nel + 1);
+  stamp = P4EST_ALLOC (p4est_locidx_t, nln);
+  for (nz = 0; nz < nln; ++nz) {
+    stamp[nz] = -1;
+  }
+
+  /* first pass: close a block whenever taking the next element along
+   * the curve would push its distinct node count past the limit */
+  nb = 0;
+  bfirst = 0;
+  ncount = 0;
+  total_nodes = 0;
+  blocks->block_offsets[0] = 0;
+  for (el = 0; el < nel; ++el) {
+    newnodes = 0;
+    for (k = 0; k < vnodes; ++k) {
+      nid = en[el * vnodes + k];
+      if (stamp[nid] != nb) {
+        stamp[nid] = nb;
+        ++newnodes;
+      }
+    }
+    if (el > bfirst && ncount + newnodes > max_block_nodes) {
+      /* close the block; stale stamps of the rejected attempt are
+       * harmless since this block id is never tested again */
+      total_nodes += ncount;
+      blocks->block_offsets[++nb] = el;
+      bfirst = el;
+      ncount = 0;
+      for (k = 0; k < vnodes; ++k) {
+        nid = en[el * vnodes + k];
+        if (stamp[nid] != nb) {
+          stamp[nid] = nb;
+          ++ncount;
+        }
+      }
+    }
+    else {
+      ncount += newnodes;
+    }
+  }
+  if (nel > 0) {
+    total_nodes += ncount;
+    blocks->block_offsets[++nb] = nel;
+  }
+  blocks->num_blocks = nb;
+  blocks->block_offsets = P4EST_REALLOC (blocks->block_offsets,
+                                         p4est_locidx_t, nb + 1);
+  blocks->node_offsets = P4EST_ALLOC (p4est_locidx_t, nb + 1);
+  blocks->block_nodes = P4EST_ALLOC (p4est_locidx_t, total_nodes);
+  blocks->block_elem_nodes =
+    P4EST_ALLOC (p4est_locidx_t, (size_t) nel * (size_t) vnodes);
+  pos = P4EST_ALLOC (p4est_locidx_t, nln);
+
+  /* second pass: list each block's nodes in ascending order and mirror
+   * element_nodes with positions in that list */
+  for (nz = 0; nz < nln; ++nz) {
+    stamp[nz] = -1;
+  }
+  blocks->node_offsets[0] = 0;
+  for (b = 0; b < nb; ++b) {
+    ncount = 0;
+    for (el = blocks->block_offsets[b];
+         el < blocks->block_offsets[b + 1]; ++el) {
+      for (k = 0; k < vnodes; ++k) {
+        nid = en[el * vnodes + k];
+        if (stamp[nid] != b) {
+          stamp[nid] = b;
+          blocks->block_nodes[blocks->node_offsets[b] + ncount++] = nid;
+        }
+      }
+    }
+    blocks->node_offsets[b + 1] = blocks->node_offsets[b] + ncount;
+    qsort (blocks->block_nodes + blocks->node_offsets[b], (size_t) ncount,
+           sizeof (p4est_locidx_t), p4est_locidx_compare);
+    for (iz = 0; iz < ncount; ++iz) {
+      pos[blocks->block_nodes[blocks->node_offsets[b] + iz]] = iz;
+    }
+    for (el = blocks->block_offsets[b];
+         el < blocks->block_offsets[b + 1]; ++el) {
+      for (k = 0; k < vnodes; ++k) {
+        blocks->block_elem_nodes[el * vnodes + k] =
+          pos[en[el * vnodes + k]];
+      }
+    }
+  }
+  P4EST_ASSERT (blocks->node_offsets[nb] == total_nodes);
+
+  P4EST_FREE (pos);
+  P4EST_FREE (stamp);
+
+  return blocks;
+}
+
+void
+p4est_lnodes_blocks_destroy (p4est_lnodes_blocks_t * blocks)
+{
+  P4EST_FREE (blocks->block_elem_nodes);
+  P4EST_FREE (blocks->block_nodes);
+  P4EST_FREE (blocks->node_offsets);
+  P4EST_FREE (blocks->block_offsets);
+  P4EST_FREE (blocks);
+}
+
 void
 p4est_lnodes_destroy (p4est_lnodes_t * lnodes)
 {
@@ -2686,6 +2940,37 @@ p4est_lnodes_destroy (p4est_lnodes_t * lnodes)
   P4EST_FREE (lnodes);
 }
 
+p4est_lnodes_t     *
+p4est_lnodes_update (p4est_t * p4est, p4est_ghost_t * ghost_layer,
+                     int degree, p4est_lnodes_t * lnodes)
+{
+  int                 mpiret;
+  int                 lchanged, gchanged;
+
+  if (lnodes == NULL) {
+    return p4est_lnodes_new (p4est, ghost_layer, degree);
+  }
+
+  /* check whether the forest changed since the nodes were built:
+   * adaptation bumps the revision counter and repartitioning moves
+   * the process boundaries of the global quadrant enumeration */
+  lchanged = (lnodes->degree != degree ||
+              lnodes->revision != p4est->revision ||
+              lnodes->num_local_elements != p4est->local_num_quadrants ||
+              lnodes->partition_offset !=
+              p4est->global_first_quadrant[p4est->mpirank]);
+  mpiret = sc_MPI_Allreduce (&lchanged, &gchanged, 1, sc_MPI_INT,
+                             sc_MPI_MAX, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  if (!gchanged) {
+    /* the element-to-node map and sharers are still valid */
+    return lnodes;
+  }
+
+  p4est_lnodes_destroy (lnodes);
+  return p4est_lnodes_new (p4est, ghost_layer, degree);
+}
+
 #ifdef P4EST_ENABLE_MPI
 
 static              size_t
@@ -3696,6 +3981,247 @@ p4est_lnodes_share_all (sc_array_t * node_data, p4est_lnodes_t * lnodes)
   return buffer;
 }
 
+p4est_lnodes_buffer_t *
+p4est_lnodes_share_all_fields_begin (sc_array_t ** node_data, int num_fields,
+                                     p4est_lnodes_t * lnodes)
+{
+  int                 mpiret;
+  int                 p, proc;
+  int                 k;
+  sc_array_t         *sharers = lnodes->sharers;
+  int                 npeers = (int) sharers->elem_count;
+  p4est_lnodes_rank_t *lrank;
+  p4est_lnodes_buffer_t *buffer;
+  sc_array_t         *requests;
+  sc_MPI_Request     *request;
+  sc_array_t         *send_bufs;
+  sc_array_t         *send_buf;
+  sc_array_t         *recv_bufs;
+  sc_array_t         *recv_buf;
+  p4est_locidx_t      lz;
+  void               *dest;
+  size_t              zz;
+  size_t              count;
+  size_t              elem_size = node_data[0]->elem_size;
+  sc_MPI_Comm         comm = lnodes->mpicomm;
+  int                 mpirank;
+
+  mpiret = sc_MPI_Comm_rank (comm, &mpirank);
+
+  P4EST_ASSERT (num_fields >= 1);
+#ifdef P4EST_ENABLE_DEBUG
+  for (k = 0; k < num_fields; k++) {
+    P4EST_ASSERT (node_data[k]->elem_size == elem_size);
+    P4EST_ASSERT (node_data[k]->elem_count ==
+                  (size_t) lnodes->num_local_nodes);
+  }
+#endif
+
+  buffer = P4EST_ALLOC (p4est_lnodes_buffer_t, 1);
+  buffer->requests = requests = sc_array_new (sizeof (sc_MPI_Request));
+  buffer->send_buffers = send_bufs = sc_array_new (sizeof (sc_array_t));
+  buffer->recv_buffers = recv_bufs = sc_array_new (sizeof (sc_array_t));
+  sc_array_resize (recv_bufs, (size_t) npeers);
+  sc_array_resize (send_bufs, (size_t) npeers);
+
+  for (p = 0; p < npeers; p++) {
+    lrank = p4est_lnodes_rank_array_index_int (sharers, p);
+    proc = lrank->rank;
+    if (proc == mpirank) {
+      /* there is no buffer for the current process: look in node_data
+       * for values */
+      recv_buf = (sc_array_t *) sc_array_index_int (recv_bufs, p);
+      sc_array_init (recv_buf, elem_size);
+      send_buf = (sc_array_t *) sc_array_index_int (send_bufs, p);
+      sc_array_init (send_buf, elem_size);
+      continue;
+    }
+    count = lrank->shared_nodes.elem_count;
+    if (lrank->shared_nodes.elem_count) {
+      recv_buf = (sc_array_t *) sc_array_index_int (recv_bufs, p);
+      sc_array_init (recv_buf, elem_size);
+      sc_array_resize (recv_buf, count * (size_t) num_fields);
+      request = (sc_MPI_Request *) sc_array_push (requests);
+      mpiret = sc_MPI_Irecv (recv_buf->array,
+                             (int) (count * (size_t) num_fields * elem_size),
+                             sc_MPI_BYTE, proc, P4EST_COMM_LNODES_ALL,
+                             comm, request);
+      SC_CHECK_MPI (mpiret);
+
+      /* pack all fields into one message for this peer */
+      send_buf = (sc_array_t *) sc_array_index_int (send_bufs, p);
+      sc_array_init (send_buf, elem_size);
+      sc_array_resize (send_buf, count * (size_t) num_fields);
+      for (k = 0; k < num_fields; k++) {
+        for (zz = 0; zz < count; zz++) {
+          lz = *((p4est_locidx_t *) sc_array_index (&lrank->shared_nodes,
+                                                    zz));
+          dest = sc_array_index (send_buf, (size_t) k * count + zz);
+          memcpy (dest, node_data[k]->array + elem_size * lz, elem_size);
+        }
+      }
+      request = (sc_MPI_Request *) sc_array_push (requests);
+      mpiret = sc_MPI_Isend (send_buf->array,
+                             (int) (count * (size_t) num_fields * elem_size),
+                             sc_MPI_BYTE, proc, P4EST_COMM_LNODES_ALL,
+                             comm, request);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+
+  return buffer;
+}
+
+p4est_lnodes_buffer_t *
+p4est_lnodes_share_all_fields (sc_array_t ** node_data, int num_fields,
+                               p4est_lnodes_t * lnodes)
+{
+  p4est_lnodes_buffer_t *buffer;
+
+  buffer = p4est_lnodes_share_all_fields_begin (node_data, num_fields,
+                                                lnodes);
+  p4est_lnodes_share_all_end (buffer);
+
+  return buffer;
+}
+
+sc_MPI_Comm
+p4est_lnodes_graph_comm_new (p4est_lnodes_t * lnodes)
+{
+#ifdef P4EST_MPI_DIST_GRAPH
+  int                 mpiret;
+  int                 p, mpirank;
+  int                 npeers = (int) lnodes->sharers->elem_count;
+  int                 nn;
+  int                *neighbors;
+  p4est_lnodes_rank_t *lrank;
+  MPI_Comm            graph_comm;
+
+  mpiret = sc_MPI_Comm_rank (lnodes->mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  /* node sharing is symmetric: sources and destinations coincide */
+  neighbors = P4EST_ALLOC (int, npeers);
+  nn = 0;
+  for (p = 0; p < npeers; p++) {
+    lrank = p4est_lnodes_rank_array_index_int (lnodes->sharers, p);
+    if (lrank->rank != mpirank && lrank->shared_nodes.elem_count > 0) {
+      neighbors[nn++] = lrank->rank;
+    }
+  }
+  mpiret = MPI_Dist_graph_create_adjacent (lnodes->mpicomm,
+                                           nn, neighbors, MPI_UNWEIGHTED,
+                                           nn, neighbors, MPI_UNWEIGHTED,
+                                           MPI_INFO_NULL, 0, &graph_comm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (neighbors);
+
+  return graph_comm;
+#else
+  /* without MPI-3 the collective variant falls back to point-to-point */
+  return sc_MPI_COMM_NULL;
+#endif
+}
+
+p4est_lnodes_buffer_t *
+p4est_lnodes_share_all_graph (sc_array_t * node_data,
+                              p4est_lnodes_t * lnodes,
+                              sc_MPI_Comm graph_comm)
+{
+#ifndef P4EST_MPI_DIST_GRAPH
+  return p4est_lnodes_share_all (node_data, lnodes);
+#else
+  int                 mpiret;
+  int                 p, proc, mpirank;
+  int                 nn, total;
+  int                *counts, *displs;
+  sc_array_t         *sharers = lnodes->sharers;
+  int                 npeers = (int) sharers->elem_count;
+  p4est_lnodes_rank_t *lrank;
+  p4est_lnodes_buffer_t *buffer;
+  sc_array_t         *recv_bufs, *recv_buf;
+  char               *sbuffer, *rbuffer, *mem;
+  p4est_locidx_t      lz;
+  size_t              zz, count;
+  size_t              elem_size = node_data->elem_size;
+
+  if (graph_comm == sc_MPI_COMM_NULL) {
+    return p4est_lnodes_share_all (node_data, lnodes);
+  }
+
+  mpiret = sc_MPI_Comm_rank (lnodes->mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+  P4EST_ASSERT (node_data->elem_count == (size_t) lnodes->num_local_nodes);
+
+  /* the same buffer layout serves sending and receiving: each peer
+   * exchanges the full list of nodes shared with it */
+  counts = P4EST_ALLOC (int, npeers);
+  displs = P4EST_ALLOC (int, npeers);
+  nn = 0;
+  total = 0;
+  for (p = 0; p < npeers; p++) {
+    lrank = p4est_lnodes_rank_array_index_int (sharers, p);
+    if (lrank->rank == mpirank || lrank->shared_nodes.elem_count == 0) {
+      continue;
+    }
+    counts[nn] = (int) (lrank->shared_nodes.elem_count * elem_size);
+    displs[nn] = total;
+    total += counts[nn];
+    ++nn;
+  }
+
+  /* pack the owned values of all shared nodes per peer */
+  sbuffer = mem = P4EST_ALLOC (char, total);
+  rbuffer = P4EST_ALLOC (char, total);
+  for (p = 0; p < npeers; p++) {
+    lrank = p4est_lnodes_rank_array_index_int (sharers, p);
+    if (lrank->rank == mpirank || lrank->shared_nodes.elem_count == 0) {
+      continue;
+    }
+    count = lrank->shared_nodes.elem_count;
+    for (zz = 0; zz < count; zz++) {
+      lz = *((p4est_locidx_t *) sc_array_index (&lrank->shared_nodes, zz));
+      memcpy (mem, node_data->array + elem_size * lz, elem_size);
+      mem += elem_size;
+    }
+  }
+
+  mpiret = MPI_Neighbor_alltoallv (sbuffer, counts, displs, MPI_BYTE,
+                                   rbuffer, counts, displs, MPI_BYTE,
+                                   graph_comm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (sbuffer);
+
+  /* scatter the received stream into per-sharer buffers so the result
+   * looks exactly like the one from p4est_lnodes_share_all */
+  buffer = P4EST_ALLOC (p4est_lnodes_buffer_t, 1);
+  buffer->requests = NULL;
+  buffer->send_buffers = NULL;
+  buffer->recv_buffers = recv_bufs = sc_array_new (sizeof (sc_array_t));
+  sc_array_resize (recv_bufs, (size_t) npeers);
+  mem = rbuffer;
+  for (p = 0; p < npeers; p++) {
+    lrank = p4est_lnodes_rank_array_index_int (sharers, p);
+    proc = lrank->rank;
+    recv_buf = (sc_array_t *) sc_array_index_int (recv_bufs, p);
+    sc_array_init (recv_buf, elem_size);
+    if (proc == mpirank || lrank->shared_nodes.elem_count == 0) {
+      continue;
+    }
+    count = lrank->shared_nodes.elem_count;
+    sc_array_resize (recv_buf, count);
+    memcpy (recv_buf->array, mem, count * elem_size);
+    mem += count * elem_size;
+  }
+  P4EST_ASSERT (mem == rbuffer + total);
+  P4EST_FREE (rbuffer);
+  P4EST_FREE (counts);
+  P4EST_FREE (displs);
+
+  return buffer;
+#endif
+}
+
 void
 p4est_lnodes_buffer_destroy (p4est_lnodes_buffer_t * buffer)
 {
@@ -3724,3 +4250,177 @@ p4est_lnodes_buffer_destroy (p4est_lnodes_buffer_t * buffer)
   }
   P4EST_FREE (buffer);
 }
+
+p4est_lnodes_mixed_t *
+p4est_lnodes_new_mixed (p4est_t * p4est, p4est_ghost_t * ghost_layer,
+                        p4est_lnodes_degree_t degree_fn)
+{
+  int                 mpiret;
+  int                 p, v, m, deg;
+  int                 vnodes;
+  int                *vals;
+  size_t              zz;
+  p4est_topidx_t      nt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *quadrant;
+  p4est_locidx_t      el, nel, nid, lz, ldofs;
+  p4est_locidx_t     *enodes;
+  p4est_gloidx_t      dofs, *gcount;
+  p4est_lnodes_t     *base;
+  p4est_lnodes_mixed_t *lm;
+  p4est_lnodes_rank_t *lrank;
+  p4est_lnodes_buffer_t *buffer;
+  sc_array_t         *comb, *rbuf;
+  sc_array_t          view;
+
+  P4EST_ASSERT (degree_fn != NULL);
+
+  P4EST_GLOBAL_PRODUCTION ("Into " P4EST_STRING "_lnodes_new_mixed\n");
+  p4est_log_indent_push ();
+
+  lm = P4EST_ALLOC (p4est_lnodes_mixed_t, 1);
+
+  /* the degree 2 numbering provides exactly one node per entity:
+   * corners, faces(, edges) and the cell volume, with hanging faces
+   * referencing the parent entity through the face_code logic */
+  lm->base = base = p4est_lnodes_new (p4est, ghost_layer, 2);
+  vnodes = base->vnodes;
+  P4EST_ASSERT (vnodes == P4EST_INSUL);
+  nel = base->num_local_elements;
+  enodes = base->element_nodes;
+
+  /* collect the degree of every local element from the callback */
+  lm->element_degree = P4EST_ALLOC (int, nel);
+  el = 0;
+  for (nt = p4est->first_local_tree; nt <= p4est->last_local_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      quadrant = p4est_quadrant_array_index (&tree->quadrants, zz);
+      deg = degree_fn (p4est, nt, quadrant);
+      P4EST_ASSERT (deg >= 1);
+      lm->element_degree[el++] = deg;
+    }
+  }
+  P4EST_ASSERT (el == nel);
+
+  /* relax the element degrees onto the entities by the minimum rule;
+   * elements hanging on a face or edge reference the parent entity and
+   * thus participate in its minimum, which keeps the numbering
+   * continuous across nonconforming boundaries */
+  lm->entity_degree = P4EST_ALLOC_ZERO (int, base->num_local_nodes);
+  lm->entity_dim = P4EST_ALLOC (int8_t, base->num_local_nodes);
+  memset (lm->entity_dim, -1, base->num_local_nodes * sizeof (int8_t));
+  for (el = 0; el < nel; ++el) {
+    deg = lm->element_degree[el];
+    for (v = 0; v < vnodes; ++v) {
+      nid = enodes[el * vnodes + v];
+      P4EST_ASSERT (0 <= nid && nid < base->num_local_nodes);
+      if (lm->entity_degree[nid] == 0 || deg < lm->entity_degree[nid]) {
+        lm->entity_degree[nid] = deg;
+      }
+      /* the entity dimension counts the edge-midpoint coordinates;
+       * hanging references may see the parent entity from a lower
+       * dimensional position, so the maximum is intrinsic */
+      m = (v % 3 == 1);
+      m += ((v / 3) % 3 == 1);
+#ifdef P4_TO_P8
+      m += (v / 9 == 1);
+#endif
+      if ((int8_t) m > lm->entity_dim[nid]) {
+        lm->entity_dim[nid] = (int8_t) m;
+      }
+    }
+  }
+
+  /* combine degree minimum and dimension maximum over all sharers */
+  comb = sc_array_new_count (2 * sizeof (int),
+                             (size_t) base->num_local_nodes);
+  for (nid = 0; nid < base->num_local_nodes; ++nid) {
+    P4EST_ASSERT (lm->entity_degree[nid] > 0);
+    P4EST_ASSERT (lm->entity_dim[nid] >= 0);
+    vals = (int *) sc_array_index (comb, (size_t) nid);
+    vals[0] = lm->entity_degree[nid];
+    vals[1] = (int) lm->entity_dim[nid];
+  }
+  buffer = p4est_lnodes_share_all (comb, base);
+  for (p = 0; p < (int) base->sharers->elem_count; ++p) {
+    lrank = p4est_lnodes_rank_array_index_int (base->sharers, p);
+    if (lrank->rank == p4est->mpirank) {
+      continue;
+    }
+    rbuf = (sc_array_t *) sc_array_index_int (buffer->recv_buffers, p);
+    P4EST_ASSERT (rbuf->elem_count == lrank->shared_nodes.elem_count);
+    for (zz = 0; zz < lrank->shared_nodes.elem_count; ++zz) {
+      lz = *((p4est_locidx_t *) sc_array_index (&lrank->shared_nodes, zz));
+      vals = (int *) sc_array_index (rbuf, zz);
+      P4EST_ASSERT (vals[0] > 0 && vals[1] >= 0);
+      lm->entity_degree[lz] = SC_MIN (lm->entity_degree[lz], vals[0]);
+      lm->entity_dim[lz] = SC_MAX (lm->entity_dim[lz], (int8_t) vals[1]);
+    }
+  }
+  p4est_lnodes_buffer_destroy (buffer);
+  sc_array_destroy (comb);
+
+  /* the interior degrees of freedom of an entity of dimension m and
+   * degree d number (d - 1)^m; corners always carry one */
+  lm->entity_dofs = P4EST_ALLOC (p4est_locidx_t, base->num_local_nodes);
+  for (nid = 0; nid < base->num_local_nodes; ++nid) {
+    deg = lm->entity_degree[nid];
+    ldofs = 1;
+    for (m = 0; m < (int) lm->entity_dim[nid]; ++m) {
+      ldofs *= (p4est_locidx_t) (deg - 1);
+    }
+    lm->entity_dofs[nid] = ldofs;
+  }
+
+  /* assign contiguous blocks of global numbers in entity order */
+  lm->entity_offset = P4EST_ALLOC (p4est_gloidx_t, base->num_local_nodes);
+  dofs = 0;
+  for (nid = 0; nid < base->owned_count; ++nid) {
+    lm->entity_offset[nid] = dofs;
+    dofs += (p4est_gloidx_t) lm->entity_dofs[nid];
+  }
+  lm->owned_dof_count = dofs;
+
+  gcount = P4EST_ALLOC (p4est_gloidx_t, p4est->mpisize);
+  mpiret = sc_MPI_Allgather (&lm->owned_dof_count, 1, P4EST_MPI_GLOIDX,
+                             gcount, 1, P4EST_MPI_GLOIDX, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  lm->global_dof_offset = 0;
+  lm->global_dof_count = 0;
+  for (p = 0; p < p4est->mpisize; ++p) {
+    if (p < p4est->mpirank) {
+      lm->global_dof_offset += gcount[p];
+    }
+    lm->global_dof_count += gcount[p];
+  }
+  P4EST_FREE (gcount);
+
+  for (nid = 0; nid < base->owned_count; ++nid) {
+    lm->entity_offset[nid] += lm->global_dof_offset;
+  }
+
+  /* the offsets of nonlocal entities are defined on their owners */
+  sc_array_init_data (&view, lm->entity_offset, sizeof (p4est_gloidx_t),
+                      (size_t) base->num_local_nodes);
+  p4est_lnodes_share_owned (&view, base);
+  sc_array_reset (&view);
+
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING "_lnodes_new_mixed with"
+                            " %lld global degrees of freedom\n",
+                            (long long) lm->global_dof_count);
+  return lm;
+}
+
+void
+p4est_lnodes_mixed_destroy (p4est_lnodes_mixed_t * lm)
+{
+  p4est_lnodes_destroy (lm->base);
+  P4EST_FREE (lm->element_degree);
+  P4EST_FREE (lm->entity_degree);
+  P4EST_FREE (lm->entity_dim);
+  P4EST_FREE (lm->entity_dofs);
+  P4EST_FREE (lm->entity_offset);
+  P4EST_FREE (lm);
+}
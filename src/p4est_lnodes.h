@@ -143,6 +143,10 @@ typedef struct p4est_lnodes
   p4est_locidx_t      num_local_elements;
   p4est_lnodes_code_t *face_code;
   p4est_locidx_t     *element_nodes;
+
+  /* bookkeeping for \ref p4est_lnodes_update */
+  long                revision;         /**< forest revision at creation */
+  p4est_gloidx_t      partition_offset; /**< first global quadrant of rank */
 }
 p4est_lnodes_t;
 
@@ -212,6 +216,161 @@ p4est_lnodes_t     *p4est_lnodes_new (p4est_t * p4est,
 
 void                p4est_lnodes_destroy (p4est_lnodes_t * lnodes);
 
+/** Compute a bandwidth-reducing permutation of the owned nodes.
+ * The nodes owned by this process are renumbered in the order of their
+ * first touch when walking the local elements along the space-filling
+ * curve.  Nodes whose touching elements are close on the curve thus
+ * receive close numbers, which reduces the bandwidth of matrices
+ * assembled on the numbering, similar to a reverse Cuthill-McKee
+ * reordering but with no extra cost or communication.  The permutation
+ * is returned instead of being applied to \b lnodes, since the global
+ * numbers of owned nodes are replicated in the nonlocal_nodes arrays
+ * of sharing processes; apply it to the application's matrix and
+ * vector layout, where the reordering is a purely local relabeling of
+ * the owned block [global_offset, global_offset + owned_count).
+ * \param [in] lnodes   A node numbering of any degree.
+ * \return          Array of owned_count entries mapping each current
+ *                  owned node index to its curve-ordered index; it is
+ *                  a bijection on [0, owned_count).  Free it with
+ *                  P4EST_FREE.
+ */
+p4est_locidx_t     *p4est_lnodes_sfc_permutation (p4est_lnodes_t * lnodes);
+
+/** Cache-blocked grouping of the local elements of a node numbering.
+ * Produced by \ref p4est_lnodes_blocks_new.  The local elements are cut
+ * into blocks of consecutive elements along the space-filling curve
+ * such that each block references at most a prescribed number of
+ * distinct nodes.  Per block the referenced nodes are listed in
+ * ascending order, and element_nodes is mirrored with block-local
+ * indices into that list.  An assembly loop can thus accumulate each
+ * block into a dense scratch vector sized by the block's node count,
+ * sized to stay in cache, and scatter the scratch into the global
+ * system once per block; only the scatter touches shared nodes, so
+ * the accumulation threads without conflicts.
+ */
+typedef struct p4est_lnodes_blocks
+{
+  p4est_lnodes_t     *lnodes;   /**< the numbering; borrowed */
+  p4est_locidx_t      num_blocks;       /**< number of element blocks */
+  p4est_locidx_t     *block_offsets;    /**< num_blocks + 1 entries;
+                                             block b covers the elements
+                                             [block_offsets[b],
+                                             block_offsets[b + 1]) */
+  p4est_locidx_t     *node_offsets;     /**< num_blocks + 1 offsets into
+                                             block_nodes */
+  p4est_locidx_t     *block_nodes;      /**< per block: the local node
+                                             indices it references, in
+                                             ascending order */
+  p4est_locidx_t     *block_elem_nodes; /**< same extent and layout as
+                                             element_nodes, holding
+                                             block-local positions in
+                                             the block's slice of
+                                             block_nodes */
+}
+p4est_lnodes_blocks_t;
+
+/** Cut the local elements into cache-sized blocks of the curve order.
+ * Purely local; see \ref p4est_lnodes_blocks_t for the layout.
+ * \param [in] lnodes   A node numbering of any degree.
+ * \param [in] max_block_nodes  Largest number of distinct nodes one
+ *                      block may reference; choose it so that a scratch
+ *                      vector of this many entries fits the targeted
+ *                      cache level.  It must be at least vnodes.
+ * \return              Blocking to free with
+ *                      \ref p4est_lnodes_blocks_destroy.
+ */
+p4est_lnodes_blocks_t *p4est_lnodes_blocks_new (p4est_lnodes_t * lnodes,
+                                                p4est_locidx_t
+                                                max_block_nodes);
+
+/** Free an element blocking.  The node numbering is not touched. */
+void                p4est_lnodes_blocks_destroy (p4est_lnodes_blocks_t *
+                                                 blocks);
+
+/** Refresh a node numbering after adaptation or repartitioning.
+ * This is a collective convenience wrapper for the common setup cycle.
+ * If the forest is unchanged since \b lnodes was created, which is
+ * verified globally from the forest revision counter and the partition
+ * boundaries, \b lnodes is returned as is and no construction runs.
+ * Otherwise \b lnodes is destroyed and rebuilt from the current forest.
+ * \param [in] p4est        The forest, fully 2:1 balanced.
+ * \param [in] ghost_layer  Ghost layer matching the current forest.
+ * \param [in] degree       The degree that was used to create \b lnodes.
+ * \param [in] lnodes       Node numbering to refresh, or NULL to build
+ *                          one from scratch.
+ * \return                  A node numbering valid for the current forest;
+ *                          either \b lnodes itself or a replacement.
+ */
+p4est_lnodes_t     *p4est_lnodes_update (p4est_t * p4est,
+                                         p4est_ghost_t * ghost_layer,
+                                         int degree,
+                                         p4est_lnodes_t * lnodes);
+
+/** Callback to report the polynomial degree of a local element.
+ * It will typically read the degree from the quadrant's user data.
+ * \return          The degree of the element; it must be at least 1.
+ */
+typedef int         (*p4est_lnodes_degree_t) (p4est_t * p4est,
+                                              p4est_topidx_t which_tree,
+                                              p4est_quadrant_t * quadrant);
+
+/** Store a mixed-order parallel numbering for p-adaptive elements.
+ *
+ * The numbering is organized by topological entity: every corner, face
+ * and cell volume of the mesh is one entity, identified with one node
+ * of an internal degree 2 numbering kept in \a base.  An entity of
+ * topological dimension m carries (d - 1)^m contiguous global degrees
+ * of freedom, where d is the minimum of the degrees of the elements
+ * referencing the entity; corners always carry one.  The minimum rule
+ * makes the numbering continuous between elements of different degree.
+ *
+ * The degrees of freedom of element k are gathered by walking the
+ * vnodes entities in base->element_nodes for k and expanding each into
+ * the block [entity_offset[n], entity_offset[n] + entity_dofs[n]).
+ * Elements hanging on a face reference the parent entity exactly as in
+ * \a base, so base->face_code and \ref p4est_lnodes_decode identify
+ * the hanging constraints; the interpolation acts on the entity
+ * degrees stored here.
+ *
+ * All arrays indexed by entity run over base->num_local_nodes entries,
+ * with the owned entities first as usual.  The global blocks are
+ * assigned in ascending order of the global entity numbers, so the
+ * degrees of freedom owned by this process are exactly
+ * [global_dof_offset, global_dof_offset + owned_dof_count).
+ */
+typedef struct p4est_lnodes_mixed
+{
+  p4est_lnodes_t     *base;     /**< degree 2 numbering: one node per
+                                     entity; owned by this structure */
+  int                *element_degree;   /**< degree of every local element */
+  int                *entity_degree;    /**< minimum rule degree per entity */
+  int8_t             *entity_dim;       /**< topological dimension per entity */
+  p4est_locidx_t     *entity_dofs;      /**< degrees of freedom per entity */
+  p4est_gloidx_t     *entity_offset;    /**< first global dof per entity */
+  p4est_gloidx_t      owned_dof_count;  /**< dofs owned by this process */
+  p4est_gloidx_t      global_dof_offset;        /**< first dof owned here */
+  p4est_gloidx_t      global_dof_count; /**< dofs over all processes */
+}
+p4est_lnodes_mixed_t;
+
+/** Build a mixed-order continuous numbering from per-element degrees.
+ * This is collective over all processes of the forest, which must be
+ * 2:1 balanced as for \ref p4est_lnodes_new.
+ * \param [in] p4est        The forest, fully 2:1 balanced.
+ * \param [in] ghost_layer  Full ghost layer of the forest.
+ * \param [in] degree_fn    Called once for every local element to
+ *                          obtain its polynomial degree.
+ * \return                  A mixed-order numbering to be destroyed with
+ *                          \ref p4est_lnodes_mixed_destroy.
+ */
+p4est_lnodes_mixed_t *p4est_lnodes_new_mixed (p4est_t * p4est,
+                                              p4est_ghost_t * ghost_layer,
+                                              p4est_lnodes_degree_t
+                                              degree_fn);
+
+/** Free a mixed-order numbering, including the internal base lnodes. */
+void                p4est_lnodes_mixed_destroy (p4est_lnodes_mixed_t * lm);
+
 /** Expand the ghost layer to include the support of all nodes supported on
  * the local partition.
  *
@@ -236,6 +395,46 @@ void                p4est_ghost_expand_by_lnodes (p4est_t * p4est,
                                                   p4est_lnodes_t * lnodes,
                                                   p4est_ghost_t * ghost);
 
+/** Context for split node-supported ghost expansion.
+ * It persists across expansions and remembers the communication
+ * pattern of the last one; see \ref p4est_ghost_expand_by_lnodes_begin.
+ */
+typedef struct p4est_ghost_expand_lnodes p4est_ghost_expand_lnodes_t;
+
+/** Allocate a reusable context for split node-supported expansion. */
+p4est_ghost_expand_lnodes_t *p4est_ghost_expand_lnodes_new (void);
+
+/** Start a node-supported ghost expansion that completes later.
+ * Together with \ref p4est_ghost_expand_by_lnodes_end this splits
+ * \ref p4est_ghost_expand_by_lnodes around other work of the caller.
+ * The begin call checksums the sharers array of \b lnodes; if it
+ * matches the pattern of the previous expansion through the same
+ * context, on the same ghost layer and forest revision, the ghost
+ * layer already contains this expansion and the pair degenerates to a
+ * noop, eliminating the redundant discovery round after a p-adaptation
+ * that left the node sharing pattern unchanged.
+ * \param [in,out] exp      Context from
+ *                          \ref p4est_ghost_expand_lnodes_new; no other
+ *                          begin may be pending on it.
+ * \param [in] p4est        The forest of the ghost layer.
+ * \param [in] lnodes       The nodes to support; it must stay alive
+ *                          until the matching end call.
+ * \param [in,out] ghost    The ghost layer to be expanded.
+ */
+void                p4est_ghost_expand_by_lnodes_begin
+  (p4est_ghost_expand_lnodes_t * exp, p4est_t * p4est,
+   p4est_lnodes_t * lnodes, p4est_ghost_t * ghost);
+
+/** Complete a node-supported ghost expansion.
+ * \param [in,out] exp      Context with a pending begin call.
+ */
+void                p4est_ghost_expand_by_lnodes_end
+  (p4est_ghost_expand_lnodes_t * exp);
+
+/** Free an expansion context.  No begin call may be pending. */
+void                p4est_ghost_expand_lnodes_destroy
+  (p4est_ghost_expand_lnodes_t * exp);
+
 /** Partition using weights based on the number of nodes assigned to each
  * element in lnodes
  *
@@ -345,6 +544,62 @@ void                p4est_lnodes_share_all_end (p4est_lnodes_buffer_t *
 p4est_lnodes_buffer_t *p4est_lnodes_share_all (sc_array_t * node_data,
                                                p4est_lnodes_t * lnodes);
 
+/** p4est_lnodes_share_all_fields_begin
+ *
+ * Share \a num_fields node data arrays at once, packing all fields into
+ * a single message per peer so that the latency of the exchange does not
+ * grow with the number of fields.  All arrays must have the same element
+ * size and one entry per local node.  On completion,
+ * \a buffer->recv_buffers[j] contains, for each sharing process, the
+ * entries of field 0 first, followed by the entries of field 1, and so
+ * on, each section laid out as in \ref p4est_lnodes_share_all_begin.
+ *
+ * The exchange is completed by passing the returned buffer to
+ * p4est_lnodes_share_all_end; the buffer must then be destroyed with
+ * p4est_lnodes_buffer_destroy.
+ */
+p4est_lnodes_buffer_t *p4est_lnodes_share_all_fields_begin (sc_array_t **
+                                                            node_data,
+                                                            int num_fields,
+                                                            p4est_lnodes_t *
+                                                            lnodes);
+
+/** Equivalent to calling p4est_lnodes_share_all_end directly after
+ * p4est_lnodes_share_all_fields_begin.  Use if there is no local work that
+ * can be done to mask the communication cost.
+ * \return          A fully initialized buffer that contains the received
+ *                  data of all fields.  After processing this data, the
+ *                  buffer must be freed with p4est_lnodes_buffer_destroy.
+ */
+p4est_lnodes_buffer_t *p4est_lnodes_share_all_fields (sc_array_t **
+                                                      node_data,
+                                                      int num_fields,
+                                                      p4est_lnodes_t *
+                                                      lnodes);
+
+/** Create a distributed graph communicator for the node sharing pattern.
+ * The symmetric neighbor list is taken from the sharers array, so the
+ * fixed communication pattern is exposed to the MPI library once per
+ * partition and can be route-optimized.
+ * \return          A graph communicator to pass to
+ *                  \ref p4est_lnodes_share_all_graph, to be freed with
+ *                  \ref p4est_ghost_graph_comm_destroy.  Without MPI-3
+ *                  support this is sc_MPI_COMM_NULL, in which case the
+ *                  _graph variant falls back to point-to-point messages.
+ */
+sc_MPI_Comm         p4est_lnodes_graph_comm_new (p4est_lnodes_t * lnodes);
+
+/** Share data of all shared nodes with one neighborhood collective.
+ * Identical in semantics to \ref p4est_lnodes_share_all; the returned
+ * buffer holds the received values per sharer and must be freed with
+ * \ref p4est_lnodes_buffer_destroy.
+ * \param [in] graph_comm   Created by \ref p4est_lnodes_graph_comm_new
+ *                          from the same node numbering.
+ */
+p4est_lnodes_buffer_t *p4est_lnodes_share_all_graph (sc_array_t * node_data,
+                                                     p4est_lnodes_t * lnodes,
+                                                     sc_MPI_Comm graph_comm);
+
 void                p4est_lnodes_buffer_destroy (p4est_lnodes_buffer_t *
                                                  buffer);
 
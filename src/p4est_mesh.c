@@ -92,6 +92,104 @@ mesh_corner_allocate (p4est_mesh_t * mesh, p4est_locidx_t clen,
   return cornerid;
 }
 
+/** Staging context passed through p4est_iterate while filling the mesh.
+ * The face and corner callbacks append to the growable mesh arrays only
+ * through this context, and the staged records are merged serially after
+ * the iteration.  All writes that remain inside the callbacks target
+ * index-disjoint entries per face or corner, so each thread of a future
+ * threaded iteration mode can own one filler without write conflicts.
+ */
+typedef struct p4est_mesh_filler
+{
+  p4est_mesh_t       *mesh;
+  sc_array_t          half_source;    /**< quad_to_quad index per record */
+  sc_array_t          half_entries;   /**< P4EST_HALF quadrant numbers */
+  sc_array_t          corner_source;  /**< quad_to_corner index per record */
+  sc_array_t          corner_count;   /**< corner list length per record */
+  sc_array_t          corner_quad;    /**< concatenated corner lists */
+  sc_array_t          corner_corner;  /**< concatenated corner numbers */
+}
+p4est_mesh_filler_t;
+
+static void
+p4est_mesh_filler_init (p4est_mesh_filler_t * filler, p4est_mesh_t * mesh)
+{
+  filler->mesh = mesh;
+  sc_array_init (&filler->half_source, sizeof (p4est_locidx_t));
+  sc_array_init (&filler->half_entries,
+                 P4EST_HALF * sizeof (p4est_locidx_t));
+  sc_array_init (&filler->corner_source, sizeof (p4est_locidx_t));
+  sc_array_init (&filler->corner_count, sizeof (p4est_locidx_t));
+  sc_array_init (&filler->corner_quad, sizeof (p4est_locidx_t));
+  sc_array_init (&filler->corner_corner, sizeof (int8_t));
+}
+
+/** Record one corner list for later insertion into the mesh. */
+static void
+mesh_corner_stage (p4est_mesh_filler_t * filler, p4est_locidx_t in_qtoc,
+                   p4est_locidx_t clen, const p4est_locidx_t * cquads,
+                   const int8_t * ccorners)
+{
+  P4EST_ASSERT (clen > 0);
+
+  *(p4est_locidx_t *) sc_array_push (&filler->corner_source) = in_qtoc;
+  *(p4est_locidx_t *) sc_array_push (&filler->corner_count) = clen;
+  memcpy (sc_array_push_count (&filler->corner_quad, (size_t) clen),
+          cquads, clen * sizeof (p4est_locidx_t));
+  memcpy (sc_array_push_count (&filler->corner_corner, (size_t) clen),
+          ccorners, clen * sizeof (int8_t));
+}
+
+/** Merge staged records into the mesh and reset the filler.
+ * The merge runs serially and preserves the staging order, so a single
+ * filler reproduces the arrays the callbacks used to build directly.
+ */
+static void
+p4est_mesh_filler_merge (p4est_mesh_filler_t * filler)
+{
+  int8_t             *pccorner;
+  size_t              zz, coffset;
+  p4est_locidx_t      in_qtoq, in_qtoc, clen;
+  p4est_locidx_t      cornerid, cornerid_offset;
+  p4est_locidx_t     *pcquad;
+  p4est_mesh_t       *mesh = filler->mesh;
+
+  /* assign hanging-face entries in staging order */
+  for (zz = 0; zz < filler->half_source.elem_count; ++zz) {
+    in_qtoq = *(p4est_locidx_t *) sc_array_index (&filler->half_source, zz);
+    P4EST_ASSERT (mesh->quad_to_quad[in_qtoq] == -1);
+    mesh->quad_to_quad[in_qtoq] =
+      (p4est_locidx_t) mesh->quad_to_half->elem_count;
+    memcpy (sc_array_push (mesh->quad_to_half),
+            sc_array_index (&filler->half_entries, zz),
+            P4EST_HALF * sizeof (p4est_locidx_t));
+  }
+
+  /* assign corner lists in staging order */
+  cornerid_offset = mesh->local_num_quadrants + mesh->ghost_num_quadrants;
+  coffset = 0;
+  for (zz = 0; zz < filler->corner_source.elem_count; ++zz) {
+    in_qtoc = *(p4est_locidx_t *) sc_array_index (&filler->corner_source, zz);
+    clen = *(p4est_locidx_t *) sc_array_index (&filler->corner_count, zz);
+    P4EST_ASSERT (mesh->quad_to_corner[in_qtoc] == -1);
+    cornerid = mesh_corner_allocate (mesh, clen, &pcquad, &pccorner);
+    mesh->quad_to_corner[in_qtoc] = cornerid_offset + cornerid;
+    memcpy (pcquad, sc_array_index (&filler->corner_quad, coffset),
+            clen * sizeof (p4est_locidx_t));
+    memcpy (pccorner, sc_array_index (&filler->corner_corner, coffset),
+            clen * sizeof (int8_t));
+    coffset += (size_t) clen;
+  }
+  P4EST_ASSERT (coffset == filler->corner_quad.elem_count);
+
+  sc_array_reset (&filler->half_source);
+  sc_array_reset (&filler->half_entries);
+  sc_array_reset (&filler->corner_source);
+  sc_array_reset (&filler->corner_count);
+  sc_array_reset (&filler->corner_quad);
+  sc_array_reset (&filler->corner_corner);
+}
+
 static void
 mesh_iter_corner (p4est_iter_corner_info_t * info, void *user_data)
 {
@@ -102,13 +200,12 @@ mesh_iter_corner (p4est_iter_corner_info_t * info, void *user_data)
   int                 pref, pset;
 #endif
   int                 visited[P4EST_CHILDREN];
-  int8_t             *pccorner;
+  int8_t              ccorner;
   size_t              cz, zz;
   sc_array_t         *trees;
   p4est_locidx_t      qoffset, qid1, qid2;
-  p4est_locidx_t      cornerid_offset, cornerid;
-  p4est_locidx_t     *pcquad;
-  p4est_mesh_t       *mesh = (p4est_mesh_t *) user_data;
+  p4est_mesh_filler_t *filler = (p4est_mesh_filler_t *) user_data;
+  p4est_mesh_t       *mesh = filler->mesh;
   p4est_iter_corner_side_t *side1, *side2;
   p4est_tree_t       *tree1, *tree2;
   p4est_connectivity_t *conn;
@@ -122,7 +219,6 @@ mesh_iter_corner (p4est_iter_corner_info_t * info, void *user_data)
   }
   conn = info->p4est->connectivity;
   trees = info->p4est->trees;
-  cornerid_offset = mesh->local_num_quadrants + mesh->ghost_num_quadrants;
 
   if (info->tree_boundary == P4EST_CONNECT_FACE) {
     /* This corner is inside an inter-tree face */
@@ -197,21 +293,19 @@ mesh_iter_corner (p4est_iter_corner_info_t * info, void *user_data)
           P4EST_ASSERT (0 <= qid1 && qid1 < mesh->local_num_quadrants);
           P4EST_ASSERT (mesh->quad_to_corner[P4EST_CHILDREN * qid1 +
                                              side1->corner] == -1);
-          cornerid = mesh_corner_allocate (mesh, 1, &pcquad, &pccorner);
-          mesh->quad_to_corner[P4EST_CHILDREN * qid1 + side1->corner] =
-            cornerid_offset + cornerid;
-          *pcquad = qid2;
-          *pccorner = side2->corner;
+          ccorner = side2->corner;
+          mesh_corner_stage (filler,
+                             P4EST_CHILDREN * qid1 + side1->corner, 1,
+                             &qid2, &ccorner);
         }
         if (!side2->is_ghost) {
           P4EST_ASSERT (0 <= qid2 && qid2 < mesh->local_num_quadrants);
           P4EST_ASSERT (mesh->quad_to_corner[P4EST_CHILDREN * qid2 +
                                              side2->corner] == -1);
-          cornerid = mesh_corner_allocate (mesh, 1, &pcquad, &pccorner);
-          mesh->quad_to_corner[P4EST_CHILDREN * qid2 + side2->corner] =
-            cornerid_offset + cornerid;
-          *pcquad = qid1;
-          *pccorner = side1->corner;
+          ccorner = side1->corner;
+          mesh_corner_stage (filler,
+                             P4EST_CHILDREN * qid2 + side2->corner, 1,
+                             &qid1, &ccorner);
         }
         visited[j] = 1;
         break;
@@ -320,12 +414,9 @@ mesh_iter_corner (p4est_iter_corner_info_t * info, void *user_data)
           continue;
         }
 
-        /* Allocate and fill corner information in the mesh structure */
-        cornerid = mesh_corner_allocate (mesh, goodones, &pcquad, &pccorner);
-        mesh->quad_to_corner[P4EST_CHILDREN * qid1 + c1] =
-          cornerid_offset + cornerid;
-        memcpy (pcquad, cquads, goodones * sizeof (p4est_locidx_t));
-        memcpy (pccorner, ccorners, goodones * sizeof (int8_t));
+        /* Stage the corner information for insertion after iteration */
+        mesh_corner_stage (filler, P4EST_CHILDREN * qid1 + c1,
+                           goodones, cquads, ccorners);
       }
     }
     P4EST_FREE (cquads);
@@ -389,18 +480,64 @@ mesh_iter_corner (p4est_iter_corner_info_t * info, void *user_data)
   }
 }
 
+/** Check whether a face touches a quadrant within the mesh level window. */
+static int
+mesh_face_in_window (p4est_mesh_t * mesh, p4est_iter_face_info_t * info)
+{
+  int                 h;
+  int                 lmin, lmax, level;
+  size_t              iz;
+  p4est_iter_face_side_t *side;
+  p4est_quadrant_t   *q;
+
+  if (mesh->level_min <= 0 && mesh->level_max >= P4EST_QMAXLEVEL) {
+    return 1;
+  }
+  lmin = P4EST_QMAXLEVEL;
+  lmax = 0;
+  for (iz = 0; iz < info->sides.elem_count; ++iz) {
+    side = (p4est_iter_face_side_t *) sc_array_index (&info->sides, iz);
+    if (!side->is_hanging) {
+      q = side->is.full.quad;
+      if (q != NULL) {
+        level = (int) q->level;
+        lmin = SC_MIN (lmin, level);
+        lmax = SC_MAX (lmax, level);
+      }
+    }
+    else {
+      for (h = 0; h < P4EST_HALF; ++h) {
+        q = side->is.hanging.quad[h];
+        if (q != NULL) {
+          level = (int) q->level;
+          lmin = SC_MIN (lmin, level);
+          lmax = SC_MAX (lmax, level);
+          break;
+        }
+      }
+    }
+  }
+  return !(lmax < mesh->level_min || lmin > mesh->level_max);
+}
+
 static void
 mesh_iter_face (p4est_iter_face_info_t * info, void *user_data)
 {
   int                 h;
   int                 swapsides;
-  p4est_mesh_t       *mesh = (p4est_mesh_t *) user_data;
+  p4est_mesh_filler_t *filler = (p4est_mesh_filler_t *) user_data;
+  p4est_mesh_t       *mesh = filler->mesh;
   p4est_locidx_t      jl, jl2, jls[P4EST_HALF];
-  p4est_locidx_t      in_qtoq, halfindex;
+  p4est_locidx_t      in_qtoq;
   p4est_locidx_t     *halfentries;
   p4est_tree_t       *tree;
   p4est_iter_face_side_t *side, *side2, *tempside;
 
+  /* skip faces that do not touch the requested level window */
+  if (!mesh_face_in_window (mesh, info)) {
+    return;
+  }
+
   if (info->sides.elem_count == 1) {
     /* this face is on an outside boundary of the forest */
     P4EST_ASSERT (info->orientation == 0);
@@ -510,11 +647,11 @@ mesh_iter_face (p4est_iter_face_info_t * info, void *user_data)
         in_qtoq = P4EST_FACES * jl + side->face;
         P4EST_ASSERT (mesh->quad_to_quad[in_qtoq] == -1);
         P4EST_ASSERT (mesh->quad_to_face[in_qtoq] == -25);
-        halfindex = (p4est_locidx_t) mesh->quad_to_half->elem_count;
-        mesh->quad_to_quad[in_qtoq] = halfindex;
         mesh->quad_to_face[in_qtoq] =
           P4EST_FACES * (info->orientation - P4EST_HALF) + side2->face;
-        halfentries = (p4est_locidx_t *) sc_array_push (mesh->quad_to_half);
+        /* stage the half entries; quad_to_quad is assigned in the merge */
+        *(p4est_locidx_t *) sc_array_push (&filler->half_source) = in_qtoq;
+        halfentries = (p4est_locidx_t *) sc_array_push (&filler->half_entries);
         for (h = 0; h < P4EST_HALF; ++h) {
           halfentries[h] = jls[h];
         }
@@ -534,27 +671,132 @@ mesh_iter_face (p4est_iter_face_info_t * info, void *user_data)
   }
 }
 
+/** Fill the optional quadrant-to-tree and per-level lists directly.
+ * This replaces the former volume callback: the information depends only
+ * on the local quadrant sequence and needs no neighborhood iteration.
+ */
 static void
-mesh_iter_volume (p4est_iter_volume_info_t * info, void *user_data)
+mesh_fill_volume (p4est_t * p4est, p4est_mesh_t * mesh)
 {
-  p4est_mesh_t       *mesh = (p4est_mesh_t *) user_data;
+  size_t              zz;
+  p4est_topidx_t      jt;
+  p4est_locidx_t      qid;
   p4est_tree_t       *tree;
-  p4est_locidx_t     *quadid;
-  int                 level = info->quad->level;
+  p4est_quadrant_t   *q;
+
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      qid = tree->quadrants_offset + (p4est_locidx_t) zz;
+      if (mesh->quad_to_tree != NULL) {
+        mesh->quad_to_tree[qid] = jt;
+      }
+      if (mesh->quad_level != NULL) {
+        q = p4est_quadrant_array_index (&tree->quadrants, zz);
+        *(p4est_locidx_t *) sc_array_push (mesh->quad_level + q->level) =
+          qid;
+      }
+    }
+  }
+}
 
-  /* We could use a static quadrant counter, but that gets uglier */
-  tree = p4est_tree_array_index (info->p4est->trees, info->treeid);
-  P4EST_ASSERT (0 <= info->quadid &&
-                info->quadid < (p4est_locidx_t) tree->quadrants.elem_count);
+/* The packed face adjacency stores one byte-offset face code followed by
+ * the neighbor number as a zigzag base-128 varint delta per face.  The
+ * face code offset makes the quad_to_face values non-negative. */
+#define P4EST_MESH_PACKED_SHIFT (P4EST_HALF * P4EST_FACES)
 
-  if (mesh->quad_to_tree != NULL) {
-    mesh->quad_to_tree[tree->quadrants_offset + info->quadid] = info->treeid;
+/** Append one unsigned base-128 varint to the packed stream. */
+static void
+mesh_packed_push (sc_array_t * packed, uint32_t u)
+{
+  while (u >= 0x80) {
+    *(uint8_t *) sc_array_push (packed) = (uint8_t) (u | 0x80);
+    u >>= 7;
   }
+  *(uint8_t *) sc_array_push (packed) = (uint8_t) u;
+}
 
-  if (mesh->quad_level != NULL) {
-    quadid = (p4est_locidx_t *) sc_array_push (mesh->quad_level + level);
-    *quadid = tree->quadrants_offset + info->quadid;
+/** Decode the face code and neighbor number of one quadrant face.
+ * We skip over the faces preceding \a face, which is cheap since the
+ * iterator below visits the faces of a quadrant in ascending order.
+ */
+static void
+mesh_packed_fetch (p4est_mesh_t * mesh, p4est_locidx_t qid, int face,
+                   p4est_locidx_t * qtq, int *qtf)
+{
+  int                 i, shift;
+  uint8_t             byte;
+  uint32_t            u;
+  const uint8_t      *cursor;
+
+  P4EST_ASSERT (mesh->quad_to_packed != NULL);
+  P4EST_ASSERT (0 <= qid && qid < mesh->local_num_quadrants);
+  P4EST_ASSERT (0 <= face && face < P4EST_FACES);
+
+  cursor = (const uint8_t *)
+    sc_array_index (mesh->quad_to_packed,
+                    (size_t) mesh->quad_packed_offset[qid]);
+  for (i = 0;; ++i) {
+    *qtf = (int) *cursor++ - P4EST_MESH_PACKED_SHIFT;
+    u = 0;
+    shift = 0;
+    do {
+      byte = *cursor++;
+      u |= (uint32_t) (byte & 0x7F) << shift;
+      shift += 7;
+    }
+    while (byte & 0x80);
+    if (i == face) {
+      break;
+    }
   }
+
+  /* undo the zigzag delta relative to the current quadrant */
+  *qtq = qid + (p4est_locidx_t) ((int32_t) (u >> 1) ^ -(int32_t) (u & 1));
+}
+
+void
+p4est_mesh_compress (p4est_mesh_t * mesh)
+{
+  int                 face;
+  int32_t             delta;
+  p4est_locidx_t      qid, lq;
+  p4est_locidx_t      in_qtoq;
+  sc_array_t         *packed;
+
+  if (mesh->quad_to_packed != NULL) {
+    /* the mesh has been compressed before */
+    P4EST_ASSERT (mesh->quad_to_quad == NULL);
+    P4EST_ASSERT (mesh->quad_to_face == NULL);
+    return;
+  }
+  P4EST_ASSERT (mesh->quad_to_quad != NULL);
+  P4EST_ASSERT (mesh->quad_to_face != NULL);
+
+  lq = mesh->local_num_quadrants;
+  packed = mesh->quad_to_packed = sc_array_new (sizeof (uint8_t));
+  mesh->quad_packed_offset = P4EST_ALLOC (p4est_locidx_t, lq + 1);
+
+  for (qid = 0; qid < lq; ++qid) {
+    mesh->quad_packed_offset[qid] = (p4est_locidx_t) packed->elem_count;
+    for (face = 0; face < P4EST_FACES; ++face) {
+      in_qtoq = P4EST_FACES * qid + face;
+      P4EST_ASSERT (mesh->quad_to_face[in_qtoq] +
+                    P4EST_MESH_PACKED_SHIFT >= 0);
+      *(uint8_t *) sc_array_push (packed) =
+        (uint8_t) (mesh->quad_to_face[in_qtoq] + P4EST_MESH_PACKED_SHIFT);
+      delta = (int32_t) (mesh->quad_to_quad[in_qtoq] - qid);
+      mesh_packed_push (packed,
+                        ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31));
+    }
+  }
+  mesh->quad_packed_offset[lq] = (p4est_locidx_t) packed->elem_count;
+
+  /* the raw arrays are no longer accessible */
+  P4EST_FREE (mesh->quad_to_quad);
+  P4EST_FREE (mesh->quad_to_face);
+  mesh->quad_to_quad = NULL;
+  mesh->quad_to_face = NULL;
 }
 
 size_t
@@ -583,8 +825,21 @@ p4est_mesh_memory_used (p4est_mesh_t * mesh)
   /* basic memory plus face information */
   all_memory =
     sizeof (p4est_mesh_t) + qtt_memory + ql_memory +
-    P4EST_FACES * lqz * (sizeof (p4est_locidx_t) + sizeof (int8_t)) +
     ngz * sizeof (int) + sc_array_memory_used (mesh->quad_to_half, 1);
+  if (mesh->quad_to_packed != NULL) {
+    all_memory += sc_array_memory_used (mesh->quad_to_packed, 1) +
+      (lqz + 1) * sizeof (p4est_locidx_t);
+  }
+  else {
+    all_memory +=
+      P4EST_FACES * lqz * (sizeof (p4est_locidx_t) + sizeof (int8_t));
+  }
+
+  /* add fused neighbor payload addresses */
+  if (mesh->quad_to_data != NULL) {
+    all_memory += P4EST_FACES * lqz * sizeof (void *) +
+      sc_array_memory_used (mesh->quad_to_half_data, 1);
+  }
 
   /* add corner information */
   if (mesh->quad_to_corner != NULL) {
@@ -598,6 +853,45 @@ p4est_mesh_memory_used (p4est_mesh_t * mesh)
   return all_memory;
 }
 
+void
+p4est_memory_report (p4est_t * p4est, p4est_ghost_t * ghost,
+                     p4est_mesh_t * mesh, p4est_memory_report_t * report)
+{
+  P4EST_ASSERT (report != NULL);
+
+  report->forest_bytes = p4est_memory_used (p4est);
+  report->connectivity_bytes =
+    p4est_connectivity_memory_used (p4est->connectivity);
+  report->ghost_bytes = ghost != NULL ? p4est_ghost_memory_used (ghost) : 0;
+  report->mesh_bytes = mesh != NULL ? p4est_mesh_memory_used (mesh) : 0;
+  report->balance_memory_peak = 0;
+  report->partition_memory_peak = 0;
+  if (p4est->inspect != NULL) {
+    report->balance_memory_peak = p4est->inspect->balance_memory_peak;
+    report->partition_memory_peak = p4est->inspect->partition_memory_peak;
+  }
+  report->total_bytes = report->forest_bytes + report->connectivity_bytes +
+    report->ghost_bytes + report->mesh_bytes;
+
+  /* break down the memory pools; a live count near the peak with many
+   * reclaimable bytes means the pool is fragmented after coarsening */
+  report->data_pool_live = 0;
+  report->data_pool_peak = 0;
+  report->data_pool_reclaimable = 0;
+  report->data_pool_bytes = 0;
+  if (p4est->user_data_pool != NULL) {
+    report->data_pool_live = p4est->user_data_pool->elem_count;
+    report->data_pool_peak = p4est->user_data_pool->elem_count +
+      p4est->user_data_pool->freed.elem_count;
+    report->data_pool_reclaimable =
+      p4est->user_data_pool->freed.elem_count * p4est->data_size;
+    report->data_pool_bytes =
+      sc_mempool_memory_used (p4est->user_data_pool);
+  }
+  report->quadrant_pool_bytes =
+    sc_mempool_memory_used (p4est->quadrant_pool);
+}
+
 p4est_mesh_t       *
 p4est_mesh_new (p4est_t * p4est, p4est_ghost_t * ghost,
                 p4est_connect_type_t btype)
@@ -609,22 +903,38 @@ p4est_mesh_t       *
 p4est_mesh_new_ext (p4est_t * p4est, p4est_ghost_t * ghost,
                     int compute_tree_index, int compute_level_lists,
                     p4est_connect_type_t btype)
+{
+  return p4est_mesh_new_level_ext (p4est, ghost, compute_tree_index,
+                                   compute_level_lists,
+                                   0, P4EST_QMAXLEVEL, 0, btype);
+}
+
+/** Fill all parts of a new mesh that depend only on the local forest.
+ * The ghost related members are completed by \ref p4est_mesh_new_finish,
+ * which allows the caller to overlap this function with the message
+ * round of a split ghost layer construction.
+ */
+static p4est_mesh_t *
+p4est_mesh_new_local (p4est_t * p4est, int compute_tree_index,
+                      int compute_level_lists, int level_min, int level_max,
+                      int defer_corners, p4est_connect_type_t btype)
 {
   int                 do_corner = 0;
   int                 do_volume = 0;
-  int                 rank;
-  p4est_locidx_t      lq, ng;
+  p4est_locidx_t      lq;
   p4est_locidx_t      jl;
   p4est_mesh_t       *mesh;
 
-  P4EST_ASSERT (p4est_is_balanced (p4est, P4EST_CONNECT_FULL));
+  P4EST_ASSERT (0 <= level_min && level_min <= level_max &&
+                level_max <= P4EST_QMAXLEVEL);
 
   mesh = P4EST_ALLOC_ZERO (p4est_mesh_t, 1);
 
   lq = mesh->local_num_quadrants = p4est->local_num_quadrants;
-  ng = mesh->ghost_num_quadrants = (p4est_locidx_t) ghost->ghosts.elem_count;
+  mesh->level_min = level_min;
+  mesh->level_max = level_max;
 
-  if (btype == P4EST_CONNECT_FULL) {
+  if (btype == P4EST_CONNECT_FULL && !defer_corners) {
     do_corner = 1;
   }
   do_volume = (compute_tree_index || compute_level_lists ? 1 : 0);
@@ -634,7 +944,6 @@ p4est_mesh_new_ext (p4est_t * p4est, p4est_ghost_t * ghost,
     mesh->quad_to_tree = P4EST_ALLOC (p4est_topidx_t, lq);
   }
 
-  mesh->ghost_to_proc = P4EST_ALLOC (int, ng);
   mesh->quad_to_quad = P4EST_ALLOC (p4est_locidx_t, P4EST_FACES * lq);
   mesh->quad_to_face = P4EST_ALLOC (int8_t, P4EST_FACES * lq);
   mesh->quad_to_half = sc_array_new (P4EST_HALF * sizeof (p4est_locidx_t));
@@ -648,7 +957,48 @@ p4est_mesh_new_ext (p4est_t * p4est, p4est_ghost_t * ghost,
     }
   }
 
-  /* Populate ghost information */
+  /* Fill face arrays with default values */
+  memset (mesh->quad_to_quad, -1, P4EST_FACES * lq * sizeof (p4est_locidx_t));
+  memset (mesh->quad_to_face, -25, P4EST_FACES * lq * sizeof (int8_t));
+
+  if (do_corner) {
+    /* Initialize corner information to a consistent state */
+    mesh->quad_to_corner = P4EST_ALLOC (p4est_locidx_t, P4EST_CHILDREN * lq);
+    memset (mesh->quad_to_corner, -1, P4EST_CHILDREN * lq *
+            sizeof (p4est_locidx_t));
+
+    mesh->corner_offset = sc_array_new (sizeof (p4est_locidx_t));
+    *(p4est_locidx_t *) sc_array_push (mesh->corner_offset) = 0;
+
+    mesh->corner_quad = sc_array_new (sizeof (p4est_locidx_t));
+    mesh->corner_corner = sc_array_new (sizeof (int8_t));
+  }
+
+  /* The volume information follows the local quadrant sequence */
+  if (do_volume) {
+    mesh_fill_volume (p4est, mesh);
+  }
+
+  return mesh;
+}
+
+/** Complete a mesh begun with \ref p4est_mesh_new_local.
+ * This fills the ghost related members and runs the forest iterator
+ * that collects the neighbor connectivity.
+ */
+static void
+p4est_mesh_new_finish (p4est_t * p4est, p4est_ghost_t * ghost,
+                       p4est_mesh_t * mesh)
+{
+  int                 rank;
+  p4est_locidx_t      ng;
+  p4est_locidx_t      jl;
+  p4est_mesh_filler_t filler;
+
+  ng = mesh->ghost_num_quadrants = (p4est_locidx_t) ghost->ghosts.elem_count;
+
+  /* Populate ghost information; realloc serves the recycled mesh path */
+  mesh->ghost_to_proc = P4EST_REALLOC (mesh->ghost_to_proc, int, ng);
   rank = 0;
   for (jl = 0; jl < ng; ++jl) {
     while (ghost->proc_offsets[rank + 1] <= jl) {
@@ -658,32 +1008,332 @@ p4est_mesh_new_ext (p4est_t * p4est, p4est_ghost_t * ghost,
     mesh->ghost_to_proc[jl] = rank;
   }
 
+  /* Call the forest iterator to collect face connectivity */
+  p4est_mesh_filler_init (&filler, mesh);
+  p4est_iterate (p4est, ghost, &filler, NULL, mesh_iter_face,
+#ifdef P4_TO_P8
+                 NULL,
+#endif
+                 mesh->quad_to_corner != NULL ? mesh_iter_corner : NULL);
+  p4est_mesh_filler_merge (&filler);
+}
+
+p4est_mesh_t       *
+p4est_mesh_new_level_ext (p4est_t * p4est, p4est_ghost_t * ghost,
+                          int compute_tree_index, int compute_level_lists,
+                          int level_min, int level_max, int defer_corners,
+                          p4est_connect_type_t btype)
+{
+  p4est_mesh_t       *mesh;
+
+  P4EST_ASSERT (p4est_is_balanced (p4est, P4EST_CONNECT_FULL));
+
+  mesh = p4est_mesh_new_local (p4est, compute_tree_index,
+                               compute_level_lists, level_min, level_max,
+                               defer_corners, btype);
+  p4est_mesh_new_finish (p4est, ghost, mesh);
+
+  return mesh;
+}
+
+p4est_mesh_t       *
+p4est_mesh_reuse_ext (p4est_t * p4est, p4est_ghost_t * ghost,
+                      int compute_tree_index, int compute_level_lists,
+                      p4est_connect_type_t btype, p4est_mesh_t * mesh)
+{
+  int                 do_corner;
+  p4est_locidx_t      jl;
+  p4est_locidx_t      lq;
+
+  if (mesh == NULL) {
+    return p4est_mesh_new_ext (p4est, ghost, compute_tree_index,
+                               compute_level_lists, btype);
+  }
+
+  P4EST_ASSERT (p4est_is_balanced (p4est, P4EST_CONNECT_FULL));
+
+  /* members built by compress or attach_data are not carried over */
+  if (mesh->quad_to_packed != NULL) {
+    sc_array_destroy (mesh->quad_to_packed);
+    P4EST_FREE (mesh->quad_packed_offset);
+    mesh->quad_to_packed = NULL;
+    mesh->quad_packed_offset = NULL;
+  }
+  if (mesh->quad_to_data != NULL) {
+    P4EST_FREE (mesh->quad_to_data);
+    sc_array_destroy (mesh->quad_to_half_data);
+    mesh->quad_to_data = NULL;
+    mesh->quad_to_half_data = NULL;
+  }
+
+  lq = mesh->local_num_quadrants = p4est->local_num_quadrants;
+  mesh->level_min = 0;
+  mesh->level_max = P4EST_QMAXLEVEL;
+
+  /* Reallocate the flat arrays to the new quadrant count.  The
+   * variable-length arrays are emptied without surrendering their
+   * capacity, so repeated rebuild cycles stop allocating once the
+   * forest size has settled. */
+  if (compute_tree_index) {
+    mesh->quad_to_tree =
+      P4EST_REALLOC (mesh->quad_to_tree, p4est_topidx_t, lq);
+  }
+  else if (mesh->quad_to_tree != NULL) {
+    P4EST_FREE (mesh->quad_to_tree);
+    mesh->quad_to_tree = NULL;
+  }
+  mesh->quad_to_quad =
+    P4EST_REALLOC (mesh->quad_to_quad, p4est_locidx_t, P4EST_FACES * lq);
+  mesh->quad_to_face =
+    P4EST_REALLOC (mesh->quad_to_face, int8_t, P4EST_FACES * lq);
+  sc_array_resize (mesh->quad_to_half, 0);
+
+  /* Optional per-level lists of quadrants */
+  if (compute_level_lists) {
+    if (mesh->quad_level == NULL) {
+      mesh->quad_level = P4EST_ALLOC (sc_array_t, P4EST_QMAXLEVEL + 1);
+
+      for (jl = 0; jl <= P4EST_QMAXLEVEL; ++jl) {
+        sc_array_init (mesh->quad_level + jl, sizeof (p4est_locidx_t));
+      }
+    }
+    else {
+      for (jl = 0; jl <= P4EST_QMAXLEVEL; ++jl) {
+        sc_array_resize (mesh->quad_level + jl, 0);
+      }
+    }
+  }
+  else if (mesh->quad_level != NULL) {
+    for (jl = 0; jl <= P4EST_QMAXLEVEL; ++jl) {
+      sc_array_reset (mesh->quad_level + jl);
+    }
+    P4EST_FREE (mesh->quad_level);
+    mesh->quad_level = NULL;
+  }
+
   /* Fill face arrays with default values */
   memset (mesh->quad_to_quad, -1, P4EST_FACES * lq * sizeof (p4est_locidx_t));
   memset (mesh->quad_to_face, -25, P4EST_FACES * lq * sizeof (int8_t));
 
+  do_corner = (btype == P4EST_CONNECT_FULL);
   if (do_corner) {
     /* Initialize corner information to a consistent state */
-    mesh->quad_to_corner = P4EST_ALLOC (p4est_locidx_t, P4EST_CHILDREN * lq);
+    mesh->quad_to_corner =
+      P4EST_REALLOC (mesh->quad_to_corner, p4est_locidx_t,
+                     P4EST_CHILDREN * lq);
     memset (mesh->quad_to_corner, -1, P4EST_CHILDREN * lq *
             sizeof (p4est_locidx_t));
 
-    mesh->corner_offset = sc_array_new (sizeof (p4est_locidx_t));
+    if (mesh->corner_offset == NULL) {
+      mesh->corner_offset = sc_array_new (sizeof (p4est_locidx_t));
+      mesh->corner_quad = sc_array_new (sizeof (p4est_locidx_t));
+      mesh->corner_corner = sc_array_new (sizeof (int8_t));
+    }
+    else {
+      sc_array_resize (mesh->corner_offset, 0);
+      sc_array_resize (mesh->corner_quad, 0);
+      sc_array_resize (mesh->corner_corner, 0);
+    }
     *(p4est_locidx_t *) sc_array_push (mesh->corner_offset) = 0;
+  }
+  else if (mesh->quad_to_corner != NULL) {
+    P4EST_FREE (mesh->quad_to_corner);
+    sc_array_destroy (mesh->corner_offset);
+    sc_array_destroy (mesh->corner_quad);
+    sc_array_destroy (mesh->corner_corner);
+    mesh->quad_to_corner = NULL;
+    mesh->corner_offset = NULL;
+    mesh->corner_quad = NULL;
+    mesh->corner_corner = NULL;
+  }
+  mesh->local_num_corners = 0;
 
-    mesh->corner_quad = sc_array_new (sizeof (p4est_locidx_t));
-    mesh->corner_corner = sc_array_new (sizeof (int8_t));
+  /* The volume information follows the local quadrant sequence */
+  if (compute_tree_index || compute_level_lists) {
+    mesh_fill_volume (p4est, mesh);
   }
 
-  /* Call the forest iterator to collect face connectivity */
-  p4est_iterate (p4est, ghost, mesh,
-                 (do_volume ? mesh_iter_volume : NULL), mesh_iter_face,
+  p4est_mesh_new_finish (p4est, ghost, mesh);
+
+  return mesh;
+}
+
+p4est_mesh_t       *
+p4est_ghost_mesh_new (p4est_t * p4est, p4est_connect_type_t btype,
+                      int compute_tree_index, int compute_level_lists,
+                      p4est_ghost_t ** ghost)
+{
+  p4est_ghost_new_t  *gnc;
+  p4est_ghost_t      *g;
+  p4est_mesh_t       *mesh;
+
+  P4EST_ASSERT (ghost != NULL);
+  P4EST_ASSERT (p4est_is_balanced (p4est, P4EST_CONNECT_FULL));
+
+  /* post the ghost layer messages before touching any mesh memory */
+  gnc = p4est_ghost_new_begin (p4est, btype);
+
+  /* the local mesh fills overlap with the ghost messages in flight */
+  mesh = p4est_mesh_new_local (p4est, compute_tree_index,
+                               compute_level_lists, 0, P4EST_QMAXLEVEL,
+                               0, btype);
+
+  /* complete the ghost layer and the ghost dependent mesh parts */
+  g = p4est_ghost_new_end (gnc);
+  p4est_mesh_new_finish (p4est, g, mesh);
+
+  *ghost = g;
+  return mesh;
+}
+
+void
+p4est_mesh_build_corners (p4est_t * p4est, p4est_ghost_t * ghost,
+                          p4est_mesh_t * mesh)
+{
+  p4est_locidx_t      lq;
+  p4est_mesh_filler_t filler;
+
+  P4EST_ASSERT (mesh != NULL);
+  P4EST_ASSERT (mesh->local_num_quadrants == p4est->local_num_quadrants);
+
+  /* already built, either up front or by an earlier call */
+  if (mesh->quad_to_corner != NULL) {
+    return;
+  }
+
+  lq = mesh->local_num_quadrants;
+
+  /* Initialize corner information to a consistent state */
+  mesh->quad_to_corner = P4EST_ALLOC (p4est_locidx_t, P4EST_CHILDREN * lq);
+  memset (mesh->quad_to_corner, -1, P4EST_CHILDREN * lq *
+          sizeof (p4est_locidx_t));
+
+  mesh->corner_offset = sc_array_new (sizeof (p4est_locidx_t));
+  *(p4est_locidx_t *) sc_array_push (mesh->corner_offset) = 0;
+
+  mesh->corner_quad = sc_array_new (sizeof (p4est_locidx_t));
+  mesh->corner_corner = sc_array_new (sizeof (int8_t));
+
+  /* run only the corner part of the mesh iteration */
+  p4est_mesh_filler_init (&filler, mesh);
+  p4est_iterate (p4est, ghost, &filler, NULL, NULL,
 #ifdef P4_TO_P8
                  NULL,
 #endif
-                 do_corner ? mesh_iter_corner : NULL);
+                 mesh_iter_corner);
+  p4est_mesh_filler_merge (&filler);
+}
 
-  return mesh;
+void
+p4est_mesh_iterate_faces (p4est_t * p4est, p4est_ghost_t * ghost,
+                          p4est_mesh_t * mesh,
+                          p4est_mesh_face_fn_t * table, void *user_data)
+{
+  const p4est_locidx_t lnq = mesh->local_num_quadrants;
+  p4est_locidx_t      il, qtq;
+  int                 f, config;
+  int8_t              qtf;
+  p4est_mesh_face_fn_t fn;
+
+  P4EST_ASSERT (mesh->local_num_quadrants == p4est->local_num_quadrants);
+  P4EST_ASSERT (mesh->quad_to_quad != NULL && mesh->quad_to_face != NULL);
+  P4EST_ASSERT (table != NULL);
+
+  for (il = 0; il < lnq; ++il) {
+    for (f = 0; f < P4EST_FACES; ++f) {
+      qtq = mesh->quad_to_quad[P4EST_FACES * il + f];
+      qtf = mesh->quad_to_face[P4EST_FACES * il + f];
+      if (qtq == il && (int) qtf == f) {
+        /* a face on the domain boundary has its own slot per face number */
+        config = P4EST_MESH_FACE_CONFIG_OFFSET * (2 + P4EST_HALF) + f;
+      }
+      else {
+        /* the face code is the configuration, shifted to nonnegative */
+        config = (int) qtf + P4EST_MESH_FACE_CONFIG_OFFSET;
+      }
+      P4EST_ASSERT (0 <= config && config < P4EST_MESH_FACE_CONFIGS);
+      fn = table[config];
+      if (fn != NULL) {
+        fn (p4est, ghost, mesh, il, f, user_data);
+      }
+    }
+  }
+}
+
+void
+p4est_mesh_blocked_order (p4est_t * p4est, p4est_mesh_t * mesh,
+                          int block_size,
+                          p4est_locidx_t * blocked_of_local,
+                          p4est_locidx_t * local_of_blocked)
+{
+  const p4est_locidx_t lnq = mesh->local_num_quadrants;
+  int                 f, h;
+  p4est_locidx_t      il, nl, qtq, bend;
+  p4est_locidx_t      head, filled, seed;
+  p4est_locidx_t     *halfs;
+  p4est_locidx_t     *queue;
+  int8_t              qtf;
+
+  P4EST_ASSERT (mesh->local_num_quadrants == p4est->local_num_quadrants);
+  P4EST_ASSERT (mesh->quad_to_quad != NULL && mesh->quad_to_face != NULL);
+  P4EST_ASSERT (block_size > 0);
+  P4EST_ASSERT (blocked_of_local != NULL);
+
+  for (il = 0; il < lnq; ++il) {
+    blocked_of_local[il] = -1;
+  }
+
+  /* each block is grown breadth first through the face adjacency, so
+   * neighbors across refinement levels receive nearby blocked labels;
+   * the queue doubles as the inverse relabeling in assignment order */
+  queue = local_of_blocked != NULL ? local_of_blocked :
+    P4EST_ALLOC (p4est_locidx_t, lnq);
+  filled = 0;
+  seed = 0;
+  while (filled < lnq) {
+    /* seed the next block from the lowest Morton index not yet placed */
+    while (blocked_of_local[seed] >= 0) {
+      ++seed;
+    }
+    P4EST_ASSERT (seed < lnq);
+    blocked_of_local[seed] = filled;
+    queue[filled++] = seed;
+    bend = SC_MIN (filled - 1 + (p4est_locidx_t) block_size, lnq);
+
+    for (head = filled - 1; head < filled && filled < bend; ++head) {
+      il = queue[head];
+      for (f = 0; f < P4EST_FACES && filled < bend; ++f) {
+        qtq = mesh->quad_to_quad[P4EST_FACES * il + f];
+        qtf = mesh->quad_to_face[P4EST_FACES * il + f];
+        if (qtf < 0) {
+          /* hanging face: the half-size neighbors are listed separately */
+          halfs = (p4est_locidx_t *) sc_array_index (mesh->quad_to_half,
+                                                     (size_t) qtq);
+          for (h = 0; h < P4EST_HALF && filled < bend; ++h) {
+            nl = halfs[h];
+            if (nl < lnq && blocked_of_local[nl] < 0) {
+              blocked_of_local[nl] = filled;
+              queue[filled++] = nl;
+            }
+          }
+        }
+        else {
+          /* same- or double-size neighbor; ghosts and the boundary
+           * self-reference are excluded by the two tests below */
+          nl = qtq;
+          if (nl < lnq && blocked_of_local[nl] < 0) {
+            blocked_of_local[nl] = filled;
+            queue[filled++] = nl;
+          }
+        }
+      }
+    }
+  }
+  P4EST_ASSERT (filled == lnq);
+
+  if (local_of_blocked == NULL) {
+    P4EST_FREE (queue);
+  }
 }
 
 void
@@ -707,6 +1357,16 @@ p4est_mesh_destroy (p4est_mesh_t * mesh)
   P4EST_FREE (mesh->quad_to_face);
   sc_array_destroy (mesh->quad_to_half);
 
+  if (mesh->quad_to_packed != NULL) {
+    sc_array_destroy (mesh->quad_to_packed);
+    P4EST_FREE (mesh->quad_packed_offset);
+  }
+
+  if (mesh->quad_to_data != NULL) {
+    P4EST_FREE (mesh->quad_to_data);
+    sc_array_destroy (mesh->quad_to_half_data);
+  }
+
   if (mesh->quad_to_corner != NULL) {
     P4EST_FREE (mesh->quad_to_corner);
     sc_array_destroy (mesh->corner_offset);
@@ -855,9 +1515,16 @@ p4est_mesh_face_neighbor_next (p4est_mesh_face_neighbor_t * mfn,
   P4EST_ASSERT (mfn->ghost->ghosts.elem_count == (size_t) ngh);
 
   /* Retrieve face and quadrant codes */
-  quadfacecode = mfn->quadrant_code + (p4est_locidx_t) mfn->face;
-  qtq = mfn->mesh->quad_to_quad[quadfacecode];
-  qtf = (int) mfn->mesh->quad_to_face[quadfacecode];
+  if (mfn->mesh->quad_to_packed == NULL) {
+    quadfacecode = mfn->quadrant_code + (p4est_locidx_t) mfn->face;
+    qtq = mfn->mesh->quad_to_quad[quadfacecode];
+    qtf = (int) mfn->mesh->quad_to_face[quadfacecode];
+  }
+  else {
+    /* decode the compressed adjacency of this quadrant face */
+    mesh_packed_fetch (mfn->mesh, mfn->quadrant_code / P4EST_FACES,
+                       mfn->face, &qtq, &qtf);
+  }
   if (qtf >= 0) {
     /* Neighbor is same or double size */
     ;
@@ -938,3 +1605,328 @@ p4est_mesh_face_neighbor_data (p4est_mesh_face_neighbor_t * mfn,
     return (void *) ((char *) ghost_data + data_size * qtq);
   }
 }
+
+/** Prefetch the quadrant and data the iterator will return next.
+ * The iterator state is examined without being advanced.
+ */
+static void
+p4est_mesh_face_neighbor_peek (p4est_mesh_face_neighbor_t * mfn,
+                               void *ghost_data)
+{
+  int                 qtf;
+  p4est_topidx_t      which_tree;
+  p4est_locidx_t      qtq, quadfacecode;
+  p4est_locidx_t      lnq, *halfs;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (mfn->face >= 0 && mfn->face < P4EST_FACES);
+  P4EST_ASSERT (mfn->subface >= 0 && mfn->subface < P4EST_HALF);
+
+  /* retrieve the upcoming face and quadrant codes */
+  if (mfn->mesh->quad_to_packed == NULL) {
+    quadfacecode = mfn->quadrant_code + (p4est_locidx_t) mfn->face;
+    qtq = mfn->mesh->quad_to_quad[quadfacecode];
+    qtf = (int) mfn->mesh->quad_to_face[quadfacecode];
+  }
+  else {
+    mesh_packed_fetch (mfn->mesh, mfn->quadrant_code / P4EST_FACES,
+                       mfn->face, &qtq, &qtf);
+  }
+  if (qtf < 0) {
+    /* the upcoming neighbor is one of the half size quadrants */
+    P4EST_ASSERT (qtq >= 0);
+    halfs = (p4est_locidx_t *) sc_array_index (mfn->mesh->quad_to_half,
+                                               (size_t) qtq);
+    qtq = halfs[mfn->subface];
+  }
+
+  P4EST_ASSERT (qtq >= 0);
+  lnq = mfn->mesh->local_num_quadrants;
+  if (qtq < lnq) {
+    /* local quadrant: touch its struct and payload ahead of time */
+    which_tree = mfn->which_tree;
+    q = p4est_mesh_quadrant_cumulative (mfn->p4est, qtq, &which_tree, NULL);
+    P4EST_PREFETCH (q);
+    if (mfn->p4est->data_size > 0) {
+      P4EST_PREFETCH (q->p.user_data);
+    }
+  }
+  else {
+    /* ghost quadrant: its address follows from plain index math */
+    qtq -= lnq;
+    q = p4est_quadrant_array_index (&mfn->ghost->ghosts, (size_t) qtq);
+    P4EST_PREFETCH (q);
+    if (ghost_data != NULL) {
+      P4EST_PREFETCH ((char *) ghost_data +
+                      mfn->p4est->data_size * (size_t) qtq);
+    }
+  }
+}
+
+p4est_quadrant_t   *
+p4est_mesh_face_neighbor_next_prefetch (p4est_mesh_face_neighbor_t * mfn,
+                                        void *ghost_data,
+                                        p4est_topidx_t * ntree,
+                                        p4est_locidx_t * nquad,
+                                        int *nface, int *nrank)
+{
+  p4est_quadrant_t   *q;
+
+  q = p4est_mesh_face_neighbor_next (mfn, ntree, nquad, nface, nrank);
+  if (q != NULL && mfn->face < P4EST_FACES) {
+    /* hide the latency of the next dependent lookup behind this one */
+    p4est_mesh_face_neighbor_peek (mfn, ghost_data);
+  }
+
+  return q;
+}
+
+int
+p4est_mesh_face_neighbor_ring (p4est_mesh_face_neighbor_t * mfn,
+                               void *ghost_data, int ring_size,
+                               p4est_quadrant_t ** ring_quads,
+                               void **ring_data)
+{
+  int                 k;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (ring_size > 0);
+  P4EST_ASSERT (ring_quads != NULL);
+
+  for (k = 0; k < ring_size; ++k) {
+    q = p4est_mesh_face_neighbor_next_prefetch (mfn, ghost_data,
+                                                NULL, NULL, NULL, NULL);
+    if (q == NULL) {
+      break;
+    }
+    ring_quads[k] = q;
+    if (ring_data != NULL) {
+      ring_data[k] = p4est_mesh_face_neighbor_data (mfn, ghost_data);
+    }
+  }
+
+  return k;
+}
+
+/** Retrieve one face entry from either the raw or packed adjacency. */
+static void
+mesh_face_code (p4est_mesh_t * mesh, p4est_locidx_t qid, int face,
+                p4est_locidx_t * qtq, int *qtf)
+{
+  if (mesh->quad_to_packed == NULL) {
+    *qtq = mesh->quad_to_quad[P4EST_FACES * qid + face];
+    *qtf = (int) mesh->quad_to_face[P4EST_FACES * qid + face];
+  }
+  else {
+    mesh_packed_fetch (mesh, qid, face, qtq, qtf);
+  }
+}
+
+/** Translate an encoded local or ghost neighbor number to a global one. */
+static p4est_gloidx_t
+mesh_csr_global (p4est_t * p4est, p4est_ghost_t * ghost,
+                 p4est_mesh_t * mesh, p4est_locidx_t qtq)
+{
+  p4est_quadrant_t   *gq;
+
+  P4EST_ASSERT (0 <= qtq && qtq < mesh->local_num_quadrants +
+                mesh->ghost_num_quadrants);
+  if (qtq < mesh->local_num_quadrants) {
+    return p4est->global_first_quadrant[p4est->mpirank] +
+      (p4est_gloidx_t) qtq;
+  }
+  qtq -= mesh->local_num_quadrants;
+  gq = p4est_quadrant_array_index (&ghost->ghosts, (size_t) qtq);
+  return p4est->global_first_quadrant[mesh->ghost_to_proc[qtq]] +
+    (p4est_gloidx_t) gq->p.piggy3.local_num;
+}
+
+void
+p4est_mesh_to_csr (p4est_t * p4est, p4est_ghost_t * ghost,
+                   p4est_mesh_t * mesh,
+                   p4est_locidx_t ** xadj, p4est_gloidx_t ** adjncy)
+{
+  int                 face, h;
+  int                 qtf;
+  p4est_locidx_t      qid, lq, qtq;
+  p4est_locidx_t      nedges;
+  p4est_locidx_t     *lxadj, *halfs;
+  p4est_gloidx_t     *ladjncy;
+
+  P4EST_ASSERT (mesh->local_num_quadrants == p4est->local_num_quadrants);
+  P4EST_ASSERT (mesh->ghost_num_quadrants ==
+                (p4est_locidx_t) ghost->ghosts.elem_count);
+
+  lq = mesh->local_num_quadrants;
+  lxadj = *xadj = P4EST_ALLOC (p4est_locidx_t, lq + 1);
+
+  /* count the edges of each local quadrant */
+  nedges = 0;
+  for (qid = 0; qid < lq; ++qid) {
+    lxadj[qid] = nedges;
+    for (face = 0; face < P4EST_FACES; ++face) {
+      mesh_face_code (mesh, qid, face, &qtq, &qtf);
+      if (qtq == qid && qtf == face) {
+        /* a forest boundary face has no neighbor */
+        continue;
+      }
+      nedges += (qtf >= 0 ? 1 : P4EST_HALF);    /* same type */
+    }
+  }
+  lxadj[lq] = nedges;
+
+  /* fill the adjacency with global quadrant numbers */
+  ladjncy = *adjncy = P4EST_ALLOC (p4est_gloidx_t, nedges);
+  nedges = 0;
+  for (qid = 0; qid < lq; ++qid) {
+    for (face = 0; face < P4EST_FACES; ++face) {
+      mesh_face_code (mesh, qid, face, &qtq, &qtf);
+      if (qtq == qid && qtf == face) {
+        continue;
+      }
+      if (qtf >= 0) {
+        /* one same-size or double-size neighbor */
+        ladjncy[nedges++] = mesh_csr_global (p4est, ghost, mesh, qtq);
+      }
+      else {
+        /* expand the half-size neighbors of a hanging face */
+        halfs = (p4est_locidx_t *) sc_array_index (mesh->quad_to_half,
+                                                   (size_t) qtq);
+        for (h = 0; h < P4EST_HALF; ++h) {
+          ladjncy[nedges++] = mesh_csr_global (p4est, ghost, mesh, halfs[h]);
+        }
+      }
+    }
+  }
+  P4EST_ASSERT (nedges == lxadj[lq]);
+}
+
+void
+p4est_mesh_face_neighbors_batch (p4est_mesh_t * mesh,
+                                 const p4est_locidx_t * quad_ids,
+                                 p4est_locidx_t num_quads,
+                                 p4est_locidx_t * nquad, int8_t * nface,
+                                 sc_array_t * hanging)
+{
+  int                 face;
+  int                 qtf;
+  p4est_locidx_t      iz, qid, qtq;
+
+  P4EST_ASSERT (num_quads >= 0);
+  P4EST_ASSERT (num_quads == 0 || (quad_ids != NULL && nquad != NULL &&
+                                   nface != NULL));
+  P4EST_ASSERT (hanging == NULL ||
+                hanging->elem_size == sizeof (p4est_locidx_t));
+
+  if (hanging != NULL) {
+    sc_array_resize (hanging, 0);
+  }
+
+  if (mesh->quad_to_packed == NULL) {
+    /* gather the raw entries in a tight loop free of branching */
+    for (iz = 0; iz < num_quads; ++iz) {
+      qid = quad_ids[iz];
+      P4EST_ASSERT (0 <= qid && qid < mesh->local_num_quadrants);
+      memcpy (nquad + P4EST_FACES * iz,
+              mesh->quad_to_quad + P4EST_FACES * qid,
+              P4EST_FACES * sizeof (p4est_locidx_t));
+      memcpy (nface + P4EST_FACES * iz,
+              mesh->quad_to_face + P4EST_FACES * qid,
+              P4EST_FACES * sizeof (int8_t));
+    }
+  }
+  else {
+    /* decode all faces of each quadrant with one cursor pass */
+    for (iz = 0; iz < num_quads; ++iz) {
+      qid = quad_ids[iz];
+      for (face = 0; face < P4EST_FACES; ++face) {
+        mesh_packed_fetch (mesh, qid, face, &qtq, &qtf);
+        nquad[P4EST_FACES * iz + face] = qtq;
+        nface[P4EST_FACES * iz + face] = (int8_t) qtf;
+      }
+    }
+  }
+
+  /* collect the hanging positions for the caller's slow path */
+  if (hanging != NULL) {
+    for (iz = 0; iz < P4EST_FACES * num_quads; ++iz) {
+      if (nface[iz] < 0) {
+        *(p4est_locidx_t *) sc_array_push (hanging) = iz;
+      }
+    }
+  }
+}
+
+void
+p4est_mesh_attach_data (p4est_t * p4est, p4est_ghost_t * ghost,
+                        p4est_mesh_t * mesh, void *ghost_data)
+{
+  const size_t        stride =
+    p4est->data_size == 0 ? sizeof (void *) : p4est->data_size;
+  int                 face, qtf;
+  int                 h;
+  p4est_topidx_t      tt;
+  p4est_locidx_t      lq, ng;
+  p4est_locidx_t      il, qid, qtq;
+  p4est_locidx_t     *halfs;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+  size_t              zz;
+  void              **alldata, **halfrow;
+
+  lq = mesh->local_num_quadrants;
+  ng = mesh->ghost_num_quadrants;
+  P4EST_ASSERT (lq == p4est->local_num_quadrants);
+  P4EST_ASSERT (ng == (p4est_locidx_t) ghost->ghosts.elem_count);
+
+  /* resolve every local and ghost payload address exactly once */
+  alldata = P4EST_ALLOC (void *, (size_t) (lq + ng));
+  il = 0;
+  for (tt = p4est->first_local_tree; tt <= p4est->last_local_tree; ++tt) {
+    tree = p4est_tree_array_index (p4est->trees, tt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      alldata[il++] =
+        p4est->data_size == 0 ? (void *) &q->p.user_data : q->p.user_data;
+    }
+  }
+  P4EST_ASSERT (il == lq);
+  for (qid = 0; qid < ng; ++qid) {
+    alldata[lq + qid] = (char *) ghost_data + stride * (size_t) qid;
+  }
+
+  /* an earlier attachment is replaced wholesale */
+  if (mesh->quad_to_data != NULL) {
+    P4EST_FREE (mesh->quad_to_data);
+    sc_array_destroy (mesh->quad_to_half_data);
+  }
+  mesh->quad_to_data = P4EST_ALLOC (void *, P4EST_FACES * (size_t) lq);
+  mesh->quad_to_half_data =
+    sc_array_new_count (P4EST_HALF * sizeof (void *),
+                        mesh->quad_to_half->elem_count);
+
+  /* fuse the addresses behind every face entry */
+  for (qid = 0; qid < lq; ++qid) {
+    for (face = 0; face < P4EST_FACES; ++face) {
+      mesh_face_code (mesh, qid, face, &qtq, &qtf);
+      if (qtf >= 0) {
+        /* same or double size neighbor, or the quadrant itself at a
+         * domain boundary */
+        mesh->quad_to_data[P4EST_FACES * qid + face] = alldata[qtq];
+      }
+      else {
+        /* hanging face: one address per half size neighbor */
+        halfs = (p4est_locidx_t *) sc_array_index (mesh->quad_to_half,
+                                                   (size_t) qtq);
+        halfrow = (void **) sc_array_index (mesh->quad_to_half_data,
+                                            (size_t) qtq);
+        for (h = 0; h < P4EST_HALF; ++h) {
+          halfrow[h] = alldata[halfs[h]];
+        }
+        mesh->quad_to_data[P4EST_FACES * qid + face] = (void *) halfrow;
+      }
+    }
+  }
+
+  P4EST_FREE (alldata);
+}
@@ -456,8 +456,6 @@ p4est_nodes_foreach (void **item, const void *u)
   return 1;
 }
 
-#ifdef P4EST_ENABLE_MPI
-
 static p4est_locidx_t *
 p4est_shared_offsets (sc_array_t * inda)
 {
@@ -477,8 +475,6 @@ p4est_shared_offsets (sc_array_t * inda)
   return shared_offsets;
 }
 
-#endif
-
 p4est_nodes_t      *
 p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
 {
@@ -1317,6 +1313,436 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
   return nodes;
 }
 
+p4est_nodes_t      *
+p4est_nodes_new_from_lnodes (p4est_t * p4est, p4est_lnodes_t * lnodes)
+{
+  const int           num_procs = p4est->mpisize;
+  const int           rank = p4est->mpirank;
+  int                 k, owner;
+  int                 qcid, face;
+  int                 has_hanging;
+  int                 clamped = 1;
+  int                 hanging_face[P4EST_FACES];
+  int                *sharer_ranks, *new_sharers;
+  size_t              zz, position;
+  size_t              num_sharers, old_position, new_position;
+  int8_t              quad_status[P4EST_CHILDREN];
+  int8_t             *node_seen;
+  p4est_topidx_t      jt;
+  p4est_locidx_t      il, ne, nid, first, second;
+  p4est_locidx_t      num_local_nodes;
+  p4est_locidx_t      num_indep_nodes, num_owned_indeps, num_owned_shared;
+  p4est_locidx_t      offset_owned_indeps;
+  p4est_locidx_t      num_face_hangings, dup_face_hangings;
+  p4est_locidx_t      quad_indeps[P4EST_CHILDREN];
+  p4est_locidx_t     *local_nodes, *quad_nodes;
+  p4est_locidx_t     *sharer_counts;
+  p4est_locidx_t     *shared_offsets;
+  p4est_gloidx_t      gnum, goffset;
+  const p4est_locidx_t *enodes;
+  p4est_lnodes_rank_t *lrank;
+  p4est_tree_t       *tree;
+  p4est_nodes_t      *nodes;
+  p4est_quadrant_t    c, n, p;
+  p4est_quadrant_t   *q, *r;
+  p4est_indep_t      *in;
+  sc_array_t         *quadrants;
+  sc_array_t         *inda, *faha;
+  sc_array_t         *shared_indeps;
+  sc_hash_array_t    *face_hangings;
+  sc_recycle_array_t *nrarr;
+#ifndef P4_TO_P8
+  p4est_hang2_t      *fh;
+#else
+  int                 l, edge;
+  int                 hanging_edge[P8EST_EDGES];
+  p4est_locidx_t      all_face_hangings;
+  p4est_locidx_t      num_edge_hangings_begin;
+  p4est_locidx_t      num_edge_hangings, dup_edge_hangings;
+  p8est_hang4_t      *fh;
+  p8est_hang2_t      *eh;
+  sc_array_t         *edha;
+  sc_hash_array_t    *edge_hangings;
+#endif
+
+  P4EST_GLOBAL_PRODUCTION ("Into " P4EST_STRING "_nodes_new_from_lnodes\n");
+  p4est_log_indent_push ();
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  SC_CHECK_ABORT (lnodes->degree == 1 && lnodes->vnodes == P4EST_CHILDREN,
+                  P4EST_STRING
+                  "_nodes_new_from_lnodes requires a degree 1 numbering");
+  P4EST_ASSERT (lnodes->num_local_elements == p4est->local_num_quadrants);
+
+  P4EST_QUADRANT_INIT (&c);
+  P4EST_QUADRANT_INIT (&n);
+  P4EST_QUADRANT_INIT (&p);
+
+  /* allocate and initialize the node structure to return */
+  nodes = P4EST_ALLOC (p4est_nodes_t, 1);
+  memset (nodes, -1, sizeof (*nodes));
+  faha = &nodes->face_hangings;
+#ifdef P4_TO_P8
+  edha = &nodes->edge_hangings;
+#endif
+  shared_indeps = &nodes->shared_indeps;
+  sc_array_init (shared_indeps, sizeof (sc_recycle_array_t));
+  shared_offsets = nodes->shared_offsets = NULL;
+
+  /* compute number of local quadrant corners */
+  nodes->num_local_quadrants = p4est->local_num_quadrants;
+  num_local_nodes =             /* same type */
+    P4EST_CHILDREN * nodes->num_local_quadrants;
+  nodes->local_nodes = local_nodes =
+    P4EST_ALLOC (p4est_locidx_t, num_local_nodes);
+
+  /* The lnodes numbering fixes the independent nodes up front: we store
+   * the nodes owned by other processes first, in ascending order of their
+   * global numbers, followed by the nodes owned by this process in the
+   * order of their first touch by a local element.  Both blocks are
+   * nondecreasing in the owning tree of the node, which is the layout
+   * that p4est_nodes_is_valid expects. */
+  num_indep_nodes = lnodes->num_local_nodes;
+  num_owned_indeps = lnodes->owned_count;
+  offset_owned_indeps = num_indep_nodes - num_owned_indeps;
+  inda = &nodes->indep_nodes;
+  sc_array_init (inda, sizeof (p4est_indep_t));
+  sc_array_resize (inda, (size_t) num_indep_nodes);
+  node_seen = P4EST_ALLOC_ZERO (int8_t, num_indep_nodes);
+
+#ifndef P4_TO_P8
+  face_hangings = sc_hash_array_new (sizeof (p4est_hang2_t),
+                                     p4est_node_hash_piggy_fn,
+                                     p4est_node_equal_piggy_fn, &clamped);
+#else
+  face_hangings = sc_hash_array_new (sizeof (p8est_hang4_t),
+                                     p4est_node_hash_piggy_fn,
+                                     p4est_node_equal_piggy_fn, &clamped);
+  edge_hangings = sc_hash_array_new (sizeof (p8est_hang2_t),
+                                     p4est_node_hash_piggy_fn,
+                                     p4est_node_equal_piggy_fn, &clamped);
+
+  /* count face hanging corners to seed the edge hanging offset */
+  all_face_hangings = 0;
+  for (ne = 0; ne < lnodes->num_local_elements; ++ne) {
+    if (p8est_lnodes_decode (lnodes->face_code[ne], hanging_face,
+                             hanging_edge)) {
+      for (k = 0; k < P4EST_FACES; ++k) {
+        all_face_hangings += (hanging_face[k] >= 0);
+      }
+    }
+  }
+  num_edge_hangings_begin = num_indep_nodes + all_face_hangings;
+  num_edge_hangings = dup_edge_hangings = 0;
+#endif
+  num_face_hangings = dup_face_hangings = 0;
+
+  /* This loop fills the independent nodes from the element corners and
+   * collects the hanging nodes identified by the lnodes face code. */
+  ne = 0;
+  quad_nodes = local_nodes;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    quadrants = &tree->quadrants;
+
+    for (zz = 0; zz < quadrants->elem_count;
+         quad_nodes += P4EST_CHILDREN, ++ne, ++zz) {
+      q = p4est_quadrant_array_index (quadrants, zz);
+      qcid = p4est_quadrant_child_id (q);
+      enodes = lnodes->element_nodes + P4EST_CHILDREN * ne;
+
+      /* determine hanging corner status from the lnodes face code */
+      memset (quad_status, 0, sizeof (quad_status));
+#ifndef P4_TO_P8
+      has_hanging = p4est_lnodes_decode (lnodes->face_code[ne],
+                                         hanging_face);
+#else
+      has_hanging = p8est_lnodes_decode (lnodes->face_code[ne],
+                                         hanging_face, hanging_edge);
+#endif
+      if (has_hanging) {
+        P4EST_ASSERT (q->level > 0);
+        p4est_quadrant_parent (q, &p);
+        for (k = 0; k < P4EST_DIM; ++k) {
+          face = p4est_corner_faces[qcid][k];
+          if (hanging_face[face] >= 0) {
+            /* the corner opposite qcid on this face hangs in its center */
+            quad_status[qcid ^ ((P4EST_CHILDREN - 1) ^ (1 << k))] = 1;
+          }
+#ifdef P4_TO_P8
+          edge = p8est_corner_edges[qcid][k];
+          if (hanging_edge[edge] >= 0) {
+            quad_status[qcid ^ (1 << k)] = 2;
+          }
+#endif
+        }
+      }
+
+      /* match the independent nodes with their lnodes numbers */
+      for (k = 0; k < P4EST_CHILDREN; ++k) {
+        nid = enodes[k];
+        P4EST_ASSERT (nid >= 0 && nid < num_indep_nodes);
+        quad_indeps[k] = (nid < num_owned_indeps) ?
+          offset_owned_indeps + nid : nid - num_owned_indeps;
+        if (!node_seen[nid]) {
+          /* a hanging slot refers to the matching parent corner */
+          p4est_quadrant_corner_node (quad_status[k] ? &p : q, k, &n);
+          p4est_node_canonicalize (p4est, jt, &n, &c);
+          r = (p4est_quadrant_t *)
+            sc_array_index (inda, (size_t) quad_indeps[k]);
+          *r = c;
+          in = (p4est_indep_t *) r;
+          in->pad8 = 0;         /* shared by 0 other processors so far */
+          in->pad16 = (int16_t) (-1);
+          node_seen[nid] = 1;
+        }
+        if (quad_status[k] == 0) {
+          quad_nodes[k] = quad_indeps[k];
+        }
+      }
+      if (!has_hanging) {
+        continue;
+      }
+
+      /* create hanging node records exactly as p4est_nodes_new would */
+      for (k = 0; k < P4EST_CHILDREN; ++k) {
+        if (quad_status[k] == 1) {
+          P4EST_ASSERT (qcid != k && quad_indeps[qcid] != quad_indeps[k]);
+          p4est_quadrant_corner_node (q, k, &n);
+          p4est_node_canonicalize (p4est, jt, &n, &c);
+          r =
+            (p4est_quadrant_t *) sc_hash_array_insert_unique (face_hangings,
+                                                              &c, &position);
+          if (r != NULL) {
+            *r = c;
+            P4EST_ASSERT (num_face_hangings == (p4est_locidx_t) position);
+#ifndef P4_TO_P8
+            fh = (p4est_hang2_t *) r;
+            first = quad_indeps[qcid];
+            second = quad_indeps[k];
+            if (first < second) {
+              fh->p.piggy.depends[0] = first;
+              fh->p.piggy.depends[1] = second;
+            }
+            else {
+              fh->p.piggy.depends[0] = second;
+              fh->p.piggy.depends[1] = first;
+            }
+#else
+            fh = (p8est_hang4_t *) r;
+            face = p8est_child_corner_faces[qcid][k];
+            P4EST_ASSERT (face >= 0);
+            for (l = 0; l < 4; ++l) {
+              fh->p.piggy.depends[l] =
+                quad_indeps[p8est_face_corners[face][l]];
+            }
+            qsort (fh->p.piggy.depends,
+                   4, sizeof (p4est_locidx_t), p4est_locidx_compare);
+#endif
+            ++num_face_hangings;
+          }
+          else {
+            ++dup_face_hangings;
+          }
+          quad_nodes[k] =       /* same type */
+            num_indep_nodes + (p4est_locidx_t) position;
+        }
+#ifdef P4_TO_P8
+        else if (quad_status[k] == 2) {
+          P4EST_ASSERT (qcid != k && quad_indeps[qcid] != quad_indeps[k]);
+          p4est_quadrant_corner_node (q, k, &n);
+          p4est_node_canonicalize (p4est, jt, &n, &c);
+          r =
+            (p4est_quadrant_t *) sc_hash_array_insert_unique (edge_hangings,
+                                                              &c, &position);
+          if (r != NULL) {
+            *r = c;
+            P4EST_ASSERT (num_edge_hangings == (p4est_locidx_t) position);
+            eh = (p8est_hang2_t *) r;
+            first = quad_indeps[qcid];
+            second = quad_indeps[k];
+            if (first < second) {
+              eh->p.piggy.depends[0] = first;
+              eh->p.piggy.depends[1] = second;
+            }
+            else {
+              eh->p.piggy.depends[0] = second;
+              eh->p.piggy.depends[1] = first;
+            }
+            ++num_edge_hangings;
+          }
+          else {
+            ++dup_edge_hangings;
+          }
+          quad_nodes[k] =       /* same type */
+            num_edge_hangings_begin + (p4est_locidx_t) position;
+        }
+#endif
+      }
+    }
+  }
+  P4EST_ASSERT (ne == nodes->num_local_quadrants);
+  P4EST_FREE (node_seen);
+  sc_hash_array_rip (face_hangings, faha);
+  P4EST_ASSERT (num_face_hangings == (p4est_locidx_t) faha->elem_count);
+#ifdef P4_TO_P8
+  P4EST_ASSERT (num_face_hangings + dup_face_hangings == all_face_hangings);
+  sc_hash_array_rip (edge_hangings, edha);
+  P4EST_ASSERT (num_edge_hangings == (p4est_locidx_t) edha->elem_count);
+
+  /* Correct the offsets of edge hanging nodes */
+  for (il = 0; il < num_local_nodes; ++il) {
+    if (local_nodes[il] >= num_edge_hangings_begin) {
+      local_nodes[il] -= dup_face_hangings;
+    }
+  }
+#endif
+
+  /* Translate the sharers array into per-node sharer lists */
+  num_owned_shared = 0;
+  sharer_counts = P4EST_ALLOC_ZERO (p4est_locidx_t, num_indep_nodes + 1);
+  for (zz = 0; zz < lnodes->sharers->elem_count; ++zz) {
+    lrank = p4est_lnodes_rank_array_index (lnodes->sharers, zz);
+    if (lrank->rank == rank) {
+      continue;
+    }
+    for (position = 0; position < lrank->shared_nodes.elem_count;
+         ++position) {
+      nid = *(p4est_locidx_t *) sc_array_index (&lrank->shared_nodes,
+                                                position);
+      ++sharer_counts[nid + 1];
+    }
+  }
+  for (il = 0; il < num_indep_nodes; ++il) {
+    sharer_counts[il + 1] += sharer_counts[il];
+  }
+  sharer_ranks = P4EST_ALLOC (int, sharer_counts[num_indep_nodes]);
+  for (zz = 0; zz < lnodes->sharers->elem_count; ++zz) {
+    lrank = p4est_lnodes_rank_array_index (lnodes->sharers, zz);
+    if (lrank->rank == rank) {
+      continue;
+    }
+    for (position = 0; position < lrank->shared_nodes.elem_count;
+         ++position) {
+      nid = *(p4est_locidx_t *) sc_array_index (&lrank->shared_nodes,
+                                                position);
+      sharer_ranks[sharer_counts[nid]++] = lrank->rank;
+    }
+  }
+
+  /* Store the sharer lists in the recycle arrays */
+  for (il = 0; il < num_indep_nodes; ++il) {
+    nid = (il < offset_owned_indeps) ?
+      num_owned_indeps + il : il - offset_owned_indeps;
+    first = (nid > 0) ? sharer_counts[nid - 1] : 0;
+    num_sharers = (size_t) (sharer_counts[nid] - first);
+    if (num_sharers == 0) {
+      continue;
+    }
+    P4EST_ASSERT (num_sharers <= (size_t) INT8_MAX);
+    if (il >= offset_owned_indeps) {
+      ++num_owned_shared;
+    }
+    if (shared_indeps->elem_count < num_sharers) {
+      nrarr = NULL;
+      old_position = shared_indeps->elem_count;
+      sc_array_resize (shared_indeps, num_sharers);
+      for (zz = old_position; zz < num_sharers; ++zz) {
+        nrarr = (sc_recycle_array_t *) sc_array_index (shared_indeps, zz);
+        sc_recycle_array_init (nrarr, (zz + 1) * sizeof (int));
+      }
+    }
+    else {
+      nrarr =
+        (sc_recycle_array_t *) sc_array_index (shared_indeps,
+                                               num_sharers - 1);
+    }
+    new_sharers = (int *) sc_recycle_array_insert (nrarr, &new_position);
+    memcpy (new_sharers, sharer_ranks + first, num_sharers * sizeof (int));
+    in = (p4est_indep_t *) sc_array_index (inda, (size_t) il);
+    in->pad8 = (int8_t) num_sharers;
+    if (shared_offsets == NULL) {
+      if (new_position > (size_t) INT16_MAX) {
+        shared_offsets = p4est_shared_offsets (inda);
+        shared_offsets[il] = (p4est_locidx_t) new_position;
+      }
+      else {
+        in->pad16 = (int16_t) new_position;
+      }
+    }
+    else {
+      shared_offsets[il] = (p4est_locidx_t) new_position;
+    }
+  }
+  P4EST_FREE (sharer_counts);
+  P4EST_FREE (sharer_ranks);
+
+  /* Allocate remaining output data structures */
+  nodes->num_owned_indeps = num_owned_indeps;
+  nodes->num_owned_shared = num_owned_shared;
+  nodes->offset_owned_indeps = offset_owned_indeps;
+  nodes->nonlocal_ranks = P4EST_ALLOC (int, offset_owned_indeps);
+  nodes->global_owned_indeps = P4EST_ALLOC (p4est_locidx_t, num_procs);
+  memcpy (nodes->global_owned_indeps, lnodes->global_owned_count,
+          num_procs * sizeof (p4est_locidx_t));
+  nodes->shared_offsets = shared_offsets;
+
+  /* Assign the owner indices of the independent nodes and unclamp */
+  owner = 0;
+  goffset = 0;
+  for (il = 0; il < num_indep_nodes; ++il) {
+    in = (p4est_indep_t *) sc_array_index (inda, (size_t) il);
+    p4est_node_unclamp ((p4est_quadrant_t *) in);
+    if (il < offset_owned_indeps) {
+      gnum = lnodes->nonlocal_nodes[il];
+      while (gnum >= goffset +
+             (p4est_gloidx_t) lnodes->global_owned_count[owner]) {
+        goffset += (p4est_gloidx_t) lnodes->global_owned_count[owner++];
+        P4EST_ASSERT (owner < num_procs);
+      }
+      P4EST_ASSERT (owner != rank);
+      nodes->nonlocal_ranks[il] = owner;
+      in->p.piggy3.local_num = (p4est_locidx_t) (gnum - goffset);
+    }
+    else {
+      in->p.piggy3.local_num = il - offset_owned_indeps;
+    }
+  }
+
+  /* Unclamp the hanging nodes as well */
+  for (zz = 0; zz < faha->elem_count; ++zz) {
+#ifdef P4_TO_P8
+    fh = (p8est_hang4_t *) sc_array_index (faha, zz);
+#else
+    fh = (p4est_hang2_t *) sc_array_index (faha, zz);
+#endif
+    p4est_node_unclamp ((p4est_quadrant_t *) fh);
+  }
+#ifdef P4_TO_P8
+  for (zz = 0; zz < edha->elem_count; ++zz) {
+    eh = (p8est_hang2_t *) sc_array_index (edha, zz);
+    p4est_node_unclamp ((p4est_quadrant_t *) eh);
+  }
+#endif
+
+  /* Print some statistics and clean up */
+  P4EST_VERBOSEF ("Converted %lld independent nodes from the lnodes\n",
+                  (long long) num_indep_nodes);
+  P4EST_VERBOSEF ("Collected %lld face hangings with %lld duplicates\n",
+                  (long long) num_face_hangings,
+                  (long long) dup_face_hangings);
+#ifdef P4_TO_P8
+  P4EST_VERBOSEF ("Collected %lld edge hangings with %lld duplicates\n",
+                  (long long) num_edge_hangings,
+                  (long long) dup_edge_hangings);
+#endif
+
+  P4EST_ASSERT (p4est_nodes_is_valid (p4est, nodes));
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_nodes_new_from_lnodes\n");
+
+  return nodes;
+}
+
 void
 p4est_nodes_destroy (p4est_nodes_t * nodes)
 {
@@ -27,6 +27,7 @@
 
 #include <p4est.h>
 #include <p4est_ghost.h>
+#include <p4est_lnodes.h>
 
 SC_EXTERN_C_BEGIN;
 
@@ -164,6 +165,21 @@ p4est_nodes_t;
  */
 p4est_nodes_t      *p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost);
 
+/** Create node information from a degree 1 lnodes structure.
+ * The parallel node numbering in \ref p4est_lnodes_new is computed
+ * considerably faster than \ref p4est_nodes_new since it avoids hashing
+ * the independent nodes; this function translates its result into the
+ * nodes layout expected by legacy code.
+ * \param [in] p4est    The forest the node numbering was created for.
+ * \param [in] lnodes   A valid node numbering of degree 1 created for
+ *                      \a p4est in its current state.  It is not modified.
+ * \return              A fully populated nodes structure equivalent to the
+ *                      result of \ref p4est_nodes_new with a ghost layer,
+ *                      up to the ordering of the nodes.
+ */
+p4est_nodes_t      *p4est_nodes_new_from_lnodes (p4est_t * p4est,
+                                                 p4est_lnodes_t * lnodes);
+
 /** Destroy node information. */
 void                p4est_nodes_destroy (p4est_nodes_t * nodes);
 
@@ -22,14 +22,6 @@
   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
 */
 
-/********************************************************************
- *                          IMPORTANT NOTE                          *
- *                                                                  *
- * The p4est_points functionality depends on sc/src/sc_sort.        *
- * That parallel bitonic sort is still buggy (see sc/bugs).         *
- * If you want to use this code you have to fix the sort first.     *
- ********************************************************************/
-
 #ifdef P4_TO_P8
 #include <p8est_algorithms.h>
 #include <p8est_bits.h>
@@ -43,8 +35,6 @@
 #include <p4est_extended.h>
 #include <p4est_points.h>
 #endif /* !P4_TO_P8 */
-#include <sc_allgather.h>
-#include <sc_sort.h>
 
 typedef struct
 {
@@ -96,6 +86,197 @@ p4est_points_refine (p4est_t * p4est, p4est_topidx_t which_tree,
   }
 }
 
+/** Splitter candidates proposed per process by the sample sort below.
+ * A constant oversampling keeps the candidate gather and the histogram
+ * at O (P) total instead of O (P^2) while still placing each splitter
+ * close to its target quantile. */
+#define P4EST_POINTS_OVERSAMPLE 8
+
+/** Sort the points in parallel by tree number and Morton index.
+ *
+ * This is a histogram sample sort: after a local sort, every process
+ * proposes a few evenly spaced splitter candidates from its points.
+ * The candidates are shared and weighted by a global histogram computed
+ * with a single allreduce, from which the candidates closest to the
+ * ideal quantiles are selected as splitters.  The points are then
+ * exchanged in one all-to-all round and the original distribution of
+ * counts is restored with a fixed-size transfer.
+ *
+ * On return, \a points is globally sorted and each process holds the
+ * same number of points that it passed in.
+ */
+static void
+p4est_points_sample_sort (sc_MPI_Comm mpicomm, p4est_quadrant_t * points,
+                          p4est_locidx_t num_points)
+{
+  int                 mpiret;
+  int                 num_procs;
+#ifdef P4EST_ENABLE_MPI
+  int                 i, j, jbest, ncand, npc, nsplit;
+  int                *scnt, *sdsp, *rcnt, *rdsp;
+  size_t              zz;
+  p4est_locidx_t      rtotal;
+  p4est_locidx_t     *boundary;
+  p4est_gloidx_t      gcount, gtarget, gtotal;
+  p4est_gloidx_t     *lhist, *ghist, *oldgfq, *newgfq;
+  p4est_quadrant_t   *cand, *allcand, *split, *rbuf;
+#endif
+
+  mpiret = sc_MPI_Comm_size (mpicomm, &num_procs);
+  SC_CHECK_MPI (mpiret);
+
+  /* sort the local points */
+  if (num_points > 0) {
+    qsort (points, (size_t) num_points, sizeof (p4est_quadrant_t),
+           p4est_quadrant_compare_piggy);
+  }
+  if (num_procs == 1) {
+    return;
+  }
+
+#ifdef P4EST_ENABLE_MPI
+  /* compute the global prefix of the incoming point counts */
+  oldgfq = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
+  gcount = (p4est_gloidx_t) num_points;
+  mpiret = MPI_Allgather (&gcount, 1, P4EST_MPI_GLOIDX,
+                          oldgfq + 1, 1, P4EST_MPI_GLOIDX, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  oldgfq[0] = 0;
+  for (i = 0; i < num_procs; ++i) {
+    oldgfq[i + 1] += oldgfq[i];
+  }
+  gtotal = oldgfq[num_procs];
+
+  /* every process proposes a bounded number of evenly spaced splitter
+   * candidates instead of one per potential splitter */
+  nsplit = num_procs - 1;
+  npc = SC_MIN (nsplit, P4EST_POINTS_OVERSAMPLE);
+  cand = P4EST_ALLOC (p4est_quadrant_t, npc);
+  for (i = 0; i < npc; ++i) {
+    if (num_points > 0) {
+      cand[i] = points[(size_t) (i + 1) * num_points / (npc + 1)];
+    }
+    else {
+      /* an empty process contributes the smallest possible node */
+      P4EST_QUADRANT_INIT (cand + i);
+      cand[i].x = 0;
+      cand[i].y = 0;
+#ifdef P4_TO_P8
+      cand[i].z = 0;
+#endif
+      cand[i].level = P4EST_MAXLEVEL;
+      cand[i].p.which_tree = 0;
+    }
+  }
+  ncand = num_procs * npc;
+  allcand = P4EST_ALLOC (p4est_quadrant_t, ncand);
+  mpiret = MPI_Allgather (cand, npc * (int) sizeof (p4est_quadrant_t),
+                          MPI_BYTE, allcand,
+                          npc * (int) sizeof (p4est_quadrant_t),
+                          MPI_BYTE, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (cand);
+  qsort (allcand, (size_t) ncand, sizeof (p4est_quadrant_t),
+         p4est_quadrant_compare_piggy);
+
+  /* weight the candidates by a global histogram in one allreduce */
+  lhist = P4EST_ALLOC (p4est_gloidx_t, ncand);
+  ghist = P4EST_ALLOC (p4est_gloidx_t, ncand);
+  zz = 0;
+  for (j = 0; j < ncand; ++j) {
+    while (zz < (size_t) num_points &&
+           p4est_quadrant_compare_piggy (points + zz, allcand + j) < 0) {
+      ++zz;
+    }
+    lhist[j] = (p4est_gloidx_t) zz;
+  }
+  mpiret = MPI_Allreduce (lhist, ghist, ncand, P4EST_MPI_GLOIDX,
+                          MPI_SUM, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (lhist);
+
+  /* select the candidate closest to each ideal quantile */
+  split = P4EST_ALLOC (p4est_quadrant_t, nsplit);
+  j = 0;
+  for (i = 0; i < nsplit; ++i) {
+    gtarget = p4est_partition_cut_gloidx (gtotal, i + 1, num_procs);
+    while (j < ncand - 1 && ghist[j] < gtarget) {
+      ++j;
+    }
+    jbest = j;
+    if (j > 0 && gtarget - ghist[j - 1] < ghist[j] - gtarget) {
+      jbest = j - 1;
+    }
+    split[i] = allcand[jbest];
+  }
+  P4EST_FREE (ghist);
+  P4EST_FREE (allcand);
+
+  /* bucket the local points by the splitters */
+  boundary = P4EST_ALLOC (p4est_locidx_t, nsplit);
+  zz = 0;
+  for (i = 0; i < nsplit; ++i) {
+    while (zz < (size_t) num_points &&
+           p4est_quadrant_compare_piggy (points + zz, split + i) < 0) {
+      ++zz;
+    }
+    boundary[i] = (p4est_locidx_t) zz;
+  }
+  P4EST_FREE (split);
+  scnt = P4EST_ALLOC (int, num_procs);
+  sdsp = P4EST_ALLOC (int, num_procs);
+  rcnt = P4EST_ALLOC (int, num_procs);
+  rdsp = P4EST_ALLOC (int, num_procs);
+  for (i = 0; i < num_procs; ++i) {
+    scnt[i] = (int) (((i == nsplit) ? num_points : boundary[i]) -
+                     ((i == 0) ? 0 : boundary[i - 1])) *
+      (int) sizeof (p4est_quadrant_t);
+    sdsp[i] = (i == 0) ? 0 : sdsp[i - 1] + scnt[i - 1];
+  }
+  P4EST_FREE (boundary);
+
+  /* exchange bucket sizes and points in one all-to-all round */
+  mpiret = MPI_Alltoall (scnt, 1, MPI_INT, rcnt, 1, MPI_INT, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  rtotal = 0;
+  for (i = 0; i < num_procs; ++i) {
+    rdsp[i] = (i == 0) ? 0 : rdsp[i - 1] + rcnt[i - 1];
+    rtotal += (p4est_locidx_t) (rcnt[i] / (int) sizeof (p4est_quadrant_t));
+  }
+  rbuf = P4EST_ALLOC (p4est_quadrant_t, rtotal);
+  mpiret = MPI_Alltoallv (points, scnt, sdsp, MPI_BYTE,
+                          rbuf, rcnt, rdsp, MPI_BYTE, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (scnt);
+  P4EST_FREE (sdsp);
+  P4EST_FREE (rcnt);
+  P4EST_FREE (rdsp);
+
+  /* the buckets arrive sorted by source; sort their concatenation */
+  if (rtotal > 0) {
+    qsort (rbuf, (size_t) rtotal, sizeof (p4est_quadrant_t),
+           p4est_quadrant_compare_piggy);
+  }
+
+  /* restore the original point counts with a fixed-size transfer */
+  newgfq = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
+  gcount = (p4est_gloidx_t) rtotal;
+  mpiret = MPI_Allgather (&gcount, 1, P4EST_MPI_GLOIDX,
+                          newgfq + 1, 1, P4EST_MPI_GLOIDX, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  newgfq[0] = 0;
+  for (i = 0; i < num_procs; ++i) {
+    newgfq[i + 1] += newgfq[i];
+  }
+  P4EST_ASSERT (newgfq[num_procs] == gtotal);
+  p4est_transfer_fixed (oldgfq, newgfq, mpicomm, points, rbuf,
+                        sizeof (p4est_quadrant_t));
+  P4EST_FREE (newgfq);
+  P4EST_FREE (oldgfq);
+  P4EST_FREE (rbuf);
+#endif /* P4EST_ENABLE_MPI */
+}
+
 p4est_t            *
 p4est_new_points (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
                   int maxlevel, p4est_quadrant_t * points,
@@ -104,10 +285,9 @@ p4est_new_points (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
 {
   int                 mpiret;
   int                 num_procs, rank;
-  int                 i, isizet;
-  size_t              lcount;
-  size_t             *nmemb;
+  int                 i;
 #ifdef P4EST_ENABLE_DEBUG
+  size_t              lcount;
   size_t              zz;
 #endif
   p4est_topidx_t      jt, num_trees;
@@ -141,16 +321,9 @@ p4est_new_points (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
    */
 
   /* parallel sort the incoming points */
-  lcount = (size_t) num_points;
-  nmemb = P4EST_ALLOC_ZERO (size_t, num_procs);
-  isizet = (int) sizeof (size_t);
-  mpiret = sc_MPI_Allgather (&lcount, isizet, sc_MPI_BYTE,
-                             nmemb, isizet, sc_MPI_BYTE, mpicomm);
-  SC_CHECK_MPI (mpiret);
-  sc_psort (mpicomm, points, nmemb, sizeof (p4est_quadrant_t),
-            p4est_quadrant_compare_piggy);
-  P4EST_FREE (nmemb);
+  p4est_points_sample_sort (mpicomm, points, num_points);
 #ifdef P4EST_ENABLE_DEBUG
+  lcount = (size_t) num_points;
   first_quad = points;
   for (zz = 1; zz < lcount; ++zz) {
     next_quad = points + zz;
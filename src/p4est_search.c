@@ -32,9 +32,15 @@
 #include <p8est_search.h>
 #endif
 
-ssize_t
-p4est_find_lower_bound (sc_array_t * array,
-                        const p4est_quadrant_t * q, size_t guess)
+/** Strategy for the bound searches chosen by \ref p4est_search_bound_tune:
+ * -1 before the measurement, 0 for the guess-seeded bisection, and 1 for
+ * the branchless halving. */
+static int          p4est_find_bound_strategy = -1;
+
+/** The historic guess-seeded bisection behind \ref p4est_find_lower_bound. */
+static ssize_t
+p4est_find_lower_bound_seeded (sc_array_t * array,
+                               const p4est_quadrant_t * q, size_t guess)
 {
   int                 comp;
   size_t              count;
@@ -81,9 +87,10 @@ p4est_find_lower_bound (sc_array_t * array,
   return (ssize_t) guess;
 }
 
-ssize_t
-p4est_find_higher_bound (sc_array_t * array,
-                         const p4est_quadrant_t * q, size_t guess)
+/** The historic guess-seeded bisection behind \ref p4est_find_higher_bound. */
+static ssize_t
+p4est_find_higher_bound_seeded (sc_array_t * array,
+                                const p4est_quadrant_t * q, size_t guess)
 {
   int                 comp;
   size_t              count;
@@ -134,20 +141,187 @@ p4est_find_higher_bound (sc_array_t * array,
   return (ssize_t) guess;
 }
 
-static              size_t
-p4est_array_split_ancestor_id (sc_array_t * array, size_t zindex, void *data)
+/** Branchless variant of \ref p4est_find_lower_bound.
+ * The range is halved by a conditional index update that compiles to a
+ * conditional move, so the search runs without mispredicted branches at
+ * the price of ignoring the caller's seed.
+ */
+static ssize_t
+p4est_find_lower_bound_branchless (sc_array_t * array,
+                                   const p4est_quadrant_t * q)
+{
+  size_t              low, half, n;
+  p4est_quadrant_t   *cur;
+
+  n = array->elem_count;
+  if (n == 0)
+    return -1;
+
+  /* the lowest position >= q stays inside [low, low + n] throughout */
+  low = 0;
+  while (n > 1) {
+    half = n / 2;
+    cur = p4est_quadrant_array_index (array, low + half - 1);
+    if (p4est_quadrant_compare (cur, q) < 0) {
+      low += half;
+    }
+    n -= half;
+  }
+  cur = p4est_quadrant_array_index (array, low);
+  if (p4est_quadrant_compare (cur, q) < 0) {
+    ++low;
+  }
+
+  return low == array->elem_count ? -1 : (ssize_t) low;
+}
+
+/** Branchless variant of \ref p4est_find_higher_bound.
+ * See \ref p4est_find_lower_bound_branchless.
+ */
+static ssize_t
+p4est_find_higher_bound_branchless (sc_array_t * array,
+                                    const p4est_quadrant_t * q)
+{
+  size_t              low, half, n;
+  p4est_quadrant_t   *cur;
+
+  n = array->elem_count;
+  if (n == 0)
+    return -1;
+
+  /* find the lowest position > q; its predecessor is the result */
+  low = 0;
+  while (n > 1) {
+    half = n / 2;
+    cur = p4est_quadrant_array_index (array, low + half - 1);
+    if (p4est_quadrant_compare (cur, q) <= 0) {
+      low += half;
+    }
+    n -= half;
+  }
+  cur = p4est_quadrant_array_index (array, low);
+  if (p4est_quadrant_compare (cur, q) <= 0) {
+    ++low;
+  }
+
+  return low == 0 ? -1 : (ssize_t) (low - 1);
+}
+
+void
+p4est_search_bound_tune (void)
+{
+  const size_t        nquads = (size_t) 1 << 14;
+  const size_t        nqueries = (size_t) 1 << 12;
+  int                 level;
+  size_t              zz, guess;
+  ssize_t             result, sink = 0;
+  uint64_t            id, stride, lcg;
+  double              tseed, tflat;
+  sc_array_t         *aq;
+  p4est_quadrant_t   *cur, query;
+
+  /* build a synthetic uniform leaf array in Morton order */
+  level = 0;
+  while (((uint64_t) 1 << (P4EST_DIM * level)) < nquads) {
+    ++level;
+  }
+  stride = ((uint64_t) 1 << (P4EST_DIM * level)) / (uint64_t) nquads;
+  aq = sc_array_new_count (sizeof (p4est_quadrant_t), nquads);
+  for (zz = 0; zz < nquads; ++zz) {
+    cur = p4est_quadrant_array_index (aq, zz);
+    P4EST_QUADRANT_INIT (cur);
+    p4est_quadrant_set_morton (cur, level, (uint64_t) zz * stride);
+  }
+
+  /* the query stream mixes carried-guess locality with random jumps,
+   * which is where the strategies trade places */
+  tseed = sc_MPI_Wtime ();
+  guess = nquads / 2;
+  lcg = 1;
+  for (zz = 0; zz < nqueries; ++zz) {
+    lcg = lcg * 6364136223846793005ULL + 1442695040888963407ULL;
+    id = (zz % 2) ? (uint64_t) zz * stride :
+      (lcg >> 16) % ((uint64_t) nquads * stride);
+    p4est_quadrant_set_morton (&query, level, id);
+    result = p4est_find_higher_bound_seeded (aq, &query, guess);
+    sink += result;
+    guess = result >= 0 ? (size_t) result : nquads / 2;
+  }
+  tseed = sc_MPI_Wtime () - tseed;
+
+  tflat = sc_MPI_Wtime ();
+  lcg = 1;
+  for (zz = 0; zz < nqueries; ++zz) {
+    lcg = lcg * 6364136223846793005ULL + 1442695040888963407ULL;
+    id = (zz % 2) ? (uint64_t) zz * stride :
+      (lcg >> 16) % ((uint64_t) nquads * stride);
+    p4est_quadrant_set_morton (&query, level, id);
+    sink += p4est_find_higher_bound_branchless (aq, &query);
+  }
+  tflat = sc_MPI_Wtime () - tflat;
+  sc_array_destroy (aq);
+
+  p4est_find_bound_strategy = tflat < tseed ? 1 : 0;
+  P4EST_LDEBUGF ("search bound tune seeded %g flat %g chose %d (%ld)\n",
+                 tseed, tflat, p4est_find_bound_strategy, (long) sink);
+}
+
+/** Run the measurement exactly once, also when the first searches
+ * arrive on concurrent threads.  The critical section serializes the
+ * callers and its re-check leaves the measurement to the first one,
+ * which times the strategies while the others are blocked rather than
+ * contending on the memory system.
+ */
+static void
+p4est_search_bound_tune_once (void)
 {
-  int                *levelp = (int *) data;
-  p4est_quadrant_t   *q = p4est_quadrant_array_index (array, zindex);
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp critical (p4est_search_bound)
+#endif
+  {
+    if (p4est_find_bound_strategy < 0) {
+      p4est_search_bound_tune ();
+    }
+  }
+}
 
-  return ((size_t) p4est_quadrant_ancestor_id (q, *levelp));
+ssize_t
+p4est_find_lower_bound (sc_array_t * array,
+                        const p4est_quadrant_t * q, size_t guess)
+{
+  if (p4est_find_bound_strategy < 0) {
+    p4est_search_bound_tune_once ();
+  }
+  if (p4est_find_bound_strategy) {
+    return p4est_find_lower_bound_branchless (array, q);
+  }
+  return p4est_find_lower_bound_seeded (array, q, guess);
 }
 
+ssize_t
+p4est_find_higher_bound (sc_array_t * array,
+                         const p4est_quadrant_t * q, size_t guess)
+{
+  if (p4est_find_bound_strategy < 0) {
+    p4est_search_bound_tune_once ();
+  }
+  if (p4est_find_bound_strategy) {
+    return p4est_find_higher_bound_branchless (array, q);
+  }
+  return p4est_find_higher_bound_seeded (array, q, guess);
+}
+
+/** Below this quadrant count a single linear pass over the array fills
+ * all child boundaries faster than per-child binary searches. */
+#define P4EST_SPLIT_ARRAY_LINEAR 64
+
 void
 p4est_split_array (sc_array_t * array, int level, size_t indices[])
 {
+  int                 id, cid;
   size_t              count = array->elem_count;
-  sc_array_t          view;
+  size_t              zz, zlo, half, n;
+  p4est_quadrant_t   *q;
 #ifdef P4EST_ENABLE_DEBUG
   p4est_quadrant_t   *test1, test2;
   p4est_quadrant_t   *cur;
@@ -174,10 +348,46 @@ p4est_split_array (sc_array_t * array, int level, size_t indices[])
   P4EST_ASSERT ((int) test2.level >= level);
 #endif
 
-  sc_array_init_data (&view, indices, sizeof (size_t), P4EST_CHILDREN + 1);
+  /* classify by the child id of each quadrant's ancestor one level down */
   level++;
-  sc_array_split (array, &view, P4EST_CHILDREN, p4est_array_split_ancestor_id,
-                  &level);
+  indices[0] = 0;
+  indices[P4EST_CHILDREN] = count;
+  if (count <= P4EST_SPLIT_ARRAY_LINEAR) {
+    /* deep levels of a search recursion produce many small windows where
+     * one scan over the array beats P4EST_CHILDREN binary searches */
+    id = 0;
+    for (zz = 0; zz < count; ++zz) {
+      q = p4est_quadrant_array_index (array, zz);
+      cid = p4est_quadrant_ancestor_id (q, level);
+      P4EST_ASSERT (id <= cid);
+      while (id < cid) {
+        indices[++id] = zz;
+      }
+    }
+    while (id < P4EST_CHILDREN - 1) {
+      indices[++id] = count;
+    }
+  }
+  else {
+    /* each boundary is the lower bound of its child id; successive
+     * searches shrink from the left since the boundaries are sorted */
+    zlo = 0;
+    for (id = 1; id < P4EST_CHILDREN; ++id) {
+      n = count - zlo;
+      while (n > 0) {
+        half = n >> 1;
+        q = p4est_quadrant_array_index (array, zlo + half);
+        if (p4est_quadrant_ancestor_id (q, level) < id) {
+          zlo += half + 1;
+          n -= half + 1;
+        }
+        else {
+          n = half;
+        }
+      }
+      indices[id] = zlo;
+    }
+  }
 }
 
 /** If we suppose a range of quadrants touches a corner of a tree, then it must
@@ -647,3 +857,749 @@ p4est_search (p4est_t * p4est, p4est_search_query_t search_quadrant_fn,
     sc_array_reset (acts);
   }
 }
+
+/** One suspended level of the iterative search traversal. */
+typedef struct p4est_search_frame
+{
+  p4est_quadrant_t    quadrant; /**< Ancestor of the frame's window. */
+  size_t              offset;   /**< Window start in the tree's storage. */
+  size_t              count;    /**< Number of quadrants in the window. */
+  int                 child;    /**< Next child to descend; -1 before the
+                                     frame has been entered. */
+  size_t              split[P4EST_CHILDREN + 1];   /**< Absolute window
+                                     bounds of the quadrant's children. */
+}
+p4est_search_frame_t;
+
+/** Explicit stack replacing the recursion of \ref p4est_search. */
+struct p4est_search_cursor
+{
+  p4est_t            *p4est;            /**< Forest being traversed. */
+  p4est_search_query_t search_quadrant_fn;      /**< The quadrant callback. */
+  p4est_topidx_t      which_tree;       /**< Current tree number. */
+  sc_array_t          stack;            /**< Of p4est_search_frame_t. */
+};
+
+p4est_search_cursor_t *
+p4est_search_cursor_new (p4est_t * p4est,
+                         p4est_search_query_t search_quadrant_fn)
+{
+  p4est_search_cursor_t *cursor;
+
+  P4EST_ASSERT (p4est != NULL);
+
+  cursor = P4EST_ALLOC (p4est_search_cursor_t, 1);
+  cursor->p4est = p4est;
+  cursor->search_quadrant_fn = search_quadrant_fn;
+  cursor->which_tree = p4est->first_local_tree - 1;
+  sc_array_init (&cursor->stack, sizeof (p4est_search_frame_t));
+
+  return cursor;
+}
+
+int
+p4est_search_next (p4est_search_cursor_t * cursor,
+                   p4est_topidx_t * which_tree,
+                   p4est_quadrant_t ** quadrant, p4est_locidx_t * local_num)
+{
+  int                 i;
+  size_t              boffset, bcount;
+  p4est_t            *p4est;
+  p4est_locidx_t      lnum;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t    parent;
+  p4est_quadrant_t   *q, *lq;
+  p4est_search_frame_t *frame;
+  sc_array_t          view;
+
+  P4EST_ASSERT (cursor != NULL);
+  p4est = cursor->p4est;
+
+  for (;;) {
+    if (cursor->stack.elem_count == 0) {
+      /* advance to the next local tree and push its root frame */
+      if (cursor->which_tree >= p4est->last_local_tree) {
+        /* the traversal is exhausted; stay that way for repeated calls */
+        return 0;
+      }
+      ++cursor->which_tree;
+      tree = p4est_tree_array_index (p4est->trees, cursor->which_tree);
+      P4EST_ASSERT (tree->quadrants.elem_count > 0);
+
+      /* find the smallest quadrant that contains all of this tree */
+      q = p4est_quadrant_array_index (&tree->quadrants, 0);
+      lq = p4est_quadrant_array_index (&tree->quadrants,
+                                       tree->quadrants.elem_count - 1);
+      frame = (p4est_search_frame_t *) sc_array_push (&cursor->stack);
+      p4est_nearest_common_ancestor (q, lq, &frame->quadrant);
+      frame->offset = 0;
+      frame->count = tree->quadrants.elem_count;
+      frame->child = -1;
+      continue;
+    }
+
+    frame = (p4est_search_frame_t *)
+      sc_array_index (&cursor->stack, cursor->stack.elem_count - 1);
+    tree = p4est_tree_array_index (p4est->trees, cursor->which_tree);
+
+    if (frame->child == -1) {
+      /* this frame is entered for the first time */
+      q = p4est_quadrant_array_index (&tree->quadrants, frame->offset);
+      if (frame->count == 1) {
+        /* the frame's window has shrunk to a single leaf */
+        P4EST_ASSERT (p4est_quadrant_is_equal (&frame->quadrant, q) ||
+                      p4est_quadrant_is_ancestor (&frame->quadrant, q));
+        lnum = tree->quadrants_offset + (p4est_locidx_t) frame->offset;
+        sc_array_resize (&cursor->stack, cursor->stack.elem_count - 1);
+        if (cursor->search_quadrant_fn != NULL &&
+            !cursor->search_quadrant_fn (p4est, cursor->which_tree,
+                                         q, lnum, NULL)) {
+          continue;
+        }
+        if (which_tree != NULL) {
+          *which_tree = cursor->which_tree;
+        }
+        if (quadrant != NULL) {
+          *quadrant = q;
+        }
+        if (local_num != NULL) {
+          *local_num = lnum;
+        }
+        return 1;
+      }
+      P4EST_ASSERT (p4est_quadrant_is_ancestor (&frame->quadrant, q));
+      lq = p4est_quadrant_array_index (&tree->quadrants,
+                                       frame->offset + frame->count - 1);
+      P4EST_ASSERT (!p4est_quadrant_is_equal (q, lq) &&
+                    p4est_quadrant_is_ancestor (&frame->quadrant, lq));
+
+      /* skip unnecessary intermediate levels if possible */
+      if (p4est_quadrant_ancestor_id (q, frame->quadrant.level + 1) ==
+          p4est_quadrant_ancestor_id (lq, frame->quadrant.level + 1)) {
+        p4est_nearest_common_ancestor (q, lq, &frame->quadrant);
+        P4EST_ASSERT (p4est_quadrant_is_ancestor (&frame->quadrant, q));
+        P4EST_ASSERT (p4est_quadrant_is_ancestor (&frame->quadrant, lq));
+      }
+
+      /* execute quadrant callback if present, which may prune the subtree */
+      if (cursor->search_quadrant_fn != NULL &&
+          !cursor->search_quadrant_fn (p4est, cursor->which_tree,
+                                       &frame->quadrant, -1, NULL)) {
+        sc_array_resize (&cursor->stack, cursor->stack.elem_count - 1);
+        continue;
+      }
+
+      /* split the frame's window along the children of its quadrant */
+      sc_array_init_view (&view, &tree->quadrants,
+                          frame->offset, frame->count);
+      p4est_split_array (&view, (int) frame->quadrant.level, frame->split);
+      sc_array_reset (&view);
+      for (i = 0; i <= P4EST_CHILDREN; ++i) {
+        frame->split[i] += frame->offset;
+      }
+      frame->child = 0;
+    }
+
+    /* descend into the next populated child or pop the frame */
+    for (i = frame->child; i < P4EST_CHILDREN; ++i) {
+      if (frame->split[i] < frame->split[i + 1]) {
+        break;
+      }
+    }
+    if (i == P4EST_CHILDREN) {
+      sc_array_resize (&cursor->stack, cursor->stack.elem_count - 1);
+      continue;
+    }
+
+    /* pushing may reallocate the stack; copy the parent data beforehand */
+    parent = frame->quadrant;
+    boffset = frame->split[i];
+    bcount = frame->split[i + 1] - frame->split[i];
+    frame->child = i + 1;
+    frame = (p4est_search_frame_t *) sc_array_push (&cursor->stack);
+    p4est_quadrant_child (&parent, &frame->quadrant, i);
+    frame->offset = boffset;
+    frame->count = bcount;
+    frame->child = -1;
+  }
+}
+
+void
+p4est_search_cursor_destroy (p4est_search_cursor_t * cursor)
+{
+  P4EST_ASSERT (cursor != NULL);
+
+  sc_array_reset (&cursor->stack);
+  P4EST_FREE (cursor);
+}
+
+void
+p4est_search_points_sorted (p4est_t * p4est,
+                            p4est_search_query_t search_point_fn,
+                            sc_array_t * points)
+{
+  size_t              zz;
+  size_t              guess;
+  ssize_t             sidx;
+  p4est_topidx_t      which_tree, current_tree;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *point, *leaf;
+  sc_array_t         *tquadrants;
+
+  P4EST_ASSERT (p4est != NULL);
+  P4EST_ASSERT (search_point_fn != NULL);
+  P4EST_ASSERT (points != NULL);
+  P4EST_ASSERT (points->elem_size == sizeof (p4est_quadrant_t));
+
+  /* establish one Morton-sorted query stream over all trees */
+  sc_array_sort (points, p4est_quadrant_compare_piggy);
+
+  current_tree = -1;
+  tree = NULL;
+  tquadrants = NULL;
+  guess = 0;
+  for (zz = 0; zz < points->elem_count; ++zz) {
+    point = p4est_quadrant_array_index (points, zz);
+    P4EST_ASSERT (p4est_quadrant_is_valid (point));
+    which_tree = point->p.piggy3.which_tree;
+
+    /* the stream is sorted: trees are encountered in ascending order */
+    P4EST_ASSERT (which_tree >= current_tree || current_tree == -1);
+    if (which_tree < p4est->first_local_tree) {
+      continue;
+    }
+    if (which_tree > p4est->last_local_tree) {
+      break;
+    }
+    if (which_tree != current_tree) {
+      current_tree = which_tree;
+      tree = p4est_tree_array_index (p4est->trees, current_tree);
+      tquadrants = &tree->quadrants;
+      guess = 0;
+    }
+    if (tquadrants->elem_count == 0) {
+      continue;
+    }
+
+    /* the containing leaf is the highest local quadrant below the point;
+     * the previous result seeds the bisection, so consecutive queries
+     * landing in nearby leaves resolve in few comparisons */
+    sidx = p4est_find_higher_bound (tquadrants, point, guess);
+    if (sidx < 0) {
+      /* the point lies below this process's quadrant range */
+      continue;
+    }
+    guess = (size_t) sidx;
+    leaf = p4est_quadrant_array_index (tquadrants, (size_t) sidx);
+    if (!p4est_quadrant_is_equal (leaf, point) &&
+        !p4est_quadrant_is_ancestor (leaf, point)) {
+      /* the point lies above this process's quadrant range */
+      continue;
+    }
+
+    /* report the match; the return value cannot prune anything here */
+    (void) search_point_fn (p4est, current_tree, leaf,
+                            tree->quadrants_offset + (p4est_locidx_t) sidx,
+                            point);
+  }
+}
+
+/** This recursion context saves on the number of parameters passed. */
+typedef struct p4est_region_recursion
+{
+  p4est_tree_t       *tree;             /**< Tree being traversed. */
+  const p4est_qcoord_t *lower;          /**< Inclusive lower box corner. */
+  const p4est_qcoord_t *upper;          /**< Exclusive upper box corner. */
+  sc_array_t         *ranges;           /**< Collects the matched runs. */
+}
+p4est_region_recursion_t;
+
+/** Compare a quadrant's extent against the query box.
+ * The extent covered by a quadrant is exactly the coordinate range
+ * between its first and last descendant, so this comparison prunes
+ * the same subtrees that a descendant range test would.
+ * \return  0 if the quadrant is disjoint from the box, 2 if it is
+ *          contained in the box, and 1 for a partial overlap.
+ */
+static int
+p4est_region_classify (const p4est_region_recursion_t * rec,
+                       const p4est_quadrant_t * quadrant)
+{
+  const p4est_qcoord_t h = P4EST_QUADRANT_LEN (quadrant->level);
+  int                 d;
+  int                 inside = 1;
+  p4est_qcoord_t      qlo[P4EST_DIM];
+
+  qlo[0] = quadrant->x;
+  qlo[1] = quadrant->y;
+#ifdef P4_TO_P8
+  qlo[2] = quadrant->z;
+#endif
+  for (d = 0; d < P4EST_DIM; ++d) {
+    if (qlo[d] >= rec->upper[d] || qlo[d] + h <= rec->lower[d]) {
+      return 0;
+    }
+    if (qlo[d] < rec->lower[d] || qlo[d] + h > rec->upper[d]) {
+      inside = 0;
+    }
+  }
+  return inside ? 2 : 1;
+}
+
+/** Append a run of local indices, merging with the previous run. */
+static void
+p4est_region_append (const p4est_region_recursion_t * rec,
+                     p4est_locidx_t begin, p4est_locidx_t end)
+{
+  p4est_index_range_t *r;
+
+  P4EST_ASSERT (begin < end);
+  if (rec->ranges->elem_count > 0) {
+    r = (p4est_index_range_t *)
+      sc_array_index (rec->ranges, rec->ranges->elem_count - 1);
+    P4EST_ASSERT (r->end <= begin);
+    if (r->end == begin) {
+      r->end = end;
+      return;
+    }
+  }
+  r = (p4est_index_range_t *) sc_array_push (rec->ranges);
+  r->begin = begin;
+  r->end = end;
+}
+
+static void
+p4est_region_recursion (const p4est_region_recursion_t * rec,
+                        p4est_quadrant_t * quadrant, sc_array_t * quadrants)
+{
+  const size_t        qcount = quadrants->elem_count;
+  int                 i, touch;
+  size_t              split[P4EST_CHILDREN + 1];
+  p4est_locidx_t      offset;
+  p4est_quadrant_t   *q, *lq, child;
+  sc_array_t          child_quadrants;
+
+  /* the recursion invariants match those of p4est_search_recursion */
+  if (qcount == 0) {
+    return;
+  }
+  q = p4est_quadrant_array_index (quadrants, 0);
+  if (qcount > 1) {
+    P4EST_ASSERT (p4est_quadrant_is_ancestor (quadrant, q));
+    lq = p4est_quadrant_array_index (quadrants, quadrants->elem_count - 1);
+    P4EST_ASSERT (!p4est_quadrant_is_equal (q, lq) &&
+                  p4est_quadrant_is_ancestor (quadrant, lq));
+
+    /* skip unnecessary intermediate levels if possible */
+    if (p4est_quadrant_ancestor_id (q, quadrant->level + 1) ==
+        p4est_quadrant_ancestor_id (lq, quadrant->level + 1)) {
+      p4est_nearest_common_ancestor (q, lq, quadrant);
+      P4EST_ASSERT (p4est_quadrant_is_ancestor (quadrant, q));
+      P4EST_ASSERT (p4est_quadrant_is_ancestor (quadrant, lq));
+    }
+  }
+  else {
+    P4EST_ASSERT (p4est_quadrant_is_equal (quadrant, q) ||
+                  p4est_quadrant_is_ancestor (quadrant, q));
+
+    /* the leaf's own extent decides the match */
+    quadrant = q;
+  }
+
+  /* prune subtrees that lie outside the box without any leaf visits */
+  touch = p4est_region_classify (rec, quadrant);
+  if (touch == 0) {
+    return;
+  }
+
+  /* determine offset of this array view in the local forest */
+  offset = rec->tree->quadrants_offset + (p4est_locidx_t)
+    ((quadrants->array - rec->tree->quadrants.array)
+     / sizeof (p4est_quadrant_t));
+
+  if (touch == 2 || qcount == 1) {
+    /* a contained subtree matches wholesale; a leaf that still
+     * overlaps partially intersects the box and matches as well */
+    p4est_region_append (rec, offset, offset + (p4est_locidx_t) qcount);
+    return;
+  }
+
+  /* partial overlap of an ancestor: split the array and descend */
+  p4est_split_array (quadrants, (int) quadrant->level, split);
+  for (i = 0; i < P4EST_CHILDREN; ++i) {
+    p4est_quadrant_child (quadrant, &child, i);
+    if (split[i] < split[i + 1]) {
+      sc_array_init_view (&child_quadrants, quadrants,
+                          split[i], split[i + 1] - split[i]);
+      p4est_region_recursion (rec, &child, &child_quadrants);
+      sc_array_reset (&child_quadrants);
+    }
+  }
+}
+
+void
+p4est_search_region (p4est_t * p4est, p4est_topidx_t which_tree,
+                     const p4est_qcoord_t lower[],
+                     const p4est_qcoord_t upper[], sc_array_t * ranges)
+{
+  int                 d;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t    root;
+  p4est_quadrant_t   *f, *l;
+  p4est_region_recursion_t srec, *rec = &srec;
+  sc_array_t         *tquadrants;
+
+  P4EST_ASSERT (p4est != NULL);
+  P4EST_ASSERT (0 <= which_tree &&
+                which_tree < p4est->connectivity->num_trees);
+  P4EST_ASSERT (ranges != NULL &&
+                ranges->elem_size == sizeof (p4est_index_range_t));
+
+  for (d = 0; d < P4EST_DIM; ++d) {
+    P4EST_ASSERT (0 <= lower[d] && upper[d] <= P4EST_ROOT_LEN);
+    if (lower[d] >= upper[d]) {
+      /* the box is empty */
+      return;
+    }
+  }
+
+  /* the tree holds no local quadrants */
+  if (which_tree < p4est->first_local_tree ||
+      which_tree > p4est->last_local_tree) {
+    return;
+  }
+  tree = p4est_tree_array_index (p4est->trees, which_tree);
+  tquadrants = &tree->quadrants;
+  if (tquadrants->elem_count == 0) {
+    return;
+  }
+
+  /* find the smallest quadrant that contains all of this tree */
+  f = p4est_quadrant_array_index (tquadrants, 0);
+  l = p4est_quadrant_array_index (tquadrants, tquadrants->elem_count - 1);
+  p4est_nearest_common_ancestor (f, l, &root);
+
+  /* perform top-down search */
+  rec->tree = tree;
+  rec->lower = lower;
+  rec->upper = upper;
+  rec->ranges = ranges;
+  p4est_region_recursion (rec, &root, tquadrants);
+}
+
+void
+p4est_quadrant_array_box_overlap (sc_array_t * quadrants,
+                                  const p4est_qcoord_t lower[],
+                                  const p4est_qcoord_t upper[],
+                                  int8_t * results)
+{
+  const size_t        count = quadrants->elem_count;
+  size_t              zz;
+  int                 m;
+  p4est_qcoord_t      h;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+  P4EST_ASSERT (count == 0 || results != NULL);
+
+  /* one branch-free test per quadrant keeps the loop vectorizable */
+  for (zz = 0; zz < count; ++zz) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    h = P4EST_QUADRANT_LEN (q->level);
+    m = (q->x < upper[0]) & (lower[0] < q->x + h);
+    m &= (q->y < upper[1]) & (lower[1] < q->y + h);
+#ifdef P4_TO_P8
+    m &= (q->z < upper[2]) & (lower[2] < q->z + h);
+#endif
+    results[zz] = (int8_t) m;
+  }
+}
+
+void
+p4est_quadrant_array_box_contained (sc_array_t * quadrants,
+                                    const p4est_qcoord_t lower[],
+                                    const p4est_qcoord_t upper[],
+                                    int8_t * results)
+{
+  const size_t        count = quadrants->elem_count;
+  size_t              zz;
+  int                 m;
+  p4est_qcoord_t      h;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+  P4EST_ASSERT (count == 0 || results != NULL);
+
+  /* one branch-free test per quadrant keeps the loop vectorizable */
+  for (zz = 0; zz < count; ++zz) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    h = P4EST_QUADRANT_LEN (q->level);
+    m = (lower[0] <= q->x) & (q->x + h <= upper[0]);
+    m &= (lower[1] <= q->y) & (q->y + h <= upper[1]);
+#ifdef P4_TO_P8
+    m &= (lower[2] <= q->z) & (q->z + h <= upper[2]);
+#endif
+    results[zz] = (int8_t) m;
+  }
+}
+
+void
+p4est_quadrant_array_box_distance2 (sc_array_t * quadrants,
+                                    const p4est_qcoord_t lower[],
+                                    const p4est_qcoord_t upper[],
+                                    int64_t * distance2)
+{
+  const size_t        count = quadrants->elem_count;
+  size_t              zz;
+  int64_t             g, d2;
+  p4est_qcoord_t      h;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+  P4EST_ASSERT (count == 0 || distance2 != NULL);
+
+  /* clamp the per-axis gap to zero; all quantities stay exact in 64 bit */
+  for (zz = 0; zz < count; ++zz) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    h = P4EST_QUADRANT_LEN (q->level);
+    g = SC_MAX (lower[0] - (q->x + h), q->x - upper[0]);
+    g = SC_MAX (g, 0);
+    d2 = g * g;
+    g = SC_MAX (lower[1] - (q->y + h), q->y - upper[1]);
+    g = SC_MAX (g, 0);
+    d2 += g * g;
+#ifdef P4_TO_P8
+    g = SC_MAX (lower[2] - (q->z + h), q->z - upper[2]);
+    g = SC_MAX (g, 0);
+    d2 += g * g;
+#endif
+    distance2[zz] = d2;
+  }
+}
+
+/** Append a range to a set, merging with the last one when possible.
+ * The caller feeds ranges in ascending order of their first index.
+ */
+static void
+p4est_morton_range_push (sc_array_t * ranges, uint64_t first, uint64_t last)
+{
+  p4est_morton_range_t *r;
+
+  P4EST_ASSERT (first <= last);
+
+  if (ranges->elem_count > 0) {
+    r = (p4est_morton_range_t *)
+      sc_array_index (ranges, ranges->elem_count - 1);
+    P4EST_ASSERT (r->first <= first);
+    if (first <= r->last + 1) {
+      /* the new range touches or overlaps the previous one */
+      if (last > r->last) {
+        r->last = last;
+      }
+      return;
+    }
+  }
+  r = (p4est_morton_range_t *) sc_array_push (ranges);
+  r->first = first;
+  r->last = last;
+}
+
+#ifdef P4EST_ENABLE_DEBUG
+
+/** Check that a range set is sorted, disjoint, and maximally merged. */
+static int
+p4est_morton_range_array_is_valid (sc_array_t * ranges)
+{
+  size_t              zz;
+  p4est_morton_range_t *r, *p;
+
+  if (ranges->elem_size != sizeof (p4est_morton_range_t)) {
+    return 0;
+  }
+  p = NULL;
+  for (zz = 0; zz < ranges->elem_count; ++zz) {
+    r = (p4est_morton_range_t *) sc_array_index (ranges, zz);
+    if (r->first > r->last) {
+      return 0;
+    }
+    if (p != NULL && p->last + 1 >= r->first) {
+      return 0;
+    }
+    p = r;
+  }
+  return 1;
+}
+
+#endif /* P4EST_ENABLE_DEBUG */
+
+void
+p4est_morton_range_from_quadrants (sc_array_t * quadrants,
+                                   sc_array_t * ranges)
+{
+  size_t              zz;
+  uint64_t            first, count;
+  p4est_quadrant_t    fd;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+  P4EST_ASSERT (ranges->elem_size == sizeof (p4est_morton_range_t));
+  P4EST_ASSERT (ranges->elem_count == 0);
+
+  for (zz = 0; zz < quadrants->elem_count; ++zz) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    P4EST_ASSERT (p4est_quadrant_is_extended (q));
+    p4est_quadrant_first_descendant (q, &fd, P4EST_QMAXLEVEL);
+    first = p4est_quadrant_linear_id (&fd, P4EST_QMAXLEVEL);
+    count = (uint64_t) 1 <<
+      (P4EST_DIM * (P4EST_QMAXLEVEL - (int) q->level));
+    p4est_morton_range_push (ranges, first, first + count - 1);
+  }
+  P4EST_ASSERT (p4est_morton_range_array_is_valid (ranges));
+}
+
+void
+p4est_morton_range_to_quadrants (sc_array_t * ranges, sc_array_t * quadrants)
+{
+  int                 level;
+  size_t              zz;
+  uint64_t            cur, count;
+  p4est_morton_range_t *r;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (p4est_morton_range_array_is_valid (ranges));
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+
+  for (zz = 0; zz < ranges->elem_count; ++zz) {
+    r = (p4est_morton_range_t *) sc_array_index (ranges, zz);
+    cur = r->first;
+    while (cur <= r->last) {
+      /* grow the largest quadrant aligned at cur inside the range */
+      level = P4EST_QMAXLEVEL;
+      count = 1;
+      while (level > 0 && cur % (count << P4EST_DIM) == 0 &&
+             cur + (count << P4EST_DIM) - 1 <= r->last) {
+        count <<= P4EST_DIM;
+        --level;
+      }
+      q = (p4est_quadrant_t *) sc_array_push (quadrants);
+      P4EST_QUADRANT_INIT (q);
+      p4est_quadrant_set_morton
+        (q, level, cur >> (P4EST_DIM * (P4EST_QMAXLEVEL - level)));
+      P4EST_ASSERT (p4est_quadrant_is_valid (q));
+      cur += count;
+    }
+  }
+}
+
+void
+p4est_morton_range_union (sc_array_t * a, sc_array_t * b, sc_array_t * out)
+{
+  size_t              ia, ib;
+  p4est_morton_range_t *ra, *rb;
+
+  P4EST_ASSERT (p4est_morton_range_array_is_valid (a));
+  P4EST_ASSERT (p4est_morton_range_array_is_valid (b));
+  P4EST_ASSERT (out->elem_size == sizeof (p4est_morton_range_t));
+  P4EST_ASSERT (out->elem_count == 0);
+
+  ia = ib = 0;
+  while (ia < a->elem_count && ib < b->elem_count) {
+    ra = (p4est_morton_range_t *) sc_array_index (a, ia);
+    rb = (p4est_morton_range_t *) sc_array_index (b, ib);
+    if (ra->first <= rb->first) {
+      p4est_morton_range_push (out, ra->first, ra->last);
+      ++ia;
+    }
+    else {
+      p4est_morton_range_push (out, rb->first, rb->last);
+      ++ib;
+    }
+  }
+  for (; ia < a->elem_count; ++ia) {
+    ra = (p4est_morton_range_t *) sc_array_index (a, ia);
+    p4est_morton_range_push (out, ra->first, ra->last);
+  }
+  for (; ib < b->elem_count; ++ib) {
+    rb = (p4est_morton_range_t *) sc_array_index (b, ib);
+    p4est_morton_range_push (out, rb->first, rb->last);
+  }
+  P4EST_ASSERT (p4est_morton_range_array_is_valid (out));
+}
+
+void
+p4est_morton_range_intersection (sc_array_t * a, sc_array_t * b,
+                                 sc_array_t * out)
+{
+  size_t              ia, ib;
+  uint64_t            lo, hi;
+  p4est_morton_range_t *ra, *rb;
+
+  P4EST_ASSERT (p4est_morton_range_array_is_valid (a));
+  P4EST_ASSERT (p4est_morton_range_array_is_valid (b));
+  P4EST_ASSERT (out->elem_size == sizeof (p4est_morton_range_t));
+  P4EST_ASSERT (out->elem_count == 0);
+
+  ia = ib = 0;
+  while (ia < a->elem_count && ib < b->elem_count) {
+    ra = (p4est_morton_range_t *) sc_array_index (a, ia);
+    rb = (p4est_morton_range_t *) sc_array_index (b, ib);
+    lo = SC_MAX (ra->first, rb->first);
+    hi = SC_MIN (ra->last, rb->last);
+    if (lo <= hi) {
+      p4est_morton_range_push (out, lo, hi);
+    }
+    if (ra->last < rb->last) {
+      ++ia;
+    }
+    else {
+      ++ib;
+    }
+  }
+  P4EST_ASSERT (p4est_morton_range_array_is_valid (out));
+}
+
+void
+p4est_morton_range_difference (sc_array_t * a, sc_array_t * b,
+                               sc_array_t * out)
+{
+  size_t              ia, ib;
+  uint64_t            cur;
+  p4est_morton_range_t *ra, *rb;
+
+  P4EST_ASSERT (p4est_morton_range_array_is_valid (a));
+  P4EST_ASSERT (p4est_morton_range_array_is_valid (b));
+  P4EST_ASSERT (out->elem_size == sizeof (p4est_morton_range_t));
+  P4EST_ASSERT (out->elem_count == 0);
+
+  ib = 0;
+  for (ia = 0; ia < a->elem_count; ++ia) {
+    ra = (p4est_morton_range_t *) sc_array_index (a, ia);
+    cur = ra->first;
+    while (ib < b->elem_count) {
+      rb = (p4est_morton_range_t *) sc_array_index (b, ib);
+      if (rb->last < cur) {
+        /* this subtrahend lies entirely before the cursor */
+        ++ib;
+        continue;
+      }
+      if (rb->first > ra->last) {
+        /* this subtrahend lies beyond the current range */
+        break;
+      }
+      if (rb->first > cur) {
+        p4est_morton_range_push (out, cur, rb->first - 1);
+      }
+      if (rb->last >= ra->last) {
+        /* the subtrahend may still overlap the next range of a */
+        cur = ra->last + 1;
+        break;
+      }
+      cur = rb->last + 1;
+      ++ib;
+    }
+    if (cur <= ra->last) {
+      p4est_morton_range_push (out, cur, ra->last);
+    }
+  }
+  P4EST_ASSERT (p4est_morton_range_array_is_valid (out));
+}
@@ -62,6 +62,9 @@
 #define P4EST_CONNECT_FACE              P8EST_CONNECT_FACE
 #define P4EST_CONNECT_CORNER            P8EST_CONNECT_CORNER
 #define P4EST_CONNECT_FULL              P8EST_CONNECT_FULL
+#define P4EST_GHOST_BUILD_GHOSTS        P8EST_GHOST_BUILD_GHOSTS
+#define P4EST_GHOST_BUILD_MIRRORS       P8EST_GHOST_BUILD_MIRRORS
+#define P4EST_GHOST_BUILD_FULL          P8EST_GHOST_BUILD_FULL
 #define P4EST_CONN_ENCODE_NONE          P8EST_CONN_ENCODE_NONE
 #define P4EST_WRAP_NONE                 P8EST_WRAP_NONE
 #define P4EST_WRAP_REFINE               P8EST_WRAP_REFINE
@@ -76,6 +79,8 @@
 #define p4est_connectivity_t            p8est_connectivity_t
 #define p4est_corner_transform_t        p8est_corner_transform_t
 #define p4est_corner_info_t             p8est_corner_info_t
+#define p4est_corner_resolver           p8est_corner_resolver
+#define p4est_corner_resolver_t         p8est_corner_resolver_t
 #define p4est_geometry_t                p8est_geometry_t
 #define p4est_t                         p8est_t
 #define p4est_tree_t                    p8est_tree_t
@@ -85,27 +90,68 @@
 #define p4est_init_t                    p8est_init_t
 #define p4est_refine_t                  p8est_refine_t
 #define p4est_coarsen_t                 p8est_coarsen_t
+#define p4est_coarsen_batch_t           p8est_coarsen_batch_t
 #define p4est_weight_t                  p8est_weight_t
+#define p4est_weight_batch_t            p8est_weight_batch_t
+#define p4est_weight_vector_t           p8est_weight_vector_t
+#define p4est_partition_norm_t          p8est_partition_norm_t
+#define P4EST_PARTITION_NORM_L1         P8EST_PARTITION_NORM_L1
+#define P4EST_PARTITION_NORM_MAX        P8EST_PARTITION_NORM_MAX
+#define p4est_workspace                 p8est_workspace
+#define p4est_workspace_t               p8est_workspace_t
+#define p4est_journal_entry             p8est_journal_entry
+#define p4est_journal_entry_t           p8est_journal_entry_t
+#define p4est_migrate_range             p8est_migrate_range
+#define p4est_migrate_range_t           p8est_migrate_range_t
+#define p4est_migrate_fn_t              p8est_migrate_fn_t
 #define p4est_ghost_t                   p8est_ghost_t
+#define p4est_ghost_new_context         p8est_ghost_new_context
+#define p4est_ghost_new_t               p8est_ghost_new_t
 #define p4est_ghost_exchange_t          p8est_ghost_exchange_t
+#define p4est_ghost_exchange_group      p8est_ghost_exchange_group
+#define p4est_ghost_exchange_group_t    p8est_ghost_exchange_group_t
+#define p4est_ghost_exchange_group_member p8est_ghost_exchange_group_member
+#define p4est_ghost_exchange_group_member_t \
+        p8est_ghost_exchange_group_member_t
+#define p4est_ghost_exchange_plan       p8est_ghost_exchange_plan
+#define p4est_ghost_exchange_plan_t     p8est_ghost_exchange_plan_t
+#define p4est_ghost_pack_plan           p8est_ghost_pack_plan
+#define p4est_ghost_pack_plan_t         p8est_ghost_pack_plan_t
+#define p4est_ghost_combine_t           p8est_ghost_combine_t
+#define p4est_ghost_shared              p8est_ghost_shared
+#define p4est_ghost_shared_t            p8est_ghost_shared_t
+#define p4est_ghost_index               p8est_ghost_index
+#define p4est_ghost_index_t             p8est_ghost_index_t
 #define p4est_indep_t                   p8est_indep_t
 #define p4est_nodes_t                   p8est_nodes_t
 #define p4est_lnodes_t                  p8est_lnodes_t
 #define p4est_lnodes_code_t             p8est_lnodes_code_t
 #define p4est_lnodes_rank_t             p8est_lnodes_rank_t
 #define p4est_lnodes_buffer_t           p8est_lnodes_buffer_t
+#define p4est_lnodes_degree_t           p8est_lnodes_degree_t
+#define p4est_lnodes_mixed              p8est_lnodes_mixed
+#define p4est_lnodes_mixed_t            p8est_lnodes_mixed_t
+#define p4est_lnodes_blocks             p8est_lnodes_blocks
+#define p4est_lnodes_blocks_t           p8est_lnodes_blocks_t
 #define p4est_iter_volume_t             p8est_iter_volume_t
 #define p4est_iter_volume_info_t        p8est_iter_volume_info_t
 #define p4est_iter_face_t               p8est_iter_face_t
 #define p4est_iter_face_info_t          p8est_iter_face_info_t
 #define p4est_iter_face_side_t          p8est_iter_face_side_t
+#define p4est_iterate_plan_t            p8est_iterate_plan_t
 #define p4est_iter_corner_t             p8est_iter_corner_t
 #define p4est_iter_corner_side_t        p8est_iter_corner_side_t
 #define p4est_iter_corner_info_t        p8est_iter_corner_info_t
+#define p4est_iter_phase_t              p8est_iter_phase_t
 #define p4est_search_query_t            p8est_search_query_t
+#define p4est_index_range_t             p8est_index_range_t
+#define p4est_morton_range              p8est_morton_range
+#define p4est_morton_range_t            p8est_morton_range_t
 #define p4est_traverse_query_t          p8est_traverse_query_t
 #define p4est_mesh_t                    p8est_mesh_t
 #define p4est_mesh_face_neighbor_t      p8est_mesh_face_neighbor_t
+#define p4est_ensemble_t                p8est_ensemble_t
+#define p4est_flags_t                   p8est_flags_t
 #define p4est_wrap_t                    p8est_wrap_t
 #define p4est_wrap_leaf_t               p8est_wrap_leaf_t
 #define p4est_wrap_flags_t              p8est_wrap_flags_t
@@ -131,6 +177,25 @@
 #define p4est_connectivity_new_byname   p8est_connectivity_new_byname
 #define p4est_connectivity_new_copy     p8est_connectivity_new_copy
 #define p4est_connectivity_bcast        p8est_connectivity_bcast
+#define p4est_connectivity_shared_context p8est_connectivity_shared_context
+#define p4est_connectivity_shared_context_t p8est_connectivity_shared_context_t
+#define p4est_connectivity_share_offset p8est_connectivity_share_offset
+#define p4est_connectivity_share        p8est_connectivity_share
+#define p4est_connectivity_unshare      p8est_connectivity_unshare
+#define p4est_connectivity_row          p8est_connectivity_row
+#define p4est_connectivity_row_t        p8est_connectivity_row_t
+#define p4est_connectivity_dist         p8est_connectivity_dist
+#define p4est_connectivity_dist_t       p8est_connectivity_dist_t
+#define p4est_connectivity_dist_context p8est_connectivity_dist_context
+#define p4est_connectivity_dist_context_t p8est_connectivity_dist_context_t
+#define p4est_connectivity_dist_begin   p8est_connectivity_dist_begin
+#define p4est_connectivity_dist_owner   p8est_connectivity_dist_owner
+#define p4est_connectivity_dist_fill    p8est_connectivity_dist_fill
+#define p4est_connectivity_dist_position p8est_connectivity_dist_position
+#define p4est_connectivity_dist_cache   p8est_connectivity_dist_cache
+#define p4est_connectivity_distribute   p8est_connectivity_distribute
+#define p4est_connectivity_dist_row     p8est_connectivity_dist_row
+#define p4est_connectivity_dist_destroy p8est_connectivity_dist_destroy
 #define p4est_connectivity_destroy      p8est_connectivity_destroy
 #define p4est_connectivity_set_attr     p8est_connectivity_set_attr
 #define p4est_connectivity_is_valid     p8est_connectivity_is_valid
@@ -141,8 +206,14 @@
 #define p4est_connectivity_source       p8est_connectivity_source
 #define p4est_connectivity_inflate      p8est_connectivity_inflate
 #define p4est_connectivity_load         p8est_connectivity_load
+#define p4est_connectivity_mmap_context p8est_connectivity_mmap_context
+#define p4est_connectivity_mmap_context_t p8est_connectivity_mmap_context_t
+#define p4est_connectivity_mmap_array   p8est_connectivity_mmap_array
+#define p4est_connectivity_mmap         p8est_connectivity_mmap
+#define p4est_connectivity_munmap       p8est_connectivity_munmap
 #define p4est_connectivity_complete     p8est_connectivity_complete
 #define p4est_connectivity_reduce       p8est_connectivity_reduce
+#define p4est_connectivity_require_corners p8est_connectivity_require_corners
 #define p4est_expand_face_transform     p8est_expand_face_transform
 #define p4est_find_face_transform       p8est_find_face_transform
 #define p4est_find_corner_transform     p8est_find_corner_transform
@@ -158,17 +229,32 @@
 #define p4est_qcoord_to_vertex          p8est_qcoord_to_vertex
 #define p4est_memory_used               p8est_memory_used
 #define p4est_revision                  p8est_revision
+#define p4est_level_statistics_t        p8est_level_statistics_t
+#define p4est_statistics_levels         p8est_statistics_levels
 #define p4est_new                       p8est_new
 #define p4est_destroy                   p8est_destroy
 #define p4est_copy                      p8est_copy
 #define p4est_reset_data                p8est_reset_data
+#define p4est_repack_data               p8est_repack_data
+#define p4est_memory_compact            p8est_memory_compact
+#define p4est_numa_first_touch          p8est_numa_first_touch
+#define p4est_advise_hugepages          p8est_advise_hugepages
+#define p4est_reserve_quadrants         p8est_reserve_quadrants
 #define p4est_refine                    p8est_refine
 #define p4est_coarsen                   p8est_coarsen
 #define p4est_balance                   p8est_balance
 #define p4est_partition                 p8est_partition
 #define p4est_checksum                  p8est_checksum
+#define p4est_checksum_ext              p8est_checksum_ext
 #define p4est_save                      p8est_save
+#define p4est_save_compressed           p8est_save_compressed
+#define p4est_checkpoint                p8est_checkpoint
+#define p4est_checkpoint_t              p8est_checkpoint_t
+#define p4est_checkpoint_begin          p8est_checkpoint_begin
+#define p4est_checkpoint_end            p8est_checkpoint_end
 #define p4est_load                      p8est_load
+#define p4est_load_compressed           p8est_load_compressed
+#define p4est_load_parallel             p8est_load_parallel
 #define p4est_connect_type_int          p8est_connect_type_int
 #define p4est_connect_type_string       p8est_connect_type_string
 #define p4est_tree_array_index          p8est_tree_array_index
@@ -180,21 +266,64 @@
 /* functions in p4est_extended */
 #define p4est_replace_t                 p8est_replace_t
 #define p4est_new_ext                   p8est_new_ext
+#define p4est_new_replicated            p8est_new_replicated
+#define p4est_level_map_t               p8est_level_map_t
+#define p4est_new_from_level_map        p8est_new_from_level_map
 #define p4est_mesh_new_ext              p8est_mesh_new_ext
+#define p4est_mesh_new_level_ext        p8est_mesh_new_level_ext
+#define p4est_mesh_reuse_ext            p8est_mesh_reuse_ext
 #define p4est_copy_ext                  p8est_copy_ext
+#define p4est_view                      p8est_view
+#define p4est_view_t                    p8est_view_t
+#define p4est_view_new                  p8est_view_new
+#define p4est_view_protect_tree         p8est_view_protect_tree
+#define p4est_view_protect              p8est_view_protect
+#define p4est_view_tree                 p8est_view_tree
+#define p4est_view_destroy              p8est_view_destroy
 #define p4est_refine_ext                p8est_refine_ext
+#define p4est_refine_range              p8est_refine_range
+#define p4est_refine_range_t            p8est_refine_range_t
+#define p4est_refine_ranges             p8est_refine_ranges
 #define p4est_coarsen_ext               p8est_coarsen_ext
+#define p4est_coarsen_batch             p8est_coarsen_batch
+#define p4est_coarsen_uniform           p8est_coarsen_uniform
+#define p4est_inspect_report            p8est_inspect_report
+#define p4est_journal_log               p8est_journal_log
+#define p4est_workspace_new             p8est_workspace_new
+#define p4est_workspace_destroy         p8est_workspace_destroy
 #define p4est_balance_ext               p8est_balance_ext
 #define p4est_balance_subtree_ext       p8est_balance_subtree_ext
+#define p4est_balance_incremental       p8est_balance_incremental
+#define p4est_balance_levels            p8est_balance_levels
 #define p4est_partition_ext             p8est_partition_ext
+#define p4est_partition_batch           p8est_partition_batch
+#define p4est_partition_vector          p8est_partition_vector
+#define p4est_partition_lazy            p8est_partition_lazy
+#define p4est_partition_context         p8est_partition_context
+#define p4est_partition_context_t       p8est_partition_context_t
+#define p4est_partition_begin           p8est_partition_begin
+#define p4est_partition_end             p8est_partition_end
 #define p4est_partition_for_coarsening  p8est_partition_for_coarsening
 #define p4est_save_ext                  p8est_save_ext
 #define p4est_load_ext                  p8est_load_ext
 #define p4est_source_ext                p8est_source_ext
+#define p4est_load_fast                 p8est_load_fast
+#define p4est_save_buffer               p8est_save_buffer
+#define p4est_load_buffer               p8est_load_buffer
+#define p4est_save_delta_buffer         p8est_save_delta_buffer
+#define p4est_apply_delta_buffer        p8est_apply_delta_buffer
 
 /* functions in p4est_iterate */
 #define p4est_iterate                   p8est_iterate
+#define p4est_iterate_threaded          p8est_iterate_threaded
+#define p4est_iterate_level             p8est_iterate_level
+#define p4est_iterate_fused             p8est_iterate_fused
 #define p4est_iterate_ext               p8est_iterate_ext
+#define p4est_iterate_plan_new          p8est_iterate_plan_new
+#define p4est_iterate_plan_execute      p8est_iterate_plan_execute
+#define p4est_iterate_plan_execute_ext  p8est_iterate_plan_execute_ext
+#define p4est_iterate_plan_destroy      p8est_iterate_plan_destroy
+#define p4est_iterate_export            p8est_iterate_export
 #define p4est_iter_fside_array_index    p8est_iter_fside_array_index
 #define p4est_iter_fside_array_index_int p8est_iter_fside_array_index_int
 #define p4est_iter_cside_array_index    p8est_iter_cside_array_index
@@ -209,6 +338,7 @@
 #define p4est_quadrant_overlaps         p8est_quadrant_overlaps
 #define p4est_quadrant_is_equal_piggy   p8est_quadrant_is_equal_piggy
 #define p4est_quadrant_compare          p8est_quadrant_compare
+#define p4est_quadrant_compare_inline   p8est_quadrant_compare_inline
 #define p4est_quadrant_disjoint         p8est_quadrant_disjoint
 #define p4est_quadrant_compare_piggy    p8est_quadrant_compare_piggy
 #define p4est_quadrant_compare_local_num p8est_quadrant_compare_local_num
@@ -222,6 +352,7 @@
 #define p4est_quadrant_contains_node    p8est_quadrant_contains_node
 #define p4est_quadrant_ancestor_id      p8est_quadrant_ancestor_id
 #define p4est_quadrant_child_id         p8est_quadrant_child_id
+#define p4est_quadrant_child_id_inline  p8est_quadrant_child_id_inline
 #define p4est_quadrant_is_inside_root   p8est_quadrant_is_inside_root
 #define p4est_quadrant_is_inside_3x3    p8est_quadrant_is_inside_3x3
 #define p4est_quadrant_is_outside_face  p8est_quadrant_is_outside_face
@@ -234,6 +365,7 @@
 #define p4est_quadrant_is_family        p8est_quadrant_is_family
 #define p4est_quadrant_is_familyv       p8est_quadrant_is_familyv
 #define p4est_quadrant_is_familypv      p8est_quadrant_is_familypv
+#define p4est_quadrant_family_scan      p8est_quadrant_family_scan
 #define p4est_quadrant_is_parent        p8est_quadrant_is_parent
 #define p4est_quadrant_is_parent_D      p8est_quadrant_is_parent_D
 #define p4est_quadrant_is_ancestor      p8est_quadrant_is_ancestor
@@ -244,6 +376,7 @@
 #define p4est_quadrant_is_inside_tree   p8est_quadrant_is_inside_tree
 #define p4est_quadrant_ancestor         p8est_quadrant_ancestor
 #define p4est_quadrant_parent           p8est_quadrant_parent
+#define p4est_quadrant_parent_inline    p8est_quadrant_parent_inline
 #define p4est_quadrant_sibling          p8est_quadrant_sibling
 #define p4est_quadrant_child            p8est_quadrant_child
 #define p4est_quadrant_face_neighbor    p8est_quadrant_face_neighbor
@@ -253,6 +386,10 @@
 #define p4est_quadrant_corner_neighbor  p8est_quadrant_corner_neighbor
 #define p4est_quadrant_corner_neighbor_extra    \
         p8est_quadrant_corner_neighbor_extra
+#define p4est_corner_resolver_new       p8est_corner_resolver_new
+#define p4est_quadrant_corner_neighbor_resolve  \
+        p8est_quadrant_corner_neighbor_resolve
+#define p4est_corner_resolver_destroy   p8est_corner_resolver_destroy
 #define p4est_quadrant_half_corner_neighbor     \
         p8est_quadrant_half_corner_neighbor
 #define p4est_quadrant_corner_node      p8est_quadrant_corner_node
@@ -269,39 +406,78 @@
 #define p4est_quadrant_transform_corner p8est_quadrant_transform_corner
 #define p4est_quadrant_shift_corner     p8est_quadrant_shift_corner
 #define p4est_quadrant_linear_id        p8est_quadrant_linear_id
+#define p4est_quadrant_linear_id_v      p8est_quadrant_linear_id_v
 #define p4est_quadrant_set_morton       p8est_quadrant_set_morton
+#define p4est_quadrant_array_to_soa     p8est_quadrant_array_to_soa
+#define p4est_quadrant_array_from_soa   p8est_quadrant_array_from_soa
+#define P4EST_COMPACT_MAXLEVEL          P8EST_COMPACT_MAXLEVEL
+#define p4est_quadrant_compact_t        p8est_quadrant_compact_t
+#define p4est_quadrant_compact_pack     p8est_quadrant_compact_pack
+#define p4est_quadrant_compact_unpack   p8est_quadrant_compact_unpack
+#define p4est_quadrant_array_to_compact p8est_quadrant_array_to_compact
+#define p4est_quadrant_array_from_compact \
+        p8est_quadrant_array_from_compact
 
 /* functions in p4est_search */
+#define p4est_search_bound_tune         p8est_search_bound_tune
 #define p4est_find_lower_bound          p8est_find_lower_bound
 #define p4est_find_higher_bound         p8est_find_higher_bound
 #define p4est_split_array               p8est_split_array
 #define p4est_find_range_boundaries     p8est_find_range_boundaries
 #define p4est_search                    p8est_search
+#define p4est_search_cursor_t           p8est_search_cursor_t
+#define p4est_search_cursor             p8est_search_cursor
+#define p4est_search_cursor_new         p8est_search_cursor_new
+#define p4est_search_next               p8est_search_next
+#define p4est_search_cursor_destroy     p8est_search_cursor_destroy
+#define p4est_search_points_sorted      p8est_search_points_sorted
+#define p4est_search_region             p8est_search_region
+#define p4est_quadrant_array_box_overlap p8est_quadrant_array_box_overlap
+#define p4est_quadrant_array_box_contained \
+        p8est_quadrant_array_box_contained
+#define p4est_quadrant_array_box_distance2 \
+        p8est_quadrant_array_box_distance2
+#define p4est_morton_range_from_quadrants p8est_morton_range_from_quadrants
+#define p4est_morton_range_to_quadrants p8est_morton_range_to_quadrants
+#define p4est_morton_range_union        p8est_morton_range_union
+#define p4est_morton_range_intersection p8est_morton_range_intersection
+#define p4est_morton_range_difference   p8est_morton_range_difference
 #define p4est_traverse                  p8est_traverse
 
 /* functions in p4est_algorithms */
 #define p4est_quadrant_init_data        p8est_quadrant_init_data
 #define p4est_quadrant_free_data        p8est_quadrant_free_data
 #define p4est_quadrant_checksum         p8est_quadrant_checksum
+#define p4est_quadrant_array_advise_huge p8est_quadrant_array_advise_huge
 #define p4est_tree_is_sorted            p8est_tree_is_sorted
 #define p4est_tree_is_linear            p8est_tree_is_linear
 #define p4est_tree_is_almost_sorted     p8est_tree_is_almost_sorted
 #define p4est_tree_is_complete          p8est_tree_is_complete
 #define p4est_tree_print                p8est_tree_print
 #define p4est_is_equal                  p8est_is_equal
+#define p4est_tree_checksums            p8est_tree_checksums
+#define p4est_tree_checksums_t          p8est_tree_checksums_t
+#define p4est_tree_checksums_new        p8est_tree_checksums_new
+#define p4est_tree_checksums_update     p8est_tree_checksums_update
+#define p4est_tree_checksums_destroy    p8est_tree_checksums_destroy
+#define p4est_divergence                p8est_divergence
 #define p4est_is_valid                  p8est_is_valid
 #define p4est_tree_compute_overlap      p8est_tree_compute_overlap
+#define p4est_quadrant_array_sort       p8est_quadrant_array_sort
 #define p4est_tree_uniqify_overlap      p8est_tree_uniqify_overlap
 #define p4est_tree_remove_nonowned      p8est_tree_remove_nonowned
 #define p4est_complete_region           p8est_complete_region
 #define p4est_complete_subtree          p8est_complete_subtree
 #define p4est_balance_subtree           p8est_balance_subtree
+#define p4est_balance_subtrees          p8est_balance_subtrees
 #define p4est_balance_border            p8est_balance_border
 #define p4est_linearize_tree            p8est_linearize_tree
 #define p4est_next_nonempty_process     p8est_next_nonempty_process
 #define p4est_partition_correction      p8est_partition_correction
 #define p4est_partition_for_coarsening  p8est_partition_for_coarsening
 #define p4est_partition_given           p8est_partition_given
+#define p4est_partition_given_begin     p8est_partition_given_begin
+#define p4est_partition_given_end       p8est_partition_given_end
 
 /* functions in p4est_communication */
 #define p4est_comm_parallel_env_assign  p8est_comm_parallel_env_assign
@@ -312,6 +488,10 @@
 #define p4est_comm_parallel_env_is_null p8est_comm_parallel_env_is_null
 #define p4est_comm_parallel_env_reduce  p8est_comm_parallel_env_reduce
 #define p4est_comm_parallel_env_reduce_ext p8est_comm_parallel_env_reduce_ext
+#define p4est_comm_active               p8est_comm_active
+#define p4est_comm_active_t             p8est_comm_active_t
+#define p4est_comm_parallel_env_shrink  p8est_comm_parallel_env_shrink
+#define p4est_comm_parallel_env_expand  p8est_comm_parallel_env_expand
 #define p4est_comm_count_quadrants      p8est_comm_count_quadrants
 #define p4est_comm_global_partition     p8est_comm_global_partition
 #define p4est_comm_count_pertree        p8est_comm_count_pertree
@@ -319,6 +499,35 @@
 #define p4est_comm_is_contained         p8est_comm_is_contained
 #define p4est_comm_is_owner             p8est_comm_is_owner
 #define p4est_comm_find_owner           p8est_comm_find_owner
+#define p4est_comm_find_owner_bounded   p8est_comm_find_owner_bounded
+#define p4est_comm_find_owner_interpolate p8est_comm_find_owner_interpolate
+#define p4est_comm_find_owner_batch     p8est_comm_find_owner_batch
+#define p4est_comm_partition_dir        p8est_comm_partition_dir
+#define p4est_comm_partition_dir_t      p8est_comm_partition_dir_t
+#define p4est_comm_partition_dir_new    p8est_comm_partition_dir_new
+#define p4est_comm_partition_dir_destroy p8est_comm_partition_dir_destroy
+#define p4est_comm_partition_dir_find_owner p8est_comm_partition_dir_find_owner
+#define p4est_data_vector               p8est_data_vector
+#define p4est_data_vector_t             p8est_data_vector_t
+#define p4est_data_vector_new           p8est_data_vector_new
+#define p4est_data_vector_index         p8est_data_vector_index
+#define p4est_data_vector_link          p8est_data_vector_link
+#define p4est_data_vector_partition     p8est_data_vector_partition
+#define p4est_data_vector_destroy       p8est_data_vector_destroy
+#define p4est_remote                    p8est_remote
+#define p4est_remote_t                  p8est_remote_t
+#define p4est_remote_pack               p8est_remote_pack
+#define p4est_remote_open               p8est_remote_open
+#define p4est_remote_get                p8est_remote_get
+#define p4est_remote_close              p8est_remote_close
+#define p4est_transfer_context          p8est_transfer_context
+#define p4est_transfer_context_t        p8est_transfer_context_t
+#define p4est_transfer_fixed            p8est_transfer_fixed
+#define p4est_transfer_fixed_begin      p8est_transfer_fixed_begin
+#define p4est_transfer_fixed_end        p8est_transfer_fixed_end
+#define p4est_transfer_custom           p8est_transfer_custom
+#define p4est_transfer_custom_begin     p8est_transfer_custom_begin
+#define p4est_transfer_custom_end       p8est_transfer_custom_end
 #define p4est_comm_tree_info            p8est_comm_tree_info
 #define p4est_comm_neighborhood_owned   p8est_comm_neighborhood_owned
 #define p4est_comm_sync_flag            p8est_comm_sync_flag
@@ -326,10 +535,26 @@
 
 /* functions in p4est_io */
 #define p4est_deflate_quadrants         p8est_deflate_quadrants
+#define p4est_deflate_quadrants_compressed p8est_deflate_quadrants_compressed
 #define p4est_inflate                   p8est_inflate
+#define p4est_inflate_compressed        p8est_inflate_compressed
+#define p4est_inflate_trusted           p8est_inflate_trusted
+#define p4est_data_codec                p8est_data_codec
+#define p4est_data_codec_t              p8est_data_codec_t
+#define p4est_save_data_encoded         p8est_save_data_encoded
+#define p4est_load_data_encoded         p8est_load_data_encoded
+#define p4est_tree_pager                p8est_tree_pager
+#define p4est_tree_pager_t              p8est_tree_pager_t
+#define p4est_tree_pager_new            p8est_tree_pager_new
+#define p4est_tree_evict                p8est_tree_evict
+#define p4est_tree_fetch                p8est_tree_fetch
+#define p4est_tree_pager_destroy        p8est_tree_pager_destroy
+#define p4est_gather_to_team            p8est_gather_to_team
+#define p4est_scatter_from_team         p8est_scatter_from_team
 
 /* functions in p4est_geometry */
 #define p4est_geometry_destroy          p8est_geometry_destroy
+#define p4est_geometry_X_v              p8est_geometry_X_v
 #define p4est_geometry_new_connectivity p8est_geometry_new_connectivity
 
 /* functions in p4est_vtk */
@@ -338,6 +563,12 @@
 #define p4est_vtk_context_set_geom      p8est_vtk_context_set_geom
 #define p4est_vtk_context_set_scale     p8est_vtk_context_set_scale
 #define p4est_vtk_context_set_continuous p8est_vtk_context_set_continuous
+#define p4est_vtk_context_set_appended  p8est_vtk_context_set_appended
+#define p4est_vtk_context_set_collective p8est_vtk_context_set_collective
+#define p4est_vtk_context_set_streaming p8est_vtk_context_set_streaming
+#define p4est_vtk_select_t              p8est_vtk_select_t
+#define p4est_vtk_context_set_select    p8est_vtk_context_set_select
+#define p4est_vtk_context_set_ranges    p8est_vtk_context_set_ranges
 #define p4est_vtk_write_file            p8est_vtk_write_file
 #define p4est_vtk_write_header          p8est_vtk_write_header
 #define p4est_vtk_write_cell_dataf      p8est_vtk_write_cell_dataf
@@ -350,6 +581,48 @@
 #define p4est_quadrant_find_owner       p8est_quadrant_find_owner
 #define p4est_ghost_memory_used         p8est_ghost_memory_used
 #define p4est_ghost_new                 p8est_ghost_new
+#define p4est_ghost_connect_fn_t        p8est_ghost_connect_fn_t
+#define p4est_ghost_new_select          p8est_ghost_new_select
+#define p4est_ghost_build               p8est_ghost_build
+#define p4est_ghost_build_t             p8est_ghost_build_t
+#define p4est_ghost_new_build           p8est_ghost_new_build
+#define p4est_ghost_update              p8est_ghost_update
+#define p4est_ghost_new_begin           p8est_ghost_new_begin
+#define p4est_ghost_new_width           p8est_ghost_new_width
+#define p4est_ghost_new_end             p8est_ghost_new_end
+#define p4est_ghost_new_hierarchy       p8est_ghost_new_hierarchy
+#define p4est_ghost_exchange_indexed    p8est_ghost_exchange_indexed
+#define p4est_ghost_exchange_reduce     p8est_ghost_exchange_reduce
+#define p4est_ghost_exchange_plan_new   p8est_ghost_exchange_plan_new
+#define p4est_ghost_exchange_plan_symmetric_new \
+        p8est_ghost_exchange_plan_symmetric_new
+#define p4est_ghost_exchange_plan_partitioned_new \
+        p8est_ghost_exchange_plan_partitioned_new
+#define p4est_ghost_exchange_plan_start p8est_ghost_exchange_plan_start
+#define p4est_ghost_exchange_plan_ready p8est_ghost_exchange_plan_ready
+#define p4est_ghost_exchange_plan_complete \
+        p8est_ghost_exchange_plan_complete
+#define p4est_ghost_exchange_plan_go    p8est_ghost_exchange_plan_go
+#define p4est_ghost_exchange_plan_destroy p8est_ghost_exchange_plan_destroy
+#define p4est_ghost_pack_plan_new       p8est_ghost_pack_plan_new
+#define p4est_ghost_pack_plan_destroy   p8est_ghost_pack_plan_destroy
+#define p4est_ghost_exchange_buffers    p8est_ghost_exchange_buffers
+#define p4est_ghost_exchange_buffers_begin p8est_ghost_exchange_buffers_begin
+#define p4est_ghost_exchange_buffers_end p8est_ghost_exchange_buffers_end
+#define p4est_ghost_exchange_group_new  p8est_ghost_exchange_group_new
+#define p4est_ghost_exchange_group_add  p8est_ghost_exchange_group_add
+#define p4est_ghost_exchange_group_begin p8est_ghost_exchange_group_begin
+#define p4est_ghost_exchange_group_end  p8est_ghost_exchange_group_end
+#define p4est_ghost_exchange_group_go   p8est_ghost_exchange_group_go
+#define p4est_ghost_exchange_group_destroy \
+        p8est_ghost_exchange_group_destroy
+#define p4est_ghost_graph_comm_new      p8est_ghost_graph_comm_new
+#define p4est_ghost_graph_comm_destroy  p8est_ghost_graph_comm_destroy
+#define p4est_ghost_exchange_data_graph p8est_ghost_exchange_data_graph
+#define p4est_ghost_exchange_custom_graph p8est_ghost_exchange_custom_graph
+#define p4est_ghost_shared_new          p8est_ghost_shared_new
+#define p4est_ghost_exchange_data_shared p8est_ghost_exchange_data_shared
+#define p4est_ghost_shared_destroy      p8est_ghost_shared_destroy
 #define p4est_ghost_destroy             p8est_ghost_destroy
 #define p4est_ghost_exchange_data       p8est_ghost_exchange_data
 #define p4est_ghost_exchange_data_begin p8est_ghost_exchange_data_begin
@@ -357,6 +630,14 @@
 #define p4est_ghost_exchange_custom     p8est_ghost_exchange_custom
 #define p4est_ghost_exchange_custom_begin p8est_ghost_exchange_custom_begin
 #define p4est_ghost_exchange_custom_end p8est_ghost_exchange_custom_end
+#define p4est_ghost_unpack_t            p8est_ghost_unpack_t
+#define p4est_ghost_exchange_custom_scatter \
+        p8est_ghost_exchange_custom_scatter
+#define p4est_ghost_exchange_custom_scatter_begin \
+        p8est_ghost_exchange_custom_scatter_begin
+#define p4est_ghost_exchange_custom_scatter_end \
+        p8est_ghost_exchange_custom_scatter_end
+#define p4est_ghost_exchange_active     p8est_ghost_exchange_active
 #define p4est_ghost_exchange_custom_levels p8est_ghost_exchange_custom_levels
 #define p4est_ghost_exchange_custom_levels_begin        \
         p8est_ghost_exchange_custom_levels_begin
@@ -367,20 +648,38 @@
 #define p4est_ghost_is_valid            p8est_ghost_is_valid
 #define p4est_face_quadrant_exists      p8est_face_quadrant_exists
 #define p4est_quadrant_exists           p8est_quadrant_exists
+#define p4est_ghost_index_new           p8est_ghost_index_new
+#define p4est_ghost_index_lookup        p8est_ghost_index_lookup
+#define p4est_ghost_index_destroy       p8est_ghost_index_destroy
 #define p4est_is_balanced               p8est_is_balanced
 #define p4est_ghost_checksum            p8est_ghost_checksum
+#define p4est_ghost_advise_hugepages    p8est_ghost_advise_hugepages
 #define p4est_ghost_expand              p8est_ghost_expand
+#define p4est_ghost_expand_ranges       p8est_ghost_expand_ranges
 
 /* functions in p4est_nodes */
 #define p4est_nodes_new                 p8est_nodes_new
+#define p4est_nodes_new_from_lnodes     p8est_nodes_new_from_lnodes
 #define p4est_nodes_destroy             p8est_nodes_destroy
 #define p4est_nodes_is_valid            p8est_nodes_is_valid
 
 /* functions in p4est_lnodes */
 #define p4est_lnodes_new                p8est_lnodes_new
+#define p4est_lnodes_update             p8est_lnodes_update
 #define p4est_lnodes_destroy            p8est_lnodes_destroy
+#define p4est_lnodes_sfc_permutation    p8est_lnodes_sfc_permutation
+#define p4est_lnodes_blocks_new         p8est_lnodes_blocks_new
+#define p4est_lnodes_blocks_destroy     p8est_lnodes_blocks_destroy
+#define p4est_lnodes_new_mixed          p8est_lnodes_new_mixed
+#define p4est_lnodes_mixed_destroy      p8est_lnodes_mixed_destroy
 #define p4est_ghost_support_lnodes      p8est_ghost_support_lnodes
 #define p4est_ghost_expand_by_lnodes    p8est_ghost_expand_by_lnodes
+#define p4est_ghost_expand_lnodes       p8est_ghost_expand_lnodes
+#define p4est_ghost_expand_lnodes_t     p8est_ghost_expand_lnodes_t
+#define p4est_ghost_expand_lnodes_new   p8est_ghost_expand_lnodes_new
+#define p4est_ghost_expand_by_lnodes_begin p8est_ghost_expand_by_lnodes_begin
+#define p4est_ghost_expand_by_lnodes_end p8est_ghost_expand_by_lnodes_end
+#define p4est_ghost_expand_lnodes_destroy p8est_ghost_expand_lnodes_destroy
 #define p4est_partition_lnodes          p8est_partition_lnodes
 #define p4est_partition_lnodes_detailed p8est_partition_lnodes_detailed
 #define p4est_lnodes_decode             p8est_lnodes_decode
@@ -390,6 +689,10 @@
 #define p4est_lnodes_share_all_begin    p8est_lnodes_share_all_begin
 #define p4est_lnodes_share_all_end      p8est_lnodes_share_all_end
 #define p4est_lnodes_share_all          p8est_lnodes_share_all
+#define p4est_lnodes_share_all_fields_begin p8est_lnodes_share_all_fields_begin
+#define p4est_lnodes_share_all_fields   p8est_lnodes_share_all_fields
+#define p4est_lnodes_graph_comm_new     p8est_lnodes_graph_comm_new
+#define p4est_lnodes_share_all_graph    p8est_lnodes_share_all_graph
 #define p4est_lnodes_buffer_destroy     p8est_lnodes_buffer_destroy
 #define p4est_lnodes_rank_array_index   p8est_lnodes_rank_array_index
 #define p4est_lnodes_rank_array_index_int p8est_lnodes_rank_array_index_int
@@ -398,18 +701,51 @@
 /* functions in p4est_mesh */
 #define p4est_mesh_memory_used          p8est_mesh_memory_used
 #define p4est_mesh_new                  p8est_mesh_new
+#define p4est_ghost_mesh_new            p8est_ghost_mesh_new
+#define p4est_mesh_build_corners        p8est_mesh_build_corners
+#define p4est_mesh_compress             p8est_mesh_compress
+#define p4est_memory_report             p8est_memory_report
+#define p4est_memory_report_t           p8est_memory_report_t
+#define P4EST_MESH_FACE_CONFIG_OFFSET   P8EST_MESH_FACE_CONFIG_OFFSET
+#define P4EST_MESH_FACE_CONFIGS         P8EST_MESH_FACE_CONFIGS
+#define p4est_mesh_face_fn_t            p8est_mesh_face_fn_t
+#define p4est_mesh_iterate_faces        p8est_mesh_iterate_faces
+#define p4est_mesh_blocked_order        p8est_mesh_blocked_order
 #define p4est_mesh_destroy              p8est_mesh_destroy
 #define p4est_mesh_quadrant_cumulative  p8est_mesh_quadrant_cumulative
 #define p4est_mesh_face_neighbor_init   p8est_mesh_face_neighbor_init
 #define p4est_mesh_face_neighbor_init2  p8est_mesh_face_neighbor_init2
 #define p4est_mesh_face_neighbor_next   p8est_mesh_face_neighbor_next
 #define p4est_mesh_face_neighbor_data   p8est_mesh_face_neighbor_data
+#define p4est_mesh_face_neighbor_next_prefetch  \
+        p8est_mesh_face_neighbor_next_prefetch
+#define p4est_mesh_face_neighbor_ring   p8est_mesh_face_neighbor_ring
+#define p4est_mesh_attach_data          p8est_mesh_attach_data
+#define p4est_mesh_to_csr               p8est_mesh_to_csr
+#define p4est_mesh_face_neighbors_batch p8est_mesh_face_neighbors_batch
 
 /* functions in p4est_balance */
 #define p4est_balance_seeds_face        p8est_balance_seeds_face
 #define p4est_balance_seeds_corner      p8est_balance_seeds_corner
 #define p4est_balance_seeds             p8est_balance_seeds
 
+/* functions in p4est_ensemble */
+#define p4est_ensemble_new              p8est_ensemble_new
+#define p4est_ensemble_forest           p8est_ensemble_forest
+#define p4est_ensemble_data             p8est_ensemble_data
+#define p4est_ensemble_fork             p8est_ensemble_fork
+#define p4est_ensemble_is_forked        p8est_ensemble_is_forked
+#define p4est_ensemble_reset_data       p8est_ensemble_reset_data
+#define p4est_ensemble_destroy          p8est_ensemble_destroy
+
+/* functions in p4est_flags */
+#define p4est_flags_attach              p8est_flags_attach
+#define p4est_flags_detach              p8est_flags_detach
+#define p4est_flags_update              p8est_flags_update
+#define p4est_flags_bytes               p8est_flags_bytes
+#define p4est_flags_test                p8est_flags_test
+#define p4est_flags_set                 p8est_flags_set
+
 /* functions in p4est_wrap */
 #define p4est_wrap_new_conn             p8est_wrap_new_conn
 #define p4est_wrap_new_p4est            p8est_wrap_new_p8est
@@ -427,8 +763,10 @@
 #define p4est_wrap_adapt                p8est_wrap_adapt
 #define p4est_wrap_partition            p8est_wrap_partition
 #define p4est_wrap_complete             p8est_wrap_complete
+#define p4est_wrap_set_subset           p8est_wrap_set_subset
 #define p4est_wrap_leaf_next            p8est_wrap_leaf_next
 #define p4est_wrap_leaf_first           p8est_wrap_leaf_first
+#define p4est_wrap_leaf_first_subset    p8est_wrap_leaf_first_subset
 
 /* functions in p4est_plex */
 #define p4est_get_plex_data             p8est_get_plex_data
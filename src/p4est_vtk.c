@@ -25,13 +25,23 @@
 #ifdef P4_TO_P8
 #include <p8est_vtk.h>
 #include <p8est_nodes.h>
+#include <p8est_bits.h>
+#include <p8est_search.h>
+#include <p8est_communication.h>
 #define P4EST_VTK_CELL_TYPE     11      /* VTK_VOXEL */
 #else
 #include <p4est_vtk.h>
 #include <p4est_nodes.h>
+#include <p4est_bits.h>
+#include <p4est_search.h>
+#include <p4est_communication.h>
 #define P4EST_VTK_CELL_TYPE      8      /* VTK_PIXEL */
 #endif /* !P4_TO_P8 */
 
+#ifdef P4EST_VTK_COMPRESSION
+#include <zlib.h>
+#endif
+
 /* default parameters for the vtk context */
 static const double p4est_vtk_scale = 0.95;
 static const int    p4est_vtk_continuous = 0;
@@ -181,6 +191,15 @@ struct p4est_vtk_context
   double              scale;       /**< Parameter to shrink quadrants. */
   int                 continuous;  /**< Assume continuous point data? */
 
+  /* optional restriction of the output to selected quadrants */
+  p4est_vtk_select_t  select_fn;   /**< Per-quadrant predicate or NULL. */
+  void               *select_user; /**< Passed through to select_fn. */
+  sc_array_t         *select_ranges;   /**< Morton ranges or NULL. */
+  p4est_topidx_t      select_tree; /**< Tree the ranges apply to; -1 means
+                                        they apply within every tree. */
+  p4est_t            *full_p4est;  /**< The original forest while a
+                                        selection view replaces p4est. */
+
   /* internal context data */
   int                 writing;     /**< True after p4est_vtk_write_header. */
   p4est_locidx_t      num_corners; /**< Number of local element corners. */
@@ -193,8 +212,416 @@ struct p4est_vtk_context
   FILE               *vtufile;     /**< File pointer for the VTU file. */
   FILE               *pvtufile;    /**< Paraview meta file. */
   FILE               *visitfile;   /**< Visit meta file. */
+
+  /* state for the raw appended data section */
+  int                 streaming;   /**< Write the header in per-tree chunks? */
+  int                 appended;    /**< Defer data to an appended section? */
+  int                 collective;  /**< Write one shared file with MPI I/O? */
+  sc_array_t         *app_blocks;  /**< Deferred blocks of encoded data. */
+  size_t              app_offset;  /**< Byte offset of the next block. */
+  char                app_format[64];  /**< Scratch for format attribute. */
 };
 
+/** One encoded data block deferred to the appended data section. */
+typedef struct p4est_vtk_app_block
+{
+  char               *data;        /**< Encoded bytes including header. */
+  size_t              byte_length; /**< Number of encoded bytes. */
+  size_t              global_length;   /**< Block length over all ranks. */
+  size_t              local_offset;    /**< This rank's offset in block. */
+}
+p4est_vtk_app_block_t;
+
+static p4est_t     *p4est_vtk_select_build (p4est_vtk_context_t * cont);
+static void         p4est_vtk_select_destroy (p4est_t * sel);
+
+/** Return the format attribute text for the next DataArray element.
+ * In appended mode this includes the offset of the upcoming data block,
+ * so it must be called before \ref p4est_vtk_write_array stashes it.
+ */
+static const char  *
+p4est_vtk_format_attr (p4est_vtk_context_t * cont)
+{
+  if (!cont->appended) {
+    return " format=\"" P4EST_VTK_FORMAT_STRING "\"";
+  }
+  snprintf (cont->app_format, sizeof (cont->app_format),
+            " format=\"appended\" offset=\"%llu\"",
+            (unsigned long long) cont->app_offset);
+  return cont->app_format;
+}
+
+#ifndef P4EST_VTK_ASCII
+
+/** Encode one array, either inline base64 or stashed for appending.
+ * The appended encoding is VTK's raw block format: a UInt32 byte count
+ * before the payload, or the multi-block zlib header when compression
+ * is enabled.  Compression splits the array into independent blocks
+ * that are processed across threads under --enable-openmp.
+ */
+static int
+p4est_vtk_write_array (p4est_vtk_context_t * cont, char *numeric_data,
+                       size_t byte_length)
+{
+  p4est_vtk_app_block_t *block;
+
+  if (!cont->appended) {
+    return p4est_vtk_write_binary (cont->vtufile, numeric_data, byte_length);
+  }
+
+  if (cont->app_blocks == NULL) {
+    cont->app_blocks = sc_array_new (sizeof (p4est_vtk_app_block_t));
+  }
+  block = (p4est_vtk_app_block_t *) sc_array_push (cont->app_blocks);
+
+  if (cont->collective) {
+    /* every rank holds the same number of bytes per cell, so the block
+     * layout in the shared file follows from global_first_quadrant; the
+     * data is kept uncompressed to make the offsets deterministic */
+    p4est_t            *p4est = cont->p4est;
+    p4est_locidx_t      ncells = p4est->local_num_quadrants;
+    long                stride =
+      (long) (ncells > 0 ? byte_length / (size_t) ncells : 0);
+    long                gstride;
+    int                 mpiret;
+
+    P4EST_ASSERT (ncells == 0 ||
+                  byte_length == (size_t) stride * (size_t) ncells);
+    mpiret = sc_MPI_Allreduce (&stride, &gstride, 1, sc_MPI_LONG,
+                               sc_MPI_MAX, p4est->mpicomm);
+    SC_CHECK_MPI (mpiret);
+
+    block->byte_length = byte_length;
+    block->data = P4EST_ALLOC (char, byte_length);
+    memcpy (block->data, numeric_data, byte_length);
+    block->global_length = sizeof (uint32_t) +
+      (size_t) gstride * (size_t) p4est->global_num_quadrants;
+    block->local_offset = sizeof (uint32_t) + (size_t) gstride *
+      (size_t) p4est->global_first_quadrant[p4est->mpirank];
+
+    cont->app_offset += block->global_length;
+    return 0;
+  }
+
+#ifndef P4EST_VTK_COMPRESSION
+  {
+    uint32_t            header = (uint32_t) byte_length;
+
+    block->byte_length = sizeof (uint32_t) + byte_length;
+    block->data = P4EST_ALLOC (char, block->byte_length);
+    memcpy (block->data, &header, sizeof (uint32_t));
+    memcpy (block->data + sizeof (uint32_t), numeric_data, byte_length);
+  }
+#else
+  {
+    const size_t        bsize = 1 << 15;      /* VTK's default block size */
+    /* an empty array writes the header [0][bsize][0] and no payload:
+     * claiming one block with last size zero would promise a full block */
+    size_t              nblocks = (byte_length + bsize - 1) / bsize;
+    size_t              lastsize = byte_length % bsize;   /* 0: no partial */
+    size_t              bound = compressBound ((uLong) bsize);
+    size_t              hlen = (3 + nblocks) * sizeof (uint32_t);
+    size_t              zb, total;
+    uint32_t           *header;
+    uLongf             *destlen;
+    char               *scratch;
+    int                 zerror = Z_OK;
+
+    destlen = P4EST_ALLOC (uLongf, nblocks);
+    scratch = P4EST_ALLOC (char, nblocks * bound);
+
+    /* the blocks are independent; compress them across threads */
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (dynamic)
+#endif
+    for (zb = 0; zb < nblocks; zb++) {
+      size_t              zlen = SC_MIN (bsize, byte_length - zb * bsize);
+      int                 zret;
+
+      destlen[zb] = (uLongf) bound;
+      zret = compress2 ((Bytef *) (scratch + zb * bound), &destlen[zb],
+                        (const Bytef *) (numeric_data + zb * bsize),
+                        (uLong) zlen, Z_DEFAULT_COMPRESSION);
+      if (zret != Z_OK) {
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp critical
+#endif
+        zerror = zret;
+      }
+    }
+    if (zerror != Z_OK) {
+      P4EST_FREE (destlen);
+      P4EST_FREE (scratch);
+      block->data = NULL;
+      block->byte_length = 0;
+      return -1;
+    }
+
+    total = hlen;
+    for (zb = 0; zb < nblocks; zb++) {
+      total += (size_t) destlen[zb];
+    }
+    block->byte_length = total;
+    block->data = P4EST_ALLOC (char, total);
+
+    header = (uint32_t *) block->data;
+    header[0] = (uint32_t) nblocks;
+    header[1] = (uint32_t) bsize;
+    header[2] = (uint32_t) lastsize;
+    total = hlen;
+    for (zb = 0; zb < nblocks; zb++) {
+      header[3 + zb] = (uint32_t) destlen[zb];
+      memcpy (block->data + total, scratch + zb * bound,
+              (size_t) destlen[zb]);
+      total += (size_t) destlen[zb];
+    }
+    P4EST_FREE (destlen);
+    P4EST_FREE (scratch);
+  }
+#endif /* P4EST_VTK_COMPRESSION */
+
+  block->global_length = block->byte_length;
+  block->local_offset = 0;
+  cont->app_offset += block->byte_length;
+  return 0;
+}
+
+/* base64 alphabet for the streaming encoder below */
+static const char   p4est_vtk_base64_tab[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/** Feed bytes into a continuous base64 stream.
+ * Between calls, up to two bytes of an unfinished triple live in \a carry.
+ */
+static void
+p4est_vtk_base64_feed (FILE * file, int *rem, char *carry,
+                       const char *data, size_t length)
+{
+  char                e[4];
+  const unsigned char *u;
+
+  /* finish a triple left over from an earlier call */
+  while (*rem > 0 && length > 0) {
+    carry[(*rem)++] = *data++;
+    --length;
+    if (*rem == 3) {
+      u = (const unsigned char *) carry;
+      e[0] = p4est_vtk_base64_tab[u[0] >> 2];
+      e[1] = p4est_vtk_base64_tab[((u[0] & 0x03) << 4) | (u[1] >> 4)];
+      e[2] = p4est_vtk_base64_tab[((u[1] & 0x0F) << 2) | (u[2] >> 6)];
+      e[3] = p4est_vtk_base64_tab[u[2] & 0x3F];
+      (void) fwrite (e, 1, 4, file);
+      *rem = 0;
+    }
+  }
+
+  /* encode whole triples straight from the input */
+  while (length >= 3) {
+    u = (const unsigned char *) data;
+    e[0] = p4est_vtk_base64_tab[u[0] >> 2];
+    e[1] = p4est_vtk_base64_tab[((u[0] & 0x03) << 4) | (u[1] >> 4)];
+    e[2] = p4est_vtk_base64_tab[((u[1] & 0x0F) << 2) | (u[2] >> 6)];
+    e[3] = p4est_vtk_base64_tab[u[2] & 0x3F];
+    (void) fwrite (e, 1, 4, file);
+    data += 3;
+    length -= 3;
+  }
+
+  /* stash the tail for the next call */
+  while (length > 0) {
+    carry[(*rem)++] = *data++;
+    --length;
+  }
+}
+
+/** Terminate a base64 stream, emitting the padded final group. */
+static void
+p4est_vtk_base64_rest (FILE * file, int *rem, char *carry)
+{
+  char                e[4];
+  const unsigned char *u = (const unsigned char *) carry;
+
+  if (*rem == 1) {
+    e[0] = p4est_vtk_base64_tab[u[0] >> 2];
+    e[1] = p4est_vtk_base64_tab[(u[0] & 0x03) << 4];
+    e[2] = e[3] = '=';
+    (void) fwrite (e, 1, 4, file);
+  }
+  else if (*rem == 2) {
+    e[0] = p4est_vtk_base64_tab[u[0] >> 2];
+    e[1] = p4est_vtk_base64_tab[((u[0] & 0x03) << 4) | (u[1] >> 4)];
+    e[2] = p4est_vtk_base64_tab[(u[1] & 0x0F) << 2];
+    e[3] = '=';
+    (void) fwrite (e, 1, 4, file);
+  }
+  *rem = 0;
+}
+
+/** State for writing one inline DataArray in bounded memory.
+ * Without compression the bytes are base64-encoded as they arrive.
+ * With compression the raw bytes are collected into VTK's 32 KiB
+ * blocks, each compressed and spilled to a temporary file, since the
+ * multi-block header listing all compressed sizes must precede the
+ * data; the end call replays the blocks through the base64 encoder.
+ */
+typedef struct p4est_vtk_stream
+{
+  p4est_vtk_context_t *cont;
+  int                 rem;         /**< pending bytes of a base64 triple */
+  char                carry[3];
+#ifdef P4EST_VTK_COMPRESSION
+  size_t              total;       /**< raw bytes announced up front */
+  size_t              pend;        /**< fill level of the pending block */
+  char               *pending;     /**< one raw block of bsize bytes */
+  char               *scratch;     /**< compressBound sized scratch */
+  FILE               *blockfile;   /**< compressed blocks in order */
+  sc_array_t         *blocksizes;  /**< compressed size per block */
+#endif
+}
+p4est_vtk_stream_t;
+
+#ifdef P4EST_VTK_COMPRESSION
+
+/** Compress the pending raw block and spill it to the block file. */
+static int
+p4est_vtk_stream_flush (p4est_vtk_stream_t * vs)
+{
+  const size_t        bsize = 1 << 15;      /* VTK's default block size */
+  uLongf              destlen = (uLongf) compressBound ((uLong) bsize);
+
+  if (compress2 ((Bytef *) vs->scratch, &destlen,
+                 (const Bytef *) vs->pending, (uLong) vs->pend,
+                 Z_DEFAULT_COMPRESSION) != Z_OK) {
+    return -1;
+  }
+  if (fwrite (vs->scratch, 1, (size_t) destlen, vs->blockfile) !=
+      (size_t) destlen) {
+    return -1;
+  }
+  *(uint32_t *) sc_array_push (vs->blocksizes) = (uint32_t) destlen;
+  vs->pend = 0;
+  return 0;
+}
+
+#endif /* P4EST_VTK_COMPRESSION */
+
+/** Start streaming one DataArray of \a total payload bytes. */
+static int
+p4est_vtk_stream_begin (p4est_vtk_context_t * cont, p4est_vtk_stream_t * vs,
+                        size_t total)
+{
+  P4EST_ASSERT (!cont->appended);
+
+  vs->cont = cont;
+  vs->rem = 0;
+#ifndef P4EST_VTK_COMPRESSION
+  {
+    uint32_t            header = (uint32_t) total;
+
+    p4est_vtk_base64_feed (cont->vtufile, &vs->rem, vs->carry,
+                           (const char *) &header, sizeof (uint32_t));
+  }
+#else
+  vs->total = total;
+  vs->pend = 0;
+  vs->pending = P4EST_ALLOC (char, (size_t) 1 << 15);
+  vs->scratch = P4EST_ALLOC (char, compressBound ((uLong) (1 << 15)));
+  vs->blocksizes = sc_array_new (sizeof (uint32_t));
+  vs->blockfile = tmpfile ();
+  if (vs->blockfile == NULL) {
+    P4EST_FREE (vs->pending);
+    P4EST_FREE (vs->scratch);
+    sc_array_destroy (vs->blocksizes);
+    return -1;
+  }
+#endif
+  return 0;
+}
+
+/** Append one chunk of payload bytes to the streamed DataArray. */
+static int
+p4est_vtk_stream_chunk (p4est_vtk_stream_t * vs, const char *data,
+                        size_t length)
+{
+#ifndef P4EST_VTK_COMPRESSION
+  p4est_vtk_base64_feed (vs->cont->vtufile, &vs->rem, vs->carry,
+                         data, length);
+#else
+  const size_t        bsize = 1 << 15;
+  size_t              now;
+
+  while (length > 0) {
+    now = SC_MIN (length, bsize - vs->pend);
+    memcpy (vs->pending + vs->pend, data, now);
+    vs->pend += now;
+    data += now;
+    length -= now;
+    if (vs->pend == bsize && p4est_vtk_stream_flush (vs)) {
+      return -1;
+    }
+  }
+#endif
+  return 0;
+}
+
+/** Finish the streamed DataArray and release all stream resources. */
+static int
+p4est_vtk_stream_end (p4est_vtk_stream_t * vs)
+{
+  FILE               *vtufile = vs->cont->vtufile;
+#ifdef P4EST_VTK_COMPRESSION
+  const size_t        bsize = 1 << 15;
+  int                 retval = 0;
+  size_t              zb, readnow;
+  uint32_t            word;
+
+  /* flush a trailing partial block; an empty array yields one block */
+  if (vs->pend > 0 || vs->blocksizes->elem_count == 0) {
+    retval = p4est_vtk_stream_flush (vs);
+  }
+
+  if (!retval) {
+    /* the multi-block header forms its own base64 stream */
+    word = (uint32_t) vs->blocksizes->elem_count;
+    p4est_vtk_base64_feed (vtufile, &vs->rem, vs->carry,
+                           (const char *) &word, sizeof (uint32_t));
+    word = (uint32_t) bsize;
+    p4est_vtk_base64_feed (vtufile, &vs->rem, vs->carry,
+                           (const char *) &word, sizeof (uint32_t));
+    word = (uint32_t) (vs->total % bsize);      /* 0 means no partial */
+    p4est_vtk_base64_feed (vtufile, &vs->rem, vs->carry,
+                           (const char *) &word, sizeof (uint32_t));
+    for (zb = 0; zb < vs->blocksizes->elem_count; ++zb) {
+      p4est_vtk_base64_feed (vtufile, &vs->rem, vs->carry, (const char *)
+                             sc_array_index (vs->blocksizes, zb),
+                             sizeof (uint32_t));
+    }
+    p4est_vtk_base64_rest (vtufile, &vs->rem, vs->carry);
+
+    /* replay the compressed blocks as the data stream */
+    rewind (vs->blockfile);
+    while ((readnow = fread (vs->pending, 1, bsize, vs->blockfile)) > 0) {
+      p4est_vtk_base64_feed (vtufile, &vs->rem, vs->carry,
+                             vs->pending, readnow);
+    }
+  }
+  p4est_vtk_base64_rest (vtufile, &vs->rem, vs->carry);
+
+  (void) fclose (vs->blockfile);
+  P4EST_FREE (vs->pending);
+  P4EST_FREE (vs->scratch);
+  sc_array_destroy (vs->blocksizes);
+  if (retval) {
+    return -1;
+  }
+#else
+  p4est_vtk_base64_rest (vtufile, &vs->rem, vs->carry);
+#endif
+  return ferror (vtufile) ? -1 : 0;
+}
+
+#endif /* !P4EST_VTK_ASCII */
+
 p4est_vtk_context_t *
 p4est_vtk_context_new (p4est_t * p4est, const char *filename)
 {
@@ -211,6 +638,7 @@ p4est_vtk_context_new (p4est_t * p4est, const char *filename)
 
   cont->scale = p4est_vtk_scale;
   cont->continuous = p4est_vtk_continuous;
+  cont->select_tree = -1;
 
   return cont;
 }
@@ -244,6 +672,77 @@ p4est_vtk_context_set_continuous (p4est_vtk_context_t * cont, int continuous)
   cont->continuous = continuous;
 }
 
+void
+p4est_vtk_context_set_appended (p4est_vtk_context_t * cont, int appended)
+{
+  P4EST_ASSERT (cont != NULL);
+  P4EST_ASSERT (!cont->writing);
+
+#ifdef P4EST_VTK_ASCII
+  /* an ascii build has no raw representation of the data blocks */
+  appended = 0;
+#endif
+  cont->appended = appended;
+}
+
+void
+p4est_vtk_context_set_collective (p4est_vtk_context_t * cont, int collective)
+{
+  P4EST_ASSERT (cont != NULL);
+  P4EST_ASSERT (!cont->writing);
+
+#if !defined P4EST_ENABLE_MPIIO || defined P4EST_VTK_ASCII
+  if (collective) {
+    P4EST_LERROR (P4EST_STRING "_vtk: collective output requires MPI I/O"
+                  " and binary data; writing one file per process\n");
+    collective = 0;
+  }
+#endif
+  cont->collective = collective;
+  if (collective) {
+    /* the shared file is laid out as one raw appended data section */
+    cont->appended = 1;
+  }
+}
+
+void
+p4est_vtk_context_set_select (p4est_vtk_context_t * cont,
+                              p4est_vtk_select_t select_fn, void *user)
+{
+  P4EST_ASSERT (cont != NULL);
+  P4EST_ASSERT (!cont->writing);
+
+  cont->select_fn = select_fn;
+  cont->select_user = user;
+}
+
+void
+p4est_vtk_context_set_ranges (p4est_vtk_context_t * cont,
+                              p4est_topidx_t which_tree, sc_array_t * ranges)
+{
+  P4EST_ASSERT (cont != NULL);
+  P4EST_ASSERT (!cont->writing);
+  P4EST_ASSERT (ranges == NULL ||
+                ranges->elem_size == sizeof (p4est_morton_range_t));
+  P4EST_ASSERT (which_tree >= -1);
+
+  cont->select_ranges = ranges;
+  cont->select_tree = which_tree;
+}
+
+void
+p4est_vtk_context_set_streaming (p4est_vtk_context_t * cont, int streaming)
+{
+  P4EST_ASSERT (cont != NULL);
+  P4EST_ASSERT (!cont->writing);
+
+#ifdef P4EST_VTK_ASCII
+  /* the ascii writer prints from one array and cannot stream */
+  streaming = 0;
+#endif
+  cont->streaming = streaming;
+}
+
 void
 p4est_vtk_context_destroy (p4est_vtk_context_t * context)
 {
@@ -253,6 +752,13 @@ p4est_vtk_context_destroy (p4est_vtk_context_t * context)
   /* since this function is called inside write_header and write_footer,
    * we cannot assume a consistent state of all member variables */
 
+  if (context->full_p4est != NULL) {
+    /* drop the selection view and restore the caller's forest */
+    p4est_vtk_select_destroy (context->p4est);
+    context->p4est = context->full_p4est;
+    context->full_p4est = NULL;
+  }
+
   P4EST_ASSERT (context->filename != NULL);
   P4EST_FREE (context->filename);
 
@@ -262,6 +768,20 @@ p4est_vtk_context_destroy (p4est_vtk_context_t * context)
   }
   P4EST_FREE (context->node_to_corner);
 
+  /* deallocate any data blocks not yet written to the appended section */
+  if (context->app_blocks != NULL) {
+    size_t              zz;
+    p4est_vtk_app_block_t *block;
+
+    for (zz = 0; zz < context->app_blocks->elem_count; zz++) {
+      block = (p4est_vtk_app_block_t *)
+        sc_array_index (context->app_blocks, zz);
+      P4EST_FREE (block->data);
+    }
+    sc_array_destroy (context->app_blocks);
+    context->app_blocks = NULL;
+  }
+
   /* Close all file pointers. */
   if (context->vtufile != NULL) {
     if (fclose (context->vtufile)) {
@@ -328,6 +848,137 @@ p4est_vtk_write_file (p4est_t * p4est, p4est_geometry_t * geom,
   SC_CHECK_ABORT (!retval, P4EST_STRING "_vtk: Error writing footer");
 }
 
+/** Decide whether one quadrant is part of the selected output. */
+static int
+p4est_vtk_select_quadrant (p4est_vtk_context_t * cont, p4est_topidx_t jt,
+                           p4est_quadrant_t * quad)
+{
+  size_t              zlo, zhi, zmid;
+  uint64_t            qfirst, qlast;
+  p4est_quadrant_t    fd;
+  p4est_morton_range_t *range;
+
+  if (cont->select_fn != NULL) {
+    return cont->select_fn (cont->full_p4est, jt, quad,
+                            cont->select_user) != 0;
+  }
+  P4EST_ASSERT (cont->select_ranges != NULL);
+
+  if (cont->select_tree != -1 && jt != cont->select_tree) {
+    return 0;
+  }
+
+  /* the finest-level index interval covered by this quadrant */
+  p4est_quadrant_first_descendant (quad, &fd, P4EST_QMAXLEVEL);
+  qfirst = p4est_quadrant_linear_id (&fd, P4EST_QMAXLEVEL);
+  qlast = qfirst +
+    (((uint64_t) 1 << (P4EST_DIM * (P4EST_QMAXLEVEL - quad->level))) - 1);
+
+  /* find the first range that ends at or after the quadrant */
+  zlo = 0;
+  zhi = cont->select_ranges->elem_count;
+  while (zlo < zhi) {
+    zmid = zlo + (zhi - zlo) / 2;
+    range = (p4est_morton_range_t *)
+      sc_array_index (cont->select_ranges, zmid);
+    if (range->last < qfirst) {
+      zlo = zmid + 1;
+    }
+    else {
+      zhi = zmid;
+    }
+  }
+  if (zlo == cont->select_ranges->elem_count) {
+    return 0;
+  }
+  range = (p4est_morton_range_t *) sc_array_index (cont->select_ranges, zlo);
+  return range->first <= qlast;
+}
+
+/** Build a transient view of the forest holding only selected quadrants.
+ * The view shares the connectivity and communicator of the original
+ * forest and carries consistent local and global counts, so the writer
+ * functions and the parallel piece bookkeeping work on it unchanged.
+ */
+static p4est_t     *
+p4est_vtk_select_build (p4est_vtk_context_t * cont)
+{
+  p4est_t            *p4est = cont->full_p4est;
+  p4est_t            *sel;
+  int                 j;
+  size_t              zz;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree, *stree;
+  p4est_quadrant_t   *quad, *copy;
+
+  sel = P4EST_ALLOC_ZERO (p4est_t, 1);
+  sel->mpicomm = p4est->mpicomm;
+  sel->mpisize = p4est->mpisize;
+  sel->mpirank = p4est->mpirank;
+  sel->connectivity = p4est->connectivity;
+  sel->user_pointer = p4est->user_pointer;
+  sel->first_local_tree = -1;
+  sel->last_local_tree = -2;
+
+  sel->trees = sc_array_new_count (sizeof (p4est_tree_t),
+                                   p4est->trees->elem_count);
+  for (jt = 0; jt < (p4est_topidx_t) sel->trees->elem_count; ++jt) {
+    stree = p4est_tree_array_index (sel->trees, jt);
+    memset (stree, 0, sizeof (p4est_tree_t));
+    sc_array_init (&stree->quadrants, sizeof (p4est_quadrant_t));
+    stree->quadrants_offset = sel->local_num_quadrants;
+    for (j = P4EST_QMAXLEVEL + 1; j <= P4EST_MAXLEVEL; ++j) {
+      stree->quadrants_per_level[j] = -1;
+    }
+    if (jt < p4est->first_local_tree || jt > p4est->last_local_tree) {
+      continue;
+    }
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      quad = p4est_quadrant_array_index (&tree->quadrants, zz);
+      if (!p4est_vtk_select_quadrant (cont, jt, quad)) {
+        continue;
+      }
+      copy = p4est_quadrant_array_push (&stree->quadrants);
+      *copy = *quad;
+      ++stree->quadrants_per_level[quad->level];
+      if (quad->level > stree->maxlevel) {
+        stree->maxlevel = quad->level;
+      }
+    }
+    if (stree->quadrants.elem_count > 0) {
+      if (sel->first_local_tree == -1) {
+        sel->first_local_tree = jt;
+      }
+      sel->last_local_tree = jt;
+      sel->local_num_quadrants +=
+        (p4est_locidx_t) stree->quadrants.elem_count;
+    }
+  }
+
+  /* establish the global counts of the selection */
+  sel->global_first_quadrant = P4EST_ALLOC (p4est_gloidx_t, sel->mpisize + 1);
+  p4est_comm_count_quadrants (sel);
+
+  return sel;
+}
+
+/** Free a selection view created by \ref p4est_vtk_select_build. */
+static void
+p4est_vtk_select_destroy (p4est_t * sel)
+{
+  p4est_topidx_t      jt;
+  p4est_tree_t       *stree;
+
+  for (jt = 0; jt < (p4est_topidx_t) sel->trees->elem_count; ++jt) {
+    stree = p4est_tree_array_index (sel->trees, jt);
+    sc_array_reset (&stree->quadrants);
+  }
+  sc_array_destroy (sel->trees);
+  P4EST_FREE (sel->global_first_quadrant);
+  P4EST_FREE (sel);
+}
+
 p4est_vtk_context_t *
 p4est_vtk_write_header (p4est_vtk_context_t * cont)
 {
@@ -349,18 +1000,22 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
   int                 retval;
   uint8_t            *uint8_data;
   p4est_locidx_t     *locidx_data;
+  p4est_vtk_stream_t  vs;
 #endif
   int                 xi, yi, j, k;
 #ifdef P4_TO_P8
   int                 zi;
 #endif
   double              h2, eta_x, eta_y, eta_z = 0.;
-  double              xyz[3], XYZ[3];   /* 3 not P4EST_DIM */
+  double              xyz[3];   /* 3 not P4EST_DIM */
+  double             *geom_abc, *geom_xyz;
+  size_t              gidx, z0;
   size_t              num_quads, zz;
   p4est_topidx_t      jt;
   p4est_topidx_t      vt[P4EST_CHILDREN];
   p4est_locidx_t      quad_count, Npoints;
-  p4est_locidx_t      sk, il, ntcid, *ntc;
+  p4est_locidx_t      sk, il, ntcid, fidx, *ntc;
+  size_t              max_quads;
   P4EST_VTK_FLOAT_TYPE *float_data;
   sc_array_t         *quadrants, *indeps;
   sc_array_t         *trees;
@@ -381,6 +1036,20 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
   /* from now on this context is officially in use for writing */
   cont->writing = 1;
 
+  if (cont->streaming && cont->appended) {
+    /* the appended data section defers all blocks by design */
+    P4EST_LERROR (P4EST_STRING "_vtk: appended data cannot be streamed;"
+                  " writing the header in one piece\n");
+    cont->streaming = 0;
+  }
+
+  if (cont->select_fn != NULL || cont->select_ranges != NULL) {
+    /* replace the forest by a view holding only the selected quadrants;
+     * all counts and offsets below then refer to the selection */
+    cont->full_p4est = cont->p4est;
+    cont->p4est = p4est_vtk_select_build (cont);
+  }
+
   /* grab context variables */
   p4est = cont->p4est;
   filename = cont->filename;
@@ -406,9 +1075,22 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
   last_local_tree = p4est->last_local_tree;
   Ncells = p4est->local_num_quadrants;
 
+  /* the single collective piece indexes its corners globally, which
+   * must not overflow the local index type used in the file */
+  SC_CHECK_ABORT (!cont->collective ||
+                  p4est->global_num_quadrants <=
+                  (p4est_gloidx_t) P4EST_LOCIDX_MAX / P4EST_CHILDREN,
+                  P4EST_STRING "_vtk: too many global corners for"
+                  " collective output");
+
   cont->num_corners = Ncorners = P4EST_CHILDREN * Ncells;
-  if (scale < 1. || !conti) {
-    /* when we scale the quadrants we need each corner separately */
+  if (scale < 1. || !conti || cont->collective || cont->streaming ||
+      cont->full_p4est != NULL) {
+    /* when we scale the quadrants we need each corner separately; the
+     * collective writer needs them as well, since its file offsets
+     * derive from the global quadrant counts alone, the streaming
+     * writer emits per-tree chunks without a deduplicated node list,
+     * and a selection view is not a complete forest to run nodes on */
     cont->nodes = nodes = NULL;
     cont->num_points = Npoints = Ncorners;
     cont->node_to_corner = ntc = NULL;
@@ -445,12 +1127,20 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
 #endif
   }
 
-  /* Have each proc write to its own file */
-  snprintf (cont->vtufilename, BUFSIZ, "%s_%04d.vtu", filename, mpirank);
-  /* Use "w" for writing the initial part of the file.
-   * For further parts, use "r+" and fseek so write_compressed succeeds.
-   */
-  cont->vtufile = fopen (cont->vtufilename, "wb");
+  if (!cont->collective) {
+    /* Have each proc write to its own file */
+    snprintf (cont->vtufilename, BUFSIZ, "%s_%04d.vtu", filename, mpirank);
+    /* Use "w" for writing the initial part of the file.
+     * For further parts, use "r+" and fseek so write_compressed succeeds.
+     */
+    cont->vtufile = fopen (cont->vtufilename, "wb");
+  }
+  else {
+    /* All procs share one file; the XML text is identical on every rank
+     * and is buffered here until the collective write in the footer. */
+    snprintf (cont->vtufilename, BUFSIZ, "%s.vtu", filename);
+    cont->vtufile = tmpfile ();
+  }
   if (cont->vtufile == NULL) {
     P4EST_LERRORF ("Could not open %s for output\n", cont->vtufilename);
     p4est_vtk_context_destroy (cont);
@@ -461,7 +1151,10 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
   fprintf (cont->vtufile,
            "<VTKFile type=\"UnstructuredGrid\" version=\"0.1\"");
 #if defined P4EST_VTK_BINARY && defined P4EST_VTK_COMPRESSION
-  fprintf (cont->vtufile, " compressor=\"vtkZLibDataCompressor\"");
+  if (!cont->collective) {
+    /* the collective layout keeps the blocks uncompressed */
+    fprintf (cont->vtufile, " compressor=\"vtkZLibDataCompressor\"");
+  }
 #endif
 #ifdef SC_IS_BIGENDIAN
   fprintf (cont->vtufile, " byte_order=\"BigEndian\">\n");
@@ -471,15 +1164,63 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
   fprintf (cont->vtufile, "  <UnstructuredGrid>\n");
   fprintf (cont->vtufile,
            "    <Piece NumberOfPoints=\"%lld\" NumberOfCells=\"%lld\">\n",
-           (long long) Npoints, (long long) Ncells);
+           !cont->collective ? (long long) Npoints :
+           (long long) P4EST_CHILDREN * cont->p4est->global_num_quadrants,
+           !cont->collective ? (long long) Ncells :
+           (long long) cont->p4est->global_num_quadrants);
   fprintf (cont->vtufile, "      <Points>\n");
 
-  float_data = P4EST_ALLOC (P4EST_VTK_FLOAT_TYPE, 3 * Npoints);
+  if (!cont->streaming) {
+    float_data = P4EST_ALLOC (P4EST_VTK_FLOAT_TYPE, 3 * Npoints);
+  }
+  else {
+    /* bound the coordinate buffer by the largest local tree */
+    max_quads = 0;
+    for (jt = first_local_tree; jt <= last_local_tree; ++jt) {
+      tree = p4est_tree_array_index (trees, jt);
+      max_quads = SC_MAX (max_quads, tree->quadrants.elem_count);
+    }
+    float_data = P4EST_ALLOC (P4EST_VTK_FLOAT_TYPE,
+                              3 * P4EST_CHILDREN * max_quads);
+  }
 
   /* write point position data */
   fprintf (cont->vtufile, "        <DataArray type=\"%s\" Name=\"Position\""
-           " NumberOfComponents=\"3\" format=\"%s\">\n",
-           P4EST_VTK_FLOAT_NAME, P4EST_VTK_FORMAT_STRING);
+           " NumberOfComponents=\"3\"%s>\n",
+           P4EST_VTK_FLOAT_NAME, p4est_vtk_format_attr (cont));
+
+#ifndef P4EST_VTK_ASCII
+  retval = 0;
+  if (cont->streaming) {
+    fprintf (cont->vtufile, "          ");
+    if (p4est_vtk_stream_begin (cont, &vs, sizeof (*float_data) *
+                                3 * (size_t) Npoints)) {
+      P4EST_LERROR (P4EST_STRING "_vtk: Error streaming points\n");
+      p4est_vtk_context_destroy (cont);
+      P4EST_FREE (float_data);
+      return NULL;
+    }
+  }
+#endif
+
+  geom_abc = geom_xyz = NULL;
+  if (geom != NULL) {
+    /* stage reference points and map them through the geometry in one
+     * batch per tree; see p4est_geometry_X_v */
+    if (nodes == NULL) {
+      max_quads = 0;
+      for (jt = first_local_tree; jt <= last_local_tree; ++jt) {
+        tree = p4est_tree_array_index (trees, jt);
+        max_quads = SC_MAX (max_quads, tree->quadrants.elem_count);
+      }
+      geom_abc = P4EST_ALLOC (double, 3 * P4EST_CHILDREN * max_quads);
+      geom_xyz = P4EST_ALLOC (double, 3 * P4EST_CHILDREN * max_quads);
+    }
+    else {
+      geom_abc = P4EST_ALLOC (double, 3 * (size_t) Npoints);
+      geom_xyz = P4EST_ALLOC (double, 3 * (size_t) Npoints);
+    }
+  }
 
   if (nodes == NULL) {
     /* loop over the trees */
@@ -504,6 +1245,8 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
       for (zz = 0; zz < num_quads; ++zz, ++quad_count) {
         quad = p4est_quadrant_array_index (quadrants, zz);
         h2 = .5 * intsize * P4EST_QUADRANT_LEN (quad->level);
+        fidx = 3 * P4EST_CHILDREN * (cont->streaming ?
+                                     (p4est_locidx_t) zz : quad_count);
         k = 0;
 #ifdef P4_TO_P8
         for (zi = 0; zi < 2; ++zi) {
@@ -515,14 +1258,11 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
               P4EST_ASSERT (0 <= k && k < P4EST_CHILDREN);
               eta_x = intsize * quad->x + h2 * (1. + (xi * 2 - 1) * scale);
               if (geom != NULL) {
-                xyz[0] = eta_x;
-                xyz[1] = eta_y;
-                xyz[2] = eta_z;
-                geom->X (geom, jt, xyz, XYZ);
-                for (j = 0; j < 3; ++j) {
-                  float_data[3 * (P4EST_CHILDREN * quad_count + k) + j] =
-                    (P4EST_VTK_FLOAT_TYPE) XYZ[j];
-                }
+                /* stage the point for the batched call after this tree */
+                gidx = 3 * (P4EST_CHILDREN * zz + (size_t) k);
+                geom_abc[gidx + 0] = eta_x;
+                geom_abc[gidx + 1] = eta_y;
+                geom_abc[gidx + 2] = eta_z;
               }
               else {
                 for (j = 0; j < 3; ++j) {
@@ -540,7 +1280,7 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
 #endif
             );
                   /* *INDENT-ON* */
-                  float_data[3 * (P4EST_CHILDREN * quad_count + k) + j] =
+                  float_data[fidx + 3 * k + j] =
                     (P4EST_VTK_FLOAT_TYPE) xyz[j];
                 }
               }
@@ -552,63 +1292,123 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
 #endif
         P4EST_ASSERT (k == P4EST_CHILDREN);
       }
+      if (geom != NULL) {
+        /* map all corner points of this tree in one batch */
+        p4est_geometry_X_v (geom, jt, P4EST_CHILDREN * num_quads,
+                            geom_abc, geom_xyz);
+        fidx = 3 * P4EST_CHILDREN *
+          (cont->streaming ? 0 : quad_count - (p4est_locidx_t) num_quads);
+        for (gidx = 0; gidx < 3 * P4EST_CHILDREN * num_quads; ++gidx) {
+          float_data[fidx + gidx] = (P4EST_VTK_FLOAT_TYPE) geom_xyz[gidx];
+        }
+      }
+#ifndef P4EST_VTK_ASCII
+      if (cont->streaming) {
+        /* write this tree's coordinates and reuse the buffer */
+        retval |= p4est_vtk_stream_chunk (&vs, (const char *) float_data,
+                                          sizeof (*float_data) * 3 *
+                                          P4EST_CHILDREN * num_quads);
+      }
+#endif
     }
     P4EST_ASSERT (P4EST_CHILDREN * quad_count == Npoints);
   }
-  else {
-    for (zz = 0; zz < indeps->elem_count; ++zz) {
-      in = (p4est_indep_t *) sc_array_index (indeps, zz);
+  else if (geom != NULL) {
+    p4est_locidx_t      nz;
+
+    /* stage all reference points, then map each run of nodes in the
+     * same tree through the geometry in one batch; the per-node loops
+     * are independent and run thread-parallel */
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (static)
+#endif
+    for (nz = 0; nz < Npoints; ++nz) {
+      p4est_indep_t      *nin;
 
-      /* retrieve corners of the tree */
+      nin = (p4est_indep_t *) sc_array_index (indeps, (size_t) nz);
+      geom_abc[3 * nz + 0] = intsize * nin->x;
+      geom_abc[3 * nz + 1] = intsize * nin->y;
+#ifdef P4_TO_P8
+      geom_abc[3 * nz + 2] = intsize * nin->z;
+#else
+      geom_abc[3 * nz + 2] = 0.;
+#endif
+    }
+    for (zz = 0; zz < indeps->elem_count; zz = z0) {
+      in = (p4est_indep_t *) sc_array_index (indeps, zz);
       jt = in->p.which_tree;
-      if (geom == NULL) {
-        for (k = 0; k < P4EST_CHILDREN; ++k) {
-          vt[k] = tree_to_vertex[jt * P4EST_CHILDREN + k];
+      for (z0 = zz + 1; z0 < indeps->elem_count; ++z0) {
+        in = (p4est_indep_t *) sc_array_index (indeps, z0);
+        if (in->p.which_tree != jt) {
+          break;
         }
       }
-      else {
-        /* provoke crash on logic bug */
-        P4EST_ASSERT (vt[0] == -1);
-        v = NULL;
+      p4est_geometry_X_v (geom, jt, z0 - zz,
+                          geom_abc + 3 * zz, geom_xyz + 3 * zz);
+    }
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (static)
+#endif
+    for (nz = 0; nz < Npoints; ++nz) {
+      int                 nj;
+
+      for (nj = 0; nj < 3; ++nj) {
+        float_data[3 * nz + nj] =
+          (P4EST_VTK_FLOAT_TYPE) geom_xyz[3 * nz + nj];
       }
+    }
+  }
+  else {
+    p4est_locidx_t      nz;
 
-      /* calculate vertex coordinates */
-      eta_x = intsize * in->x;
-      eta_y = intsize * in->y;
-#ifdef P4_TO_P8
-      eta_z = intsize * in->z;
+    /* each deduplicated node interpolates the tree corner vertices
+     * independently, so the loop runs thread-parallel */
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (static)
 #endif
-      if (geom != NULL) {
-        xyz[0] = eta_x;
-        xyz[1] = eta_y;
-        xyz[2] = eta_z;
-        geom->X (geom, jt, xyz, XYZ);
-        for (j = 0; j < 3; ++j) {
-          float_data[3 * zz + j] = (P4EST_VTK_FLOAT_TYPE) XYZ[j];
-        }
+    for (nz = 0; nz < Npoints; ++nz) {
+      int                 nk, nj;
+      double              neta_x, neta_y, neta_z;
+      p4est_topidx_t      njt;
+      p4est_topidx_t      nvt[P4EST_CHILDREN];
+      p4est_indep_t      *nin;
+
+      nin = (p4est_indep_t *) sc_array_index (indeps, (size_t) nz);
+
+      /* retrieve corners of the tree */
+      njt = nin->p.which_tree;
+      for (nk = 0; nk < P4EST_CHILDREN; ++nk) {
+        nvt[nk] = tree_to_vertex[njt * P4EST_CHILDREN + nk];
       }
-      else {
-        for (j = 0; j < 3; ++j) {
-          /* *INDENT-OFF* */
-          xyz[j] =
-            ((1. - eta_z) * ((1. - eta_y) * ((1. - eta_x) * v[3 * vt[0] + j] +
-                                                   eta_x  * v[3 * vt[1] + j]) +
-                                   eta_y  * ((1. - eta_x) * v[3 * vt[2] + j] +
-                                                   eta_x  * v[3 * vt[3] + j]))
-  #ifdef P4_TO_P8
-             +     eta_z  * ((1. - eta_y) * ((1. - eta_x) * v[3 * vt[4] + j] +
-                                                   eta_x  * v[3 * vt[5] + j]) +
-                                   eta_y  * ((1. - eta_x) * v[3 * vt[6] + j] +
-                                                   eta_x  * v[3 * vt[7] + j]))
-  #endif
-            );
-          /* *INDENT-ON* */
 
-          float_data[3 * zz + j] = (P4EST_VTK_FLOAT_TYPE) xyz[j];
-        }
+      /* calculate vertex coordinates */
+      neta_x = intsize * nin->x;
+      neta_y = intsize * nin->y;
+#ifdef P4_TO_P8
+      neta_z = intsize * nin->z;
+#else
+      neta_z = 0.;
+#endif
+      for (nj = 0; nj < 3; ++nj) {
+        /* *INDENT-OFF* */
+        float_data[3 * nz + nj] = (P4EST_VTK_FLOAT_TYPE)
+          ((1. - neta_z) * ((1. - neta_y) * ((1. - neta_x) * v[3 * nvt[0] + nj] +
+                                                   neta_x  * v[3 * nvt[1] + nj]) +
+                                  neta_y  * ((1. - neta_x) * v[3 * nvt[2] + nj] +
+                                                   neta_x  * v[3 * nvt[3] + nj]))
+#ifdef P4_TO_P8
+           +     neta_z  * ((1. - neta_y) * ((1. - neta_x) * v[3 * nvt[4] + nj] +
+                                                   neta_x  * v[3 * nvt[5] + nj]) +
+                                  neta_y  * ((1. - neta_x) * v[3 * nvt[6] + nj] +
+                                                   neta_x  * v[3 * nvt[7] + nj]))
+#endif
+          );
+        /* *INDENT-ON* */
       }
     }
   }
+  P4EST_FREE (geom_abc);
+  P4EST_FREE (geom_xyz);
 
 #ifdef P4EST_VTK_ASCII
   for (il = 0; il < Npoints; ++il) {
@@ -625,13 +1425,14 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
              wx, wy, wz);
   }
 #else
-  fprintf (cont->vtufile, "          ");
-  /* TODO: Don't allocate the full size of the array, only allocate
-   * the chunk that will be passed to zlib and do this a chunk
-   * at a time.
-   */
-  retval = p4est_vtk_write_binary (cont->vtufile, (char *) float_data,
-                                   sizeof (*float_data) * 3 * Npoints);
+  if (!cont->streaming) {
+    fprintf (cont->vtufile, "          ");
+    retval = p4est_vtk_write_array (cont, (char *) float_data,
+                                    sizeof (*float_data) * 3 * Npoints);
+  }
+  else {
+    retval = p4est_vtk_stream_end (&vs) || retval;
+  }
   fprintf (cont->vtufile, "\n");
   if (retval) {
     P4EST_LERROR (P4EST_STRING "_vtk: Error encoding points\n");
@@ -649,7 +1450,7 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
   /* write connectivity data */
   fprintf (cont->vtufile,
            "        <DataArray type=\"%s\" Name=\"connectivity\""
-           " format=\"%s\">\n", P4EST_VTK_LOCIDX, P4EST_VTK_FORMAT_STRING);
+           "%s>\n", P4EST_VTK_LOCIDX, p4est_vtk_format_attr (cont));
 #ifdef P4EST_VTK_ASCII
   for (sk = 0, il = 0; il < Ncells; ++il) {
     fprintf (cont->vtufile, "         ");
@@ -662,18 +1463,47 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
 #else
   fprintf (cont->vtufile, "          ");
   if (nodes == NULL) {
-    locidx_data = P4EST_ALLOC (p4est_locidx_t, Ncorners);
-    for (il = 0; il < Ncorners; ++il) {
-      locidx_data[il] = il;
+    /* in collective mode the point indices are global to the one piece */
+    const p4est_locidx_t corner_base = !cont->collective ? 0 :
+      (p4est_locidx_t) (P4EST_CHILDREN *
+                        cont->p4est->global_first_quadrant[mpirank]);
+
+    if (!cont->streaming) {
+      locidx_data = P4EST_ALLOC (p4est_locidx_t, Ncorners);
+      for (il = 0; il < Ncorners; ++il) {
+        locidx_data[il] = corner_base + il;
+      }
+      retval =
+        p4est_vtk_write_array (cont, (char *) locidx_data,
+                               sizeof (p4est_locidx_t) * Ncorners);
+      P4EST_FREE (locidx_data);
+    }
+    else {
+      /* generate the synthetic indices in fixed batches */
+      const p4est_locidx_t batch = 1 << 14;
+      p4est_locidx_t      len;
+
+      retval = p4est_vtk_stream_begin (cont, &vs, sizeof (p4est_locidx_t) *
+                                       (size_t) Ncorners);
+      if (!retval) {
+        locidx_data = P4EST_ALLOC (p4est_locidx_t, batch);
+        for (il = 0; il < Ncorners && !retval; il += len) {
+          len = SC_MIN (batch, Ncorners - il);
+          for (sk = 0; sk < len; ++sk) {
+            locidx_data[sk] = corner_base + il + sk;
+          }
+          retval = p4est_vtk_stream_chunk (&vs, (const char *) locidx_data,
+                                           sizeof (p4est_locidx_t) *
+                                           (size_t) len);
+        }
+        P4EST_FREE (locidx_data);
+        retval = p4est_vtk_stream_end (&vs) || retval;
+      }
     }
-    retval =
-      p4est_vtk_write_binary (cont->vtufile, (char *) locidx_data,
-                              sizeof (p4est_locidx_t) * Ncorners);
-    P4EST_FREE (locidx_data);
   }
   else {
     retval =
-      p4est_vtk_write_binary (cont->vtufile, (char *) nodes->local_nodes,
+      p4est_vtk_write_array (cont, (char *) nodes->local_nodes,
                               sizeof (p4est_locidx_t) * Ncorners);
   }
   fprintf (cont->vtufile, "\n");
@@ -687,7 +1517,7 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
 
   /* write offset data */
   fprintf (cont->vtufile, "        <DataArray type=\"%s\" Name=\"offsets\""
-           " format=\"%s\">\n", P4EST_VTK_LOCIDX, P4EST_VTK_FORMAT_STRING);
+           "%s>\n", P4EST_VTK_LOCIDX, p4est_vtk_format_attr (cont));
 #ifdef P4EST_VTK_ASCII
   fprintf (cont->vtufile, "         ");
   for (il = 1, sk = 1; il <= Ncells; ++il, ++sk) {
@@ -697,17 +1527,47 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
   }
   fprintf (cont->vtufile, "\n");
 #else
-  locidx_data = P4EST_ALLOC (p4est_locidx_t, Ncells);
-  for (il = 1; il <= Ncells; ++il)
-    locidx_data[il - 1] = P4EST_CHILDREN * il;  /* same type */
+  {
+    /* in collective mode the cumulative counts continue across ranks */
+    const p4est_locidx_t cell_base = !cont->collective ? 0 :
+      (p4est_locidx_t) cont->p4est->global_first_quadrant[mpirank];
 
-  fprintf (cont->vtufile, "          ");
-  retval = p4est_vtk_write_binary (cont->vtufile, (char *) locidx_data,
-                                   sizeof (p4est_locidx_t) * Ncells);
+    fprintf (cont->vtufile, "          ");
+    if (!cont->streaming) {
+      locidx_data = P4EST_ALLOC (p4est_locidx_t, Ncells);
+      for (il = 1; il <= Ncells; ++il)
+        locidx_data[il - 1] = P4EST_CHILDREN * (cell_base + il);  /* same type */
+      retval = p4est_vtk_write_array (cont, (char *) locidx_data,
+                                      sizeof (p4est_locidx_t) * Ncells);
+      P4EST_FREE (locidx_data);
+    }
+    else {
+      const p4est_locidx_t batch = 1 << 14;
+      p4est_locidx_t      len;
+
+      retval = p4est_vtk_stream_begin (cont, &vs, sizeof (p4est_locidx_t) *
+                                       (size_t) Ncells);
+      if (!retval) {
+        locidx_data = P4EST_ALLOC (p4est_locidx_t, batch);
+        for (il = 0; il < Ncells && !retval; il += len) {
+          len = SC_MIN (batch, Ncells - il);
+          for (sk = 0; sk < len; ++sk) {
+            /* *INDENT-OFF* */
+            locidx_data[sk] =
+              P4EST_CHILDREN * (cell_base + il + sk + 1);  /* same type */
+            /* *INDENT-ON* */
+          }
+          retval = p4est_vtk_stream_chunk (&vs, (const char *) locidx_data,
+                                           sizeof (p4est_locidx_t) *
+                                           (size_t) len);
+        }
+        P4EST_FREE (locidx_data);
+        retval = p4est_vtk_stream_end (&vs) || retval;
+      }
+    }
+  }
   fprintf (cont->vtufile, "\n");
 
-  P4EST_FREE (locidx_data);
-
   if (retval) {
     P4EST_LERROR (P4EST_STRING "_vtk: Error encoding offsets\n");
     p4est_vtk_context_destroy (cont);
@@ -718,7 +1578,7 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
 
   /* write type data */
   fprintf (cont->vtufile, "        <DataArray type=\"UInt8\" Name=\"types\""
-           " format=\"%s\">\n", P4EST_VTK_FORMAT_STRING);
+           "%s>\n", p4est_vtk_format_attr (cont));
 #ifdef P4EST_VTK_ASCII
   fprintf (cont->vtufile, "         ");
   for (il = 0, sk = 1; il < Ncells; ++il, ++sk) {
@@ -728,17 +1588,36 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
   }
   fprintf (cont->vtufile, "\n");
 #else
-  uint8_data = P4EST_ALLOC (uint8_t, Ncells);
-  for (il = 0; il < Ncells; ++il)
-    uint8_data[il] = P4EST_VTK_CELL_TYPE;
-
   fprintf (cont->vtufile, "          ");
-  retval = p4est_vtk_write_binary (cont->vtufile, (char *) uint8_data,
-                                   sizeof (*uint8_data) * Ncells);
+  if (!cont->streaming) {
+    uint8_data = P4EST_ALLOC (uint8_t, Ncells);
+    for (il = 0; il < Ncells; ++il)
+      uint8_data[il] = P4EST_VTK_CELL_TYPE;
+    retval = p4est_vtk_write_array (cont, (char *) uint8_data,
+                                    sizeof (*uint8_data) * Ncells);
+    P4EST_FREE (uint8_data);
+  }
+  else {
+    const p4est_locidx_t batch = 1 << 14;
+    p4est_locidx_t      len;
+
+    retval = p4est_vtk_stream_begin (cont, &vs, (size_t) Ncells);
+    if (!retval) {
+      /* one constant batch serves all chunks */
+      uint8_data = P4EST_ALLOC (uint8_t, SC_MIN (batch, Ncells));
+      memset (uint8_data, P4EST_VTK_CELL_TYPE,
+              (size_t) SC_MIN (batch, Ncells));
+      for (il = 0; il < Ncells && !retval; il += len) {
+        len = SC_MIN (batch, Ncells - il);
+        retval = p4est_vtk_stream_chunk (&vs, (const char *) uint8_data,
+                                         (size_t) len);
+      }
+      P4EST_FREE (uint8_data);
+      retval = p4est_vtk_stream_end (&vs) || retval;
+    }
+  }
   fprintf (cont->vtufile, "\n");
 
-  P4EST_FREE (uint8_data);
-
   if (retval) {
     P4EST_LERROR (P4EST_STRING "_vtk: Error encoding types\n");
     p4est_vtk_context_destroy (cont);
@@ -755,7 +1634,7 @@ p4est_vtk_write_header (p4est_vtk_context_t * cont)
   }
 
   /* Only have the root write to the parallel vtk file */
-  if (mpirank == 0) {
+  if (mpirank == 0 && !cont->collective) {
     snprintf (cont->pvtufilename, BUFSIZ, "%s.pvtu", filename);
 
     cont->pvtufile = fopen (cont->pvtufilename, "wb");
@@ -959,7 +1838,7 @@ p4est_vtk_write_point_datav (p4est_vtk_context_t * cont,
   }
 
   /* Only have the root write to the parallel vtk file */
-  if (mpirank == 0) {
+  if (mpirank == 0 && !cont->collective) {
     fprintf (cont->pvtufile, "    <PPointData>\n");
 
     all = 0;
@@ -1158,7 +2037,7 @@ p4est_vtk_write_cell_datav (p4est_vtk_context_t * cont,
 
   if (write_tree) {
     fprintf (cont->vtufile, "        <DataArray type=\"%s\" Name=\"treeid\""
-             " format=\"%s\">\n", P4EST_VTK_LOCIDX, P4EST_VTK_FORMAT_STRING);
+             "%s>\n", P4EST_VTK_LOCIDX, p4est_vtk_format_attr (cont));
 #ifdef P4EST_VTK_ASCII
     fprintf (cont->vtufile, "         ");
     for (il = 0, sk = 1, jt = first_local_tree; jt <= last_local_tree; ++jt) {
@@ -1180,7 +2059,7 @@ p4est_vtk_write_cell_datav (p4est_vtk_context_t * cont,
       }
     }
     fprintf (cont->vtufile, "          ");
-    retval = p4est_vtk_write_binary (cont->vtufile, (char *) locidx_data,
+    retval = p4est_vtk_write_array (cont, (char *) locidx_data,
                                      sizeof (*locidx_data) * Ncells);
     fprintf (cont->vtufile, "\n");
     if (retval) {
@@ -1201,7 +2080,7 @@ p4est_vtk_write_cell_datav (p4est_vtk_context_t * cont,
 
   if (write_level) {
     fprintf (cont->vtufile, "        <DataArray type=\"%s\" Name=\"level\""
-             " format=\"%s\">\n", "UInt8", P4EST_VTK_FORMAT_STRING);
+             "%s>\n", "UInt8", p4est_vtk_format_attr (cont));
 #ifdef P4EST_VTK_ASCII
     fprintf (cont->vtufile, "         ");
     for (il = 0, sk = 1, jt = first_local_tree; jt <= last_local_tree; ++jt) {
@@ -1228,7 +2107,7 @@ p4est_vtk_write_cell_datav (p4est_vtk_context_t * cont,
     }
 
     fprintf (cont->vtufile, "          ");
-    retval = p4est_vtk_write_binary (cont->vtufile, (char *) uint8_data,
+    retval = p4est_vtk_write_array (cont, (char *) uint8_data,
                                      sizeof (*uint8_data) * Ncells);
     fprintf (cont->vtufile, "\n");
 
@@ -1253,7 +2132,7 @@ p4est_vtk_write_cell_datav (p4est_vtk_context_t * cont,
       wrap_rank > 0 ? mpirank % wrap_rank : mpirank;
 
     fprintf (cont->vtufile, "        <DataArray type=\"%s\" Name=\"mpirank\""
-             " format=\"%s\">\n", P4EST_VTK_LOCIDX, P4EST_VTK_FORMAT_STRING);
+             "%s>\n", P4EST_VTK_LOCIDX, p4est_vtk_format_attr (cont));
 #ifdef P4EST_VTK_ASCII
     fprintf (cont->vtufile, "         ");
     for (il = 0, sk = 1; il < Ncells; ++il, ++sk) {
@@ -1267,7 +2146,7 @@ p4est_vtk_write_cell_datav (p4est_vtk_context_t * cont,
       locidx_data[il] = (p4est_locidx_t) wrapped_rank;
 
     fprintf (cont->vtufile, "          ");
-    retval = p4est_vtk_write_binary (cont->vtufile, (char *) locidx_data,
+    retval = p4est_vtk_write_array (cont, (char *) locidx_data,
                                      sizeof (*locidx_data) * Ncells);
     fprintf (cont->vtufile, "\n");
 
@@ -1325,7 +2204,7 @@ p4est_vtk_write_cell_datav (p4est_vtk_context_t * cont,
   }
 
   /* Only have the root write to the parallel vtk file */
-  if (mpirank == 0) {
+  if (mpirank == 0 && !cont->collective) {
     fprintf (cont->pvtufile, "    <PCellData Scalars=\"%s\">\n",
              vtkCellDataString);
 
@@ -1430,8 +2309,8 @@ p4est_vtk_write_point_scalar (p4est_vtk_context_t * cont,
 
   /* write point data */
   fprintf (cont->vtufile, "        <DataArray type=\"%s\" Name=\"%s\""
-           " format=\"%s\">\n",
-           P4EST_VTK_FLOAT_NAME, scalar_name, P4EST_VTK_FORMAT_STRING);
+           "%s>\n",
+           P4EST_VTK_FLOAT_NAME, scalar_name, p4est_vtk_format_attr (cont));
 
 #ifdef P4EST_VTK_ASCII
   for (il = 0; il < Npoints; ++il) {
@@ -1460,7 +2339,7 @@ p4est_vtk_write_point_scalar (p4est_vtk_context_t * cont,
    * the chunk that will be passed to zlib and do this a chunk
    * at a time.
    */
-  retval = p4est_vtk_write_binary (cont->vtufile, (char *) float_data,
+  retval = p4est_vtk_write_array (cont, (char *) float_data,
                                    sizeof (*float_data) * Npoints);
   fprintf (cont->vtufile, "\n");
 
@@ -1507,8 +2386,8 @@ p4est_vtk_write_cell_scalar (p4est_vtk_context_t * cont,
 
   /* Write cell data. */
   fprintf (cont->vtufile, "        <DataArray type=\"%s\" Name=\"%s\""
-           " format=\"%s\">\n",
-           P4EST_VTK_FLOAT_NAME, scalar_name, P4EST_VTK_FORMAT_STRING);
+           "%s>\n",
+           P4EST_VTK_FLOAT_NAME, scalar_name, p4est_vtk_format_attr (cont));
 
 #ifdef P4EST_VTK_ASCII
   for (il = 0; il < Ncells; ++il) {
@@ -1532,7 +2411,7 @@ p4est_vtk_write_cell_scalar (p4est_vtk_context_t * cont,
    * the chunk that will be passed to zlib and do this a chunk
    * at a time.
    */
-  retval = p4est_vtk_write_binary (cont->vtufile, (char *) float_data,
+  retval = p4est_vtk_write_array (cont, (char *) float_data,
                                    sizeof (*float_data) * Ncells);
   fprintf (cont->vtufile, "\n");
 
@@ -1571,8 +2450,8 @@ p4est_vtk_write_cell_vector (p4est_vtk_context_t * cont,
 
   /* Write cell data. */
   fprintf (cont->vtufile, "        <DataArray type=\"%s\" Name=\"%s\""
-           " NumberOfComponents=\"3\" format=\"%s\">\n",
-           P4EST_VTK_FLOAT_NAME, vector_name, P4EST_VTK_FORMAT_STRING);
+           " NumberOfComponents=\"3\"%s>\n",
+           P4EST_VTK_FLOAT_NAME, vector_name, p4est_vtk_format_attr (cont));
 
 #ifdef P4EST_VTK_ASCII
   for (il = 0; il < Nvcell; il += 3) {
@@ -1603,7 +2482,7 @@ p4est_vtk_write_cell_vector (p4est_vtk_context_t * cont,
    * the chunk that will be passed to zlib and do this a chunk
    * at a time.
    */
-  retval = p4est_vtk_write_binary (cont->vtufile, (char *) float_data,
+  retval = p4est_vtk_write_array (cont, (char *) float_data,
                                    sizeof (*float_data) * Nvcell);
   fprintf (cont->vtufile, "\n");
 
@@ -1637,6 +2516,108 @@ p4est_vtk_write_footer (p4est_vtk_context_t * cont)
 
   fprintf (cont->vtufile, "    </Piece>\n");
   fprintf (cont->vtufile, "  </UnstructuredGrid>\n");
+
+  /* flush all deferred data blocks into the appended data section */
+  if (cont->appended && cont->app_blocks != NULL && !cont->collective) {
+    size_t              zz;
+    p4est_vtk_app_block_t *block;
+
+    fprintf (cont->vtufile, "  <AppendedData encoding=\"raw\">\n_");
+    for (zz = 0; zz < cont->app_blocks->elem_count; zz++) {
+      block = (p4est_vtk_app_block_t *)
+        sc_array_index (cont->app_blocks, zz);
+      if (fwrite (block->data, 1, block->byte_length, cont->vtufile) !=
+          block->byte_length) {
+        P4EST_LERROR (P4EST_STRING "_vtk: Error writing appended data\n");
+        p4est_vtk_context_destroy (cont);
+        return -1;
+      }
+    }
+    fprintf (cont->vtufile, "\n  </AppendedData>\n");
+  }
+
+#ifdef P4EST_ENABLE_MPIIO
+  if (cont->collective) {
+    /* the XML text is identical on every rank; the root writes it once
+     * and all ranks store their data blocks at offsets derived from
+     * global_first_quadrant with one collective call per array */
+    const char          tail[] = "\n  </AppendedData>\n</VTKFile>\n";
+    long                head_length;
+    size_t              zz, block_start;
+    p4est_vtk_app_block_t *block;
+    MPI_File            mpifile;
+    MPI_Offset          mpiofs;
+    int                 mpiret;
+
+    fprintf (cont->vtufile, "  <AppendedData encoding=\"raw\">\n_");
+    if (fflush (cont->vtufile) || (head_length = ftell (cont->vtufile)) < 0) {
+      P4EST_LERROR (P4EST_STRING "_vtk: Error sizing collective header\n");
+      p4est_vtk_context_destroy (cont);
+      return -1;
+    }
+
+    mpiret = MPI_File_open (cont->p4est->mpicomm, cont->vtufilename,
+                            MPI_MODE_WRONLY | MPI_MODE_CREATE |
+                            MPI_MODE_UNIQUE_OPEN, MPI_INFO_NULL, &mpifile);
+    SC_CHECK_MPI (mpiret);
+    mpiret = MPI_File_set_size (mpifile, (MPI_Offset) 0);
+    SC_CHECK_MPI (mpiret);
+
+    if (procRank == 0) {
+      char               *head = P4EST_ALLOC (char, head_length);
+
+      rewind (cont->vtufile);
+      if (fread (head, 1, (size_t) head_length, cont->vtufile) !=
+          (size_t) head_length) {
+        P4EST_LERROR (P4EST_STRING "_vtk: Error reading back header\n");
+        P4EST_FREE (head);
+        p4est_vtk_context_destroy (cont);
+        return -1;
+      }
+      mpiret = MPI_File_write_at (mpifile, (MPI_Offset) 0, head,
+                                  (int) head_length, MPI_BYTE,
+                                  MPI_STATUS_IGNORE);
+      SC_CHECK_MPI (mpiret);
+      P4EST_FREE (head);
+    }
+
+    block_start = (size_t) head_length;
+    for (zz = 0; cont->app_blocks != NULL &&
+         zz < cont->app_blocks->elem_count; zz++) {
+      block = (p4est_vtk_app_block_t *)
+        sc_array_index (cont->app_blocks, zz);
+      if (procRank == 0) {
+        uint32_t            raw_size =
+          (uint32_t) (block->global_length - sizeof (uint32_t));
+
+        mpiret = MPI_File_write_at (mpifile, (MPI_Offset) block_start,
+                                    &raw_size, (int) sizeof (uint32_t),
+                                    MPI_BYTE, MPI_STATUS_IGNORE);
+        SC_CHECK_MPI (mpiret);
+      }
+      mpiofs = (MPI_Offset) (block_start + block->local_offset);
+      mpiret = MPI_File_write_at_all (mpifile, mpiofs, block->data,
+                                      (int) block->byte_length, MPI_BYTE,
+                                      MPI_STATUS_IGNORE);
+      SC_CHECK_MPI (mpiret);
+      block_start += block->global_length;
+    }
+
+    if (procRank == 0) {
+      mpiret = MPI_File_write_at (mpifile, (MPI_Offset) block_start,
+                                  (void *) tail,
+                                  (int) (sizeof (tail) - 1), MPI_BYTE,
+                                  MPI_STATUS_IGNORE);
+      SC_CHECK_MPI (mpiret);
+    }
+    mpiret = MPI_File_close (&mpifile);
+    SC_CHECK_MPI (mpiret);
+
+    p4est_vtk_context_destroy (cont);
+    return 0;
+  }
+#endif /* P4EST_ENABLE_MPIIO */
+
   fprintf (cont->vtufile, "</VTKFile>\n");
 
   if (ferror (cont->vtufile)) {
@@ -1647,10 +2628,23 @@ p4est_vtk_write_footer (p4est_vtk_context_t * cont)
 
   /* Only have the root write to the parallel vtk file */
   if (procRank == 0) {
-    fprintf (cont->visitfile, "!NBLOCKS %d\n", numProcs);
+    int                 nblocks = numProcs;
+    const p4est_gloidx_t *gfq = cont->p4est->global_first_quadrant;
+
+    if (cont->full_p4est != NULL) {
+      /* with a selection some pieces may be empty; list only the rest */
+      nblocks = 0;
+      for (p = 0; p < numProcs; ++p) {
+        nblocks += (gfq[p + 1] > gfq[p]);
+      }
+    }
+    fprintf (cont->visitfile, "!NBLOCKS %d\n", nblocks);
 
     /* Write data about the parallel pieces into both files */
     for (p = 0; p < numProcs; ++p) {
+      if (cont->full_p4est != NULL && gfq[p + 1] == gfq[p]) {
+        continue;
+      }
       fprintf (cont->pvtufile,
                "    <Piece Source=\"%s_%04d.vtu\"/>\n", cont->filename, p);
       fprintf (cont->visitfile, "%s_%04d.vtu\n", cont->filename, p);
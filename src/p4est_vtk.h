@@ -119,6 +119,106 @@ void                p4est_vtk_context_set_scale (p4est_vtk_context_t * cont,
 void                p4est_vtk_context_set_continuous (p4est_vtk_context_t *
                                                       cont, int continuous);
 
+/** Write data arrays into VTK's raw appended data section.
+ *
+ * In this mode each DataArray element only records a byte offset and the
+ * encoded data blocks are written verbatim after the grid description,
+ * avoiding the 33% size overhead of inline base64 encoding.  When zlib
+ * compression is configured, the independent blocks of each array are
+ * compressed across threads under \c --enable-openmp.  The option is
+ * ignored when p4est is compiled for ascii VTK output.
+ *
+ * \param [in,out] cont     The VTK context to modify.
+ * \param [in] appended     Boolean: write raw appended data blocks.
+ */
+void                p4est_vtk_context_set_appended (p4est_vtk_context_t *
+                                                    cont, int appended);
+
+/** Write one shared VTU file collectively with MPI I/O.
+ *
+ * Instead of one .vtu file per process plus a .pvtu index, all processes
+ * write their cells into a single file, each at an offset derived from
+ * global_first_quadrant using MPI_File_write_at_all.  This avoids the
+ * metadata storm of creating many files on parallel file systems.  The
+ * mode implies the raw appended data section, disables compression, and
+ * always duplicates shared quadrant corners.  All write_* calls keep
+ * their usual semantics.  The option is ignored unless p4est is
+ * configured with MPI I/O and binary VTK data.
+ *
+ * \param [in,out] cont     The VTK context to modify.
+ * \param [in] collective   Boolean: write one shared file collectively.
+ */
+void                p4est_vtk_context_set_collective (p4est_vtk_context_t *
+                                                      cont, int collective);
+
+/** Write the grid description in per-tree chunks of bounded memory.
+ *
+ * By default the header materializes the full coordinate and
+ * connectivity arrays of the local forest before encoding them, which
+ * makes VTK output the peak-memory moment of many runs.  In streaming
+ * mode these arrays are generated and written tree by tree, bounding
+ * the writer's scratch memory by the largest local tree.  The mode
+ * always duplicates shared quadrant corners, since a deduplicated
+ * node list cannot be built one tree at a time, and it is ignored
+ * for ascii VTK output and for the appended data section, which
+ * defers all blocks by design.
+ *
+ * \param [in,out] cont     The VTK context to modify.
+ * \param [in] streaming    Boolean: write the header in per-tree chunks.
+ */
+void                p4est_vtk_context_set_streaming (p4est_vtk_context_t *
+                                                     cont, int streaming);
+
+/** Callback to decide whether a quadrant appears in the VTK output.
+ * \param [in] p4est        The forest passed to the context.
+ * \param [in] which_tree   The tree containing \a quadrant.
+ * \param [in] quadrant     The quadrant under consideration.
+ * \param [in,out] user     The pointer registered with the predicate.
+ * \return                  True to include the quadrant in the output.
+ */
+typedef int         (*p4est_vtk_select_t) (p4est_t * p4est,
+                                           p4est_topidx_t which_tree,
+                                           p4est_quadrant_t * quadrant,
+                                           void *user);
+
+/** Restrict the output to the quadrants chosen by a predicate.
+ * The point and cell arrays are built only for the selected quadrants,
+ * so a small region can be dumped at full rate without whole-mesh I/O.
+ * Data arrays passed to the write functions then cover exactly the
+ * selected quadrants in forest order, and the parallel meta files list
+ * only the pieces of processes that selected anything.  A selection
+ * always writes each cell's corners separately as if the scale were
+ * smaller than one.
+ * \param [in,out] cont      The context is modified.
+ *                           It must not yet be used for writing.
+ * \param [in] select_fn     Called once per local quadrant during
+ *                           \ref p4est_vtk_write_header; NULL reverts
+ *                           to writing every quadrant.
+ * \param [in,out] user      Arbitrary pointer passed to \a select_fn.
+ */
+void                p4est_vtk_context_set_select (p4est_vtk_context_t * cont,
+                                                  p4est_vtk_select_t
+                                                  select_fn, void *user);
+
+/** Restrict the output to a set of Morton index ranges.
+ * Behaves like \ref p4est_vtk_context_set_select with a built-in
+ * predicate that keeps every quadrant overlapping one of the ranges.
+ * A predicate registered separately takes precedence over the ranges.
+ * \param [in,out] cont      The context is modified.
+ *                           It must not yet be used for writing.
+ * \param [in] which_tree    Tree the ranges refer to, or -1 to apply
+ *                           them within every local tree.
+ * \param [in] ranges        Sorted disjoint ranges of finest-level
+ *                           Morton indices as produced by
+ *                           \ref p4est_morton_range_from_quadrants;
+ *                           an array of p4est_morton_range_t that must
+ *                           stay alive until the header is written.
+ *                           NULL reverts to writing every quadrant.
+ */
+void                p4est_vtk_context_set_ranges (p4est_vtk_context_t * cont,
+                                                  p4est_topidx_t which_tree,
+                                                  sc_array_t * ranges);
+
 /** Cleanly destroy a \ref p4est_vtk_context_t structure.
  *
  * This function closes all the file pointers and frees the context.
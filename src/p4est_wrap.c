@@ -171,6 +171,32 @@ replace_on_balance (p4est_t * p4est, p4est_topidx_t which_tree,
   }
 }
 
+/** Keep one retired mesh around so its allocations seed the next rebuild. */
+static void
+p4est_wrap_mesh_retire (p4est_wrap_t * pp, p4est_mesh_t * mesh)
+{
+  if (pp->mesh_pool == NULL) {
+    pp->mesh_pool = mesh;
+  }
+  else {
+    p4est_mesh_destroy (mesh);
+  }
+}
+
+/** Build a mesh, recycling the pooled allocations when available. */
+static p4est_mesh_t *
+p4est_wrap_mesh_build (p4est_wrap_t * pp, p4est_ghost_t * ghost)
+{
+  p4est_mesh_t       *mesh;
+
+  mesh = p4est_mesh_reuse_ext (pp->p4est, ghost, 1, 1, pp->btype,
+                               pp->mesh_pool);
+  pp->mesh_pool = NULL;
+  pp->mesh_revision = p4est_revision (pp->p4est);
+
+  return mesh;
+}
+
 p4est_wrap_t       *
 p4est_wrap_new_conn (sc_MPI_Comm mpicomm, p4est_connectivity_t * conn,
                      int initial_level)
@@ -208,7 +234,7 @@ p4est_wrap_new_p4est (p4est_t * p4est, int hollow, p4est_connect_type_t btype,
   if (!pp->hollow) {
     pp->flags = P4EST_ALLOC_ZERO (uint8_t, pp->p4est->local_num_quadrants);
     pp->ghost = p4est_ghost_new (pp->p4est, pp->btype);
-    pp->mesh = p4est_mesh_new_ext (pp->p4est, pp->ghost, 1, 1, pp->btype);
+    pp->mesh = p4est_wrap_mesh_build (pp, pp->ghost);
   }
 
   pp->p4est->user_pointer = pp;
@@ -400,9 +426,13 @@ p4est_wrap_destroy (p4est_wrap_t * pp)
     p4est_mesh_destroy (pp->mesh);
     p4est_ghost_destroy (pp->ghost);
   }
+  if (pp->mesh_pool != NULL) {
+    p4est_mesh_destroy (pp->mesh_pool);
+  }
 
   P4EST_FREE (pp->flags);
   P4EST_FREE (pp->temp_flags);
+  P4EST_FREE (pp->subset_trees);
 
   p4est_destroy (pp->p4est);
 
@@ -451,7 +481,7 @@ p4est_wrap_set_hollow (p4est_wrap_t * pp, int hollow)
     /* Allocate the ghost, mesh, and flag members */
     pp->flags = P4EST_ALLOC_ZERO (uint8_t, pp->p4est->local_num_quadrants);
     pp->ghost = p4est_ghost_new (pp->p4est, pp->btype);
-    pp->mesh = p4est_mesh_new_ext (pp->p4est, pp->ghost, 1, 1, pp->btype);
+    pp->mesh = p4est_wrap_mesh_build (pp, pp->ghost);
   }
   else {
     /* Free and nullify the ghost, mesh, and flag members */
@@ -461,6 +491,10 @@ p4est_wrap_set_hollow (p4est_wrap_t * pp, int hollow)
     pp->ghost = NULL;
     pp->mesh = NULL;
     pp->flags = NULL;
+    if (pp->mesh_pool != NULL) {
+      p4est_mesh_destroy (pp->mesh_pool);
+      pp->mesh_pool = NULL;
+    }
   }
   pp->num_refine_flags = pp->inside_counter = pp->num_replaced = 0;
   pp->hollow = hollow;
@@ -573,7 +607,7 @@ p4est_wrap_adapt (p4est_wrap_t * pp)
 #ifdef P4EST_ENABLE_DEBUG
   p4est_locidx_t      jl, local_num;
 #endif
-  p4est_gloidx_t      global_num;
+  long                rev;
   p4est_t            *p4est = pp->p4est;
 
   P4EST_ASSERT (!pp->hollow);
@@ -594,30 +628,33 @@ p4est_wrap_adapt (p4est_wrap_t * pp)
                                      (P4EST_CHILDREN - 1) *
                                      pp->num_refine_flags);
 
+  /* The revision counter tells us whether a rebuild is due at all */
+  rev = p4est_revision (p4est);
+  P4EST_ASSERT (rev == pp->mesh_revision);
+
   /* Execute refinement */
   pp->inside_counter = pp->num_replaced = 0;
 #ifdef P4EST_ENABLE_DEBUG
   local_num = p4est->local_num_quadrants;
 #endif
-  global_num = p4est->global_num_quadrants;
   p4est_refine_ext (p4est, 0, -1, refine_callback, NULL, replace_on_refine);
   P4EST_ASSERT (pp->inside_counter == local_num);
   P4EST_ASSERT (p4est->local_num_quadrants - local_num ==
                 pp->num_replaced * (P4EST_CHILDREN - 1));
-  changed = global_num != p4est->global_num_quadrants;
 
   /* Execute coarsening */
   pp->inside_counter = pp->num_replaced = 0;
 #ifdef P4EST_ENABLE_DEBUG
   local_num = p4est->local_num_quadrants;
 #endif
-  global_num = p4est->global_num_quadrants;
   p4est_coarsen_ext (p4est, 0, 1, coarsen_callback, NULL,
                      pp->coarsen_delay ? replace_on_coarsen : pp->replace_fn);
   P4EST_ASSERT (pp->inside_counter == local_num);
   P4EST_ASSERT (local_num - p4est->local_num_quadrants ==
                 pp->num_replaced * (P4EST_CHILDREN - 1));
-  changed = changed || global_num != p4est->global_num_quadrants;
+
+  /* Both adaptation phases bump the revision whenever they act */
+  changed = p4est_revision (p4est) != rev;
 
   /* Free temporary flags */
   P4EST_FREE (pp->temp_flags);
@@ -631,7 +668,7 @@ p4est_wrap_adapt (p4est_wrap_t * pp)
     pp->flags = P4EST_ALLOC_ZERO (uint8_t, p4est->local_num_quadrants);
 
     pp->ghost_aux = p4est_ghost_new (p4est, pp->btype);
-    pp->mesh_aux = p4est_mesh_new_ext (p4est, pp->ghost_aux, 1, 1, pp->btype);
+    pp->mesh_aux = p4est_wrap_mesh_build (pp, pp->ghost_aux);
     pp->match_aux = 1;
   }
 #ifdef P4EST_ENABLE_DEBUG
@@ -711,6 +748,7 @@ p4est_wrap_partition (p4est_wrap_t * pp, int weight_exponent,
                       p4est_locidx_t * unchanged_old_first)
 {
   int                 changed;
+  long                rev;
   p4est_gloidx_t      pre_me, pre_next;
   p4est_gloidx_t      post_me, post_next;
 
@@ -722,7 +760,8 @@ p4est_wrap_partition (p4est_wrap_t * pp, int weight_exponent,
   P4EST_ASSERT (pp->mesh_aux != NULL);
   P4EST_ASSERT (pp->match_aux == 1);
 
-  p4est_mesh_destroy (pp->mesh);
+  /* the stale mesh's allocations seed a possible rebuild below */
+  p4est_wrap_mesh_retire (pp, pp->mesh);
   p4est_ghost_destroy (pp->ghost);
   pp->match_aux = 0;
 
@@ -745,16 +784,24 @@ p4est_wrap_partition (p4est_wrap_t * pp, int weight_exponent,
   /* We need to lift the restriction on 64 bits for the global weight sum */
   P4EST_ASSERT (weight_exponent == 0 || weight_exponent == 1);
   pp->weight_exponent = weight_exponent;
-  changed =
-    p4est_partition_ext (pp->p4est, 1,
-                         weight_exponent ? partition_weight : NULL) > 0;
+  rev = p4est_revision (pp->p4est);
+  p4est_partition_ext (pp->p4est, 1,
+                       weight_exponent ? partition_weight : NULL);
+
+  /* partition bumps the revision exactly when quadrants have moved */
+  changed = p4est_revision (pp->p4est) != rev;
 
   if (changed) {
     P4EST_FREE (pp->flags);
     pp->flags = P4EST_ALLOC_ZERO (uint8_t, pp->p4est->local_num_quadrants);
 
+    /* tree ownership may have moved; a registered subset is now stale */
+    P4EST_FREE (pp->subset_trees);
+    pp->subset_trees = NULL;
+    pp->num_subset_trees = 0;
+
     pp->ghost = p4est_ghost_new (pp->p4est, pp->btype);
-    pp->mesh = p4est_mesh_new_ext (pp->p4est, pp->ghost, 1, 1, pp->btype);
+    pp->mesh = p4est_wrap_mesh_build (pp, pp->ghost);
 
     /* Query the window onto global quadrant sequence after partition */
     if (unchanged_first != NULL || unchanged_length != NULL ||
@@ -793,12 +840,42 @@ p4est_wrap_complete (p4est_wrap_t * pp)
   P4EST_ASSERT (pp->mesh_aux != NULL);
   P4EST_ASSERT (pp->match_aux == 0);
 
-  p4est_mesh_destroy (pp->mesh_aux);
+  p4est_wrap_mesh_retire (pp, pp->mesh_aux);
   p4est_ghost_destroy (pp->ghost_aux);
   pp->ghost_aux = NULL;
   pp->mesh_aux = NULL;
 }
 
+void
+p4est_wrap_set_subset (p4est_wrap_t * pp, p4est_topidx_t num_trees,
+                       const p4est_topidx_t * trees)
+{
+  p4est_topidx_t      it;
+
+  P4EST_ASSERT (pp != NULL);
+  P4EST_ASSERT (num_trees >= 0);
+
+  /* clear any previously registered subset */
+  P4EST_FREE (pp->subset_trees);
+  pp->subset_trees = NULL;
+  pp->num_subset_trees = 0;
+  if (num_trees == 0) {
+    P4EST_ASSERT (trees == NULL);
+    return;
+  }
+
+  /* copy the sorted list of local tree numbers */
+  P4EST_ASSERT (trees != NULL);
+  pp->subset_trees = P4EST_ALLOC (p4est_topidx_t, num_trees);
+  for (it = 0; it < num_trees; ++it) {
+    P4EST_ASSERT (pp->p4est->first_local_tree <= trees[it]);
+    P4EST_ASSERT (trees[it] <= pp->p4est->last_local_tree);
+    P4EST_ASSERT (it == 0 || trees[it - 1] < trees[it]);
+    pp->subset_trees[it] = trees[it];
+  }
+  pp->num_subset_trees = num_trees;
+}
+
 static p4est_wrap_leaf_t *
 p4est_wrap_leaf_info (p4est_wrap_leaf_t * leaf)
 {
@@ -884,6 +961,82 @@ p4est_wrap_leaf_first (p4est_wrap_t * pp, int track_mirrors)
   leaf->tquadrants = &leaf->tree->quadrants;
   P4EST_ASSERT (leaf->tquadrants->elem_size > 0);
   leaf->which_quad = 0;
+  leaf->sub_index = -1;
+
+  /* initialize mirror tracking if desired */
+  leaf->nm = leaf->next_mirror_quadrant = -1;
+  if (track_mirrors) {
+    leaf->mirrors = &(p4est_wrap_get_ghost (pp))->mirrors;
+    if (leaf->mirrors->elem_count > 0) {
+      mirror = p4est_quadrant_array_index (leaf->mirrors, 0);
+      leaf->next_mirror_quadrant = (int) mirror->p.piggy3.local_num;
+      P4EST_ASSERT (leaf->next_mirror_quadrant >= 0);
+      P4EST_ASSERT (leaf->next_mirror_quadrant < p4est->local_num_quadrants);
+    }
+  }
+  else {
+    leaf->mirrors = NULL;
+    leaf->is_mirror = 0;
+  }
+
+  /* complete leaf and mirror information */
+  return p4est_wrap_leaf_info (leaf);
+}
+
+static void
+p4est_wrap_leaf_skip_mirrors (p4est_wrap_leaf_t * leaf)
+{
+  p4est_locidx_t      offset;
+  p4est_quadrant_t   *mirror;
+
+  if (leaf->mirrors == NULL) {
+    return;
+  }
+
+  /* advance the mirror counter past quadrants in skipped trees */
+  offset = leaf->tree->quadrants_offset;
+  while (leaf->next_mirror_quadrant >= 0 &&
+         leaf->next_mirror_quadrant < offset) {
+    if (++leaf->nm + 1 < (p4est_locidx_t) leaf->mirrors->elem_count) {
+      mirror = p4est_quadrant_array_index (leaf->mirrors, leaf->nm + 1);
+      leaf->next_mirror_quadrant = mirror->p.piggy3.local_num;
+    }
+    else {
+      leaf->next_mirror_quadrant = -1;
+    }
+  }
+}
+
+p4est_wrap_leaf_t  *
+p4est_wrap_leaf_first_subset (p4est_wrap_t * pp, int track_mirrors)
+{
+  p4est_t            *p4est = pp->p4est;
+  p4est_wrap_leaf_t  *leaf;
+  p4est_quadrant_t   *mirror;
+
+  P4EST_ASSERT (pp->num_subset_trees >= 0);
+
+  /* without a registered subset we iterate over the whole forest */
+  if (pp->num_subset_trees == 0) {
+    return p4est_wrap_leaf_first (pp, track_mirrors);
+  }
+  if (p4est->local_num_quadrants == 0) {
+    P4EST_ASSERT (p4est->first_local_tree == -1);
+    P4EST_ASSERT (p4est->last_local_tree == -2);
+    return NULL;
+  }
+
+  /* prepare internal state of the leaf iterator */
+  leaf = P4EST_ALLOC (p4est_wrap_leaf_t, 1);
+  leaf->pp = pp;
+  leaf->sub_index = 0;
+  leaf->which_tree = pp->subset_trees[0];
+  P4EST_ASSERT (p4est->first_local_tree <= leaf->which_tree);
+  P4EST_ASSERT (leaf->which_tree <= p4est->last_local_tree);
+  leaf->tree = p4est_tree_array_index (p4est->trees, leaf->which_tree);
+  leaf->tquadrants = &leaf->tree->quadrants;
+  P4EST_ASSERT (leaf->tquadrants->elem_size > 0);
+  leaf->which_quad = 0;
 
   /* initialize mirror tracking if desired */
   leaf->nm = leaf->next_mirror_quadrant = -1;
@@ -895,6 +1048,9 @@ p4est_wrap_leaf_first (p4est_wrap_t * pp, int track_mirrors)
       P4EST_ASSERT (leaf->next_mirror_quadrant >= 0);
       P4EST_ASSERT (leaf->next_mirror_quadrant < p4est->local_num_quadrants);
     }
+
+    /* trees before the first subset tree may contain mirrors */
+    p4est_wrap_leaf_skip_mirrors (leaf);
   }
   else {
     leaf->mirrors = NULL;
@@ -913,22 +1069,37 @@ p4est_wrap_leaf_next (p4est_wrap_leaf_t * leaf)
   P4EST_ASSERT (leaf != NULL);
 
   if ((size_t) leaf->which_quad + 1 == leaf->tquadrants->elem_count) {
-    ++leaf->which_tree;
-    if (leaf->which_tree > p4est->last_local_tree) {
+    if (leaf->sub_index < 0) {
+      ++leaf->which_tree;
+      if (leaf->which_tree > p4est->last_local_tree) {
 #ifdef P4EST_ENABLE_DEBUG
-      if (leaf->mirrors != NULL) {
-        P4EST_ASSERT (leaf->nm + 1 ==
-                      (p4est_locidx_t) leaf->mirrors->elem_count);
-        P4EST_ASSERT (leaf->next_mirror_quadrant == -1);
-      }
+        if (leaf->mirrors != NULL) {
+          P4EST_ASSERT (leaf->nm + 1 ==
+                        (p4est_locidx_t) leaf->mirrors->elem_count);
+          P4EST_ASSERT (leaf->next_mirror_quadrant == -1);
+        }
 #endif
-      P4EST_FREE (leaf);
-      return NULL;
+        P4EST_FREE (leaf);
+        return NULL;
+      }
+    }
+    else {
+      /* advance to the next tree of the registered subset */
+      if (++leaf->sub_index == leaf->pp->num_subset_trees) {
+        P4EST_FREE (leaf);
+        return NULL;
+      }
+      leaf->which_tree = leaf->pp->subset_trees[leaf->sub_index];
+      P4EST_ASSERT (leaf->which_tree <= p4est->last_local_tree);
     }
     leaf->tree = p4est_tree_array_index (p4est->trees, leaf->which_tree);
     leaf->tquadrants = &leaf->tree->quadrants;
     P4EST_ASSERT (leaf->tquadrants->elem_size > 0);
     leaf->which_quad = 0;
+    if (leaf->sub_index >= 0) {
+      /* trees skipped on the way here may contain mirrors */
+      p4est_wrap_leaf_skip_mirrors (leaf);
+    }
   }
   else {
     ++leaf->which_quad;
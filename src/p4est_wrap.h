@@ -94,6 +94,15 @@ typedef struct p4est_wrap
   p4est_ghost_t      *ghost_aux;
   p4est_mesh_t       *mesh_aux;
   int                 match_aux;
+  long                mesh_revision;    /**< forest revision the current
+                                             ghost and mesh were built for */
+  p4est_mesh_t       *mesh_pool;        /**< one retired mesh kept around;
+                                             its allocations seed the next
+                                             rebuild */
+
+  /* for restricted leaf iteration use p4est_wrap_set_subset declared below */
+  p4est_topidx_t      num_subset_trees; /**< 0 if no subset is registered */
+  p4est_topidx_t     *subset_trees;     /**< Sorted local tree numbers */
 }
 p4est_wrap_t;
 
@@ -312,6 +321,28 @@ int                 p4est_wrap_partition (p4est_wrap_t * pp,
  */
 void                p4est_wrap_complete (p4est_wrap_t * pp);
 
+/** Register a subset of the local trees for restricted leaf iteration.
+ * Subsequent calls to \ref p4est_wrap_leaf_first_subset traverse only the
+ * registered trees, which saves time when most trees are inactive, for
+ * example in local time stepping.  The full mesh and ghost structures
+ * remain valid for the subset leaves since their entries are indexed by
+ * process-local quadrant numbers; see \ref p4est_wrap_get_mesh.
+ * The subset refers to the current partition.  It is cleared whenever
+ * \ref p4est_wrap_partition changes the forest and must be registered
+ * anew since tree ownership may have moved between processors.
+ * \param [in,out] pp       A valid p4est_wrap structure, hollow or not.
+ * \param [in] num_trees    Number of trees in the subset.
+ *                          Pass 0 together with \a trees == NULL to clear
+ *                          a previously registered subset.
+ * \param [in] trees        Sorted ascending list of tree numbers, each
+ *                          within the range of the process-local trees.
+ *                          The numbers are copied; ownership stays with
+ *                          the caller.
+ */
+void                p4est_wrap_set_subset (p4est_wrap_t * pp,
+                                           p4est_topidx_t num_trees,
+                                           const p4est_topidx_t * trees);
+
 /*** ITERATOR OVER THE FOREST LEAVES ***/
 
 typedef struct p4est_wrap_leaf
@@ -336,6 +367,9 @@ typedef struct p4est_wrap_leaf
   sc_array_t         *mirrors;        /**< If not NULL, from pp's ghost */
   p4est_locidx_t      nm;             /**< Internal: mirror counter */
   p4est_locidx_t      next_mirror_quadrant;     /**< Internal: next */
+
+  /* Information about iterating over a tree subset */
+  p4est_topidx_t      sub_index;      /**< Internal: subset position or -1 */
 }
 p4est_wrap_leaf_t;
 
@@ -354,6 +388,21 @@ p4est_wrap_leaf_t;
 p4est_wrap_leaf_t  *p4est_wrap_leaf_first (p4est_wrap_t * pp,
                                            int track_mirrors);
 
+/* Create an iterator over the leaves of the registered tree subset.
+ * Like \ref p4est_wrap_leaf_first, but the iteration only visits the
+ * trees registered with \ref p4est_wrap_set_subset.  Without a
+ * registered subset this function iterates over the whole local forest.
+ * Mirror tracking remains consistent: mirrors in skipped trees are
+ * passed over internally and never reported.
+ * \param [in] pp   Legal p4est_wrap structure, hollow or not.
+ * \param [in] track_mirrors    If true, \a pp must not be hollow and mirror
+ *                              information from the ghost layer is stored.
+ * \return          NULL if the subset is locally empty, otherwise a leaf
+ *                  iterator for use with \a p4est_wrap_leaf_next.
+ */
+p4est_wrap_leaf_t  *p4est_wrap_leaf_first_subset (p4est_wrap_t * pp,
+                                                  int track_mirrors);
+
 /* Move the forest leaf iterator forward.
  * \param [in,out] leaf     A non-NULL leaf iterator created by
  *                          \ref p4est_wrap_leaf_first.
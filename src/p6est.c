@@ -32,6 +32,7 @@
 #include <p4est_algorithms.h>
 #include <sc_containers.h>
 #include <p4est_communication.h>
+#include <p4est_io.h>
 #include <sc_io.h>
 #include <p6est_extended.h>
 
@@ -1068,6 +1069,320 @@ p6est_load_ext (const char *filename, sc_MPI_Comm mpicomm, size_t data_size,
   return p6est;
 }
 
+p6est_t            *
+p6est_load_fast (const char *filename, sc_MPI_Comm mpicomm,
+                 size_t data_size, int load_data, void *user_pointer,
+                 p6est_connectivity_t ** connectivity)
+{
+  const int           headc = 6;
+  const int           align = 32;
+  const int           root = 0;
+  int                 retval;
+  int                 mpiret;
+  int                 num_procs, rank;
+  int                 i;
+  FILE               *file;
+  char               *lbuf, *bp;
+  uint64_t           *u64a;
+  uint64_t            meta[4];
+  size_t              save_data_size;
+  size_t              col_size, comb_size, head_count;
+  size_t              zz, zcount, zpadding;
+  size_t              col_pos, layer_pos;
+  size_t              first, last;
+  long                fthis;
+  double             *top_vertices;
+  double              height[3];
+  p4est_topidx_t      jt, num_trees;
+  p4est_gloidx_t     *gfq, *pertree, *gfl;
+  p4est_qcoord_t     *qap;
+  p4est_locidx_t     *dap, *loaddata;
+  p4est_locidx_t      lfirst, llast, nlayers;
+  p4est_connectivity_t *conn4;
+  p6est_connectivity_t *conn;
+  p4est_t            *loadcolumns, *columns;
+  p4est_tree_t       *tree, *loadtree;
+  sc_array_t         *tquadrants, *loadtquadrants;
+  p4est_quadrant_t   *col, *loadcol;
+  sc_array_t         *qarr, *darr;
+  sc_io_source_t     *src;
+  p6est_t            *p6est;
+
+  P4EST_GLOBAL_PRODUCTIONF ("Into p6est_load_fast %s\n", filename);
+  p4est_log_indent_push ();
+
+  P4EST_ASSERT (connectivity != NULL);
+  if (data_size == 0) {
+    load_data = 0;
+  }
+  col_size = (P4EST_DIM + 1) * sizeof (p4est_qcoord_t) +
+    2 * sizeof (p4est_locidx_t);
+
+  /* retrieve MPI information */
+  mpiret = sc_MPI_Comm_size (mpicomm, &num_procs);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
+
+  /* the root parses connectivity and both headers once for everybody */
+  conn4 = NULL;
+  conn = NULL;
+  src = NULL;
+  u64a = NULL;
+  gfq = P4EST_ALLOC (p4est_gloidx_t, num_procs + 1);
+  gfq[0] = 0;
+  meta[0] = meta[1] = meta[2] = meta[3] = 0;
+  if (rank == root) {
+    size_t              conn_bytes;
+
+    src = sc_io_source_new (SC_IO_TYPE_FILENAME, SC_IO_ENCODE_NONE,
+                            filename);
+    SC_CHECK_ABORT (src != NULL, "file source: possibly file not found");
+    conn4 = p4est_connectivity_source (src);
+    SC_CHECK_ABORT (conn4 != NULL, "connectivity source");
+    zcount = src->bytes_out;
+    zpadding = (align - zcount % align) % align;
+    retval = sc_io_source_read (src, NULL, zpadding, NULL);
+    SC_CHECK_ABORT (!retval, "source padding");
+    conn_bytes = src->bytes_out;
+
+    /* read format and basic partition parameters of the column forest */
+    u64a = P4EST_ALLOC (uint64_t, headc);
+    retval = sc_io_source_read (src, u64a,
+                                sizeof (uint64_t) * (size_t) headc, NULL);
+    SC_CHECK_ABORT (!retval, "read format");
+    SC_CHECK_ABORT (u64a[0] == P4EST_ONDISK_FORMAT, "invalid format");
+    SC_CHECK_ABORT (u64a[1] == (uint64_t) sizeof (p4est_qcoord_t),
+                    "invalid coordinate size");
+    SC_CHECK_ABORT (u64a[2] == (uint64_t) sizeof (p4est_quadrant_t),
+                    "invalid quadrant size");
+    SC_CHECK_ABORT (u64a[3] == (uint64_t) (2 * sizeof (p4est_locidx_t)),
+                    "invalid column data size");
+    SC_CHECK_ABORT (u64a[4] != 0, "column ranges not saved");
+    SC_CHECK_ABORT ((int) u64a[5] == num_procs,
+                    "fast reload requires the saving process count");
+
+    /* the saved partition becomes the reload partition verbatim */
+    u64a = P4EST_REALLOC (u64a, uint64_t, num_procs);
+    retval = sc_io_source_read (src, u64a,
+                                sizeof (uint64_t) * (size_t) num_procs,
+                                NULL);
+    SC_CHECK_ABORT (!retval, "read column partition");
+    for (i = 0; i < num_procs; ++i) {
+      gfq[i + 1] = (p4est_gloidx_t) u64a[i];
+    }
+
+    /* every process computes its byte ranges from these offsets */
+    num_trees = conn4->num_trees;
+    head_count = (size_t) (headc + num_procs) + (size_t) num_trees;
+    zpadding = (align - (head_count * sizeof (uint64_t)) % align) % align;
+    col_pos = conn_bytes + head_count * sizeof (uint64_t) + zpadding;
+
+    /* hold on to the per-tree counts until every process knows them */
+    u64a = P4EST_REALLOC (u64a, uint64_t, num_trees);
+    retval = sc_io_source_read (src, u64a,
+                                sizeof (uint64_t) * (size_t) num_trees,
+                                NULL);
+    SC_CHECK_ABORT (!retval, "read pertree information");
+
+    /* skip the column section and parse the vertical extras */
+    retval = sc_io_source_read (src, NULL, (long)
+                                (col_pos + (size_t) gfq[num_procs] *
+                                 col_size - src->bytes_out), NULL);
+    SC_CHECK_ABORT (!retval, "seek over columns");
+    zcount = src->bytes_out;
+    zpadding = (align - zcount % align) % align;
+    retval = sc_io_source_read (src, NULL, zpadding, NULL);
+    SC_CHECK_ABORT (!retval, "source padding");
+    conn = p6est_connectivity_extra_source (conn4, src);
+    SC_CHECK_ABORT (conn != NULL, "connectivity extra source");
+    zcount = src->bytes_out;
+    zpadding = (align - zcount % align) % align;
+    retval = sc_io_source_read (src, NULL, zpadding, NULL);
+    SC_CHECK_ABORT (!retval, "source padding");
+    retval = sc_io_source_read (src, &meta[0], sizeof (uint64_t), NULL);
+    SC_CHECK_ABORT (!retval, "source data size");
+    zcount = src->bytes_out;
+    zpadding = (align - zcount % align) % align;
+    layer_pos = zcount + zpadding;
+    retval = sc_io_source_destroy (src);
+    SC_CHECK_ABORT (!retval, "destroy source");
+
+    meta[1] = (uint64_t) col_pos;
+    meta[2] = (uint64_t) layer_pos;
+    meta[3] = (conn->top_vertices != NULL) ?
+      (uint64_t) conn4->num_vertices : 0;
+  }
+
+  /* distribute connectivity, header facts, partition and tree counts */
+  conn4 = p4est_connectivity_bcast (conn4, root, mpicomm);
+  mpiret = sc_MPI_Bcast (meta, 4, sc_MPI_LONG_LONG_INT, root, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  save_data_size = (size_t) meta[0];
+  col_pos = (size_t) meta[1];
+  layer_pos = (size_t) meta[2];
+  if (load_data) {
+    SC_CHECK_ABORT (save_data_size == data_size, "data size mismatch");
+  }
+  comb_size = 2 * sizeof (p4est_qcoord_t) + save_data_size;
+
+  /* complete the vertical part of the connectivity on every process */
+  if (meta[3] > 0) {
+    top_vertices = (rank == root) ? conn->top_vertices :
+      P4EST_ALLOC (double, 3 * (size_t) meta[3]);
+    mpiret = sc_MPI_Bcast (top_vertices, 3 * (int) meta[3], sc_MPI_DOUBLE,
+                           root, mpicomm);
+    SC_CHECK_MPI (mpiret);
+    height[0] = height[1] = height[2] = 0.;
+  }
+  else {
+    top_vertices = NULL;
+    if (rank == root) {
+      height[0] = conn->height[0];
+      height[1] = conn->height[1];
+      height[2] = conn->height[2];
+    }
+    mpiret = sc_MPI_Bcast (height, 3, sc_MPI_DOUBLE, root, mpicomm);
+    SC_CHECK_MPI (mpiret);
+  }
+  if (rank != root) {
+    conn = P4EST_ALLOC (p6est_connectivity_t, 1);
+    conn->conn4 = conn4;
+    conn->top_vertices = top_vertices;
+    conn->height[0] = height[0];
+    conn->height[1] = height[1];
+    conn->height[2] = height[2];
+  }
+  *connectivity = conn;
+
+  mpiret = sc_MPI_Bcast (gfq + 1, num_procs, P4EST_MPI_GLOIDX,
+                         root, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  num_trees = conn4->num_trees;
+  pertree = P4EST_ALLOC (p4est_gloidx_t, num_trees + 1);
+  pertree[0] = 0;
+  if (rank == root) {
+    for (jt = 0; jt < num_trees; ++jt) {
+      pertree[jt + 1] = (p4est_gloidx_t) u64a[jt];
+    }
+    SC_CHECK_ABORT (gfq[num_procs] == pertree[num_trees],
+                    "pertree mismatch");
+    P4EST_FREE (u64a);
+  }
+  mpiret = sc_MPI_Bcast (pertree + 1, num_trees, P4EST_MPI_GLOIDX,
+                         root, mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  /* each process reads exactly its contiguous column range in one call */
+  zcount = (size_t) (gfq[rank + 1] - gfq[rank]);
+  lbuf = P4EST_ALLOC (char, zcount * col_size);
+  file = fopen (filename, "rb");
+  SC_CHECK_ABORT (file != NULL, "file open");
+  fthis = (long) (col_pos + (size_t) gfq[rank] * col_size);
+  retval = fseek (file, fthis, SEEK_SET);
+  SC_CHECK_ABORT (retval == 0, "seek columns");
+  sc_fread (lbuf, col_size, zcount, file, "read columns");
+
+  /* split the raw bytes into coordinates and layer ranges */
+  qarr =
+    sc_array_new_size (sizeof (p4est_qcoord_t), (P4EST_DIM + 1) * zcount);
+  qap = (p4est_qcoord_t *) qarr->array;
+  darr = sc_array_new_size (2 * sizeof (p4est_locidx_t), zcount);
+  dap = (p4est_locidx_t *) darr->array;
+  bp = lbuf;
+  for (zz = 0; zz < zcount; ++zz) {
+    memcpy (qap, bp, (P4EST_DIM + 1) * sizeof (p4est_qcoord_t));
+    qap += P4EST_DIM + 1;
+    memcpy (dap, bp + (P4EST_DIM + 1) * sizeof (p4est_qcoord_t),
+            2 * sizeof (p4est_locidx_t));
+    dap += 2;
+    bp += col_size;
+  }
+  P4EST_FREE (lbuf);
+
+  /* bulk-adopt the saved column partition; the contents are trusted */
+  loadcolumns = p4est_inflate (mpicomm, conn4, gfq, pertree,
+                               qarr, darr, NULL);
+  sc_array_destroy (qarr);
+  sc_array_destroy (darr);
+  P4EST_FREE (pertree);
+  P4EST_FREE (gfq);
+  columns = p4est_copy (loadcolumns, 0);
+
+  nlayers = 0;
+  for (jt = columns->first_local_tree; jt <= columns->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (columns->trees, jt);
+    loadtree = p4est_tree_array_index (loadcolumns->trees, jt);
+    tquadrants = &tree->quadrants;
+    loadtquadrants = &loadtree->quadrants;
+    for (zz = 0; zz < tquadrants->elem_count; ++zz) {
+      col = p4est_quadrant_array_index (tquadrants, zz);
+      loadcol = p4est_quadrant_array_index (loadtquadrants, zz);
+      loaddata = (p4est_locidx_t *) loadcol->p.user_data;
+      lfirst = loaddata[0];
+      llast = loaddata[1];
+      first = (size_t) nlayers;
+      nlayers += llast - lfirst;
+      last = first + (size_t) (llast - lfirst);
+
+      P6EST_COLUMN_SET_RANGE (col, first, last);
+    }
+  }
+  p4est_destroy (loadcolumns);
+
+  p6est = P4EST_ALLOC (p6est_t, 1);
+  columns->user_pointer = p6est;
+
+  p6est->columns = columns;
+  p6est->connectivity = conn;
+  p6est->data_size = data_size;
+  p6est_comm_parallel_env_assign (p6est, mpicomm);
+  mpicomm = p6est->mpicomm;
+  rank = p6est->mpirank;
+  p6est->global_first_layer = gfl = P4EST_ALLOC (p4est_gloidx_t,
+                                                 p6est->mpisize + 1);
+  p6est->layers =
+    sc_array_new_size (sizeof (p2est_quadrant_t), (size_t) nlayers);
+  p6est->layer_pool = sc_mempool_new (sizeof (p2est_quadrant_t));
+  p6est->user_pointer = user_pointer;
+  p6est->user_data_pool = data_size ? sc_mempool_new (data_size) : NULL;
+
+  p6est_update_offsets (p6est);
+
+  /* one more bulk read rebuilds the layers of this process' columns */
+  if (nlayers) {
+    lbuf = P4EST_ALLOC (char, comb_size * (size_t) nlayers);
+    fthis = (long) (layer_pos + (size_t) gfl[rank] * comb_size);
+    retval = fseek (file, fthis, SEEK_SET);
+    SC_CHECK_ABORT (retval == 0, "seek layers");
+    sc_fread (lbuf, comb_size, (size_t) nlayers, file, "read layers");
+
+    bp = lbuf;
+    for (zz = 0; zz < (size_t) nlayers; zz++) {
+      p2est_quadrant_t   *layer =
+        p2est_quadrant_array_index (p6est->layers, zz);
+      p4est_qcoord_t     *loadlayer = (p4est_qcoord_t *) bp;
+
+      P2EST_QUADRANT_INIT (layer);
+      layer->z = loadlayer[0];
+      layer->level = (int8_t) loadlayer[1];
+      if (load_data) {
+        layer->p.user_data = sc_mempool_alloc (p6est->user_data_pool);
+        memcpy (layer->p.user_data, &loadlayer[2], save_data_size);
+      }
+      bp += comb_size;
+    }
+    P4EST_FREE (lbuf);
+  }
+  retval = fclose (file);
+  SC_CHECK_ABORT (retval == 0, "file close");
+
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done p6est_load_fast %s\n", filename);
+
+  return p6est;
+}
+
 typedef struct p6est_refine_col_data
 {
   p6est_refine_column_t refine_col_fn;
@@ -1233,6 +1548,101 @@ p6est_update_offsets (p6est_t * p6est)
                 p6est->layers->elem_count);
 }
 
+p2est_quadrant_t   *
+p6est_layers_raw (p6est_t * p6est, p4est_locidx_t ** column_offsets)
+{
+  size_t              zz, first, last;
+  size_t              offset;
+  size_t              this_col;
+  p4est_topidx_t      jt;
+  p4est_quadrant_t   *col;
+  p4est_tree_t       *tree;
+  sc_array_t         *tquadrants;
+  p4est_t            *columns = p6est->columns;
+  p4est_locidx_t     *offsets;
+  int                 compressed;
+
+  /* the flat layer array is column-major exactly when it is compressed;
+   * detect stale ranges left behind by adaptation and compress on demand */
+  compressed = 1;
+  offset = 0;
+  for (jt = columns->first_local_tree;
+       compressed && jt <= columns->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (columns->trees, jt);
+    tquadrants = &tree->quadrants;
+    for (zz = 0; zz < tquadrants->elem_count; ++zz) {
+      col = p4est_quadrant_array_index (tquadrants, zz);
+      P6EST_COLUMN_GET_RANGE (col, &first, &last);
+      if (first != offset) {
+        compressed = 0;
+        break;
+      }
+      offset = last;
+    }
+  }
+  if (!compressed || offset != p6est->layers->elem_count) {
+    p6est_compress_columns (p6est);
+  }
+
+  if (column_offsets != NULL) {
+    offsets =
+      P4EST_ALLOC (p4est_locidx_t, columns->local_num_quadrants + 1);
+    this_col = 0;
+    for (jt = columns->first_local_tree; jt <= columns->last_local_tree;
+         ++jt) {
+      tree = p4est_tree_array_index (columns->trees, jt);
+      tquadrants = &tree->quadrants;
+      for (zz = 0; zz < tquadrants->elem_count; ++zz, ++this_col) {
+        col = p4est_quadrant_array_index (tquadrants, zz);
+        P6EST_COLUMN_GET_RANGE (col, &first, &last);
+        offsets[this_col] = (p4est_locidx_t) first;
+      }
+    }
+    P4EST_ASSERT (this_col == (size_t) columns->local_num_quadrants);
+    offsets[this_col] = (p4est_locidx_t) p6est->layers->elem_count;
+    *column_offsets = offsets;
+  }
+
+  return (p2est_quadrant_t *) p6est->layers->array;
+}
+
+void
+p6est_iterate_columns (p6est_t * p6est, void *user_data,
+                       p6est_column_iter_t iter_fn)
+{
+  size_t              zz, n_cols;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  sc_array_t         *tquadrants;
+  p4est_t            *columns = p6est->columns;
+  p2est_quadrant_t   *layers;
+
+  P4EST_ASSERT (iter_fn != NULL);
+
+  /* compressing first makes each column's slice contiguous and lets
+   * consecutive columns stream through consecutive memory */
+  layers = p6est_layers_raw (p6est, NULL);
+
+  for (jt = columns->first_local_tree; jt <= columns->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (columns->trees, jt);
+    tquadrants = &tree->quadrants;
+    n_cols = tquadrants->elem_count;
+
+    /* columns are independent; the callback must be thread safe */
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (dynamic)
+#endif
+    for (zz = 0; zz < n_cols; ++zz) {
+      size_t              first, last;
+      p4est_quadrant_t   *col;
+
+      col = p4est_quadrant_array_index (tquadrants, zz);
+      P6EST_COLUMN_GET_RANGE (col, &first, &last);
+      iter_fn (p6est, jt, col, layers + first, last - first, user_data);
+    }
+  }
+}
+
 void
 p6est_refine_columns_ext (p6est_t * p6est, int refine_recursive,
                           int allowed_level, p6est_refine_column_t refine_fn,
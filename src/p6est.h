@@ -624,6 +624,60 @@ p6est_layer_free_data (p6est_t * p6est, p2est_quadrant_t * layer)
 void                p6est_compress_columns (p6est_t * p6est);
 void                p6est_update_offsets (p6est_t * p6est);
 
+/** Expose the layers of all local columns as one contiguous array.
+ * The flat layer storage is column-major whenever it is compressed:
+ * the layers of each column are consecutive and the columns follow
+ * each other in Morton order of the column forest.  This function
+ * compresses the storage if adaptation has left stale ranges behind
+ * and then returns the raw base pointer, so column sweeps can stream
+ * through every layer of every column without indirect loads.
+ * The pointer is invalidated by any function that modifies the forest.
+ * \param [in,out] p6est           The forest; possibly compressed.
+ * \param [out] column_offsets     If not NULL, filled with a newly
+ *                                 allocated array of local_num_quadrants
+ *                                 + 1 entries, where column \a c owns
+ *                                 the layers [offsets[c], offsets[c+1])
+ *                                 of the returned array.  The caller
+ *                                 frees it with P4EST_FREE.
+ * \return                         Pointer to the first layer of the
+ *                                 first local column.
+ */
+p2est_quadrant_t   *p6est_layers_raw (p6est_t * p6est,
+                                      p4est_locidx_t ** column_offsets);
+
+/** Callback function prototype invoked once per local column.
+ * The layers of the column are passed as one contiguous slice.
+ * Under --enable-openmp the callback is invoked concurrently from
+ * different threads, so it must not modify the forest and any writes
+ * to shared state must be synchronized by the caller.
+ * \param [in] p6est        the forest
+ * \param [in] which_tree   the tree containing the column
+ * \param [in] column       the column being visited
+ * \param [in,out] layers   pointer to the first layer of the column
+ * \param [in] num_layers   number of layers in the column
+ * \param [in,out] user_data  the pointer passed to
+ *                            \ref p6est_iterate_columns
+ */
+typedef void        (*p6est_column_iter_t) (p6est_t * p6est,
+                                            p4est_topidx_t which_tree,
+                                            p4est_quadrant_t * column,
+                                            p2est_quadrant_t * layers,
+                                            size_t num_layers,
+                                            void *user_data);
+
+/** Visit every local column and hand its layer slice to a callback.
+ * The columns of each tree are distributed across a thread pool under
+ * --enable-openmp and visited in Morton order otherwise; the order of
+ * concurrent visits is unspecified.  The layer storage is compressed
+ * first (see \ref p6est_layers_raw), so each column's slice is
+ * contiguous and consecutive columns touch consecutive memory.
+ * \param [in,out] p6est      The forest; possibly compressed.
+ * \param [in,out] user_data  Passed through to \a iter_fn.
+ * \param [in] iter_fn        Called once for every local column.
+ */
+void                p6est_iterate_columns (p6est_t * p6est, void *user_data,
+                                           p6est_column_iter_t iter_fn);
+
 SC_EXTERN_C_END;
 
 #endif /* !P6EST_H */
@@ -136,6 +136,22 @@ p6est_t            *p6est_load_ext (const char *filename, sc_MPI_Comm mpicomm,
                                     void *user_pointer,
                                     p6est_connectivity_t ** connectivity);
 
+/** Reload a file written by \ref p6est_save_ext on the saving partition.
+ * Requires the file to have been saved with save_partition true and the
+ * process count to match; it aborts otherwise.  Only rank zero parses
+ * the connectivity and both headers and broadcasts them; every process
+ * then seeks directly to its recorded byte ranges and reads its columns
+ * and its layers with one bulk call each.  The layer records of a column
+ * are stored contiguously, so the layers array is rebuilt straight from
+ * the read buffer without streaming through the file.  The file contents
+ * are adopted as saved and not re-verified.  The parameters match
+ * \ref p6est_load_ext.
+ */
+p6est_t            *p6est_load_fast (const char *filename,
+                                     sc_MPI_Comm mpicomm, size_t data_size,
+                                     int load_data, void *user_pointer,
+                                     p6est_connectivity_t ** connectivity);
+
 /** Horizontally refine a forest with a bounded refinement level and a replace option.
  *
  * \param [in,out] p6est The forest is changed in place.
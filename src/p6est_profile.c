@@ -557,6 +557,7 @@ p6est_profile_new_local (p6est_t * p6est,
   profile->btype = btype;
   profile->lnode_changed[0] = NULL;
   profile->lnode_changed[1] = NULL;
+  profile->lnode_dirty = NULL;
   profile->enode_counts = NULL;
   profile->diff = diff;
   if (btype == P8EST_CONNECT_FACE) {
@@ -592,9 +593,12 @@ p6est_profile_new_local (p6est_t * p6est,
   if (ptype == P6EST_PROFILE_UNION) {
     profile->lnode_changed[0] = P4EST_ALLOC (p4est_locidx_t, nln);
     profile->lnode_changed[1] = P4EST_ALLOC (p4est_locidx_t, nln);
+    profile->lnode_dirty = P4EST_ALLOC (int, nln);
     profile->enode_counts = P4EST_ALLOC (p4est_locidx_t, P4EST_INSUL * nle);
     profile->evenodd = 0;
     memset (profile->lnode_changed[0], -1, nln * sizeof (int));
+    /* every profile must be communicated by the first sync */
+    memset (profile->lnode_dirty, -1, nln * sizeof (int));
   }
 
   /* create the profiles for each node: layers are reduced to just their level
@@ -855,6 +859,7 @@ p6est_profile_balance_local (p6est_profile_t * profile)
                 profile->lnode_changed[evenodd ^ 1][nidx] = 1;
                 any_local_change = 1;
               }
+              profile->lnode_dirty[nidx] = 1;
               lr[nidx][0] = lc->elem_count;
               lr[nidx][1] = work->elem_count;
               c = (int8_t *) sc_array_push_count (lc, work->elem_count);
@@ -893,6 +898,8 @@ p6est_profile_sync (p6est_profile_t * profile)
   p4est_locidx_t      send_total;
   p4est_locidx_t     *send_offsets, send_offset;
   p4est_locidx_t (*lr)[2];
+  p4est_locidx_t     *lrsend;
+  int                *dirty;
   sc_array_t         *lc = profile->lnode_columns;
   sc_MPI_Request     *recv_request, *send_request;
   sc_array_t         *work;
@@ -910,6 +917,27 @@ p6est_profile_sync (p6est_profile_t * profile)
 
   sc_array_init_data (&lrview, lr, 2 * sizeof (p4est_locidx_t), nln);
 
+  /* for union profiles we restrict this round to the profiles grown
+   * since the last sync; a zero count advertised for a clean node makes
+   * the union on the receiving side a no-op, so the bulk of the payload
+   * vanishes when only a handful of columns changed */
+  lrsend = NULL;
+  dirty = profile->lnode_dirty;
+  if (dirty != NULL) {
+    p4est_locidx_t      nidx;
+
+    P4EST_ASSERT (profile->ptype == P6EST_PROFILE_UNION);
+    lrsend = P4EST_ALLOC_ZERO (p4est_locidx_t, 2 * nln);
+    for (nidx = 0; nidx < nln; nidx++) {
+      if (dirty[nidx]) {
+        lrsend[2 * nidx] = lr[nidx][0];
+        lrsend[2 * nidx + 1] = lr[nidx][1];
+      }
+    }
+    memset (dirty, 0, nln * sizeof (int));
+    sc_array_init_data (&lrview, lrsend, 2 * sizeof (p4est_locidx_t), nln);
+  }
+
   countbuf = p4est_lnodes_share_all_begin (&lrview, lnodes);
   send_offsets = P4EST_ALLOC (p4est_locidx_t, nsharers + 1);
   send_offset = 0;
@@ -1018,6 +1046,10 @@ p6est_profile_sync (p6est_profile_t * profile)
 
       nidx = *((p4est_locidx_t *) sc_array_index (shared_nodes, zy));
 
+      if (lrsend != NULL && !lrsend[2 * nidx + 1]) {
+        /* this node was advertised with a zero count */
+        continue;
+      }
       if (lr[nidx][1]) {
         c = (int8_t *) sc_array_index (lc, lr[nidx][0]);
         memcpy (send + send_offsets[zz] + icount, c,
@@ -1086,6 +1118,9 @@ p6est_profile_sync (p6est_profile_t * profile)
             lr[nidx][0] = lc->elem_count;
             lr[nidx][1] = work->elem_count;
             profile->lnode_changed[evenodd][nidx] = 1;
+            /* other sharers of this node learn of the growth from us
+             * in the next round */
+            dirty[nidx] = 1;
 
             c = (int8_t *) sc_array_push_count (lc, work->elem_count);
             memcpy (c, work->array, work->elem_count * work->elem_size);
@@ -1115,6 +1150,7 @@ p6est_profile_sync (p6est_profile_t * profile)
   p6est_profile_compress (profile);
   p4est_lnodes_buffer_destroy (countbuf);
 
+  P4EST_FREE (lrsend);
   P4EST_FREE (recv_request);
   P4EST_FREE (recv_offsets);
   P4EST_FREE (recv);
@@ -1148,6 +1184,8 @@ p6est_profile_destroy (p6est_profile_t * profile)
     P4EST_ASSERT (profile->lnode_changed[1]);
     P4EST_FREE (profile->lnode_changed[0]);
     P4EST_FREE (profile->lnode_changed[1]);
+    P4EST_ASSERT (profile->lnode_dirty);
+    P4EST_FREE (profile->lnode_dirty);
     P4EST_ASSERT (profile->enode_counts);
     P4EST_FREE (profile->enode_counts);
   }
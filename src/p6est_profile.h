@@ -57,6 +57,10 @@ typedef struct p6est_profile
   p4est_locidx_t     *lnode_ranges;
   sc_array_t         *lnode_columns;
   int                *lnode_changed[2];
+  int                *lnode_dirty;      /**< union profiles only: nodes whose
+                                             profile has grown since the last
+                                             completed sync; only these are
+                                             communicated by the next sync */
   p4est_locidx_t     *enode_counts;
   int                 evenodd;
   p4est_qcoord_t      diff;
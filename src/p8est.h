@@ -182,6 +182,38 @@ size_t              p8est_memory_used (p8est_t * p8est);
  */
 long                p8est_revision (p8est_t * p8est);
 
+/** Global statistics on the shape of a forest.
+ * Filled by \ref p8est_statistics_levels.
+ */
+typedef struct p8est_level_statistics
+{
+  /** Global number of octants on each level. */
+  p4est_gloidx_t      global_per_level[P8EST_MAXLEVEL + 1];
+  int                 global_minlevel;  /**< smallest nonempty level */
+  int                 global_maxlevel;  /**< largest nonempty level */
+  p4est_gloidx_t      min_tree_quadrants;       /**< least filled tree */
+  p4est_gloidx_t      max_tree_quadrants;       /**< most filled tree */
+  double              tree_imbalance;   /**< max over average tree count */
+  p4est_gloidx_t      min_rank_quadrants;       /**< least loaded process */
+  p4est_gloidx_t      max_rank_quadrants;       /**< most loaded process */
+  double              rank_imbalance;   /**< max over average process count */
+}
+p8est_level_statistics_t;
+
+/** Compute the global level distribution and load extremes of a forest.
+ * The level histogram is summed from the per-level counters that every
+ * tree maintains with one small Allreduce; the per-process extremes
+ * come for free from the replicated partition array and the per-tree
+ * extremes add one collective sum over the trees.  The result is
+ * identical on all processes, e.g. to steer a refinement policy.
+ * This function is collective.
+ * \param [in] p8est    Valid forest structure.
+ * \param [out] stats   Filled with the global statistics.
+ */
+void                p8est_statistics_levels (p8est_t * p8est,
+                                             p8est_level_statistics_t *
+                                             stats);
+
 /** Callback function prototype to initialize the quadrant's user data.
  * \param [in] p8est         the forest
  * \param [in] which_tree    the tree containing \a quadrant
@@ -215,6 +247,25 @@ typedef int         (*p8est_coarsen_t) (p8est_t * p8est,
                                         p4est_topidx_t which_tree,
                                         p8est_quadrant_t * quadrants[]);
 
+/** Callback function prototype to decide coarsening for many families.
+ * Called once per tree with all candidate families at once.
+ * \param [in] p8est         the forest
+ * \param [in] which_tree    the tree containing all families
+ * \param [in] quadrants     the tree's quadrant array
+ * \param [in] num_families  number of candidate families
+ * \param [in] family_first  index of the first sibling of each family
+ *                           within \a quadrants
+ * \param [out] coarsen_flags  zero-initialized array of \a num_families
+ *                           entries; set nonzero to coarsen a family.
+ */
+typedef void        (*p8est_coarsen_batch_t) (p8est_t * p8est,
+                                              p4est_topidx_t which_tree,
+                                              sc_array_t * quadrants,
+                                              p4est_locidx_t num_families,
+                                              const p4est_locidx_t *
+                                              family_first,
+                                              int8_t * coarsen_flags);
+
 /** Callback function prototype to calculate weights for partitioning.
  * \param [in] p8est       the forest
  * \param [in] which_tree  the tree containing \a quadrant
@@ -225,6 +276,42 @@ typedef int         (*p8est_weight_t) (p8est_t * p8est,
                                        p4est_topidx_t which_tree,
                                        p8est_quadrant_t * quadrant);
 
+/** Callback function prototype to calculate partition weights in batches.
+ * It is called once per local tree and fills one weight per octant,
+ * which allows the cost model to be vectorized by the caller.
+ * \param [in] p8est       the forest
+ * \param [in] which_tree  the tree whose octants are passed
+ * \param [in] quadrants   array of the tree's octants in Morton order
+ * \param [out] weights    one 32bit integer >= 0 per octant.
+ * \note    Global sum of weights must fit into a 64bit integer.
+ */
+typedef void        (*p8est_weight_batch_t) (p8est_t * p8est,
+                                             p4est_topidx_t which_tree,
+                                             sc_array_t * quadrants,
+                                             int *weights);
+
+/** Callback function prototype to calculate vector partition weights.
+ * It fills one weight per constraint for a single octant, e.g. its
+ * memory footprint and its compute cost as separate components.
+ * \param [in] p8est       the forest
+ * \param [in] which_tree  the tree containing \a quadrant
+ * \param [in] quadrant    the octant to be weighted
+ * \param [out] weights    one 32bit integer >= 0 per component.
+ * \note    Global sum of each component must fit into a 64bit integer.
+ */
+typedef void        (*p8est_weight_vector_t) (p8est_t * p8est,
+                                              p4est_topidx_t which_tree,
+                                              p8est_quadrant_t * quadrant,
+                                              int *weights);
+
+/** Norms available to combine vector partition weights into a scalar. */
+typedef enum p8est_partition_norm
+{
+  P8EST_PARTITION_NORM_L1,      /**< balance the sum of the components */
+  P8EST_PARTITION_NORM_MAX      /**< balance the dominant component */
+}
+p8est_partition_norm_t;
+
 extern void        *P8EST_DATA_UNINITIALIZED;
 
 /** set statically allocated quadrant to defined values */
@@ -307,6 +394,64 @@ void                p8est_reset_data (p8est_t * p8est, size_t data_size,
                                       p8est_init_t init_fn,
                                       void *user_pointer);
 
+/** Restore locality of the per-quadrant user data.
+ * Repeated refinement and coarsening scatter the user data allocations
+ * across the memory pool.  This function reallocates the data of every
+ * local quadrant from a fresh pool in Morton order, so the data of
+ * adjacent quadrants becomes address-adjacent, and frees the old pool.
+ * All pointers to user data held outside the forest are invalidated.
+ * \param [in,out] p8est   The forest; its quadrants' data is moved.
+ */
+void                p8est_repack_data (p8est_t * p8est);
+
+/** Return the memory stranded by refinement peaks to tight storage.
+ * After heavy coarsening the octant arrays keep the capacity of their
+ * largest past size, the octant pool keeps the chunks carved at the
+ * peak, and the user data pool is riddled with freed slots, so the
+ * resident set stays near its maximum.  This function rebuilds every
+ * local tree's octant array with exact capacity, recreates the
+ * octant pool, and repacks the user data as in \ref p8est_repack_data.
+ * All pointers to octants or user data held outside the forest are
+ * invalidated.
+ * \param [in,out] p8est   The forest; its storage is moved.
+ */
+void                p8est_memory_compact (p8est_t * p8est);
+
+/** Place the octant storage of each tree on its reader's memory domain.
+ * The octant arrays are reallocated and copied tree by tree from an
+ * OpenMP loop with a static schedule, matching the tree-to-thread
+ * affinity of the volume pass in \ref p8est_iterate_threaded.  Under the
+ * operating system's first-touch policy the pages of each tree thus end
+ * up on the memory domain of the thread that will read them.  Without
+ * OpenMP the storage is simply reallocated serially.
+ * All pointers to octants held outside the forest are invalidated.
+ * \param [in,out] p8est   The forest; its octant storage is moved.
+ */
+void                p8est_numa_first_touch (p8est_t * p8est);
+
+/** Request huge page backing for the octant storage of all local trees.
+ * Advises the kernel to back each tree's octant array with transparent
+ * huge pages where the system supports it, reducing TLB pressure on
+ * traversals over large forests.  The advice survives until the array is
+ * reallocated, so it is best applied after the forest has settled or
+ * after \ref p8est_reserve_quadrants.  A no-op where unsupported.
+ * \param [in,out] p8est   The forest; its storage is advised in place.
+ */
+void                p8est_advise_hugepages (p8est_t * p8est);
+
+/** Preallocate octant storage from the forest's growth history.
+ * Records the revision counter and local octant count on every call.
+ * When called again after the forest has grown, the measured growth
+ * ratio is replayed onto each local tree: the octant arrays are grown
+ * to the forecast capacity and shrunk back, so the next adaptation of
+ * similar strength appends in place instead of doubling through fresh
+ * allocations.  The reserved storage is advised to use huge pages via
+ * \ref p8est_advise_hugepages.  Requires an attached inspect structure
+ * to hold the history and does nothing without one.
+ * \param [in,out] p8est   The forest; tree storage may be reallocated.
+ */
+void                p8est_reserve_quadrants (p8est_t * p8est);
+
 /** Refine a forest.
  * \param [in,out] p8est The forest is changed in place.
  * \param [in] refine_recursive Boolean to decide on recursive refinement.
@@ -404,6 +549,62 @@ unsigned            p8est_checksum (p8est_t * p8est);
 void                p8est_save (const char *filename, p8est_t * p8est,
                                 int save_data);
 
+/** Save the complete connectivity/p8est data to disk with compression.
+ *
+ * The file layout follows \ref p8est_save up to the header, which is
+ * extended by an index of compressed chunk sizes, one per process.
+ * Each process' octants and data are deflated into an independent
+ * chunk; the fixed-size blocks inside a chunk compress in parallel
+ * when threads are available.  The partition is always saved since the
+ * chunk boundaries are tied to the writing process count, so the file
+ * must be read back by \ref p8est_load_compressed on as many processes.
+ *
+ * \param [in] filename    Name of the file to write.
+ * \param [in] p8est       Valid forest structure.
+ * \param [in] save_data   If true, the element data is saved.
+ *                         Otherwise, a data size of 0 is saved.
+ * \note            Aborts on file errors.
+ * \note            If p4est is not configured to use MPI-IO, some processes
+ *                  return from this function before the file is complete, in
+ *                  which case immediate read-access to the file may require a
+ *                  call to sc_MPI_Barrier.
+ */
+void                p8est_save_compressed (const char *filename,
+                                           p8est_t * p8est, int save_data);
+
+/** Pending state of an asynchronous checkpoint write. */
+typedef struct p8est_checkpoint p8est_checkpoint_t;
+
+/** Start writing a checkpoint without blocking for the file I/O.
+ *
+ * The local octants (and optionally their data) are snapshotted into a
+ * staging buffer and a split collective MPI write is started, so the
+ * forest may be adapted, partitioned, or destroyed again as soon as this
+ * function returns.  The file is identical to one written by
+ * \ref p8est_save and is read back with \ref p8est_load.
+ * If p4est is not configured to use MPI-IO, the checkpoint falls back to
+ * the blocking \ref p8est_save and completes before returning.
+ *
+ * \param [in] filename    Name of the file to write.
+ * \param [in] p8est       Valid forest structure.
+ * \param [in] save_data   If true, the element data is saved.
+ *                         Otherwise, a data size of 0 is saved.
+ * \return          Pending checkpoint state; it must be passed to
+ *                  \ref p8est_checkpoint_end to complete the write.
+ * \note            Aborts on file errors.
+ */
+p8est_checkpoint_t *p8est_checkpoint_begin (const char *filename,
+                                            p8est_t * p8est, int save_data);
+
+/** Complete an asynchronous checkpoint write.
+ * This function waits for the collective write started by
+ * \ref p8est_checkpoint_begin, closes the file, and frees the staging
+ * buffer.  The file is complete on all processes afterwards.
+ * \param [in,out] ck   Created by \ref p8est_checkpoint_begin.
+ *                      It is deallocated before this function returns.
+ */
+void                p8est_checkpoint_end (p8est_checkpoint_t * ck);
+
 /** Load the complete connectivity/p8est structure from disk.
  *
  * This is a collective operation that all MPI processes need to call.  All
@@ -437,6 +638,52 @@ p8est_t            *p8est_load (const char *filename, sc_MPI_Comm mpicomm,
                                 void *user_pointer,
                                 p8est_connectivity_t ** connectivity);
 
+/** Load a file written by \ref p8est_save_compressed from disk.
+ *
+ * Every process reads the header and then only its own compressed
+ * chunk, whose blocks decompress in parallel when threads are
+ * available.  The number of processes must equal the number the file
+ * was written with, since the chunks encode that partition.
+ *
+ * The parameters match \ref p8est_load; see there for details.
+ *
+ * \return          Returns a valid forest structure. A pointer to a valid
+ *                  connectivity structure is returned through the last
+ *                  argument.
+ * \note            Aborts on file errors or invalid file contents.
+ */
+p8est_t            *p8est_load_compressed (const char *filename,
+                                           sc_MPI_Comm mpicomm,
+                                           size_t data_size, int load_data,
+                                           void *user_pointer,
+                                           p8est_connectivity_t **
+                                           connectivity);
+
+/** Load a file written by \ref p8est_save on any number of processes.
+ *
+ * The saved partition is ignored and replaced by a uniform one for the
+ * current communicator size, as with the autopartition option of
+ * p8est_load_ext().  Unlike the streamed loader, only the root process
+ * reads the header; every process then reads exactly its own slice of
+ * the octant records with one collective MPI-IO read, so restarting
+ * on a different number of processes scales with the slice size and
+ * not with the file size.  Without MPI-IO support this function falls
+ * back to the streamed loader.
+ *
+ * The parameters match \ref p8est_load; see there for details.
+ *
+ * \return          Returns a valid forest structure. A pointer to a valid
+ *                  connectivity structure is returned through the last
+ *                  argument.
+ * \note            Aborts on file errors or invalid file contents.
+ */
+p8est_t            *p8est_load_parallel (const char *filename,
+                                         sc_MPI_Comm mpicomm,
+                                         size_t data_size, int load_data,
+                                         void *user_pointer,
+                                         p8est_connectivity_t **
+                                         connectivity);
+
 /** Return a pointer to an array element indexed by a p4est_topidx_t.
  * \param [in] index needs to be in [0]..[elem_count-1].
  */
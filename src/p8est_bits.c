@@ -212,14 +212,13 @@ p8est_quadrant_edge_neighbor_extra (const p4est_quadrant_t * q, p4est_topidx_t
         int                 nface =
           conn->tree_to_face[P4EST_FACES * t + face];
         int                 o = nface / P4EST_FACES;
-        int                 ref, set;
+        int                 set;
         int                 c1, c2, nc1, nc2;
 
         nface = nface % P4EST_FACES;
 
         P4EST_ASSERT (p8est_edge_faces[opedge][1] == face);
-        ref = p8est_face_permutation_refs[face][nface];
-        set = p8est_face_permutation_sets[ref][o];
+        set = p8est_face_permutation_orientations[face][nface][o];
 
         c1 = p8est_edge_corners[opedge][0];
         nc1 = p8est_corner_face_corners[c1][face];
@@ -256,14 +255,13 @@ p8est_quadrant_edge_neighbor_extra (const p4est_quadrant_t * q, p4est_topidx_t
       int                 opedge = (edge ^ 2);
       int                 nface = conn->tree_to_face[P4EST_FACES * t + face];
       int                 o = nface / P4EST_FACES;
-      int                 ref, set;
+      int                 set;
       int                 c1, c2, nc1, nc2;
 
       nface = nface % P4EST_FACES;
 
       P4EST_ASSERT (p8est_edge_faces[opedge][0] == face);
-      ref = p8est_face_permutation_refs[face][nface];
-      set = p8est_face_permutation_sets[ref][o];
+      set = p8est_face_permutation_orientations[face][nface][o];
 
       c1 = p8est_edge_corners[opedge][0];
       nc1 = p8est_corner_face_corners[c1][face];
@@ -272,6 +272,20 @@ int                 p8est_quadrant_is_familyv (const p8est_quadrant_t q[]);
  */
 int                 p8est_quadrant_is_familypv (p8est_quadrant_t * q[]);
 
+/** Mark all positions in a quadrant array where a family starts.
+ * The test runs over the coordinate and level entries with mask
+ * arithmetic and avoids per-window function calls.
+ * \param [in] q             Array of \a num_quadrants valid quadrants.
+ * \param [in] num_quadrants Number of quadrants in \a q.
+ * \param [out] family_start Array of \a num_quadrants flags.  The entry
+ *                           at index i is set to 1 if the 8 quadrants
+ *                           beginning at i form a family, 0 otherwise.
+ * \return                   The number of family starts found.
+ */
+size_t              p8est_quadrant_family_scan (const p8est_quadrant_t * q,
+                                                size_t num_quadrants,
+                                                int8_t * family_start);
+
 /** Test if a quadrant is the parent of another quadrant.
  * \param [in] q Quadrant to be tested.
  * \param [in] r Possible child quadrant.
@@ -507,6 +521,47 @@ void                p8est_quadrant_corner_neighbor_extra (const
                                                           p8est_connectivity_t
                                                           * conn);
 
+/** A resolver for corner neighbors that caches inter-tree transforms.
+ * \ref p8est_quadrant_corner_neighbor_extra derives the transform set of
+ * a tree corner from the connectivity on every call; the resolver
+ * derives it on the first query per (tree, corner) pair and reuses it
+ * afterwards, which pays off on meshes with many trees.
+ */
+typedef struct p8est_corner_resolver p8est_corner_resolver_t;
+
+/** Create a corner resolver with an empty transform cache.
+ * \param [in] conn   The connectivity to be queried; it must stay
+ *                    unchanged and alive for the resolver's lifetime.
+ * \return            A resolver to be freed with
+ *                    \ref p8est_corner_resolver_destroy.
+ */
+p8est_corner_resolver_t *p8est_corner_resolver_new (p8est_connectivity_t *
+                                                    conn);
+
+/** Compute corner neighbors like \ref p8est_quadrant_corner_neighbor_extra
+ * but answer tree-corner crossings from the resolver's cache.
+ * The results are identical to the uncached function.
+ * \param [in]     res    The resolver; its cache grows as needed.
+ * \param [in]     q      Input octant, must be valid.
+ * \param [in]     t      Tree that contains \a q.
+ * \param [in]     corner The corner across which to generate the neighbor.
+ * \param [in,out] quads  An initialized but empty array where the corner
+ *                        neighbors will be placed.
+ * \param [in,out] treeids An initialized but empty array where the ids of
+ *                        the trees containing the corner neighbors will be
+ *                        placed.
+ * \param [in,out] ncorners if not NULL, filled with the corners of \a quads
+ *                          that neighbor \a q.
+ */
+void                p8est_quadrant_corner_neighbor_resolve
+  (p8est_corner_resolver_t * res, const p8est_quadrant_t * q,
+   p4est_locidx_t t, int corner, sc_array_t * quads, sc_array_t * treeids,
+   sc_array_t * ncorners);
+
+/** Free a corner resolver and its cached transform sets. */
+void                p8est_corner_resolver_destroy (p8est_corner_resolver_t *
+                                                   res);
+
 /** Compute the half size corner neighbor of a quadrant.
  *
  * \param [in]  q       The quadrant whose corner neighbor will be constructed.
@@ -711,6 +766,116 @@ uint64_t            p8est_quadrant_linear_id (const p8est_quadrant_t *
 void                p8est_quadrant_set_morton (p8est_quadrant_t * quadrant,
                                                int level, uint64_t id);
 
+/** Computes the linear position on a uniform grid for an array of octants.
+ * This amortizes per-call overhead over the whole array; on processors
+ * with BMI2 the bit interleaving additionally uses the PDEP instruction.
+ * \param [in]  quadrants  Array of p8est_quadrant_t.
+ * \param [in]  level      The level of the regular grid; no octant in
+ *                         the array may be of smaller level.
+ * \param [out] ids        Array of at least \a quadrants->elem_count
+ *                         entries receiving the linear positions.
+ */
+void                p8est_quadrant_linear_id_v (sc_array_t * quadrants,
+                                               int level, uint64_t * ids);
+
+/** Gather the coordinates and levels of an array of octants into
+ * separate contiguous arrays.
+ * The structure-of-arrays form allows scans over sorted octant arrays
+ * to be vectorized over the coordinate lanes.  The piggy data is not
+ * copied; use the array index to refer back to the original octants.
+ * \param [in]  quadrants  Array of p8est_quadrant_t.
+ * \param [out] x          Array of at least \a quadrants->elem_count
+ *                         entries receiving the x coordinates.
+ * \param [out] y          Likewise for the y coordinates.
+ * \param [out] z          Likewise for the z coordinates.
+ * \param [out] level      Likewise for the levels.
+ */
+void                p8est_quadrant_array_to_soa (sc_array_t * quadrants,
+                                                p4est_qcoord_t * x,
+                                                p4est_qcoord_t * y,
+                                                p4est_qcoord_t * z,
+                                                int8_t * level);
+
+/** Scatter separate coordinate and level arrays back into octants.
+ * This is the inverse operation of p8est_quadrant_array_to_soa.
+ * The octant array must already have its final element count; the
+ * piggy data of the octants is never modified.
+ * \param [in,out] quadrants  Array of p8est_quadrant_t to be overwritten.
+ * \param [in]     x          Array of x coordinates.
+ * \param [in]     y          Array of y coordinates.
+ * \param [in]     z          Array of z coordinates.
+ * \param [in]     level      Array of levels.
+ */
+void                p8est_quadrant_array_from_soa (sc_array_t * quadrants,
+                                                  const p4est_qcoord_t * x,
+                                                  const p4est_qcoord_t * y,
+                                                  const p4est_qcoord_t * z,
+                                                  const int8_t * level);
+
+/** Deepest level representable by \ref p8est_quadrant_compact_t. */
+#define P8EST_COMPACT_MAXLEVEL 16
+
+/** Compact 8 byte encoding of an octant for shallow forests.
+ * Octants of level at most \ref P8EST_COMPACT_MAXLEVEL have
+ * coordinates that are multiples of a fixed power of two, so 16 bits
+ * per coordinate encode them exactly.  The encoding is meant for
+ * memory bound storage and transport of octant sets -- snapshots,
+ * caches, application messages -- at a fraction of the in-core struct
+ * size; the algorithms of this library keep operating on the full
+ * \ref p8est_quadrant_t.  The piggy data union is not represented.
+ */
+typedef struct p8est_quadrant_compact
+{
+  uint16_t            x, y, z;  /**< coordinates scaled down by
+                                     2^(P8EST_MAXLEVEL -
+                                     P8EST_COMPACT_MAXLEVEL) */
+  uint8_t             level;    /**< level of refinement */
+  uint8_t             pad8;     /**< copied from the octant verbatim */
+}
+p8est_quadrant_compact_t;
+
+/** Encode one octant into its compact form.
+ * \param [in] q    Valid octant of level at most
+ *                  \ref P8EST_COMPACT_MAXLEVEL with coordinates
+ *                  inside the root, i.e. not a tree neighbor.
+ * \param [out] c   The compact encoding of \a q.
+ */
+void                p8est_quadrant_compact_pack (const p8est_quadrant_t * q,
+                                                 p8est_quadrant_compact_t *
+                                                 c);
+
+/** Decode one octant from its compact form.
+ * This is the inverse operation of \ref p8est_quadrant_compact_pack.
+ * Only the coordinates, the level, and the pad8 member of \a q are
+ * written; the user_data of \a q is never modified.
+ * \param [in] c    A compact encoding created by the pack function.
+ * \param [out] q   The decoded octant.
+ */
+void                p8est_quadrant_compact_unpack (const
+                                                   p8est_quadrant_compact_t *
+                                                   c, p8est_quadrant_t * q);
+
+/** Encode an array of octants into compact form.
+ * \param [in] quadrants     Array of p8est_quadrant_t, all of level at
+ *                           most \ref P8EST_COMPACT_MAXLEVEL.
+ * \param [in,out] compact   Initialized array of
+ *                           \ref p8est_quadrant_compact_t; it is
+ *                           resized to match and overwritten.
+ */
+void                p8est_quadrant_array_to_compact (sc_array_t * quadrants,
+                                                     sc_array_t * compact);
+
+/** Decode an array of octants from compact form.
+ * This is the inverse operation of \ref p8est_quadrant_array_to_compact.
+ * The piggy data of the decoded octants is cleared.
+ * \param [in] compact       Array of \ref p8est_quadrant_compact_t.
+ * \param [in,out] quadrants Initialized array of p8est_quadrant_t; it
+ *                           is resized to match and overwritten.
+ */
+void                p8est_quadrant_array_from_compact (sc_array_t * compact,
+                                                       sc_array_t *
+                                                       quadrants);
+
 SC_EXTERN_C_END;
 
 #endif /* !P8EST_BITS_H */
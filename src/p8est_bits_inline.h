@@ -0,0 +1,137 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/** \file p8est_bits_inline.h
+ *
+ * Static-inline copies of the hottest octant primitives.
+ *
+ * The canonical definitions of these functions live in \ref p8est_bits.h
+ * and are compiled into the library, which costs a function call per use.
+ * The versions in this header are bitwise identical in behavior and exist
+ * so that tight user loops, such as neighbor walks over an octant array,
+ * can inline them.  They must be kept in sync with p4est_bits.c; any
+ * behavioral change there is a bug here.
+ *
+ * \ingroup p8est
+ */
+
+#ifndef P8EST_BITS_INLINE_H
+#define P8EST_BITS_INLINE_H
+
+#include <p8est_bits.h>
+
+SC_EXTERN_C_BEGIN;
+
+/** Inline version of \ref p8est_quadrant_child_id.
+ * \param [in] q  Valid octant; may not be a node.
+ * \return        The child id of \a q within its parent.
+ */
+/*@unused@*/
+static inline int
+p8est_quadrant_child_id_inline (const p8est_quadrant_t * q)
+{
+  int                 id = 0;
+
+  P4EST_ASSERT (p8est_quadrant_is_extended (q));
+
+  if (q->level == 0) {
+    return 0;
+  }
+
+  id |= ((q->x & P8EST_QUADRANT_LEN (q->level)) ? 0x01 : 0);
+  id |= ((q->y & P8EST_QUADRANT_LEN (q->level)) ? 0x02 : 0);
+  id |= ((q->z & P8EST_QUADRANT_LEN (q->level)) ? 0x04 : 0);
+
+  return id;
+}
+
+/** Inline version of \ref p8est_quadrant_parent.
+ * \param [in]  q  Valid octant of level greater zero.
+ * \param [out] r  The parent of \a q; may alias \a q.
+ */
+/*@unused@*/
+static inline void
+p8est_quadrant_parent_inline (const p8est_quadrant_t * q,
+                              p8est_quadrant_t * r)
+{
+  P4EST_ASSERT (p8est_quadrant_is_extended (q));
+  P4EST_ASSERT (q->level > 0);
+
+  r->x = q->x & ~P8EST_QUADRANT_LEN (q->level);
+  r->y = q->y & ~P8EST_QUADRANT_LEN (q->level);
+  r->z = q->z & ~P8EST_QUADRANT_LEN (q->level);
+  r->level = (int8_t) (q->level - 1);
+  P4EST_ASSERT (p8est_quadrant_is_extended (r));
+}
+
+/** Inline version of \ref p8est_quadrant_compare.
+ * Unlike the library function this one takes typed pointers, so it is
+ * not suitable as an sc_array sort callback; use it for direct calls.
+ * \return  Comparison result, less, equal or greater than zero.
+ */
+/*@unused@*/
+static inline int
+p8est_quadrant_compare_inline (const p8est_quadrant_t * q1,
+                               const p8est_quadrant_t * q2)
+{
+  uint32_t            exclorx, exclory, exclorz, exclorxy, exclor;
+  int64_t             p1, p2, diff;
+
+  P4EST_ASSERT (p8est_quadrant_is_node (q1, 1) ||
+                p8est_quadrant_is_extended (q1));
+  P4EST_ASSERT (p8est_quadrant_is_node (q2, 1) ||
+                p8est_quadrant_is_extended (q2));
+
+  /* these are unsigned variables that inherit the sign bits */
+  exclorx = q1->x ^ q2->x;
+  exclory = q1->y ^ q2->y;
+  exclorz = q1->z ^ q2->z;
+  exclorxy = exclorx | exclory;
+  exclor = exclorxy | exclorz;
+
+  if (!exclor) {
+    return (int) q1->level - (int) q2->level;
+  }
+
+  /* if (exclor ^ exclorz) > exclorz, then exclorxy has a more significant bit
+   * than exclorz; also exclor and (exclor ^ exclorz) cannot be equal */
+  if (exclorz > (exclor ^ exclorz)) {
+    p1 = q1->z + ((q1->z >= 0) ? 0 : ((int64_t) 1 << (P8EST_MAXLEVEL + 2)));
+    p2 = q2->z + ((q2->z >= 0) ? 0 : ((int64_t) 1 << (P8EST_MAXLEVEL + 2)));
+  }
+  else if (exclory > (exclorxy ^ exclory)) {
+    p1 = q1->y + ((q1->y >= 0) ? 0 : ((int64_t) 1 << (P8EST_MAXLEVEL + 2)));
+    p2 = q2->y + ((q2->y >= 0) ? 0 : ((int64_t) 1 << (P8EST_MAXLEVEL + 2)));
+  }
+  else {
+    p1 = q1->x + ((q1->x >= 0) ? 0 : ((int64_t) 1 << (P8EST_MAXLEVEL + 2)));
+    p2 = q2->x + ((q2->x >= 0) ? 0 : ((int64_t) 1 << (P8EST_MAXLEVEL + 2)));
+  }
+  diff = p1 - p2;
+  return (diff == 0) ? 0 : ((diff < 0) ? -1 : 1);
+}
+
+SC_EXTERN_C_END;
+
+#endif /* !P8EST_BITS_INLINE_H */
@@ -62,6 +62,19 @@ const int           p8est_face_permutation_refs[6][6] =
  { 0, 2, 2, 0, 0, 1 },
  { 0, 2, 2, 0, 0, 1 },
  { 2, 0, 0, 2, 2, 0 }};
+const int           p8est_face_permutation_orientations[6][6][4] =
+{{ { 1, 2, 5, 6 }, { 0, 3, 4, 7 }, { 0, 3, 4, 7 },
+   { 1, 2, 5, 6 }, { 1, 2, 5, 6 }, { 0, 3, 4, 7 } },
+ { { 0, 4, 3, 7 }, { 1, 2, 5, 6 }, { 1, 2, 5, 6 },
+   { 0, 3, 4, 7 }, { 0, 3, 4, 7 }, { 1, 2, 5, 6 } },
+ { { 0, 4, 3, 7 }, { 1, 2, 5, 6 }, { 1, 2, 5, 6 },
+   { 0, 3, 4, 7 }, { 0, 3, 4, 7 }, { 1, 2, 5, 6 } },
+ { { 1, 2, 5, 6 }, { 0, 4, 3, 7 }, { 0, 4, 3, 7 },
+   { 1, 2, 5, 6 }, { 1, 2, 5, 6 }, { 0, 3, 4, 7 } },
+ { { 1, 2, 5, 6 }, { 0, 4, 3, 7 }, { 0, 4, 3, 7 },
+   { 1, 2, 5, 6 }, { 1, 2, 5, 6 }, { 0, 3, 4, 7 } },
+ { { 0, 4, 3, 7 }, { 1, 2, 5, 6 }, { 1, 2, 5, 6 },
+   { 0, 4, 3, 7 }, { 0, 4, 3, 7 }, { 1, 2, 5, 6 } }};
 
 const int           p8est_face_edge_permutations[8][4] =
 {{ 0, 1, 2, 3 },
@@ -76,6 +89,19 @@ const int           p8est_face_edge_permutation_sets[3][4] =
 {{ 4, 1, 2, 7 },
  { 0, 6, 5, 3 },
  { 0, 5, 6, 3 }};
+const int           p8est_face_edge_permutation_orientations[6][6][4] =
+{{ { 4, 1, 2, 7 }, { 0, 6, 5, 3 }, { 0, 6, 5, 3 },
+   { 4, 1, 2, 7 }, { 4, 1, 2, 7 }, { 0, 6, 5, 3 } },
+ { { 0, 5, 6, 3 }, { 4, 1, 2, 7 }, { 4, 1, 2, 7 },
+   { 0, 6, 5, 3 }, { 0, 6, 5, 3 }, { 4, 1, 2, 7 } },
+ { { 0, 5, 6, 3 }, { 4, 1, 2, 7 }, { 4, 1, 2, 7 },
+   { 0, 6, 5, 3 }, { 0, 6, 5, 3 }, { 4, 1, 2, 7 } },
+ { { 4, 1, 2, 7 }, { 0, 5, 6, 3 }, { 0, 5, 6, 3 },
+   { 4, 1, 2, 7 }, { 4, 1, 2, 7 }, { 0, 6, 5, 3 } },
+ { { 4, 1, 2, 7 }, { 0, 5, 6, 3 }, { 0, 5, 6, 3 },
+   { 4, 1, 2, 7 }, { 4, 1, 2, 7 }, { 0, 6, 5, 3 } },
+ { { 0, 5, 6, 3 }, { 4, 1, 2, 7 }, { 4, 1, 2, 7 },
+   { 0, 5, 6, 3 }, { 0, 5, 6, 3 }, { 4, 1, 2, 7 } }};
 
 const int           p8est_edge_faces[12][2] =
 {{ 2, 4 },
@@ -932,7 +958,7 @@ p8est_find_edge_transform_internal (p4est_connectivity_t * conn,
 {
   int                 i, j;
   int                 redge, nedge, iflip, nflip;
-  int                 pref, pset, fc[2], nc[2];
+  int                 pset, fc[2], nc[2];
   int                 face, nface, orient, eorient;
   p4est_topidx_t      etree, ietree, ntree;
   p8est_edge_transform_t *et;
@@ -960,8 +986,7 @@ p8est_find_edge_transform_internal (p4est_connectivity_t * conn,
       nface %= P4EST_FACES;
       fcorners = &(p8est_edge_face_corners[iedge][face][0]);
       P4EST_ASSERT (fcorners[0] >= 0 && fcorners[1] >= 0);
-      pref = p8est_face_permutation_refs[face][nface];
-      pset = p8est_face_permutation_sets[pref][orient];
+      pset = p8est_face_permutation_orientations[face][nface][orient];
       fc[0] = p8est_face_permutations[pset][fcorners[0]];
       fc[1] = p8est_face_permutations[pset][fcorners[1]];
 
@@ -1032,8 +1057,8 @@ p8est_find_edge_transform_internal (p4est_connectivity_t * conn,
         P4EST_ASSERT (fcorners[i][0] >= 0);
         nfcorners = p8est_edge_face_corners[nedge][nfaces[i]];
         if (nfcorners[0] >= 0) {
-          pref = p8est_face_permutation_refs[faces[i]][nfaces[i]];
-          pset = p8est_face_permutation_sets[pref][orients[i]];
+          pset = p8est_face_permutation_orientations
+            [faces[i]][nfaces[i]][orients[i]];
           fc[0] = p8est_face_permutations[pset][fcorners[i][0]];
           fc[1] = p8est_face_permutations[pset][fcorners[i][1]];
 
@@ -1075,7 +1100,7 @@ int
 p8est_connectivity_face_neighbor_edge_orientation (int e, int f,
                                                    int nf, int o)
 {
-  int                 fe, nfe, pref, pset;
+  int                 fe, nfe, pset;
 
   P4EST_ASSERT (0 <= e && e < P8EST_EDGES);
   P4EST_ASSERT (0 <= f && f < P4EST_FACES);
@@ -1085,8 +1110,7 @@ p8est_connectivity_face_neighbor_edge_orientation (int e, int f,
   fe = p8est_edge_face_edges[e][f];
   P4EST_ASSERT (0 <= fe && fe < P4EST_HALF);
 
-  pref = p8est_face_permutation_refs[f][nf];
-  pset = p8est_face_edge_permutation_sets[pref][o];
+  pset = p8est_face_edge_permutation_orientations[f][nf][o];
   nfe = p8est_face_edge_permutations[pset][fe];
 
   P4EST_ASSERT (0 <= nfe && nfe < P4EST_HALF);
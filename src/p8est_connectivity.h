@@ -257,6 +257,12 @@ extern const int    p8est_face_permutation_sets[3][4];
  * The order is [my_face][neighbor_face] */
 extern const int    p8est_face_permutation_refs[6][6];
 
+/** Store the permutation for each face combination and orientation.
+ * This is p8est_face_permutation_sets composed over
+ * p8est_face_permutation_refs, saving one dependent load in inner
+ * loops.  The order is [my_face][neighbor_face][orientation]. */
+extern const int    p8est_face_permutation_orientations[6][6][4];
+
 /* face edges */
 
 /** Store only the 8 out of 24 possible permutations that occur. */
@@ -265,6 +271,12 @@ extern const int    p8est_face_edge_permutations[8][4];
 /** Store the 3 occurring sets of 4 permutations per face. */
 extern const int    p8est_face_edge_permutation_sets[3][4];
 
+/** Store the edge permutation for each face combination and orientation.
+ * This is p8est_face_edge_permutation_sets composed over
+ * p8est_face_permutation_refs.
+ * The order is [my_face][neighbor_face][orientation]. */
+extern const int    p8est_face_edge_permutation_orientations[6][6][4];
+
 /** Store the face numbers 0..5 for each tree edge. */
 extern const int    p8est_edge_faces[12][2];
 
@@ -437,6 +449,129 @@ p8est_connectivity_t *p8est_connectivity_bcast (p8est_connectivity_t *
                                                 conn_in, int root,
                                                 sc_MPI_Comm comm);
 
+/** Share one connectivity among the processes of a node.
+ *  With MPI-3 the connectivity arrays are placed in a shared memory
+ *  window so that one copy serves all processes of \a intranode_comm;
+ *  without it every process receives a private deep copy.
+ *  This function is collective over \a intranode_comm, which should
+ *  span exactly one shared memory domain, e.g. as obtained from
+ *  MPI_Comm_split_type with MPI_COMM_TYPE_SHARED.
+ *  \param [in] conn_in For the root process the connectivity to share,
+ *                      for the other processes it must be NULL.
+ *                      It is not modified and may be destroyed afterwards.
+ *  \param [in] root    The rank of the process that provides the connectivity.
+ *  \param [in] intranode_comm  The node-local MPI communicator.
+ *  \return             A connectivity with the same values as \a conn_in
+ *                      on the root process.  It must be treated as
+ *                      read-only and freed collectively with
+ *                      \ref p8est_connectivity_unshare, never with
+ *                      \ref p8est_connectivity_destroy.
+ */
+p8est_connectivity_t *p8est_connectivity_share (p8est_connectivity_t *
+                                                conn_in, int root,
+                                                sc_MPI_Comm intranode_comm);
+
+/** Free a connectivity created by \ref p8est_connectivity_share.
+ *  Collective over the communicator passed at creation time.
+ *  \param [in,out] conn Connectivity previously returned by
+ *                       \ref p8est_connectivity_share.
+ */
+void                p8est_connectivity_unshare (p8est_connectivity_t * conn);
+
+/** One face-adjacency row of a distributed connectivity.
+ * This is the per-tree information consulted by neighbor and transform
+ * lookups; it is the unit of storage, caching, and remote transfer.
+ */
+typedef struct p8est_connectivity_row
+{
+  p4est_topidx_t      which_tree;       /**< global tree number */
+  p4est_topidx_t      tree_to_tree[P8EST_FACES];        /**< as in
+                                             \ref p8est_connectivity_t */
+  int8_t              tree_to_face[P8EST_FACES];        /**< as in
+                                             \ref p8est_connectivity_t */
+}
+p8est_connectivity_row_t;
+
+/** Partitioned storage of the face adjacency of a connectivity.
+ * Every process permanently holds the rows of a contiguous block of
+ * trees plus a cache seeded with the rows the local partition touches,
+ * so the replicated \ref p8est_connectivity_t can be destroyed after
+ * construction and its per-tree arrays no longer bound the mesh size.
+ * Rows of other trees are fetched on demand from the owning process
+ * and retained in the cache.  Corner and edge adjacency, vertices, and
+ * attributes are not distributed; algorithms that require them must
+ * keep the replicated connectivity.
+ */
+typedef struct p8est_connectivity_dist
+{
+  sc_MPI_Comm         mpicomm;      /**< communicator of the distribution */
+  int                 mpirank, mpisize;     /**< size and rank within it */
+  p4est_topidx_t      num_trees;    /**< global number of trees */
+  p4est_topidx_t      first_owned;  /**< first tree of the owned block */
+  p4est_topidx_t      num_owned;    /**< number of owned trees */
+  p8est_connectivity_row_t *owned;  /**< rows of the owned block */
+  sc_array_t         *cached;       /**< fetched and preseeded rows of
+                                         \ref p8est_connectivity_row_t,
+                                         sorted by tree number */
+  long                num_fetches;  /**< remote rows fetched so far */
+}
+p8est_connectivity_dist_t;
+
+/** Distribute the face adjacency of a replicated connectivity.
+ *  The trees are assigned to the processes in uniform contiguous
+ *  blocks; each process copies its block out of \a conn and seeds its
+ *  cache with the rows for the trees [\a cache_first, \a cache_last]
+ *  and all their face neighbors, typically the local tree range of the
+ *  process so that neighbor lookups of the partition never leave the
+ *  process.  With MPI-3 the owned block is exposed in a passive-target
+ *  RMA window that serves the on-demand fetches of other processes;
+ *  without it every process keeps all rows, which preserves the query
+ *  semantics at the replicated memory footprint.
+ *  This function is collective over \a mpicomm.
+ *  \param [in] conn         replicated connectivity, identical on all
+ *                           processes; it is not modified and may be
+ *                           destroyed afterwards to reclaim its memory.
+ *  \param [in] mpicomm      the communicator to distribute over.
+ *  \param [in] cache_first  first tree to seed the cache with.
+ *  \param [in] cache_last   last tree to seed the cache with; may be
+ *                           \a cache_first - 1 for an empty seed range.
+ *  \return                  the distributed face adjacency; free it
+ *                           collectively with
+ *                           \ref p8est_connectivity_dist_destroy.
+ */
+p8est_connectivity_dist_t *p8est_connectivity_distribute
+  (p8est_connectivity_t * conn, sc_MPI_Comm mpicomm,
+   p4est_topidx_t cache_first, p4est_topidx_t cache_last);
+
+/** Look up the face adjacency row of any tree.
+ *  Owned and cached trees are served from process memory.  Other rows
+ *  are fetched from the owning process through the RMA window and
+ *  added to the cache, so repeated queries for the same tree hit the
+ *  fast path.  Remote fetches are not collective, but they do require
+ *  the window to stay exposed, i.e. they must happen strictly between
+ *  \ref p8est_connectivity_distribute and
+ *  \ref p8est_connectivity_dist_destroy on all processes.
+ *  \param [in] dist         the distributed face adjacency.
+ *  \param [in] which_tree   global tree number to query.
+ *  \param [out] ttree       filled with the P8EST_FACES neighbor trees.
+ *  \param [out] tface       filled with the P8EST_FACES neighbor faces.
+ */
+void                p8est_connectivity_dist_row (p8est_connectivity_dist_t *
+                                                 dist,
+                                                 p4est_topidx_t which_tree,
+                                                 p4est_topidx_t
+                                                 ttree[P8EST_FACES],
+                                                 int8_t
+                                                 tface[P8EST_FACES]);
+
+/** Free a distributed face adjacency.
+ *  Collective over the communicator passed at creation time.
+ *  \param [in,out] dist Distribution previously returned by
+ *                       \ref p8est_connectivity_distribute.
+ */
+void                p8est_connectivity_dist_destroy (p8est_connectivity_dist_t
+                                                     * dist);
+
 /** Destroy a connectivity structure.  Also destroy all attributes.
  */
 void                p8est_connectivity_destroy (p8est_connectivity_t *
@@ -510,6 +645,23 @@ p8est_connectivity_t *p8est_connectivity_inflate (sc_array_t * buffer);
 p8est_connectivity_t *p8est_connectivity_load (const char *filename,
                                                size_t * bytes);
 
+/** Map a connectivity structure from disk into read-only memory.
+ * The connectivity arrays point into a shared file mapping, so all
+ * processes on a node reference one copy of the data in the page cache.
+ * The connectivity must be treated as read-only and freed with
+ * \ref p8est_connectivity_munmap, never \ref p8est_connectivity_destroy.
+ * On systems without mmap this falls back to \ref p8est_connectivity_load.
+ * \param [in] filename         Name of the file to map.
+ * \return              Returns valid connectivity, or NULL on file error.
+ */
+p8est_connectivity_t *p8est_connectivity_mmap (const char *filename);
+
+/** Free a connectivity created by \ref p8est_connectivity_mmap.
+ * \param [in,out] conn Connectivity previously returned by
+ *                      \ref p8est_connectivity_mmap.
+ */
+void                p8est_connectivity_munmap (p8est_connectivity_t * conn);
+
 /** Create a connectivity structure for the unit cube.
  */
 p8est_connectivity_t *p8est_connectivity_new_unitcube (void);
@@ -672,6 +824,22 @@ void                p8est_connectivity_complete (p8est_connectivity_t * conn);
  */
 void                p8est_connectivity_reduce (p8est_connectivity_t * conn);
 
+/** Make sure the edge and corner adjacency tables of a connectivity exist.
+ * This is the lazy counterpart to \ref p8est_connectivity_reduce:
+ * face-only runs may reduce a connectivity on creation, or load a
+ * reduced one, and defer the cost and memory of the ett and ctt tables
+ * until a code path actually queries edge or corner neighbors.
+ * When the tables are already present this function returns
+ * immediately, so it is safe to call on every first access.
+ * Otherwise it runs \ref p8est_connectivity_complete, which requires
+ * proper vertex information; see the warnings given there.
+ * \param [in,out] conn     A valid connectivity; its edge and corner
+ *                          tables are constructed if and only if they
+ *                          are absent.
+ */
+void                p8est_connectivity_require_corners (p8est_connectivity_t *
+                                                        conn);
+
 /** p8est_connectivity_permute
  * Given a permutation \a perm of the trees in a connectivity \a conn,
  * permute the trees of \a conn in place and update \a conn to match.
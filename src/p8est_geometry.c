@@ -137,6 +137,73 @@ p8est_geometry_shell_X (p8est_geometry_t * geom,
   }
 }
 
+static void
+p8est_geometry_shell_X_v (p8est_geometry_t * geom,
+                          p4est_topidx_t which_tree,
+                          size_t num_points, const double *rst, double *xyz)
+{
+  const struct p8est_geometry_builtin_shell *shell
+    = &((p8est_geometry_builtin_t *) geom)->p.shell;
+  /* axis permutation and signs of (q * x, q * y, q) per patch,
+   * equivalent to the switch in p8est_geometry_shell_X */
+  static const int    perm[6][3] = {
+    {2, 0, 1},                  /* right */
+    {1, 0, 2},                  /* bottom */
+    {2, 0, 1},                  /* left */
+    {1, 0, 2},                  /* top */
+    {0, 2, 1},                  /* back */
+    {0, 2, 1}                   /* front */
+  };
+  static const double sign[6][3] = {
+    {+1., -1., -1.},            /* right */
+    {-1., -1., -1.},            /* bottom */
+    {-1., -1., +1.},            /* left */
+    {+1., -1., +1.},            /* top */
+    {-1., +1., +1.},            /* back */
+    {+1., -1., +1.}             /* front */
+  };
+  const int           patch = (int) (which_tree / 4);
+  const double        R2byR1 = shell->R2byR1;
+  const double        R1sqrbyR2 = shell->R1sqrbyR2;
+  double              cv[P4EST_CHILDREN][3];
+  double              abc[3], s[3];
+  double              x, y, R, q;
+  size_t              iz;
+
+  P4EST_ASSERT (shell->type == P8EST_GEOMETRY_BUILTIN_SHELL);
+  P4EST_ASSERT (0 <= which_tree && which_tree < 24);
+
+  /* gather the tree corners once for all points */
+  p4est_geometry_tree_corners ((p4est_connectivity_t *) geom->user,
+                               which_tree, cv);
+
+  for (iz = 0; iz < num_points; ++iz) {
+    /* transform from the reference cube into vertex space */
+    p4est_geometry_corners_X ((const double (*)[3]) cv, rst + 3 * iz, abc);
+
+    /* assert that input points are in the expected range */
+    P4EST_ASSERT (abc[0] < 1.0 + SC_1000_EPS && abc[0] > -1.0 - SC_1000_EPS);
+    P4EST_ASSERT (abc[1] < 1.0 + SC_1000_EPS && abc[1] > -1.0 - SC_1000_EPS);
+    P4EST_ASSERT (abc[2] < 2.0 + SC_1000_EPS && abc[2] > 1.0 - SC_1000_EPS);
+
+    /* transform abc[0] and abc[1] in-place for nicer grading */
+    x = tan (abc[0] * M_PI_4);
+    y = tan (abc[1] * M_PI_4);
+
+    /* compute transformation ingredients */
+    R = R1sqrbyR2 * pow (R2byR1, abc[2]);
+    q = R / sqrt (x * x + y * y + 1.);
+
+    /* assign correct coordinates based on patch id */
+    s[0] = q * x;
+    s[1] = q * y;
+    s[2] = q;
+    xyz[3 * iz + 0] = sign[patch][0] * s[perm[patch][0]];
+    xyz[3 * iz + 1] = sign[patch][1] * s[perm[patch][1]];
+    xyz[3 * iz + 2] = sign[patch][2] * s[perm[patch][2]];
+  }
+}
+
 p8est_geometry_t   *
 p8est_geometry_new_shell (p8est_connectivity_t * conn, double R2, double R1)
 {
@@ -156,6 +223,7 @@ p8est_geometry_new_shell (p8est_connectivity_t * conn, double R2, double R1)
   builtin->geom.name = "p8est_shell";
   builtin->geom.user = conn;
   builtin->geom.X = p8est_geometry_shell_X;
+  builtin->geom.X_v = p8est_geometry_shell_X_v;
 
   return (p8est_geometry_t *) builtin;
 }
@@ -264,6 +332,128 @@ p8est_geometry_sphere_X (p8est_geometry_t * geom,
   }
 }
 
+static void
+p8est_geometry_sphere_X_v (p8est_geometry_t * geom,
+                           p4est_topidx_t which_tree,
+                           size_t num_points, const double *rst, double *xyz)
+{
+  const struct p8est_geometry_builtin_sphere *sphere
+    = &((p8est_geometry_builtin_t *) geom)->p.sphere;
+  /* axis permutation and signs of (q * x, q * y, q) per direction,
+   * equivalent to the switch in p8est_geometry_sphere_X */
+  static const int    perm[6][3] = {
+    {0, 2, 1},                  /* front */
+    {0, 1, 2},                  /* top */
+    {0, 2, 1},                  /* back */
+    {2, 0, 1},                  /* right */
+    {1, 0, 2},                  /* bottom */
+    {2, 0, 1}                   /* left */
+  };
+  static const double sign[6][3] = {
+    {+1., -1., +1.},            /* front */
+    {+1., +1., +1.},            /* top */
+    {+1., +1., -1.},            /* back */
+    {+1., -1., -1.},            /* right */
+    {-1., -1., -1.},            /* bottom */
+    {-1., -1., +1.}             /* left */
+  };
+  const int           patch = (int) (which_tree % 6);
+  double              cv[P4EST_CHILDREN][3];
+  double              abc[3], s[3];
+  double              x, y, R, q;
+  size_t              iz;
+
+  P4EST_ASSERT (sphere->type == P8EST_GEOMETRY_BUILTIN_SPHERE);
+  P4EST_ASSERT (0 <= which_tree && which_tree < 13);
+
+  /* gather the tree corners once for all points */
+  p4est_geometry_tree_corners ((p4est_connectivity_t *) geom->user,
+                               which_tree, cv);
+
+  if (which_tree >= 12) {       /* center cube */
+    const double        Clength = sphere->Clength;
+
+    for (iz = 0; iz < num_points; ++iz) {
+      p4est_geometry_corners_X ((const double (*)[3]) cv, rst + 3 * iz, abc);
+      P4EST_ASSERT (abc[0] < 1.0 + SC_1000_EPS && abc[0] > -1.0 - SC_1000_EPS);
+      P4EST_ASSERT (abc[1] < 1.0 + SC_1000_EPS && abc[1] > -1.0 - SC_1000_EPS);
+      P4EST_ASSERT (abc[2] < 1.0 + SC_1000_EPS && abc[2] > -1.0 - SC_1000_EPS);
+
+      xyz[3 * iz + 0] = abc[0] * Clength;
+      xyz[3 * iz + 1] = abc[1] * Clength;
+      xyz[3 * iz + 2] = abc[2] * Clength;
+    }
+    return;
+  }
+
+  if (which_tree < 6) {         /* outer shell */
+    const double        dist = 1. / 8.; /* keep it inside the tree */
+    const double        R2byR1 = sphere->R2byR1;
+    const double        R1sqrbyR2 = sphere->R1sqrbyR2;
+
+    for (iz = 0; iz < num_points; ++iz) {
+      double              z_cmb;
+
+      p4est_geometry_corners_X ((const double (*)[3]) cv, rst + 3 * iz, abc);
+      P4EST_ASSERT (abc[0] < 1.0 + SC_1000_EPS && abc[0] > -1.0 - SC_1000_EPS);
+      P4EST_ASSERT (abc[1] < 1.0 + SC_1000_EPS && abc[1] > -1.0 - SC_1000_EPS);
+      P4EST_ASSERT (abc[2] < 2.0 + SC_1000_EPS && abc[2] > 1.0 - SC_1000_EPS);
+
+      z_cmb = abc[2] - (1. + 5. / 8.);
+      x = tan (abc[0] * M_PI_4);
+      y = tan (abc[1] * M_PI_4);
+      if (fabs (z_cmb) < dist) {
+        /* correct z grading for the PREM model */
+        const double        correction = 0.008873;
+
+        R = R1sqrbyR2 * pow (R2byR1,
+                             abc[2] + correction *
+                             exp (1. / (dist * dist) -
+                                  1. / ((z_cmb + dist) * (dist - z_cmb))));
+      }
+      else {
+        R = R1sqrbyR2 * pow (R2byR1, abc[2]);
+      }
+      q = R / sqrt (x * x + y * y + 1.);
+
+      s[0] = q * x;
+      s[1] = q * y;
+      s[2] = q;
+      xyz[3 * iz + 0] = sign[patch][0] * s[perm[patch][0]];
+      xyz[3 * iz + 1] = sign[patch][1] * s[perm[patch][1]];
+      xyz[3 * iz + 2] = sign[patch][2] * s[perm[patch][2]];
+    }
+  }
+  else {                        /* inner shell */
+    const double        R1byR0 = sphere->R1byR0;
+    const double        R0sqrbyR1 = sphere->R0sqrbyR1;
+
+    for (iz = 0; iz < num_points; ++iz) {
+      double              p, tanx, tany;
+
+      p4est_geometry_corners_X ((const double (*)[3]) cv, rst + 3 * iz, abc);
+      P4EST_ASSERT (abc[0] < 1.0 + SC_1000_EPS && abc[0] > -1.0 - SC_1000_EPS);
+      P4EST_ASSERT (abc[1] < 1.0 + SC_1000_EPS && abc[1] > -1.0 - SC_1000_EPS);
+      P4EST_ASSERT (abc[2] < 2.0 + SC_1000_EPS && abc[2] > 1.0 - SC_1000_EPS);
+
+      p = 2. - abc[2];
+      tanx = tan (abc[0] * M_PI_4);
+      tany = tan (abc[1] * M_PI_4);
+      x = p * abc[0] + (1. - p) * tanx;
+      y = p * abc[1] + (1. - p) * tany;
+      R = R0sqrbyR1 * pow (R1byR0, abc[2]);
+      q = R / sqrt (1. + (1. - p) * (tanx * tanx + tany * tany) + 2. * p);
+
+      s[0] = q * x;
+      s[1] = q * y;
+      s[2] = q;
+      xyz[3 * iz + 0] = sign[patch][0] * s[perm[patch][0]];
+      xyz[3 * iz + 1] = sign[patch][1] * s[perm[patch][1]];
+      xyz[3 * iz + 2] = sign[patch][2] * s[perm[patch][2]];
+    }
+  }
+}
+
 p8est_geometry_t   *
 p8est_geometry_new_sphere (p8est_connectivity_t * conn,
                            double R2, double R1, double R0)
@@ -296,6 +486,7 @@ p8est_geometry_new_sphere (p8est_connectivity_t * conn,
   builtin->geom.name = "p8est_sphere";
   builtin->geom.user = conn;
   builtin->geom.X = p8est_geometry_sphere_X;
+  builtin->geom.X_v = p8est_geometry_sphere_X_v;
 
   return (p8est_geometry_t *) builtin;
 }
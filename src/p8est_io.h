@@ -66,4 +66,202 @@ p8est_t            *p8est_inflate (sc_MPI_Comm mpicomm,
                                    sc_array_t * quadrants, sc_array_t * data,
                                    void *user_pointer);
 
+/** Extract processor local quadrants into a compressed byte stream.
+ * Since the quadrants are Morton-sorted, each one is stored as its level
+ * and the variable-length encoded delta of first-descendant linear ids,
+ * which is typically several times smaller than the plain representation.
+ * The deltas restart at zero for every tree.
+ * \param [in] p8est    The forest is not modified.
+ * \param [in,out] data If not NULL, pointer to a pointer that will be set
+ *                      to a newly allocated array with per-quadrant data.
+ *                      Must be NULL if p8est->data_size == 0.
+ * \return              A byte array encoding all local quadrants, to be
+ *                      passed to \ref p8est_inflate_compressed.
+ */
+sc_array_t         *p8est_deflate_quadrants_compressed (p8est_t * p8est,
+                                                        sc_array_t ** data);
+
+/** Create a new p8est from a compressed quadrant stream.
+ * The counterpart of \ref p8est_deflate_quadrants_compressed; all other
+ * parameters and the result are as in \ref p8est_inflate.
+ * \param [in] cquadrants    Byte array as returned by
+ *                           \ref p8est_deflate_quadrants_compressed.
+ * \return              The newly created p8est with a zero revision counter.
+ */
+p8est_t            *p8est_inflate_compressed (sc_MPI_Comm mpicomm,
+                                              p8est_connectivity_t *
+                                              connectivity,
+                                              const p4est_gloidx_t *
+                                              global_first_quadrant,
+                                              const p4est_gloidx_t * pertree,
+                                              sc_array_t * cquadrants,
+                                              sc_array_t * data,
+                                              void *user_pointer);
+
+/** Create a new p8est from a trusted quadrant stream.
+ * Behaves like \ref p8est_inflate, but assumes the stream was produced
+ * by a matching deflate call and skips the full consistency checks,
+ * including the final forest validation in debug builds.  Instead,
+ * roughly one percent of the octants are sampling-verified and any
+ * failure aborts.  This serves restart loops that inflate thousands of
+ * times from streams the same binary wrote.  The \a quadrants array
+ * may be either the plain coordinate array of
+ * \ref p8est_deflate_quadrants or the byte stream of
+ * \ref p8est_deflate_quadrants_compressed; the two are told apart by
+ * their element size.
+ * \param [in] quadrants     Array from one of the deflate variants.
+ * \return              The newly created p8est with a zero revision counter.
+ */
+p8est_t            *p8est_inflate_trusted (sc_MPI_Comm mpicomm,
+                                           p8est_connectivity_t *
+                                           connectivity,
+                                           const p4est_gloidx_t *
+                                           global_first_quadrant,
+                                           const p4est_gloidx_t * pertree,
+                                           sc_array_t * quadrants,
+                                           sc_array_t * data,
+                                           void *user_pointer);
+
+/** A pluggable codec for the per-octant payload of analysis dumps.
+ * The callbacks may implement an error-bounded lossy compressor for
+ * float state that does not feed a bit-exact restart; the structure is
+ * a plain pair of function pointers so external codec libraries can be
+ * wrapped without p4est depending on them.
+ */
+typedef struct p8est_data_codec
+{
+  /** Encode \a count payload records of \a data_size bytes each from
+   * \a src, appending the encoded bytes to \a dest (element size 1).
+   * Called once per local tree, possibly from concurrent threads.
+   * Return 0 on success; nonzero aborts the save. */
+  int                 (*encode) (const char *src, size_t count,
+                                 size_t data_size, sc_array_t * dest,
+                                 void *user);
+  /** Decode the \a nbytes encoded bytes at \a src into exactly
+   * \a count records of \a data_size bytes at \a dest.
+   * Return 0 on success; nonzero aborts the load. */
+  int                 (*decode) (const char *src, size_t nbytes,
+                                 size_t count, size_t data_size,
+                                 char *dest, void *user);
+  void               *user;     /**< passed through to both callbacks,
+                                     e.g. holding an error bound */
+}
+p8est_data_codec_t;
+
+/** Write the octant payload of all local trees through a codec.
+ * Each local tree's payload is gathered contiguously and encoded as
+ * one chunk; the chunks are independent and are encoded
+ * thread-parallel when p4est is configured with \c --enable-openmp.
+ * The buffer holds this processor's framed chunks only; the caller
+ * persists it, e.g. next to a \ref p8est_save with save_data false,
+ * keeping bit-exact restart files separate from smaller analysis
+ * dumps.  Not collective.
+ * \param [in] p8est       Valid forest with positive data size.
+ * \param [in] codec       Codec whose encode callback is used.
+ * \param [in,out] buffer  Array of bytes (element size 1); it is
+ *                         resized and overwritten.
+ * \return                 Byte count of this processor's buffer.
+ */
+size_t              p8est_save_data_encoded (p8est_t * p8est,
+                                             p8est_data_codec_t * codec,
+                                             sc_array_t * buffer);
+
+/** Read a payload buffer written by \ref p8est_save_data_encoded.
+ * The forest must hold the same local trees and octant counts as at
+ * the time of the save, e.g. after reloading the matching checkpoint,
+ * and allocated octant data of the recorded size.  The per-tree
+ * chunks are decoded thread-parallel and written into the octant
+ * payload storage.  Not collective.
+ * \param [in,out] p8est   Valid forest with positive data size.
+ * \param [in] codec       Codec whose decode callback is used.
+ * \param [in] buffer      This processor's buffer from the save.
+ */
+void                p8est_load_data_encoded (p8est_t * p8est,
+                                             p8est_data_codec_t * codec,
+                                             sc_array_t * buffer);
+
+/** Replicate the whole forest as a serial forest on a team of ranks.
+ * The quadrant stream of every process, and the quadrant payload if
+ * the data size is positive, is gathered onto the first \a team_size
+ * ranks, which each inflate a forest over sc_MPI_COMM_SELF holding all
+ * global quadrants.  This serves a replicated direct solve on the
+ * coarsest level of a multigrid hierarchy.  The replicated forest
+ * shares the connectivity of \a p8est; its payload moves back with
+ * \ref p8est_scatter_from_team.  The byte counts of the gathered
+ * streams must fit an int, which holds for the coarse forests this is
+ * meant for.  This function is collective on the forest's
+ * communicator.
+ * \param [in] team_size  Number of ranks receiving the replica,
+ *                        identical on every process.
+ * \return          The replicated serial forest on the first
+ *                  \a team_size ranks and NULL elsewhere.  Destroy it
+ *                  with \ref p8est_destroy before the original forest.
+ */
+p8est_t            *p8est_gather_to_team (p8est_t * p8est, int team_size);
+
+/** Return the payload of a replicated forest to the distributed one.
+ * The inverse of \ref p8est_gather_to_team for the quadrant data: the
+ * first team rank scatters the replica's payload along the original
+ * partition and every process copies its slice into the local
+ * quadrants.  The forest structure must not have changed in between.
+ * With a data size of zero this function does nothing.  This function
+ * is collective on the forest's communicator.
+ * \param [in] p8est    The distributed forest, unchanged since the
+ *                      matching \ref p8est_gather_to_team.
+ * \param [in] team     The replicated forest on team ranks and NULL
+ *                      elsewhere; required on rank zero.
+ */
+void                p8est_scatter_from_team (p8est_t * p8est,
+                                             p8est_t * team);
+
+/** Pager that holds cold trees of a forest on disk.
+ * Created by \ref p8est_tree_pager_new; while it exists, the forest
+ * must not be refined, coarsened, balanced, or partitioned, and only
+ * trees that are currently resident may be accessed.
+ */
+typedef struct p8est_tree_pager p8est_tree_pager_t;
+
+/** Start paging the local trees of a forest to a per-rank file.
+ * The octants and the user data of an evicted tree are written in
+ * the deflate stream layout and their memory is returned to the
+ * forest's pools; since the stream size of a tree is fixed, every
+ * tree has a reserved region in the file.  All trees start resident.
+ * Not collective.
+ * \param [in] p8est         Valid forest; it must stay unadapted and
+ *                           unpartitioned while the pager exists.
+ * \param [in] directory     Writable directory, e.g. on a local NVMe.
+ * \param [in] max_resident  Resident byte budget enforced by
+ *                           \ref p8est_tree_fetch, or 0 for no bound.
+ * \return                   Pager with all trees resident.
+ */
+p8est_tree_pager_t *p8est_tree_pager_new (p8est_t * p8est,
+                                          const char *directory,
+                                          size_t max_resident);
+
+/** Write one resident local tree to the backing file and free it.
+ * The per-level counters and descendant range remain in the tree, so
+ * the forest's global counts stay intact; only the octant storage
+ * and payload are released until the next \ref p8est_tree_fetch.
+ * \param [in,out] pager       Valid pager.
+ * \param [in] which_tree      Resident local tree to page out.
+ */
+void                p8est_tree_evict (p8est_tree_pager_t * pager,
+                                      p4est_topidx_t which_tree);
+
+/** Make a local tree resident, paging it in if necessary.
+ * Marks the tree most recently used; afterwards, least recently used
+ * trees are evicted until the pager's byte budget is respected again.
+ * Call this before touching a tree's octants in any way.
+ * \param [in,out] pager       Valid pager.
+ * \param [in] which_tree      Local tree to access next.
+ */
+void                p8est_tree_fetch (p8est_tree_pager_t * pager,
+                                      p4est_topidx_t which_tree);
+
+/** Fetch all remaining trees, delete the backing file, free the pager.
+ * The forest is left fully resident and valid.
+ * \param [in,out] pager       Pager to deallocate.
+ */
+void                p8est_tree_pager_destroy (p8est_tree_pager_t * pager);
+
 #endif /* !P8EST_IO_H */
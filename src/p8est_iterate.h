@@ -321,6 +321,171 @@ void                p8est_iterate (p8est_t * p4est,
                                    p8est_iter_edge_t iter_edge,
                                    p8est_iter_corner_t iter_corner);
 
+/** Execute the same callbacks as \ref p8est_iterate with a threaded
+ * volume pass.
+ *
+ * When p4est is configured with \c --enable-openmp, the volume callback
+ * is executed tree-parallel across an OpenMP thread team; it must then
+ * be safe to call concurrently from different threads.  Within each tree
+ * the quadrants are still visited in Morton order, but no ordering holds
+ * between trees or between the volume pass and the other callbacks.
+ * The face, edge, and corner callbacks are executed by the serial code
+ * path.  Trees are assigned to threads with a static schedule, so the
+ * storage placement of \ref p8est_numa_first_touch stays local to its
+ * reader.  Without OpenMP this function behaves like \ref p8est_iterate
+ * except for the relaxed callback ordering.
+ */
+void                p8est_iterate_threaded (p8est_t * p4est,
+                                            p8est_ghost_t * ghost_layer,
+                                            void *user_data,
+                                            p8est_iter_volume_t iter_volume,
+                                            p8est_iter_face_t iter_face,
+                                            p8est_iter_edge_t iter_edge,
+                                            p8est_iter_corner_t iter_corner);
+
+/** One callback set of a fused iteration; see \ref p8est_iterate_fused. */
+typedef struct p8est_iter_phase
+{
+  p8est_iter_volume_t volume_fn;        /**< may be NULL */
+  p8est_iter_face_t   face_fn;  /**< may be NULL */
+  p8est_iter_edge_t   edge_fn;  /**< may be NULL */
+  p8est_iter_corner_t corner_fn;        /**< may be NULL */
+  void               *user_data;        /**< passed to this phase's
+                                             callbacks */
+}
+p8est_iter_phase_t;
+
+/** Execute several callback sets in one fused traversal.
+ * Equivalent in effect to calling \ref p8est_iterate once per phase in
+ * array order, but the forest is traversed a single time: at every
+ * volume, face, edge, and corner the callbacks of all phases run back
+ * to back in phase order while the element's data is hot in cache.
+ * For bandwidth-bound steps composed of several sweeps this touches
+ * the octant data once per step instead of once per sweep.
+ * Note that fusing changes the interleaving between phases: a later
+ * phase's callback at one element runs before an earlier phase has
+ * seen the following elements.  Phases whose element computation needs
+ * the completed previous sweep over the whole forest must remain
+ * separate iterations.
+ * \param[in] p8est          the forest
+ * \param[in] ghost_layer    optional as in \ref p8est_iterate
+ * \param[in] num_phases     number of callback sets, at least one
+ * \param[in] phases         array of \a num_phases callback sets; only
+ *                           the callback types provided by at least
+ *                           one phase are computed at all
+ */
+void                p8est_iterate_fused (p8est_t * p8est,
+                                         p8est_ghost_t * ghost_layer,
+                                         int num_phases,
+                                         const p8est_iter_phase_t * phases);
+
+/** Execute a volume callback for the octants of one level only.
+ *
+ * The selected octants are visited in Morton order as in
+ * \ref p8est_iterate.  Trees without octants of \a level are skipped
+ * using the per-tree level counts, and within a tree the loop jumps
+ * over whole subtrees of finer octants by binary search.  The cost
+ * thus scales with the number of octants on the selected level and
+ * the subtrees skipped, not with the size of the forest, which suits
+ * level sweeps such as multigrid smoothers.
+ * \param[in] ghost_layer    optional as in \ref p8est_iterate
+ * \param[in] level          only octants of this level are visited
+ * \param[in] iter_volume    callback function for the matching octants
+ */
+void                p8est_iterate_level (p8est_t * p4est,
+                                         p8est_ghost_t * ghost_layer,
+                                         int level, void *user_data,
+                                         p8est_iter_volume_t iter_volume);
+
+/** A recorded iteration sequence for repeated replay on a fixed forest.
+ * The plan stores the flattened visit sequence of \ref p8est_iterate,
+ * with all octant pointers, indices, and face configurations resolved,
+ * so that repeated iterations replay a linear event list instead of
+ * redoing the tree recursion.  The plan references storage inside the
+ * forest and the ghost layer and is invalidated by any change to either.
+ */
+typedef struct p8est_iterate_plan
+{
+  p8est_t            *p4est;        /**< the forest at recording time */
+  p8est_ghost_t      *ghost_layer;  /**< the recorded ghost layer or NULL */
+  long                revision;     /**< forest revision at recording */
+  sc_array_t         *events;       /**< event categories in visit order */
+  sc_array_t         *volumes;      /**< recorded volume callback data */
+  sc_array_t         *faces;        /**< recorded face callback data */
+  sc_array_t         *face_sides;   /**< flat storage of all face sides */
+  sc_array_t         *face_counts;  /**< number of sides per face event */
+  sc_array_t         *edges;        /**< recorded edge callback data */
+  sc_array_t         *edge_sides;   /**< flat storage of all edge sides */
+  sc_array_t         *edge_counts;  /**< number of sides per edge event */
+  sc_array_t         *corners;      /**< recorded corner callback data */
+  sc_array_t         *corner_sides; /**< flat storage of all corner sides */
+  sc_array_t         *corner_counts;        /**< sides per corner event */
+}
+p8est_iterate_plan_t;
+
+/** Record the visit sequence of \ref p8est_iterate for later replay.
+ * The recursion runs once with all callback categories enabled; the
+ * events are stored with resolved octant indices.  The plan remains
+ * valid until the forest or the ghost layer changes and must be freed
+ * with \ref p8est_iterate_plan_destroy.
+ * \param[in] p4est          the forest, remains owned by the caller
+ * \param[in] ghost_layer    optional as in \ref p8est_iterate
+ * \return                   the recorded iteration plan
+ */
+p8est_iterate_plan_t *p8est_iterate_plan_new (p8est_t * p4est,
+                                              p8est_ghost_t * ghost_layer);
+
+/** Replay a recorded iteration plan as a linear sweep.
+ * The callbacks observe the same information and ordering as in the
+ * \ref p8est_iterate call that recorded the plan; categories whose
+ * callback is NULL are skipped.  The forest must not have been adapted,
+ * partitioned, or balanced since the plan was recorded.
+ */
+void                p8est_iterate_plan_execute (p8est_iterate_plan_t * plan,
+                                                void *user_data,
+                                                p8est_iter_volume_t
+                                                iter_volume,
+                                                p8est_iter_face_t iter_face,
+                                                p8est_iter_edge_t iter_edge,
+                                                p8est_iter_corner_t
+                                                iter_corner);
+
+/** Free all storage held by an iteration plan. */
+void                p8est_iterate_plan_destroy (p8est_iterate_plan_t * plan);
+
+/** Materialize all face events of \ref p8est_iterate into flat arrays.
+ * This serves callers that cannot afford per-event C callbacks, such as
+ * kernels written in another language: one pass over the recursion
+ * fills a plain struct-of-arrays description of every face event that
+ * \ref p8est_iterate would report, in the same order.
+ *
+ * Each face event occupies 2 * P8EST_HALF consecutive entries of
+ * \a quadids, first the slots of side zero, then of side one.  A full
+ * side uses its first slot and sets the remaining ones to -1; a hanging
+ * side fills all slots in child order.  Local octants are indexed
+ * cumulatively over the process, i.e. the tree offset is added; ghosts
+ * are indexed into the ghost array with their bit set in the matching
+ * \a ghost_flags bitmask, bit k for slot k of side zero and bit
+ * P8EST_HALF + k for side one.
+ *
+ * The packed \a face_codes entry holds the face number of side zero in
+ * bits 0-2 and of side one in bits 3-5, the orientation in bits 6-7,
+ * the hanging status of the sides in bits 8 and 9, and bit 10 set for a
+ * single-sided event on the domain boundary.
+ *
+ * \param[in] p8est          the forest, not changed by the export
+ * \param[in] ghost_layer    optional as in \ref p8est_iterate
+ * \param[in,out] quadids    resized; holds sizeof (p4est_locidx_t)
+ * \param[in,out] face_codes resized; holds sizeof (int16_t)
+ * \param[in,out] ghost_flags resized; holds sizeof (uint8_t)
+ * \return                   the number of face events exported
+ */
+p4est_locidx_t      p8est_iterate_export (p8est_t * p8est,
+                                          p8est_ghost_t * ghost_layer,
+                                          sc_array_t * quadids,
+                                          sc_array_t * face_codes,
+                                          sc_array_t * ghost_flags);
+
 /** Return a pointer to a iter_corner_side array element indexed by a int.
  */
 /*@unused@*/
@@ -102,6 +102,11 @@ typedef struct
   sc_array_t         *quad_level;       /**< stores lists of per-level quads,
                                              NULL by default */
 
+  int                 level_min;        /**< face adjacency is only built for
+                                             faces touching this level range */
+  int                 level_max;        /**< the default window is the full
+                                             0 .. P8EST_QMAXLEVEL range */
+
   /* These members are NULL if the connect_t is not P4EST_CONNECT_CORNER */
   /* CAUTION: tree-boundary corners not yet implemented */
   p4est_locidx_t      local_num_corners;        /* tree-boundary corners */
@@ -109,6 +114,16 @@ typedef struct
   sc_array_t         *corner_offset;    /* local_num_corners + 1 entries */
   sc_array_t         *corner_quad;      /* corner_offset indexes into this */
   sc_array_t         *corner_corner;    /* and this one too (type int8_t) */
+
+  /* These members are NULL unless p8est_mesh_compress has been called */
+  sc_array_t         *quad_to_packed;   /**< compressed face adjacency */
+  p4est_locidx_t     *quad_packed_offset;       /**< byte offset per quad */
+
+  /* These members are NULL unless p8est_mesh_attach_data has been called */
+  void              **quad_to_data;     /**< neighbor payload address for
+                                             each local quadrant face */
+  sc_array_t         *quad_to_half_data;        /**< payload addresses of
+                                             the half size neighbors */
 }
 p8est_mesh_t;
 
@@ -142,6 +157,52 @@ p8est_mesh_face_neighbor_t;
  */
 size_t              p8est_mesh_memory_used (p8est_mesh_t * mesh);
 
+/** Unified local memory usage of a forest and its derived structures.
+ * Filled by \ref p8est_memory_report.
+ */
+typedef struct p8est_memory_report
+{
+  size_t              forest_bytes;     /**< \ref p8est_memory_used */
+  size_t              connectivity_bytes;       /**< usage of the shared
+                                                     connectivity */
+  size_t              ghost_bytes;      /**< zero without a ghost layer */
+  size_t              mesh_bytes;       /**< zero without a mesh */
+  size_t              balance_memory_peak;      /**< from the inspect
+                                                     structure, or zero */
+  size_t              partition_memory_peak;    /**< likewise */
+  size_t              total_bytes;      /**< sum of the persistent usage */
+
+  /* breakdown of the memory pools; already counted in forest_bytes */
+  size_t              data_pool_live;   /**< user data allocations in use */
+  size_t              data_pool_peak;   /**< most user data allocations
+                                             ever in use at once */
+  size_t              data_pool_reclaimable;    /**< bytes sitting on the
+                                             user data pool's free list;
+                                             \ref p8est_memory_compact
+                                             returns them */
+  size_t              data_pool_bytes;  /**< total bytes held by the user
+                                             data pool */
+  size_t              quadrant_pool_bytes;      /**< total bytes held by
+                                             the scratch octant pool */
+}
+p8est_memory_report_t;
+
+/** Collect the local memory usage of a forest and its companions.
+ * Not collective.  Complements the individual memory_used functions by
+ * gathering them in one call together with the transient high-water
+ * marks recorded in the attached inspect structure, which capture the
+ * peaks inside balance and partition that polling the persistent usage
+ * misses.
+ * \param [in] p8est    Valid forest structure.
+ * \param [in] ghost    Optional ghost layer of the forest, may be NULL.
+ * \param [in] mesh     Optional mesh of the forest, may be NULL.
+ * \param [out] report  Filled with the usage in bytes.
+ */
+void                p8est_memory_report (p8est_t * p8est,
+                                         p8est_ghost_t * ghost,
+                                         p8est_mesh_t * mesh,
+                                         p8est_memory_report_t * report);
+
 /** Create a p8est_mesh structure.
  * \param [in] p8est    A forest that is fully 2:1 balanced.
  * \param [in] ghost    The ghost layer created from the provided p4est.
@@ -151,6 +212,123 @@ size_t              p8est_mesh_memory_used (p8est_mesh_t * mesh);
 p8est_mesh_t       *p8est_mesh_new (p8est_t * p8est, p8est_ghost_t * ghost,
                                     p8est_connect_type_t btype);
 
+/** Create a ghost layer and a mesh in one fused construction.
+ * Equivalent to \ref p8est_ghost_new followed by \ref p8est_mesh_new_ext,
+ * but the ghost messages are posted first and all mesh memory that
+ * depends only on the local forest is allocated and filled while they
+ * are in flight, hiding the communication latency and avoiding the
+ * allocation gap between the two separate calls.
+ * \param [in] p8est    A forest that is fully 2:1 balanced.
+ * \param [in] btype    Determines the highest codimension of neighbors;
+ *                      used for the ghost layer and the mesh alike.
+ * \param [in] compute_tree_index   As in \ref p8est_mesh_new_ext.
+ * \param [in] compute_level_lists  As in \ref p8est_mesh_new_ext.
+ * \param [out] ghost   On output, the newly created ghost layer.  It is
+ *                      owned by the caller and must be destroyed with
+ *                      \ref p8est_ghost_destroy after the mesh.
+ * \return              A fully allocated mesh structure.
+ */
+p8est_mesh_t       *p8est_ghost_mesh_new (p8est_t * p8est,
+                                          p8est_connect_type_t btype,
+                                          int compute_tree_index,
+                                          int compute_level_lists,
+                                          p8est_ghost_t ** ghost);
+
+/** Build the corner adjacency of a mesh on first use.
+ * This complements a mesh whose corner construction has been deferred,
+ * see \ref p8est_mesh_new_level_ext.  The function is idempotent: it
+ * returns immediately if the corner information is already present.
+ * \param [in] p8est    The forest the mesh was created from.
+ * \param [in] ghost    The ghost layer the mesh was created with.
+ * \param [in,out] mesh Mesh whose corner members are filled in.
+ */
+void                p8est_mesh_build_corners (p8est_t * p8est,
+                                              p8est_ghost_t * ghost,
+                                              p8est_mesh_t * mesh);
+
+/** Compress the face adjacency of a mesh into a delta-coded byte stream.
+ * The quad_to_quad and quad_to_face arrays are replaced by a packed
+ * stream that stores, per face, the face code and the neighbor number
+ * as a variable-length delta relative to the current quadrant.  Since
+ * most neighbors are nearby in the local Morton order, typical meshes
+ * compress to roughly two bytes per face.  After compression, the face
+ * adjacency is ONLY available through \ref p8est_mesh_face_neighbor_next
+ * and the quad_to_quad and quad_to_face members are NULL.
+ * The function is idempotent.
+ * \param [in,out] mesh  Mesh whose face arrays are compressed in place.
+ */
+void                p8est_mesh_compress (p8est_mesh_t * mesh);
+
+/** The quad_to_face values shifted to start from zero. */
+#define P8EST_MESH_FACE_CONFIG_OFFSET (P8EST_HALF * P8EST_FACES)
+
+/** Number of distinct face configurations dispatched by
+ * \ref p8est_mesh_iterate_faces.  The first
+ * P8EST_MESH_FACE_CONFIG_OFFSET * (2 + P8EST_HALF) configurations are
+ * the quad_to_face codes plus P8EST_MESH_FACE_CONFIG_OFFSET; the last
+ * P8EST_FACES are domain boundary faces, one per face number.
+ */
+#define P8EST_MESH_FACE_CONFIGS \
+  (P8EST_MESH_FACE_CONFIG_OFFSET * (2 + P8EST_HALF) + P8EST_FACES)
+
+/** Callback for one local octant's face of a known configuration.
+ * \param [in] quadrant_id  Cumulative number of the octant over all
+ *                          local trees.
+ * \param [in] face         The octant's face number in 0..P8EST_FACES-1.
+ */
+typedef void        (*p8est_mesh_face_fn_t) (p8est_t * p4est,
+                                             p8est_ghost_t * ghost,
+                                             p8est_mesh_t * mesh,
+                                             p4est_locidx_t quadrant_id,
+                                             int face, void *user_data);
+
+/** Sweep the local octant faces through a configuration jump table.
+ * The quad_to_face code of the mesh already determines the neighbor's
+ * face number, relative orientation, and hanging status, so each face
+ * dispatches directly into \a table without re-deriving this
+ * information: the entry for a code \a v is table[v +
+ * P8EST_MESH_FACE_CONFIG_OFFSET], and domain boundary faces use the
+ * final P8EST_FACES entries.  A NULL entry skips the face.  This lets
+ * a numerical kernel install one specialized, branch-free routine per
+ * configuration.  Unlike \ref p8est_iterate, every face of every local
+ * octant is visited, so an interior face is seen from both sides;
+ * a kernel that computes one flux per face may leave the codes of one
+ * side NULL.
+ * \param [in] table      P8EST_MESH_FACE_CONFIGS callbacks, NULLs allowed.
+ */
+void                p8est_mesh_iterate_faces (p8est_t * p8est,
+                                              p8est_ghost_t * ghost,
+                                              p8est_mesh_t * mesh,
+                                              p8est_mesh_face_fn_t * table,
+                                              void *user_data);
+
+/** Compute a blocked relabeling of the local octants.
+ * The octant storage itself always stays in Morton order, which the
+ * library relies on; this function only computes a translation table
+ * that applications may use to lay out their per-octant data.  Each
+ * block is a face-connected patch of up to \a block_size octants
+ * grown breadth first through the mesh adjacency, so face-neighbor
+ * pairs across refinement levels tend to land in the same block and
+ * thus on the same pages of a blocked data array.
+ * The tables are only valid as long as the mesh is; after adapting or
+ * repartitioning the forest, rebuild the mesh and the relabeling.
+ * \param [in] block_size        Maximal octants per block; choose it
+ *                               so one block of data fills a few pages,
+ *                               e.g. 64 for moderate data sizes.
+ * \param [out] blocked_of_local Array of local_num_quadrants entries
+ *                               mapping each local (Morton) index to
+ *                               its blocked label; a permutation.
+ * \param [out] local_of_blocked If not NULL, array of the same length
+ *                               filled with the inverse permutation.
+ */
+void                p8est_mesh_blocked_order (p8est_t * p8est,
+                                              p8est_mesh_t * mesh,
+                                              int block_size,
+                                              p4est_locidx_t *
+                                              blocked_of_local,
+                                              p4est_locidx_t *
+                                              local_of_blocked);
+
 /** Destroy a p8est_mesh structure.
  * \param [in] mesh     Mesh structure previously created by p8est_mesh_new.
  */
@@ -215,6 +393,58 @@ p8est_quadrant_t   *p8est_mesh_face_neighbor_next (p8est_mesh_face_neighbor_t
                                                    p4est_locidx_t * nquad,
                                                    int *nface, int *nrank);
 
+/** Export the distributed dual graph as CSR arrays with global indices.
+ * Every local quadrant contributes one row whose entries are the global
+ * numbers of its face neighbors, with hanging faces expanded to all
+ * half-size neighbors and forest boundary faces skipped.  This is the
+ * input format expected by graph partitioners and load models and costs
+ * only the memory of the final graph, in contrast to going through a
+ * full intermediate cell complex.
+ * \param [in]  p4est   The forest the mesh was created from.
+ * \param [in]  ghost   The ghost layer the mesh was created with.
+ * \param [in]  mesh    Mesh with raw or compressed face adjacency.
+ * \param [out] xadj    On output, *xadj is a newly allocated array of
+ *                      local_num_quadrants + 1 row offsets; the caller
+ *                      frees it with P4EST_FREE.
+ * \param [out] adjncy  On output, *adjncy is a newly allocated array of
+ *                      xadj[local_num_quadrants] global quadrant numbers;
+ *                      the caller frees it with P4EST_FREE.
+ */
+void                p8est_mesh_to_csr (p8est_t * p4est,
+                                    p8est_ghost_t * ghost,
+                                    p8est_mesh_t * mesh,
+                                    p4est_locidx_t ** xadj,
+                                    p4est_gloidx_t ** adjncy);
+
+/** Gather the face adjacency of many quadrants in one pass.
+ * For each quadrant and face, the neighbor number and face code are
+ * written to the output arrays with the same encoding as quad_to_quad
+ * and quad_to_face, so hanging faces store an index into quad_to_half
+ * together with a negative face code.  Optionally the positions of the
+ * hanging faces are collected, which lets a caller run a tight
+ * vectorizable loop over the uniform entries and treat the hanging
+ * configurations in a separate pass.  The function works on both the
+ * raw and the compressed face adjacency.
+ * \param [in]  mesh       A mesh created by \ref p8est_mesh_new.
+ * \param [in]  quad_ids   Array of \a num_quads cumulative local
+ *                         quadrant numbers to query.
+ * \param [in]  num_quads  Number of quadrants queried.
+ * \param [out] nquad      Neighbor numbers, encoded as in quad_to_quad;
+ *                         must hold P8EST_FACES * \a num_quads entries.
+ * \param [out] nface      Face codes, encoded as in quad_to_face;
+ *                         must hold equally many entries.
+ * \param [in,out] hanging If not NULL, an array of p4est_locidx_t whose
+ *                         contents are replaced by the positions of the
+ *                         hanging faces within the output arrays.
+ */
+void                p8est_mesh_face_neighbors_batch (p8est_mesh_t * mesh,
+                                                  const p4est_locidx_t
+                                                  * quad_ids,
+                                                  p4est_locidx_t num_quads,
+                                                  p4est_locidx_t * nquad,
+                                                  int8_t * nface,
+                                                  sc_array_t * hanging);
+
 /** Get the user data for the current face neighbor.
  * \param [in]     mfn           Internal status of the iterator.
  * \param [in]     ghost_data    Data for the ghost quadrants that has been
@@ -225,6 +455,59 @@ p8est_quadrant_t   *p8est_mesh_face_neighbor_next (p8est_mesh_face_neighbor_t
 void               *p8est_mesh_face_neighbor_data (p8est_mesh_face_neighbor_t
                                                    * mfn, void *ghost_data);
 
+/** Move the iterator forward while prefetching the neighbor after next.
+ * Identical in semantics to \ref p8est_mesh_face_neighbor_next, except
+ * that the quadrant and user data of the following neighbor are
+ * software prefetched before this call returns, which hides the
+ * latency of the dependent quad_to_quad lookups in tight flux loops.
+ * \param [in] ghost_data   As in \ref p8est_mesh_face_neighbor_data;
+ *                          may be NULL to skip the data prefetch.
+ */
+p8est_quadrant_t   *p8est_mesh_face_neighbor_next_prefetch
+  (p8est_mesh_face_neighbor_t * mfn, void *ghost_data,
+   p4est_topidx_t * ntree, p4est_locidx_t * nquad, int *nface, int *nrank);
+
+/** Pull several face neighbors out of the iterator in one call.
+ * The neighbors are resolved with the prefetching iterator, so each
+ * lookup overlaps the latency of the next one.  A caller typically
+ * refills a small ring of a handful of entries and drains it in a
+ * branch-free inner loop.
+ * \param [in] ghost_data   As in \ref p8est_mesh_face_neighbor_data;
+ *                          may be NULL together with \a ring_data NULL.
+ * \param [in] ring_size    Capacity of the output arrays.
+ * \param [out] ring_quads  Filled with the next neighbor quadrants.
+ * \param [out] ring_data   If not NULL, filled with the matching user
+ *                          data pointers.
+ * \return                  The number of entries filled, less than
+ *                          \a ring_size only when the iterator is done.
+ */
+int                 p8est_mesh_face_neighbor_ring
+  (p8est_mesh_face_neighbor_t * mfn, void *ghost_data, int ring_size,
+   p8est_quadrant_t ** ring_quads, void **ring_data);
+
+/** Fuse neighbor payload addresses into the face adjacency.
+ * This fills the quad_to_data member with one address per local
+ * quadrant face: for full faces the neighbor's user data, and for
+ * hanging faces the address of a row of P8EST_HALF addresses in
+ * quad_to_half_data, analogous to the quad_to_half indirection.  A
+ * stencil kernel thus reaches a neighbor's payload in one load
+ * instead of hopping through quad_to_quad, the ghost index and the
+ * ghost data array.  The addresses stay valid as long as the forest,
+ * the mesh and \a ghost_data do; calling this function again replaces
+ * an earlier attachment.
+ * \param [in] p8est        The forest the mesh was created from.
+ * \param [in] ghost        The ghost layer the mesh was created with.
+ * \param [in] mesh         A mesh created by \ref p8est_mesh_new.
+ * \param [in] ghost_data   Contiguous ghost payload, laid out as filled
+ *                          by \ref p8est_ghost_exchange_data; the array
+ *                          itself must outlive the attachment while the
+ *                          contents may be refreshed freely.
+ */
+void                p8est_mesh_attach_data (p8est_t * p8est,
+                                            p8est_ghost_t * ghost,
+                                            p8est_mesh_t * mesh,
+                                            void *ghost_data);
+
 SC_EXTERN_C_END;
 
 #endif /* !P8EST_MESH_H */
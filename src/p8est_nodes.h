@@ -27,6 +27,7 @@
 
 #include <p8est.h>
 #include <p8est_ghost.h>
+#include <p8est_lnodes.h>
 
 SC_EXTERN_C_BEGIN;
 
@@ -208,6 +209,21 @@ p8est_nodes_t;
  */
 p8est_nodes_t      *p8est_nodes_new (p8est_t * p8est, p8est_ghost_t * ghost);
 
+/** Create node information from a degree 1 lnodes structure.
+ * The parallel node numbering in \ref p8est_lnodes_new is computed
+ * considerably faster than \ref p8est_nodes_new since it avoids hashing
+ * the independent nodes; this function translates its result into the
+ * nodes layout expected by legacy code.
+ * \param [in] p8est    The forest the node numbering was created for.
+ * \param [in] lnodes   A valid node numbering of degree 1 created for
+ *                      \a p8est in its current state.  It is not modified.
+ * \return              A fully populated nodes structure equivalent to the
+ *                      result of \ref p8est_nodes_new with a ghost layer,
+ *                      up to the ordering of the nodes.
+ */
+p8est_nodes_t      *p8est_nodes_new_from_lnodes (p8est_t * p8est,
+                                                 p8est_lnodes_t * lnodes);
+
 /** Destroy node information. */
 void                p8est_nodes_destroy (p8est_nodes_t * nodes);
 
@@ -36,6 +36,15 @@
 
 SC_EXTERN_C_BEGIN;
 
+/** Measure the bound search strategies and lock in the faster one.
+ * Times the guess-seeded bisection against a branchless halving search
+ * on a synthetic leaf array with a mixed query stream and selects the
+ * winner for all subsequent calls of \ref p8est_find_lower_bound and
+ * \ref p8est_find_higher_bound.  Runs automatically before the first
+ * search; call it explicitly to pay the measurement at program setup.
+ */
+void                p8est_search_bound_tune (void);
+
 /** Find the lowest position tq in a quadrant array such that tq >= q.
  * \return  Returns the id of the matching quadrant
  *                  or -1 if not found or the array is empty.
@@ -180,6 +189,235 @@ void                p8est_search (p8est_t * p8est,
                                   p8est_search_query_t search_point_fn,
                                   sc_array_t * points);
 
+/** Opaque state of a resumable depth-first search.
+ * Created by \ref p8est_search_cursor_new and advanced one matching
+ * leaf at a time by \ref p8est_search_next.
+ */
+typedef struct p8est_search_cursor p8est_search_cursor_t;
+
+/** Start a resumable depth-first search through the local forest.
+ * The traversal visits the same octants in the same order as
+ * \ref p8est_search without points, but control returns to the caller
+ * at every leaf instead of driving the whole recursion internally.
+ * This suits event loops that interleave the search with other work,
+ * such as asynchronous queries issued per reported leaf.
+ * \param [in] p8est     The forest to be searched.  It must not be
+ *                       modified while the cursor is in use.
+ * \param [in] search_quadrant_fn   As in \ref p8est_search: executed
+ *                       with a NULL point for every octant entered,
+ *                       and a false return excludes the octant and
+ *                       its descendants.  May be NULL, in which case
+ *                       every leaf is reported.
+ * \return               A cursor to pass to \ref p8est_search_next;
+ *                       free it with \ref p8est_search_cursor_destroy.
+ */
+p8est_search_cursor_t *p8est_search_cursor_new (p8est_t * p8est,
+                                                p8est_search_query_t
+                                                search_quadrant_fn);
+
+/** Resume the suspended traversal until the next leaf is reached.
+ * \param [in,out] cursor    Cursor from \ref p8est_search_cursor_new.
+ * \param [out] which_tree   On a match, the tree of the leaf.
+ *                           May be NULL.
+ * \param [out] quadrant     On a match, the leaf itself, pointing into
+ *                           the forest storage.  May be NULL.
+ * \param [out] local_num    On a match, the index of the leaf relative
+ *                           to the process-local octant storage.
+ *                           May be NULL.
+ * \return                   True on a match.  False when the traversal
+ *                           is exhausted; the output arguments are
+ *                           untouched in this case.
+ */
+int                 p8est_search_next (p8est_search_cursor_t * cursor,
+                                       p4est_topidx_t * which_tree,
+                                       p8est_quadrant_t ** quadrant,
+                                       p4est_locidx_t * local_num);
+
+/** Free a search cursor at any stage of the traversal. */
+void                p8est_search_cursor_destroy (p8est_search_cursor_t *
+                                                 cursor);
+
+/** Locate many points in the local forest with one sorted sweep.
+ * Unlike \ref p8est_search, which recurses top-down and calls the point
+ * callback on every quadrant/point candidate pair, this function sorts
+ * the points once and merges the sorted query stream against the linear
+ * quadrant storage, so the traversal cost is amortized over all points.
+ *
+ * The points must be quadrants that are at least as deep as the leaves
+ * they may land in; typically they are constructed at P8EST_QMAXLEVEL
+ * from the coordinates to locate.  Each point's p.piggy3.which_tree
+ * must be set to the tree containing it; p.piggy3.local_num is free
+ * for user payload, e.g. the original query index.
+ *
+ * \param [in] p8est        The forest to be searched.
+ * \param [in] search_point_fn  Called exactly once for each point that
+ *                          falls into a process-local leaf, with the
+ *                          containing leaf, its local number and the
+ *                          point.  The return value is ignored.
+ * \param [in,out] points   Array of p8est_quadrant_t queries.  It is
+ *                          sorted in place by tree and Morton order.
+ *                          Points outside the process-local part of
+ *                          the forest are skipped silently.
+ */
+void                p8est_search_points_sorted (p8est_t * p8est,
+                                                p8est_search_query_t
+                                                search_point_fn,
+                                                sc_array_t * points);
+
+/** One contiguous run of process-local octant indices. */
+typedef struct p8est_index_range
+{
+  p4est_locidx_t      begin;    /**< First matching local index. */
+  p4est_locidx_t      end;      /**< One past the last matching index. */
+}
+p8est_index_range_t;
+
+/** Find all local octants intersecting an axis-aligned box.
+ * Unlike \ref p8est_search with a box-intersection point callback,
+ * this function prunes the top-down recursion by comparing octant
+ * extents against the box in coordinate space, without invoking any
+ * user code.  Subtrees disjoint from the box are skipped wholesale
+ * and subtrees contained in it are reported as one run, so the cost
+ * is proportional to the octants near the box surface.
+ *
+ * \param [in] p8est        The forest to be searched.
+ * \param [in] which_tree   The tree the box refers to.  If this process
+ *                          holds no octants of it, nothing is reported.
+ * \param [in] lower        Inclusive lower box corner, P8EST_DIM entries
+ *                          of tree-local coordinates in [0, P8EST_ROOT_LEN].
+ * \param [in] upper        Exclusive upper box corner, same convention.
+ *                          Dimensions with lower >= upper make the box
+ *                          empty.
+ * \param [in,out] ranges   Initialized array of \ref p8est_index_range_t.
+ *                          Maximal runs of matching process-local octant
+ *                          indices are appended in ascending order.
+ */
+void                p8est_search_region (p8est_t * p8est,
+                                         p4est_topidx_t which_tree,
+                                         const p4est_qcoord_t lower[],
+                                         const p4est_qcoord_t upper[],
+                                         sc_array_t * ranges);
+
+/** Test many octants against an axis-aligned box in one pass.
+ * The loop body is branch free, so optimizing compilers vectorize it
+ * without any instruction-set specific code in this library.  To batch
+ * process the candidates found by \ref p8est_search_region, create a
+ * view on the tree's octant array for each reported index range with
+ * \ref sc_array_init_view and pass the view here.
+ * \param [in] quadrants     Array of octants of one tree.
+ * \param [in] lower         Inclusive lower box corner, P8EST_DIM entries
+ *                           of tree-local coordinates as in
+ *                           \ref p8est_search_region.
+ * \param [in] upper         Exclusive upper box corner, same convention.
+ * \param [out] results      One entry per octant, set to 1 if the
+ *                           octant's extent intersects the box and to
+ *                           0 otherwise.
+ */
+void                p8est_quadrant_array_box_overlap (sc_array_t * quadrants,
+                                                      const p4est_qcoord_t
+                                                      lower[],
+                                                      const p4est_qcoord_t
+                                                      upper[],
+                                                      int8_t * results);
+
+/** Test many octants for containment in an axis-aligned box.
+ * Like \ref p8est_quadrant_array_box_overlap, but an entry is set to 1
+ * only if the octant's extent lies entirely inside the box.
+ * \param [in] quadrants     Array of octants of one tree.
+ * \param [in] lower         Inclusive lower box corner.
+ * \param [in] upper         Exclusive upper box corner.
+ * \param [out] results      One entry per octant, 1 for containment.
+ */
+void                p8est_quadrant_array_box_contained (sc_array_t *
+                                                        quadrants,
+                                                        const p4est_qcoord_t
+                                                        lower[],
+                                                        const p4est_qcoord_t
+                                                        upper[],
+                                                        int8_t * results);
+
+/** Compute squared distances from many octants to an axis-aligned box.
+ * The distance is measured in octant coordinate space between the
+ * closed octant extent and the closed box; it is zero whenever the
+ * two touch or overlap.  All arithmetic is exact in 64 bits.
+ * \param [in] quadrants     Array of octants of one tree.
+ * \param [in] lower         Inclusive lower box corner.
+ * \param [in] upper         Upper box corner, treated as inclusive for
+ *                           the purpose of measuring distance.
+ * \param [out] distance2    One squared distance per octant.
+ */
+void                p8est_quadrant_array_box_distance2 (sc_array_t *
+                                                        quadrants,
+                                                        const p4est_qcoord_t
+                                                        lower[],
+                                                        const p4est_qcoord_t
+                                                        upper[],
+                                                        int64_t * distance2);
+
+/** One closed range of finest-level Morton indices within a tree.
+ * A set of octants of one tree is represented as an sc_array of
+ * these ranges, sorted ascending, pairwise disjoint, and maximally
+ * merged: consecutive ranges are separated by at least one index.
+ * The indices are linear ids at level P8EST_QMAXLEVEL, so an octant
+ * of level l covers a run of 2^(P8EST_DIM * (P8EST_QMAXLEVEL - l))
+ * of them.  The algebra below works by linear merge sweeps, so each
+ * operation costs the sum of the two input lengths.
+ */
+typedef struct p8est_morton_range
+{
+  uint64_t            first;    /**< First covered Morton index. */
+  uint64_t            last;     /**< Last covered index, inclusive. */
+}
+p8est_morton_range_t;
+
+/** Convert a sorted octant array into a Morton range set.
+ * \param [in] quadrants     Array of octants of one tree in Morton
+ *                           order; overlaps are absorbed.
+ * \param [in,out] ranges    Array of p8est_morton_range_t, must be
+ *                           empty on input; the set is appended.
+ */
+void                p8est_morton_range_from_quadrants (sc_array_t *
+                                                       quadrants,
+                                                       sc_array_t * ranges);
+
+/** Cover a Morton range set by the minimal list of octants.
+ * The inverse of \ref p8est_morton_range_from_quadrants up to the
+ * coarsening inherent in merged ranges: each range is tiled greedily
+ * by the largest aligned octants that fit.
+ * \param [in] ranges        Valid Morton range set.
+ * \param [in,out] quadrants Array of p8est_quadrant_t; the covering
+ *                           octants are appended in Morton order.
+ */
+void                p8est_morton_range_to_quadrants (sc_array_t * ranges,
+                                                     sc_array_t * quadrants);
+
+/** Form the union of two Morton range sets.
+ * \param [in] a, b          Valid Morton range sets.
+ * \param [in,out] out       Empty array of p8est_morton_range_t;
+ *                           receives the union as a valid set.
+ */
+void                p8est_morton_range_union (sc_array_t * a, sc_array_t * b,
+                                              sc_array_t * out);
+
+/** Form the intersection of two Morton range sets.
+ * \param [in] a, b          Valid Morton range sets.
+ * \param [in,out] out       Empty array of p8est_morton_range_t;
+ *                           receives the intersection as a valid set.
+ */
+void                p8est_morton_range_intersection (sc_array_t * a,
+                                                     sc_array_t * b,
+                                                     sc_array_t * out);
+
+/** Subtract one Morton range set from another.
+ * \param [in] a             Valid Morton range set to subtract from.
+ * \param [in] b             Valid Morton range set to subtract.
+ * \param [in,out] out       Empty array of p8est_morton_range_t;
+ *                           receives a minus b as a valid set.
+ */
+void                p8est_morton_range_difference (sc_array_t * a,
+                                                   sc_array_t * b,
+                                                   sc_array_t * out);
+
 /** Callback function for the traversal recursion.
  * \param [in] p8est        The forest to traverse.
  *                          Its local quadrants are never accessed.
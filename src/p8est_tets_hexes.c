@@ -83,6 +83,9 @@ p8est_tets_read_node (const char *nodefilename)
     P4EST_LERRORF ("Failed to open %s\n", nodefilename);
     goto dead;
   }
+  /* stream the file through a large chunk buffer; the default stdio
+   * buffer is too small for meshes with many millions of nodes */
+  (void) setvbuf (nodefile, NULL, _IOFBF, (size_t) 1 << 20);
 
   /* read header information */
   retval = fscanf (nodefile, "%ld %d %d %d",
@@ -172,6 +175,9 @@ p8est_tets_read_ele (const char *elefilename, p4est_topidx_t num_nodes,
     P4EST_LERRORF ("Failed to open %s\n", elefilename);
     goto dead;
   }
+  /* stream the file through a large chunk buffer; the default stdio
+   * buffer is too small for meshes with many millions of tetrahedra */
+  (void) setvbuf (elefile, NULL, _IOFBF, (size_t) 1 << 20);
 
   /* read header information */
   retval = fscanf (elefile, "%ld %d %d",
@@ -365,13 +371,84 @@ p8est_tets_make_righthanded (p8est_tets_t * ptg)
   return tnum_flips;
 }
 
-typedef struct p8est_tet_edge_info
+/** Sort an array of fixed-size records by \a compar.
+ * Under --enable-openmp sorted chunks are produced in parallel and
+ * merged with one thread per output run, following the pattern of
+ * \ref p4est_quadrant_array_sort; otherwise this is sc_array_sort.
+ */
+static void
+p8est_tets_sort (sc_array_t * records,
+                 int (*compar) (const void *, const void *))
+{
+#ifdef P4EST_ENABLE_OPENMP
+  const size_t        csize = (size_t) 1 << 15;
+  const size_t        incount = records->elem_count;
+  const size_t        esize = records->elem_size;
+  size_t              lo, mid, hi, li, ri, oi;
+  size_t              width;
+  char               *in, *out, *scratch, *swap;
+
+  /* small arrays are not worth the thread startup and scratch copy */
+  if (incount <= 2 * csize) {
+    sc_array_sort (records, compar);
+    return;
+  }
+
+  /* sort fixed-size chunks independently in parallel */
+  in = records->array;
+#pragma omp parallel for schedule (dynamic)
+  for (lo = 0; lo < incount; lo += csize) {
+    qsort (in + lo * esize, SC_MIN (csize, incount - lo), esize, compar);
+  }
+
+  /* merge sorted runs of doubling width, one thread per output run */
+  out = scratch = P4EST_ALLOC (char, incount * esize);
+  for (width = csize; width < incount; width *= 2) {
+#pragma omp parallel for schedule (dynamic) private (mid, hi, li, ri, oi)
+    for (lo = 0; lo < incount; lo += 2 * width) {
+      mid = SC_MIN (lo + width, incount);
+      hi = SC_MIN (lo + 2 * width, incount);
+      li = lo;
+      ri = mid;
+      oi = lo;
+      while (li < mid && ri < hi) {
+        if (compar (in + li * esize, in + ri * esize) <= 0) {
+          memcpy (out + oi++ * esize, in + li++ * esize, esize);
+        }
+        else {
+          memcpy (out + oi++ * esize, in + ri++ * esize, esize);
+        }
+      }
+      while (li < mid) {
+        memcpy (out + oi++ * esize, in + li++ * esize, esize);
+      }
+      while (ri < hi) {
+        memcpy (out + oi++ * esize, in + ri++ * esize, esize);
+      }
+    }
+    swap = in;
+    in = out;
+    out = swap;
+  }
+  if (in == scratch) {
+    memcpy (records->array, scratch, incount * esize);
+  }
+  P4EST_FREE (scratch);
+#else
+  sc_array_sort (records, compar);
+#endif
+
+  P4EST_ASSERT (sc_array_is_sorted (records, compar));
+}
+
+/** One occurrence of a tetrahedron edge, keyed for sorting. */
+typedef struct p8est_tet_edge_record
 {
-  p4est_topidx_t      ek[2];
-  sc_array_t          tets;
-  sc_array_t          tet_edges;
+  p4est_topidx_t      ek[2];    /**< sorted corner node pair */
+  p4est_topidx_t      tet;      /**< tetrahedron of this occurrence */
+  p4est_topidx_t      tet_edge; /**< edge number within the tetrahedron */
 }
-p8est_tet_edge_info_t;
+p8est_tet_edge_record_t;
 
 /** Create unique edge key for a given edge of a tetrahedron.
  * \param [out] ek      The edge key consists of two node numbers.
@@ -390,80 +467,90 @@ p8est_tet_edge_key (p4est_topidx_t * ek, p4est_topidx_t * tet, int edge)
   p4est_topidx_bsort (ek, 2);
 }
 
-static unsigned
-p8est_tet_edge_hash (const void *v, const void *u)
-{
-  const p8est_tet_edge_info_t *ei = (p8est_tet_edge_info_t *) v;
-
-  return p4est_topidx_hash2 (ei->ek);
-}
-
 static int
-p8est_tet_edge_equal (const void *v1, const void *v2, const void *u)
+p8est_tet_edge_compare (const void *v1, const void *v2)
 {
-  const p8est_tet_edge_info_t *ei1 = (p8est_tet_edge_info_t *) v1;
-  const p8est_tet_edge_info_t *ei2 = (p8est_tet_edge_info_t *) v2;
+  const p8est_tet_edge_record_t *e1 = (const p8est_tet_edge_record_t *) v1;
+  const p8est_tet_edge_record_t *e2 = (const p8est_tet_edge_record_t *) v2;
 
-  return !memcmp (ei1->ek, ei2->ek, 2 * sizeof (p4est_topidx_t));
+  if (e1->ek[0] != e2->ek[0]) {
+    return e1->ek[0] < e2->ek[0] ? -1 : 1;
+  }
+  if (e1->ek[1] != e2->ek[1]) {
+    return e1->ek[1] < e2->ek[1] ? -1 : 1;
+  }
+  /* ties are ordered by occurrence so the unique scan is deterministic */
+  if (e1->tet != e2->tet) {
+    return e1->tet < e2->tet ? -1 : 1;
+  }
+  return (int) (e1->tet_edge - e2->tet_edge);
 }
 
-static sc_hash_array_t *
-p8est_tets_identify_edges (p8est_tets_t * ptg)
+/** Identify unique tetrahedron edges by sorting all occurrences.
+ * \param [in] ptg         Valid tetrahedron mesh.
+ * \param [out] tet_edges  Array of 6 * num_tets entries; entry
+ *                         6 * tet + edge receives the unique edge index.
+ * \return                 Array of p8est_tet_edge_record_t holding one
+ *                         representative occurrence per unique edge,
+ *                         the one with the smallest tetrahedron number.
+ */
+static sc_array_t  *
+p8est_tets_identify_edges (p8est_tets_t * ptg, p4est_topidx_t * tet_edges)
 {
-  int                 edge, *pi;
-  size_t              iz, znum_tets, pz;
-  sc_hash_array_t    *edge_ha;
-  p4est_topidx_t     *tet, *pt;
-  p8est_tet_edge_info_t eikey, *ei;
-
-  /* create hash array for shared edges */
-  edge_ha = sc_hash_array_new (sizeof (p8est_tet_edge_info_t),
-                               p8est_tet_edge_hash, p8est_tet_edge_equal,
-                               NULL);
-
-  /* loop through all edges and identify edge-neighbor tet groups */
+  int                 edge;
+  size_t              iz, znum_tets, znum_records;
+  sc_array_t         *records, *edges;
+  p4est_topidx_t     *tet;
+  p4est_topidx_t      nedges;
+  p4est_topidx_t      lastek[2];
+  p8est_tet_edge_record_t *er;
+
+  /* list every edge occurrence of every tetrahedron */
   znum_tets = ptg->tets->elem_count / 4;
+  records = sc_array_new_size (sizeof (p8est_tet_edge_record_t),
+                               6 * znum_tets);
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (static) private (edge, tet, er)
+#endif
   for (iz = 0; iz < znum_tets; ++iz) {
     tet = p8est_tets_tet_index (ptg, iz);
     for (edge = 0; edge < 6; ++edge) {
-      p8est_tet_edge_key (eikey.ek, tet, edge);
-      ei = (p8est_tet_edge_info_t *)
-        sc_hash_array_insert_unique (edge_ha, &eikey, &pz);
-      if (ei != NULL) {
-        /* added new edge group ei to hash array */
-        P4EST_ASSERT (sc_array_position (&edge_ha->a, ei) == pz);
-        memcpy (ei->ek, eikey.ek, 2 * sizeof (p4est_topidx_t));
-        sc_array_init (&ei->tets, sizeof (p4est_topidx_t));
-        pt = (p4est_topidx_t *) sc_array_push (&ei->tets);
-        *pt = (p4est_topidx_t) iz;
-        sc_array_init (&ei->tet_edges, sizeof (int));
-        pi = (int *) sc_array_push (&ei->tet_edges);
-        *pi = edge;
-      }
-      else {
-        /* found existing entry from earlier edge */
-        ei = (p8est_tet_edge_info_t *) sc_array_index (&edge_ha->a, pz);
-        P4EST_ASSERT (p8est_tet_edge_equal (ei->ek, eikey.ek, NULL));
-        P4EST_ASSERT (ei->tets.elem_count > 0);
-        pt = (p4est_topidx_t *) sc_array_push (&ei->tets);
-        *pt = (p4est_topidx_t) iz;
-        P4EST_ASSERT (ei->tet_edges.elem_count > 0);
-        pi = (int *) sc_array_push (&ei->tet_edges);
-        *pi = edge;
-      }
+      er = (p8est_tet_edge_record_t *)
+        sc_array_index (records, 6 * iz + (size_t) edge);
+      p8est_tet_edge_key (er->ek, tet, edge);
+      er->tet = (p4est_topidx_t) iz;
+      er->tet_edge = (p4est_topidx_t) edge;
+    }
+  }
+
+  /* sort by key and assign unique edge numbers in one scan */
+  p8est_tets_sort (records, p8est_tet_edge_compare);
+  edges = sc_array_new (sizeof (p8est_tet_edge_record_t));
+  nedges = 0;
+  znum_records = records->elem_count;
+  for (iz = 0; iz < znum_records; ++iz) {
+    er = (p8est_tet_edge_record_t *) sc_array_index (records, iz);
+    if (iz == 0 || memcmp (lastek, er->ek, 2 * sizeof (p4est_topidx_t))) {
+      /* the first, and lowest numbered, occurrence represents the edge */
+      memcpy (lastek, er->ek, 2 * sizeof (p4est_topidx_t));
+      memcpy (sc_array_push (edges), er, sizeof (p8est_tet_edge_record_t));
+      ++nedges;
     }
+    tet_edges[6 * er->tet + er->tet_edge] = nedges - 1;
   }
+  sc_array_destroy (records);
 
-  return edge_ha;
+  return edges;
 }
 
-typedef struct p8est_tet_face_info
+/** One occurrence of a tetrahedron face, keyed for sorting. */
+typedef struct p8est_tet_face_record
 {
-  p4est_topidx_t      fk[3];
-  p4est_topidx_t      tets[2];
-  int                 tet_faces[2];
+  p4est_topidx_t      fk[3];    /**< sorted corner node triple */
+  p4est_topidx_t      tet;      /**< tetrahedron of this occurrence */
+  p4est_topidx_t      tet_face; /**< face number within the tetrahedron */
 }
-p8est_tet_face_info_t;
+p8est_tet_face_record_t;
 
 /** Create unique face key for a given face of a tetrahedron.
  * \param [out] fk      The face key consists of three node numbers.
@@ -483,92 +570,106 @@ p8est_tet_face_key (p4est_topidx_t * fk, p4est_topidx_t * tet, int face)
   p4est_topidx_bsort (fk, 3);
 }
 
-static unsigned
-p8est_tet_face_hash (const void *v, const void *u)
-{
-  const p8est_tet_face_info_t *fi = (p8est_tet_face_info_t *) v;
-
-  return p4est_topidx_hash3 (fi->fk);
-}
-
 static int
-p8est_tet_face_equal (const void *v1, const void *v2, const void *u)
+p8est_tet_face_compare (const void *v1, const void *v2)
 {
-  const p8est_tet_face_info_t *fi1 = (p8est_tet_face_info_t *) v1;
-  const p8est_tet_face_info_t *fi2 = (p8est_tet_face_info_t *) v2;
+  const p8est_tet_face_record_t *f1 = (const p8est_tet_face_record_t *) v1;
+  const p8est_tet_face_record_t *f2 = (const p8est_tet_face_record_t *) v2;
+  int                 k;
 
-  return !memcmp (fi1->fk, fi2->fk, 3 * sizeof (p4est_topidx_t));
+  for (k = 0; k < 3; ++k) {
+    if (f1->fk[k] != f2->fk[k]) {
+      return f1->fk[k] < f2->fk[k] ? -1 : 1;
+    }
+  }
+  /* ties are ordered by occurrence so the unique scan is deterministic */
+  if (f1->tet != f2->tet) {
+    return f1->tet < f2->tet ? -1 : 1;
+  }
+  return (int) (f1->tet_face - f2->tet_face);
 }
 
-static sc_hash_array_t *
-p8est_tets_identify_faces (p8est_tets_t * ptg)
+/** Identify unique tetrahedron faces by sorting all occurrences.
+ * \param [in] ptg         Valid tetrahedron mesh.
+ * \param [out] tet_faces  Array of 4 * num_tets entries; entry
+ *                         4 * tet + face receives the unique face index.
+ * \return                 Array of p8est_tet_face_record_t holding one
+ *                         representative occurrence per unique face,
+ *                         the one with the smallest tetrahedron number.
+ */
+static sc_array_t  *
+p8est_tets_identify_faces (p8est_tets_t * ptg, p4est_topidx_t * tet_faces)
 {
   int                 face;
-  size_t              iz, znum_tets, pz;
-  sc_hash_array_t    *face_ha;
+  size_t              iz, znum_tets, znum_records;
+  sc_array_t         *records, *faces;
   p4est_topidx_t     *tet;
-  p8est_tet_face_info_t fikey, *fi;
+  p4est_topidx_t      nfaces;
+  p4est_topidx_t      lastfk[3];
+  p8est_tet_face_record_t *fr;
 
-  /* create hash array for shared faces */
-  face_ha = sc_hash_array_new (sizeof (p8est_tet_face_info_t),
-                               p8est_tet_face_hash, p8est_tet_face_equal,
-                               NULL);
-
-  /* loop through all faces and identify face-neighbor tet pairs */
+  /* list every face occurrence of every tetrahedron */
   znum_tets = ptg->tets->elem_count / 4;
+  records = sc_array_new_size (sizeof (p8est_tet_face_record_t),
+                               4 * znum_tets);
+#ifdef P4EST_ENABLE_OPENMP
+#pragma omp parallel for schedule (static) private (face, tet, fr)
+#endif
   for (iz = 0; iz < znum_tets; ++iz) {
     tet = p8est_tets_tet_index (ptg, iz);
     for (face = 0; face < 4; ++face) {
-      p8est_tet_face_key (fikey.fk, tet, face);
-      fi = (p8est_tet_face_info_t *)
-        sc_hash_array_insert_unique (face_ha, &fikey, &pz);
-      if (fi != NULL) {
-        /* added fi to hash array as the first of two tets */
-        P4EST_ASSERT (sc_array_position (&face_ha->a, fi) == pz);
-        memcpy (fi->fk, fikey.fk, 3 * sizeof (p4est_topidx_t));
-        fi->tets[0] = (p4est_topidx_t) iz;
-        fi->tets[1] = -1;
-        fi->tet_faces[0] = face;
-        fi->tet_faces[1] = -1;
-      }
-      else {
-        /* found existing entry from the first face */
-        fi = (p8est_tet_face_info_t *) sc_array_index (&face_ha->a, pz);
-        P4EST_ASSERT (p8est_tet_face_equal (fi->fk, fikey.fk, NULL));
-        P4EST_ASSERT (fi->tets[0] >= 0 && fi->tet_faces[0] >= 0);
-        P4EST_ASSERT (fi->tets[1] == -1 && fi->tet_faces[1] == -1);
-        fi->tets[1] = (p4est_topidx_t) iz;
-        fi->tet_faces[1] = face;
-      }
+      fr = (p8est_tet_face_record_t *)
+        sc_array_index (records, 4 * iz + (size_t) face);
+      p8est_tet_face_key (fr->fk, tet, face);
+      fr->tet = (p4est_topidx_t) iz;
+      fr->tet_face = (p4est_topidx_t) face;
     }
   }
 
-  return face_ha;
+  /* sort by key and assign unique face numbers in one scan */
+  p8est_tets_sort (records, p8est_tet_face_compare);
+  faces = sc_array_new (sizeof (p8est_tet_face_record_t));
+  nfaces = 0;
+  znum_records = records->elem_count;
+  for (iz = 0; iz < znum_records; ++iz) {
+    fr = (p8est_tet_face_record_t *) sc_array_index (records, iz);
+    if (iz == 0 || memcmp (lastfk, fr->fk, 3 * sizeof (p4est_topidx_t))) {
+      /* the first, and lowest numbered, occurrence represents the face */
+      memcpy (lastfk, fr->fk, 3 * sizeof (p4est_topidx_t));
+      memcpy (sc_array_push (faces), fr, sizeof (p8est_tet_face_record_t));
+      ++nfaces;
+    }
+    tet_faces[4 * fr->tet + fr->tet_face] = nfaces - 1;
+  }
+  sc_array_destroy (records);
+
+  return faces;
 }
 
 /** Create a connectivity where the trees are not connected to each other. */
 static p8est_connectivity_t *
 p8est_tets_connectivity_new (p8est_tets_t * ptg,
-                             sc_hash_array_t * edge_ha,
-                             sc_hash_array_t * face_ha)
+                             sc_array_t * edges, sc_array_t * faces,
+                             const p4est_topidx_t * tet_edges,
+                             const p4est_topidx_t * tet_faces)
 {
   int                 j, k;
   int                 edge, face;
   size_t              nvz, evzoffset, fvzoffset, vvzoffset;
-  size_t              iz, pz;
+  size_t              iz;
   double             *vp, *n[4];
   int8_t             *ttf;
   p4est_topidx_t      tt, *tet, node;
   p4est_topidx_t     *ttv, *ttt;
   p4est_topidx_t      nid[15];
   p8est_connectivity_t *conn;
-  p8est_tet_edge_info_t *ei, eikey;
-  p8est_tet_face_info_t *fi, fikey;
+  p8est_tet_edge_record_t *er;
+  p8est_tet_face_record_t *fr;
 
   /* arrange vertices by tet corners, edges, faces, and volumes */
   evzoffset = ptg->nodes->elem_count / 3;
-  fvzoffset = evzoffset + edge_ha->a.elem_count;
-  vvzoffset = fvzoffset + face_ha->a.elem_count;
+  fvzoffset = evzoffset + edges->elem_count;
+  vvzoffset = fvzoffset + faces->elem_count;
   nvz = vvzoffset + ptg->tets->elem_count / 4;
 
   /* allocate connectivity */
@@ -577,11 +678,10 @@ p8est_tets_connectivity_new (p8est_tets_t * ptg,
   /* populate vertices */
   memcpy (conn->vertices, ptg->nodes->array, 3 * evzoffset * sizeof (double));
   vp = conn->vertices + 3 * evzoffset;
-  for (iz = 0; iz < edge_ha->a.elem_count; ++iz) {
-    ei = (p8est_tet_edge_info_t *) sc_array_index (&edge_ha->a, iz);
-    tt = *((p4est_topidx_t *) sc_array_index (&ei->tets, 0));
-    edge = *((int *) sc_array_index (&ei->tet_edges, 0));
-    tet = p8est_tets_tet_index (ptg, tt);
+  for (iz = 0; iz < edges->elem_count; ++iz) {
+    er = (p8est_tet_edge_record_t *) sc_array_index (edges, iz);
+    edge = (int) er->tet_edge;
+    tet = p8est_tets_tet_index (ptg, er->tet);
     for (j = 0; j < 2; ++j) {
       node = tet[p8est_tet_edge_corners[edge][j]];
       n[j] = p8est_tets_node_index (ptg, node);
@@ -591,11 +691,10 @@ p8est_tets_connectivity_new (p8est_tets_t * ptg,
     vp[2] = .5 * (n[0][2] + n[1][2]);
     vp += 3;
   }
-  for (iz = 0; iz < face_ha->a.elem_count; ++iz) {
-    fi = (p8est_tet_face_info_t *) sc_array_index (&face_ha->a, iz);
-    tt = fi->tets[0];
-    face = fi->tet_faces[0];
-    tet = p8est_tets_tet_index (ptg, tt);
+  for (iz = 0; iz < faces->elem_count; ++iz) {
+    fr = (p8est_tet_face_record_t *) sc_array_index (faces, iz);
+    face = (int) fr->tet_face;
+    tet = p8est_tets_tet_index (ptg, fr->tet);
     for (j = 0; j < 3; ++j) {
       node = tet[p8est_tet_face_corners[face][j]];
       n[j] = p8est_tets_node_index (ptg, node);
@@ -626,14 +725,10 @@ p8est_tets_connectivity_new (p8est_tets_t * ptg,
       nid[j] = tet[j];
     }
     for (edge = 0; edge < 6; ++edge) {
-      p8est_tet_edge_key (eikey.ek, tet, edge);
-      P4EST_EXECUTE_ASSERT_TRUE (sc_hash_array_lookup (edge_ha, &eikey, &pz));
-      nid[4 + edge] = (p4est_topidx_t) (evzoffset + pz);
+      nid[4 + edge] = (p4est_topidx_t) evzoffset + tet_edges[6 * iz + edge];
     }
     for (face = 0; face < 4; ++face) {
-      p8est_tet_face_key (fikey.fk, tet, face);
-      P4EST_EXECUTE_ASSERT_TRUE (sc_hash_array_lookup (face_ha, &fikey, &pz));
-      nid[10 + face] = (p4est_topidx_t) (fvzoffset + pz);
+      nid[10 + face] = (p4est_topidx_t) fvzoffset + tet_faces[4 * iz + face];
     }
     nid[14] = (p4est_topidx_t) (vvzoffset + iz);
 
@@ -665,37 +760,34 @@ p8est_connectivity_new_tets (p8est_tets_t * ptg)
 {
   int                *pint, i;
   int8_t              attr;
-  size_t              ez, znum_edges;
   size_t              tz, znum_tets;
-  sc_hash_array_t    *edge_ha, *face_ha;
-  sc_array_t          edge_array;
-  p8est_tet_edge_info_t *ei;
+  sc_array_t         *edges, *faces;
+  p4est_topidx_t     *tet_edges, *tet_faces;
   p8est_connectivity_t *conn;
 
   /* identify unique edges and faces */
-  edge_ha = p8est_tets_identify_edges (ptg);
+  znum_tets = ptg->tets->elem_count / 4;
+  tet_edges = P4EST_ALLOC (p4est_topidx_t, 6 * znum_tets);
+  edges = p8est_tets_identify_edges (ptg, tet_edges);
   P4EST_GLOBAL_LDEBUGF ("Added %ld unique tetrahedron edges\n",
-                        (long) edge_ha->a.elem_count);
+                        (long) edges->elem_count);
 
-  face_ha = p8est_tets_identify_faces (ptg);
+  tet_faces = P4EST_ALLOC (p4est_topidx_t, 4 * znum_tets);
+  faces = p8est_tets_identify_faces (ptg, tet_faces);
   P4EST_GLOBAL_LDEBUGF ("Added %ld unique tetrahedron faces\n",
-                        (long) face_ha->a.elem_count);
+                        (long) faces->elem_count);
 
   /* add vertex information to connectivity */
-  conn = p8est_tets_connectivity_new (ptg, edge_ha, face_ha);
+  conn = p8est_tets_connectivity_new (ptg, edges, faces,
+                                      tet_edges, tet_faces);
   P4EST_GLOBAL_LDEBUGF ("Connectivity has %ld vertices and %ld trees\n",
                         (long) conn->num_vertices, (long) conn->num_trees);
 
   /* clean unique edges and faces */
-  sc_hash_array_rip (edge_ha, &edge_array);
-  znum_edges = edge_array.elem_count;
-  for (ez = 0; ez < znum_edges; ++ez) {
-    ei = (p8est_tet_edge_info_t *) sc_array_index (&edge_array, ez);
-    sc_array_reset (&ei->tets);
-    sc_array_reset (&ei->tet_edges);
-  }
-  sc_array_reset (&edge_array);
-  sc_hash_array_destroy (face_ha);
+  sc_array_destroy (edges);
+  sc_array_destroy (faces);
+  P4EST_FREE (tet_edges);
+  P4EST_FREE (tet_faces);
 
   /* transfer tree tags */
   if (ptg->tet_attributes != NULL) {
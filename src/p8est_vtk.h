@@ -118,6 +118,107 @@ void                p8est_vtk_context_set_scale (p8est_vtk_context_t * cont,
  */
 void                p8est_vtk_context_set_continuous (p8est_vtk_context_t *
                                                       cont, int continuous);
+
+/** Write data arrays into VTK's raw appended data section.
+ *
+ * In this mode each DataArray element only records a byte offset and the
+ * encoded data blocks are written verbatim after the grid description,
+ * avoiding the 33% size overhead of inline base64 encoding.  When zlib
+ * compression is configured, the independent blocks of each array are
+ * compressed across threads under \c --enable-openmp.  The option is
+ * ignored when p4est is compiled for ascii VTK output.
+ *
+ * \param [in,out] cont     The VTK context to modify.
+ * \param [in] appended     Boolean: write raw appended data blocks.
+ */
+void                p8est_vtk_context_set_appended (p8est_vtk_context_t *
+                                                    cont, int appended);
+
+/** Write one shared VTU file collectively with MPI I/O.
+ *
+ * Instead of one .vtu file per process plus a .pvtu index, all processes
+ * write their cells into a single file, each at an offset derived from
+ * global_first_quadrant using MPI_File_write_at_all.  This avoids the
+ * metadata storm of creating many files on parallel file systems.  The
+ * mode implies the raw appended data section, disables compression, and
+ * always duplicates shared octant corners.  All write_* calls keep
+ * their usual semantics.  The option is ignored unless p4est is
+ * configured with MPI I/O and binary VTK data.
+ *
+ * \param [in,out] cont     The VTK context to modify.
+ * \param [in] collective   Boolean: write one shared file collectively.
+ */
+void                p8est_vtk_context_set_collective (p8est_vtk_context_t *
+                                                      cont, int collective);
+
+/** Write the grid description in per-tree chunks of bounded memory.
+ *
+ * By default the header materializes the full coordinate and
+ * connectivity arrays of the local forest before encoding them, which
+ * makes VTK output the peak-memory moment of many runs.  In streaming
+ * mode these arrays are generated and written tree by tree, bounding
+ * the writer's scratch memory by the largest local tree.  The mode
+ * always duplicates shared quadrant corners, since a deduplicated
+ * node list cannot be built one tree at a time, and it is ignored
+ * for ascii VTK output and for the appended data section, which
+ * defers all blocks by design.
+ *
+ * \param [in,out] cont     The VTK context to modify.
+ * \param [in] streaming    Boolean: write the header in per-tree chunks.
+ */
+void                p8est_vtk_context_set_streaming (p8est_vtk_context_t *
+                                                     cont, int streaming);
+
+/** Callback to decide whether an octant appears in the VTK output.
+ * \param [in] p8est        The forest passed to the context.
+ * \param [in] which_tree   The tree containing \a quadrant.
+ * \param [in] quadrant     The octant under consideration.
+ * \param [in,out] user     The pointer registered with the predicate.
+ * \return                  True to include the octant in the output.
+ */
+typedef int         (*p8est_vtk_select_t) (p8est_t * p8est,
+                                           p4est_topidx_t which_tree,
+                                           p8est_quadrant_t * quadrant,
+                                           void *user);
+
+/** Restrict the output to the octants chosen by a predicate.
+ * The point and cell arrays are built only for the selected octants,
+ * so a small region can be dumped at full rate without whole-mesh I/O.
+ * Data arrays passed to the write functions then cover exactly the
+ * selected octants in forest order, and the parallel meta files list
+ * only the pieces of processes that selected anything.  A selection
+ * always writes each cell's corners separately as if the scale were
+ * smaller than one.
+ * \param [in,out] cont      The context is modified.
+ *                           It must not yet be used for writing.
+ * \param [in] select_fn     Called once per local octant during
+ *                           \ref p8est_vtk_write_header; NULL reverts
+ *                           to writing every octant.
+ * \param [in,out] user      Arbitrary pointer passed to \a select_fn.
+ */
+void                p8est_vtk_context_set_select (p8est_vtk_context_t * cont,
+                                                  p8est_vtk_select_t
+                                                  select_fn, void *user);
+
+/** Restrict the output to a set of Morton index ranges.
+ * Behaves like \ref p8est_vtk_context_set_select with a built-in
+ * predicate that keeps every octant overlapping one of the ranges.
+ * A predicate registered separately takes precedence over the ranges.
+ * \param [in,out] cont      The context is modified.
+ *                           It must not yet be used for writing.
+ * \param [in] which_tree    Tree the ranges refer to, or -1 to apply
+ *                           them within every local tree.
+ * \param [in] ranges        Sorted disjoint ranges of finest-level
+ *                           Morton indices as produced by
+ *                           \ref p8est_morton_range_from_quadrants;
+ *                           an array of p8est_morton_range_t that must
+ *                           stay alive until the header is written.
+ *                           NULL reverts to writing every octant.
+ */
+void                p8est_vtk_context_set_ranges (p8est_vtk_context_t * cont,
+                                                  p4est_topidx_t which_tree,
+                                                  sc_array_t * ranges);
+
 /** Cleanly destroy a \ref p8est_vtk_context_t structure.
  *
  * This function closes all the file pointers and frees the context.
@@ -94,6 +94,10 @@ typedef struct p8est_wrap
   p8est_ghost_t      *ghost_aux;
   p8est_mesh_t       *mesh_aux;
   int                 match_aux;
+
+  /* for restricted leaf iteration use p8est_wrap_set_subset declared below */
+  p4est_topidx_t      num_subset_trees; /**< 0 if no subset is registered */
+  p4est_topidx_t     *subset_trees;     /**< Sorted local tree numbers */
 }
 p8est_wrap_t;
 
@@ -296,6 +300,28 @@ int                 p8est_wrap_partition (p8est_wrap_t * pp,
  */
 void                p8est_wrap_complete (p8est_wrap_t * pp);
 
+/** Register a subset of the local trees for restricted leaf iteration.
+ * Subsequent calls to \ref p8est_wrap_leaf_first_subset traverse only the
+ * registered trees, which saves time when most trees are inactive, for
+ * example in local time stepping.  The full mesh and ghost structures
+ * remain valid for the subset leaves since their entries are indexed by
+ * process-local quadrant numbers; see \ref p8est_wrap_get_mesh.
+ * The subset refers to the current partition.  It is cleared whenever
+ * \ref p8est_wrap_partition changes the forest and must be registered
+ * anew since tree ownership may have moved between processors.
+ * \param [in,out] pp       A valid p8est_wrap structure, hollow or not.
+ * \param [in] num_trees    Number of trees in the subset.
+ *                          Pass 0 together with \a trees == NULL to clear
+ *                          a previously registered subset.
+ * \param [in] trees        Sorted ascending list of tree numbers, each
+ *                          within the range of the process-local trees.
+ *                          The numbers are copied; ownership stays with
+ *                          the caller.
+ */
+void                p8est_wrap_set_subset (p8est_wrap_t * pp,
+                                           p4est_topidx_t num_trees,
+                                           const p4est_topidx_t * trees);
+
 /*** ITERATOR OVER THE FOREST LEAVES ***/
 
 typedef struct p8est_wrap_leaf
@@ -320,6 +346,9 @@ typedef struct p8est_wrap_leaf
   sc_array_t         *mirrors;        /**< If not NULL, from pp's ghost */
   p4est_locidx_t      nm;             /**< Internal: mirror counter */
   p4est_locidx_t      next_mirror_quadrant;     /**< Internal: next */
+
+  /* Information about iterating over a tree subset */
+  p4est_topidx_t      sub_index;      /**< Internal: subset position or -1 */
 }
 p8est_wrap_leaf_t;
 
@@ -338,6 +367,21 @@ p8est_wrap_leaf_t;
 p8est_wrap_leaf_t  *p8est_wrap_leaf_first (p8est_wrap_t * pp,
                                            int track_mirrors);
 
+/* Create an iterator over the leaves of the registered tree subset.
+ * Like \ref p8est_wrap_leaf_first, but the iteration only visits the
+ * trees registered with \ref p8est_wrap_set_subset.  Without a
+ * registered subset this function iterates over the whole local forest.
+ * Mirror tracking remains consistent: mirrors in skipped trees are
+ * passed over internally and never reported.
+ * \param [in] pp   Legal p8est_wrap structure, hollow or not.
+ * \param [in] track_mirrors    If true, \a pp must not be hollow and mirror
+ *                              information from the ghost layer is stored.
+ * \return          NULL if the subset is locally empty, otherwise a leaf
+ *                  iterator for use with \a p8est_wrap_leaf_next.
+ */
+p8est_wrap_leaf_t  *p8est_wrap_leaf_first_subset (p8est_wrap_t * pp,
+                                                  int track_mirrors);
+
 /* Move the forest leaf iterator forward.
  * \param [in,out] leaf     A non-NULL leaf iterator created by
  *                          \ref p8est_wrap_leaf_first.
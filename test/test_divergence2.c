@@ -0,0 +1,144 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4_TO_P8
+#include <p4est_algorithms.h>
+#include <p4est_bits.h>
+#include <p4est_extended.h>
+#else
+#include <p8est_algorithms.h>
+#include <p8est_bits.h>
+#include <p8est_extended.h>
+#endif
+
+static int
+test_refine (p4est_t * p4est, p4est_topidx_t which_tree,
+             p4est_quadrant_t * quadrant)
+{
+  return quadrant->level == 2 && p4est_quadrant_child_id (quadrant) == 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  size_t              zz;
+  sc_MPI_Comm         mpicomm;
+  p4est_t            *p4est, *other;
+  p4est_connectivity_t *connectivity;
+  p4est_topidx_t      jt, expected;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+  p4est_quadrant_t    expect_pos, first_diff, last_diff;
+  p4est_tree_checksums_t *tc1, *tc2;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  /* create forest and an identical copy */
+#ifndef P4_TO_P8
+  connectivity = p4est_connectivity_new_star ();
+#else
+  connectivity = p8est_connectivity_new_rotcubes ();
+#endif
+  p4est = p4est_new_ext (mpicomm, connectivity, 0, 2, 1, 0, NULL, NULL);
+  other = p4est_copy (p4est, 0);
+
+  SC_CHECK_ABORT (p4est_divergence (p4est, other, NULL, NULL, NULL, NULL)
+                  == -1, "Equal forests diverge");
+
+  /* predict where the refinement below will first differ */
+  expected = -1;
+  P4EST_QUADRANT_INIT (&expect_pos);
+  for (jt = p4est->first_local_tree;
+       expected == -1 && jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      if (test_refine (p4est, jt, q)) {
+        expected = jt;
+        p4est_quadrant_first_descendant (q, &expect_pos, P4EST_QMAXLEVEL);
+        break;
+      }
+    }
+  }
+
+  /* cache tree checksums and let a journal track the refinement */
+  tc1 = p4est_tree_checksums_new (p4est);
+  tc2 = p4est_tree_checksums_new (other);
+  p4est->inspect = P4EST_ALLOC_ZERO (p4est_inspect_t, 1);
+  p4est->inspect->journal = sc_array_new (sizeof (p4est_journal_entry_t));
+
+  p4est_refine (p4est, 0, test_refine, NULL);
+  SC_CHECK_ABORT (expected == -1 ||
+                  p4est->inspect->journal->elem_count > 0, "Journal empty");
+
+  /* the incremental update rescans only the journaled trees */
+  p4est_tree_checksums_update (tc1);
+  P4EST_QUADRANT_INIT (&first_diff);
+  P4EST_QUADRANT_INIT (&last_diff);
+  jt = p4est_divergence (p4est, other, tc1, tc2, &first_diff, &last_diff);
+  SC_CHECK_ABORT (jt == expected, "Diverging tree");
+  if (expected != -1) {
+    SC_CHECK_ABORT (first_diff.p.which_tree == expected &&
+                    last_diff.p.which_tree == expected,
+                    "Diverging range tree");
+    SC_CHECK_ABORT (p4est_quadrant_is_equal (&first_diff, &expect_pos),
+                    "Diverging range start");
+    SC_CHECK_ABORT (p4est_quadrant_compare (&first_diff, &last_diff) <= 0,
+                    "Diverging range order");
+  }
+
+  /* the reverse comparison finds the same tree */
+  SC_CHECK_ABORT (p4est_divergence (other, p4est, tc2, tc1, NULL, NULL)
+                  == expected, "Reverse divergence");
+
+  /* equalize the copy; without a journal the cache update falls back
+   * to recomputing all local trees */
+  p4est_refine (other, 0, test_refine, NULL);
+  p4est_tree_checksums_update (tc1);
+  p4est_tree_checksums_update (tc2);
+  SC_CHECK_ABORT (p4est_divergence (p4est, other, tc1, tc2, NULL, NULL)
+                  == -1, "Equalized forests diverge");
+
+  p4est_tree_checksums_destroy (tc1);
+  p4est_tree_checksums_destroy (tc2);
+  sc_array_destroy (p4est->inspect->journal);
+  P4EST_FREE (p4est->inspect);
+  p4est->inspect = NULL;
+
+  p4est_destroy (p4est);
+  p4est_destroy (other);
+  p4est_connectivity_destroy (connectivity);
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
@@ -374,6 +374,58 @@ test_exchange_D (p4est_t * p4est, p4est_ghost_t * ghost)
   P4EST_FREE (ghost_struct_data);
 }
 
+static void
+test_ghost_split (p4est_t * p4est)
+{
+  p4est_ghost_t      *ghost, *split;
+  p4est_ghost_new_t  *gnc;
+
+  /* build the reference layer in one shot */
+  ghost = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+
+  /* the split construction may overlap unrelated work with communication */
+  gnc = p4est_ghost_new_begin (p4est, P4EST_CONNECT_FULL);
+  SC_CHECK_ABORT (p4est_is_valid (p4est), "Forest invalid between begin/end");
+  split = p4est_ghost_new_end (gnc);
+
+  /* both constructions must produce the identical ghost layer */
+  SC_CHECK_ABORT (p4est_ghost_is_valid (p4est, split), "Split ghost invalid");
+  SC_CHECK_ABORT (split->ghosts.elem_count == ghost->ghosts.elem_count &&
+                  !memcmp (split->ghosts.array, ghost->ghosts.array,
+                           ghost->ghosts.elem_count *
+                           sizeof (p4est_quadrant_t)), "Split ghosts");
+  SC_CHECK_ABORT (split->mirrors.elem_count == ghost->mirrors.elem_count &&
+                  !memcmp (split->mirrors.array, ghost->mirrors.array,
+                           ghost->mirrors.elem_count *
+                           sizeof (p4est_quadrant_t)), "Split mirrors");
+  SC_CHECK_ABORT (!memcmp (split->tree_offsets, ghost->tree_offsets,
+                           (size_t) (p4est->connectivity->num_trees + 1) *
+                           sizeof (p4est_locidx_t)), "Split tree offsets");
+  SC_CHECK_ABORT (!memcmp (split->proc_offsets, ghost->proc_offsets,
+                           (size_t) (p4est->mpisize + 1) *
+                           sizeof (p4est_locidx_t)), "Split proc offsets");
+  SC_CHECK_ABORT (!memcmp (split->mirror_tree_offsets,
+                           ghost->mirror_tree_offsets,
+                           (size_t) (p4est->connectivity->num_trees + 1) *
+                           sizeof (p4est_locidx_t)),
+                  "Split mirror tree offsets");
+  SC_CHECK_ABORT (!memcmp (split->mirror_proc_offsets,
+                           ghost->mirror_proc_offsets,
+                           (size_t) (p4est->mpisize + 1) *
+                           sizeof (p4est_locidx_t)),
+                  "Split mirror proc offsets");
+  SC_CHECK_ABORT (!memcmp (split->mirror_proc_mirrors,
+                           ghost->mirror_proc_mirrors,
+                           (size_t) ghost->mirror_proc_offsets[p4est->mpisize]
+                           * sizeof (p4est_locidx_t)),
+                  "Split mirror proc mirrors");
+  SC_CHECK_ABORT (p4est_ghost_checksum (p4est, split) ==
+                  p4est_ghost_checksum (p4est, ghost), "Split checksum");
+
+  p4est_ghost_destroy (split);
+  p4est_ghost_destroy (ghost);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -413,6 +465,9 @@ main (int argc, char **argv)
   /* do a uniform partition */
   p4est_partition (p4est, 0, NULL);
 
+  /* verify the split begin/end construction against the one-shot one */
+  test_ghost_split (p4est);
+
   /* create the ghost layer */
   ghost = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
 